@@ -168,6 +168,12 @@ typedef struct _au_endpoint_desc_ {
 #define USB_WAIT_EVENT_DEVICE_NOTIFICATION        38
 #define USB_WAIT_EVENT_MFINDEX                    39
 
+/* completion codes returned by AuBulkWait */
+#define USB_COMPLETION_SUCCESS       1
+#define USB_COMPLETION_BABBLE        3
+#define USB_COMPLETION_STALL         6
+#define USB_COMPLETION_SHORT_PACKET  13
+
 #define USB_DESCRIPTOR_WVALUE(type,index) ((type << 8) | index)
 
 /* transfer type defined in endpoint descriptor*/
@@ -196,6 +202,12 @@ typedef uint8_t(*get_endpoint_attrib)(_au_usb_dev_* dev, void* ep);
 typedef AuUSBDescriptor* (*get_descriptor_callback)(_au_usb_dev_* dev, uint8_t type);
 typedef void (*set_config_val_callback)(_au_usb_dev_* dev, uint8_t config_val);
 typedef int (*poll_wait_callback)(_au_usb_dev_* dev, int poll_wait);
+typedef uint32_t (*bulk_queue_callback)(_au_usb_dev_* dev, uint64_t buffer_addr, uint32_t len, void* ep, uint16_t stream);
+typedef int (*bulk_wait_callback)(_au_usb_dev_* dev, void* ep, uint16_t stream, uint32_t seq);
+typedef int (*set_interface_callback)(_au_usb_dev_* dev, uint8_t iface, uint8_t alt);
+typedef void* (*get_endpoint_by_addr_callback)(_au_usb_dev_* dev, uint8_t addr);
+typedef uint16_t (*get_max_streams_callback)(_au_usb_dev_* dev, void* ep);
+typedef void (*clear_halt_callback)(_au_usb_dev_* dev, void* ep);
 
 #pragma pack(push,1)
 typedef struct _au_usb_dev_ {
@@ -228,6 +240,15 @@ typedef struct _au_usb_dev_ {
 	poll_wait_callback AuUSBWait;
 	au_usb_drv_entry ClassEntry;
 	au_usb_drv_unload ClassUnload;
+	/* queued transfers, AuBulkQueue returns a sequence number
+	 * which AuBulkWait blocks on, several transfers can be
+	 * in flight on the same endpoint */
+	bulk_queue_callback AuBulkQueue;
+	bulk_wait_callback AuBulkWait;
+	set_interface_callback AuSetInterface;
+	get_endpoint_by_addr_callback AuGetEndpointByAddress;
+	get_max_streams_callback AuGetMaxStreams;
+	clear_halt_callback AuClearHalt;
 }AuUSBDeviceStruc;
 #pragma pack(pop)
 
@@ -34,6 +34,7 @@
 #include <Fs/vdisk.h>
 #ifdef ARCH_X64
 #include <Sync/mutex.h>
+#include <hashmap.h>
 #endif
 #include <Fs/vfs.h>
 
@@ -49,6 +50,11 @@
 #define FAT_EOC_MARK  0xFFFFFFF8
 #define FAT_BAD_CLUSTER 0xFFFFFFF7
 
+/* largest run transferred by a single disk request when
+ * moving clusters straight into caller's memory, kept well
+ * below AHCI's 4MiB per PRD limit */
+#define FAT_DIRECT_MAX_BYTES  (1024*1024)
+
 #pragma pack(push,1)
 /* FAT BPB */
 typedef struct _FAT_BPB_ {
@@ -156,6 +162,11 @@ typedef struct _FatFS_ {
 	AuMutex *fat_mutex;
 	AuMutex *fat_write_mutex;
 	AuMutex *fat_read_mutex;
+	hashmap_t* dir_index; //directory indexes by first cluster
+	struct _FatWriteBack_* wb_files; //files with dirty data or size
+	uint32_t free_clusters;   //valid once free_counted is set
+	uint32_t wb_reserved;     //free clusters promised to buffered data
+	bool free_counted;
 #endif
 }FatFS;
 
@@ -215,6 +226,33 @@ extern uint32_t FatFindFreeCluster(AuVFSNode* node);
 */
 extern void FatAllocCluster(AuVFSNode* fsys, int position, uint32_t n_value);
 
+/*
+* FatFindFreeRun -- finds a run of free clusters, the
+* first run long enough is returned, otherwise the
+* longest one found
+* @param fsys -- Pointer to file system node
+* @param hint -- cluster to start searching from
+* @param want -- clusters needed
+* @param run_len -- receives the length of the run
+*/
+extern uint32_t FatFindFreeRun(AuVFSNode* fsys, uint32_t hint, uint32_t want, uint32_t* run_len);
+
+/*
+* FatFreeClusters -- returns the number of free clusters
+* not promised to buffered data yet
+* @param fsys -- Pointer to file system node
+*/
+extern uint32_t FatFreeClusters(AuVFSNode* fsys);
+
+/*
+* FatAllocChain -- links a run of clusters into a chain
+* ending with EOC mark
+* @param fsys -- Pointer to file system node
+* @param start -- first cluster of the run
+* @param count -- number of clusters in the run
+*/
+extern void FatAllocChain(AuVFSNode* fsys, uint32_t start, uint32_t count);
+
 /**
 * FatClearCluster -- clears a cluster to 0
 * @param cluster -- cluster to clear
@@ -228,6 +266,27 @@ extern void FatClearCluster(AuVFSNode* node, uint32_t cluster);
 */
 extern uint32_t FatReadFAT(AuVFSNode *node, uint64_t cluster_index);
 
+/*
+* FatDirectTransfer -- transfers whole clusters between disk
+* and caller's buffer without bouncing, as long as the cluster
+* chain and buffer pages are contiguous
+* @param fsys -- Pointer to file system node
+* @param file -- Pointer to file
+* @param buffer -- caller's buffer
+* @param length -- bytes left to transfer
+* @param write -- true to write, false to read
+*/
+extern size_t FatDirectTransfer(AuVFSNode* fsys, AuVFSNode* file, uint8_t* buffer, size_t length, bool write);
+
+/*
+* FatGetClusterFor -- returns the cluster for provided byte offset
+* of the file
+* @param fs -- file system pointer
+* @param file -- pointer to file node
+* @param offset -- byte offset
+*/
+extern size_t FatGetClusterFor(AuVFSNode* fs, AuVFSNode* file, uint64_t offset);
+
 //! Opens a file 
 //! @param filename -- name of the file
 //! @example -- /EFI/BOOT/BOOTx64.efi
@@ -37,19 +37,17 @@
 /*
 * FatCreateFile -- Creates a blank file
 * @param fsys -- Pointer to file system
-* @param parent_cluster -- Parent cluster, if it's
-* 0 then parent_cluster equals to root_cluster
-* @param filename -- name of the file
+* @param filename -- path of the file
 */
 extern AuVFSNode* FatCreateFile(AuVFSNode* fsys, char* filename);
 
 /*
-* FatFileWriteContent -- write contents to fat file (4kib)
+* FatFileGetLastCluster -- walks the cluster chain of a
+* file and returns the last cluster of it
 * @param fsys -- Pointer to file system node
-* @param first_cluster -- first cluster of the file
-* @param buffer -- buffer to write
+* @param file -- Pointer to file
 */
-extern void FatFileWriteContent(AuVFSNode* fsys, AuVFSNode* file, uint64_t* buffer);
+extern uint32_t FatFileGetLastCluster(AuVFSNode* fsys, AuVFSNode* file);
 
 
 /*
@@ -75,6 +73,14 @@ extern void FatFileUpdateSize(AuVFSNode* fsys, AuVFSNode* file, size_t size);
 */
 extern AuVFSNode* FatFileGetParent(AuVFSNode* fsys, const char* filename);
 
+/*
+* FatFileGetName -- extracts the last component
+* of a path
+* @param path -- path of the file
+* @param name -- buffer of FAT_LFN_MAX_NAME + 1 bytes
+*/
+extern void FatFileGetName(const char* path, char* name);
+
 /*
 * FatWrite -- write callback
 * @param fsys -- pointer to file system
@@ -82,7 +88,7 @@ extern AuVFSNode* FatFileGetParent(AuVFSNode* fsys, const char* filename);
 * @param buffer -- buffer to write
 * @param length -- bytes needed to write
 */
-extern size_t FatWrite(AuVFSNode* fsys, AuVFSNode* file, uint64_t* buffer, uint32_t length);
+extern size_t FatWrite(AuVFSNode* fsys, AuVFSNode* file, uint64_t* buffer, size_t length);
 
 /*
 * FatFileUpdateFilename -- updates the current file name
@@ -0,0 +1,192 @@
+/**
+* BSD 2-Clause License
+*
+* Copyright (c) 2022-2023, Manas Kamal Choudhury
+* All rights reserved.
+*
+* Redistribution and use in source and binary forms, with or without
+* modification, are permitted provided that the following conditions are met:
+*
+* 1. Redistributions of source code must retain the above copyright notice, this
+*    list of conditions and the following disclaimer.
+*
+* 2. Redistributions in binary form must reproduce the above copyright notice,
+*    this list of conditions and the following disclaimer in the documentation
+*    and/or other materials provided with the distribution.
+*
+* THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+* AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+* IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+* DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE
+* FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+* DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR
+* SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER
+* CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY,
+* OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+* OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+*
+**/
+
+#ifndef __FAT_INDEX_H__
+#define __FAT_INDEX_H__
+
+#include <Fs\Fat\Fat.h>
+#include <Fs\vfs.h>
+#include <hashmap.h>
+#include <stdint.h>
+
+/*
+ * FAT directory index, every directory gets an in-memory
+ * copy of its entries on first access, keyed by both long
+ * and short name so that lookups, collision checks and
+ * directory enumeration never go back to the disk
+ */
+
+#define FAT_LFN_MAX_NAME  255
+#define FAT_LFN_CHARS_PER_ENTRY 13
+#define FAT_LFN_LAST_ENTRY  0x40
+#define FAT_LFN_ORDER_MASK  0x1F
+#define FAT_DIR_ENTRY_FREE  0xE5
+#define FAT_DIR_ENTRY_END   0x00
+
+#define FAT_INDEX_BUCKETS  64
+#define FAT_DIR_INDEX_BUCKETS  32
+/* indexes used within this many ticks are left alone
+ * by reclaim */
+#define FAT_INDEX_IDLE_TICKS  2000
+
+typedef struct _FatIndexEntry_ {
+	char* name;            //long name, or the short one when no LFN present
+	char short_name[13];   //short name in human readable form
+	uint8_t dos_name[11];  //short name as stored on disk
+	uint32_t first_cluster;
+	uint32_t size;
+	uint16_t date;
+	uint16_t time;
+	uint8_t attrib;
+	uint32_t slot;         //slot of the short entry
+	uint8_t lfn_count;     //number of LFN slots preceding the short entry
+	bool valid;
+}FatIndexEntry;
+
+typedef struct _FatDirIndex_ {
+	uint32_t first_cluster;
+	uint32_t* clusters;    //cluster chain of the directory
+	uint32_t cluster_count;
+	uint32_t slot_count;   //32 byte slots in the whole chain
+	uint32_t end_slot;     //slot holding the end of directory marker
+	uint8_t* slot_map;     //bitmap of slots in use
+	FatIndexEntry** entries;
+	uint32_t entry_count;
+	uint32_t entry_cap;
+	uint32_t dead_count;   //unlinked entries waiting to be reused
+	hashmap_t* long_names;
+	hashmap_t* short_names;
+	hashmap_t* clusters_map;  //entries keyed by first cluster
+	uint64_t last_use;     //system tick of last lookup
+}FatDirIndex;
+
+/*
+ * FatIndexGet -- returns the index of a directory, builds
+ * it from disk on first access
+ * @param fsys -- Pointer to file system node
+ * @param dir_cluster -- first cluster of the directory
+ */
+extern FatDirIndex* FatIndexGet(AuVFSNode* fsys, uint32_t dir_cluster);
+
+/*
+ * FatIndexLookup -- looks up an entry by its long or
+ * short name, case insensitively
+ * @param fsys -- Pointer to file system node
+ * @param dir_cluster -- first cluster of the directory
+ * @param name -- name to look for
+ */
+extern FatIndexEntry* FatIndexLookup(AuVFSNode* fsys, uint32_t dir_cluster, const char* name);
+
+/*
+ * FatIndexFindFile -- returns the directory entry backing
+ * an opened file
+ * @param fsys -- Pointer to file system node
+ * @param file -- Pointer to file
+ */
+extern FatIndexEntry* FatIndexFindFile(AuVFSNode* fsys, AuVFSNode* file);
+
+/*
+ * FatIndexAddEntry -- writes a new entry, along with its
+ * LFN entries if needed, into a directory. The directory
+ * grows by one cluster when it has no room left
+ * @param fsys -- Pointer to file system node
+ * @param dir_cluster -- first cluster of the directory
+ * @param name -- name of the new entry
+ * @param proto -- short entry to write, filename is filled in
+ */
+extern FatIndexEntry* FatIndexAddEntry(AuVFSNode* fsys, uint32_t dir_cluster, const char* name, FatDir* proto);
+
+/*
+ * FatIndexRemoveEntry -- marks an entry and its LFN
+ * entries deleted
+ * @param fsys -- Pointer to file system node
+ * @param dir_cluster -- first cluster of the directory
+ * @param ent -- entry to remove
+ */
+extern int FatIndexRemoveEntry(AuVFSNode* fsys, uint32_t dir_cluster, FatIndexEntry* ent);
+
+/*
+ * FatIndexRenameEntry -- gives an entry a new name
+ * @param fsys -- Pointer to file system node
+ * @param dir_cluster -- first cluster of the directory
+ * @param ent -- entry to rename
+ * @param newname -- new name
+ */
+extern FatIndexEntry* FatIndexRenameEntry(AuVFSNode* fsys, uint32_t dir_cluster, FatIndexEntry* ent, const char* newname);
+
+/*
+ * FatIndexUpdateSize -- updates size and write stamp
+ * of an entry
+ * @param fsys -- Pointer to file system node
+ * @param dir_cluster -- first cluster of the directory
+ * @param ent -- entry to update
+ * @param size -- size in bytes
+ */
+extern int FatIndexUpdateSize(AuVFSNode* fsys, uint32_t dir_cluster, FatIndexEntry* ent, uint32_t size);
+
+/*
+ * FatIndexDrop -- forgets the index of a directory
+ * @param fsys -- Pointer to file system node
+ * @param dir_cluster -- first cluster of the directory
+ */
+extern void FatIndexDrop(AuVFSNode* fsys, uint32_t dir_cluster);
+
+/*
+ * FatIndexRegister -- lets reclaim drop idle directory
+ * indexes of a mounted volume
+ * @param fsys -- Pointer to file system node
+ */
+extern void FatIndexRegister(AuVFSNode* fsys);
+
+/*
+ * FatIndexUnregister -- removes a volume from reclaim
+ * @param fsys -- Pointer to file system node
+ */
+extern void FatIndexUnregister(AuVFSNode* fsys);
+
+/*
+ * FatIndexFillNode -- fills a vfs node from an index entry
+ * @param fsys -- Pointer to file system node
+ * @param file -- node to fill
+ * @param ent -- index entry
+ * @param name -- name the file was opened with
+ * @param parent -- first cluster of parent directory
+ */
+extern void FatIndexFillNode(AuVFSNode* fsys, AuVFSNode* file, FatIndexEntry* ent, const char* name, uint32_t parent);
+
+/*
+ * FatIndexCopyName -- copies a name into a fixed size
+ * buffer, truncating it when needed
+ * @param dest -- destination buffer
+ * @param name -- name to copy
+ * @param dest_sz -- size of destination buffer
+ */
+extern void FatIndexCopyName(char* dest, const char* name, size_t dest_sz);
+
+#endif
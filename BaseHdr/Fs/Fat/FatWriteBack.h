@@ -0,0 +1,179 @@
+/**
+* BSD 2-Clause License
+*
+* Copyright (c) 2022-2023, Manas Kamal Choudhury
+* All rights reserved.
+*
+* Redistribution and use in source and binary forms, with or without
+* modification, are permitted provided that the following conditions are met:
+*
+* 1. Redistributions of source code must retain the above copyright notice, this
+*    list of conditions and the following disclaimer.
+*
+* 2. Redistributions in binary form must reproduce the above copyright notice,
+*    this list of conditions and the following disclaimer in the documentation
+*    and/or other materials provided with the distribution.
+*
+* THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+* AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+* IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+* DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE
+* FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+* DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR
+* SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER
+* CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY,
+* OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+* OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+*
+**/
+
+#ifndef __FAT_WRITEBACK_H__
+#define __FAT_WRITEBACK_H__
+
+#include <Fs\Fat\Fat.h>
+#include <Fs\vfs.h>
+#include <stdint.h>
+
+/*
+ * FAT write-back, data written past the allocated cluster
+ * chain of a file stays in memory until it gets flushed, so
+ * clusters are allocated as long contiguous runs and the
+ * directory entry gets updated once per flush instead of
+ * once per write
+ */
+
+/* data is buffered in chunks of physically contiguous pages */
+#define FAT_WB_CHUNK_SIZE  (64*1024)
+#define FAT_WB_MAX_CHUNKS  16
+/* flusher thread wakes up every interval */
+#define FAT_WB_FLUSH_INTERVAL  1000
+
+typedef struct _FatWriteBack_ {
+	uint32_t first_cluster;
+	uint32_t parent_cluster;
+	uint32_t last_cluster;    //last cluster of allocated chain
+	uint64_t alloc_bytes;     //bytes covered by allocated chain
+	uint32_t tail_cluster;    //first cluster of the contiguous tail
+	uint64_t tail_offset;     //byte offset of tail_cluster
+	uint64_t size;            //file size including buffered data
+	uint32_t reserved;        //free clusters reserved past alloc_bytes
+	uint8_t* chunks[FAT_WB_MAX_CHUNKS]; //data from alloc_bytes onwards
+	bool size_dirty;
+	bool idle;                //stayed clean for a whole flush period
+	struct _FatWriteBack_* next;
+}FatWriteBack;
+
+/*
+ * FatWriteBackRegister -- registers a mounted FAT volume
+ * with the flusher
+ * @param fsys -- Pointer to file system node
+ */
+extern void FatWriteBackRegister(AuVFSNode* fsys);
+
+/*
+ * FatWriteBackUnregister -- flushes everything and removes
+ * a volume from the flusher
+ * @param fsys -- Pointer to file system node
+ */
+extern void FatWriteBackUnregister(AuVFSNode* fsys);
+
+/*
+ * FatWriteBackFind -- returns the write-back state of a
+ * file if there is one
+ * @param fsys -- Pointer to file system node
+ * @param first_cluster -- first cluster of the file
+ */
+extern FatWriteBack* FatWriteBackFind(AuVFSNode* fsys, uint32_t first_cluster);
+
+/*
+ * FatWriteBackGet -- returns the write-back state of a
+ * file, creating it when needed
+ * @param fsys -- Pointer to file system node
+ * @param file -- Pointer to file
+ */
+extern FatWriteBack* FatWriteBackGet(AuVFSNode* fsys, AuVFSNode* file);
+
+/*
+ * FatWriteBackClusterFor -- returns the cluster holding given
+ * byte offset when it lies in the contiguous tail of the chain,
+ * 0 otherwise
+ * @param fsys -- Pointer to file system node
+ * @param wb -- write-back state of the file
+ * @param offset -- byte offset
+ */
+extern uint32_t FatWriteBackClusterFor(AuVFSNode* fsys, FatWriteBack* wb, uint64_t offset);
+
+/*
+ * FatWriteBackWindow -- returns the end of the range a
+ * file can buffer before it has to be flushed
+ * @param fsys -- Pointer to file system node
+ * @param wb -- write-back state of the file
+ */
+extern uint64_t FatWriteBackWindow(AuVFSNode* fsys, FatWriteBack* wb);
+
+/*
+ * FatWriteBackBuffer -- copies data into the buffered
+ * area of a file, returns bytes buffered, short once the
+ * buffer or the volume is full
+ * @param fsys -- Pointer to file system node
+ * @param wb -- write-back state of the file
+ * @param offset -- byte offset, not below alloc_bytes
+ * @param buffer -- data to copy
+ * @param length -- length in bytes
+ */
+extern size_t FatWriteBackBuffer(AuVFSNode* fsys, FatWriteBack* wb, uint64_t offset, uint8_t* buffer, size_t length);
+
+/*
+ * FatWriteBackRead -- copies buffered data of a file,
+ * returns bytes copied
+ * @param fsys -- Pointer to file system node
+ * @param wb -- write-back state of the file
+ * @param offset -- byte offset, not below alloc_bytes
+ * @param buffer -- destination buffer
+ * @param length -- length in bytes
+ */
+extern size_t FatWriteBackRead(AuVFSNode* fsys, FatWriteBack* wb, uint64_t offset, uint8_t* buffer, size_t length);
+
+/*
+ * FatWriteBackSetSize -- records a new file size, the
+ * directory entry is updated on next flush
+ * @param fsys -- Pointer to file system node
+ * @param wb -- write-back state of the file
+ * @param size -- size in bytes
+ */
+extern void FatWriteBackSetSize(AuVFSNode* fsys, FatWriteBack* wb, uint64_t size);
+
+/*
+ * FatWriteBackFlush -- allocates clusters for buffered
+ * data, writes it out and updates the directory entry,
+ * returns 0 on success
+ * @param fsys -- Pointer to file system node
+ * @param wb -- write-back state of the file
+ */
+extern int FatWriteBackFlush(AuVFSNode* fsys, FatWriteBack* wb);
+
+/*
+ * FatWriteBackSync -- flushes a file, or every file
+ * of the volume when file is null
+ * @param fsys -- Pointer to file system node
+ * @param file -- Pointer to file, can be null
+ */
+extern int FatWriteBackSync(AuVFSNode* fsys, AuVFSNode* file);
+
+/*
+ * FatWriteBackRelease -- flushes a file and forgets
+ * its write-back state
+ * @param fsys -- Pointer to file system node
+ * @param first_cluster -- first cluster of the file
+ */
+extern void FatWriteBackRelease(AuVFSNode* fsys, uint32_t first_cluster);
+
+/*
+ * FatWriteBackDiscard -- throws away buffered data of
+ * a file being removed
+ * @param fsys -- Pointer to file system node
+ * @param first_cluster -- first cluster of the file
+ */
+extern void FatWriteBackDiscard(AuVFSNode* fsys, uint32_t first_cluster);
+
+#endif
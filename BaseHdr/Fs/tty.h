@@ -32,13 +32,25 @@
 
 #include <stdint.h>
 #include <termios.h>
+#ifdef ARCH_X64
+#include <ringbuf.h>
+#include <Hal\x86_64_sched.h>
+#elif ARCH_ARM64
 #include <circbuf.h>
+#include <Hal/AA64/sched.h>
+#endif
 
 #define TIOCGWINSZ   0x5401
 #define TIOCSWINSZ   0x5402
 #define TIOCFLUSH    0x5403
 #define TIOCGATTR    0x5404
 #define TIOSPGRP     0x5405
+#define TIOCSATTR    0x5406
+
+#define TTY_BUFFER_SIZE  4096
+#define TTY_LINE_MAX     512
+/* committed canonical lines waiting to be read */
+#define TTY_PENDING_LINES  64
 
 #pragma pack(push,1)
 typedef struct _win_size_ {
@@ -48,19 +60,47 @@ typedef struct _win_size_ {
 	uint16_t ws_ypixel;
 }WinSize;
 
+/*
+ * TTYWaiter -- thread sleeping on a tty end, lives
+ * on the sleeping thread's kernel stack
+ */
+typedef struct _tty_waiter_ {
+#ifdef ARCH_X64
+	AuThread* thread;
+#elif ARCH_ARM64
+	AA64Thread* thread;
+#endif
+	struct _tty_waiter_* next;
+}TTYWaiter;
+
 typedef struct __tty__ {
 	uint8_t id;
 	WinSize size;
 	Termios term;
-	CircBuffer *masterbuf;
+#ifdef ARCH_X64
+	AuRingBuffer* masterbuf;  /* slave output, read by master */
+	AuRingBuffer* slavebuf;   /* master input, read by slave */
+#elif ARCH_ARM64
+	CircBuffer* masterbuf;
 	CircBuffer* slavebuf;
+#endif
 	void* masterbuf_ptr;
 	void* slavebuf_ptr;
-	int master_written;
-	int slave_written;
+	uint8_t lineBuf[TTY_LINE_MAX]; /* canonical line being edited */
+	uint16_t lineLen;
+	/* lengths of committed lines still in slavebuf, lines
+	 * ended by VEOL or VEOF carry no newline, so readers
+	 * split on these */
+	uint16_t lineEnds[TTY_PENDING_LINES];
+	uint16_t lineEndHead;
+	uint16_t lineEndCount;
+	bool eof;
+	bool hangup;
+	bool outCR;
 	uint16_t master_pid;
 	uint16_t slave_pid;
-	uint16_t blockedSlaveId;
+	TTYWaiter* readers;
+	TTYWaiter* writers;
 	struct __tty__ *next;
 	struct __tty__ *prev;
 }TTY;
@@ -80,4 +120,13 @@ extern int AuTTYCreate(int* master_fd, int* slave_fd);
 * AuTTYInitialise -- initialize the TTY kernel resource
 */
 extern void AuTTYInitialise();
+
+#ifdef ARCH_X64
+/*
+ * AuTTYRemoveThread -- drop a thread from tty
+ * wait queues
+ * @param thr -- Pointer to thread
+ */
+extern void AuTTYRemoveThread(AuThread* thr);
+#endif
 #endif
\ No newline at end of file
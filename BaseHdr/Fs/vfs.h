@@ -70,9 +70,9 @@ typedef struct _AuDirectoryEnty_ {
 #pragma pack(pop)
 
 typedef struct __VFS_NODE__* (*open_callback) (struct __VFS_NODE__ *node, char* path);
-typedef size_t(*read_callback) (struct __VFS_NODE__ *node, struct  __VFS_NODE__ *file, uint64_t* buffer, uint32_t length);
+typedef size_t(*read_callback) (struct __VFS_NODE__ *node, struct  __VFS_NODE__ *file, uint64_t* buffer, size_t length);
 typedef size_t(*read_block_callback) (struct __VFS_NODE__ *node, struct __VFS_NODE__ *file, uint64_t* buffer);
-typedef size_t (*write_callback) (struct __VFS_NODE__ *node, struct __VFS_NODE__ *file, uint64_t* buffer, uint32_t length);
+typedef size_t (*write_callback) (struct __VFS_NODE__ *node, struct __VFS_NODE__ *file, uint64_t* buffer, size_t length);
 typedef struct __VFS_NODE__*(*create_dir_callback) (struct __VFS_NODE__ *node, char* dirname);
 typedef struct __VFS_NODE__*(*create_file_callback) (struct __VFS_NODE__ *node, char* filename);
 typedef int (*remove_dir_callback) (struct __VFS_NODE__* node, struct __VFS_NODE__ *file);
@@ -82,13 +82,14 @@ typedef int(*iocontrol_callback) (struct __VFS_NODE__ *file, int code, void *arg
 typedef struct __VFS_NODE__* (*opendir_callback) (struct __VFS_NODE__ *fs, char* dirname);
 typedef int(*readdir_callback)(struct __VFS_NODE__* fs, struct __VFS_NODE__* dir, AuDirectoryEntry* dirent);
 typedef size_t(*fs_getblockfor) (struct __VFS_NODE__* fs, struct  __VFS_NODE__* file, uint64_t offset);
+typedef int(*sync_callback) (struct __VFS_NODE__* fs, struct __VFS_NODE__* file);
 
 #pragma pack(push,1)
 typedef struct __VFS_NODE__ {
 	char filename[32];
-	uint32_t size;
+	uint64_t size;
 	uint8_t  eof;
-	uint32_t pos;
+	uint64_t pos;
 	uint32_t parent_block;
 	uint64_t first_block;
 	uint64_t current;
@@ -110,20 +111,33 @@ typedef struct __VFS_NODE__ {
 	readdir_callback read_dir;
 	fs_getblockfor get_blockfor;
 	iocontrol_callback iocontrol;
+	sync_callback sync;
 }AuVFSNode;
 #pragma pack(pop)
 
 #pragma pack(push,1)
 typedef struct _AuFileStatus_ {
 	uint8_t filemode; //mode of the file
-	size_t size;  //size in bytes
-	uint32_t current_block;
-	uint32_t start_block;
+	uint64_t size;  //size in bytes
+	uint64_t current_block;
+	uint64_t start_block;
 	uint32_t user_id; //for future use
 	uint32_t group_id; //for future use
 	uint32_t num_links;
 	uint8_t eof;
+	uint64_t pos; //current byte offset
 }AuFileStatus;
+
+/*
+ * AuIOVec -- one segment of a vectored
+ * read/write request
+ */
+typedef struct _AuIOVec_ {
+	void* base;
+	size_t len;
+}AuIOVec;
+
+#define AU_IOV_MAX 64
 #pragma pack(pop)
 
 #pragma pack(push,1)
@@ -200,7 +214,7 @@ AU_EXTERN AU_EXPORT AuVFSNode* AuVFSFind(char* path);
 * @param buffer -- buffer to write to
 * @param length -- length of the file
 */
-AU_EXTERN AU_EXPORT size_t AuVFSNodeRead(AuVFSNode* node, AuVFSNode* file, uint64_t* buffer, uint32_t length);
+AU_EXTERN AU_EXPORT size_t AuVFSNodeRead(AuVFSNode* node, AuVFSNode* file, uint64_t* buffer, size_t length);
 
 /*
 * AuVFSNodeReadBlock -- read a block size data from file system
@@ -244,8 +258,9 @@ extern int AuVFSRemoveDir(AuVFSNode* fsys, AuVFSNode* file);
 * @param file -- file node to use
 * @param buffer -- buffer to write
 * @param length -- length of the data
+* @return number of bytes written
 */
-AU_EXTERN AU_EXPORT void AuVFSNodeWrite(AuVFSNode* node, AuVFSNode * file, uint64_t *buffer, uint32_t length);
+AU_EXTERN AU_EXPORT size_t AuVFSNodeWrite(AuVFSNode* node, AuVFSNode * file, uint64_t *buffer, size_t length);
 
 /*
 * AuVFSNodeClose -- close a file system or file
@@ -254,6 +269,15 @@ AU_EXTERN AU_EXPORT void AuVFSNodeWrite(AuVFSNode* node, AuVFSNode * file, uint6
 */
 AU_EXTERN AU_EXPORT void AuVFSNodeClose(AuVFSNode* node, AuVFSNode* file);
 
+/*
+* AuVFSNodeSync -- writes out data of a file held back
+* by the file system, the whole file system when file
+* is null
+* @param node -- file system node to use
+* @param file -- file to sync, can be null
+*/
+AU_EXTERN AU_EXPORT int AuVFSNodeSync(AuVFSNode* node, AuVFSNode* file);
+
 /*
 * AuVFSGetBlockFor -- returns a block number for
 * certain byte offset of file
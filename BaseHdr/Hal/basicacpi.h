@@ -413,8 +413,32 @@ typedef struct _acpi_srat_mem_affinity_
 	uint32_t flags;
 	uint64_t reserved2;
 }AcpiSRATMemAffinity;
+
+typedef struct _acpi_srat_cpu_affinity_
+{
+	acpi_sub_table header;
+	uint8_t proximity_domain_lo;
+	uint8_t apic_id;
+	uint32_t flags;
+	uint8_t local_sapic_eid;
+	uint8_t proximity_domain_hi[3];
+	uint32_t clock_domain;
+}AcpiSRATCpuAffinity;
+
+typedef struct _acpi_srat_x2apic_affinity_
+{
+	acpi_sub_table header;
+	uint16_t reserved;
+	uint32_t proximity_domain;
+	uint32_t x2apic_id;
+	uint32_t flags;
+	uint32_t clock_domain;
+	uint32_t reserved2;
+}AcpiSRATX2ApicAffinity;
 #pragma pack(pop)
 
+#define ACPI_SRAT_ENABLED  (1<<0)
+
 #define APIC_TYPE_INTERRUPT_OVERRIDE 2
 
 /*
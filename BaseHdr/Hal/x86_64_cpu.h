@@ -162,6 +162,24 @@ extern void x86_64_hal_cpu_feature_enable();
 
 extern bool x86_64_is_cpu_fxsave_supported();
 
+/*
+* x86_64_is_cpu_pcid_supported -- checks if process
+* context identifiers are enabled
+*/
+extern bool x86_64_is_cpu_pcid_supported();
+
+/*
+* x86_64_is_cpu_invpcid_supported -- checks if single
+* pcid entries can be invalidated
+*/
+extern bool x86_64_is_cpu_invpcid_supported();
+
+/*
+* x86_64_is_cpu_pdpe1gb_supported -- checks if 1 GiB
+* pages can be used
+*/
+extern bool x86_64_is_cpu_pdpe1gb_supported();
+
 /*
 * x86_64_cpu_msi_address -- calculates the cpu msi address
 * @param data -- msi data to return
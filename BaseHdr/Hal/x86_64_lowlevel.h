@@ -79,6 +79,7 @@ extern "C" void x86_64_idt_test();
 
 //! TLB Flush
 extern "C" void flush_tlb(void* addr);
+extern "C" void x64_invpcid(size_t type, void* desc);
 extern "C" void cache_flush();
 
 extern "C" void x64_atom_exchange(size_t r1, size_t r2);
@@ -127,4 +128,6 @@ extern "C" void x64_ltr(uint16_t seg);
 extern "C" void x64_enter_user(uint64_t stack, uint64_t entry_addr, uint64_t cs, uint64_t ss);
 extern "C" void x64_force_sched();
 extern "C" bool x64_lock_test(volatile size_t *lock, size_t old_value, size_t new_value);
+extern "C" uint32_t x64_atomic_fetch_add(volatile uint32_t* value, uint32_t add);
+extern "C" uint64_t x64_read_rflags();
 #endif
\ No newline at end of file
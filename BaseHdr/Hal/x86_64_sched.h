@@ -39,6 +39,20 @@
 #define  THREAD_STATE_SLEEP     4
 #define  THREAD_STATE_KILLABLE  5
 
+//! Scheduler queues a thread can be linked on
+#define  THREAD_QUEUE_NONE     0
+#define  THREAD_QUEUE_READY    1
+#define  THREAD_QUEUE_BLOCKED  2
+#define  THREAD_QUEUE_SLEEP    3
+#define  THREAD_QUEUE_TRASH    4
+
+//! Thread priorities, the scheduler only picks threads
+//! from the highest priority that has ready threads
+#define  THREAD_PRIORITY_NORMAL    0
+#define  THREAD_PRIORITY_HIGH      1
+#define  THREAD_PRIORITY_REALTIME  2
+#define  THREAD_PRIORITY_LEVELS    3
+
 //! Thread levels =========================================================
 //! THREAD_LEVEL_KERNEL -- This bit is set when the thread given is kernel mode
 //! THREAD_LEVEL_USER -- This bit is set when the thread given is user mode
@@ -125,7 +139,9 @@ typedef struct _au_thread_ {
 	uint32_t mxcsr;
 	char name[16];
 	uint8_t state;
-	uint16_t id;
+	uint32_t id;
+	/* scheduler list the thread is linked on */
+	uint8_t queue;
 	uint64_t quanta;
 	uint64_t endTick;
 	uint8_t priviledge;
@@ -140,6 +156,16 @@ typedef struct _au_thread_ {
 	void* procSlot;
 	_au_thread_ *next;
 	_au_thread_ *prev;
+	/* effective priority, may be raised above
+	 * basePriority by priority inheritance */
+	uint8_t priority;
+	uint8_t basePriority;
+	/* set while the thread is running on a cpu */
+	volatile uint8_t onCpu;
+	/* mutex the thread is waiting for and list of
+	 * mutexes it owns, used for priority inheritance */
+	void* waitMutex;
+	void* heldMutex;
 }AuThread;
 #pragma pack(pop)
 
@@ -204,6 +230,13 @@ AU_EXTERN AU_EXPORT void AuSleepThread(AuThread *thread, uint64_t ms);
 */
 AU_EXTERN AU_EXPORT void AuUnblockThread(AuThread *t);
 
+/*
+* AuWakeThread -- make a blocked or sleeping thread
+* ready before its sleep time expires
+* @param t -- pointer to thread
+*/
+AU_EXTERN AU_EXPORT void AuWakeThread(AuThread* t);
+
 /*
 * AuThreadMoveToTrash -- move given thread to
 * trash
@@ -219,18 +252,34 @@ extern void AuThreadMoveToTrash(AuThread* t);
 extern void AuThreadCleanTrash(AuThread* t);
 
 /*
-* AuThreadFindByID -- finds a thread by its id from
-* ready queue
+* AuThreadFindByID -- finds a live thread by its id
 * @param id -- id of the thread
 */
-AU_EXTERN AU_EXPORT AuThread* AuThreadFindByID(uint16_t id);
+AU_EXTERN AU_EXPORT AuThread* AuThreadFindByID(uint32_t id);
 
 /*
 * AuThreadFindByIDBlockList -- finds a thread by its id from
 * the block queue
 * @param id -- id of the thread
 */
-AU_EXTERN AU_EXPORT AuThread* AuThreadFindByIDBlockList(uint16_t id);
+AU_EXTERN AU_EXPORT AuThread* AuThreadFindByIDBlockList(uint32_t id);
+
+/*
+* AuThreadSetPriority -- change effective priority of
+* a thread
+* @param t -- pointer to thread
+* @param priority -- new priority
+*/
+AU_EXTERN AU_EXPORT void AuThreadSetPriority(AuThread* t, uint8_t priority);
+
+/*
+* AuThreadSetBasePriority -- change base priority of
+* a thread, effective priority is never lowered below
+* an inherited one
+* @param t -- pointer to thread
+* @param priority -- new base priority
+*/
+AU_EXTERN AU_EXPORT void AuThreadSetBasePriority(AuThread* t, uint8_t priority);
 
 /*
 * AuForceScheduler -- force the scheduler
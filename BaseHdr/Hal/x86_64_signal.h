@@ -80,7 +80,7 @@ extern void AuPrepareSignal(AuThread* thr, interrupt_stack_frame* frame, Signal*
 * @param tid -- thread id
 * @param signo -- signal number
 */
-extern void AuSendSignal(uint16_t tid, int signo);
+extern void AuSendSignal(uint32_t tid, int signo);
 
 /*
 * AuSignalRemoveAll -- remove all signal forcefully
@@ -0,0 +1,81 @@
+/**
+* BSD 2-Clause License
+*
+* Copyright (c) 2022-2023, Manas Kamal Choudhury
+* All rights reserved.
+*
+* Redistribution and use in source and binary forms, with or without
+* modification, are permitted provided that the following conditions are met:
+*
+* 1. Redistributions of source code must retain the above copyright notice, this
+*    list of conditions and the following disclaimer.
+*
+* 2. Redistributions in binary form must reproduce the above copyright notice,
+*    this list of conditions and the following disclaimer in the documentation
+*    and/or other materials provided with the distribution.
+*
+* THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+* AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+* IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+* DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE
+* FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+* DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR
+* SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER
+* CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY,
+* OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+* OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+*
+**/
+
+#ifndef __CHANNEL_H__
+#define __CHANNEL_H__
+
+#include <stdint.h>
+#include <Hal\x86_64_sched.h>
+
+/* number of wait queue buckets, waiters are hashed
+ * by the physical address of the word they wait on */
+#define CHANNEL_WAIT_BUCKETS  64
+
+/*
+ * AuChannelWaiter -- a thread sleeping on a
+ * shared memory word
+ */
+typedef struct _channel_waiter_ {
+	uint64_t key;
+	AuThread* thread;
+	bool woken;
+	struct _channel_waiter_* next;
+}AuChannelWaiter;
+
+/*
+ * AuChannelInitialise -- initialise channel
+ * wait queues
+ */
+extern void AuChannelInitialise();
+
+/*
+ * AuChannelWait -- sleep until the word at given
+ * user address is woken, returns immediately if
+ * the word no longer holds the expected value
+ * @param addr -- user address of the word
+ * @param expected -- value the caller last observed
+ */
+extern int AuChannelWait(uint32_t* addr, uint32_t expected);
+
+/*
+ * AuChannelWake -- wake threads sleeping on the word
+ * at given user address
+ * @param addr -- user address of the word
+ * @param count -- maximum number of threads to wake
+ */
+extern int AuChannelWake(uint32_t* addr, int count);
+
+/*
+ * AuChannelRemoveThread -- drop a thread from channel
+ * wait queues
+ * @param thr -- Pointer to thread
+ */
+extern void AuChannelRemoveThread(AuThread* thr);
+
+#endif
@@ -39,18 +39,32 @@
 #define POSTBOX_GET_EVENT  404
 #define POSTBOX_CREATE_ROOT  405
 #define POSTBOX_GET_EVENT_ROOT  406
+#define POSTBOX_PUT_EVENTS  407
+#define POSTBOX_GET_EVENTS  408
+#define POSTBOX_GET_STATS  409
 
 #define POSTBOX_NO_EVENT  -1
 #define POSTBOX_ROOT_ID    1
 
+/* priority lanes, input lane is always drained first */
+#define POSTBOX_LANE_INPUT  0
+#define POSTBOX_LANE_NORMAL 1
+#define POSTBOX_LANES  2
+
+/* put flags */
+#define POSTBOX_FLAG_COALESCE  (1<<0)
+
+#define POSTBOX_HASH_SIZE  64
+#define POSTBOX_LANE_PAGES  2
+
 #pragma pack(push,1)
 /*
  * PostEvent -- event message structure
  */
 typedef struct _post_event_ {
 	uint8_t type;
-	uint16_t to_id;
-	uint16_t from_id;
+	uint32_t to_id;
+	uint32_t from_id;
 	uint32_t dword;
 	uint32_t dword2;
 	uint32_t dword3;
@@ -67,18 +81,62 @@ typedef struct _post_event_ {
 }PostEvent;
 #pragma pack(pop)
 
+/*
+ * PostBoxPutRequest -- batched put, all events go to the
+ * same lane, with POSTBOX_FLAG_COALESCE an event replaces
+ * the newest pending event of the same type, sender and
+ * target handle, which senders keep in dword4
+ */
 #pragma pack(push,1)
-typedef struct _postbox_ {
-	uint64_t* address;
-	uint16_t ownerID;
-	int headIdx;
-	int tailIdx;
-	bool full;
+typedef struct _postbox_put_req_ {
+	PostEvent* events;
+	uint32_t count;
+	uint8_t lane;
+	uint8_t flags;
+}PostBoxPutRequest;
+#pragma pack(pop)
+
+/*
+ * PostBoxGetRequest -- batched get
+ */
+#pragma pack(push,1)
+typedef struct _postbox_get_req_ {
+	PostEvent* events;
+	uint32_t count;
+	uint8_t root;
+}PostBoxGetRequest;
+#pragma pack(pop)
+
+/*
+ * PostBoxStats -- overflow accounting of a postbox
+ */
+#pragma pack(push,1)
+typedef struct _postbox_stats_ {
+	uint32_t posted;
+	uint32_t delivered;
+	uint32_t coalesced;
+	uint32_t dropped[POSTBOX_LANES];
+	uint32_t highWater[POSTBOX_LANES];
+}PostBoxStats;
+#pragma pack(pop)
+
+typedef struct _postbox_lane_ {
+	PostEvent* events;
+	uint16_t headIdx;
+	uint16_t tailIdx;
+	uint16_t count;
 	uint16_t size;
-	struct _postbox_ *next;
-	struct _postbox_* prev;
+	/* slot of the newest event if it may be superseded */
+	int lastCoalesce;
+}PostBoxLane;
+
+typedef struct _postbox_ {
+	uint32_t ownerID;
+	AuThread* owner;
+	PostBoxLane lanes[POSTBOX_LANES];
+	PostBoxStats stats;
+	struct _postbox_* hashNext;
 }PostBox;
-#pragma pack(pop)
 
 /*
 * AuIPCPostBoxInitialise -- initialise
@@ -92,6 +150,28 @@ extern void AuIPCPostBoxInitialise();
 */
 extern void PostBoxPutEvent(PostEvent* event);
 
+/*
+ * PostBoxPutEvents -- put a batch of events to post boxes,
+ * owners are woken once after the batch
+ * @param events -- array of events
+ * @param count -- number of events
+ * @param lane -- priority lane
+ * @param flags -- put flags
+ * @return number of events queued
+ */
+extern int PostBoxPutEvents(PostEvent* events, uint32_t count, uint8_t lane, uint8_t flags);
+
+/*
+ * PostBoxGetEvents -- get a batch of events, input lane
+ * first
+ * @param events -- array to fill
+ * @param count -- capacity of the array
+ * @param root -- is this post box is root
+ * @param curr_thread -- Pointer to current thread
+ * @return number of events copied
+ */
+extern int PostBoxGetEvents(PostEvent* events, uint32_t count, bool root, AuThread* curr_thread);
+
 /*
  * PostBoxGetEvent -- get an event from post box and copy it to a
  * memory area
@@ -104,16 +184,16 @@ extern int PostBoxGetEvent(PostEvent* event, bool root, AuThread* curr_thread);
 /*
 * PostBoxCreate -- creates a postbox
 * @param root -- is this post box root ?
-* @param tid -- thread id
+* @param owner -- thread owning the postbox
 */
-extern void PostBoxCreate(bool root, uint16_t tid);
+extern void PostBoxCreate(bool root, AuThread* owner);
 
 /*
 * PostBoxDestroyByID -- destroys a post box identified by
 * an id
 * @param id -- id of the postbox
 */
-extern void PostBoxDestroyByID(uint16_t id);
+extern void PostBoxDestroyByID(uint32_t id);
 
 
 #endif
\ No newline at end of file
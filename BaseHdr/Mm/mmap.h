@@ -70,4 +70,28 @@ extern void MemMapDirty(void* startingVaddr, size_t len, int flags, int prot);
 * @param len -- length of the mapping
 */
 extern void UnmapMemMapping(void* address, size_t len);
+
+/*
+* AuMemMapUnmap -- unmaps a memory mapping of given
+* process
+* @param proc -- Pointer to process
+* @param address -- address from where mapping starts
+* @param len -- length of the mapping
+*/
+extern void AuMemMapUnmap(AuProcess* proc, void* address, size_t len);
+
+/*
+* AuMemMapHandleFault -- resolves a page fault inside a
+* file backed mapping, returns true if it was handled
+* @param proc -- Pointer to process
+* @param vaddr -- faulting address
+* @param error -- page fault error code
+*/
+extern bool AuMemMapHandleFault(AuProcess* proc, uint64_t vaddr, uint64_t error);
+
+/*
+* AuMemMapRegisterShrinkers -- hands the mapping page
+* cache over to reclaim
+*/
+extern void AuMemMapRegisterShrinkers();
 #endif
\ No newline at end of file
@@ -32,6 +32,36 @@
 
 #include <aurora.h>
 
+#define PMM_ZONE_DMA32   0
+#define PMM_ZONE_NORMAL  1
+
+#define PMM_MAX_ZONES  16
+#define PMM_MAX_NODES  8
+
+/*
+* AuPmmZone -- a range of frames of one type on one
+* numa node, frame numbers are page indexes
+*/
+typedef struct _pmm_zone_ {
+	uint64_t start;
+	uint64_t end;
+	/* lowest frame that may be free */
+	uint64_t scan;
+	uint64_t freeFrames;
+	uint8_t node;
+	uint8_t type;
+}AuPmmZone;
+
+/*
+* AuPmmNodeRange -- memory range of a numa node as
+* reported by firmware
+*/
+typedef struct _pmm_node_range_ {
+	uint64_t start;
+	uint64_t end;
+	uint8_t node;
+}AuPmmNodeRange;
+
 /*
 * AuPmmngrInitialise -- initialise the physical memory
 * manager
@@ -47,17 +77,79 @@ AU_EXTERN AU_EXPORT void* AuPmmngrAlloc();
 
 /*
 * AuPmmngrAllocBlocks -- Allocate multiple physical page frames
-* and return the first page pointer to the caller
+* and return the first page pointer to the caller, null
+* when no contiguous run of that size is free
 * @param size -- Number of blocks to allocate
 */
 AU_EXTERN AU_EXPORT void* AuPmmngrAllocBlocks(int num);
 
+/*
+* AuPmmngrAllocContiguous -- allocates a run of physically
+* contiguous, aligned frames, returns null if none is free
+* @param num -- number of frames
+* @param align -- alignment in frames, power of two
+*/
+AU_EXTERN AU_EXPORT void* AuPmmngrAllocContiguous(size_t num, size_t align);
+
+/*
+* AuPmmngrAllocDMA32 -- allocates a run of physically
+* contiguous frames below 4GiB, returns null if none is
+* free
+* @param num -- number of frames
+* @param align -- alignment in frames, power of two
+*/
+AU_EXTERN AU_EXPORT void* AuPmmngrAllocDMA32(size_t num, size_t align);
+
 /*
 * AuPmmngrFree -- Free a physical page frame
 * @param Address -- Pointer to physical page
 */
 AU_EXTERN AU_EXPORT void AuPmmngrFree(void* Address);
 
+/*
+* AuPmmngrFreeCold -- Free a physical page frame whose
+* contents are not going to be reused soon, it is handed
+* out after recently freed frames
+* @param Address -- Pointer to physical page
+*/
+AU_EXTERN AU_EXPORT void AuPmmngrFreeCold(void* Address);
+
+/*
+* AuPmmngrCacheInitialise -- enable per cpu frame
+* caches, called once per cpu data is available
+*/
+extern void AuPmmngrCacheInitialise();
+
+/*
+* AuPmmngrAddNodeRange -- record a memory range of a
+* numa node, called while parsing SRAT
+* @param domain -- proximity domain
+* @param base -- physical base address
+* @param length -- length in bytes
+*/
+extern void AuPmmngrAddNodeRange(uint32_t domain, uint64_t base, uint64_t length);
+
+/*
+* AuPmmngrSetCPUNode -- record proximity domain of a
+* cpu, called while parsing SRAT
+* @param apicId -- local apic id of the cpu
+* @param domain -- proximity domain
+*/
+extern void AuPmmngrSetCPUNode(uint32_t apicId, uint32_t domain);
+
+/*
+* AuPmmngrBuildZones -- rebuild zones from the numa
+* ranges recorded so far
+*/
+extern void AuPmmngrBuildZones();
+
+/*
+* AuPmmngrGetZone -- returns a zone for inspection,
+* null past the last zone
+* @param num -- zone number
+*/
+extern AuPmmZone* AuPmmngrGetZone(int num);
+
 /*
 * AuPmmngrFreeBlocks -- Free multiple page frames
 * @param Addr -- Address of the first page frame
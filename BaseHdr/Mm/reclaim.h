@@ -0,0 +1,144 @@
+/**
+* BSD 2-Clause License
+*
+* Copyright (c) 2022-2023, Manas Kamal Choudhury
+* All rights reserved.
+*
+* Redistribution and use in source and binary forms, with or without
+* modification, are permitted provided that the following conditions are met:
+*
+* 1. Redistributions of source code must retain the above copyright notice, this
+*    list of conditions and the following disclaimer.
+*
+* 2. Redistributions in binary form must reproduce the above copyright notice,
+*    this list of conditions and the following disclaimer in the documentation
+*    and/or other materials provided with the distribution.
+*
+* THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+* AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+* IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+* DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE
+* FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+* DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR
+* SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER
+* CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY,
+* OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+* OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+*
+**/
+
+#ifndef __RECLAIM_H__
+#define __RECLAIM_H__
+
+#include <stdint.h>
+#include <aurora.h>
+
+/* compressed in-memory store for pages that have no
+ * backing file, comment out to leave such pages resident */
+#define MM_COMPRESSED_SWAP  1
+
+/* shrinker can run from inside a failing allocation,
+ * otherwise it only runs from the reclaim thread */
+#define SHRINKER_FLAG_DIRECT  (1<<0)
+
+/* pages a single call to the reclaim thread frees at
+ * most before checking watermarks again */
+#define RECLAIM_BATCH  32
+
+/*
+* AuShrinker -- a cache that can give memory back,
+* count returns the number of pages it could free and
+* scan tries to free up to nr of them, returning the
+* number actually freed
+*/
+typedef struct _au_shrinker_ {
+	const char* name;
+	size_t(*count)(struct _au_shrinker_* shrinker);
+	size_t(*scan)(struct _au_shrinker_* shrinker, size_t nr);
+	uint8_t flags;
+	void* data;
+	struct _au_shrinker_* next;
+}AuShrinker;
+
+/*
+* AuReclaimWatermarks -- free page thresholds, below low
+* the reclaim thread is woken until high is reached,
+* below min allocations reclaim directly and the
+* remaining frames are kept for reclaim itself
+*/
+typedef struct _reclaim_watermarks_ {
+	uint64_t min;
+	uint64_t low;
+	uint64_t high;
+}AuReclaimWatermarks;
+
+/*
+* AuRegisterShrinker -- registers a cache with reclaim
+* @param shrinker -- pointer to shrinker, must stay valid
+*/
+AU_EXTERN AU_EXPORT void AuRegisterShrinker(AuShrinker* shrinker);
+
+/*
+* AuUnregisterShrinker -- removes a cache from reclaim
+* @param shrinker -- pointer to shrinker
+*/
+AU_EXTERN AU_EXPORT void AuUnregisterShrinker(AuShrinker* shrinker);
+
+/*
+* AuReclaimInitialise -- computes watermarks and starts
+* the reclaim thread
+*/
+extern void AuReclaimInitialise();
+
+/*
+* AuReclaimGetWatermarks -- returns current watermarks
+*/
+extern AuReclaimWatermarks* AuReclaimGetWatermarks();
+
+/*
+* AuReclaimWake -- wakes the reclaim thread, safe to
+* call with any lock held
+*/
+extern void AuReclaimWake();
+
+/*
+* AuReclaimActive -- true while the current context is
+* reclaiming, allocations made from here may dip into
+* the reserve below min watermark
+*/
+extern bool AuReclaimActive();
+
+/*
+* AuReclaimPages -- runs shrinkers until nr pages were
+* freed or nothing more can be freed
+* @param nr -- number of pages wanted
+* @param direct -- called from a failing allocation
+* @return number of pages freed
+*/
+extern size_t AuReclaimPages(size_t nr, bool direct);
+
+#ifdef MM_COMPRESSED_SWAP
+/*
+* AuReclaimCompressPage -- stores a compressed copy of a
+* page, returns null if the page does not compress well
+* @param page -- virtual address of the page
+*/
+extern void* AuReclaimCompressPage(void* page);
+
+/*
+* AuReclaimDecompressPage -- restores a page and frees
+* the compressed copy
+* @param handle -- value returned by compress
+* @param page -- virtual address of destination page
+*/
+extern void AuReclaimDecompressPage(void* handle, void* page);
+
+/*
+* AuReclaimFreeCompressed -- frees a compressed copy
+* without restoring it
+* @param handle -- value returned by compress
+*/
+extern void AuReclaimFreeCompressed(void* handle);
+#endif
+
+#endif
\ No newline at end of file
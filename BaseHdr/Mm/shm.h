@@ -35,16 +35,36 @@
 
 #define USER_SHARED_MEM_START 0x0000000080000000
 
+/* frames in one 2 MiB large page */
+#define SHM_LARGE_PAGE_FRAMES 512
+
+/* segments created with this key have no name and are
+ * only reachable through their handle */
+#define SHM_KEY_ANONYMOUS  0
+/* handles carry this bit so that a handle and a key can
+ * be told apart, keys must stay below it */
+#define SHM_HANDLE_TAG  (1ULL<<62)
+#define SHM_HASH_BUCKETS  64
+
+/* round the segment up to whole large pages and back
+ * it by an aligned contiguous run */
+#define SHM_FLAG_LARGE_PAGES  (1<<0)
+
 #pragma pack(push,1)
 /*
- * AuSHM -- shared memory segment
+ * AuSHM -- shared memory segment, lives as long as
+ * something holds a reference to it, the creating
+ * process and every attached mapping hold one
  */
 typedef struct _shm_ {
-	uint16_t key;
-	uint16_t id;
+	uint64_t key;
+	uint64_t handle;
 	uint64_t num_frames;
 	uint64_t* frames;
-	uint16_t link_count;
+	uint32_t refs;
+	uint8_t flags;
+	struct _shm_* key_next;
+	struct _shm_* handle_next;
 }AuSHM;
 #pragma pack(pop)
 
@@ -62,37 +82,47 @@ typedef struct _shm_mapping_ {
 extern void AuInitialiseSHMMan();
 
 /*
-* AuGetSHMSeg -- searches and return a
-* shm segment by its key
-* @param key -- key to search
+* AuSHMGet -- looks up a segment by its key or handle
+* and takes a reference to it, which keeps the segment
+* alive until AuSHMPut
+* @param id -- key or handle
+*/
+extern AuSHM* AuSHMGet(uint64_t id);
+
+/*
+* AuSHMPut -- drops a reference taken by AuSHMGet
+* @param shm -- segment
 */
-extern AuSHM * AuGetSHMByID(uint16_t id);
+extern void AuSHMPut(AuSHM* shm);
 
 /*
-* AuCreateSHM -- create a new shared memory segment
+* AuCreateSHM -- create a new shared memory segment,
+* returns its handle or -1, the creating process holds
+* a reference until it detaches or exits
 * @param proc -- Creator process
-* @param key  --  unique key to use
+* @param key  --  unique key to use, SHM_KEY_ANONYMOUS
+* for a segment without name
 * @param sz   --  size in multiple of PAGE_SIZE
-* @param flags -- security flags
+* @param flags -- shm flags
 */
-extern int AuCreateSHM(AuProcess* proc, uint16_t key, size_t sz, uint8_t flags);
+extern int64_t AuCreateSHM(AuProcess* proc, uint64_t key, size_t sz, uint8_t flags);
 
 /*
 * AuSHMObtainMem -- obtains a virtual memory from given
 * shm segment
 * @param proc -- Calling process
-* @param id -- shm segment id
+* @param id -- key or handle of the segment
 * @param shmaddr -- starting shared memory address to map
 * @parma shmflg -- flags
 */
-extern void* AuSHMObtainMem(AuProcess* proc, uint16_t id, void* shmaddr, int shmflg);
+extern void* AuSHMObtainMem(AuProcess* proc, uint64_t id, void* shmaddr, int shmflg);
 
 /*
 * AuSHMUnmap -- unmaps a shared memory segment
-* @param key -- key to search
+* @param id -- key or handle of the segment
 * @param proc -- process to look
 */
-extern void AuSHMUnmap(uint16_t key, AuProcess* proc);
+extern void AuSHMUnmap(uint64_t id, AuProcess* proc);
 
 /*
 * AuSHMUnmapAll -- unmaps all mappings for this
@@ -0,0 +1,128 @@
+/**
+* BSD 2-Clause License
+*
+* Copyright (c) 2022-2023, Manas Kamal Choudhury
+* All rights reserved.
+*
+* Redistribution and use in source and binary forms, with or without
+* modification, are permitted provided that the following conditions are met:
+*
+* 1. Redistributions of source code must retain the above copyright notice, this
+*    list of conditions and the following disclaimer.
+*
+* 2. Redistributions in binary form must reproduce the above copyright notice,
+*    this list of conditions and the following disclaimer in the documentation
+*    and/or other materials provided with the distribution.
+*
+* THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+* AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+* IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+* DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE
+* FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+* DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR
+* SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER
+* CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY,
+* OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+* OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+*
+**/
+
+#ifndef __TLB_H__
+#define __TLB_H__
+
+#include <stdint.h>
+
+/* number of pages a batch carries before it is
+ * flushed, beyond this the whole address space
+ * is flushed instead of single pages */
+#define TLB_BATCH_MAX  32
+
+#define TLB_MAX_CPUS   8
+
+/* pcid 0 stays with untagged cr3 loads */
+#define TLB_PCID_SLOTS 64
+
+#define TLB_SHOOTDOWN_VECTOR 0xF0
+
+#define X86_64_CR3_NOFLUSH   (1ULL<<63)
+#define X86_64_CR3_ADDR_MASK 0x000FFFFFFFFFF000ULL
+
+#pragma pack(push,1)
+/*
+ * AuTLBBatch -- collects unmapped pages of one address
+ * space, frames are only released after every cpu has
+ * dropped its stale translations
+ */
+typedef struct _tlb_batch_ {
+	uint64_t cr3;
+	uint64_t addrs[TLB_BATCH_MAX];
+	uint64_t frames[TLB_BATCH_MAX];
+	int num_addrs;
+	int num_frames;
+	bool full;
+	bool kernel;
+}AuTLBBatch;
+#pragma pack(pop)
+
+/*
+ * AuTLBInitialise -- initialise tlb management of
+ * the boot processor
+ */
+extern void AuTLBInitialise();
+
+/*
+ * AuTLBRegisterCPU -- marks current processor as a target
+ * of shootdowns, a processor calls it once it runs threads
+ * with interrupts enabled
+ */
+extern void AuTLBRegisterCPU();
+
+/*
+ * AuTLBSwitchCR3 -- returns the cr3 value to load for
+ * an address space, tagged with its pcid
+ * @param cr3 -- physical address of the root table
+ */
+extern uint64_t AuTLBSwitchCR3(uint64_t cr3);
+
+/*
+ * AuTLBReleaseCR3 -- releases the pcid of an address
+ * space which is being destroyed
+ * @param cr3 -- physical address of the root table
+ */
+extern void AuTLBReleaseCR3(uint64_t cr3);
+
+/*
+ * AuTLBShootdown -- drops translations of given pages
+ * on every processor using the address space
+ * @param cr3 -- physical address of the root table
+ * @param addrs -- page addresses
+ * @param count -- number of addresses
+ * @param full -- flush the whole address space
+ * @param kernel -- addresses belong to kernel half
+ */
+extern void AuTLBShootdown(uint64_t cr3, uint64_t* addrs, int count, bool full, bool kernel);
+
+/*
+ * AuTLBBatchInit -- prepares an empty batch
+ * @param batch -- pointer to the batch
+ * @param cr3 -- physical address of the root table
+ */
+extern void AuTLBBatchInit(AuTLBBatch* batch, uint64_t cr3);
+
+/*
+ * AuTLBBatchAdd -- adds an unmapped page to a batch
+ * @param batch -- pointer to the batch
+ * @param vaddr -- unmapped virtual address, 0 if only
+ * a frame is released
+ * @param frame -- physical frame to release, 0 for none
+ */
+extern void AuTLBBatchAdd(AuTLBBatch* batch, uint64_t vaddr, uint64_t frame);
+
+/*
+ * AuTLBBatchFlush -- shoots down the batched pages and
+ * releases the batched frames
+ * @param batch -- pointer to the batch
+ */
+extern void AuTLBBatchFlush(AuTLBBatch* batch);
+
+#endif
@@ -49,9 +49,15 @@
 #define VM_TYPE_STACK    3
 #define VM_TYPE_HEAP     4
 #define VM_TYPE_RESOURCE 5
+#define VM_TYPE_MMAP     6
+#define VM_TYPE_SHM      7
+#define VM_TYPE_MAX      8
 
 
-/* AuVMArea -- virtual memory mapping area */
+/* AuVMArea -- virtual memory mapping area, areas of
+ * a process are kept in an AVL tree ordered by start
+ * address, every node also keeps the span and the
+ * largest free gap of its subtree */
 typedef struct _vm_area_ {
 	size_t start;
 	size_t end;
@@ -59,8 +65,37 @@ typedef struct _vm_area_ {
 	uint8_t prot_flags;
 	uint8_t type;
 	AuVFSNode* file;
+	/* file backed mappings, offset of start in the file
+	 * and the object caching its pages */
+	uint64_t file_offset;
+	struct _sh_memap_object_* mapobj;
+
+	/* tree linkage */
+	struct _vm_area_* left;
+	struct _vm_area_* right;
+	int height;
+	size_t sub_start;
+	size_t sub_end;
+	size_t max_gap;
 }AuVMArea;
 
+/* AuVMPin -- range of user memory the kernel is working
+ * on, unmapping any part of it is refused until the
+ * pin is dropped */
+typedef struct _vm_pin_ {
+	size_t start;
+	size_t end;
+	struct _vm_pin_* next;
+}AuVMPin;
+
+/* AuVMStats -- address space statistics of a process */
+typedef struct _vm_stats_ {
+	size_t num_areas;
+	size_t mapped_len;
+	size_t largest_gap;
+	size_t type_len[VM_TYPE_MAX];
+}AuVMStats;
+
 /*
 * AuInsertVMArea -- insert a memory segment to the given process
 * @param proc -- pointer to the process
@@ -95,4 +130,83 @@ extern AuVMArea* AuVMAreaCreate(size_t start, size_t end, uint8_t prot, size_t l
 */
 extern AuVMArea* AuVMAreaGet(AuProcess* proc, size_t address);
 
+/*
+* AuVMAreaFindFirst -- finds the lowest area overlapping
+* the given range
+* @param proc -- pointer to the process
+* @param start -- start of the range
+* @param end -- end of the range
+*/
+extern AuVMArea* AuVMAreaFindFirst(AuProcess* proc, size_t start, size_t end);
+
+/*
+* AuVMAreaFindGap -- finds the lowest free range of given
+* length inside [start, end)
+* @param proc -- pointer to the process
+* @param start -- start of the range
+* @param end -- end of the range
+* @param len -- length needed
+*/
+extern size_t AuVMAreaFindGap(AuProcess* proc, size_t start, size_t end, size_t len);
+
+/*
+* AuVMAreaMap -- records a new mapping, merging it with
+* neighbouring areas of same kind
+* @param proc -- pointer to the process
+* @param start -- starting address
+* @param len -- length of the mapping
+* @param prot -- protection flags
+* @param type -- type of the area
+* @param file -- backing file, if any
+*/
+extern AuVMArea* AuVMAreaMap(AuProcess* proc, size_t start, size_t len, uint8_t prot, uint8_t type,
+	AuVFSNode* file);
+
+/*
+* AuVMAreaUnmap -- removes a range from the address space,
+* areas partially covered are trimmed or split
+* @param proc -- pointer to the process
+* @param start -- starting address
+* @param len -- length of the range
+*/
+extern void AuVMAreaUnmap(AuProcess* proc, size_t start, size_t len);
+
+/*
+* AuVMAreaPin -- pins a range of user memory for the
+* duration of a kernel operation on it
+* @param proc -- pointer to the process
+* @param start -- starting address
+* @param len -- length of the range
+*/
+extern AuVMPin* AuVMAreaPin(AuProcess* proc, size_t start, size_t len);
+
+/*
+* AuVMAreaUnpin -- drops a pin taken by AuVMAreaPin
+* @param proc -- pointer to the process
+* @param pin -- pin to drop, can be null
+*/
+extern void AuVMAreaUnpin(AuProcess* proc, AuVMPin* pin);
+
+/*
+* AuVMAreaPinned -- checks if any part of a range is
+* pinned
+* @param proc -- pointer to the process
+* @param start -- starting address
+* @param len -- length of the range
+*/
+extern bool AuVMAreaPinned(AuProcess* proc, size_t start, size_t len);
+
+/*
+* AuVMAreaGetStats -- collects address space statistics
+* @param proc -- pointer to the process
+* @param stats -- pointer to statistics to fill
+*/
+extern void AuVMAreaGetStats(AuProcess* proc, AuVMStats* stats);
+
+/*
+* AuVMAreaDestroyAll -- frees every area of a process
+* @param proc -- pointer to the process
+*/
+extern void AuVMAreaDestroyAll(AuProcess* proc);
+
 #endif
\ No newline at end of file
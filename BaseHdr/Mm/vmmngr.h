@@ -47,6 +47,10 @@
 #define X86_64_PAGING_NO_EXECUTE 0x80000
 #define X86_64_PAGING_NO_CACHING 0x200000
 #define X86_64_PAGING_WRITE_THROUGH 0x400000
+#define X86_64_PAGING_HUGE 0x80
+#define X86_64_PAGING_ADDR_MASK 0x000FFFFFFFFFF000ULL
+#define X86_64_LARGE_PAGE_SIZE 0x200000ULL
+#define X86_64_HUGE_PAGE_SIZE 0x40000000ULL
 #else
 #define PTE_VALID (1ULL << 0)
 #define PTE_TABLE (1ULL << 1)
@@ -74,6 +78,9 @@
 #define VIRT_GETPAGE_CREATE (1<<0)
 #define VIRT_GETPAGE_ONLY_RET (1<<1)
 
+/* AuVmmngrUnmapRange flags */
+#define VMMNGR_UNMAP_FREE_PHYSICAL (1<<0)
+
 #define KERNEL_BASE_ADDRESS  0xFFFFE00000000000
 #define USER_BASE_ADDRESS 0x0000000060000000   //0x0000400000000000
 #define USER_END_ADDRESS  0x0000000080000000
@@ -173,6 +180,45 @@ AU_EXTERN AU_EXPORT uint64_t* AuGetFreePage(bool user, void* ptr);
 */
 AU_EXTERN AU_EXPORT void AuFreePages(uint64_t virt_addr, bool free_physical, size_t s);
 
+/*
+* AuVmmngrUnmapRange -- unmaps a range of pages, freeing
+* emptied user paging tables and shooting down stale
+* tlb entries in batches
+* @param pml4 -- virtual address of the root table
+* @param start -- page aligned starting address
+* @param len -- length in bytes
+* @param flags -- VMMNGR_UNMAP_* flags
+*/
+AU_EXTERN AU_EXPORT size_t AuVmmngrUnmapRange(uint64_t* pml4, uint64_t start, size_t len, uint8_t flags);
+
+/*
+* AuVmmngrMapRange -- maps a physically contiguous range,
+* using 1 GiB and 2 MiB pages wherever alignment permits
+* @param pml4 -- virtual address of the root table
+* @param phys_addr -- physical start address
+* @param virt_addr -- virtual start address
+* @param len -- length in bytes
+* @param attrib -- page attributes
+*/
+AU_EXTERN AU_EXPORT bool AuVmmngrMapRange(uint64_t* pml4, uint64_t phys_addr, uint64_t virt_addr, size_t len, uint8_t attrib);
+
+/*
+* AuVmmngrPromoteRange -- merges 2 MiB windows of a range
+* that map aligned, contiguous frames into large pages
+* @param pml4 -- virtual address of the root table
+* @param start -- starting address
+* @param len -- length in bytes
+*/
+AU_EXTERN AU_EXPORT size_t AuVmmngrPromoteRange(uint64_t* pml4, uint64_t start, size_t len);
+
+/*
+* AuVmmngrGetEntry -- returns the page table entry of an
+* address without creating missing tables
+* @param pml4 -- virtual address of the root table
+* @param virt_addr -- virtual address
+*/
+AU_EXTERN AU_EXPORT AuVPage* AuVmmngrGetEntry(uint64_t* pml4, uint64_t virt_addr);
+
 /*
  * AuFreePages -- frees up contiguous pages
  * @param virt_addr -- starting virtual address
@@ -195,6 +241,16 @@ AU_EXTERN AU_EXPORT void* AuGetPhysicalAddress(uint64_t virt_addr);
 */
 AU_EXTERN AU_EXPORT void* AuGetPhysicalAddressEx(uint64_t* cr3, uint64_t virt_addr);
 
+/*
+ * AuVmmngrGetPhysicalRun -- returns the physical address
+ * backing a virtual address together with the number of
+ * physically contiguous bytes from there on
+ * @param virt_addr -- virtual address
+ * @param max_len -- maximum length of interest
+ * @param run_len -- pointer receiving the contiguous length
+ */
+AU_EXTERN AU_EXPORT uint64_t AuVmmngrGetPhysicalRun(uint64_t virt_addr, size_t max_len, size_t* run_len);
+
 /*
 * AuCreateVirtualAddressSpace -- creates a new virtual address
 * space and return the new address space in a linear virtual
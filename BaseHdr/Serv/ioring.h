@@ -0,0 +1,147 @@
+/**
+* BSD 2-Clause License
+*
+* Copyright (c) 2022-2023, Manas Kamal Choudhury
+* All rights reserved.
+*
+* Redistribution and use in source and binary forms, with or without
+* modification, are permitted provided that the following conditions are met:
+*
+* 1. Redistributions of source code must retain the above copyright notice, this
+*    list of conditions and the following disclaimer.
+*
+* 2. Redistributions in binary form must reproduce the above copyright notice,
+*    this list of conditions and the following disclaimer in the documentation
+*    and/or other materials provided with the distribution.
+*
+* THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+* AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+* IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+* DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE
+* FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+* DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR
+* SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER
+* CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY,
+* OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+* OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+*
+**/
+
+#ifndef __IORING_H__
+#define __IORING_H__
+
+#include <stdint.h>
+#include <process.h>
+#include <Sync\spinlock.h>
+
+/* submission opcodes */
+#define IORING_OP_NOP     0
+#define IORING_OP_READ    1
+#define IORING_OP_WRITE   2
+#define IORING_OP_READV   3
+#define IORING_OP_WRITEV  4
+#define IORING_OP_FSYNC   5
+#define IORING_OP_CLOSE   6
+#define IORING_OP_IOCTL   7
+#define IORING_OP_SEND    8
+#define IORING_OP_RECV    9
+#define IORING_OP_SHM_OBTAIN  10
+#define IORING_OP_SHM_UNMAP   11
+
+/* submission flags */
+#define IORING_SQE_ASYNC  (1<<0)
+
+/* read/write at current file offset */
+#define IORING_OFFSET_CURRENT  ((uint64_t)-1)
+
+#define IORING_MAX_ENTRIES  4096
+
+#pragma pack(push,1)
+/*
+ * AuIORingSQE -- submission queue entry, for pipes
+ * READ/WRITE are used as for files
+ */
+typedef struct _au_ioring_sqe_ {
+	uint8_t opcode;
+	uint8_t flags;
+	uint16_t rsvd;
+	int32_t fd;
+	uint64_t addr;
+	uint64_t len;
+	uint64_t offset;
+	uint64_t userData;
+}AuIORingSQE;
+
+/*
+ * AuIORingCQE -- completion queue entry
+ */
+typedef struct _au_ioring_cqe_ {
+	uint64_t userData;
+	int64_t result;
+}AuIORingCQE;
+
+/*
+ * AuIORingHdr -- header of the ring memory shared with
+ * the process, followed by sq entries and then cq
+ * entries (twice the sq entries)
+ */
+typedef struct _au_ioring_hdr_ {
+	uint32_t entries;
+	/* consumed by kernel, produced by process */
+	uint32_t sqHead;
+	uint32_t sqTail;
+	/* consumed by process, produced by kernel */
+	uint32_t cqHead;
+	uint32_t cqTail;
+	uint32_t rsvd[11];
+}AuIORingHdr;
+#pragma pack(pop)
+
+/*
+ * AuIORing -- kernel side state of a process's ring
+ */
+typedef struct _au_ioring_ {
+	volatile AuIORingHdr* hdr;
+	AuIORingSQE* sqes;
+	AuIORingCQE* cqes;
+	uint32_t sqMask;
+	uint32_t cqMask;
+	uint32_t inflight;
+	Spinlock* lock;
+	/* ring memory can not be unmapped while registered */
+	struct _vm_pin_* pin;
+	/* operations handed to the worker */
+	AuIORingSQE* pending;
+	uint32_t pendingHead;
+	uint32_t pendingCount;
+	AuThread* worker;
+	bool workerIdle;
+	/* submitter sleeping for completions */
+	AuThread* waiter;
+	uint32_t waitFor;
+}AuIORing;
+
+/*
+ * IORingSetup -- register ring memory of current
+ * process
+ * @param mem -- page aligned ring memory
+ * @param entries -- number of sq entries, power of two
+ */
+extern int IORingSetup(void* mem, uint32_t entries);
+
+/*
+ * IORingEnter -- consume submissions and optionally
+ * wait for completions
+ * @param toSubmit -- maximum submissions to consume
+ * @param minComplete -- completions to wait for
+ */
+extern int IORingEnter(uint32_t toSubmit, uint32_t minComplete);
+
+/*
+ * AuIORingDestroy -- release ring state of a
+ * process
+ * @param proc -- Pointer to process
+ */
+extern void AuIORingDestroy(AuProcess* proc);
+
+#endif
@@ -37,9 +37,10 @@
 #include <Hal\x86_64_signal.h>
 #endif
 #include <Net\socket.h>
+#include <Fs\vfs.h>
 
 /* maximum supported system calls */
-#define AURORA_MAX_SYSCALL  58
+#define AURORA_MAX_SYSCALL  75
 #define AURORA_SYSCALL_MAGIC  0x15062023 
 
 /* ==========================================
@@ -57,7 +58,7 @@ extern int PauseThread();
 /*
 * GetThreadID -- returns currently running thread id
 */
-extern uint16_t GetThreadID();
+extern uint32_t GetThreadID();
 #elif ARCH_ARM64
 extern uint64_t GetThreadID();
 #endif
@@ -114,26 +115,27 @@ extern void SignalReturn(int num);
 extern int SetSignal(int signo, AuSigHandler handler);
 #endif
 /*
-* CreateSharedMem -- create a shared memory chunk
-* @param key -- key to use
+* CreateSharedMem -- create a shared memory chunk,
+* returns its handle
+* @param key -- key to use, 0 for an anonymous segment
 * @param sz -- memory size
 * @param flags -- shared memory flags
 */
-extern int CreateSharedMem(uint16_t key, size_t sz, uint8_t flags);
+extern int64_t CreateSharedMem(uint64_t key, size_t sz, uint8_t flags);
 
 /*
 * ObtainSharedMem -- obtain a shared memory
-* @param id -- segment id
+* @param id -- segment handle or key
 * @param shmaddr -- user specified address
 * @param shmflg -- flags to use for protection
 */
-extern void* ObtainSharedMem(uint16_t id, void* shmaddr, int shmflg);
+extern void* ObtainSharedMem(uint64_t id, void* shmaddr, int shmflg);
 
 /*
 * UnmapSharedMem -- unmap shared memory segment
-* @param key -- key to search
+* @param key -- key or handle to search
 */
-extern void UnmapSharedMem(uint16_t key);
+extern void UnmapSharedMem(uint64_t key);
 
 /*
 * GetProcessHeapMem -- get a memory from
@@ -282,6 +284,48 @@ extern int StopTimer(int threadID);
 */
 extern int DestroyTimer(int threadID);
 
+/*
+* HRTimerCreate -- create a high resolution timer
+* owned by current thread
+* @param flags -- HRTIMER_FLAG_* bits
+*/
+extern int HRTimerCreate(uint8_t flags);
+
+/*
+* HRTimerArm -- arm a high resolution timer
+* @param id -- timer id
+* @param initial -- first expiry in nanoseconds
+* @param period -- interval in nanoseconds, 0 for
+* one-shot
+* @param flags -- HRTIMER_ARM_* bits
+*/
+extern int HRTimerArm(int id, uint64_t initial, uint64_t period, uint8_t flags);
+
+/*
+* HRTimerDisarm -- stop a high resolution timer
+* @param id -- timer id
+*/
+extern int HRTimerDisarm(int id);
+
+/*
+* HRTimerWait -- wait for a high resolution timer
+* to expire
+* @param id -- timer id
+*/
+extern int64_t HRTimerWait(int id);
+
+/*
+* HRTimerClose -- destroy a high resolution timer
+* @param id -- timer id
+*/
+extern int HRTimerClose(int id);
+
+/*
+* GetMonotonicClock -- returns nanoseconds of the
+* monotonic clock
+*/
+extern uint64_t GetMonotonicClock();
+
 /*
 * ProcessGetFileDesc -- Searches all process file
 * descriptor entries for
@@ -295,7 +339,61 @@ extern int ProcessGetFileDesc(const char* filename);
 * @param fd -- File descriptor
 * @param offset -- offset in bytes
 */
-extern int FileSetOffset(int fd, size_t offset);
+extern int FileSetOffset(int fd, uint64_t offset);
+
+/*
+* ReadFileAt -- reads a file from given byte offset
+* without using or updating the file position
+* @param fd -- file descriptor
+* @param buffer -- buffer where to put the data
+* @param length -- length in bytes
+* @param offset -- offset in bytes to read from
+*/
+extern size_t ReadFileAt(int fd, void* buffer, size_t length, uint64_t offset);
+
+/*
+* WriteFileAt -- writes to a file at given byte offset
+* without using or updating the file position
+* @param fd -- file descriptor
+* @param buffer -- buffer to write
+* @param length -- length in bytes
+* @param offset -- offset in bytes to write at
+*/
+extern size_t WriteFileAt(int fd, void* buffer, size_t length, uint64_t offset);
+
+/*
+* ReadFileV -- reads a file into multiple buffers
+* in one call
+* @param fd -- file descriptor
+* @param iov -- array of buffer segments
+* @param iovcnt -- number of segments
+*/
+extern size_t ReadFileV(int fd, AuIOVec* iov, int iovcnt);
+
+/*
+* WriteFileV -- writes multiple buffers to a file
+* in one call
+* @param fd -- file descriptor
+* @param iov -- array of buffer segments
+* @param iovcnt -- number of segments
+*/
+extern size_t WriteFileV(int fd, AuIOVec* iov, int iovcnt);
+
+/*
+* FileSync -- writes out data of a file held
+* back by its file system
+* @param fd -- file descriptor
+*/
+extern int FileSync(int fd);
+
+/*
+* FileDup -- duplicates a file descriptor, both
+* descriptors share the file and its offset
+* @param fd -- file descriptor to duplicate
+* @param newfd -- target descriptor, -1 for the
+* lowest free one
+*/
+extern int FileDup(int fd, int newfd);
 
 /*
 * GetTimeOfDay -- returns the time format 
@@ -32,14 +32,14 @@
 #define __AU_SOUND_H__
 
 #include <stdint.h>
-#include <circbuf.h>
+#include <ringbuf.h>
 #include <Hal\x86_64_sched.h>
 #include <aurora.h>
 
 #pragma pack(push,1)
 typedef struct __au_dsp__ {
-	CircBuffer *buffer;
-	uint16_t _dsp_id;
+	AuRingBuffer *buffer;
+	uint32_t _dsp_id;
 	AuThread *SndThread;
 	uint64_t sleep_time;
 	bool available;
@@ -81,7 +81,7 @@ AU_EXTERN AU_EXPORT void AuSoundGetBlock(uint64_t *buffer);
 * AuSoundRemoveDSP -- remove the dsp from
 * dsp list
 */
-AU_EXTERN AU_EXPORT void AuSoundRemoveDSP(uint16_t id);
+AU_EXTERN AU_EXPORT void AuSoundRemoveDSP(uint32_t id);
 
 /*
 * AuSoundStart -- Starts the Sound card
@@ -0,0 +1,86 @@
+/**
+* BSD 2-Clause License
+*
+* Copyright (c) 2022-2023, Manas Kamal Choudhury
+* All rights reserved.
+*
+* Redistribution and use in source and binary forms, with or without
+* modification, are permitted provided that the following conditions are met:
+*
+* 1. Redistributions of source code must retain the above copyright notice, this
+*    list of conditions and the following disclaimer.
+*
+* 2. Redistributions in binary form must reproduce the above copyright notice,
+*    this list of conditions and the following disclaimer in the documentation
+*    and/or other materials provided with the distribution.
+*
+* THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+* AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+* IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+* DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE
+* FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+* DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR
+* SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER
+* CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY,
+* OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+* OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+*
+**/
+
+#ifndef __FUTEX_H__
+#define __FUTEX_H__
+
+#include <stdint.h>
+#include <Hal\x86_64_sched.h>
+
+/* futex operations */
+#define FUTEX_WAIT  0
+#define FUTEX_WAKE  1
+#define FUTEX_CMP_REQUEUE  2
+
+/* futex return codes */
+#define FUTEX_ERROR     -1
+#define FUTEX_TIMEDOUT  -2
+#define FUTEX_AGAIN     -3
+
+#define FUTEX_HASH_SIZE  256
+
+/*
+ * AuFutexWaiter -- a thread sleeping on a futex,
+ * keyed by address space and user address
+ */
+typedef struct _futex_waiter_ {
+	uint64_t space;
+	uint64_t addr;
+	AuThread* thread;
+	bool woken;
+	struct _futex_waiter_* next;
+}AuFutexWaiter;
+
+/*
+ * AuFutexInitialise -- initialise futex
+ * wait queues
+ */
+extern void AuFutexInitialise();
+
+/*
+ * Futex -- futex system call
+ * @param addr -- user address of the futex word
+ * @param op -- FUTEX_WAIT, FUTEX_WAKE or FUTEX_CMP_REQUEUE
+ * @param val -- expected value for wait, wake count for
+ * wake and requeue
+ * @param val2 -- timeout in ms for wait (0 waits forever),
+ * requeue count for requeue
+ * @param addr2 -- target futex for requeue
+ * @param val3 -- expected value of futex for requeue
+ */
+extern int64_t Futex(uint32_t* addr, int op, uint32_t val, uint64_t val2, uint32_t* addr2, uint32_t val3);
+
+/*
+ * AuFutexRemoveThread -- drop a thread from futex
+ * wait queues
+ * @param thr -- Pointer to thread
+ */
+extern void AuFutexRemoveThread(AuThread* thr);
+
+#endif
@@ -36,14 +36,35 @@
 #include <aurora.h>
 #include <list.h>
 
-#pragma pack(push,1)
+#define MUTEX_WAITER_WRITER  0
+#define MUTEX_WAITER_READER  1
+
+/* number of pause loops an acquirer spins while the
+ * owner is running on another cpu, before blocking */
+#define MUTEX_SPIN_LIMIT  1024
+
+/*
+ * AuMutexWaiter -- a blocked thread, lives on the
+ * waiting thread's kernel stack and is linked in
+ * FIFO order
+ */
+typedef struct _mutex_waiter_ {
+	AuThread* thread;
+	uint8_t type;
+	volatile uint8_t granted;
+	struct _mutex_waiter_* next;
+}AuMutexWaiter;
+
 typedef struct _mutex_ {
 	Spinlock* lock;
-	volatile uint8_t status;
-	AuThread *owner;
-	list_t* waiters;
+	AuThread * volatile owner;
+	AuMutexWaiter* head;
+	AuMutexWaiter* tail;
+	/* highest priority among waiters */
+	uint8_t ceiling;
+	/* next mutex held by the same owner */
+	struct _mutex_* heldNext;
 }AuMutex;
-#pragma pack(pop)
 
 /*
 * AuCreateMutex -- create a new mutex and return
@@ -56,6 +77,14 @@ AU_EXTERN AU_EXPORT AuMutex* AuCreateMutex();
 */
 AU_EXTERN AU_EXPORT int AuAcquireMutex(AuMutex* mut);
 
+/*
+* AuTryAcquireMutex -- acquire a mutex only if it is
+* free
+* @param mut -- Pointer to mutex
+* @return true if mutex was taken
+*/
+AU_EXTERN AU_EXPORT bool AuTryAcquireMutex(AuMutex* mut);
+
 /*
 * AuReleaseMutex -- release a mutex
 * @param pointer to mutex
@@ -68,4 +97,11 @@ AU_EXTERN AU_EXPORT int AuReleaseMutex(AuMutex *mutex);
 */
 AU_EXTERN AU_EXPORT void AuDeleteMutex(AuMutex *mutex);
 
+/*
+* AuMutexRemoveThread -- drop a dying thread from mutex
+* wait queues and pass on the mutexes it owns
+* @param thr -- Pointer to thread
+*/
+extern void AuMutexRemoveThread(AuThread* thr);
+
 #endif
\ No newline at end of file
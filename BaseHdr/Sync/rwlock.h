@@ -0,0 +1,88 @@
+/**
+* BSD 2-Clause License
+*
+* Copyright (c) 2022-2023, Manas Kamal Choudhury
+* All rights reserved.
+*
+* Redistribution and use in source and binary forms, with or without
+* modification, are permitted provided that the following conditions are met:
+*
+* 1. Redistributions of source code must retain the above copyright notice, this
+*    list of conditions and the following disclaimer.
+*
+* 2. Redistributions in binary form must reproduce the above copyright notice,
+*    this list of conditions and the following disclaimer in the documentation
+*    and/or other materials provided with the distribution.
+*
+* THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+* AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+* IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+* DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE
+* FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+* DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR
+* SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER
+* CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY,
+* OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+* OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+*
+**/
+
+#ifndef __RWLOCK_H__
+#define __RWLOCK_H__
+
+#include <Sync/spinlock.h>
+#include <Sync/mutex.h>
+#include <stdint.h>
+#include <Hal/x86_64_sched.h>
+#include <aurora.h>
+
+/*
+ * AuRWLock -- sleeping reader/writer lock, waiters are
+ * served in FIFO order so that a stream of readers
+ * cannot starve a writer
+ */
+typedef struct _rwlock_ {
+	Spinlock* lock;
+	AuThread* writer;
+	uint32_t readers;
+	AuMutexWaiter* head;
+	AuMutexWaiter* tail;
+}AuRWLock;
+
+/*
+* AuCreateRWLock -- create a new reader/writer lock
+*/
+AU_EXTERN AU_EXPORT AuRWLock* AuCreateRWLock();
+
+/*
+* AuAcquireReadLock -- acquire a lock for shared access
+* @param rw -- Pointer to rwlock
+*/
+AU_EXTERN AU_EXPORT void AuAcquireReadLock(AuRWLock* rw);
+
+/*
+* AuReleaseReadLock -- release a shared access
+* @param rw -- Pointer to rwlock
+*/
+AU_EXTERN AU_EXPORT void AuReleaseReadLock(AuRWLock* rw);
+
+/*
+* AuAcquireWriteLock -- acquire a lock for exclusive
+* access
+* @param rw -- Pointer to rwlock
+*/
+AU_EXTERN AU_EXPORT void AuAcquireWriteLock(AuRWLock* rw);
+
+/*
+* AuReleaseWriteLock -- release exclusive access
+* @param rw -- Pointer to rwlock
+*/
+AU_EXTERN AU_EXPORT void AuReleaseWriteLock(AuRWLock* rw);
+
+/*
+* AuDeleteRWLock -- free up a reader/writer lock
+* @param rw -- Pointer to rwlock
+*/
+AU_EXTERN AU_EXPORT void AuDeleteRWLock(AuRWLock* rw);
+
+#endif
\ No newline at end of file
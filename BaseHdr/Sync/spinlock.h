@@ -33,11 +33,36 @@
 #include <stdint.h>
 #include <aurora.h>
 
-#pragma pack(push,1)
+#define SPINLOCK_EARLY_POOL  32
+
+/*
+ * SpinlockStats -- contention and hold time counters,
+ * times are in tsc cycles
+ */
+typedef struct _spinlock_stats_ {
+	uint64_t acquisitions;
+	uint64_t contended;
+	uint64_t spinCycles;
+	uint64_t maxSpinCycles;
+	uint64_t holdCycles;
+	uint64_t maxHoldCycles;
+}SpinlockStats;
+
+/*
+ * Spinlock -- fair ticket lock, waiters are served in
+ * the order they arrived and only read the lock word
+ * while spinning
+ */
 typedef struct _spinlock_ {
-	size_t value;
+	volatile uint32_t next;   /* next ticket to hand out */
+	volatile uint32_t owner;  /* ticket being served */
+	uint8_t holderCpu;
+	void* holderIp;
+	uint64_t acquiredAt;
+	const char* name;
+	SpinlockStats stats;
+	struct _spinlock_* statNext;
 }Spinlock;
-#pragma pack(pop)
 
 /*
 * AuCreateSpinlock -- creates a new spinlock and return
@@ -45,6 +70,13 @@ typedef struct _spinlock_ {
 */
 AU_EXTERN AU_EXPORT Spinlock* AuCreateSpinlock(bool early);
 
+/*
+* AuInitialiseSpinlock -- initialise a statically
+* allocated or embedded spinlock
+* @param lock -- pointer to spinlock
+*/
+AU_EXTERN AU_EXPORT void AuInitialiseSpinlock(Spinlock* lock);
+
 /*
 * AuDeleteSpinlock -- deletes only non-early spinlocks
 */
@@ -63,4 +95,50 @@ AU_EXTERN AU_EXPORT void AuAcquireSpinlock(Spinlock* lock);
 */
 AU_EXTERN AU_EXPORT void AuReleaseSpinlock(Spinlock* lock);
 
+/*
+* AuTryAcquireSpinlock -- acquire a lock only if it
+* is free
+* @param lock -- pointer to spinlock
+* @return true if lock was taken
+*/
+AU_EXTERN AU_EXPORT bool AuTryAcquireSpinlock(Spinlock* lock);
+
+/*
+* AuAcquireSpinlockIrqSave -- disable interrupts and
+* acquire a lock, for locks also taken by interrupt
+* handlers
+* @param lock -- pointer to spinlock
+* @return interrupt state to pass to release
+*/
+AU_EXTERN AU_EXPORT uint64_t AuAcquireSpinlockIrqSave(Spinlock* lock);
+
+/*
+* AuReleaseSpinlockIrqRestore -- release a lock and
+* restore interrupt state saved by acquire
+* @param lock -- pointer to spinlock
+* @param flags -- saved interrupt state
+*/
+AU_EXTERN AU_EXPORT void AuReleaseSpinlockIrqRestore(Spinlock* lock, uint64_t flags);
+
+/*
+* AuSpinlockIsHeld -- checks if a lock is currently
+* held by anyone
+* @param lock -- pointer to spinlock
+*/
+AU_EXTERN AU_EXPORT bool AuSpinlockIsHeld(Spinlock* lock);
+
+/*
+* AuSpinlockSetName -- names a lock and makes its
+* statistics visible through /dev/lockstat
+* @param lock -- pointer to spinlock
+* @param name -- name of the lock, must stay valid
+*/
+AU_EXTERN AU_EXPORT void AuSpinlockSetName(Spinlock* lock, const char* name);
+
+/*
+* AuSpinlockStatInitialise -- creates /dev/lockstat
+* and enables lock holder tracking
+*/
+extern void AuSpinlockStatInitialise();
+
 #endif
\ No newline at end of file
@@ -31,6 +31,7 @@
 #define __AU_TIMER_H__
 
 #include <stdint.h>
+#include <Hal\x86_64_sched.h>
 
 #define TIMER_UPDATE_ORDER_SECOND 1
 #define TIMER_UPDATE_ORDER_MINUTE 2
@@ -38,6 +39,7 @@
 #define TIMER_UPDATE_ORDER_INTERVAL 4
 
 #define TIMER_MESSAGE_CODE 8
+#define HRTIMER_MESSAGE_CODE 9
 
 #define MAX_TICK_DEFAULT UINT32_MAX
 
@@ -45,7 +47,7 @@
 typedef struct _timer_ {
 	int lastTick;
 	uint8_t updateOrder;
-	uint16_t threadId; //registered thread id
+	uint32_t threadId; //registered thread id
 	int tickDifference;
 	int maxTick;
 	bool run;
@@ -54,6 +56,32 @@ typedef struct _timer_ {
 }AuTimer;
 #pragma pack(pop)
 
+/* high resolution timer flags, given at creation */
+#define HRTIMER_FLAG_POSTBOX  (1<<0)
+
+/* arm flags */
+#define HRTIMER_ARM_ABSOLUTE  (1<<0)
+
+#define HRTIMER_HASH_SIZE  64
+#define HRTIMER_HEAP_INITIAL  32
+
+/*
+ * AuHRTimer -- one-shot or periodic timer with a deadline
+ * in nanoseconds of the monotonic clock, a thread may own
+ * any number of them
+ */
+typedef struct _hrtimer_ {
+	int id;
+	uint32_t threadId;
+	uint8_t flags;
+	uint64_t deadline;
+	uint64_t period;
+	uint64_t expirations;
+	int heapIdx;
+	AuThread* waiter;
+	struct _hrtimer_* hashNext;
+}AuHRTimer;
+
 /*
 * AuTimerDataInitialise -- initialise timer
 * data's to default value
@@ -63,26 +91,26 @@ extern void AuTimerDataInitialise();
 /*
 * AuTimerCreate -- create a new timer and immediately it will start
 */
-extern void AuTimerCreate(uint16_t thread_id, int maxTickLimit, uint8_t updateOrder);
+extern void AuTimerCreate(uint32_t thread_id, int maxTickLimit, uint8_t updateOrder);
 
 /*
 *AuTimerStart -- starts the timer
 * @param threadId -- timer's thread id
 */
-extern void AuTimerStart(uint16_t threadId);
+extern void AuTimerStart(uint32_t threadId);
 
 /*
 * AuTimerStop -- stop the timer
 * @param threadId -- timer's thread id
 */
-extern void AuTimerStop(uint16_t threadId);
+extern void AuTimerStop(uint32_t threadId);
 
 /*
 *AuTimerDestroy -- destroys a timer associated
 * with given thread id
 * @param threadId -- thread's id
 */
-extern void AuTimerDestroy(uint16_t threadID);
+extern void AuTimerDestroy(uint32_t threadID);
 /*
 * AuTimerFire-- called by RTC clock interrupt handler
 * @param sec -- second
@@ -91,5 +119,69 @@ extern void AuTimerDestroy(uint16_t threadID);
 */
 extern void AuTimerFire(int sec, int min, int hour);
 
+/*
+ * AuTimerGetNanoseconds -- returns nanoseconds of the
+ * monotonic clock, counted from tsc
+ */
+extern uint64_t AuTimerGetNanoseconds();
+
+/*
+ * AuHRTimerCreate -- creates a disarmed high resolution
+ * timer owned by a thread
+ * @param threadId -- owner thread id
+ * @param flags -- HRTIMER_FLAG_* bits
+ * @return timer id, -1 on failure
+ */
+extern int AuHRTimerCreate(uint32_t threadId, uint8_t flags);
+
+/*
+ * AuHRTimerArm -- arm or re-arm a timer
+ * @param threadId -- caller thread id
+ * @param id -- timer id
+ * @param initial -- first expiry in nanoseconds, relative
+ * to now unless HRTIMER_ARM_ABSOLUTE is given
+ * @param period -- interval for periodic timers, 0 for
+ * one-shot
+ * @param flags -- HRTIMER_ARM_* bits
+ */
+extern int AuHRTimerArm(uint32_t threadId, int id, uint64_t initial, uint64_t period, uint8_t flags);
+
+/*
+ * AuHRTimerDisarm -- stops a timer, pending expirations
+ * are kept
+ * @param threadId -- caller thread id
+ * @param id -- timer id
+ */
+extern int AuHRTimerDisarm(uint32_t threadId, int id);
+
+/*
+ * AuHRTimerWait -- blocks until the timer expired at least
+ * once, returns and clears number of expirations
+ * @param thr -- caller thread
+ * @param id -- timer id
+ */
+extern int64_t AuHRTimerWait(AuThread* thr, int id);
+
+/*
+ * AuHRTimerClose -- destroys a timer, a thread waiting
+ * on it is released
+ * @param threadId -- caller thread id
+ * @param id -- timer id
+ */
+extern int AuHRTimerClose(uint32_t threadId, int id);
+
+/*
+ * AuHRTimerRemoveThread -- destroys every timer owned
+ * by a thread
+ * @param threadId -- thread id
+ */
+extern void AuHRTimerRemoveThread(uint32_t threadId);
+
+/*
+ * AuHRTimerExpire -- fire every timer whose deadline has
+ * passed, called from scheduler tick
+ */
+extern void AuHRTimerExpire();
+
 
 #endif
\ No newline at end of file
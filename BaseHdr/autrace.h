@@ -0,0 +1,139 @@
+/**
+* BSD 2-Clause License
+*
+* Copyright (c) 2022-2023, Manas Kamal Choudhury
+* All rights reserved.
+*
+* Redistribution and use in source and binary forms, with or without
+* modification, are permitted provided that the following conditions are met:
+*
+* 1. Redistributions of source code must retain the above copyright notice, this
+*    list of conditions and the following disclaimer.
+*
+* 2. Redistributions in binary form must reproduce the above copyright notice,
+*    this list of conditions and the following disclaimer in the documentation
+*    and/or other materials provided with the distribution.
+*
+* THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+* AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+* IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+* DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE
+* FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+* DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR
+* SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER
+* CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY,
+* OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+* OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+*
+**/
+
+#ifndef __AU_TRACE_H__
+#define __AU_TRACE_H__
+
+#include <stdint.h>
+
+/*
+ * Binary trace records, one ring per cpu. Records are
+ * fixed size and stamped with the tsc of the cpu that
+ * emitted them, /dev/trace hands them out behind an
+ * AuTraceHeader and Tools/TraceDecode turns a dump into
+ * Chrome trace json. This header is shared with the
+ * host side decoder so it only depends on stdint.h
+ */
+
+#define TRACE_EVENT_SWITCH          1  /* arg0 prev tid, arg1 next tid */
+#define TRACE_EVENT_SYSCALL_ENTER   2  /* arg0 number, arg1 first param */
+#define TRACE_EVENT_SYSCALL_EXIT    3  /* arg0 number, arg1 return value */
+#define TRACE_EVENT_PAGE_FAULT      4  /* arg0 address, arg1 error code */
+#define TRACE_EVENT_BLOCK_ISSUE     5  /* arg0 lba, arg1 count | write << 32 */
+#define TRACE_EVENT_BLOCK_COMPLETE  6  /* arg0 lba, arg1 count | write << 32 */
+#define TRACE_EVENT_IRQ_ENTER       7  /* arg0 vector */
+#define TRACE_EVENT_IRQ_EXIT        8  /* arg0 vector */
+#define TRACE_EVENT_POSTBOX_SEND    9  /* arg0 destination id, arg1 type */
+#define TRACE_EVENT_LOST            10 /* arg0 records dropped, made by reader */
+#define TRACE_EVENT_MAX             11
+
+#define TRACE_MASK(ev)  (1u << (ev))
+#define TRACE_MASK_ALL  (0xFFFFFFFFu)
+
+#define TRACE_MAGIC     0x43525458 /* 'XTRC' */
+#define TRACE_VERSION   1
+
+#define TRACE_MAX_CPUS   8
+#define TRACE_RING_SIZE  (64*1024)
+
+#pragma pack(push,1)
+typedef struct _au_trace_record_ {
+	uint64_t tsc;
+	uint16_t event;
+	uint8_t cpu;
+	uint8_t rsvd;
+	uint32_t thread;
+	uint64_t arg0;
+	uint64_t arg1;
+}AuTraceRecord;
+
+typedef struct _au_trace_header_ {
+	uint32_t magic;
+	uint16_t version;
+	uint16_t recordSize;
+	uint64_t tscMhz;
+	uint64_t lost;
+}AuTraceHeader;
+#pragma pack(pop)
+
+/* bit per event id, zero while tracing is off */
+extern volatile uint32_t _au_trace_mask;
+
+/*
+ * AU_TRACE -- static tracepoint, costs a load and a test
+ * while the event is not enabled
+ */
+#define AU_TRACE(ev, a0, a1) do { \
+	if (_au_trace_mask & TRACE_MASK(ev)) \
+		AuTraceEmit((ev), (uint64_t)(a0), (uint64_t)(a1)); \
+} while (0)
+
+/*
+* AuTraceEmit -- put a record into current cpu's ring,
+* record is dropped and counted if the ring is full
+* @param event -- event id
+* @param arg0 -- first argument
+* @param arg1 -- second argument
+*/
+extern void AuTraceEmit(uint16_t event, uint64_t arg0, uint64_t arg1);
+
+/*
+* AuTraceEnable -- enable a set of events, rings are
+* allocated on first enable
+* @param mask -- events to enable
+* @return 0 on success, -1 if rings could not be allocated
+*/
+extern int AuTraceEnable(uint32_t mask);
+
+/*
+* AuTraceDisable -- stop emitting any event, recorded
+* data stays until read or reset
+*/
+extern void AuTraceDisable();
+
+/*
+* AuTraceReset -- drop everything recorded so far
+*/
+extern void AuTraceReset();
+
+/*
+* AuTraceDrain -- move whole records out of the rings
+* @param records -- where to put the records
+* @param max -- maximum number of records
+* @return number of records copied
+*/
+extern uint32_t AuTraceDrain(AuTraceRecord* records, uint32_t max);
+
+/*
+* AuTraceFillHeader -- fill in a dump header
+* @param hdr -- Pointer to header
+*/
+extern void AuTraceFillHeader(AuTraceHeader* hdr);
+
+#endif
\ No newline at end of file
@@ -90,7 +90,7 @@ hashmap_t* AuHashmapCreateInt(int size) {
 	map->hash_comp = hashmap_int_comp;
 	map->hash_key_dup = hashmap_int_dupe;
 	map->hash_key_free = hashmap_int_free;
-	map->hash_val_free = hashmap_int_free;
+	map->hash_val_free = kfree;
 	map->size = size;
 	map->entries = (hashmap_entry_t**)kmalloc(sizeof(hashmap_entry_t*)*size);
 	memset(map->entries, 0, sizeof(hashmap_entry_t*)* size);
@@ -163,7 +163,7 @@ void* AuHashmapRemove(hashmap_t* map, const void* key) {
 		else {
 			hashmap_entry_t* p = x;
 			x = x->next;
-			do {
+			while (x) {
 				if (map->hash_comp(x->key, key)){
 					void* out = x->value;
 					p->next = x->next;
@@ -173,7 +173,7 @@ void* AuHashmapRemove(hashmap_t* map, const void* key) {
 				}
 				p = x;
 				x = x->next;
-			} while (x);
+			}
 		}
 		return NULL;
 	}
@@ -0,0 +1,90 @@
+/**
+* BSD 2-Clause License
+*
+* Copyright (c) 2022-2023, Manas Kamal Choudhury
+* All rights reserved.
+*
+* Redistribution and use in source and binary forms, with or without
+* modification, are permitted provided that the following conditions are met:
+*
+* 1. Redistributions of source code must retain the above copyright notice, this
+*    list of conditions and the following disclaimer.
+*
+* 2. Redistributions in binary form must reproduce the above copyright notice,
+*    this list of conditions and the following disclaimer in the documentation
+*    and/or other materials provided with the distribution.
+*
+* THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+* AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+* IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+* DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE
+* FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+* DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR
+* SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER
+* CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY,
+* OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+* OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+*
+**/
+
+#ifndef __IDTABLE_H__
+#define __IDTABLE_H__
+
+#include <stdint.h>
+#include <aurora.h>
+
+/* ids are resolved through a four level radix tree,
+ * eight bits of the id per level */
+#define IDTABLE_LEVEL_BITS  8
+#define IDTABLE_LEVEL_SIZE  (1<<IDTABLE_LEVEL_BITS)
+#define IDTABLE_LEVELS      4
+
+#define IDTABLE_INVALID_ID  0
+
+typedef struct _idtable_node_ {
+	void* slots[IDTABLE_LEVEL_SIZE];
+	/* non null slots, a node is freed when it drops
+	 * to zero */
+	uint32_t used;
+}AuIDTableNode;
+
+/*
+ * AuIDTable -- maps 32 bit ids to objects, ids
+ * are handed out in increasing order and are not
+ * reused until the counter wraps
+ */
+typedef struct _idtable_ {
+	AuIDTableNode* root;
+	uint32_t nextID;
+	uint32_t count;
+}AuIDTable;
+
+/*
+ * AuIDTableCreate -- creates a new id table
+ */
+AU_EXTERN AU_EXPORT AuIDTable* AuIDTableCreate();
+
+/*
+ * AuIDTableAlloc -- allocates a free id and binds
+ * object to it
+ * @param table -- Pointer to id table
+ * @param obj -- object to bind
+ * @return new id, IDTABLE_INVALID_ID if table is full
+ */
+AU_EXTERN AU_EXPORT uint32_t AuIDTableAlloc(AuIDTable* table, void* obj);
+
+/*
+ * AuIDTableGet -- returns object bound to an id
+ * @param table -- Pointer to id table
+ * @param id -- id to look
+ */
+AU_EXTERN AU_EXPORT void* AuIDTableGet(AuIDTable* table, uint32_t id);
+
+/*
+ * AuIDTableRemove -- releases an id
+ * @param table -- Pointer to id table
+ * @param id -- id to release
+ */
+AU_EXTERN AU_EXPORT void AuIDTableRemove(AuIDTable* table, uint32_t id);
+
+#endif
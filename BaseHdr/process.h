@@ -42,8 +42,23 @@
 
 #define PROCESS_USER_STACK_SZ 512*1024
 
-#define MAX_THREADS_PER_PROCESS  60
+/* initial sizes of the per process thread and
+ * file descriptor tables, both grow on demand */
+#define THREAD_TABLE_INITIAL_SZ   8
+#define FILE_DESC_TABLE_INITIAL_SZ 64
+
+#ifdef ARCH_ARM64
+/* ARM64 kernel still uses a fixed table */
 #define FILE_DESC_PER_PROCESS 60
+#endif
+
+/* 0, 1 & 2 are reserved for terminal */
+#define FILE_DESC_FIRST_FREE  3
+
+/* sanity ceiling for a requested descriptor
+ * index, guards the table growth against
+ * bogus numbers from user space */
+#define FILE_DESC_INDEX_LIMIT (1<<16)
 
 #define PROCESS_STATE_NOT_READY  (1<<0)
 #define PROCESS_STATE_READY      (1<<1)
@@ -78,9 +93,13 @@
 #define PROCESS_BREAK_ADDRESS   0x0000000300000000
 #define PROCESS_MMAP_ADDRESS    0x00000000C0000000
 #define PROCESS_SHM_ADDRESS     0x0000000080000000
+#define PROCESS_USER_STACK_ADDRESS 0x0000700000000000
 
 typedef void(*entry) (void*);
 
+struct _vm_area_;
+struct _vm_pin_;
+
 #pragma pack(push,1)
 typedef struct _au_proc_ {
 	int proc_id;
@@ -104,30 +123,43 @@ typedef struct _au_proc_ {
 	AA64Thread* main_thread;
 #endif // Maybe RISC-V?
 
-    uint8_t num_thread;
+	int num_thread;
+	int max_thread;
 	entry entry_point;
 
 #ifdef ARCH_X64
-	AuThread* threads[MAX_THREADS_PER_PROCESS];
+	AuThread** threads;
 #elif ARCH_ARM64
-	AA64Thread* threads[MAX_THREADS_PER_PROCESS];
+	AA64Thread** threads;
 #endif // Maybe RISC-V?
 
-	/* file descriptors */
+#ifdef ARCH_X64
+	/* file descriptors, fd_bitmap keeps one
+	 * bit per used slot */
+	AuVFSNode** fds;
+	uint64_t* fd_bitmap;
+	int max_fds;
+#elif ARCH_ARM64
 	AuVFSNode* fds[FILE_DESC_PER_PROCESS];
+#endif
 	/*loader related data*/
 	AuVFSNode *file;
 	AuVFSNode *fsys;
 
 	/* memory account */
-	list_t* vmareas;
+	struct _vm_area_* vmroot;
+	size_t vm_count;
+	size_t vm_mapped;
+	struct _vm_pin_* vmpins;
 	list_t* shmmaps;
 	list_t* waitlist;
-	size_t shm_break;
 	size_t proc_mem_heap;
 	size_t proc_heapmem_len;
 	size_t proc_mmap_len;
 
+	/* async syscall ring */
+	void* ioring;
+
 	/* data structure */
 	struct _au_proc_ *next;
 	struct _au_proc_ *prev;
@@ -247,6 +279,57 @@ extern void AuProcessExit(AuProcess* proc, bool schedulable);
 */
 extern int AuProcessGetFileDesc(AuProcess* proc);
 
+/*
+* AuProcessGetFileNode -- returns the file bound
+* to a file descriptor
+* @param proc -- pointer to process slot
+* @param fd -- file descriptor
+*/
+extern AuVFSNode* AuProcessGetFileNode(AuProcess* proc, int fd);
+
+/*
+* AuProcessSetFileDesc -- binds a file to a file
+* descriptor, grows the table if needed
+* @param proc -- pointer to process slot
+* @param fd -- file descriptor
+* @param file -- file to bind
+*/
+extern int AuProcessSetFileDesc(AuProcess* proc, int fd, AuVFSNode* file);
+
+/*
+* AuProcessRemoveFileDesc -- releases a file descriptor
+* @param proc -- pointer to process slot
+* @param fd -- file descriptor
+*/
+extern void AuProcessRemoveFileDesc(AuProcess* proc, int fd);
+
+/*
+* AuProcessDupFileDesc -- makes newfd refer to the
+* file of fd
+* @param proc -- pointer to process slot
+* @param fd -- file descriptor to duplicate
+* @param newfd -- target descriptor, -1 for lowest
+* free one
+*/
+extern int AuProcessDupFileDesc(AuProcess* proc, int fd, int newfd);
+
+/*
+* AuProcessFreeTables -- frees thread and file
+* descriptor tables of a process
+* @param proc -- pointer to process slot
+*/
+extern void AuProcessFreeTables(AuProcess* proc);
+
+#ifdef ARCH_X64
+/*
+* AuProcessAddThread -- adds a sub thread to
+* process thread table
+* @param proc -- pointer to process slot
+* @param thr -- thread to add
+*/
+extern int AuProcessAddThread(AuProcess* proc, AuThread* thr);
+#endif
+
 /*
 * AuProcessWaitForTermination -- waits for termination
 * of child processes
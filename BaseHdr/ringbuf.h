@@ -0,0 +1,186 @@
+/**
+* BSD 2-Clause License
+*
+* Copyright (c) 2022-2023, Manas Kamal Choudhury
+* All rights reserved.
+*
+* Redistribution and use in source and binary forms, with or without
+* modification, are permitted provided that the following conditions are met:
+*
+* 1. Redistributions of source code must retain the above copyright notice, this
+*    list of conditions and the following disclaimer.
+*
+* 2. Redistributions in binary form must reproduce the above copyright notice,
+*    this list of conditions and the following disclaimer in the documentation
+*    and/or other materials provided with the distribution.
+*
+* THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+* AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+* IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+* DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE
+* FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+* DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR
+* SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER
+* CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY,
+* OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+* OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+*
+**/
+
+#ifndef __RING_BUF_H__
+#define __RING_BUF_H__
+
+#include <stdint.h>
+
+/*
+ * Single producer, single consumer byte ring. Head is
+ * only written by the producer and tail only by the
+ * consumer, both run freely and are masked on access,
+ * so no lock is needed between the two sides. Indices
+ * are published with release stores and observed with
+ * acquire loads so that data copied into the ring is
+ * visible before the index that covers it.
+ */
+#ifdef _MSC_VER
+extern "C" void _ReadWriteBarrier(void);
+#pragma intrinsic(_ReadWriteBarrier)
+/* x64 keeps store and load order, only the compiler
+ * has to be held back */
+#define AU_RING_LOAD_ACQUIRE(p) AuRingBufLoadAcquire(p)
+#define AU_RING_STORE_RELEASE(p, v) do { _ReadWriteBarrier(); *(p) = (v); } while (0)
+static inline uint32_t AuRingBufLoadAcquire(volatile uint32_t* p) {
+	uint32_t v = *p;
+	_ReadWriteBarrier();
+	return v;
+}
+#else
+#define AU_RING_LOAD_ACQUIRE(p) __atomic_load_n((p), __ATOMIC_ACQUIRE)
+#define AU_RING_STORE_RELEASE(p, v) __atomic_store_n((p), (v), __ATOMIC_RELEASE)
+#endif
+
+/*
+ * AuRingBuffer -- ring state, producer and consumer
+ * owned indices live in separate cache lines
+ */
+typedef struct _ring_buf_ {
+	uint8_t* buffer;
+	uint32_t size;
+	uint32_t mask;
+	uint8_t rsvd[48];
+	/* written by producer */
+	volatile uint32_t head;
+	uint8_t rsvd1[60];
+	/* written by consumer */
+	volatile uint32_t tail;
+	uint8_t rsvd2[60];
+}AuRingBuffer;
+
+/*
+ * AuRingBufInit -- initialise a ring over caller
+ * provided storage
+ * @param ring -- Pointer to the ring
+ * @param buffer -- storage of the ring
+ * @param size -- size of storage, power of two
+ * @return 0 on success, -1 if size is not a power of two
+ */
+extern int AuRingBufInit(AuRingBuffer* ring, uint8_t* buffer, uint32_t size);
+
+/*
+ * AuRingBufReset -- discard everything in the ring,
+ * neither side may be active
+ * @param ring -- Pointer to the ring
+ */
+extern void AuRingBufReset(AuRingBuffer* ring);
+
+/*
+ * AuRingBufUsed -- number of bytes ready to read
+ * @param ring -- Pointer to the ring
+ */
+extern uint32_t AuRingBufUsed(AuRingBuffer* ring);
+
+/*
+ * AuRingBufAvailable -- number of bytes that can
+ * be written
+ * @param ring -- Pointer to the ring
+ */
+extern uint32_t AuRingBufAvailable(AuRingBuffer* ring);
+
+/*
+ * AuRingBufEmpty -- checks if nothing is ready to read
+ * @param ring -- Pointer to the ring
+ */
+extern bool AuRingBufEmpty(AuRingBuffer* ring);
+
+/*
+ * AuRingBufWrite -- producer side, copy as many bytes
+ * as fit in at most two spans
+ * @param ring -- Pointer to the ring
+ * @param data -- data to put
+ * @param len -- length of data
+ * @return number of bytes put
+ */
+extern uint32_t AuRingBufWrite(AuRingBuffer* ring, const uint8_t* data, uint32_t len);
+
+/*
+ * AuRingBufRead -- consumer side, copy up to len
+ * bytes in at most two spans
+ * @param ring -- Pointer to the ring
+ * @param data -- where to put the data
+ * @param len -- maximum number of bytes
+ * @return number of bytes got
+ */
+extern uint32_t AuRingBufRead(AuRingBuffer* ring, uint8_t* data, uint32_t len);
+
+/*
+ * AuRingBufPut -- producer side, put a single byte
+ * @param ring -- Pointer to the ring
+ * @param c -- byte to put
+ * @return 0 on success, -1 if ring is full
+ */
+extern int AuRingBufPut(AuRingBuffer* ring, uint8_t c);
+
+/*
+ * AuRingBufWritePeek -- producer side, get the free
+ * contiguous span at head without copying
+ * @param ring -- Pointer to the ring
+ * @param span -- receives start of the span
+ * @return length of the span
+ */
+extern uint32_t AuRingBufWritePeek(AuRingBuffer* ring, uint8_t** span);
+
+/*
+ * AuRingBufWriteCommit -- producer side, publish bytes
+ * filled in through AuRingBufWritePeek
+ * @param ring -- Pointer to the ring
+ * @param len -- number of bytes filled
+ */
+extern void AuRingBufWriteCommit(AuRingBuffer* ring, uint32_t len);
+
+/*
+ * AuRingBufReadPeek -- consumer side, get the ready
+ * contiguous span at tail without copying
+ * @param ring -- Pointer to the ring
+ * @param span -- receives start of the span
+ * @return length of the span
+ */
+extern uint32_t AuRingBufReadPeek(AuRingBuffer* ring, uint8_t** span);
+
+/*
+ * AuRingBufReadCommit -- consumer side, release bytes
+ * consumed through AuRingBufReadPeek
+ * @param ring -- Pointer to the ring
+ * @param len -- number of bytes consumed
+ */
+extern void AuRingBufReadCommit(AuRingBuffer* ring, uint32_t len);
+
+/*
+ * AuRingBufFind -- consumer side, look for a byte
+ * among ready data
+ * @param ring -- Pointer to the ring
+ * @param c -- byte to look for
+ * @return number of bytes up to and including the
+ * byte, 0 if not present
+ */
+extern uint32_t AuRingBufFind(AuRingBuffer* ring, uint8_t c);
+
+#endif
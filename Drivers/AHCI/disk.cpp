@@ -277,7 +277,7 @@ int AuAHCIVDiskWrite(AuVDisk* disk, uint64_t lba, uint32_t count, uint64_t* buff
 	return count;
 }
 
-size_t AHCIDiskWrite(AuVFSNode* _node_, AuVFSNode* file, uint64_t* buffer, uint32_t len) {
+size_t AHCIDiskWrite(AuVFSNode* _node_, AuVFSNode* file, uint64_t* buffer, size_t len) {
 	/* here avoid using _node_ as file, because it contains the
 	 * address to VDisk structure */
 	if (!file)
@@ -297,7 +297,7 @@ size_t AHCIDiskWrite(AuVFSNode* _node_, AuVFSNode* file, uint64_t* buffer, uint3
 	return lba_bytes;
 }
 
-size_t AHCIDiskRead(AuVFSNode* _node_, AuVFSNode* file, uint64_t* buffer, uint32_t len) {
+size_t AHCIDiskRead(AuVFSNode* _node_, AuVFSNode* file, uint64_t* buffer, size_t len) {
 	/* here avoid using _node_ as file, because it contains the
 	 * address to VDisk structure */
 	if (!file)
@@ -338,12 +338,12 @@ AU_EXTERN AU_EXPORT int AuDriverUnload() {
 	return 0;
 }
 
-AU_EXTERN AU_EXPORT size_t E1000ReadFile(AuVFSNode* node, AuVFSNode*file, uint64_t* buffer, uint32_t len) {
+AU_EXTERN AU_EXPORT size_t E1000ReadFile(AuVFSNode* node, AuVFSNode*file, uint64_t* buffer, size_t len) {
 	AuTextOut("E1000ReadFile \n");
 	return 0;
 }
 
-AU_EXTERN AU_EXPORT size_t E1000WriteFile(AuVFSNode* node, AuVFSNode*file, uint64_t* buffer, uint32_t len) {
+AU_EXTERN AU_EXPORT size_t E1000WriteFile(AuVFSNode* node, AuVFSNode*file, uint64_t* buffer, size_t len) {
 	uint8_t* aligned_buf = (uint8_t*)buffer;
 	E1000SendPacket(e1000_nic, aligned_buf, len);
 	return len;
@@ -84,7 +84,6 @@ int NVMeNamespaceRead(NVMeNamespace* namespc_, uint64_t lba, uint32_t count, uin
 				namespc_->nsID);
 			return 1;
 		}
-		SeTextOut("[NVMe] : reading block %d sz -> %d \r\n", lba, sz);
 
 		memcpy(alignedBuff, (void*)namespc_->physMMIOBuffer, sz);
 		alignedBuff += sz;
@@ -163,7 +162,7 @@ int NVMeWriteBlock(AuVDisk* vdisk, uint64_t lba, uint32_t count, uint64_t* buffe
 }
 
 
-size_t NVMeFileWrite(AuVFSNode* _node_, AuVFSNode* file, uint64_t* buffer, uint32_t len) {
+size_t NVMeFileWrite(AuVFSNode* _node_, AuVFSNode* file, uint64_t* buffer, size_t len) {
 	if (!file)
 		return 0;
 	uint64_t lba = file->pos / 512;
@@ -175,7 +174,7 @@ size_t NVMeFileWrite(AuVFSNode* _node_, AuVFSNode* file, uint64_t* buffer, uint3
 	return lba_bytes;
 }
 
-size_t NVMeFileRead(AuVFSNode* _node_, AuVFSNode* file, uint64_t* buffer, uint32_t len) {
+size_t NVMeFileRead(AuVFSNode* _node_, AuVFSNode* file, uint64_t* buffer, size_t len) {
 	if (!file)
 		return 0;
 	uint64_t lba = file->pos / 512;
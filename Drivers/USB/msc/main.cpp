@@ -45,6 +45,35 @@
 #define SCSI_STATUS_FAILED 1
 #define SCSI_STATUS_PHASE_ERR 2
 
+#define MSC_PROTOCOL_BOT  0x50
+#define MSC_PROTOCOL_UAS  0x62
+
+/* number of BOT commands queued back to back before
+ * waiting for their status, every command takes at most
+ * 18 trbs on an endpoint ring, so the depth must keep
+ * the ring below 128 trbs */
+#define MSC_BOT_PIPELINE_DEPTH  4
+/* number of UAS commands in flight, each uses its own
+ * stream */
+#define MSC_UAS_QUEUE_DEPTH  8
+/* upper limit for a single READ/WRITE command */
+#define MSC_MAX_TRANSFER_BYTES  (1024*1024)
+/* used when device doesn't report block limits VPD page */
+#define MSC_DEFAULT_MAX_BLOCKS  240
+
+#define MSC_CMD_STRIDE  64
+#define MSC_STATUS_STRIDE  128
+
+/* UAS information units and pipe usage */
+#define UAS_IU_COMMAND  0x01
+#define UAS_IU_SENSE  0x03
+#define UAS_IU_RESPONSE  0x04
+#define UAS_PIPE_USAGE_DESCRIPTOR  0x24
+#define UAS_PIPE_COMMAND  1
+#define UAS_PIPE_STATUS  2
+#define UAS_PIPE_DATA_IN  3
+#define UAS_PIPE_DATA_OUT  4
+
 #pragma pack(push,1)
 typedef struct _scsi_cmd_ {
 	uint32_t signature;
@@ -122,8 +151,58 @@ typedef struct _scsi_write_10_ {
 }SCSIWrite10;
 #pragma pack(pop)
 
-void* bulkIn;
-void* bulkOut;
+/* UAS command information unit */
+#pragma pack(push,1)
+typedef struct _uas_command_iu_ {
+	uint8_t iuID;
+	uint8_t rsvd;
+	uint16_t tag;
+	uint8_t prioAttr;
+	uint8_t rsvd2;
+	uint8_t addCdbLen;
+	uint8_t rsvd3;
+	uint8_t lun[8];
+	uint8_t cdb[16];
+}UASCommandIU;
+#pragma pack(pop)
+
+/* UAS sense information unit */
+#pragma pack(push,1)
+typedef struct _uas_sense_iu_ {
+	uint8_t iuID;
+	uint8_t rsvd;
+	uint16_t tag;
+	uint16_t statusQualifier;
+	uint8_t status;
+	uint8_t rsvd2[7];
+	uint16_t senseLength;
+	uint8_t sense[18];
+}UASSenseIU;
+#pragma pack(pop)
+
+/*
+ * USBMassStorage -- per device state of the driver,
+ * cmdArea and statusArea hold one CBW/CSW (or command/
+ * sense IU) per in flight command
+ */
+typedef struct _usb_msc_ {
+	AuUSBDeviceStruc* dev;
+	uint8_t interfaceNum;
+	bool uas;
+	void* bulkIn;
+	void* bulkOut;
+	void* cmdPipe;
+	void* statusPipe;
+	void* dataInPipe;
+	void* dataOutPipe;
+	int depth;
+	uint32_t blockSize;
+	uint32_t maxBlocks;
+	uint32_t tag;
+	uint8_t* cmdArea;
+	uint8_t* statusArea;
+}USBMassStorage;
+
 /*
 * AuUSBDriverUnload -- deattach the driver from
 * aurora system
@@ -135,34 +214,6 @@ AU_EXTERN AU_EXPORT int AuDriverUnload(AuUSBDeviceStruc* dev) {
 
 extern "C" int _fltused = 1;
 
-/*
- * AuUSBMSCSendCommand -- send a command to MSC device
- * @param dev -- Pointer to USB device struc
- * @param bulkIn -- Bulk IN Endpoint
- * @param bulkOut -- Bulk OUT Endpoint
- * @param cbw -- SCSI Command to submit
- * @param resp -- Response buffer
- * @param respSize -- Response size
- */
-void AuUSBMSCSendCommand(AuUSBDeviceStruc *dev, void* bulkIn, void* bulkOut, SCSICommand* cbw, void* resp, uint32_t respSize) {
-	dev->AuBulkTranfer(dev, (uint64_t)cbw, sizeof(SCSICommand), bulkOut);
-	dev->AuUSBWait(dev, USB_WAIT_EVENT_TRANSFER);
-
-	if (respSize > 0) {
-		dev->AuBulkTranfer(dev, (uint64_t)resp, respSize, bulkIn);
-		dev->AuUSBWait(dev, USB_WAIT_EVENT_TRANSFER);
-	}
-	SCSIStatus* csw = (SCSIStatus*)P2V((uint64_t)AuPmmngrAlloc());
-	memset(csw, 0, sizeof(SCSIStatus));
-	dev->AuBulkTranfer(dev, V2P((uint64_t)csw), sizeof(SCSIStatus), bulkIn);
-	dev->AuUSBWait(dev, USB_WAIT_EVENT_TRANSFER);
-
-	if (csw->signature == SCSI_CMD_STATUS_SIGNATURE) {
-		SeTextOut("USB MSC -- Command submitted successfully \r\n");
-	}
-	AuPmmngrFree((void*)V2P((uint64_t)csw));
-}
-
 uint32_t convEndian(uint32_t value) {
 	return ((value >> 24) & 0x000000FF) |
 		((value >> 8) & 0x0000FF00) |
@@ -177,81 +228,227 @@ uint32_t cpuBe32(uint32_t value) {
 		((value << 24) & 0xFF000000);
 }
 
+uint16_t cpuBe16(uint16_t value) {
+	return (value >> 8) | ((value & 0xFF) << 8);
+}
+
 /*
- * AuUSBMSCRead -- read a block from MSC device
- * @param dev -- Pointer to USB device
- * @param lba -- LBA number to read
- * @param numBlocks -- Number of blocks to read
- * @param blockSz -- Size of a block -- 512
- * @param buffer -- Buffer address where to store the data
+ * AuUSBMSCRecover -- bring the device back to a known
+ * state after a failed command, all queued commands are
+ * lost and pipelining is disabled
+ * @param msc -- Pointer to mass storage device
  */
-void AuUSBMSCRead(AuUSBDeviceStruc* dev, uint32_t lba, uint16_t numBlocks, uint32_t blockSz, uint64_t* buffer) {
-	SCSICommand* cbw = (SCSICommand*)P2V((uint64_t)AuPmmngrAlloc());
-	memset(cbw, 0, 4096);
-	cbw->signature = SCSI_CMD_BLK_SIGNATURE;
-	cbw->tag = 0x12345678;
-	cbw->dataBytes = numBlocks * blockSz;
-	cbw->flags = 0x80;
-	cbw->lun = 0;
-	cbw->cmdBytes = sizeof(SCSIRead10);
-
-	SCSIRead10 read;
-	read.opcode = 0x28;
-	read.lba = cpuBe32(lba);
-	read.transferLen = (numBlocks >> 8) | ((numBlocks & 0xFF) << 8);
-	memcpy(&cbw->cmd, &read, sizeof(SCSIRead10));
-
-	AuUSBMSCSendCommand(dev, bulkIn, bulkOut, (SCSICommand*)V2P((uint64_t)cbw), buffer, numBlocks * blockSz);
-
-	AuPmmngrFree((void*)V2P((uint64_t)cbw));
-
+void AuUSBMSCRecover(USBMassStorage* msc) {
+	AuUSBDeviceStruc* dev = msc->dev;
+	SeTextOut("USB MSC -- command failed, recovering \r\n");
+	if (msc->uas) {
+		dev->AuClearHalt(dev, msc->cmdPipe);
+		dev->AuClearHalt(dev, msc->statusPipe);
+		dev->AuClearHalt(dev, msc->dataInPipe);
+		dev->AuClearHalt(dev, msc->dataOutPipe);
+	}
+	else {
+		/* Bulk-Only mass storage reset */
+		AuUSBRequestPacket pack;
+		pack.request_type = 0x21;
+		pack.request = 0xFF;
+		pack.value = 0x0000;
+		pack.index = msc->interfaceNum;
+		pack.length = 0x0000;
+		dev->AuControlTransfer(dev, &pack, 0, 0);
+		dev->AuUSBWait(dev, USB_WAIT_EVENT_TRANSFER);
+		dev->AuClearHalt(dev, msc->bulkIn);
+		dev->AuClearHalt(dev, msc->bulkOut);
+	}
+	msc->depth = 1;
 }
 
 /*
- * AuUSBMSCWrite -- write data to msc drive block
- * @param dev -- Pointer to USB Device struc
- * @param lba -- Linear Block number
- * @param nummBlocks -- number of block to write to
- * @param blockSz -- block size of the msc device
- * @param buffer -- buffer to write
+ * AuUSBMSCSubmit -- queue a command with its data and
+ * status transfers, nothing is waited here
+ * @param msc -- Pointer to mass storage device
+ * @param slot -- command slot, also the UAS stream id - 1
+ * @param cdb -- SCSI command block
+ * @param cdbLen -- length of command block
+ * @param buffer -- physical address of data buffer
+ * @param len -- data length, can be 0
+ * @param in -- data direction device-to-host
+ * @param dataSeq -- returns sequence of the data transfer
+ * @return sequence of the status transfer, 0 on failure
  */
-void AuUSBMSCWrite(AuUSBDeviceStruc* dev, uint32_t lba, uint16_t numBlocks, uint32_t blockSz, uint64_t* buffer) {
-	SCSICommand* cbw = (SCSICommand*)P2V((uint64_t)AuPmmngrAlloc());
-	memset(cbw, 0, 4096);
+uint32_t AuUSBMSCSubmit(USBMassStorage* msc, int slot, uint8_t* cdb, uint8_t cdbLen, uint64_t buffer, uint32_t len, bool in,
+	uint32_t* dataSeq) {
+	AuUSBDeviceStruc* dev = msc->dev;
+	uint32_t statusSeq = 0;
+	*dataSeq = 0;
+
+	if (msc->uas) {
+		uint16_t stream = slot + 1;
+		UASCommandIU* iu = (UASCommandIU*)(msc->cmdArea + slot * MSC_CMD_STRIDE);
+		memset(iu, 0, sizeof(UASCommandIU));
+		iu->iuID = UAS_IU_COMMAND;
+		iu->tag = cpuBe16(stream);
+		memcpy(iu->cdb, cdb, cdbLen);
+		memset(msc->statusArea + slot * MSC_STATUS_STRIDE, 0, MSC_STATUS_STRIDE);
+
+		/* status and data are queued before the command, so
+		 * that the device finds them ready */
+		statusSeq = dev->AuBulkQueue(dev, V2P((uint64_t)msc->statusArea + slot * MSC_STATUS_STRIDE), MSC_STATUS_STRIDE,
+			msc->statusPipe, stream);
+		if (len) {
+			*dataSeq = dev->AuBulkQueue(dev, buffer, len, in ? msc->dataInPipe : msc->dataOutPipe, stream);
+			if (!*dataSeq)
+				return 0;
+		}
+		if (!dev->AuBulkQueue(dev, V2P((uint64_t)iu), sizeof(UASCommandIU), msc->cmdPipe, 0))
+			return 0;
+		return statusSeq;
+	}
+
+	SCSICommand* cbw = (SCSICommand*)(msc->cmdArea + slot * MSC_CMD_STRIDE);
+	memset(cbw, 0, sizeof(SCSICommand));
 	cbw->signature = SCSI_CMD_BLK_SIGNATURE;
-	cbw->tag = 0x12345678;
-	cbw->dataBytes = numBlocks * blockSz;
-	cbw->flags = 0x80;
+	cbw->tag = ++msc->tag;
+	cbw->dataBytes = len;
+	cbw->flags = in ? SCSI_CMD_FLAG_INPUT : SCSI_CMD_FLAG_OUTPUT;
 	cbw->lun = 0;
-	cbw->cmdBytes = sizeof(SCSIWrite10);
-
-	SCSIWrite10 write;
-	write.opcode = 0x2A;
-	write.lba = cpuBe32(lba);
-	write.transferLen = (numBlocks >> 8) | ((numBlocks & 0xFF) << 8);
-	memcpy(&cbw->cmd, &write, sizeof(SCSIWrite10));
+	cbw->cmdBytes = cdbLen;
+	memcpy(&cbw->cmd, cdb, cdbLen);
+	memset(msc->statusArea + slot * MSC_STATUS_STRIDE, 0, sizeof(SCSIStatus));
+
+	if (!dev->AuBulkQueue(dev, V2P((uint64_t)cbw), sizeof(SCSICommand), msc->bulkOut, 0))
+		return 0;
+	if (len) {
+		*dataSeq = dev->AuBulkQueue(dev, buffer, len, in ? msc->bulkIn : msc->bulkOut, 0);
+		if (!*dataSeq)
+			return 0;
+	}
+	statusSeq = dev->AuBulkQueue(dev, V2P((uint64_t)msc->statusArea + slot * MSC_STATUS_STRIDE), sizeof(SCSIStatus),
+		msc->bulkIn, 0);
+	return statusSeq;
+}
 
-	/* send the command first to bulkOut*/
-	dev->AuBulkTranfer(dev, V2P((uint64_t)cbw), sizeof(SCSICommand), bulkOut);
-	dev->AuUSBWait(dev, USB_WAIT_EVENT_TRANSFER);
+/*
+ * AuUSBMSCComplete -- wait for a submitted command and
+ * check its status
+ * @param msc -- Pointer to mass storage device
+ * @param slot -- command slot
+ * @param statusSeq -- sequence of the status transfer
+ * @param dataSeq -- sequence of the data transfer
+ * @param in -- data direction device-to-host
+ * @return 0 on success, -1 on failure
+ */
+int AuUSBMSCComplete(USBMassStorage* msc, int slot, uint32_t statusSeq, uint32_t dataSeq, bool in) {
+	AuUSBDeviceStruc* dev = msc->dev;
+	int code = 0;
+
+	if (msc->uas) {
+		uint16_t stream = slot + 1;
+		code = dev->AuBulkWait(dev, msc->statusPipe, stream, statusSeq);
+		if (code != USB_COMPLETION_SUCCESS && code != USB_COMPLETION_SHORT_PACKET)
+			return -1;
+		UASSenseIU* sense = (UASSenseIU*)(msc->statusArea + slot * MSC_STATUS_STRIDE);
+		if (sense->iuID != UAS_IU_SENSE || cpuBe16(sense->tag) != stream)
+			return -1;
+		if (sense->status != 0)
+			return -1;
+		return 0;
+	}
 
-	/* send the buffer to bulkOut */
-	dev->AuBulkTranfer(dev, (uint64_t)buffer, numBlocks * blockSz, bulkOut);
-	dev->AuUSBWait(dev, USB_WAIT_EVENT_TRANSFER);
+	/* on OUT direction, data goes through a different
+	 * endpoint than status */
+	if (!in && dataSeq) {
+		code = dev->AuBulkWait(dev, msc->bulkOut, 0, dataSeq);
+		if (code != USB_COMPLETION_SUCCESS && code != USB_COMPLETION_SHORT_PACKET)
+			return -1;
+	}
+	code = dev->AuBulkWait(dev, msc->bulkIn, 0, statusSeq);
+	if (code != USB_COMPLETION_SUCCESS && code != USB_COMPLETION_SHORT_PACKET)
+		return -1;
+
+	SCSICommand* cbw = (SCSICommand*)(msc->cmdArea + slot * MSC_CMD_STRIDE);
+	SCSIStatus* csw = (SCSIStatus*)(msc->statusArea + slot * MSC_STATUS_STRIDE);
+	if (csw->signature != SCSI_CMD_STATUS_SIGNATURE || csw->tag != cbw->tag)
+		return -1;
+	if (csw->status != 0)
+		return -1;
+	return 0;
+}
 
-	/* read the status from bulkIn */
-	SCSIStatus* csw = (SCSIStatus*)P2V((uint64_t)AuPmmngrAlloc());
-	memset(csw, 0, sizeof(SCSIStatus));
-	dev->AuBulkTranfer(dev, V2P((uint64_t)csw), sizeof(SCSIStatus), bulkIn);
-	dev->AuUSBWait(dev, USB_WAIT_EVENT_TRANSFER);
+/*
+ * AuUSBMSCSendCommand -- send a single command to MSC device
+ * and wait for it
+ * @param msc -- Pointer to mass storage device
+ * @param cdb -- SCSI command block
+ * @param cdbLen -- length of command block
+ * @param resp -- physical address of response buffer
+ * @param respSize -- Response size
+ * @return 0 on success, -1 on failure
+ */
+int AuUSBMSCSendCommand(USBMassStorage* msc, uint8_t* cdb, uint8_t cdbLen, uint64_t resp, uint32_t respSize) {
+	uint32_t dataSeq = 0;
+	uint32_t statusSeq = AuUSBMSCSubmit(msc, 0, cdb, cdbLen, resp, respSize, true, &dataSeq);
+	if (!statusSeq || AuUSBMSCComplete(msc, 0, statusSeq, dataSeq, true) != 0) {
+		AuUSBMSCRecover(msc);
+		return -1;
+	}
+	return 0;
+}
 
-	if (csw->signature == SCSI_CMD_STATUS_SIGNATURE) {
-		SeTextOut("USB MSC -- write successfull \r\n");
-	};
+/*
+ * AuUSBMSCTransfer -- read or write blocks, the request
+ * is split into commands of at most maxBlocks blocks and
+ * up to msc->depth commands are kept in flight
+ * @param msc -- Pointer to mass storage device
+ * @param write -- true for write
+ * @param lba -- first block
+ * @param count -- number of blocks
+ * @param buffer -- physical address of the buffer
+ * @return 0 on success, -1 on failure
+ */
+int AuUSBMSCTransfer(USBMassStorage* msc, bool write, uint64_t lba, uint32_t count, uint64_t buffer) {
+	uint32_t statusSeq[MSC_UAS_QUEUE_DEPTH];
+	uint32_t dataSeq[MSC_UAS_QUEUE_DEPTH];
+
+	while (count > 0) {
+		int queued = 0;
+		bool failed = false;
+		for (; queued < msc->depth && count > 0; queued++) {
+			uint32_t blocks = count;
+			if (blocks > msc->maxBlocks)
+				blocks = msc->maxBlocks;
+			uint32_t bytes = blocks * msc->blockSize;
+
+			uint8_t cdb[10];
+			memset(cdb, 0, 10);
+			SCSIRead10* rw = (SCSIRead10*)cdb;
+			rw->opcode = write ? 0x2A : 0x28;
+			rw->lba = cpuBe32((uint32_t)lba);
+			rw->transferLen = cpuBe16((uint16_t)blocks);
+
+			statusSeq[queued] = AuUSBMSCSubmit(msc, queued, cdb, sizeof(SCSIRead10), buffer, bytes, !write, &dataSeq[queued]);
+			if (!statusSeq[queued]) {
+				failed = true;
+				break;
+			}
+			lba += blocks;
+			buffer += bytes;
+			count -= blocks;
+		}
 
-	AuPmmngrFree((void*)V2P((uint64_t)cbw));
-	AuPmmngrFree((void*)V2P((uint64_t)csw));
+		/* commands complete in order on BOT, on UAS each one
+		 * has its own stream */
+		for (int i = 0; i < queued && !failed; i++) {
+			if (AuUSBMSCComplete(msc, i, statusSeq[i], dataSeq[i], !write) != 0)
+				failed = true;
+		}
 
+		if (failed) {
+			AuUSBMSCRecover(msc);
+			return -1;
+		}
+	}
+	return 0;
 }
 
 /*
@@ -264,12 +461,14 @@ void AuUSBMSCWrite(AuUSBDeviceStruc* dev, uint32_t lba, uint16_t numBlocks, uint
  int AuUSBVDiskRead(AuVDisk* disk, uint64_t lba, uint32_t count, uint64_t* buffer) {
 	 if (!disk->data)
 		 return -1;
-	 AuUSBDeviceStruc* dev = (AuUSBDeviceStruc*)disk->data;
+	 USBMassStorage* msc = (USBMassStorage*)disk->data;
 	 if (disk->blockSize == 0) {
 		 SeTextOut("USB MSC-Read: Block size not defined, assigning default 512 bytes \r\n");
 		 disk->blockSize = 512;
 	 }
-	 AuUSBMSCRead(dev, lba, count, disk->blockSize, buffer);
+	 msc->blockSize = disk->blockSize;
+	 if (AuUSBMSCTransfer(msc, false, lba, count, (uint64_t)buffer) != 0)
+		 return -1;
 	 return count;
 }
 
@@ -283,97 +482,164 @@ void AuUSBMSCWrite(AuUSBDeviceStruc* dev, uint32_t lba, uint16_t numBlocks, uint
  int AuUSBVDiskWrite(AuVDisk* disk, uint64_t lba, uint32_t count, uint64_t* buffer) {
 	 if (!disk->data)
 		 return -1;
-	 AuUSBDeviceStruc* dev = (AuUSBDeviceStruc*)disk->data;
+	 USBMassStorage* msc = (USBMassStorage*)disk->data;
 	 if (disk->blockSize == 0) {
 		 SeTextOut("USB MSC-Write: Block size not defined, assigning default 512 bytes \r\n");
 		 disk->blockSize = 512;
 	 }
-	 AuUSBMSCWrite(dev, lba, count, disk->blockSize, buffer);
+	 msc->blockSize = disk->blockSize;
+	 if (AuUSBMSCTransfer(msc, true, lba, count, (uint64_t)buffer) != 0)
+		 return -1;
 	 return count;
 }
+
+/*
+ * AuUSBMSCSetupUAS -- switch to the UAS alternate setting
+ * and look up its pipes, UAS is used only when the host
+ * gives us streams on the bulk pipes, otherwise the device
+ * stays on Bulk-Only transport
+ * @param msc -- Pointer to mass storage device
+ * @param config -- configuration descriptor
+ * @param uasIface -- UAS interface descriptor
+ * @param botAlt -- alternate setting of BOT interface
+ * @return true if UAS is usable
+ */
+bool AuUSBMSCSetupUAS(USBMassStorage* msc, AuUSBConfigDesc* config, AuUSBInterfaceDesc* uasIface, int botAlt) {
+	AuUSBDeviceStruc* dev = msc->dev;
+	if (!dev->AuSetInterface || dev->AuSetInterface(dev, uasIface->bInterfaceNumber, uasIface->bAlternateSetting) != 0)
+		return false;
+
+	/* every endpoint is followed by a pipe usage descriptor
+	 * telling what the pipe is used for */
+	uint8_t pipeAddr[5];
+	memset(pipeAddr, 0, 5);
+	uint8_t lastEndpoint = 0;
+	AuUSBDescriptor* desc = raw_offset<AuUSBDescriptor*>(uasIface, uasIface->bLength);
+	while (raw_diff(desc, config) < config->wTotalLength) {
+		if (desc->bLength == 0 || desc->bDescriptorType == 4)
+			break;
+		if (desc->bDescriptorType == 5)
+			lastEndpoint = ((AuUSBEndpointDesc*)desc)->bEndpointAddress;
+		if (desc->bDescriptorType == UAS_PIPE_USAGE_DESCRIPTOR) {
+			uint8_t pipeID = ((uint8_t*)desc)[2];
+			if (pipeID >= UAS_PIPE_COMMAND && pipeID <= UAS_PIPE_DATA_OUT)
+				pipeAddr[pipeID] = lastEndpoint;
+		}
+		desc = raw_offset<AuUSBDescriptor*>(desc, desc->bLength);
+	}
+
+	msc->cmdPipe = dev->AuGetEndpointByAddress(dev, pipeAddr[UAS_PIPE_COMMAND]);
+	msc->statusPipe = dev->AuGetEndpointByAddress(dev, pipeAddr[UAS_PIPE_STATUS]);
+	msc->dataInPipe = dev->AuGetEndpointByAddress(dev, pipeAddr[UAS_PIPE_DATA_IN]);
+	msc->dataOutPipe = dev->AuGetEndpointByAddress(dev, pipeAddr[UAS_PIPE_DATA_OUT]);
+
+	uint16_t streams = 0;
+	if (msc->cmdPipe && msc->statusPipe && msc->dataInPipe && msc->dataOutPipe) {
+		streams = dev->AuGetMaxStreams(dev, msc->statusPipe);
+		if (dev->AuGetMaxStreams(dev, msc->dataInPipe) < streams)
+			streams = dev->AuGetMaxStreams(dev, msc->dataInPipe);
+		if (dev->AuGetMaxStreams(dev, msc->dataOutPipe) < streams)
+			streams = dev->AuGetMaxStreams(dev, msc->dataOutPipe);
+	}
+
+	/* stream 0 is reserved, atleast one usable stream needed */
+	if (streams < 2) {
+		AuTextOut("USB MSC -- UAS without streams not supported, using Bulk-Only \n");
+		if (botAlt >= 0)
+			dev->AuSetInterface(dev, uasIface->bInterfaceNumber, botAlt);
+		return false;
+	}
+
+	msc->uas = true;
+	msc->depth = streams - 1;
+	if (msc->depth > MSC_UAS_QUEUE_DEPTH)
+		msc->depth = MSC_UAS_QUEUE_DEPTH;
+	return true;
+}
+
 /*
 * AuUSBDriverMain -- Main entry for USB driver 
 */
 AU_EXTERN AU_EXPORT int AuUSBDriverMain(AuUSBDeviceStruc* dev) {
-	if (dev->classCode == 0x08 && dev->subClassCode == 0x6 && dev->protocol == 0x50) {
+	if (dev->classCode == 0x08 && dev->subClassCode == 0x6 && dev->protocol == MSC_PROTOCOL_BOT) {
 		AuTextOut("USB-MSC class attached \n");
 	}
 
-	uint8_t mscInterfaceNumber = 0;
+	USBMassStorage* msc = (USBMassStorage*)kmalloc(sizeof(USBMassStorage));
+	memset(msc, 0, sizeof(USBMassStorage));
+	msc->dev = dev;
+	msc->depth = MSC_BOT_PIPELINE_DEPTH;
+	msc->cmdArea = (uint8_t*)P2V((uint64_t)AuPmmngrAlloc());
+	msc->statusArea = (uint8_t*)P2V((uint64_t)AuPmmngrAlloc());
+	memset(msc->cmdArea, 0, 4096);
+	memset(msc->statusArea, 0, 4096);
+
 	AuUSBConfigDesc* config = (AuUSBConfigDesc*)dev->descriptor;
 	AuUSBInterfaceDesc* interface_desc = raw_offset<AuUSBInterfaceDesc*>(config, config->bLength);
 
 	/* 
 	 * Extract the interface number for Mass Storage class 
-	 * it will reside in Interface Class 0x08
+	 * it will reside in Interface Class 0x08, a UAS capable
+	 * device lists UAS as another alternate setting
 	 */
-	AuUSBInterfaceDesc* iface = interface_desc;
-	for (int i = 0; i < config->bNumInterfaces; i++) {
-		if (iface->bInterfaceClass == 0x08) {
-			mscInterfaceNumber = iface->bInterfaceNumber;
+	AuUSBInterfaceDesc* uasIface = NULL;
+	int botAlt = -1;
+	AuUSBDescriptor* desc = (AuUSBDescriptor*)interface_desc;
+	while (raw_diff(desc, config) < config->wTotalLength) {
+		if (desc->bLength == 0)
+			break;
+		if (desc->bDescriptorType == 4) {
+			AuUSBInterfaceDesc* iface = (AuUSBInterfaceDesc*)desc;
+			if (iface->bInterfaceClass == 0x08) {
+				msc->interfaceNum = iface->bInterfaceNumber;
+				if (iface->bInterfaceProtocol == MSC_PROTOCOL_UAS && !uasIface)
+					uasIface = iface;
+				if (iface->bInterfaceProtocol == MSC_PROTOCOL_BOT && botAlt < 0)
+					botAlt = iface->bAlternateSetting;
+			}
 		}
-		iface = raw_offset<AuUSBInterfaceDesc*>(iface, iface->bLength);
+		desc = raw_offset<AuUSBDescriptor*>(desc, desc->bLength);
 	}
 
-	AuUSBEndpointDesc* endp = raw_offset<AuUSBEndpointDesc*>(interface_desc, interface_desc->bLength);
-	while (raw_diff(endp, config) < config->wTotalLength) {
-		uint8_t endpointAddr = endp->bEndpointAddress;
-		uint8_t attrib = endp->bmAttributes;
-		if ((attrib & 0x03) == 0x02) { //Bulk transfer
-			if (endpointAddr & 0x80) {
-				AuTextOut("Bulk IN/ endpoint found \n");
-				AuTextOut("Bulk IN max pack -> %d \n", (endp->wMaxPacketSize & 0x7FFF));
-			}
-			else {
-				AuTextOut("Bulk OUT/ endpoint found \n");
-				AuTextOut("BULK OUT MaxPACk -> %d \n", (endp->wMaxPacketSize & 0x7FFF));
+	if (uasIface)
+		AuUSBMSCSetupUAS(msc, config, uasIface, botAlt);
 
-			}
+	if (!msc->uas) {
+		if (botAlt < 0) {
+			AuTextOut("USB MSC -- no usable transport \n");
+			return -1;
 		}
-
-		endp = raw_offset<AuUSBEndpointDesc*>(endp, endp->bLength);
+		msc->bulkIn = dev->AuGetBulkEndpoint(dev, 1);
+		if (msc->bulkIn)
+			AuTextOut("USB MSC Bulk-in ep found \n");
+
+		msc->bulkOut = dev->AuGetBulkEndpoint(dev, 0);
+		if (msc->bulkOut)
+			AuTextOut("USB MSC Bulk-out ep found \n");
+
+		/* Reset the USB MSC Device */
+		AuUSBRequestPacket pack;
+		pack.request_type = 0x21;
+		pack.request = 0xFF;
+		pack.value = 0x0000;
+		pack.index = msc->interfaceNum;
+		pack.length = 0x0000;
+		dev->AuControlTransfer(dev, &pack, 0, 0);
+		dev->AuUSBWait(dev, USB_WAIT_EVENT_TRANSFER);
 	}
-
-	void* ep_bulk_in = dev->AuGetBulkEndpoint(dev, 1);
-	if (ep_bulk_in) {
-		AuTextOut("USB MSC Bulk-in ep found \n");
+	else {
+		AuTextOut("USB MSC -- using UAS with %d commands in flight \n", msc->depth);
 	}
 
-	bulkIn = ep_bulk_in;
-
-	void* ep_bulk_out = dev->AuGetBulkEndpoint(dev, 0);
-	if (ep_bulk_out)
-		AuTextOut("USB MSC Bulk-out ep found \n");
-
-	bulkOut = ep_bulk_out;
-
-	/* Reset the USB MSC Device */
-	AuUSBRequestPacket pack;
-	pack.request_type = 0x21;
-	pack.request = 0xFF;
-	pack.value = 0x0000;
-	pack.index = mscInterfaceNumber;
-	pack.length = 0x0000;
-	dev->AuControlTransfer(dev, &pack, 0, 0);
-	int t_idx = -1;
-	t_idx = dev->AuUSBWait(dev, USB_WAIT_EVENT_TRANSFER);
-
-	SCSICommand* cbw = (SCSICommand*)P2V((uint64_t)AuPmmngrAlloc());
 	SCSIInquiryResponse* resp = (SCSIInquiryResponse*)P2V((uint64_t)AuPmmngrAlloc());
-	memset(resp, 0, sizeof(SCSIInquiryResponse));
-	memset(cbw, 0, sizeof(SCSICommand));
+	memset(resp, 0, 4096);
 
-	cbw->signature = SCSI_CMD_BLK_SIGNATURE;
-	cbw->tag = 0x12345678;
-	cbw->dataBytes = sizeof(SCSIInquiryResponse);
-	cbw->flags = SCSI_CMD_FLAG_INPUT;
-	cbw->lun = 0;
-	cbw->cmdBytes = 6;
-	cbw->cmd[0] = 0x12;
-	cbw->cmd[4] = sizeof(SCSIInquiryResponse);
+	uint8_t cdb[16];
+	memset(cdb, 0, 16);
+	cdb[0] = 0x12;
+	cdb[4] = sizeof(SCSIInquiryResponse);
 
-	AuUSBMSCSendCommand(dev, ep_bulk_in, ep_bulk_out, (SCSICommand*)V2P((uint64_t)cbw), 
-		(void*)V2P((uint64_t)resp), sizeof(SCSIInquiryResponse));
+	AuUSBMSCSendCommand(msc, cdb, 6, V2P((uint64_t)resp), sizeof(SCSIInquiryResponse));
 	AuTextOut("\nUSB Mass Storage device : %s \n", resp->vendorID);
 
 	AuVDisk* disk = AuCreateVDisk();
@@ -390,31 +656,59 @@ AU_EXTERN AU_EXPORT int AuUSBDriverMain(AuUSBDeviceStruc* dev) {
 	kfree(usbdiskname);
 	//strcpy(disk->diskname,resp->productID);
 
-	memset(cbw, 0, 4096);
-	cbw->signature = SCSI_CMD_BLK_SIGNATURE;
-	cbw->tag = 0x12345678;
-	cbw->dataBytes = sizeof(SCSICapacityResponse);
-	cbw->flags = 0x80; //device-to-host
-	cbw->lun = 0;
-	cbw->cmdBytes = sizeof(SCSIReadCapacity);
-	SCSIReadCapacity readcap;
-	readcap.opcode = 0x25; //read capacity 10
-	memcpy(&cbw->cmd, &readcap, sizeof(SCSIReadCapacity));
+	memset(cdb, 0, 16);
+	SCSIReadCapacity* readcap = (SCSIReadCapacity*)cdb;
+	readcap->opcode = 0x25; //read capacity 10
 
 	memset(resp, 0, 4096);
 	SCSICapacityResponse* capresp = (SCSICapacityResponse*)resp;
 
-	AuUSBMSCSendCommand(dev, ep_bulk_in, ep_bulk_out, (SCSICommand*)V2P((uint64_t)cbw),
-		(void*)V2P((uint64_t)capresp), sizeof(SCSICapacityResponse));
+	AuUSBMSCSendCommand(msc, cdb, 10, V2P((uint64_t)capresp), sizeof(SCSICapacityResponse));
 
 	uint32_t lbaCount = convEndian(capresp->lbaCount);
 	uint32_t blockSz = convEndian(capresp->blockSize);
+	if (blockSz == 0)
+		blockSz = 512;
 
 	uint64_t totalSz = ((uint64_t)lbaCount + 1) * blockSz;
 	AuTextOut("USB MSC Capacity %f GB \n", ((double)totalSz / (1024 * 1024 * 1024)));
 
-	
-	disk->data = dev;
+	/*
+	 * Transfer length limit, READ(10)/WRITE(10) carry 16 bit
+	 * block count, device may report a smaller limit in
+	 * Block Limits VPD page
+	 */
+	msc->blockSize = blockSz;
+	msc->maxBlocks = MSC_MAX_TRANSFER_BYTES / blockSz;
+	if (msc->maxBlocks > 0xFFFF)
+		msc->maxBlocks = 0xFFFF;
+	if (msc->maxBlocks == 0)
+		msc->maxBlocks = 1;
+
+	/* a device not knowing the page fails the command and
+	 * recovery turns pipelining off, which is not the
+	 * device's fault, so keep the depth */
+	int depth = msc->depth;
+	memset(cdb, 0, 16);
+	cdb[0] = 0x12;
+	cdb[1] = 0x01; //EVPD
+	cdb[2] = 0xB0; //Block Limits
+	cdb[4] = 64;
+	memset(resp, 0, 4096);
+	uint8_t* vpd = (uint8_t*)resp;
+	if (AuUSBMSCSendCommand(msc, cdb, 6, V2P((uint64_t)vpd), 64) == 0 && vpd[1] == 0xB0) {
+		uint32_t maxXfer = ((uint32_t)vpd[8] << 24) | ((uint32_t)vpd[9] << 16) | ((uint32_t)vpd[10] << 8) | vpd[11];
+		if (maxXfer != 0 && maxXfer < msc->maxBlocks)
+			msc->maxBlocks = maxXfer;
+	}
+	else {
+		if (msc->maxBlocks > MSC_DEFAULT_MAX_BLOCKS)
+			msc->maxBlocks = MSC_DEFAULT_MAX_BLOCKS;
+	}
+	msc->depth = depth;
+	AuTextOut("USB MSC max transfer %d blocks \n", msc->maxBlocks);
+
+	disk->data = msc;
 	disk->Read =0;
 	disk->Write =0;
 	disk->max_blocks = lbaCount;
@@ -448,8 +742,7 @@ AU_EXTERN AU_EXPORT int AuUSBDriverMain(AuUSBDeviceStruc* dev) {
 
 
 	AuPmmngrFree((void*)V2P((uint64_t)resp));
-	AuPmmngrFree((void*)V2P((uint64_t)cbw));
-	AuTextOut("USB MSC driver initialised %d \n", t_idx);
+	AuTextOut("USB MSC driver initialised \n");
 
 	return 0;
-}
\ No newline at end of file
+}
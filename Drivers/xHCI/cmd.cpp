@@ -32,6 +32,11 @@
 #include <Mm/vmmngr.h>
 #include <aucon.h>
 #include <Hal/serial.h>
+#include <Mm/pmmngr.h>
+#include <_null.h>
+#include <Hal/x86_64_cpu.h>
+#include <Hal/x86_64_lowlevel.h>
+#include <Hal/x86_64_sched.h>
 
 /*
  * XHCIEvaluateContextCmd -- evaluate context command
@@ -213,61 +218,249 @@ void XHCISendNormalTRB(XHCIDevice* dev, XHCISlot* slot, uint64_t data_buffer, ui
 }
 
 /*
- * XHCIBulkTransfer -- Bulk transfer callback
+ * XHCIQueueTD -- queue one transfer descriptor on an endpoint
+ * and ring its doorbell, the buffer is split into normal
+ * trbs at 64KiB boundaries, only the last trb interrupts
  * @param dev -- Pointer to host device structure
  * @param slot -- Pointer to device slot
- * @param buffer -- Pointer to memory buffer
+ * @param ep -- Pointer to endpoint structure
+ * @param stream -- stream id, 0 for endpoints without streams
+ * @param buffer -- physical address of the buffer
  * @param data_len -- total data length
- * @param ep_ -- Pointer to endpoint structure
+ * @return sequence number of the TD, 0 on failure
  */
-void XHCIBulkTransfer(XHCIDevice* dev, XHCISlot* slot, uint64_t buffer, uint16_t data_len, XHCIEndpoint* ep_) {
-	size_t pos = 0;
-	while (pos != data_len) {
-		size_t cnt = PAGE_SIZE - ((buffer + pos) & (PAGE_SIZE - 1));
-		bool last = cnt >= data_len - pos;
-		if (last) cnt = data_len - pos;
-		size_t remaining_pack = (data_len - pos + ep_->max_packet_sz - 1) / ep_->max_packet_sz;
+uint32_t XHCIQueueTD(XHCIDevice* dev, XHCISlot* slot, XHCIEndpoint* ep, uint16_t stream, uint64_t buffer, uint32_t data_len) {
+	if (!ep || ep->halted)
+		return 0;
+
+	xhci_trb_t* ring = ep->cmd_ring;
+	unsigned* index = &ep->cmd_ring_index;
+	unsigned* cycle = &ep->cmd_ring_cycle;
+	volatile uint32_t* queued = &ep->queued;
+	if (ep->num_streams) {
+		if (stream == 0 || stream >= ep->num_streams)
+			return 0;
+		ring = ep->streams[stream].ring;
+		index = &ep->streams[stream].index;
+		cycle = &ep->streams[stream].cycle;
+		queued = &ep->streams[stream].queued;
+	}
+
+	/* count the trbs first, a TD must never be larger than
+	 * the ring itself */
+	uint32_t num_trbs = 0;
+	uint64_t pos = 0;
+	do {
+		uint64_t cnt = XHCI_TRB_MAX_BUFFER - ((buffer + pos) & (XHCI_TRB_MAX_BUFFER - 1));
+		if (cnt > data_len - pos)
+			cnt = data_len - pos;
+		pos += cnt;
+		num_trbs++;
+	} while (pos < data_len);
+
+	if (num_trbs >= XHCI_TRANSFER_RING_TRBS)
+		return 0;
+
+	uint16_t max_packet = ep->max_packet_sz ? ep->max_packet_sz : 512;
+	pos = 0;
+	for (uint32_t i = 0; i < num_trbs; i++) {
+		uint64_t cnt = XHCI_TRB_MAX_BUFFER - ((buffer + pos) & (XHCI_TRB_MAX_BUFFER - 1));
+		if (cnt > data_len - pos)
+			cnt = data_len - pos;
+		bool last = (i == num_trbs - 1);
+
+		/* TD size -- packets remaining after this trb */
+		uint32_t td_size = 0;
+		if (!last) {
+			uint64_t remaining = data_len - pos - cnt;
+			td_size = (uint32_t)((remaining + max_packet - 1) / max_packet);
+			if (td_size > 31)
+				td_size = 31;
+		}
 
 		uint32_t ctrl = (TRB_TRANSFER_NORMAL << 10);
-		
 		/*
-		 * Put the chain bit to make it a TD
+		 * chain bit joins the trbs into a single TD, only
+		 * the last one generates completion event
 		 */
-		if (!last) {
+		if (!last)
 			ctrl |= (1 << 4);
-		}
-
-		if (last)
+		else
 			ctrl |= (1 << 5);
 
+		uint64_t addr = buffer + pos;
+		XHCIRingEnqueue(ring, index, cycle, XHCI_TRANSFER_RING_TRBS, addr & UINT32_MAX, (addr >> 32) & UINT32_MAX,
+			(td_size << 17) | (cnt & 0x1FFFF), ctrl);
+		pos += cnt;
+	}
 
-		/*
-		 * put the immediate data bit if it's in
-		 */
-		if (ep_->dir) {
-			//SeTextOut("This ep -> %d , is IN \r\n", ep_->endpoint_num);
-			ctrl |= (1 << 6);
+	*queued = *queued + 1;
+	uint32_t seq = *queued;
+
+	XHCIRingDoorbellSlot(dev, slot->slot_id, ep->dci | ((uint32_t)stream << 16));
+	return seq;
+}
+
+/*
+ * XHCITransferComplete -- account a transfer event to its
+ * endpoint, called from event interrupt
+ * @param dev -- Pointer to host device structure
+ * @param ep -- Pointer to endpoint structure
+ * @param trb -- Pointer to the transfer event trb
+ */
+void XHCITransferComplete(XHCIDevice* dev, XHCIEndpoint* ep, xhci_trb_t* trb) {
+	uint8_t comp_code = (trb->trb_status >> 24) & 0xff;
+	uint32_t residue = trb->trb_status & 0xFFFFFF;
+	uint64_t trb_ptr = ((uint64_t)trb->trb_param_2 << 32) | trb->trb_param_1;
+
+	if (ep->num_streams) {
+		/* every stream ring is a single page, so the stream
+		 * is found by the page of the completed trb */
+		for (int i = 1; i < ep->num_streams; i++) {
+			if (V2P((uint64_t)ep->streams[i].ring) == (trb_ptr & ~(PAGE_SIZE - 1))) {
+				ep->streams[i].comp_code = comp_code;
+				ep->streams[i].residue = residue;
+				ep->streams[i].completed++;
+				break;
+			}
 		}
+	}
+	else {
+		ep->comp_code = comp_code;
+		ep->residue = residue;
+		ep->completed++;
+	}
 
+	if (comp_code != XHCI_COMP_SUCCESS && comp_code != XHCI_COMP_SHORT_PACKET) {
+		ep->comp_code = comp_code;
+		ep->halted = true;
+	}
 
-		if (ep_ != 0) {
-			XHCISendCmdOtherEP(slot, ep_->endpoint_num, buffer & UINT32_MAX, (buffer >> 32) & UINT32_MAX,
-				((remaining_pack & 0xFFFF) << 17) | cnt & UINT16_MAX,
-				ctrl);
+	if (ep->wait_lock && AuIsSchedulerInitialised()) {
+		AuAcquireSpinlock(ep->wait_lock);
+		AuThread* waiter = ep->waiter;
+		ep->waiter = NULL;
+		if (waiter)
+			AuWakeThread(waiter);
+		AuReleaseSpinlock(ep->wait_lock);
+	}
+}
+
+/*
+ * XHCIWaitTD -- wait until the TD with given sequence
+ * number has completed, the caller sleeps until the
+ * event interrupt wakes it up or the endpoint goes
+ * XHCI_TD_TIMEOUT_MS without a completion, before the
+ * scheduler is running it spins
+ * @param dev -- Pointer to host device structure
+ * @param ep -- Pointer to endpoint structure
+ * @param stream -- stream id, 0 for endpoints without streams
+ * @param seq -- sequence number returned by XHCIQueueTD
+ * @return completion code of the last completed TD, -1 on
+ * timeout
+ */
+int XHCIWaitTD(XHCIDevice* dev, XHCIEndpoint* ep, uint16_t stream, uint32_t seq) {
+	if (!ep || seq == 0)
+		return -1;
+	volatile uint32_t* completed = &ep->completed;
+	volatile uint8_t* comp_code = &ep->comp_code;
+	if (ep->num_streams) {
+		if (stream == 0 || stream >= ep->num_streams)
+			return -1;
+		completed = &ep->streams[stream].completed;
+		comp_code = &ep->streams[stream].comp_code;
+	}
+
+	if (AuIsSchedulerInitialised() && ep->wait_lock) {
+		AuThread* thr = AuGetCurrentThread();
+		x64_cli();
+		AuAcquireSpinlock(ep->wait_lock);
+		/* completion is checked and the waiter published
+		 * under the lock the event handler takes, so a
+		 * completion can't slip in between */
+		while ((int32_t)(*completed - seq) < 0 && !ep->halted) {
+			ep->waiter = thr;
+			AuSleepThread(thr, XHCI_TD_TIMEOUT_MS);
+			AuReleaseSpinlock(ep->wait_lock);
+			AuForceScheduler();
+			x64_cli();
+			AuAcquireSpinlock(ep->wait_lock);
+			if (ep->waiter == thr) {
+				/* sleep expired, handler never cleared us */
+				ep->waiter = NULL;
+				AuReleaseSpinlock(ep->wait_lock);
+				return -1;
+			}
 		}
-		else {
-			XHCISendCmdToHost(dev, buffer & UINT32_MAX, (buffer >> 32) & UINT32_MAX, ((remaining_pack & 0xFFFF) << 17) | cnt & UINT16_MAX,
-				(TRB_TRANSFER_NORMAL << 10) | (1 << 6) | (1 << 5));
+		AuReleaseSpinlock(ep->wait_lock);
+	}
+	else {
+		int timeout = 50000;
+		while ((int32_t)(*completed - seq) < 0 && !ep->halted) {
+			if (timeout <= 0)
+				return -1;
+			x86_64_udelay(100);
+			timeout--;
 		}
+	}
 
-		pos += cnt;
-		buffer += ep_->max_packet_sz;
+	/* halted before our TD completed, report the error */
+	if ((int32_t)(*completed - seq) < 0)
+		return ep->comp_code;
+	return *comp_code;
+}
+
+/*
+ * XHCIResetEndpoint -- recover a halted endpoint, pending
+ * TDs are discarded and dequeue pointer is moved to the
+ * current enqueue position
+ * @param dev -- Pointer to host device structure
+ * @param slot -- Pointer to device slot
+ * @param ep -- Pointer to endpoint structure
+ */
+void XHCIResetEndpoint(XHCIDevice* dev, XHCISlot* slot, XHCIEndpoint* ep) {
+	if (!ep)
+		return;
+	/* reset endpoint command is only valid on halted endpoint,
+	 * a running one has to be stopped before moving its
+	 * dequeue pointer */
+	uint32_t cmd = ep->halted ? TRB_CMD_RESET_ENDPOINT : TRB_CMD_STOP_ENDPOINT;
+	XHCISendCmdToHost(dev, 0, 0, 0, (cmd << 10) | ((uint32_t)slot->slot_id << 24) |
+		((uint32_t)ep->dci << 16));
+	XHCIRingDoorbellHost(dev);
+	XHCIPollEvent(dev, TRB_EVENT_CMD_COMPLETION);
+
+	if (ep->num_streams) {
+		for (int i = 1; i < ep->num_streams; i++) {
+			XHCIStreamRing* s = &ep->streams[i];
+			uint64_t deq = V2P((uint64_t)s->ring) + s->index * sizeof(xhci_trb_t);
+			XHCISendCmdToHost(dev, (deq & UINT32_MAX) | (1 << 1) | (s->cycle & 1), (deq >> 32) & UINT32_MAX,
+				(uint32_t)i << 16, (TRB_CMD_SET_TR_DEQ_POINTER << 10) | ((uint32_t)slot->slot_id << 24) |
+				((uint32_t)ep->dci << 16));
+			XHCIRingDoorbellHost(dev);
+			XHCIPollEvent(dev, TRB_EVENT_CMD_COMPLETION);
+			s->completed = s->queued;
+		}
 	}
+	else {
+		uint64_t deq = V2P((uint64_t)ep->cmd_ring) + ep->cmd_ring_index * sizeof(xhci_trb_t);
+		XHCISendCmdToHost(dev, (deq & UINT32_MAX) | (ep->cmd_ring_cycle & 1), (deq >> 32) & UINT32_MAX, 0,
+			(TRB_CMD_SET_TR_DEQ_POINTER << 10) | ((uint32_t)slot->slot_id << 24) | ((uint32_t)ep->dci << 16));
+		XHCIRingDoorbellHost(dev);
+		XHCIPollEvent(dev, TRB_EVENT_CMD_COMPLETION);
+		ep->completed = ep->queued;
+	}
+	ep->halted = false;
+}
 
-	uint32_t ep_num = 0;
-	if (ep_)
-		ep_num = ep_->dci;
-	else
-		ep_num = XHCI_DOORBELL_ENDPOINT_0;
-	XHCIRingDoorbellSlot(dev, slot->slot_id, ep_num);
-}
\ No newline at end of file
+/*
+ * XHCIBulkTransfer -- Bulk transfer callback
+ * @param dev -- Pointer to host device structure
+ * @param slot -- Pointer to device slot
+ * @param buffer -- Pointer to memory buffer
+ * @param data_len -- total data length
+ * @param ep_ -- Pointer to endpoint structure
+ */
+void XHCIBulkTransfer(XHCIDevice* dev, XHCISlot* slot, uint64_t buffer, uint32_t data_len, XHCIEndpoint* ep_) {
+	XHCIQueueTD(dev, slot, ep_, 0, buffer, data_len);
+}
@@ -219,7 +219,7 @@ void XHCIHandleEventInterrupt() {
 			uint8_t endpoint_id = (event[xhcidev->evnt_ring_index].trb_control >> 16) & 0x1f;
 			uint8_t comp_code = (event[xhcidev->evnt_ring_index].trb_status >> 24) & 0xff;
 			uint8_t slot_id = (event[xhcidev->evnt_ring_index].trb_control >> 24) & 0xff;
-			uint64_t data = (event[xhcidev->evnt_ring_index].trb_param_1 | event[xhcidev->evnt_ring_index].trb_param_2);
+			uint64_t data = ((uint64_t)event[xhcidev->evnt_ring_index].trb_param_2 << 32) | event[xhcidev->evnt_ring_index].trb_param_1;
 			xhcidev->event_available = true;
 			xhcidev->poll_return_trb_type = TRB_EVENT_TRANSFER;
 			xhcidev->trb_event_index = xhcidev->evnt_ring_index;
@@ -228,11 +228,17 @@ void XHCIHandleEventInterrupt() {
 			/* check if this event belongs to endpoint */
 			if (endpoint_id >= 2) {
 				XHCISlot* slot = XHCIGetSlotByID(xhcidev, slot_id);
-				XHCIEndpoint* ep = XHCISlotGetEP_DCI(slot, endpoint_id);
-
-				/* if belongs, call the handler of that endpoint */
-				if (ep->callback)
-					ep->callback(xhcidev, slot, ep);
+				XHCIEndpoint* ep = NULL;
+				if (slot)
+					ep = XHCISlotGetEP_DCI(slot, endpoint_id);
+
+				/* if belongs, account the completion and call the
+				 * handler of that endpoint */
+				if (ep) {
+					XHCITransferComplete(xhcidev, ep, trb);
+					if (ep->callback)
+						ep->callback(xhcidev, slot, ep);
+				}
 			}
 		}
 
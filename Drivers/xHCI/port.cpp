@@ -123,7 +123,7 @@ XHCISlot* XHCICreateDeviceCtx(XHCIDevice* dev, uint8_t slot_num, uint8_t port_sp
 	slot->cmd_ring[slot->cmd_ring_max].trb_param_1 = V2P(slot->cmd_ring_base) & UINT32_MAX;
 	slot->cmd_ring[slot->cmd_ring_max].trb_param_2 = (V2P(slot->cmd_ring_base) >> 32) & UINT32_MAX;
 	slot->cmd_ring[slot->cmd_ring_max].trb_status = 0;
-	slot->cmd_ring[slot->cmd_ring_max].trb_control = TRB_TRANSFER_LINK << 10 | (1 << 5) | (slot->cmd_ring_cycle & 0x1);
+	slot->cmd_ring[slot->cmd_ring_max].trb_control = TRB_TRANSFER_LINK << 10 | (1 << 1) | (slot->cmd_ring_cycle & 0x1);
 	XHCIAddSlot(dev, slot);
 
 	/* Here we need an function, which will issues commands to this slot */
@@ -148,20 +148,187 @@ XHCISlot* XHCIGetSlot(XHCIDevice* dev, uint8_t port_num) {
 	return NULL;
 }
 
+/*
+ * XHCIFreeEndpoint -- free an endpoint and its rings
+ * @param ep -- Pointer to endpoint structure
+ */
+void XHCIFreeEndpoint(XHCIEndpoint* ep) {
+	if (ep->streams) {
+		for (int i = 1; i < ep->num_streams; i++)
+			AuPmmngrFree((void*)V2P((uint64_t)ep->streams[i].ring));
+		kfree(ep->streams);
+		AuPmmngrFree((void*)ep->stream_ctx_phys);
+	}
+	else {
+		AuPmmngrFree((void*)V2P((uint64_t)ep->cmd_ring));
+	}
+	kfree(ep);
+}
+
 /*
  * XHCISlotReleaseEndpoints -- release all endpoint
  * @param slot -- Pointer to device slot
  */
 void XHCISlotReleaseEndpoints(XHCISlot* slot) {
-	for (int i = 0; i < slot->endpoints->pointer; i++) {
-		XHCIEndpoint* ep = (XHCIEndpoint*)list_remove(slot->endpoints, i);
-		if (ep) {
-			AuPmmngrFree((void*)V2P((uint64_t)slot->cmd_ring));
-			kfree(ep);
-		}
+	while (slot->endpoints->pointer > 0) {
+		XHCIEndpoint* ep = (XHCIEndpoint*)list_remove(slot->endpoints, 0);
+		if (ep)
+			XHCIFreeEndpoint(ep);
 	}
 }
 
+/*
+ * XHCICreateTransferRing -- allocate a transfer ring page
+ * with a link trb pointing back to its start
+ */
+static xhci_trb_t* XHCICreateTransferRing() {
+	uint64_t ring = (uint64_t)P2V((uint64_t)AuPmmngrAlloc());
+	memset((void*)ring, 0, 4096);
+	xhci_trb_t* trb = (xhci_trb_t*)ring;
+	/* insert a link trb at the last of ring, toggle cycle
+	 * bit is set so that producer and consumer flip their
+	 * cycle state on wrap */
+	trb[XHCI_TRANSFER_RING_TRBS].trb_param_1 = V2P(ring) & UINT32_MAX;
+	trb[XHCI_TRANSFER_RING_TRBS].trb_param_2 = (V2P(ring) >> 32) & UINT32_MAX;
+	trb[XHCI_TRANSFER_RING_TRBS].trb_status = 0;
+	trb[XHCI_TRANSFER_RING_TRBS].trb_control = TRB_TRANSFER_LINK << 10 | (1 << 1) | 1;
+	return trb;
+}
+
+/*
+ * XHCISetupEndpoint -- fill the input context for an endpoint
+ * descriptor and create its transfer ring(s), the caller is
+ * responsible for issuing configure endpoint command
+ * @param dev -- Pointer to host device structure
+ * @param slot -- Pointer to device slot
+ * @param endp_ -- endpoint descriptor
+ * @param ss_cmp -- SuperSpeed endpoint companion descriptor, can
+ * be null
+ */
+XHCIEndpoint* XHCISetupEndpoint(XHCIDevice* dev, XHCISlot* slot, void* endp_, uint8_t* ss_cmp) {
+	usb_endpoint_desc_t* endp = (usb_endpoint_desc_t*)endp_;
+	uint64_t input_ctx_virt = P2V(slot->input_context_phys);
+
+	uint8_t endp_num = endp->bEndpointAddress & 0xf;
+	uint8_t dir = (endp->bEndpointAddress >> 7) & 0xf;
+	uint16_t max_packet_sz = endp->wMaxPacketSize & 0x7FF;
+	uint8_t max_burst_sz = (endp->wMaxPacketSize & 0x1800) >> 11;
+	uint8_t transfer_type = endp->bmAttributes & 0x3;
+	uint8_t interval = endp->bInterval;
+	uint16_t ici = ((endp_num * 2) + 1) + dir;
+	uint16_t dci = ((endp_num * 2) + dir);
+	if (transfer_type == ENDPOINT_TRANSFER_TYPE_CONTROL) {
+		ici = (endp_num + 1) * 2;
+		dci = (endp_num * 2) + 1;
+	}
+	if (endp_num == 0)
+		ici = (endp_num + 1) * 2;
+	uint64_t addr = (static_cast<uint64_t>(ici) * 32);
+	uint64_t dc_addr = (static_cast<uint64_t>(dci) * 32);
+	uint8_t ep_type = 0;
+	uint8_t cerr = 3;
+	switch (transfer_type) {
+	case ENDPOINT_TRANSFER_TYPE_CONTROL:
+		ep_type = 4;
+		break;
+	case ENDPOINT_TRANSFER_TYPE_ISOCH:
+		if (dir) //IF DIR 1, THEN TYPE IS IN
+			ep_type = 5;
+		else
+			ep_type = 1;
+		cerr = 0; // counter error doesn't apply for isoch transfer
+		break;
+	case ENDPOINT_TRANSFER_TYPE_BULK:
+		if (dir)
+			ep_type = 6;
+		else
+			ep_type = 2;
+		break;
+	case ENDPOINT_TRANSFER_TYPE_INT:
+		if (dir)
+			ep_type = 7;
+		else
+			ep_type = 3;
+		break;
+	}
+
+	/* SuperSpeed devices report burst size and streams in
+	 * companion descriptor */
+	uint8_t streams_log2 = 0;
+	if (ss_cmp && ss_cmp[1] == USB_DESCRIPTOR_SUPERSPEED_ENDP_CMP) {
+		max_burst_sz = ss_cmp[2];
+		if (transfer_type == ENDPOINT_TRANSFER_TYPE_BULK) {
+			streams_log2 = ss_cmp[3] & 0x1f;
+			/* MaxPSASize, 0 means streams not supported */
+			uint8_t max_psa = (dev->cap_regs->cap_hccparams1 >> 12) & 0xf;
+			if (streams_log2 > max_psa + 1)
+				streams_log2 = max_psa + 1;
+			if (max_psa == 0)
+				streams_log2 = 0;
+			if (streams_log2 > XHCI_MAX_STREAMS_LOG2)
+				streams_log2 = XHCI_MAX_STREAMS_LOG2;
+		}
+	}
+
+	XHCIEndpoint* ep = (XHCIEndpoint*)kmalloc(sizeof(XHCIEndpoint));
+	memset(ep, 0, sizeof(XHCIEndpoint));
+	ep->cmd_ring_cycle = 1;
+	ep->cmd_ring_max = XHCI_TRANSFER_RING_TRBS;
+	ep->endpoint_num = endp_num;
+	ep->endpoint_type = transfer_type;
+	ep->interval = interval;
+	ep->max_packet_sz = max_packet_sz;
+	ep->max_burst = max_burst_sz;
+	ep->dci = dci;
+	ep->offset = addr;
+	ep->ep_type = transfer_type;
+	ep->dc_offset = dc_addr;
+	ep->dir = dir;
+	ep->endpointAddress = endp->bEndpointAddress;
+	ep->endpointAttr = endp->bmAttributes;
+	ep->callback = NULL;
+	ep->wait_lock = AuCreateSpinlock(false);
+
+	uint64_t trdp = 0;
+	uint8_t dcs = 1;
+	if (streams_log2) {
+		/* linear primary stream array, stream 0 is reserved */
+		ep->num_streams = (1 << streams_log2);
+		ep->streams = (XHCIStreamRing*)kmalloc(sizeof(XHCIStreamRing) * ep->num_streams);
+		memset(ep->streams, 0, sizeof(XHCIStreamRing) * ep->num_streams);
+		uint64_t ctx_array = (uint64_t)P2V((uint64_t)AuPmmngrAlloc());
+		memset((void*)ctx_array, 0, 4096);
+		uint64_t* stream_ctx = (uint64_t*)ctx_array;
+		for (int i = 1; i < ep->num_streams; i++) {
+			ep->streams[i].ring = XHCICreateTransferRing();
+			ep->streams[i].cycle = 1;
+			/* SCT = 1, primary transfer ring */
+			stream_ctx[i * 2] = V2P((uint64_t)ep->streams[i].ring) | (1 << 1) | 1;
+			stream_ctx[i * 2 + 1] = 0;
+		}
+		ep->stream_ctx_phys = V2P(ctx_array);
+		trdp = ep->stream_ctx_phys;
+		dcs = 0;
+	}
+	else {
+		ep->cmd_ring = XHCICreateTransferRing();
+		trdp = V2P((uint64_t)ep->cmd_ring);
+	}
+
+	*raw_offset<volatile uint32_t*>(input_ctx_virt, 0x4) |= (1 << dci);
+
+	auto max_esit = max_packet_sz * (max_burst_sz + 1);
+	uint8_t max_p_streams = streams_log2 ? (streams_log2 - 1) : 0;
+	*raw_offset<volatile uint32_t*>(input_ctx_virt, addr + 0) = USB_ENDPOINT_CTX_DWORD0(max_esit >> 16, interval,
+		(streams_log2 ? 1 : 0), max_p_streams, 0, 0);
+	*raw_offset<volatile uint32_t*>(input_ctx_virt, addr + 0x04) = USB_ENDPOINT_CTX_DWORD1(max_packet_sz, max_burst_sz, 1, ep_type, cerr);
+	*raw_offset<volatile uint32_t*>(input_ctx_virt, addr + 0x08) = USB_ENDPOINT_CTX_DWORD2(trdp, dcs);
+	*raw_offset<volatile uint32_t*>(input_ctx_virt, addr + 0x0C) = USB_ENDPOINT_CTX_DWORD3(trdp);
+	*raw_offset<volatile uint32_t*>(input_ctx_virt, addr + 0x10) = USB_ENDPOINT_CTX_DWORD4(max_esit, 0x400);
+
+	list_add(slot->endpoints, ep);
+	return ep;
+}
 
 void XHCIPortChecLinkState(xhci_port_regs_t* this_port) {
 #define PORTSC_PLS_MASK (0xF << 5)
@@ -491,104 +658,31 @@ void XHCIPortInitialise(XHCIDevice* dev, unsigned int port) {
 		XHCIEvaluateContextCmd(dev, slot->input_context_phys, slot->slot_id);
 		t_idx = XHCIPollEvent(dev, TRB_EVENT_CMD_COMPLETION);
 
-		uint64_t inte_addr = 0;
 		uint32_t lasti = 0;
+		uint8_t alt_setting = interface_desc->bAlternateSetting;
 		while (raw_diff(endp, config) < config->wTotalLength) {
 
-			if (endp->bDescriptorType != USB_DESCRIPTOR_ENDPOINT) {
+			/* only endpoints of default alternate settings are
+			 * configured here, others share the same endpoint
+			 * numbers and are set up by set interface request */
+			if (endp->bDescriptorType == USB_DESCRIPTOR_INTERFACE) {
+				alt_setting = ((usb_if_desc_t*)endp)->bAlternateSetting;
 				endp = raw_offset<usb_endpoint_desc_t*>(endp, endp->bLength);
 				continue;
 			}
 
-			if (endp->bDescriptorType == USB_DESCRIPTOR_SUPERSPEED_ENDP_CMP) {
+			if (endp->bDescriptorType != USB_DESCRIPTOR_ENDPOINT || alt_setting != 0) {
 				endp = raw_offset<usb_endpoint_desc_t*>(endp, endp->bLength);
 				continue;
 			}
 
-			uint8_t endp_num = endp->bEndpointAddress & 0xf;
-			uint8_t dir = (endp->bEndpointAddress >> 7) & 0xf;
-			uint16_t max_packet_sz = endp->wMaxPacketSize & 0x7FF;
-			uint8_t max_burst_sz = (endp->wMaxPacketSize & 0x1800) >> 11;
-			uint8_t transfer_type = endp->bmAttributes & 0x3;
-			uint8_t interval = endp->bInterval;
-			uint16_t ici = ((endp_num * 2) + 1) + dir;
-			uint16_t dci = ((endp_num * 2) + dir);
-			if (transfer_type == ENDPOINT_TRANSFER_TYPE_CONTROL) {
-				ici = (endp_num + 1) * 2;
-				dci = (endp_num * 2) + 1;
-			}
-			if (endp_num == 0)
-				ici = (endp_num + 1) * 2;
-			uint64_t addr = (static_cast<uint64_t>(ici) * 32);
-			uint64_t dc_addr = (static_cast<uint64_t>(dci) * 32);
-			uint8_t ep_type, cerr;
-			cerr = 3;
-			switch (transfer_type) {
-			case ENDPOINT_TRANSFER_TYPE_CONTROL:
-				ep_type = 4;
-				break;
-			case ENDPOINT_TRANSFER_TYPE_ISOCH:
-				if (dir) //IF DIR 1, THEN TYPE IS IN
-					ep_type = 5;
-				else
-					ep_type = 1;
-				cerr = 0; // counter error doesn't apply for isoch transfer
-				break;
-			case ENDPOINT_TRANSFER_TYPE_BULK:
-				//AuTextOut("BULK Ep num ->%d \n", endp_num);
-				if (dir)
-					ep_type = 6;
-				else
-					ep_type = 2;
-				break;
-			case ENDPOINT_TRANSFER_TYPE_INT:
-				inte_addr = addr;
-				if (dir)
-					ep_type = 7;
-				else
-					ep_type = 3;
-				break;
+			uint8_t* ss_cmp = raw_offset<uint8_t*>(endp, endp->bLength);
+			if (raw_diff(ss_cmp, config) >= config->wTotalLength)
+				ss_cmp = NULL;
 
-			}
+			XHCIEndpoint* ep = XHCISetupEndpoint(dev, slot, endp, ss_cmp);
 
-			*raw_offset<volatile uint32_t*>(input_ctx_virt, 0x4) |= (1 << dci);
-
-			auto max_esit = max_packet_sz * (max_burst_sz + 1);
-			*raw_offset<volatile uint32_t*>(input_ctx_virt, addr + 0) = USB_ENDPOINT_CTX_DWORD0(max_esit >> 16, interval, 0, 0, 0, 0);
-			*raw_offset<volatile uint32_t*>(input_ctx_virt, addr + 0x04) = USB_ENDPOINT_CTX_DWORD1(max_packet_sz, max_burst_sz, 1, ep_type, cerr);
-			uint64_t cmd_ring = (uint64_t)P2V((uint64_t)AuPmmngrAlloc());
-			memset((void*)cmd_ring, 0, 4096);
-			*raw_offset<volatile uint32_t*>(input_ctx_virt, addr + 0x08) = USB_ENDPOINT_CTX_DWORD2(V2P(cmd_ring), 1);
-			*raw_offset<volatile uint32_t*>(input_ctx_virt, addr + 0x0C) = USB_ENDPOINT_CTX_DWORD3(V2P(cmd_ring));
-			*raw_offset<volatile uint32_t*>(input_ctx_virt, addr + 0x10) = USB_ENDPOINT_CTX_DWORD4(max_esit, 0x400);
-
-			XHCIEndpoint* ep = (XHCIEndpoint*)kmalloc(sizeof(XHCIEndpoint));
-			memset(ep, 0, sizeof(XHCIEndpoint));
-			ep->cmd_ring = (xhci_trb_t*)cmd_ring;
-			ep->cmd_ring_cycle = 1;
-			ep->cmd_ring_max = 128;
-			ep->endpoint_num = endp_num;
-			ep->endpoint_type = transfer_type;
-			ep->interval = interval;
-			ep->max_packet_sz = max_packet_sz;
-			ep->dci = dci;
-			ep->offset = addr;
-			ep->ep_type = transfer_type;
-			ep->dc_offset = dc_addr;
-			ep->dir = dir;
-			ep->endpointAddress = endp->bEndpointAddress;
-			ep->endpointAttr = endp->bmAttributes;
-			ep->callback = NULL;
-
-			/* insert a link trb at the last of cmd ring */
-			ep->cmd_ring[ep->cmd_ring_max].trb_param_1 = V2P(cmd_ring) & UINT32_MAX;
-			ep->cmd_ring[ep->cmd_ring_max].trb_param_2 = (V2P(cmd_ring) >> 32) & UINT32_MAX;
-			ep->cmd_ring[ep->cmd_ring_max].trb_status = 0;
-			ep->cmd_ring[ep->cmd_ring_max].trb_control = TRB_TRANSFER_LINK << 10 | (1 << 5) | (ep->cmd_ring_cycle & 0x1);
-
-			list_add(slot->endpoints, ep);
-
-			if (lasti < dci) lasti = dci;
+			if (lasti < ep->dci) lasti = ep->dci;
 
 			/* also send configure endpoint command to xhc*/
 			XHCIConfigureEndpoint(dev, slot->input_context_phys, slot_id);
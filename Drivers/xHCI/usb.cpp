@@ -33,6 +33,8 @@
 #include <_null.h>
 #include <aucon.h>
 #include <Mm/kmalloc.h>
+#include <Mm/vmmngr.h>
+#include <Mm/pmmngr.h>
 #include <string.h>
 
 /*
@@ -306,6 +308,194 @@ uint8_t USBGetEndpointAddress(AuUSBDevice* dev_, void* ep) {
 }
 
 
+/*
+ * USBBulkQueue -- queue a bulk transfer without waiting
+ * for it
+ * @param usbdev -- Pointer to USB Device data structure
+ * @param buffer -- physical address of the buffer
+ * @param data_len -- Data length
+ * @param ep -- Pointer to endpoint data structure
+ * @param stream -- stream id, 0 if endpoint has no streams
+ * @return sequence number to wait on, 0 on failure
+ */
+uint32_t USBBulkQueue(AuUSBDevice* usbdev, uint64_t buffer, uint32_t data_len, void* ep, uint16_t stream) {
+	XHCIDevice* dev = XHCIGetHost();
+	if (!dev)
+		return 0;
+	XHCISlot* slot = (XHCISlot*)usbdev->data;
+	if (!slot)
+		return 0;
+	return XHCIQueueTD(dev, slot, (XHCIEndpoint*)ep, stream, buffer, data_len);
+}
+
+/*
+ * USBBulkWait -- wait for a queued bulk transfer
+ * @param usbdev -- Pointer to USB Device data structure
+ * @param ep -- Pointer to endpoint data structure
+ * @param stream -- stream id, 0 if endpoint has no streams
+ * @param seq -- sequence number returned by USBBulkQueue
+ * @return completion code, -1 on timeout
+ */
+int USBBulkWait(AuUSBDevice* usbdev, void* ep, uint16_t stream, uint32_t seq) {
+	XHCIDevice* dev = XHCIGetHost();
+	if (!dev)
+		return -1;
+	return XHCIWaitTD(dev, (XHCIEndpoint*)ep, stream, seq);
+}
+
+/*
+ * USBClearHalt -- recover a halted endpoint on both host
+ * and device side
+ * @param usbdev -- Pointer to USB Device data structure
+ * @param ep -- Pointer to endpoint data structure
+ */
+void USBClearHalt(AuUSBDevice* usbdev, void* ep) {
+	XHCIDevice* dev = XHCIGetHost();
+	if (!dev)
+		return;
+	XHCISlot* slot = (XHCISlot*)usbdev->data;
+	XHCIEndpoint* ep_ = (XHCIEndpoint*)ep;
+	if (!slot || !ep_)
+		return;
+	XHCIResetEndpoint(dev, slot, ep_);
+
+	USB_REQUEST_PACKET pack;
+	pack.request_type = USB_BM_REQUEST_OUTPUT | USB_BM_REQUEST_STANDARD | USB_BM_REQUEST_ENDPOINT;
+	pack.request = USB_BREQUEST_CLEAR_FEATURE;
+	pack.value = 0; //ENDPOINT_HALT
+	pack.index = ep_->endpointAddress;
+	pack.length = 0;
+	XHCISendControlCmd(dev, slot, slot->slot_id, &pack, NULL, 0);
+	XHCIPollEvent(dev, TRB_EVENT_TRANSFER);
+}
+
+/*
+ * USBGetEndpointByAddress -- returns an endpoint by its
+ * endpoint address
+ * @param usbdev -- Pointer to USB Device
+ * @param addr -- endpoint address with direction bit
+ */
+void* USBGetEndpointByAddress(AuUSBDevice* usbdev, uint8_t addr) {
+	if (!usbdev)
+		return NULL;
+	XHCISlot* slot = (XHCISlot*)usbdev->data;
+	if (!slot)
+		return NULL;
+	for (int i = 0; i < slot->endpoints->pointer; i++) {
+		XHCIEndpoint* ep = (XHCIEndpoint*)list_get_at(slot->endpoints, i);
+		if (ep->endpointAddress == addr)
+			return ep;
+	}
+	return NULL;
+}
+
+/*
+ * USBGetMaxStreams -- returns number of streams allocated
+ * for an endpoint, 0 if it uses single ring
+ * @param usbdev -- Pointer to USB Device
+ * @param ep -- Pointer to endpoint
+ */
+uint16_t USBGetMaxStreams(AuUSBDevice* usbdev, void* ep) {
+	XHCIEndpoint* ep_ = (XHCIEndpoint*)ep;
+	if (!ep_)
+		return 0;
+	return ep_->num_streams;
+}
+
+/*
+ * USBSetInterface -- select an alternate setting of an
+ * interface, endpoints of the alternate setting replace
+ * the ones sharing same endpoint context
+ * @param usbdev -- Pointer to USB Device
+ * @param iface -- interface number
+ * @param alt -- alternate setting
+ */
+int USBSetInterface(AuUSBDevice* usbdev, uint8_t iface, uint8_t alt) {
+	XHCIDevice* dev = XHCIGetHost();
+	if (!dev)
+		return -1;
+	XHCISlot* slot = (XHCISlot*)usbdev->data;
+	if (!slot)
+		return -1;
+	usb_config_desc_t* config = (usb_config_desc_t*)slot->descriptor_buff;
+	usb_descriptor_t* desc = raw_offset<usb_descriptor_t*>(config, config->bLength);
+	usb_if_desc_t* if_desc = NULL;
+	while (raw_diff(desc, config) < config->wTotalLength) {
+		if (desc->bLength == 0)
+			break;
+		if (desc->bDescriptorType == USB_DESCRIPTOR_INTERFACE) {
+			usb_if_desc_t* d = (usb_if_desc_t*)desc;
+			if (d->bInterfaceNumber == iface && d->bAlternateSetting == alt) {
+				if_desc = d;
+				break;
+			}
+		}
+		desc = raw_offset<usb_descriptor_t*>(desc, desc->bLength);
+	}
+	if (!if_desc)
+		return -1;
+
+	uint64_t input_ctx_virt = P2V(slot->input_context_phys);
+	*raw_offset<volatile uint32_t*>(input_ctx_virt, 0x0) = 0;
+	*raw_offset<volatile uint32_t*>(input_ctx_virt, 0x4) = (1 << 0);
+
+	list_t* old_eps = initialize_list();
+	uint32_t lasti = (*raw_offset<volatile uint32_t*>(input_ctx_virt, 0x20) >> 27) & 0x1f;
+	desc = raw_offset<usb_descriptor_t*>(if_desc, if_desc->bLength);
+	while (raw_diff(desc, config) < config->wTotalLength) {
+		if (desc->bLength == 0 || desc->bDescriptorType == USB_DESCRIPTOR_INTERFACE)
+			break;
+		if (desc->bDescriptorType == USB_DESCRIPTOR_ENDPOINT) {
+			usb_endpoint_desc_t* endp = (usb_endpoint_desc_t*)desc;
+			uint8_t* ss_cmp = raw_offset<uint8_t*>(endp, endp->bLength);
+			if (raw_diff(ss_cmp, config) >= config->wTotalLength)
+				ss_cmp = NULL;
+
+			/* drop the endpoint occupying the same context */
+			XHCIEndpoint* prev = (XHCIEndpoint*)USBGetEndpointByAddress(usbdev, endp->bEndpointAddress);
+			if (prev) {
+				for (int i = 0; i < slot->endpoints->pointer; i++) {
+					if (list_get_at(slot->endpoints, i) == prev) {
+						list_remove(slot->endpoints, i);
+						break;
+					}
+				}
+				*raw_offset<volatile uint32_t*>(input_ctx_virt, 0x0) |= (1 << prev->dci);
+				list_add(old_eps, prev);
+			}
+
+			XHCIEndpoint* ep = XHCISetupEndpoint(dev, slot, endp, ss_cmp);
+			if (lasti < ep->dci)
+				lasti = ep->dci;
+		}
+		desc = raw_offset<usb_descriptor_t*>(desc, desc->bLength);
+	}
+
+	uint32_t slot_dw0 = *raw_offset<volatile uint32_t*>(input_ctx_virt, 0x20);
+	*raw_offset<volatile uint32_t*>(input_ctx_virt, 0x20) = (slot_dw0 & ~(0x1f << 27)) | ((lasti & 0x1f) << 27);
+
+	XHCIConfigureEndpoint(dev, slot->input_context_phys, slot->slot_id);
+	XHCIPollEvent(dev, TRB_EVENT_CMD_COMPLETION);
+	*raw_offset<volatile uint32_t*>(input_ctx_virt, 0x0) = 0;
+
+	while (old_eps->pointer > 0) {
+		XHCIEndpoint* ep = (XHCIEndpoint*)list_remove(old_eps, 0);
+		XHCIFreeEndpoint(ep);
+	}
+	kfree(old_eps);
+
+	USB_REQUEST_PACKET pack;
+	pack.request_type = USB_BM_REQUEST_OUTPUT | USB_BM_REQUEST_STANDARD | USB_BM_REQUEST_INTERFACE;
+	pack.request = USB_BREQUEST_SET_INTERFACE;
+	pack.value = alt;
+	pack.index = iface;
+	pack.length = 0;
+	XHCISendControlCmd(dev, slot, slot->slot_id, &pack, NULL, 0);
+	XHCIPollEvent(dev, TRB_EVENT_TRANSFER);
+	slot->interface_val = iface;
+	return 0;
+}
+
 /*
  * USBDeviceSetFunctions -- setup the device data structure with
  * all the function pointers
@@ -326,4 +516,10 @@ void USBDeviceSetFunctions(AuUSBDevice* dev) {
 	dev->control_transfer = USBControlTransfer;
 	dev->bulk_transfer = USBBulkTransfer;
 	dev->poll_wait = USBPollWait;
+	dev->bulk_queue = USBBulkQueue;
+	dev->bulk_wait = USBBulkWait;
+	dev->set_interface = USBSetInterface;
+	dev->get_endpoint_by_addr = USBGetEndpointByAddress;
+	dev->get_max_streams = USBGetMaxStreams;
+	dev->clear_halt = USBClearHalt;
 }
\ No newline at end of file
@@ -218,6 +218,12 @@ typedef struct _usb_dev_ {
 	int (*poll_wait)(_usb_dev_* dev, int wait_type);
 	usb_drv_entry ClassEntry;
 	usb_drv_unload ClassUnload;
+	uint32_t (*bulk_queue)(_usb_dev_* usbdev, uint64_t buffer, uint32_t data_len, void* ep, uint16_t stream);
+	int (*bulk_wait)(_usb_dev_* usbdev, void* ep, uint16_t stream, uint32_t seq);
+	int (*set_interface)(_usb_dev_* usbdev, uint8_t iface, uint8_t alt);
+	void* (*get_endpoint_by_addr)(_usb_dev_* usbdev, uint8_t addr);
+	uint16_t (*get_max_streams)(_usb_dev_* usbdev, void* ep);
+	void (*clear_halt)(_usb_dev_* usbdev, void* ep);
 }AuUSBDevice;
 #pragma pack(pop)
 
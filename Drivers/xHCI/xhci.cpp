@@ -133,23 +133,8 @@ size_t XHCIGetMaxPacketSize(uint8_t speed) {
 * @param ctrl -- control field of trb structure
 */
 void XHCISendCmdDefaultEP(XHCISlot* slot, uint32_t param1, uint32_t param2, uint32_t status, uint32_t ctrl) {
-
-	ctrl &= ~1;
-	ctrl |= slot->cmd_ring_cycle;
-	slot->cmd_ring[slot->cmd_ring_index].trb_param_1 = param1;
-	slot->cmd_ring[slot->cmd_ring_index].trb_param_2 = param2;
-	slot->cmd_ring[slot->cmd_ring_index].trb_status = status;
-	slot->cmd_ring[slot->cmd_ring_index].trb_control = ctrl;
-
-	slot->cmd_ring_index++;
-
-	if (slot->cmd_ring_index >= slot->cmd_ring_max) {
-		slot->cmd_ring[slot->cmd_ring_index].trb_control |= slot->cmd_ring_cycle;
-		if (slot->cmd_ring[slot->cmd_ring_index].trb_control & (1 << 1)) {
-			slot->cmd_ring_cycle ^= 1;
-		}
-		slot->cmd_ring_index = 0;
-	}
+	XHCIRingEnqueue(slot->cmd_ring, &slot->cmd_ring_index, &slot->cmd_ring_cycle, slot->cmd_ring_max,
+		param1, param2, status, ctrl);
 }
 
 
@@ -167,23 +152,46 @@ void XHCISendCmdOtherEP(XHCISlot* slot, uint8_t endp_num, uint32_t param1, uint3
 	if (!ep)
 		return;
 
-	ctrl &= ~1;
-	ctrl |= ep->cmd_ring_cycle & 0x1;
-	ep->cmd_ring[ep->cmd_ring_index].trb_param_1 = param1;
-	ep->cmd_ring[ep->cmd_ring_index].trb_param_2 = param2;
-	ep->cmd_ring[ep->cmd_ring_index].trb_status = status;
-	ep->cmd_ring[ep->cmd_ring_index].trb_control = ctrl;
-
-	ep->cmd_ring_index++;
-
-	if (ep->cmd_ring_index >= ep->cmd_ring_max) {
-		ep->cmd_ring[ep->cmd_ring_index].trb_control |= ep->cmd_ring_cycle;
-		if (ep->cmd_ring[ep->cmd_ring_index].trb_control & (1 << 1)) {
-			if (ep->cmd_ring_cycle)
-				ep->cmd_ring_cycle ^= 1;
-		}
+	XHCIRingEnqueue(ep->cmd_ring, &ep->cmd_ring_index, &ep->cmd_ring_cycle, ep->cmd_ring_max,
+		param1, param2, status, ctrl);
+}
 
-		ep->cmd_ring_index = 0;
+/*
+ * XHCIRingEnqueue -- put a trb on a transfer ring, when
+ * the producer reaches the link trb, the link trb is handed
+ * to the controller with current cycle and the producer
+ * cycle is toggled
+ * @param ring -- Pointer to ring base
+ * @param index -- Pointer to producer index
+ * @param cycle -- Pointer to producer cycle state
+ * @param max -- index of the link trb
+ * @param param1 -- first parameter of trb structure
+ * @param param2 -- 2nd parameter of trb structure
+ * @param status -- status field of trb structure
+ * @param ctrl -- control field of trb structure
+ */
+void XHCIRingEnqueue(xhci_trb_t* ring, unsigned* index, unsigned* cycle, unsigned max, uint32_t param1, uint32_t param2,
+	uint32_t status, uint32_t ctrl) {
+	ctrl &= ~1;
+	ctrl |= *cycle & 0x1;
+	ring[*index].trb_param_1 = param1;
+	ring[*index].trb_param_2 = param2;
+	ring[*index].trb_status = status;
+	ring[*index].trb_control = ctrl;
+
+	*index = *index + 1;
+
+	if (*index >= max) {
+		/* a TD that continues past the link trb needs the
+		 * chain bit on the link trb too */
+		uint32_t link = ring[max].trb_control & ~((1 << 4) | 1);
+		if (ctrl & (1 << 4))
+			link |= (1 << 4);
+		link |= (*cycle & 0x1);
+		ring[max].trb_control = link;
+		if (link & (1 << 1))
+			*cycle ^= 1;
+		*index = 0;
 	}
 }
 
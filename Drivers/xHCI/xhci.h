@@ -227,6 +227,38 @@ typedef struct _xhci_port_reg_ {
 }xhci_port_regs_t;
 #pragma pack(pop)
 
+/* number of usable TRBs in one transfer ring page, the
+ * link TRB sits right after the last one */
+#define XHCI_TRANSFER_RING_TRBS  128
+/* largest buffer a single normal TRB may describe, it must
+ * also not cross this boundary */
+#define XHCI_TRB_MAX_BUFFER  (64*1024)
+/* upper limit on streams allocated for one endpoint (log2) */
+#define XHCI_MAX_STREAMS_LOG2  4
+/* time a TD may go without any completion on its endpoint
+ * before the waiter gives up, in ms */
+#define XHCI_TD_TIMEOUT_MS  5000
+
+/* completion codes reported in transfer events */
+#define XHCI_COMP_SUCCESS       1
+#define XHCI_COMP_BABBLE        3
+#define XHCI_COMP_TRB_ERROR     5
+#define XHCI_COMP_STALL         6
+#define XHCI_COMP_SHORT_PACKET  13
+#define XHCI_COMP_STOPPED       26
+
+#pragma pack(push,1)
+typedef struct _xhci_stream_ring_ {
+	xhci_trb_t* ring;
+	unsigned index;
+	unsigned cycle;
+	volatile uint32_t queued;
+	volatile uint32_t completed;
+	volatile uint8_t comp_code;
+	volatile uint32_t residue;
+}XHCIStreamRing;
+#pragma pack(pop)
+
 #pragma pack(push,1)
 typedef struct _endp_ {
 	xhci_trb_t* cmd_ring;
@@ -245,6 +277,22 @@ typedef struct _endp_ {
 	uint8_t ep_type;
 	uint8_t dir;
 	endpoint_callback callback;
+	uint8_t max_burst;
+	/* completion tracking for queued TDs, sequence numbers
+	 * are handed out by XHCIQueueTD */
+	volatile uint32_t queued;
+	volatile uint32_t completed;
+	volatile uint8_t comp_code;
+	volatile uint32_t residue;
+	volatile bool halted;
+	/* guards waiter against the event interrupt */
+	Spinlock* wait_lock;
+	AuThread* waiter;
+	/* stream support, num_streams is zero when the endpoint
+	 * uses a single transfer ring */
+	uint16_t num_streams;
+	uint64_t stream_ctx_phys;
+	XHCIStreamRing* streams;
 }XHCIEndpoint;
 #pragma pack(pop)
 
@@ -551,6 +599,21 @@ extern void XHCISendCmdToHost(XHCIDevice* dev, uint32_t param1, uint32_t param2,
 */
 extern void XHCISendCmdOtherEP(XHCISlot* slot, uint8_t endp_num, uint32_t param1, uint32_t param2, uint32_t status, uint32_t ctrl);
 
+/*
+ * XHCIRingEnqueue -- put a trb on a transfer ring and
+ * follow the link trb on wrap
+ * @param ring -- Pointer to ring base
+ * @param index -- Pointer to producer index
+ * @param cycle -- Pointer to producer cycle state
+ * @param max -- index of the link trb
+ * @param param1 -- first parameter of trb structure
+ * @param param2 -- 2nd parameter of trb structure
+ * @param status -- status field of trb structure
+ * @param ctrl -- control field of trb structure
+ */
+extern void XHCIRingEnqueue(xhci_trb_t* ring, unsigned* index, unsigned* cycle, unsigned max, uint32_t param1, uint32_t param2,
+	uint32_t status, uint32_t ctrl);
+
 
 /*
 * XHCISendCmdDefaultEP -- sends command to slot trb, i.e
@@ -664,7 +727,68 @@ extern void XHCISendNormalTRB(XHCIDevice* dev, XHCISlot* slot, uint64_t data_buf
  * @param data_len -- total data length
  * @param ep_ -- Pointer to endpoint structure
  */
-extern void XHCIBulkTransfer(XHCIDevice* dev, XHCISlot* slot, uint64_t buffer, uint16_t data_len, XHCIEndpoint* ep_);
+extern void XHCIBulkTransfer(XHCIDevice* dev, XHCISlot* slot, uint64_t buffer, uint32_t data_len, XHCIEndpoint* ep_);
+
+/*
+ * XHCIQueueTD -- queue one transfer descriptor on an endpoint
+ * and ring its doorbell
+ * @param dev -- Pointer to host device structure
+ * @param slot -- Pointer to device slot
+ * @param ep -- Pointer to endpoint structure
+ * @param stream -- stream id, 0 for endpoints without streams
+ * @param buffer -- physical address of the buffer
+ * @param data_len -- total data length
+ * @return sequence number of the TD, 0 on failure
+ */
+extern uint32_t XHCIQueueTD(XHCIDevice* dev, XHCISlot* slot, XHCIEndpoint* ep, uint16_t stream, uint64_t buffer, uint32_t data_len);
+
+/*
+ * XHCIWaitTD -- wait until the TD with given sequence
+ * number has completed
+ * @param dev -- Pointer to host device structure
+ * @param ep -- Pointer to endpoint structure
+ * @param stream -- stream id, 0 for endpoints without streams
+ * @param seq -- sequence number returned by XHCIQueueTD
+ * @return completion code of the last completed TD, -1 on
+ * timeout
+ */
+extern int XHCIWaitTD(XHCIDevice* dev, XHCIEndpoint* ep, uint16_t stream, uint32_t seq);
+
+/*
+ * XHCITransferComplete -- account a transfer event to its
+ * endpoint, called from event interrupt
+ * @param dev -- Pointer to host device structure
+ * @param ep -- Pointer to endpoint structure
+ * @param trb -- Pointer to the transfer event trb
+ */
+extern void XHCITransferComplete(XHCIDevice* dev, XHCIEndpoint* ep, xhci_trb_t* trb);
+
+/*
+ * XHCIResetEndpoint -- recover a halted endpoint, pending
+ * TDs are discarded
+ * @param dev -- Pointer to host device structure
+ * @param slot -- Pointer to device slot
+ * @param ep -- Pointer to endpoint structure
+ */
+extern void XHCIResetEndpoint(XHCIDevice* dev, XHCISlot* slot, XHCIEndpoint* ep);
+
+/*
+ * XHCISetupEndpoint -- fill the input context for an endpoint
+ * descriptor and create its transfer ring(s), the caller is
+ * responsible for issuing configure endpoint command
+ * @param dev -- Pointer to host device structure
+ * @param slot -- Pointer to device slot
+ * @param endp -- endpoint descriptor
+ * @param ss_cmp -- SuperSpeed endpoint companion descriptor, can
+ * be null
+ */
+extern XHCIEndpoint* XHCISetupEndpoint(XHCIDevice* dev, XHCISlot* slot, void* endp, uint8_t* ss_cmp);
+
+/*
+ * XHCIFreeEndpoint -- free an endpoint and its rings
+ * @param ep -- Pointer to endpoint structure
+ */
+extern void XHCIFreeEndpoint(XHCIEndpoint* ep);
 
 
 /*
@@ -29,6 +29,7 @@
 
 #include <Fs\Dev\devfs.h>
 #include <Fs\Dev\devinput.h>
+#include <Fs\Dev\devtrace.h>
 #include <Mm\kmalloc.h>
 #include <list.h>
 #include <string.h>
@@ -54,6 +55,7 @@ void AuDeviceFsInitialize() {
 	AuVFSAddFileSystem(node);
 
 	AuDevInputInitialise();
+	AuDevTraceInitialise();
 
 }
 
@@ -95,7 +95,7 @@ void AuDevWriteKybrd(AuInputMessage* outmsg) {
 * @param buffer -- Pointer to buffer where to put the data
 * @param length -- length to read
 */
-size_t AuDevInputMiceWrite(AuVFSNode *fs, AuVFSNode *file, uint64_t* buffer, uint32_t length){
+size_t AuDevInputMiceWrite(AuVFSNode *fs, AuVFSNode *file, uint64_t* buffer, size_t length){
 #ifdef ARCH_X64
 	x64_cli();
 #endif
@@ -115,7 +115,7 @@ size_t AuDevInputMiceWrite(AuVFSNode *fs, AuVFSNode *file, uint64_t* buffer, uin
 * @param buffer -- Pointer to buffer where to put the data
 * @param length -- length to read
 */
-size_t AuDevInputMiceRead(AuVFSNode *fs, AuVFSNode *file, uint64_t* buffer, uint32_t length){
+size_t AuDevInputMiceRead(AuVFSNode *fs, AuVFSNode *file, uint64_t* buffer, size_t length){
 #ifdef ARCG_X64
 	x64_cli();
 #endif
@@ -136,7 +136,7 @@ size_t AuDevInputMiceRead(AuVFSNode *fs, AuVFSNode *file, uint64_t* buffer, uint
 * @param buffer -- Pointer to buffer where to put the data
 * @param length -- length to read
 */
-size_t AuDevInputKybrdWrite(AuVFSNode *fs, AuVFSNode *file, uint64_t* buffer, uint32_t length){
+size_t AuDevInputKybrdWrite(AuVFSNode *fs, AuVFSNode *file, uint64_t* buffer, size_t length){
 #ifdef ARCH_X64
 	x64_cli();
 #endif
@@ -156,7 +156,7 @@ size_t AuDevInputKybrdWrite(AuVFSNode *fs, AuVFSNode *file, uint64_t* buffer, ui
 * @param buffer -- Pointer to buffer where to put the data
 * @param length -- length to read
 */
-size_t AuDevInputKybrdRead(AuVFSNode *fs, AuVFSNode *file, uint64_t* buffer, uint32_t length){
+size_t AuDevInputKybrdRead(AuVFSNode *fs, AuVFSNode *file, uint64_t* buffer, size_t length){
 #ifdef ARCH_X64
 	x64_cli();
 #endif
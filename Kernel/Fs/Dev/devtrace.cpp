@@ -0,0 +1,139 @@
+/**
+* BSD 2-Clause License
+*
+* Copyright (c) 2022-2023, Manas Kamal Choudhury
+* All rights reserved.
+*
+* Redistribution and use in source and binary forms, with or without
+* modification, are permitted provided that the following conditions are met:
+*
+* 1. Redistributions of source code must retain the above copyright notice, this
+*    list of conditions and the following disclaimer.
+*
+* 2. Redistributions in binary form must reproduce the above copyright notice,
+*    this list of conditions and the following disclaimer in the documentation
+*    and/or other materials provided with the distribution.
+*
+* THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+* AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+* IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+* DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE
+* FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+* DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR
+* SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER
+* CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY,
+* OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+* OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+*
+**/
+
+#include <Fs\Dev\devtrace.h>
+#include <Fs\Dev\devfs.h>
+#include <Fs\vfs.h>
+#include <Mm\kmalloc.h>
+#include <Serv\sysserv.h>
+#include <autrace.h>
+#include <string.h>
+#include <_null.h>
+
+#define TRACE_BOUNCE_RECORDS  128
+
+/*
+ * AuDevTraceRead -- read callback of /dev/trace, records
+ * are drained through a kernel bounce buffer so no user
+ * page gets touched while the rings are locked
+ * @param fs -- pointer to device node
+ * @param file -- pointer to opened file
+ * @param buffer -- user buffer
+ * @param length -- length to read
+ */
+size_t AuDevTraceRead(AuVFSNode* fs, AuVFSNode* file, uint64_t* buffer, size_t length) {
+	if (!file || !buffer)
+		return 0;
+	uint8_t* out = (uint8_t*)buffer;
+	size_t ret = 0;
+	if (file->pos == 0) {
+		if (length < sizeof(AuTraceHeader))
+			return 0;
+		AuTraceHeader hdr;
+		AuTraceFillHeader(&hdr);
+		memcpy(out, &hdr, sizeof(AuTraceHeader));
+		ret += sizeof(AuTraceHeader);
+	}
+
+	AuTraceRecord* bounce = (AuTraceRecord*)kmalloc(TRACE_BOUNCE_RECORDS * sizeof(AuTraceRecord));
+	if (!bounce)
+		return ret;
+	while (length - ret >= sizeof(AuTraceRecord)) {
+		uint32_t want = (length - ret) / sizeof(AuTraceRecord);
+		if (want > TRACE_BOUNCE_RECORDS)
+			want = TRACE_BOUNCE_RECORDS;
+		uint32_t got = AuTraceDrain(bounce, want);
+		if (got == 0)
+			break;
+		memcpy(out + ret, bounce, got * sizeof(AuTraceRecord));
+		ret += got * sizeof(AuTraceRecord);
+	}
+	kfree(bounce);
+
+	/* nothing left, next read starts a new dump */
+	if (ret == 0)
+		file->pos = 0;
+	else
+		file->pos += ret;
+	return ret;
+}
+
+/*
+ * AuDevTraceIoControl -- enable, disable or reset
+ * tracing
+ * @param file -- Pointer to trace file
+ * @param code -- code to pass as command
+ * @param arg -- pointer to AuFileIoControl structure,
+ * uint_1 holds event mask for TRACE_IOCODE_ENABLE
+ */
+int AuDevTraceIoControl(AuVFSNode* file, int code, void* arg) {
+	if (!file)
+		return 0;
+	AuFileIOControl *ioctl = (AuFileIOControl*)arg;
+	if (!arg)
+		return 0;
+	if (ioctl->syscall_magic != AURORA_SYSCALL_MAGIC)
+		return 0;
+
+	switch (code)
+	{
+	case TRACE_IOCODE_ENABLE:
+		if (AuTraceEnable(ioctl->uint_1) == -1)
+			return -1;
+		break;
+	case TRACE_IOCODE_DISABLE:
+		AuTraceDisable();
+		break;
+	case TRACE_IOCODE_RESET:
+		AuTraceReset();
+		break;
+	default:
+		break;
+	}
+
+	return 1;
+}
+
+/*
+ * AuDevTraceInitialise -- creates /dev/trace, a read
+ * returns an AuTraceHeader at file position zero followed
+ * by whole trace records until the rings are empty
+ */
+void AuDevTraceInitialise() {
+	AuVFSNode* dev = AuVFSFind("/dev");
+	if (!dev)
+		return;
+	AuVFSNode* node = (AuVFSNode*)kmalloc(sizeof(AuVFSNode));
+	memset(node, 0, sizeof(AuVFSNode));
+	strcpy(node->filename, "trace");
+	node->flags = FS_FLAG_GENERAL | FS_FLAG_DEVICE;
+	node->read = AuDevTraceRead;
+	node->iocontrol = AuDevTraceIoControl;
+	AuDevFSAddFile(dev, "/dev", node);
+}
@@ -38,6 +38,8 @@
 #include <Fs/Fat/Fat.h>
 #include <Fs/Fat/FatFile.h>
 #include <Fs/Fat/FatDir.h>
+#include <Fs/Fat/FatIndex.h>
+#include <Fs/Fat/FatWriteBack.h>
 #include <Fs/vdisk.h>
 #include <Fs/vfs.h>
 #include <Mm/pmmngr.h>
@@ -193,6 +195,9 @@ uint32_t FatReadFAT(AuVFSNode *node, uint64_t cluster_index) {
 uint32_t FatFindFreeCluster(AuVFSNode* node) {
 	FatFS *fs = (FatFS*)node->device;
 	AuVDisk *vdisk = (AuVDisk*)fs->vdisk;
+	/* what is left belongs to buffered data */
+	if (!FatFreeClusters(node))
+		return 0;
 	if (!vdisk)
 		return NULL;
 
@@ -258,12 +263,169 @@ void FatAllocCluster(AuVFSNode* fsys, int position, uint32_t n_value) {
 
 	uint32_t value = *(uint32_t*)&buf[ent_offset];
 	*(uint32_t*)&buf[ent_offset] = n_value & 0x0FFFFFFF;
+	if (fs->free_counted) {
+		if (!(value & 0x0FFFFFFF) && (n_value & 0x0FFFFFFF))
+			fs->free_clusters--;
+		else if ((value & 0x0FFFFFFF) && !(n_value & 0x0FFFFFFF))
+			fs->free_clusters++;
+	}
 
 
 	AuVDiskWrite(vdisk, fat_sector, 1, (uint64_t*)V2P((size_t)buffer));
 	AuPmmngrFree((void*)V2P((size_t)buffer));
 }
 
+/*
+ * FatReadFATBlock -- reads a page worth of FAT sectors
+ * starting at given sector index of the FAT, returns
+ * the number of sectors read
+ * @param fs -- Pointer to FAT file system
+ * @param fat_sector -- sector index relative to FAT start
+ * @param buffer -- page sized buffer
+ */
+static uint32_t FatReadFATBlock(FatFS* fs, uint32_t fat_sector, uint8_t* buffer) {
+	uint32_t count = PAGE_SIZE / fs->__BytesPerSector;
+	if ((fat_sector + count) > fs->__SectorPerFAT32)
+		count = fs->__SectorPerFAT32 - fat_sector;
+	AuVDiskRead(fs->vdisk, fs->__FatBeginLBA + fat_sector, count, (uint64_t*)V2P((size_t)buffer));
+	return count;
+}
+
+/*
+ * FatFindFreeRun -- finds a run of free clusters, the
+ * search begins from hint and wraps around, the first run
+ * long enough is returned, otherwise the longest one found
+ * @param fsys -- Pointer to file system node
+ * @param hint -- cluster to start searching from
+ * @param want -- clusters needed
+ * @param run_len -- receives the length of the run
+ */
+uint32_t FatFindFreeRun(AuVFSNode* fsys, uint32_t hint, uint32_t want, uint32_t* run_len) {
+	FatFS* fs = (FatFS*)fsys->device;
+	*run_len = 0;
+	if (!fs->vdisk || !want)
+		return 0;
+
+	uint32_t ents_per_sect = fs->__BytesPerSector / 4;
+	uint32_t total = fs->__SectorPerFAT32 * ents_per_sect;
+	if ((fs->__TotalClusters + 2) < total)
+		total = fs->__TotalClusters + 2;
+	if (hint < 2 || hint >= total)
+		hint = 2;
+
+	uint8_t* buffer = (uint8_t*)P2V((size_t)AuPmmngrAlloc());
+	uint32_t block_first = 0;
+	uint32_t block_count = 0;
+	uint32_t best_start = 0;
+	uint32_t best_len = 0;
+	uint32_t start = 0;
+	uint32_t len = 0;
+
+	for (int pass = 0; pass < 2 && best_len < want; pass++) {
+		uint32_t from = pass ? 2 : hint;
+		uint32_t to = pass ? hint : total;
+		len = 0;
+		for (uint32_t c = from; c < to; c++) {
+			uint32_t sector = c / ents_per_sect;
+			if (!block_count || sector < block_first || sector >= (block_first + block_count)) {
+				block_first = sector;
+				block_count = FatReadFATBlock(fs, sector, buffer);
+			}
+			uint32_t value = ((uint32_t*)buffer)[c - (block_first * ents_per_sect)] & 0x0FFFFFFF;
+			if (value == 0) {
+				if (!len)
+					start = c;
+				len++;
+				if (len > best_len) {
+					best_start = start;
+					best_len = len;
+				}
+				if (len == want)
+					break;
+			}
+			else
+				len = 0;
+		}
+	}
+
+	AuPmmngrFree((void*)V2P((size_t)buffer));
+	*run_len = best_len;
+	return best_len ? best_start : 0;
+}
+
+/*
+ * FatFreeClusters -- returns the number of free clusters
+ * not promised to buffered data yet, the FAT is counted
+ * once and kept up to date by every FAT write afterwards
+ * @param fsys -- Pointer to file system node
+ */
+uint32_t FatFreeClusters(AuVFSNode* fsys) {
+	FatFS* fs = (FatFS*)fsys->device;
+	if (!fs->vdisk)
+		return 0;
+
+	if (!fs->free_counted) {
+		uint32_t ents_per_sect = fs->__BytesPerSector / 4;
+		uint32_t total = fs->__SectorPerFAT32 * ents_per_sect;
+		if ((fs->__TotalClusters + 2) < total)
+			total = fs->__TotalClusters + 2;
+
+		uint8_t* buffer = (uint8_t*)P2V((size_t)AuPmmngrAlloc());
+		uint32_t block_first = 0;
+		uint32_t block_count = 0;
+		uint32_t count = 0;
+		for (uint32_t c = 2; c < total; c++) {
+			uint32_t sector = c / ents_per_sect;
+			if (!block_count || sector >= (block_first + block_count)) {
+				block_first = sector;
+				block_count = FatReadFATBlock(fs, sector, buffer);
+			}
+			if (!(((uint32_t*)buffer)[c - (block_first * ents_per_sect)] & 0x0FFFFFFF))
+				count++;
+		}
+		AuPmmngrFree((void*)V2P((size_t)buffer));
+		fs->free_clusters = count;
+		fs->free_counted = true;
+	}
+
+	if (fs->free_clusters <= fs->wb_reserved)
+		return 0;
+	return fs->free_clusters - fs->wb_reserved;
+}
+
+/*
+ * FatAllocChain -- links a run of clusters into a chain
+ * ending with EOC mark, every FAT sector touched is written
+ * only once
+ * @param fsys -- Pointer to file system node
+ * @param start -- first cluster of the run
+ * @param count -- number of clusters in the run
+ */
+void FatAllocChain(AuVFSNode* fsys, uint32_t start, uint32_t count) {
+	FatFS* fs = (FatFS*)fsys->device;
+	if (!fs->vdisk || !count)
+		return;
+
+	uint32_t ents_per_sect = fs->__BytesPerSector / 4;
+	uint8_t* buffer = (uint8_t*)P2V((size_t)AuPmmngrAlloc());
+	uint32_t last = start + count - 1;
+	uint32_t c = start;
+	while (c <= last) {
+		uint32_t block_first = c / ents_per_sect;
+		uint32_t block_count = FatReadFATBlock(fs, block_first, buffer);
+		uint32_t block_end = (block_first + block_count) * ents_per_sect;
+		uint32_t* ents = (uint32_t*)buffer;
+		for (; c <= last && c < block_end; c++) {
+			uint32_t value = (c == last) ? FAT_EOC_MARK : (c + 1);
+			uint32_t i = c - (block_first * ents_per_sect);
+			if (fs->free_counted && !(ents[i] & 0x0FFFFFFF))
+				fs->free_clusters--;
+			ents[i] = (ents[i] & 0xF0000000) | (value & 0x0FFFFFFF);
+		}
+		AuVDiskWrite(fs->vdisk, fs->__FatBeginLBA + block_first, block_count, (uint64_t*)V2P((size_t)buffer));
+	}
+	AuPmmngrFree((void*)V2P((size_t)buffer));
+}
 
 /**
 * FatClearCluster -- clears a cluster to 0
@@ -317,14 +479,82 @@ size_t FatRead(AuVFSNode* fsys, AuVFSNode *file, uint64_t* buf) {
 	return static_cast<int64_t>(fs->__SectorPerCluster) * fs->__BytesPerSector;
 }
 
+/*
+ * FatDirectTransfer -- transfers whole clusters between disk
+ * and caller's buffer without bouncing through kernel memory,
+ * the transfer stops at first discontinuity either in cluster
+ * chain or in buffer's physical pages, returns bytes transferred
+ * or 0 if the request is not eligible
+ * @param fsys -- Pointer to file system node
+ * @param file -- Pointer to file
+ * @param buffer -- caller's buffer
+ * @param length -- bytes left to transfer
+ * @param write -- true to write, false to read
+ */
+size_t FatDirectTransfer(AuVFSNode* fsys, AuVFSNode* file, uint8_t* buffer, size_t length, bool write) {
+	FatFS* fs = (FatFS*)fsys->device;
+	AuVDisk* vdisk = (AuVDisk*)fs->vdisk;
+	size_t clust_sz = fs->cluster_sz_in_bytes;
+
+	if (file->eof || file->current >= (FAT_BAD_CLUSTER & 0x0FFFFFFF))
+		return 0;
+	if ((file->pos % clust_sz) != 0 || length < clust_sz)
+		return 0;
+	/* controllers need at least sector aligned buffers */
+	if (((size_t)buffer % fs->__BytesPerSector) != 0)
+		return 0;
+
+	size_t max_len = length - (length % clust_sz);
+	if (max_len > FAT_DIRECT_MAX_BYTES)
+		max_len = (FAT_DIRECT_MAX_BYTES / clust_sz) * clust_sz;
+	if (max_len < clust_sz)
+		return 0;
+
+	size_t run_len = 0;
+	uint64_t phys = AuVmmngrGetPhysicalRun((uint64_t)buffer, max_len, &run_len);
+	if (!phys)
+		return 0;
+	size_t max_clusters = run_len / clust_sz;
+	if (!max_clusters)
+		return 0;
+
+	/* gather the contiguous part of cluster chain */
+	uint32_t first = file->current;
+	uint32_t last = first;
+	size_t count = 1;
+	uint32_t next = FatReadFAT(fsys, last);
+	while (count < max_clusters && next == (last + 1)) {
+		last = next;
+		count++;
+		next = FatReadFAT(fsys, last);
+	}
+
+	uint64_t lba = FatClusterToSector32(fs, first);
+	uint32_t sectors = count * fs->__SectorPerCluster;
+	if (write)
+		AuVDiskWrite(vdisk, lba, sectors, (uint64_t*)phys);
+	else
+		AuVDiskRead(vdisk, lba, sectors, (uint64_t*)phys);
+
+	file->pos += count * clust_sz;
+	if (next == 0 || next >= (FAT_BAD_CLUSTER & 0x0FFFFFFF)) {
+		file->current = last;
+		file->eof = 1;
+	}
+	else
+		file->current = next;
+	return count * clust_sz;
+}
+
 /*
  * FatReadFile -- reads a file of some specified size in bytes
+ * starting from the current byte position of the file
  * @param fsys -- Pointer to file system
  * @param file -- Pointer to file
  * @param buffer -- Pointer to reserved memory
  * @param length -- length to read in bytes
  */
-size_t FatReadFile(AuVFSNode* fsys, AuVFSNode* file, uint64_t* buffer, uint32_t length) {
+size_t FatReadFile(AuVFSNode* fsys, AuVFSNode* file, uint64_t* buffer, size_t length) {
 	if (!fsys)
 		return 0;
 
@@ -332,155 +562,138 @@ size_t FatReadFile(AuVFSNode* fsys, AuVFSNode* file, uint64_t* buffer, uint32_t
 		return 0;
 
 	FatFS* fs = (FatFS*)fsys->device;
+	AuVDisk* vdisk = (AuVDisk*)fs->vdisk;
+	if (!vdisk)
+		return 0;
+
+	/* never read beyond the end of file */
+	if (file->pos >= file->size) {
+		file->eof = 1;
+		return 0;
+	}
+	if (length > (file->size - file->pos))
+		length = file->size - file->pos;
 
-	uint64_t read_bytes = 0;
 	size_t ret_bytes = 0;
 	uint8_t* aligned_buffer = (uint8_t*)buffer;
+	int clust_pages = (fs->cluster_sz_in_bytes + PAGE_SIZE - 1) / PAGE_SIZE;
+	void* frames = AuPmmngrAllocBlocks(clust_pages);
+	if (!frames)
+		return 0;
+	uint8_t* buff = (uint8_t*)P2V((size_t)frames);
+	/* data not yet flushed lives in the write-back */
+	FatWriteBack* wb = FatWriteBackFind(fsys, file->first_block);
+
+	while (ret_bytes < length) {
+		if (wb && file->pos >= wb->alloc_bytes) {
+			size_t buffered = FatWriteBackRead(fsys, wb, file->pos, aligned_buffer, length - ret_bytes);
+			if (!buffered)
+				break;
+			aligned_buffer += buffered;
+			ret_bytes += buffered;
+			file->pos += buffered;
+			file->eof = 1;
+			continue;
+		}
+		if (wb && file->eof) {
+			/* chain was extended by a flush while this handle
+			 * sat at its old end */
+			uint32_t tail = FatWriteBackClusterFor(fsys, wb, file->pos);
+			file->current = tail ? tail : FatGetClusterFor(fsys, file, file->pos);
+			file->eof = 0;
+		}
+		uint32_t cluster = file->current;
+		if (cluster >= (FAT_BAD_CLUSTER & 0x0FFFFFFF)) {
+			file->eof = 1;
+			break;
+		}
+		if (file->eof) {
+			/* chain might have been extended by a writer
+			 * after we reached the last cluster */
+			uint32_t next = FatReadFAT(fsys, cluster);
+			if (next == 0 || next >= (FAT_BAD_CLUSTER & 0x0FFFFFFF))
+				break;
+			cluster = next;
+			file->current = cluster;
+			file->eof = 0;
+		}
 
-	size_t num_blocks = length / fs->cluster_sz_in_bytes +
-		((length % fs->cluster_sz_in_bytes) ? 1 : 0);
+		/* whole clusters go straight into caller's pages */
+		size_t direct = FatDirectTransfer(fsys, file, aligned_buffer, length - ret_bytes, false);
+		if (direct) {
+			aligned_buffer += direct;
+			ret_bytes += direct;
+			continue;
+		}
 
-	for (int i = 0; i < num_blocks; i++) {
-		if (file->eof)
-			break;
-		uint64_t* buff = (uint64_t*)P2V((size_t)AuPmmngrAlloc());
-		memset(buff, 0, PAGE_SIZE);
-		read_bytes = FatRead(fsys, file, (uint64_t*)V2P((size_t)buff));
-		memcpy(aligned_buffer, buff, PAGE_SIZE);
-		AuPmmngrFree((void*)V2P((size_t)buff));
-		aligned_buffer += PAGE_SIZE;
-		ret_bytes += read_bytes;
-		
+		size_t offset_in_clust = file->pos % fs->cluster_sz_in_bytes;
+		size_t chunk = fs->cluster_sz_in_bytes - offset_in_clust;
+		if (chunk > (length - ret_bytes))
+			chunk = length - ret_bytes;
+
+		AuVDiskRead(vdisk, FatClusterToSector32(fs, cluster), fs->__SectorPerCluster, (uint64_t*)V2P((size_t)buff));
+		memcpy(aligned_buffer, buff + offset_in_clust, chunk);
+
+		aligned_buffer += chunk;
+		ret_bytes += chunk;
+		file->pos += chunk;
+
+		/* cluster consumed completely, move to the next
+		 * one in chain, the last cluster stays as current
+		 * so that writer can extend the chain from it */
+		if ((offset_in_clust + chunk) == fs->cluster_sz_in_bytes) {
+			uint32_t value = FatReadFAT(fsys, cluster);
+			if (value >= (FAT_BAD_CLUSTER & 0x0FFFFFFF))
+				file->eof = 1;
+			else
+				file->current = value;
+		}
 	}
 
-	/* Okay, might be we read one block, but length was less
-	 * then 4KiB, just return that length 
-	 */
-	if (length < ret_bytes)
-		ret_bytes = length;
-
+	AuPmmngrFreeBlocks((void*)V2P((size_t)buff), clust_pages);
 	return ret_bytes;
 }
 
+/*
+ * FatLocateSubDir -- looks up an entry inside a sub
+ * directory, the directory node is consumed
+ * @param fsys -- Pointer to file system node
+ * @param kfile -- directory to look in
+ * @param filename -- name of the entry
+ */
 AuVFSNode* FatLocateSubDir(AuVFSNode* fsys,AuVFSNode* kfile, const char* filename) {
-	FatFS* _fs = (FatFS*)fsys->device;
-
-	AuVFSNode* file = (AuVFSNode*)kmalloc(sizeof(AuVFSNode));
-	memset(file, 0, sizeof(AuVFSNode));
-
-	char dos_file_name[12];
-	memset(dos_file_name, 0, 11);
-	FatToDOSFilename(filename, dos_file_name, 11);
-	dos_file_name[11] = 0;
-
-	uint64_t* buf = (uint64_t*)P2V((size_t)AuPmmngrAlloc());
+	if (!kfile)
+		return NULL;
+	AuVFSNode* file = NULL;
 	if (kfile->flags != FS_FLAG_INVALID) {
-		while (1){
-			if (kfile->eof){
-				break;
-			}
-			memset(buf, 0, PAGE_SIZE);
-		
-			FatRead(fsys, kfile, (uint64_t*)V2P((size_t)buf));
-			
-			FatDir* pkDir = (FatDir*)buf;
-			for (unsigned int i = 0; i < (16*_fs->__SectorPerCluster); ++i) {
-				char name[12];
-				memcpy(name, pkDir->filename, 11);
-				name[11] = '\0';
-
-				if (strcmp(name, dos_file_name) == 0) {
-					strcpy(file->filename, filename);
-					file->current = pkDir->first_cluster;
-					file->size = pkDir->file_size;
-					file->eof = 0;
-					file->pos = 0;
-					file->status = FS_STATUS_FOUND;
-					file->first_block = file->current;
-					file->device = fsys;
-					file->parent_block = kfile->first_block;
-					if (pkDir->attrib & 0x10)
-						file->flags |= FS_FLAG_DIRECTORY;
-					else
-						file->flags |= FS_FLAG_GENERAL;
-
-					AuPmmngrFree((void*)V2P((size_t)buf));
-					kfree(kfile);
-					return file;
-				}
-
-				pkDir++;
-			}
+		FatIndexEntry* ent = FatIndexLookup(fsys, kfile->first_block, filename);
+		if (ent) {
+			file = (AuVFSNode*)kmalloc(sizeof(AuVFSNode));
+			memset(file, 0, sizeof(AuVFSNode));
+			FatIndexFillNode(fsys, file, ent, filename, kfile->first_block);
 		}
 	}
-
-	AuPmmngrFree((void*)V2P((size_t)buf));
-	kfree(file);
-	if (kfile)
-		kfree(kfile);
-	return NULL;
+	kfree(kfile);
+	return file;
 }
 
-
+/*
+ * FatLocateDir -- looks up an entry inside root
+ * directory
+ * @param fsys -- Pointer to file system node
+ * @param dir -- name of the entry
+ */
 AuVFSNode* FatLocateDir(AuVFSNode* fsys, const char* dir) {
-	AuVFSNode* file = (AuVFSNode*)kmalloc(sizeof(AuVFSNode));
-	memset(file, 0, sizeof(AuVFSNode));
-
 	FatFS* fs = (FatFS*)fsys->device;
-	AuVDisk *vdisk = (AuVDisk*)fs->vdisk;
-	if (!vdisk)
+	FatIndexEntry* ent = FatIndexLookup(fsys, fs->__RootDirFirstCluster, dir);
+	if (!ent)
 		return NULL;
 
-	uint64_t* buf;
-	FatDir *dirent;
-	char dos_file_name[12];
-
-	FatToDOSFilename(dir, dos_file_name, 11);
-	dos_file_name[11] = 0;
-	
-	buf = (uint64_t*)P2V((uint64_t)AuPmmngrAlloc());
-	memset(buf, 0, PAGE_SIZE);
-	for (unsigned int sector = 0; sector < fs->__SectorPerCluster; sector++) {
-
-		memset(buf, 0, PAGE_SIZE);
-		//ata_read_28 (root_sector + sector,1, buf);
-		AuVDiskRead(vdisk, FatClusterToSector32(fs,fs->__RootDirFirstCluster) + sector, 1, (uint64_t*)V2P((uint64_t)buf));
-
-		dirent = (FatDir*)buf;
-	
-		for (int i = 0; i < 16; i++) {
-
-			char name[12];
-			memcpy(name, dirent->filename, 11);
-			name[11] = 0;
-			if (strcmp(dos_file_name, name) == 0) {
-
-				strcpy(file->filename, dir);
-				file->current = dirent->first_cluster;
-				file->size = dirent->file_size;
-				file->eof = 0;
-				file->status = FS_STATUS_FOUND;
-				file->close = 0;
-				file->first_block = file->current;
-				file->pos = 0;
-				file->device = fsys;
-				file->parent_block = fs->__RootDirFirstCluster;
-				if (dirent->attrib == 0x10)
-					file->flags |= FS_FLAG_DIRECTORY;
-				else
-					file->flags |= FS_FLAG_GENERAL;
-				SeTextOut("FAT OPEN -> %s %x \r\n", file->filename, file->current);
-				AuPmmngrFree((void*)V2P((size_t)buf));
-				return file;
-			}
-		
-			dirent++;
-		}
-	}
-
-	AuPmmngrFree((void*)V2P((size_t)buf));
-	kfree(file);
-	return NULL;
+	AuVFSNode* file = (AuVFSNode*)kmalloc(sizeof(AuVFSNode));
+	memset(file, 0, sizeof(AuVFSNode));
+	FatIndexFillNode(fsys, file, ent, dir, fs->__RootDirFirstCluster);
+	SeTextOut("FAT OPEN -> %s %x \r\n", file->filename, file->current);
+	return file;
 }
 
 
@@ -517,9 +730,9 @@ AuVFSNode * FatOpen(AuVFSNode * fsys, char* filename) {
 	while (p) {
 
 		//! get pathname
-		char pathname[16];
+		char pathname[FAT_LFN_MAX_NAME + 1];
 		int i = 0;
-		for (i = 0; i < 16; i++) {
+		for (i = 0; i < FAT_LFN_MAX_NAME; i++) {
 
 			//! if another '\' or end of line is reached, we are done
 			if (p[i] == '/' || p[i] == '\0')
@@ -552,8 +765,13 @@ AuVFSNode * FatOpen(AuVFSNode * fsys, char* filename) {
 	}
 
 	//! found file?
-	if (cur_dir)
+	if (cur_dir) {
+		/* size might not have reached the directory entry yet */
+		FatWriteBack* wb = FatWriteBackFind(fsys, cur_dir->first_block);
+		if (wb && wb->size > cur_dir->size)
+			cur_dir->size = wb->size;
 		return cur_dir;
+	}
 	//! unable to find
 	return NULL;
 }
@@ -567,15 +785,51 @@ AuVFSNode * FatOpen(AuVFSNode * fsys, char* filename) {
  */
 size_t FatGetClusterFor(AuVFSNode* fs,AuVFSNode* file, uint64_t offset){
 	FatFS *fatfs = (FatFS*)fs->device;
-	size_t index = offset / fatfs->cluster_sz_in_bytes;
+	uint64_t index = offset / fatfs->cluster_sz_in_bytes;
 	uint32_t cluster = file->first_block;
-	for (int i = 0; i < index; i++) 
+	for (uint64_t i = 0; i < index; i++) {
 		cluster = FatReadFAT(fs, cluster);
+		if (cluster >= (FAT_EOC_MARK & 0x0FFFFFFF))
+			break;
+	}
 	return cluster;
 }
 
 
+/*
+ * FatSync -- sync callback, writes out buffered data
+ * of a file or of the whole volume
+ * @param fsys -- Pointer to file system node
+ * @param file -- Pointer to file, null for whole volume
+ */
+int FatSync(AuVFSNode* fsys, AuVFSNode* file) {
+	if (!fsys)
+		return -1;
+	if (file && (file->flags & FS_FLAG_DIRECTORY))
+		return 0;
+	return FatWriteBackSync(fsys, file);
+}
 
+/*
+ * FatClose -- close callback, a closed file gets flushed,
+ * closing the file system itself flushes every file
+ * @param fsys -- Pointer to file system node
+ * @param file -- Pointer to file, null when file system
+ * is being removed
+ */
+int FatClose(AuVFSNode* fsys, AuVFSNode* file) {
+	if (!fsys)
+		return -1;
+	if (!file) {
+		FatWriteBackUnregister(fsys);
+		FatIndexUnregister(fsys);
+		kfree(fsys);
+		return 0;
+	}
+	if (!(file->flags & FS_FLAG_DIRECTORY))
+		FatWriteBackRelease(fsys, file->first_block);
+	return 0;
+}
 
 /*
 * FatInitialise -- initialise the fat file system
@@ -611,6 +865,7 @@ AuVFSNode* FatInitialise(AuVDisk *vdisk, char* mountname){
 	fs->fat_mutex = AuCreateMutex();
 	fs->fat_write_mutex = AuCreateMutex();
 	fs->fat_read_mutex = AuCreateMutex();
+	fs->dir_index = AuHashmapCreateInt(FAT_DIR_INDEX_BUCKETS);
 	fs->__TotalClusters = bpb->large_sector_count / fs->__SectorPerCluster;
 	fs->__LastIndexInFat = 0;
 	fs->__LastIndexSector = 0;
@@ -649,7 +904,11 @@ AuVFSNode* FatInitialise(AuVDisk *vdisk, char* mountname){
 	fsys->get_blockfor = FatGetClusterFor;
 	fsys->opendir = FatOpenDir;
 	fsys->read_dir = FatDirectoryRead;
+	fsys->close = FatClose;
+	fsys->sync = FatSync;
 	vdisk->fsys = fsys;
+	FatWriteBackRegister(fsys);
+	FatIndexRegister(fsys);
 	AuVFSAddFileSystem(fsys);
 	AuVFSRegisterRoot(fsys);
 
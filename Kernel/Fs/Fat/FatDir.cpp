@@ -29,6 +29,7 @@
 
 #include <Fs\Fat\FatDir.h>
 #include <Fs\Fat\Fat.h>
+#include <Fs\Fat\FatIndex.h>
 #include <Mm\kmalloc.h>
 #include <Mm\pmmngr.h>
 #include <Mm\vmmngr.h>
@@ -55,139 +56,96 @@ AuVFSNode* FatCreateDir(AuVFSNode* fsys,char* filename) {
 	if (!parent)
 		return NULL;
 
-	parent_clust = parent->current;
+	parent_clust = parent->first_block;
+	kfree(parent);
 
 	if (!parent_clust)
 		parent_clust = _fs->__RootDirFirstCluster;
 
-	AuVFSNode* file = (AuVFSNode*)kmalloc(sizeof(AuVFSNode));
-	memset(file, 0, sizeof(AuVFSNode));
-
-	uint64_t* buff = (uint64_t*)P2V((size_t)AuPmmngrAlloc());
-	memset(buff, 0, PAGE_SIZE);
-
 	/* now extract only the filename from
 	 * entire path */
-	char* path = (char*)filename;
-	char* p = strchr(path, '/');
-	if (p)
-		p++;
+	char extract[FAT_LFN_MAX_NAME + 1];
+	FatFileGetName(filename, extract);
+	if (!extract[0])
+		return NULL;
 
-	char extract[16];
-	memset(extract, 0, 16);
-	while (p) {
-		int i = 0;
-		for (i = 0; i < 16; i++) {
-			if (p[i] == '/' || p[i] == '\0')
-				break;
-			extract[i] = p[i];
-		}
-		p = strchr(p + 1, '/');
-		if (p)
-			p++;
+	/* allocate a new cluster for dir*/
+	uint32_t cluster = FatFindFreeCluster(fsys);
+	if (!cluster)
+		return NULL;
+	FatAllocCluster(fsys, cluster, FAT_EOC_MARK);
+
+	FatDir dirent;
+	memset(&dirent, 0, sizeof(FatDir));
+	dirent.attrib = FAT_ATTRIBUTE_DIRECTORY;
+	dirent.first_cluster = cluster & 0x0000FFFF;
+	dirent.first_cluster_hi_bytes = (cluster & 0x0FFF0000) >> 16;
+	dirent.date_created = FatFormatDate();
+	dirent.time_created = FatFormatTime();
+	dirent.last_wrt_date = dirent.date_created;
+	dirent.last_wrt_time = dirent.time_created;
+	dirent.date_last_accessed = 0;
+	dirent.file_size = 0;
+
+	int clust_pages = (_fs->cluster_sz_in_bytes + PAGE_SIZE - 1) / PAGE_SIZE;
+	void* frames = AuPmmngrAllocBlocks(clust_pages);
+	if (!frames) {
+		FatAllocCluster(fsys, cluster, 0);
+		return NULL;
 	}
 
-	char fname[11];
-	memset(fname, 0, 11);
-	FatToDOSFilename(extract, fname, 11);
-	fname[10] = 0;
-
-	while (1) {
-		for (int j = 0; j < _fs->__SectorPerCluster; j++) {
-			memset(buff, 0, PAGE_SIZE);
-			AuVDiskRead(_fs->vdisk, FatClusterToSector32(_fs, parent_clust) + j, 1, (uint64_t*)V2P((size_t)buff));
-
-			FatDir *dirent = (FatDir*)buff;
-			for (int i = 0; i < 16; i++) {
-				if (dirent->filename[0] == 0x00 || dirent->filename[0] == 0xE5) {
-
-					/* fill this direntry*/
-					memcpy(dirent->filename, fname, 11);
-
-					/* allocate a new cluster for dir*/
-					uint32_t cluster = FatFindFreeCluster(fsys);
-					FatAllocCluster(fsys, cluster, FAT_EOC_MARK);
-					FatClearCluster(fsys, cluster);
-
-					dirent->attrib = FAT_ATTRIBUTE_DIRECTORY;
-					dirent->first_cluster = cluster & 0x0000FFFF;
-					dirent->first_cluster_hi_bytes = (cluster & 0x0FFF0000) >> 16;
-					dirent->date_created = FatFormatDate();
-					dirent->time_created = FatFormatTime();
-					dirent->last_wrt_date = dirent->date_created;
-					dirent->last_wrt_time = dirent->last_wrt_time;
-					dirent->date_last_accessed = 0;
-					dirent->file_size = 0;
-
-					uint64_t* entrybuf = (uint64_t*)P2V((size_t)AuPmmngrAlloc());
-					memset(entrybuf, 0, PAGE_SIZE);
-
-					FatDir* dot_entry = (FatDir*)entrybuf;
-					memset(dot_entry, 0, sizeof(FatDir));
-					dot_entry->filename[0] = '.';
-					memset(dot_entry->filename + 1, 0x20, 10);
-					dot_entry->attrib = FAT_ATTRIBUTE_DIRECTORY;
-					dot_entry->date_created = dirent->date_created;
-					dot_entry->time_created = dirent->time_created;
-					dot_entry->file_size = 0;
-					dot_entry->first_cluster = dirent->first_cluster;
-					dot_entry->first_cluster_hi_bytes = dirent->first_cluster_hi_bytes;
-					dot_entry->last_wrt_date = dirent->last_wrt_date;
-					dot_entry->last_wrt_time = dirent->last_wrt_time;
-
-					FatDir* dotdot = (FatDir*)((uint8_t*)entrybuf + sizeof(FatDir));
-					memset(dotdot, 0, sizeof(FatDir));
-					dotdot->filename[0] = '.';
-					dotdot->filename[1] = '.';
-					dotdot->attrib = FAT_ATTRIBUTE_DIRECTORY;
-					dotdot->date_created = dirent->date_created;
-					dotdot->time_created = dirent->time_created;
-					dotdot->date_last_accessed = dirent->date_last_accessed;
-					dotdot->file_size = 0;
-
-					if (parent_clust == _fs->__RootDirFirstCluster) {
-						dotdot->first_cluster = 0 & 0x0000FFFF;
-						dotdot->first_cluster_hi_bytes = (0 & 0x0FFF0000) >> 16;
-					}
-					else {
-						dotdot->first_cluster = parent_clust & 0x0000FFFF;
-						dotdot->first_cluster_hi_bytes = (0 & 0x0FFF0000) >> 16;
-					}
-
-					dotdot->last_wrt_date = dirent->last_wrt_date;
-					dotdot->last_wrt_time = dirent->last_wrt_time;
+	FatIndexEntry* ent = FatIndexAddEntry(fsys, parent_clust, extract, &dirent);
+	if (!ent) {
+		AuPmmngrFreeBlocks(frames, clust_pages);
+		FatAllocCluster(fsys, cluster, 0);
+		return NULL;
+	}
 
-					AuVDiskWrite(_fs->vdisk, FatClusterToSector32(_fs, cluster), _fs->__SectorPerCluster, (uint64_t*)V2P((size_t)entrybuf));
-					AuVDiskWrite(_fs->vdisk, FatClusterToSector32(_fs, parent_clust) + j, 1, (uint64_t*)V2P((size_t)buff));
+	uint64_t* entrybuf = (uint64_t*)P2V((size_t)frames);
+	memset(entrybuf, 0, clust_pages * PAGE_SIZE);
+
+	FatDir* dot_entry = (FatDir*)entrybuf;
+	memset(dot_entry, 0, sizeof(FatDir));
+	dot_entry->filename[0] = '.';
+	memset(dot_entry->filename + 1, 0x20, 10);
+	dot_entry->attrib = FAT_ATTRIBUTE_DIRECTORY;
+	dot_entry->date_created = dirent.date_created;
+	dot_entry->time_created = dirent.time_created;
+	dot_entry->file_size = 0;
+	dot_entry->first_cluster = dirent.first_cluster;
+	dot_entry->first_cluster_hi_bytes = dirent.first_cluster_hi_bytes;
+	dot_entry->last_wrt_date = dirent.last_wrt_date;
+	dot_entry->last_wrt_time = dirent.last_wrt_time;
+
+	FatDir* dotdot = (FatDir*)((uint8_t*)entrybuf + sizeof(FatDir));
+	memset(dotdot, 0, sizeof(FatDir));
+	dotdot->filename[0] = '.';
+	dotdot->filename[1] = '.';
+	memset(dotdot->filename + 2, 0x20, 9);
+	dotdot->attrib = FAT_ATTRIBUTE_DIRECTORY;
+	dotdot->date_created = dirent.date_created;
+	dotdot->time_created = dirent.time_created;
+	dotdot->date_last_accessed = dirent.date_last_accessed;
+	dotdot->file_size = 0;
+
+	/* '..' of a root child points to cluster 0 */
+	if (parent_clust != _fs->__RootDirFirstCluster) {
+		dotdot->first_cluster = parent_clust & 0x0000FFFF;
+		dotdot->first_cluster_hi_bytes = (parent_clust & 0x0FFF0000) >> 16;
+	}
 
-					AuPmmngrFree((void*)V2P((size_t)entrybuf));
-					AuPmmngrFree((void*)V2P((size_t)buff));
+	dotdot->last_wrt_date = dirent.last_wrt_date;
+	dotdot->last_wrt_time = dirent.last_wrt_time;
 
-					strcpy(file->filename, extract);
-					file->size = 0;
-					file->eof = 0;
-					file->pos = 0;
-					file->current = cluster;
-					file->device = fsys;
-					file->first_block = file->current;
-					file->parent_block = parent_clust;
-					file->flags |= FS_FLAG_DIRECTORY;
-					kfree(parent);
-					return file;
-				}
-				dirent++;
-			}
-		}
+	/* whole cluster is written, so rest of the new
+	 * directory reads as end of directory */
+	AuVDiskWrite(_fs->vdisk, FatClusterToSector32(_fs, cluster), _fs->__SectorPerCluster, (uint64_t*)V2P((size_t)entrybuf));
+	AuPmmngrFreeBlocks((void*)V2P((size_t)entrybuf), clust_pages);
 
-		parent_clust = FatReadFAT(fsys, parent_clust);
-		if (parent_clust == (FAT_EOC_MARK & 0x0FFFFFFF))
-			break;
-	}
-
-	AuPmmngrFree((void*)V2P((size_t)buff));
-	kfree(parent);
-	kfree(file);
-	return NULL;
+	AuVFSNode* file = (AuVFSNode*)kmalloc(sizeof(AuVFSNode));
+	memset(file, 0, sizeof(AuVFSNode));
+	FatIndexFillNode(fsys, file, ent, extract, parent_clust);
+	return file;
 }
 
 /*
@@ -201,46 +159,24 @@ int FatRemoveDir(AuVFSNode* fsys, AuVFSNode* file) {
 	if (!file)
 		return -1;
 
-	FatFS* _fs = (FatFS*)fsys->device;
-
-	uint32_t dir_clust = file->current;
-
-	bool _is_empty = true;
-
-	uint64_t* buff = (uint64_t*)P2V((size_t)AuPmmngrAlloc());
-	memset(buff, 0, PAGE_SIZE);
-	/* verify, if the directory is empty*/
-	while (1) {
-		for (int j = 0; j < _fs->__SectorPerCluster; j++) {
-			memset(buff, 0, PAGE_SIZE);
-			AuVDiskRead(_fs->vdisk, FatClusterToSector32(_fs, dir_clust) + j, 1, (uint64_t*)V2P((size_t)buff));
-
-			FatDir *dirent = (FatDir*)buff;
-			for (int i = 0; i < 16; i++) {
-				char name[11];
-				memcpy(name, dirent->filename, 11);
-				name[10] = 0;
-
-				if ((dirent->filename[0] != 0x00) && (dirent->filename[0] != 0xE5)) {
-					AuPmmngrFree((void*)V2P((size_t)buff));
-					_is_empty = false;
-					break;
-				}
-				dirent++;
-			}
-		}
-
-		dir_clust = FatReadFAT(fsys, dir_clust);
-		if (dir_clust == (FAT_EOC_MARK & 0x0FFFFFFF))
-			break;
-	}
+	uint32_t dir_clust = file->first_block;
 
-	if (_is_empty) {
-		FatFileRemove(fsys, file);
-		return 0;
+	/* verify, if the directory is empty, '.' and '..'
+	 * are always there */
+	FatDirIndex* idx = FatIndexGet(fsys, dir_clust);
+	if (!idx)
+		return -1;
+	for (uint32_t i = 0; i < idx->entry_count; i++) {
+		FatIndexEntry* ent = idx->entries[i];
+		if (!ent->valid)
+			continue;
+		if ((strcmp(ent->short_name, ".") == 0) || (strcmp(ent->short_name, "..") == 0))
+			continue;
+		return -1;
 	}
 
-	return -1;
+	FatFileRemove(fsys, file);
+	return 0;
 }
 
 
@@ -302,80 +238,35 @@ int FatDirectoryRead(AuVFSNode* fs, AuVFSNode* dir, AuDirectoryEntry* dirent) {
 		return -1;
 
 	memset(dirent->filename, 0, 32);
-	int index = dirent->index;
-	FatFS* fatfs = (FatFS*)fs->device;
-	AuVDisk* vdisk = (AuVDisk*)fatfs->vdisk;
 
-	uint64_t* buf = (uint64_t*)P2V((uint64_t)AuPmmngrAlloc());
-	memset(buf, 0, PAGE_SIZE);
-		
-	if ((index / 16) > fatfs->__SectorPerCluster) {
+	/* entries come from directory index, disk is
+	 * only touched when the directory is first seen */
+	FatDirIndex* idx = FatIndexGet(fs, dir->first_block);
+	if (!idx) {
 		dirent->index = -1;
-		AuPmmngrFree((void*)V2P((size_t)buf));
 		return -1;
 	}
 
-
-	uint8_t* aligned_buf = (uint8_t*)buf;
-	AuVDiskRead(vdisk, FatClusterToSector32(fatfs, dir->first_block) + index/16, 1, (uint64_t*)V2P((uint64_t)buf));
-	FatDir* dir_ = (FatDir*)(aligned_buf + ((index % 16) * sizeof(FatDir)));
-
-	if (dir_->filename[0] == 0x00){
-		dirent->index = -1;
-		AuPmmngrFree((void*)V2P((size_t)buf));
-		return -1;
-	}
-
-	if (dir_->filename[0] == 0xE5 || 
-		dir_->filename[0] == 0x05 ||
-		dir_->filename[0] == 0xFF) {
-		AuPmmngrFree((void*)V2P((size_t)buf));
-		dirent->index += 1;
-		return -1;
-	}
-
-	if (dir_->attrib & 0x02){
-		AuPmmngrFree((void*)V2P((size_t)buf));
+	while (dirent->index >= 0 && (uint32_t)dirent->index < idx->entry_count) {
+		FatIndexEntry* ent = idx->entries[dirent->index];
 		dirent->index += 1;
-		return -1;
-	}
-
-	if (dir_->attrib & 0x04) {
-		AuPmmngrFree((void*)V2P((size_t)buf));
-		dirent->index += 1;
-		return -1;
-	}
-
-	if (dir_->attrib & 0x08) {
-		AuPmmngrFree((void*)V2P((size_t)buf));
-		dirent->index += 1;
-		return -1;
-	}
-
-	if (dir_->attrib & 0x01) {
-		AuPmmngrFree((void*)V2P((size_t)buf));
-		dirent->index += 1;
-		return -1;
+		if (!ent->valid)
+			continue;
+		/* hidden, system and read-only entries are not listed */
+		if (ent->attrib & (FAT_ATTRIBUTE_HIDDEN | FAT_ATTRIBUTE_SYSTEM | FAT_ATTRIBUTE_READ_ONLY))
+			continue;
+
+		FatIndexCopyName(dirent->filename, ent->name, sizeof(dirent->filename));
+		dirent->size = ent->size;
+		dirent->time = ent->time;
+		dirent->date = ent->date;
+		if (ent->attrib & FAT_ATTRIBUTE_DIRECTORY)
+			dirent->flags = FS_FLAG_DIRECTORY;
+		else
+			dirent->flags = FS_FLAG_GENERAL;
+		return 0;
 	}
 
-	char filename[11];
-	char name[11];
-	memset(name, 0, 11);
-	memcpy(name, dir_->filename, 11);
-	FatFromDosToFilename(filename, (char*)dir_->filename);
-	strcpy(dirent->filename,filename);
-	dirent->size = dir_->file_size;
-	dirent->time = dir_->time_created;
-	dirent->date = dir_->date_created;
-	
-	if ((dir_->attrib & FAT_ATTRIBUTE_MASK) == FAT_ATTRIBUTE_LONG_NAME)
-		SeTextOut("DIRName -> %s attrib -> %x, LFN -> yes \r\n", filename, dir_->attrib);
-	
-	if (dir_->attrib & 0x10)
-		dirent->flags = FS_FLAG_DIRECTORY;
-	if (dir_->attrib & 0x20)
-		dirent->flags = FS_FLAG_GENERAL;
-	AuPmmngrFree((void*)V2P((size_t)buf));
-	dirent->index += 1;
-	return 0;
-}
\ No newline at end of file
+	dirent->index = -1;
+	return -1;
+}
@@ -28,6 +28,9 @@
 **/
 
 #include <Fs\Fat\Fat.h>
+#include <Fs\Fat\FatFile.h>
+#include <Fs\Fat\FatIndex.h>
+#include <Fs\Fat\FatWriteBack.h>
 #include <Fs\vdisk.h>
 #include <Fs\vfs.h>
 #include <Mm\kmalloc.h>
@@ -48,59 +51,69 @@ AuVFSNode* FatFileGetParent(AuVFSNode* fsys, const char* filename) {
 	if (!fsys)
 		return NULL;
 	FatFS* _fs = (FatFS*)fsys->device;
-	AuVFSNode* parent = NULL;
 	AuVFSNode* retfile =(AuVFSNode*)kmalloc(sizeof(AuVFSNode));
 	memset(retfile, 0, sizeof(AuVFSNode));
-	char* path = (char*)filename;
-	SeTextOut("FatFileGetParent -> %s \r\n", path);
-	char* p = strchr(path, '/');
+	strcpy(retfile->filename, "/");
+	retfile->current = _fs->__RootDirFirstCluster;
+	retfile->first_block = _fs->__RootDirFirstCluster;
+	retfile->parent_block = _fs->__RootDirFirstCluster;
+	retfile->device = fsys;
+	retfile->status = FS_STATUS_FOUND;
+	retfile->flags |= FS_FLAG_DIRECTORY;
+
+	uint32_t dir_cluster = _fs->__RootDirFirstCluster;
+	char* p = strchr((char*)filename, '/');
 	if(p)
 		p++;
-	bool is_root = true;
 	
+	/* walk every component except the last one, which
+	 * is the entry being created */
 	while (p) {
-		char pathname[16];
-		int i = 0;
-		for (i = 0; i < 16; i++) {
-			if (p[i] == '/' || p[i] == '\0')
-				break;
-			pathname[i] = p[i];
-		}
-		pathname[i] = 0;
-		if (is_root) {
-			parent = FatLocateDir(fsys, pathname);
-			if (parent) {
-				memcpy(retfile, parent, sizeof(AuVFSNode));
-				kfree(parent);
-			}
-			is_root = false;
-		}
-		else {
-			parent = FatLocateSubDir(fsys, parent, pathname);
-			if (parent) {
-				memcpy(retfile, parent, sizeof(AuVFSNode));
-				kfree(parent);
+		char* next = strchr(p, '/');
+		if (!next)
+			break;
+		size_t len = next - p;
+		if (len) {
+			char pathname[FAT_LFN_MAX_NAME + 1];
+			if (len > FAT_LFN_MAX_NAME)
+				len = FAT_LFN_MAX_NAME;
+			memcpy(pathname, p, len);
+			pathname[len] = 0;
+			FatIndexEntry* ent = FatIndexLookup(fsys, dir_cluster, pathname);
+			if (!ent || !(ent->attrib & FAT_ATTRIBUTE_DIRECTORY)) {
+				kfree(retfile);
+				return NULL;
 			}
+			memset(retfile, 0, sizeof(AuVFSNode));
+			FatIndexFillNode(fsys, retfile, ent, pathname, dir_cluster);
+			dir_cluster = ent->first_cluster ? ent->first_cluster : _fs->__RootDirFirstCluster;
+			retfile->first_block = dir_cluster;
+			retfile->current = dir_cluster;
 		}
-		p = strchr(p + 1, '/');
-		if (p)
-			p++;
+		p = next + 1;
 	}
+	return retfile;
+}
 
-	if (!retfile) {
-		memset(retfile, 0, sizeof(AuVFSNode));
-		retfile->current = _fs->__RootDirFirstCluster;
-		retfile->first_block = _fs->__RootDirFirstCluster;
-		retfile->flags |= FS_FLAG_DIRECTORY;
+/*
+ * FatFileGetName -- extracts the last component
+ * of a path
+ * @param path -- path of the file
+ * @param name -- buffer of FAT_LFN_MAX_NAME + 1 bytes
+ */
+void FatFileGetName(const char* path, char* name) {
+	const char* last = path;
+	for (const char* p = path; *p; p++) {
+		if (*p == '/')
+			last = p + 1;
 	}
-	return retfile;
+	FatIndexCopyName(name, last, FAT_LFN_MAX_NAME + 1);
 }
+
 /*
  * FatCreateFile -- Creates a blank file 
  * @param fsys -- Pointer to file system
- * @param parent_cluster -- Parent cluster, if it's
- * 0 then parent_cluster equals to root_cluster
- * @param filename -- name of the file
+ * @param filename -- path of the file
  */
 AuVFSNode* FatCreateFile(AuVFSNode* fsys, char* filename) {
 	if (!fsys)
@@ -112,105 +125,46 @@ AuVFSNode* FatCreateFile(AuVFSNode* fsys, char* filename) {
 	if (!parent)
 		return NULL;
 	
-	uint32_t parent_cluster = parent->current;
+	uint32_t parent_cluster = parent->first_block;
+	kfree(parent);
 	if (!parent_cluster)
 		parent_cluster = _fs->__RootDirFirstCluster;
 
-	AuVFSNode* file = (AuVFSNode*)kmalloc(sizeof(AuVFSNode));
-	memset(file, 0, sizeof(AuVFSNode));
-
-	uint64_t* buff = (uint64_t*)P2V((size_t)AuPmmngrAlloc());
-	memset(buff, 0, PAGE_SIZE);
-
-	char* path = (char*)filename;
-	char* p = strchr(path, '/');
-	if (p)
-		p++;
+	char extract[FAT_LFN_MAX_NAME + 1];
+	FatFileGetName(filename, extract);
+	if (!extract[0])
+		return NULL;
 
-	char extract[16];
-	memset(extract, 0, 16);
-	while (p) {
-		int i = 0;
-		for (i = 0; i < 16; i++) {
-			if (p[i] == '/' || p[i] == '\0')
-				break;
-			extract[i] = p[i];
-		}
-		p = strchr(p + 1, '/');
-		if (p)
-			p++;
+	uint32_t cluster = FatFindFreeCluster(fsys);
+	if (!cluster)
+		return NULL;
+	FatAllocCluster(fsys, cluster, FAT_EOC_MARK);
+	FatClearCluster(fsys, cluster);
+
+	FatDir dirent;
+	memset(&dirent, 0, sizeof(FatDir));
+	dirent.attrib = FAT_ATTRIBUTE_ARCHIVE;
+	dirent.first_cluster = (uint16_t)(cluster & 0x0000FFFF);
+	dirent.first_cluster_hi_bytes = (uint16_t)((cluster & 0x0FFF0000) >> 16);
+	dirent.date_created = FatFormatDate();
+	dirent.time_created = FatFormatTime();
+	dirent.last_wrt_date = dirent.date_created;
+	dirent.last_wrt_time = dirent.time_created;
+	dirent.date_last_accessed = dirent.date_created;
+	dirent.file_size = 0; //by default, 0 bytes
+
+	/* the index refuses names already present in
+	 * the directory */
+	FatIndexEntry* ent = FatIndexAddEntry(fsys, parent_cluster, extract, &dirent);
+	if (!ent) {
+		FatAllocCluster(fsys, cluster, 0);
+		return NULL;
 	}
 
-	char fname[11];
-	memset(fname, 0, 11);
-	FatToDOSFilename(extract, fname, 11);
-	//fname[11] = 0;
-	SeTextOut("File name extracted -> %s \r\n", fname);
-
-	while (1) {
-		for (int j = 0; j < _fs->__SectorPerCluster; j++) {
-			memset(buff, 0, PAGE_SIZE);
-			AuVDiskRead(_fs->vdisk, FatClusterToSector32(_fs, parent_cluster) + j, 1, (uint64_t*)V2P((size_t)buff));
-
-			FatDir *dirent = (FatDir*)buff;
-			for (int i = 0; i < 16; i++) {
-				if ((dirent->filename[0] == 0x00) || (dirent->filename[0] == 0xE5)) {
-					memcpy(dirent->filename, fname, 11);
-
-					uint32_t cluster = FatFindFreeCluster(fsys);
-					FatAllocCluster(fsys, cluster, FAT_EOC_MARK);
-					FatClearCluster(fsys, cluster);
-					SeTextOut("Creating the flie %s cluster -> %x \r\n", fname, cluster);
-					dirent->attrib = FAT_ATTRIBUTE_ARCHIVE;
-					dirent->first_cluster = (uint16_t)(cluster & 0x0000FFFF);
-					dirent->first_cluster_hi_bytes = (uint16_t)((cluster & 0x0FFF0000) >> 16);
-					dirent->date_created = FatFormatDate();
-					dirent->time_created = FatFormatTime();
-					dirent->last_wrt_date = dirent->date_created;
-					dirent->last_wrt_time = dirent->time_created;
-					dirent->date_last_accessed = dirent->date_created;
-					dirent->file_size = 0; //by default, 0 bytes
-
-					uint64_t sector = FatClusterToSector32(_fs, parent_cluster);
-					SeTextOut("sector -> %d , sector -> %d \r\n", sector, sector + j);
-					SeTextOut("Parent cluster -> %d \r\n", parent_cluster);
-					SeTextOut("Cluster begin lba -> %d \r\n", _fs->__ClusterBeginLBA);
-					SeTextOut("Sectors/c -> %d \r\n", _fs->__SectorPerCluster);
-					SeTextOut("ROOT Cluster -> %d \r\n", _fs->__RootDirFirstCluster);
-					AuVDiskWrite(_fs->vdisk, sector + j, 1, (uint64_t*)V2P((size_t)buff));
-
-					SeTextOut("File created \r\n");
-				
-					AuPmmngrFree((void*)V2P((size_t)buff));
-
-
-					strcpy(file->filename, extract);
-					file->size = dirent->file_size;
-					file->eof = 0;
-					file->pos = 0;
-					file->current = cluster;
-					file->first_block = cluster;
-					file->parent_block = parent_cluster;
-					file->device = fsys;
-					file->flags |= FS_FLAG_GENERAL;
-					file->status = FS_STATUS_FOUND;
-					kfree(parent);
-					return file;
-				}
-				dirent++;
-			}
-		}
-		parent_cluster = FatReadFAT(fsys, parent_cluster);
-		if (parent_cluster == (FAT_EOC_MARK & 0x0FFFFFFF))
-			break;
-			/* actually, here we need to allocate a new
-			 * cluster and write it to root cluster
-			 * so that root directory expands
-			 */
-	}
-	kfree(parent);
-	kfree(file);
-	return NULL;
+	AuVFSNode* file = (AuVFSNode*)kmalloc(sizeof(AuVFSNode));
+	memset(file, 0, sizeof(AuVFSNode));
+	FatIndexFillNode(fsys, file, ent, extract, parent_cluster);
+	return file;
 }
 
 /*
@@ -226,43 +180,14 @@ void FatFileUpdateSize(AuVFSNode* fsys, AuVFSNode* file, size_t size) {
 		return;
 	if (!file->parent_block)
 		return;
-	FatFS *_fs = (FatFS*)fsys->device;
 
-	uint32_t dir_cluster = file->parent_block;
-	char fname[11];
-	memset(fname, 0, 11);
-	FatToDOSFilename(file->filename, fname, 11);
-	fname[11] = 0;
-	uint64_t* buff = (uint64_t*)P2V((size_t)AuPmmngrAlloc());
-	memset(buff, 0, PAGE_SIZE);
-
-	while (1) {
-		for (int j = 0; j < _fs->__SectorPerCluster; j++) {
-			memset(buff, 0, PAGE_SIZE);
-			AuVDiskRead(_fs->vdisk, FatClusterToSector32(_fs, dir_cluster) + j, 1, (uint64_t*)V2P((size_t)buff));
-
-			FatDir *dirent = (FatDir*)buff;
-			for (int i = 0; i < 16; i++) {
-				char name[11];
-				memcpy(name, dirent->filename, 11);
-				name[11] = 0;
-
-				if (strcmp(fname, name) == 0) {
-					dirent->file_size += size + 1;
-					AuVDiskWrite(_fs->vdisk, FatClusterToSector32(_fs, dir_cluster) + j, 1, (uint64_t*)V2P((size_t)buff));
-					AuPmmngrFree((void*)V2P((size_t)buff));
-					return;
-				}
-				dirent++;
-			}
-		}
-
-		dir_cluster = FatReadFAT(fsys, dir_cluster);
-		if (dir_cluster == (FAT_EOC_MARK & 0x0FFFFFFF)) {
-			break;
-		}
-	}
-	return;
+	FatIndexEntry* ent = FatIndexFindFile(fsys, file);
+	if (!ent)
+		return;
+	/* FAT32 directory entry can only hold 32 bit size */
+	if (size > 0xFFFFFFFF)
+		size = 0xFFFFFFFF;
+	FatIndexUpdateSize(fsys, file->parent_block, ent, (uint32_t)size);
 }
 
 
@@ -277,103 +202,34 @@ int FatFileUpdateFilename(AuVFSNode* fsys, AuVFSNode* file, char* newname) {
 		return -1;
 	if (!file)
 		return -1;
-	/*if (!file->parent_block)
-	return;*/
-	FatFS *_fs = (FatFS*)fsys->device;
-
-	uint32_t dir_cluster = file->parent_block;
-
-	char fname[11];
-	memset(fname, 0, 11);
-	FatToDOSFilename(file->filename, fname, 11);
-	//fname[11] = 0;
-
-	char nname[11];
-	memset(nname, 0, 11);
-	FatToDOSFilename(newname, nname, 11);
-	//nname[11] = 0;
-
-	uint64_t* buff = (uint64_t*)P2V((size_t)AuPmmngrAlloc());
-	memset(buff, 0, PAGE_SIZE);
-
-	while (1) {
-		for (int j = 0; j < _fs->__SectorPerCluster; j++) {
-			memset(buff, 0, PAGE_SIZE);
-			AuVDiskRead(_fs->vdisk, FatClusterToSector32(_fs, dir_cluster) + j, 1, (uint64_t*)V2P((size_t)buff));
-
-			FatDir *dirent = (FatDir*)buff;
-			for (int i = 0; i < 16; i++) {
-				char name[11];
-				memcpy(name, dirent->filename, 11);
-				//name[11] = 0;
-
-				if (strcmp(name, fname) == 0) {
-					memcpy(dirent->filename, nname, 11);
-					AuVDiskWrite(_fs->vdisk, FatClusterToSector32(_fs, dir_cluster) + j, 1, (uint64_t*)V2P((size_t)buff));
-					AuPmmngrFree((void*)V2P((size_t)buff));
-					return 0;
-				}
-				dirent++;
-			}
-		}
+	if (!file->parent_block)
+		return -1;
 
-		dir_cluster = FatReadFAT(fsys, dir_cluster);
-		if (dir_cluster == (FAT_EOC_MARK & 0x0FFFFFFF)) 
-			break;
-	}
-		
-	return -1;
+	FatIndexEntry* ent = FatIndexFindFile(fsys, file);
+	if (!ent)
+		return -1;
+	if (!FatIndexRenameEntry(fsys, file->parent_block, ent, newname))
+		return -1;
+	FatIndexCopyName(file->filename, newname, sizeof(file->filename));
+	return 0;
 }
 
 
 /*
- * FatFileWriteContent -- write contents to fat file (4kib)
+ * FatFileGetLastCluster -- walks the cluster chain of a
+ * file and returns the last cluster of it
  * @param fsys -- Pointer to file system node
- * @param first_cluster -- first cluster of the file
- * @param buffer -- buffer to write
+ * @param file -- Pointer to file
  */
-void FatFileWriteContent(AuVFSNode* fsys,AuVFSNode* file, uint64_t* buffer) {
-	if (!fsys)
-		return;
-	
-
-	FatFS* _fs = (FatFS*)fsys->device;
-
-	uint64_t* buff = (uint64_t*)P2V((size_t)AuPmmngrAlloc());
-	memset(buff, 0, PAGE_SIZE);
-
-	uint32_t cluster = file->current;
-	if (file->eof){
-	
-		/* write the new cluster value to
-		* old cluster */
-		uint32_t new_cluster = FatFindFreeCluster(fsys);
-		FatAllocCluster(fsys, cluster, new_cluster);
-		FatAllocCluster(fsys, new_cluster, FAT_EOC_MARK);
-		FatClearCluster(fsys, new_cluster);
-		uint32_t clust_val = FatReadFAT(fsys, cluster);
-		cluster = new_cluster;
-		file->eof = 0;
-	}
-
-	if ((cluster != (FAT_EOC_MARK & 0x0FFFFFFF)) || (cluster != (FAT_BAD_CLUSTER & 0x0fffffff))) {
-		memcpy(buff, buffer, PAGE_SIZE);
-		//SeTextOut("Writing -> %d \r\n", _fs->__SectorPerCluster);
-		AuVDiskWrite(_fs->vdisk, FatClusterToSector32(_fs, cluster), _fs->__SectorPerCluster, (uint64_t*)V2P((uint64_t)buff));
-		file->pos++;
-	}
-	uint32_t return_cluster = FatReadFAT(fsys, cluster);
-	if (return_cluster == (FAT_EOC_MARK & 0x0FFFFFFF)) {
-		file->eof = 1;
+uint32_t FatFileGetLastCluster(AuVFSNode* fsys, AuVFSNode* file) {
+	uint32_t cluster = file->first_block;
+	while (1) {
+		uint32_t next = FatReadFAT(fsys, cluster);
+		if (next >= (FAT_BAD_CLUSTER & 0x0FFFFFFF) || next == 0)
+			break;
+		cluster = next;
 	}
-	else
-		cluster = return_cluster;
-
-	file->current = cluster;
-	file->size = file->pos * _fs->__SectorPerCluster * _fs->__BytesPerSector;
-	size_t sz = file->size;
-
-	AuPmmngrFree((void*)V2P((size_t)buff));
+	return cluster;
 }
 
 /*
@@ -388,28 +244,113 @@ void FatFileWriteDone(AuVFSNode* file) {
 }
 
 /*
- * FatWrite -- write callback
+ * FatWrite -- write callback, writes the buffer starting
+ * from current byte position of the file, data going past
+ * the allocated cluster chain is buffered and gets clusters
+ * when the write-back flushes it
  * @param fsys -- pointer to file system
  * @param file -- pointer to file
  * @param buffer -- buffer to write
  * @param length -- bytes needed to write
  */
-size_t FatWrite(AuVFSNode* fsys, AuVFSNode* file, uint64_t* buffer, uint32_t length) {
+size_t FatWrite(AuVFSNode* fsys, AuVFSNode* file, uint64_t* buffer, size_t length) {
 	if (!fsys)
 		return 0;
+	if (!file)
+		return 0;
 	FatFS* _fs = (FatFS*)fsys->device;
+	size_t clust_sz = _fs->cluster_sz_in_bytes;
+	int clust_pages = (clust_sz + PAGE_SIZE - 1) / PAGE_SIZE;
 
-	size_t num_cluster = static_cast<size_t>(length) / (static_cast<size_t>(_fs->__BytesPerSector) * _fs->__SectorPerCluster) +
-		((length % (_fs->__BytesPerSector * _fs->__SectorPerCluster) ? 1 : 0));
+	FatWriteBack* wb = FatWriteBackGet(fsys, file);
+	if (!wb)
+		return 0;
 
-	for (int i = 0; i < num_cluster; i++) {
-		FatFileWriteContent(fsys, file, buffer);
-		buffer += (static_cast<size_t>(_fs->__BytesPerSector) * _fs->__SectorPerCluster);
+	uint8_t* src = (uint8_t*)buffer;
+	uint8_t* buff = NULL;
+	size_t written = 0;
+
+	while (written < length) {
+		if (file->pos >= wb->alloc_bytes) {
+			size_t buffered = FatWriteBackBuffer(fsys, wb, file->pos, src + written, length - written);
+			if (!buffered) {
+				/* buffer is full, make room by flushing it, a
+				 * position past its window first grows the file
+				 * up to the window so that the flush moves on,
+				 * no progress means the volume is full */
+				uint64_t alloc_bytes = wb->alloc_bytes;
+				uint64_t window = FatWriteBackWindow(fsys, wb);
+				if (file->pos >= window)
+					FatWriteBackSetSize(fsys, wb, window);
+				FatWriteBackFlush(fsys, wb);
+				if (wb->alloc_bytes == alloc_bytes)
+					break;
+				continue;
+			}
+			written += buffered;
+			file->pos += buffered;
+			FatWriteBackSetSize(fsys, wb, file->pos);
+			/* last allocated cluster stays as current, the
+			 * chain gets extended from it on flush */
+			file->eof = 1;
+			continue;
+		}
+
+		/* position went past the chain end seen by this handle,
+		 * the chain has grown since, find the cluster again */
+		if (file->eof || file->current >= (FAT_BAD_CLUSTER & 0x0FFFFFFF)) {
+			uint32_t tail = FatWriteBackClusterFor(fsys, wb, file->pos);
+			file->current = tail ? tail : FatGetClusterFor(fsys, file, file->pos);
+			file->eof = 0;
+		}
+		uint32_t cluster = file->current;
+
+		/* overwriting already allocated whole clusters, let
+		 * the disk pick the data up from caller's pages */
+		size_t direct = FatDirectTransfer(fsys, file, src + written, length - written, true);
+		if (direct) {
+			written += direct;
+			continue;
+		}
+
+		size_t offset_in_clust = file->pos % clust_sz;
+		size_t chunk = clust_sz - offset_in_clust;
+		if (chunk > (length - written))
+			chunk = length - written;
+
+		if (!buff) {
+			void* frames = AuPmmngrAllocBlocks(clust_pages);
+			if (!frames)
+				break;
+			buff = (uint8_t*)P2V((size_t)frames);
+		}
+		uint64_t lba = FatClusterToSector32(_fs, cluster);
+		/* partial cluster write, keep the rest of the old content */
+		if (chunk != clust_sz)
+			AuVDiskRead(_fs->vdisk, lba, _fs->__SectorPerCluster, (uint64_t*)V2P((size_t)buff));
+		memcpy(buff + offset_in_clust, src + written, chunk);
+		AuVDiskWrite(_fs->vdisk, lba, _fs->__SectorPerCluster, (uint64_t*)V2P((size_t)buff));
+
+		written += chunk;
+		file->pos += chunk;
+
+		if ((offset_in_clust + chunk) == clust_sz) {
+			uint32_t next = FatReadFAT(fsys, cluster);
+			if (next >= (FAT_BAD_CLUSTER & 0x0FFFFFFF))
+				file->eof = 1;
+			else
+				file->current = next;
+		}
 	}
 
-	FatFileUpdateSize(fsys, file, length);
-	//FatFileWriteDone(file);
+	if (buff)
+		AuPmmngrFreeBlocks((void*)V2P((size_t)buff), clust_pages);
 
+	/* directory entry is updated by the write-back */
+	if (file->pos > file->size)
+		file->size = file->pos;
+	FatWriteBackSetSize(fsys, wb, file->size);
+	return written;
 }
 
 /*
@@ -422,8 +363,6 @@ int FatFileClearDirEntry(AuVFSNode* fsys, AuVFSNode* file) {
 		return -1;
 	if (!file)
 		return -1;
-	
-	FatFS* _fs = (FatFS*)fsys->device;
 
 	uint32_t dir_clust = file->parent_block;
 	if (!dir_clust) {
@@ -431,42 +370,11 @@ int FatFileClearDirEntry(AuVFSNode* fsys, AuVFSNode* file) {
 		return 1;
 	}
 
-	char fname[11];
-	memset(fname, 0, 11);
-	FatToDOSFilename(file->filename, fname, 11);
-	fname[11] = 0;
-	SeTextOut("Dir clust -> %x \r\n", dir_clust);
-	uint64_t* buff = (uint64_t*)P2V((size_t)AuPmmngrAlloc());
-	memset(buff, 0, PAGE_SIZE);
-
-	while (1) {
-		for (int j = 0; j < _fs->__SectorPerCluster; j++) {
-			memset(buff, 0, PAGE_SIZE);
-			AuVDiskRead(_fs->vdisk, FatClusterToSector32(_fs, dir_clust) + j, 1, (uint64_t*)V2P((size_t)buff));
-
-			FatDir *dirent = (FatDir*)buff;
-			for (int i = 0; i < 16; i++) {
-				char name[11];
-				memcpy(name, dirent->filename, 11);
-				name[11] = 0;
-				if (strcmp(name, fname) == 0) {
-					memset(dirent, 0, sizeof(FatDir));
-					SeTextOut("Dir clearing found \r\n");
-					dirent->filename[0] = 0xE5;
-					AuVDiskWrite(_fs->vdisk, FatClusterToSector32(_fs, dir_clust) + j, 1, (uint64_t*)V2P((size_t)buff));
-					AuPmmngrFree((void*)V2P((size_t)buff));
-					return 0;
-				}
-				dirent++;
-			}
-		}
-
-		dir_clust = FatReadFAT(fsys, dir_clust);
-		if (dir_clust == (FAT_EOC_MARK & 0x0FFFFFFF)) 
-			break;
-
-	}
-	return -1;
+	/* LFN entries of the file go along with it */
+	FatIndexEntry* ent = FatIndexFindFile(fsys, file);
+	if (!ent)
+		return -1;
+	return FatIndexRemoveEntry(fsys, dir_clust, ent);
 }
 
 /*
@@ -484,6 +392,9 @@ int FatFileRemove(AuVFSNode* fsys, AuVFSNode* file) {
 	if (!parent_clust)
 		return 1;
 
+	/* buffered data of the file has nowhere to go */
+	FatWriteBackDiscard(fsys, file->first_block);
+
 	/* because we will iterate all clusters from
 	 * first one
 	 */
@@ -506,6 +417,10 @@ int FatFileRemove(AuVFSNode* fsys, AuVFSNode* file) {
 
 	/* clear the dir entry */
 	FatFileClearDirEntry(fsys, file);
+
+	/* clusters of a removed directory might come back
+	 * as another directory, forget its index */
+	FatIndexDrop(fsys, file->first_block);
 	return 0;
 }
 
@@ -0,0 +1,1025 @@
+/**
+* BSD 2-Clause License
+*
+* Copyright (c) 2022-2023, Manas Kamal Choudhury
+* All rights reserved.
+*
+* Redistribution and use in source and binary forms, with or without
+* modification, are permitted provided that the following conditions are met:
+*
+* 1. Redistributions of source code must retain the above copyright notice, this
+*    list of conditions and the following disclaimer.
+*
+* 2. Redistributions in binary form must reproduce the above copyright notice,
+*    this list of conditions and the following disclaimer in the documentation
+*    and/or other materials provided with the distribution.
+*
+* THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+* AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+* IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+* DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE
+* FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+* DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR
+* SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER
+* CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY,
+* OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+* OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+*
+**/
+
+#include <Fs\Fat\FatIndex.h>
+#include <Fs\Fat\Fat.h>
+#include <Fs\vdisk.h>
+#include <Fs\vfs.h>
+#include <Mm\kmalloc.h>
+#include <Mm\pmmngr.h>
+#include <Mm\vmmngr.h>
+#include <string.h>
+#include <ctype.h>
+#include <_null.h>
+#include <Hal\serial.h>
+#include <Hal\x86_64_sched.h>
+#include <Mm\reclaim.h>
+#include <list.h>
+
+#define FAT_SLOT_SIZE  32
+/* FAT never allows more than 65536 entries in a directory */
+#define FAT_DIR_MAX_SLOTS  65536
+/* characters allowed in a short name besides letters and digits */
+static const char* _fat_short_specials = "$%'-_@~`!(){}^#&";
+static list_t* _fat_index_volumes;
+
+/*
+ * FatIndexGrow -- grows an allocation, newly added
+ * bytes are zeroed
+ * @param old -- old allocation, can be null
+ * @param old_sz -- old size in bytes
+ * @param new_sz -- new size in bytes
+ */
+static void* FatIndexGrow(void* old, size_t old_sz, size_t new_sz) {
+	void* ptr = kmalloc(new_sz);
+	memset(ptr, 0, new_sz);
+	if (old) {
+		memcpy(ptr, old, old_sz);
+		kfree(old);
+	}
+	return ptr;
+}
+
+/*
+ * FatIndexKey -- converts a name to its hash key, names
+ * are matched case insensitively
+ * @param name -- name to convert
+ * @param key -- buffer of FAT_LFN_MAX_NAME + 1 bytes
+ */
+static void FatIndexKey(const char* name, char* key) {
+	int i = 0;
+	for (; name[i] && i < FAT_LFN_MAX_NAME; i++)
+		key[i] = tolower(name[i]);
+	key[i] = 0;
+}
+
+/*
+ * FatIndexCopyName -- copies a name into a fixed size
+ * buffer, truncating it when needed
+ * @param dest -- destination buffer
+ * @param name -- name to copy
+ * @param dest_sz -- size of destination buffer
+ */
+void FatIndexCopyName(char* dest, const char* name, size_t dest_sz) {
+	size_t i = 0;
+	for (; name[i] && i < (dest_sz - 1); i++)
+		dest[i] = name[i];
+	memset(dest + i, 0, dest_sz - i);
+}
+
+/*
+ * FatIndexSlotSector -- returns the sector holding a
+ * directory slot
+ * @param fs -- Pointer to fat file system
+ * @param idx -- directory index
+ * @param slot -- slot number
+ * @param offset -- receives byte offset of the slot
+ * within the sector
+ */
+static uint64_t FatIndexSlotSector(FatFS* fs, FatDirIndex* idx, uint32_t slot, uint32_t* offset) {
+	uint32_t per_sector = fs->__BytesPerSector / FAT_SLOT_SIZE;
+	uint32_t per_cluster = fs->cluster_sz_in_bytes / FAT_SLOT_SIZE;
+	uint32_t in_cluster = slot % per_cluster;
+	*offset = (in_cluster % per_sector) * FAT_SLOT_SIZE;
+	return FatClusterToSector32(fs, idx->clusters[slot / per_cluster]) + (in_cluster / per_sector);
+}
+
+static bool FatIndexSlotUsed(FatDirIndex* idx, uint32_t slot) {
+	return (idx->slot_map[slot / 8] & (1 << (slot % 8))) != 0;
+}
+
+static void FatIndexSlotMark(FatDirIndex* idx, uint32_t slot, bool used) {
+	if (used)
+		idx->slot_map[slot / 8] |= (1 << (slot % 8));
+	else
+		idx->slot_map[slot / 8] &= ~(1 << (slot % 8));
+}
+
+/*
+ * FatIndexWriteSlots -- writes consecutive slots of a
+ * directory, every touched sector is read and written
+ * once. If ents is null, slots are marked deleted
+ * @param fsys -- Pointer to file system node
+ * @param idx -- directory index
+ * @param slot -- first slot
+ * @param ents -- entries to write
+ * @param count -- number of slots
+ */
+static void FatIndexWriteSlots(AuVFSNode* fsys, FatDirIndex* idx, uint32_t slot, FatDir* ents, uint32_t count) {
+	FatFS* fs = (FatFS*)fsys->device;
+	uint8_t* buff = (uint8_t*)P2V((size_t)AuPmmngrAlloc());
+	uint64_t cur_sector = 0;
+	bool loaded = false;
+	for (uint32_t i = 0; i < count; i++) {
+		uint32_t offset = 0;
+		uint64_t sector = FatIndexSlotSector(fs, idx, slot + i, &offset);
+		if (!loaded || sector != cur_sector) {
+			if (loaded)
+				AuVDiskWrite(fs->vdisk, cur_sector, 1, (uint64_t*)V2P((size_t)buff));
+			AuVDiskRead(fs->vdisk, sector, 1, (uint64_t*)V2P((size_t)buff));
+			cur_sector = sector;
+			loaded = true;
+		}
+		if (ents)
+			memcpy(buff + offset, &ents[i], sizeof(FatDir));
+		else
+			buff[offset] = FAT_DIR_ENTRY_FREE;
+	}
+	if (loaded)
+		AuVDiskWrite(fs->vdisk, cur_sector, 1, (uint64_t*)V2P((size_t)buff));
+	AuPmmngrFree((void*)V2P((size_t)buff));
+}
+
+/*
+ * FatIndexReadSlot -- reads a single directory slot
+ * @param fsys -- Pointer to file system node
+ * @param idx -- directory index
+ * @param slot -- slot number
+ * @param ent -- receives the entry
+ */
+static void FatIndexReadSlot(AuVFSNode* fsys, FatDirIndex* idx, uint32_t slot, FatDir* ent) {
+	FatFS* fs = (FatFS*)fsys->device;
+	uint8_t* buff = (uint8_t*)P2V((size_t)AuPmmngrAlloc());
+	uint32_t offset = 0;
+	uint64_t sector = FatIndexSlotSector(fs, idx, slot, &offset);
+	AuVDiskRead(fs->vdisk, sector, 1, (uint64_t*)V2P((size_t)buff));
+	memcpy(ent, buff + offset, sizeof(FatDir));
+	AuPmmngrFree((void*)V2P((size_t)buff));
+}
+
+/*
+ * FatIndexInsert -- adds an entry to the index, if a name
+ * is already present the first one keeps it. Position of
+ * an unlinked entry is reused before the list grows
+ * @param idx -- directory index
+ * @param ent -- entry to add
+ */
+static void FatIndexInsert(FatDirIndex* idx, FatIndexEntry* ent) {
+	bool placed = false;
+	for (uint32_t i = 0; idx->dead_count && i < idx->entry_count; i++) {
+		if (!idx->entries[i]->valid) {
+			kfree(idx->entries[i]);
+			idx->entries[i] = ent;
+			idx->dead_count--;
+			placed = true;
+			break;
+		}
+	}
+	if (!placed && idx->entry_count == idx->entry_cap) {
+		uint32_t cap = idx->entry_cap ? idx->entry_cap * 2 : 32;
+		idx->entries = (FatIndexEntry**)FatIndexGrow(idx->entries, idx->entry_cap * sizeof(FatIndexEntry*),
+			cap * sizeof(FatIndexEntry*));
+		idx->entry_cap = cap;
+	}
+	if (!placed)
+		idx->entries[idx->entry_count++] = ent;
+
+	char key[FAT_LFN_MAX_NAME + 1];
+	FatIndexKey(ent->name, key);
+	if (!AuHashmapHas(idx->long_names, key))
+		AuHashmapSet(idx->long_names, key, ent);
+	FatIndexKey(ent->short_name, key);
+	if (!AuHashmapHas(idx->short_names, key))
+		AuHashmapSet(idx->short_names, key, ent);
+	/* empty files have no cluster yet */
+	if (ent->first_cluster && !AuHashmapHas(idx->clusters_map, (void*)(size_t)ent->first_cluster))
+		AuHashmapSet(idx->clusters_map, (void*)(size_t)ent->first_cluster, ent);
+}
+
+/*
+ * FatIndexUnlink -- removes an entry from name tables,
+ * the entry itself stays in the list as invalid so that
+ * running directory enumerations keep their position,
+ * the next insert takes its place
+ * @param idx -- directory index
+ * @param ent -- entry to unlink
+ */
+static void FatIndexUnlink(FatDirIndex* idx, FatIndexEntry* ent) {
+	char key[FAT_LFN_MAX_NAME + 1];
+	FatIndexKey(ent->name, key);
+	if (AuHashmapGet(idx->long_names, key) == ent)
+		AuHashmapRemove(idx->long_names, key);
+	FatIndexKey(ent->short_name, key);
+	if (AuHashmapGet(idx->short_names, key) == ent)
+		AuHashmapRemove(idx->short_names, key);
+	if (ent->first_cluster && AuHashmapGet(idx->clusters_map, (void*)(size_t)ent->first_cluster) == ent)
+		AuHashmapRemove(idx->clusters_map, (void*)(size_t)ent->first_cluster);
+	kfree(ent->name);
+	ent->name = NULL;
+	ent->valid = false;
+	idx->dead_count++;
+}
+
+/*
+ * FatIndexNewEntry -- creates an index entry from a short
+ * directory entry
+ * @param dirent -- short directory entry
+ * @param long_name -- long name if any, else null
+ * @param slot -- slot of the short entry
+ * @param lfn_count -- number of LFN slots in front of it
+ */
+static FatIndexEntry* FatIndexNewEntry(FatDir* dirent, const char* long_name, uint32_t slot, uint8_t lfn_count) {
+	FatIndexEntry* ent = (FatIndexEntry*)kmalloc(sizeof(FatIndexEntry));
+	memset(ent, 0, sizeof(FatIndexEntry));
+	memcpy(ent->dos_name, dirent->filename, 11);
+	FatFromDosToFilename(ent->short_name, (char*)dirent->filename);
+	const char* name = long_name ? long_name : ent->short_name;
+	ent->name = (char*)kmalloc(strlen(name) + 1);
+	strcpy(ent->name, name);
+	ent->first_cluster = ((uint32_t)dirent->first_cluster_hi_bytes << 16) | dirent->first_cluster;
+	ent->size = dirent->file_size;
+	ent->date = dirent->date_created;
+	ent->time = dirent->time_created;
+	ent->attrib = dirent->attrib;
+	ent->slot = slot;
+	ent->lfn_count = lfn_count;
+	ent->valid = true;
+	return ent;
+}
+
+/*
+ * FatLFNGetChars -- extracts the characters of a LFN
+ * entry, non ASCII characters are replaced with '_'
+ * @param lfn -- LFN entry
+ * @param out -- buffer of at least 13 bytes
+ */
+static int FatLFNGetChars(FatLFN* lfn, char* out) {
+	uint8_t* parts[3] = { lfn->nameOne, lfn->nameTwo, lfn->nameThree };
+	int lens[3] = { 5, 6, 2 };
+	int n = 0;
+	for (int p = 0; p < 3; p++) {
+		for (int i = 0; i < lens[p]; i++) {
+			uint16_t c = parts[p][i * 2] | (parts[p][i * 2 + 1] << 8);
+			if (c == 0x0000 || c == 0xFFFF)
+				return n;
+			out[n++] = (c < 0x80) ? (char)c : '_';
+		}
+	}
+	return n;
+}
+
+/*
+ * FatLFNSetChars -- fills the characters of a LFN entry,
+ * name is terminated with 0x0000 and padded with 0xFFFF
+ * @param lfn -- LFN entry
+ * @param name -- characters to store
+ * @param len -- number of characters left in name
+ */
+static void FatLFNSetChars(FatLFN* lfn, const char* name, size_t len) {
+	uint8_t* parts[3] = { lfn->nameOne, lfn->nameTwo, lfn->nameThree };
+	int lens[3] = { 5, 6, 2 };
+	size_t n = 0;
+	for (int p = 0; p < 3; p++) {
+		for (int i = 0; i < lens[p]; i++) {
+			uint16_t c;
+			if (n < len)
+				c = (uint8_t)name[n];
+			else if (n == len)
+				c = 0x0000;
+			else
+				c = 0xFFFF;
+			parts[p][i * 2] = c & 0xFF;
+			parts[p][i * 2 + 1] = (c >> 8) & 0xFF;
+			n++;
+		}
+	}
+}
+
+/*
+ * FatIndexBuild -- reads a directory cluster by cluster
+ * and builds its index
+ * @param fsys -- Pointer to file system node
+ * @param dir_cluster -- first cluster of the directory
+ */
+static FatDirIndex* FatIndexBuild(AuVFSNode* fsys, uint32_t dir_cluster) {
+	FatFS* fs = (FatFS*)fsys->device;
+	uint32_t per_cluster = fs->cluster_sz_in_bytes / FAT_SLOT_SIZE;
+
+	FatDirIndex* idx = (FatDirIndex*)kmalloc(sizeof(FatDirIndex));
+	memset(idx, 0, sizeof(FatDirIndex));
+	idx->first_cluster = dir_cluster;
+
+	/* collect the cluster chain first */
+	uint32_t cap = 0;
+	uint32_t cluster = dir_cluster;
+	while (cluster >= 2 && cluster < (FAT_BAD_CLUSTER & 0x0FFFFFFF)) {
+		if ((idx->cluster_count + 1) * per_cluster > FAT_DIR_MAX_SLOTS)
+			break;
+		if (idx->cluster_count == cap) {
+			idx->clusters = (uint32_t*)FatIndexGrow(idx->clusters, cap * sizeof(uint32_t), (cap + 8) * sizeof(uint32_t));
+			cap += 8;
+		}
+		idx->clusters[idx->cluster_count++] = cluster;
+		cluster = FatReadFAT(fsys, cluster);
+	}
+	if (!idx->cluster_count) {
+		kfree(idx);
+		return NULL;
+	}
+
+	int clust_pages = (fs->cluster_sz_in_bytes + PAGE_SIZE - 1) / PAGE_SIZE;
+	void* frames = AuPmmngrAllocBlocks(clust_pages);
+	if (!frames) {
+		kfree(idx->clusters);
+		kfree(idx);
+		return NULL;
+	}
+
+	idx->slot_count = idx->cluster_count * per_cluster;
+	idx->end_slot = idx->slot_count;
+	idx->slot_map = (uint8_t*)FatIndexGrow(NULL, 0, (idx->slot_count + 7) / 8);
+	idx->long_names = AuHashmapCreate(FAT_INDEX_BUCKETS);
+	idx->short_names = AuHashmapCreate(FAT_INDEX_BUCKETS);
+	idx->clusters_map = AuHashmapCreateInt(FAT_INDEX_BUCKETS);
+
+	uint8_t* buff = (uint8_t*)P2V((size_t)frames);
+	char* lfn_name = (char*)kmalloc(FAT_LFN_MAX_NAME + FAT_LFN_CHARS_PER_ENTRY + 1);
+
+	/* state of the LFN sequence collected so far */
+	int lfn_next = 0;
+	int lfn_len = 0;
+	uint8_t lfn_sum = 0;
+	uint8_t lfn_slots = 0;
+	bool done = false;
+
+	for (uint32_t c = 0; c < idx->cluster_count && !done; c++) {
+		AuVDiskRead(fs->vdisk, FatClusterToSector32(fs, idx->clusters[c]), fs->__SectorPerCluster,
+			(uint64_t*)V2P((size_t)buff));
+		for (uint32_t i = 0; i < per_cluster; i++) {
+			uint32_t slot = c * per_cluster + i;
+			FatDir* dirent = (FatDir*)(buff + i * FAT_SLOT_SIZE);
+
+			if (dirent->filename[0] == FAT_DIR_ENTRY_END) {
+				idx->end_slot = slot;
+				done = true;
+				break;
+			}
+			if (dirent->filename[0] == FAT_DIR_ENTRY_FREE) {
+				lfn_slots = 0;
+				continue;
+			}
+
+			FatIndexSlotMark(idx, slot, true);
+
+			if ((dirent->attrib & FAT_ATTRIBUTE_MASK) == FAT_ATTRIBUTE_LONG_NAME) {
+				FatLFN* lfn = (FatLFN*)dirent;
+				int order = lfn->order & FAT_LFN_ORDER_MASK;
+				if (lfn->order & FAT_LFN_LAST_ENTRY) {
+					lfn_slots = 0;
+					if (order == 0 || (order * FAT_LFN_CHARS_PER_ENTRY) > (FAT_LFN_MAX_NAME + FAT_LFN_CHARS_PER_ENTRY))
+						continue;
+					memset(lfn_name, 0, FAT_LFN_MAX_NAME + FAT_LFN_CHARS_PER_ENTRY + 1);
+					lfn_len = (order - 1) * FAT_LFN_CHARS_PER_ENTRY +
+						FatLFNGetChars(lfn, lfn_name + (order - 1) * FAT_LFN_CHARS_PER_ENTRY);
+					lfn_sum = lfn->checkSum;
+					lfn_next = order - 1;
+					lfn_slots = 1;
+				}
+				else if (lfn_slots && order == lfn_next && lfn->checkSum == lfn_sum) {
+					FatLFNGetChars(lfn, lfn_name + (order - 1) * FAT_LFN_CHARS_PER_ENTRY);
+					lfn_next--;
+					lfn_slots++;
+				}
+				else
+					lfn_slots = 0;
+				continue;
+			}
+
+			/* volume label is not a directory member */
+			if (dirent->attrib & FAT_ATTRIBUTE_VOLUME) {
+				lfn_slots = 0;
+				continue;
+			}
+
+			const char* long_name = NULL;
+			if (lfn_slots && lfn_next == 0 && FatCalculateCheckSum(dirent->filename) == lfn_sum) {
+				if (lfn_len > FAT_LFN_MAX_NAME)
+					lfn_len = FAT_LFN_MAX_NAME;
+				lfn_name[lfn_len] = 0;
+				long_name = lfn_name;
+			}
+			else
+				lfn_slots = 0;
+
+			FatIndexInsert(idx, FatIndexNewEntry(dirent, long_name, slot, lfn_slots));
+			lfn_slots = 0;
+		}
+	}
+
+	kfree(lfn_name);
+	AuPmmngrFreeBlocks((void*)V2P((size_t)buff), clust_pages);
+	return idx;
+}
+
+/*
+ * FatIndexGet -- returns the index of a directory, builds
+ * it from disk on first access
+ * @param fsys -- Pointer to file system node
+ * @param dir_cluster -- first cluster of the directory
+ */
+FatDirIndex* FatIndexGet(AuVFSNode* fsys, uint32_t dir_cluster) {
+	if (!fsys)
+		return NULL;
+	FatFS* fs = (FatFS*)fsys->device;
+	/* '..' entries pointing to root store cluster 0 */
+	if (dir_cluster == 0)
+		dir_cluster = fs->__RootDirFirstCluster;
+	if (!fs->dir_index)
+		fs->dir_index = AuHashmapCreateInt(FAT_DIR_INDEX_BUCKETS);
+
+	FatDirIndex* idx = (FatDirIndex*)AuHashmapGet(fs->dir_index, (void*)(size_t)dir_cluster);
+	if (!idx) {
+		idx = FatIndexBuild(fsys, dir_cluster);
+		if (!idx)
+			return NULL;
+		AuHashmapSet(fs->dir_index, (void*)(size_t)dir_cluster, idx);
+	}
+	idx->last_use = AuGetSystemTimerTick();
+	return idx;
+}
+
+/*
+ * FatIndexFindExact -- looks up a name in long and short
+ * name tables
+ * @param idx -- directory index
+ * @param name -- name to look for
+ */
+static FatIndexEntry* FatIndexFindExact(FatDirIndex* idx, const char* name) {
+	char key[FAT_LFN_MAX_NAME + 1];
+	FatIndexKey(name, key);
+	FatIndexEntry* ent = (FatIndexEntry*)AuHashmapGet(idx->long_names, key);
+	if (!ent)
+		ent = (FatIndexEntry*)AuHashmapGet(idx->short_names, key);
+	return ent;
+}
+
+/*
+ * FatIndexLookup -- looks up an entry by its long or
+ * short name, case insensitively
+ * @param fsys -- Pointer to file system node
+ * @param dir_cluster -- first cluster of the directory
+ * @param name -- name to look for
+ */
+FatIndexEntry* FatIndexLookup(AuVFSNode* fsys, uint32_t dir_cluster, const char* name) {
+	FatDirIndex* idx = FatIndexGet(fsys, dir_cluster);
+	if (!idx)
+		return NULL;
+	if (!name || !name[0])
+		return NULL;
+	FatIndexEntry* ent = FatIndexFindExact(idx, name);
+	if (ent)
+		return ent;
+
+	/* files written without LFN support carry the name
+	 * truncated to 8.3, try that form too. Entries with a
+	 * long name are only found by it or by their exact
+	 * short name, never by a truncated guess */
+	char dos_name[12];
+	char short_name[13];
+	memset(short_name, 0, 13);
+	FatToDOSFilename(name, dos_name, 11);
+	dos_name[11] = 0;
+	FatFromDosToFilename(short_name, dos_name);
+	char key[FAT_LFN_MAX_NAME + 1];
+	FatIndexKey(short_name, key);
+	ent = (FatIndexEntry*)AuHashmapGet(idx->short_names, key);
+	if (ent && ent->lfn_count)
+		return NULL;
+	return ent;
+}
+
+/*
+ * FatIndexFindFile -- returns the directory entry backing
+ * an opened file
+ * @param fsys -- Pointer to file system node
+ * @param file -- Pointer to file
+ */
+FatIndexEntry* FatIndexFindFile(AuVFSNode* fsys, AuVFSNode* file) {
+	if (!file || !file->parent_block)
+		return NULL;
+	FatDirIndex* idx = FatIndexGet(fsys, file->parent_block);
+	if (!idx)
+		return NULL;
+	/* first cluster identifies a file better than its
+	 * name, which might have been truncated in the node */
+	if (file->first_block) {
+		FatIndexEntry* ent = (FatIndexEntry*)AuHashmapGet(idx->clusters_map, (void*)(size_t)file->first_block);
+		if (ent)
+			return ent;
+	}
+	return FatIndexLookup(fsys, file->parent_block, file->filename);
+}
+
+/*
+ * FatIndexIsShortChar -- checks if a character can be
+ * stored in a short name
+ */
+static bool FatIndexIsShortChar(char c) {
+	if ((uint8_t)c >= 0x80)
+		return false;
+	if (isalpha((uint8_t)c) || isdigit((uint8_t)c))
+		return true;
+	return c && strchr((char*)_fat_short_specials, c) != NULL;
+}
+
+/*
+ * FatIndexMakeShortName -- generates the 8.3 name for a
+ * new entry, returns true if the name needs LFN entries
+ * to be represented
+ * @param idx -- directory index
+ * @param name -- long name
+ * @param dos_name -- receives 11 byte short name
+ */
+static bool FatIndexMakeShortName(FatDirIndex* idx, const char* name, uint8_t* dos_name) {
+	size_t len = strlen(name);
+	int last_dot = -1;
+	int dot_count = 0;
+	for (size_t i = 0; i < len; i++) {
+		if (name[i] == '.') {
+			last_dot = i;
+			dot_count++;
+		}
+	}
+
+	/* name already fits 8.3, only keep LFN if case differs */
+	size_t base_len = (last_dot == -1) ? len : last_dot;
+	size_t ext_len = (last_dot == -1) ? 0 : len - last_dot - 1;
+	bool fits = (dot_count <= 1 && base_len >= 1 && base_len <= 8 && ext_len <= 3);
+	bool has_lower = false;
+	for (size_t i = 0; i < len && fits; i++) {
+		if ((int)i == last_dot)
+			continue;
+		if (!FatIndexIsShortChar(name[i]))
+			fits = false;
+		if (islower((uint8_t)name[i]))
+			has_lower = true;
+	}
+	memset(dos_name, ' ', 11);
+	if (fits) {
+		for (size_t i = 0; i < base_len; i++)
+			dos_name[i] = toupper(name[i]);
+		for (size_t i = 0; i < ext_len; i++)
+			dos_name[8 + i] = toupper(name[last_dot + 1 + i]);
+		return has_lower;
+	}
+
+	/* lossy conversion, build basis name and add numeric tail */
+	char basis[8];
+	int basis_len = 0;
+	for (size_t i = 0; i < base_len && basis_len < 8; i++) {
+		char c = name[i];
+		if (c == ' ' || c == '.')
+			continue;
+		basis[basis_len++] = FatIndexIsShortChar(c) ? toupper(c) : '_';
+	}
+	if (!basis_len)
+		basis[basis_len++] = '_';
+	int ext_n = 0;
+	for (size_t i = 0; i < ext_len && ext_n < 3; i++) {
+		char c = name[last_dot + 1 + i];
+		if (c == ' ')
+			continue;
+		dos_name[8 + ext_n++] = FatIndexIsShortChar(c) ? toupper(c) : '_';
+	}
+
+	for (uint32_t n = 1; n < 1000000; n++) {
+		char tail[8];
+		int tail_len = 0;
+		char digits[7];
+		int d = 0;
+		for (uint32_t v = n; v; v /= 10)
+			digits[d++] = '0' + (v % 10);
+		tail[tail_len++] = '~';
+		while (d)
+			tail[tail_len++] = digits[--d];
+
+		int keep = basis_len;
+		if (keep + tail_len > 8)
+			keep = 8 - tail_len;
+		memset(dos_name, ' ', 8);
+		memcpy(dos_name, basis, keep);
+		memcpy(dos_name + keep, tail, tail_len);
+
+		char short_name[13];
+		char key[FAT_LFN_MAX_NAME + 1];
+		memset(short_name, 0, 13);
+		FatFromDosToFilename(short_name, (char*)dos_name);
+		FatIndexKey(short_name, key);
+		if (!AuHashmapHas(idx->short_names, key))
+			break;
+	}
+	return true;
+}
+
+/*
+ * FatIndexExtend -- appends a fresh cluster to a directory
+ * @param fsys -- Pointer to file system node
+ * @param idx -- directory index
+ */
+static bool FatIndexExtend(AuVFSNode* fsys, FatDirIndex* idx) {
+	FatFS* fs = (FatFS*)fsys->device;
+	uint32_t per_cluster = fs->cluster_sz_in_bytes / FAT_SLOT_SIZE;
+	if (idx->slot_count + per_cluster > FAT_DIR_MAX_SLOTS)
+		return false;
+
+	int clust_pages = (fs->cluster_sz_in_bytes + PAGE_SIZE - 1) / PAGE_SIZE;
+	void* frames = AuPmmngrAllocBlocks(clust_pages);
+	if (!frames)
+		return false;
+
+	uint32_t cluster = FatFindFreeCluster(fsys);
+	if (!cluster) {
+		AuPmmngrFreeBlocks(frames, clust_pages);
+		return false;
+	}
+	FatAllocCluster(fsys, cluster, FAT_EOC_MARK);
+	FatAllocCluster(fsys, idx->clusters[idx->cluster_count - 1], cluster);
+
+	/* a fresh directory cluster must read as end of directory */
+	uint8_t* buff = (uint8_t*)P2V((size_t)frames);
+	memset(buff, 0, clust_pages * PAGE_SIZE);
+	AuVDiskWrite(fs->vdisk, FatClusterToSector32(fs, cluster), fs->__SectorPerCluster, (uint64_t*)V2P((size_t)buff));
+	AuPmmngrFreeBlocks((void*)V2P((size_t)buff), clust_pages);
+
+	idx->clusters = (uint32_t*)FatIndexGrow(idx->clusters, idx->cluster_count * sizeof(uint32_t),
+		(idx->cluster_count + 1) * sizeof(uint32_t));
+	idx->clusters[idx->cluster_count++] = cluster;
+	idx->slot_map = (uint8_t*)FatIndexGrow(idx->slot_map, (idx->slot_count + 7) / 8,
+		(idx->slot_count + per_cluster + 7) / 8);
+	idx->slot_count += per_cluster;
+	return true;
+}
+
+/*
+ * FatIndexFindFreeRun -- finds consecutive free slots,
+ * grows the directory if there are none
+ * @param fsys -- Pointer to file system node
+ * @param idx -- directory index
+ * @param needed -- number of slots needed
+ */
+static int64_t FatIndexFindFreeRun(AuVFSNode* fsys, FatDirIndex* idx, uint32_t needed) {
+	while (1) {
+		uint32_t run = 0;
+		for (uint32_t s = 0; s < idx->slot_count; s++) {
+			if (FatIndexSlotUsed(idx, s)) {
+				run = 0;
+				continue;
+			}
+			run++;
+			if (run == needed)
+				return (int64_t)s + 1 - needed;
+		}
+		if (!FatIndexExtend(fsys, idx))
+			return -1;
+	}
+}
+
+/*
+ * FatIndexAddEntry -- writes a new entry, along with its
+ * LFN entries if needed, into a directory. The directory
+ * grows by one cluster when it has no room left
+ * @param fsys -- Pointer to file system node
+ * @param dir_cluster -- first cluster of the directory
+ * @param name -- name of the new entry
+ * @param proto -- short entry to write, filename is filled in
+ */
+FatIndexEntry* FatIndexAddEntry(AuVFSNode* fsys, uint32_t dir_cluster, const char* name, FatDir* proto) {
+	FatDirIndex* idx = FatIndexGet(fsys, dir_cluster);
+	if (!idx)
+		return NULL;
+	size_t len = strlen(name);
+	if (!len || len > FAT_LFN_MAX_NAME)
+		return NULL;
+	/* name already taken */
+	if (FatIndexFindExact(idx, name))
+		return NULL;
+
+	uint8_t dos_name[11];
+	bool need_lfn = FatIndexMakeShortName(idx, name, dos_name);
+	uint32_t lfn_count = need_lfn ? (len + FAT_LFN_CHARS_PER_ENTRY - 1) / FAT_LFN_CHARS_PER_ENTRY : 0;
+	uint32_t needed = lfn_count + 1;
+
+	int64_t first = FatIndexFindFreeRun(fsys, idx, needed);
+	if (first < 0)
+		return NULL;
+	uint32_t slot = (uint32_t)first;
+
+	/* one more slot for moving the end of directory marker */
+	FatDir* ents = (FatDir*)kmalloc((needed + 1) * sizeof(FatDir));
+	memset(ents, 0, (needed + 1) * sizeof(FatDir));
+	memcpy(proto->filename, dos_name, 11);
+	uint8_t sum = FatCalculateCheckSum(dos_name);
+	for (uint32_t i = 0; i < lfn_count; i++) {
+		/* LFN entries are stored last part first */
+		uint32_t order = lfn_count - i;
+		FatLFN* lfn = (FatLFN*)&ents[i];
+		lfn->order = order | ((i == 0) ? FAT_LFN_LAST_ENTRY : 0);
+		lfn->attrib = FAT_ATTRIBUTE_LONG_NAME;
+		lfn->checkSum = sum;
+		size_t start = (order - 1) * FAT_LFN_CHARS_PER_ENTRY;
+		FatLFNSetChars(lfn, name + start, len - start);
+	}
+	memcpy(&ents[lfn_count], proto, sizeof(FatDir));
+
+	uint32_t count = needed;
+	if (slot + needed > idx->end_slot) {
+		idx->end_slot = slot + needed;
+		if (idx->end_slot < idx->slot_count)
+			count++;
+	}
+	FatIndexWriteSlots(fsys, idx, slot, ents, count);
+	kfree(ents);
+
+	for (uint32_t i = 0; i < needed; i++)
+		FatIndexSlotMark(idx, slot + i, true);
+
+	FatIndexEntry* ent = FatIndexNewEntry(proto, need_lfn ? name : NULL, slot + lfn_count, lfn_count);
+	FatIndexInsert(idx, ent);
+	return ent;
+}
+
+/*
+ * FatIndexRemoveEntry -- marks an entry and its LFN
+ * entries deleted
+ * @param fsys -- Pointer to file system node
+ * @param dir_cluster -- first cluster of the directory
+ * @param ent -- entry to remove
+ */
+int FatIndexRemoveEntry(AuVFSNode* fsys, uint32_t dir_cluster, FatIndexEntry* ent) {
+	FatDirIndex* idx = FatIndexGet(fsys, dir_cluster);
+	if (!idx)
+		return -1;
+	if (!ent || !ent->valid)
+		return -1;
+	uint32_t first = ent->slot - ent->lfn_count;
+	FatIndexWriteSlots(fsys, idx, first, NULL, ent->lfn_count + 1);
+	for (uint32_t s = first; s <= ent->slot; s++)
+		FatIndexSlotMark(idx, s, false);
+	FatIndexUnlink(idx, ent);
+	return 0;
+}
+
+/*
+ * FatIndexRenameEntry -- gives an entry a new name
+ * @param fsys -- Pointer to file system node
+ * @param dir_cluster -- first cluster of the directory
+ * @param ent -- entry to rename
+ * @param newname -- new name
+ */
+FatIndexEntry* FatIndexRenameEntry(AuVFSNode* fsys, uint32_t dir_cluster, FatIndexEntry* ent, const char* newname) {
+	FatDirIndex* idx = FatIndexGet(fsys, dir_cluster);
+	if (!idx)
+		return NULL;
+	if (!ent || !ent->valid)
+		return NULL;
+	FatIndexEntry* other = FatIndexFindExact(idx, newname);
+	if (other && other != ent)
+		return NULL;
+
+	FatDir proto;
+	FatIndexReadSlot(fsys, idx, ent->slot, &proto);
+	if (other == ent) {
+		/* only the case changes, old slots make the room */
+		FatIndexRemoveEntry(fsys, dir_cluster, ent);
+		return FatIndexAddEntry(fsys, dir_cluster, newname, &proto);
+	}
+	/* write the new entry first, so that a full disk
+	 * never loses the file */
+	FatIndexEntry* renamed = FatIndexAddEntry(fsys, dir_cluster, newname, &proto);
+	if (renamed)
+		FatIndexRemoveEntry(fsys, dir_cluster, ent);
+	return renamed;
+}
+
+/*
+ * FatIndexUpdateSize -- updates size and write stamp
+ * of an entry
+ * @param fsys -- Pointer to file system node
+ * @param dir_cluster -- first cluster of the directory
+ * @param ent -- entry to update
+ * @param size -- size in bytes
+ */
+int FatIndexUpdateSize(AuVFSNode* fsys, uint32_t dir_cluster, FatIndexEntry* ent, uint32_t size) {
+	FatDirIndex* idx = FatIndexGet(fsys, dir_cluster);
+	if (!idx)
+		return -1;
+	if (!ent || !ent->valid)
+		return -1;
+	FatDir dirent;
+	FatIndexReadSlot(fsys, idx, ent->slot, &dirent);
+	dirent.file_size = size;
+	dirent.last_wrt_date = FatFormatDate();
+	dirent.last_wrt_time = FatFormatTime();
+	FatIndexWriteSlots(fsys, idx, ent->slot, &dirent, 1);
+	ent->size = size;
+	return 0;
+}
+
+/*
+ * FatIndexDrop -- forgets the index of a directory
+ * @param fsys -- Pointer to file system node
+ * @param dir_cluster -- first cluster of the directory
+ */
+void FatIndexDrop(AuVFSNode* fsys, uint32_t dir_cluster) {
+	FatFS* fs = (FatFS*)fsys->device;
+	if (!fs->dir_index)
+		return;
+	FatDirIndex* idx = (FatDirIndex*)AuHashmapGet(fs->dir_index, (void*)(size_t)dir_cluster);
+	if (!idx)
+		return;
+	AuHashmapRemove(fs->dir_index, (void*)(size_t)dir_cluster);
+
+	for (uint32_t i = 0; i < idx->entry_count; i++) {
+		if (idx->entries[i]->name)
+			kfree(idx->entries[i]->name);
+		kfree(idx->entries[i]);
+	}
+	if (idx->entries)
+		kfree(idx->entries);
+	kfree(idx->clusters);
+	kfree(idx->slot_map);
+	AuHashmapFree(idx->long_names);
+	kfree(idx->long_names);
+	AuHashmapFree(idx->short_names);
+	kfree(idx->short_names);
+	AuHashmapFree(idx->clusters_map);
+	kfree(idx->clusters_map);
+	kfree(idx);
+}
+
+/*
+ * FatIndexFootprint -- approximate heap bytes held by
+ * a directory index
+ * @param idx -- directory index
+ */
+static size_t FatIndexFootprint(FatDirIndex* idx) {
+	size_t bytes = sizeof(FatDirIndex) + idx->cluster_count * sizeof(uint32_t) + (idx->slot_count + 7) / 8;
+	bytes += idx->entry_cap * sizeof(FatIndexEntry*);
+	for (uint32_t i = 0; i < idx->entry_count; i++) {
+		bytes += sizeof(FatIndexEntry);
+		if (idx->entries[i]->name)
+			bytes += strlen(idx->entries[i]->name) + 1;
+	}
+	/* name and cluster tables hold a node per entry */
+	bytes += 3 * (FAT_INDEX_BUCKETS * sizeof(void*) + idx->entry_count * sizeof(hashmap_entry_t));
+	return bytes;
+}
+
+/*
+ * FatIndexOldest -- finds the least recently used idle
+ * index of all registered volumes, the root directory
+ * is always kept
+ * @param fsys_out -- receives the volume
+ * @param now -- current system tick
+ */
+static FatDirIndex* FatIndexOldest(AuVFSNode** fsys_out, uint64_t now) {
+	FatDirIndex* oldest = NULL;
+	for (int v = 0; _fat_index_volumes && v < _fat_index_volumes->pointer; v++) {
+		AuVFSNode* fsys = (AuVFSNode*)list_get_at(_fat_index_volumes, v);
+		FatFS* fs = (FatFS*)fsys->device;
+		if (!fs->dir_index)
+			continue;
+		for (size_t b = 0; b < fs->dir_index->size; b++) {
+			for (hashmap_entry_t* e = fs->dir_index->entries[b]; e; e = e->next) {
+				FatDirIndex* idx = (FatDirIndex*)e->value;
+				if (idx->first_cluster == fs->__RootDirFirstCluster)
+					continue;
+				if (now - idx->last_use < FAT_INDEX_IDLE_TICKS)
+					continue;
+				if (!oldest || idx->last_use < oldest->last_use) {
+					oldest = idx;
+					*fsys_out = fsys;
+				}
+			}
+		}
+	}
+	return oldest;
+}
+
+/*
+ * FatIndexCount -- pages worth of heap held by idle
+ * directory indexes
+ * @param shrinker -- unused
+ */
+static size_t FatIndexCount(AuShrinker* shrinker) {
+	uint64_t now = AuGetSystemTimerTick();
+	size_t bytes = 0;
+	for (int v = 0; _fat_index_volumes && v < _fat_index_volumes->pointer; v++) {
+		FatFS* fs = (FatFS*)((AuVFSNode*)list_get_at(_fat_index_volumes, v))->device;
+		if (!fs->dir_index)
+			continue;
+		for (size_t b = 0; b < fs->dir_index->size; b++) {
+			for (hashmap_entry_t* e = fs->dir_index->entries[b]; e; e = e->next) {
+				FatDirIndex* idx = (FatDirIndex*)e->value;
+				if (idx->first_cluster != fs->__RootDirFirstCluster && now - idx->last_use >= FAT_INDEX_IDLE_TICKS)
+					bytes += FatIndexFootprint(idx);
+			}
+		}
+	}
+	return bytes / PAGE_SIZE;
+}
+
+/*
+ * FatIndexScan -- drops least recently used directory
+ * indexes, they are built again from disk on next
+ * lookup. Heap only hands pages back once whole
+ * blocks are empty, so the pages actually returned
+ * to the pmm are reported, not the bytes dropped
+ * @param shrinker -- unused
+ * @param nr -- number of pages wanted
+ */
+static size_t FatIndexScan(AuShrinker* shrinker, size_t nr) {
+	uint64_t now = AuGetSystemTimerTick();
+	uint64_t before = AuPmmngrGetFreeMem();
+	size_t bytes = 0;
+	while (bytes < nr * PAGE_SIZE) {
+		AuVFSNode* fsys = NULL;
+		FatDirIndex* idx = FatIndexOldest(&fsys, now);
+		if (!idx)
+			break;
+		bytes += FatIndexFootprint(idx);
+		FatIndexDrop(fsys, idx->first_cluster);
+	}
+	uint64_t after = AuPmmngrGetFreeMem();
+	return after > before ? after - before : 0;
+}
+
+static AuShrinker fat_index_shrinker = { "fatindex", FatIndexCount, FatIndexScan, 0 };
+
+/*
+ * FatIndexRegister -- lets reclaim drop idle directory
+ * indexes of a mounted volume
+ * @param fsys -- Pointer to file system node
+ */
+void FatIndexRegister(AuVFSNode* fsys) {
+	if (!_fat_index_volumes) {
+		_fat_index_volumes = initialize_list();
+		AuRegisterShrinker(&fat_index_shrinker);
+	}
+	list_add(_fat_index_volumes, fsys);
+}
+
+/*
+ * FatIndexUnregister -- removes a volume from reclaim
+ * @param fsys -- Pointer to file system node
+ */
+void FatIndexUnregister(AuVFSNode* fsys) {
+	if (!_fat_index_volumes)
+		return;
+	for (int i = 0; i < _fat_index_volumes->pointer; i++) {
+		if (list_get_at(_fat_index_volumes, i) == fsys) {
+			list_remove(_fat_index_volumes, i);
+			break;
+		}
+	}
+}
+
+/*
+ * FatIndexFillNode -- fills a vfs node from an index entry
+ * @param fsys -- Pointer to file system node
+ * @param file -- node to fill
+ * @param ent -- index entry
+ * @param name -- name the file was opened with
+ * @param parent -- first cluster of parent directory
+ */
+void FatIndexFillNode(AuVFSNode* fsys, AuVFSNode* file, FatIndexEntry* ent, const char* name, uint32_t parent) {
+	FatIndexCopyName(file->filename, name, sizeof(file->filename));
+	file->current = ent->first_cluster;
+	file->first_block = file->current;
+	file->size = ent->size;
+	file->eof = 0;
+	file->pos = 0;
+	file->status = FS_STATUS_FOUND;
+	file->device = fsys;
+	file->parent_block = parent;
+	if (ent->attrib & FAT_ATTRIBUTE_DIRECTORY)
+		file->flags |= FS_FLAG_DIRECTORY;
+	else
+		file->flags |= FS_FLAG_GENERAL;
+}
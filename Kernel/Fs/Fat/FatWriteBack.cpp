@@ -0,0 +1,647 @@
+/**
+* BSD 2-Clause License
+*
+* Copyright (c) 2022-2023, Manas Kamal Choudhury
+* All rights reserved.
+*
+* Redistribution and use in source and binary forms, with or without
+* modification, are permitted provided that the following conditions are met:
+*
+* 1. Redistributions of source code must retain the above copyright notice, this
+*    list of conditions and the following disclaimer.
+*
+* 2. Redistributions in binary form must reproduce the above copyright notice,
+*    this list of conditions and the following disclaimer in the documentation
+*    and/or other materials provided with the distribution.
+*
+* THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+* AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+* IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+* DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE
+* FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+* DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR
+* SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER
+* CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY,
+* OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+* OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+*
+**/
+
+#include <Fs\Fat\FatWriteBack.h>
+#include <Fs\Fat\FatFile.h>
+#include <Fs\Fat\FatIndex.h>
+#include <Fs\Fat\Fat.h>
+#include <Fs\vdisk.h>
+#include <Fs\vfs.h>
+#include <Hal\x86_64_sched.h>
+#include <Hal\x86_64_lowlevel.h>
+#include <Mm\kmalloc.h>
+#include <Mm\pmmngr.h>
+#include <Mm\vmmngr.h>
+#include <Mm\reclaim.h>
+#include <Hal\serial.h>
+#include <string.h>
+#include <list.h>
+#include <_null.h>
+
+static list_t* _fat_wb_volumes;
+static AuThread* _fat_wb_thread;
+
+/*
+ * FatWriteBackChunkBytes -- returns the bytes covered by
+ * one buffer chunk, always a multiple of cluster size
+ * @param fs -- Pointer to FAT file system
+ */
+static size_t FatWriteBackChunkBytes(FatFS* fs) {
+	size_t clust_sz = fs->cluster_sz_in_bytes;
+	size_t chunk_bytes = (FAT_WB_CHUNK_SIZE / clust_sz) * clust_sz;
+	if (!chunk_bytes)
+		chunk_bytes = clust_sz;
+	return chunk_bytes;
+}
+
+/*
+ * FatWriteBackChunk -- returns a buffer chunk, allocating
+ * a zeroed one when it is not present yet
+ * @param fs -- Pointer to FAT file system
+ * @param wb -- write-back state of the file
+ * @param index -- index of the chunk
+ */
+static uint8_t* FatWriteBackChunk(FatFS* fs, FatWriteBack* wb, int index) {
+	if (!wb->chunks[index]) {
+		size_t chunk_bytes = FatWriteBackChunkBytes(fs);
+		int chunk_pages = (chunk_bytes + PAGE_SIZE - 1) / PAGE_SIZE;
+		void* phys = AuPmmngrAllocBlocks(chunk_pages);
+		if (!phys)
+			return NULL;
+		wb->chunks[index] = (uint8_t*)P2V((size_t)phys);
+		memset(wb->chunks[index], 0, chunk_pages * PAGE_SIZE);
+	}
+	return wb->chunks[index];
+}
+
+/*
+ * FatWriteBackFreeChunks -- frees all buffer chunks
+ * @param fs -- Pointer to FAT file system
+ * @param wb -- write-back state of the file
+ */
+static void FatWriteBackFreeChunks(FatFS* fs, FatWriteBack* wb) {
+	int chunk_pages = (FatWriteBackChunkBytes(fs) + PAGE_SIZE - 1) / PAGE_SIZE;
+	for (int i = 0; i < FAT_WB_MAX_CHUNKS; i++) {
+		if (wb->chunks[i]) {
+			AuPmmngrFreeBlocks((void*)V2P((size_t)wb->chunks[i]), chunk_pages);
+			wb->chunks[i] = NULL;
+		}
+	}
+}
+
+/*
+ * FatWriteBackUnreserve -- gives reserved clusters of a
+ * file back to the volume
+ * @param fs -- Pointer to FAT file system
+ * @param wb -- write-back state of the file
+ * @param count -- number of clusters
+ */
+static void FatWriteBackUnreserve(FatFS* fs, FatWriteBack* wb, uint32_t count) {
+	if (count > wb->reserved)
+		count = wb->reserved;
+	wb->reserved -= count;
+	fs->wb_reserved -= count;
+}
+
+/*
+ * FatWriteBackReserve -- reserves free clusters for the
+ * buffered range up to end, so that a flush never runs out
+ * of them, returns the end actually covered which is less
+ * than end once the volume is full
+ * @param fsys -- Pointer to file system node
+ * @param wb -- write-back state of the file
+ * @param end -- byte offset the range ends at
+ */
+static uint64_t FatWriteBackReserve(AuVFSNode* fsys, FatWriteBack* wb, uint64_t end) {
+	FatFS* fs = (FatFS*)fsys->device;
+	size_t clust_sz = fs->cluster_sz_in_bytes;
+	uint64_t covered = wb->alloc_bytes + static_cast<uint64_t>(wb->reserved) * clust_sz;
+	if (end <= covered)
+		return end;
+	uint64_t want = (end - covered + clust_sz - 1) / clust_sz;
+	uint32_t avail = FatFreeClusters(fsys);
+	if (want > avail)
+		want = avail;
+	wb->reserved += (uint32_t)want;
+	fs->wb_reserved += (uint32_t)want;
+	covered += want * clust_sz;
+	return (end < covered) ? end : covered;
+}
+
+/*
+ * FatWriteBackUnlink -- removes a state from the volume's
+ * list and frees it
+ * @param fs -- Pointer to FAT file system
+ * @param wb -- write-back state to remove
+ */
+static void FatWriteBackUnlink(FatFS* fs, FatWriteBack* wb) {
+	FatWriteBack* prev = NULL;
+	for (FatWriteBack* it = fs->wb_files; it; it = it->next) {
+		if (it == wb) {
+			if (prev)
+				prev->next = it->next;
+			else
+				fs->wb_files = it->next;
+			break;
+		}
+		prev = it;
+	}
+	FatWriteBackUnreserve(fs, wb, wb->reserved);
+	FatWriteBackFreeChunks(fs, wb);
+	kfree(wb);
+}
+
+/*
+ * FatWriteBackFlusher -- flusher thread, periodically writes
+ * out dirty files of every registered volume and forgets the
+ * ones that stayed clean for a whole period
+ */
+static void FatWriteBackFlusher(uint64_t param) {
+	while (1) {
+		x64_cli();
+		for (int i = 0; i < _fat_wb_volumes->pointer; i++) {
+			AuVFSNode* fsys = (AuVFSNode*)list_get_at(_fat_wb_volumes, i);
+			FatFS* fs = (FatFS*)fsys->device;
+			FatWriteBack* wb = fs->wb_files;
+			while (wb) {
+				FatWriteBack* next = wb->next;
+				if (wb->size_dirty || wb->size > wb->alloc_bytes) {
+					FatWriteBackFlush(fsys, wb);
+					wb->idle = false;
+				}
+				else if (wb->idle)
+					FatWriteBackUnlink(fs, wb);
+				else
+					wb->idle = true;
+				wb = next;
+			}
+		}
+		AuSleepThread(AuGetCurrentThread(), FAT_WB_FLUSH_INTERVAL);
+		AuForceScheduler();
+	}
+}
+
+/*
+ * FatWriteBackStartFlusher -- starts the flusher thread
+ * once the scheduler is up, until then every write is
+ * flushed synchronously
+ */
+static void FatWriteBackStartFlusher() {
+	if (_fat_wb_thread || !AuIsSchedulerInitialised())
+		return;
+	/* without a stack writes keep flushing synchronously,
+	 * the next file opened for writing tries again */
+	void* stack = AuPmmngrAlloc();
+	if (!stack)
+		return;
+	_fat_wb_thread = AuCreateKthread(FatWriteBackFlusher, (uint64_t)P2V((uint64_t)stack + 4096),
+		(uint64_t)AuGetRootPageTable(), "fatflush");
+}
+
+/*
+ * FatWriteBackBufferedPages -- number of pages held by
+ * buffer chunks of a file
+ * @param fs -- Pointer to FAT file system
+ * @param wb -- write-back state of the file
+ */
+static size_t FatWriteBackBufferedPages(FatFS* fs, FatWriteBack* wb) {
+	size_t chunk_pages = (FatWriteBackChunkBytes(fs) + PAGE_SIZE - 1) / PAGE_SIZE;
+	size_t pages = 0;
+	for (int i = 0; i < FAT_WB_MAX_CHUNKS; i++)
+		if (wb->chunks[i])
+			pages += chunk_pages;
+	return pages;
+}
+
+/*
+ * FatWriteBackShrinkCount -- pages buffered by every
+ * registered volume
+ * @param shrinker -- unused
+ */
+static size_t FatWriteBackShrinkCount(AuShrinker* shrinker) {
+	size_t pages = 0;
+	for (int i = 0; _fat_wb_volumes && i < _fat_wb_volumes->pointer; i++) {
+		FatFS* fs = (FatFS*)((AuVFSNode*)list_get_at(_fat_wb_volumes, i))->device;
+		for (FatWriteBack* wb = fs->wb_files; wb; wb = wb->next)
+			pages += FatWriteBackBufferedPages(fs, wb);
+	}
+	return pages;
+}
+
+/*
+ * FatWriteBackShrinkScan -- flushes buffered files early,
+ * a flush writes to disk which is never done inside a
+ * reclaim pass, so the flusher is woken up to do it and
+ * the chunks come back once it ran
+ * @param shrinker -- unused
+ * @param nr -- number of pages wanted
+ */
+static size_t FatWriteBackShrinkScan(AuShrinker* shrinker, size_t nr) {
+	if (_fat_wb_thread)
+		AuWakeThread(_fat_wb_thread);
+	return 0;
+}
+
+static AuShrinker fat_wb_shrinker = { "fatwb", FatWriteBackShrinkCount, FatWriteBackShrinkScan, 0 };
+
+/*
+ * FatWriteBackRegister -- registers a mounted FAT volume
+ * with the flusher
+ * @param fsys -- Pointer to file system node
+ */
+void FatWriteBackRegister(AuVFSNode* fsys) {
+	if (!_fat_wb_volumes) {
+		_fat_wb_volumes = initialize_list();
+		AuRegisterShrinker(&fat_wb_shrinker);
+	}
+	list_add(_fat_wb_volumes, fsys);
+}
+
+/*
+ * FatWriteBackUnregister -- flushes everything and removes
+ * a volume from the flusher
+ * @param fsys -- Pointer to file system node
+ */
+void FatWriteBackUnregister(AuVFSNode* fsys) {
+	FatFS* fs = (FatFS*)fsys->device;
+	FatWriteBackSync(fsys, NULL);
+	while (fs->wb_files)
+		FatWriteBackUnlink(fs, fs->wb_files);
+	if (!_fat_wb_volumes)
+		return;
+	for (int i = 0; i < _fat_wb_volumes->pointer; i++) {
+		if (list_get_at(_fat_wb_volumes, i) == fsys) {
+			list_remove(_fat_wb_volumes, i);
+			break;
+		}
+	}
+}
+
+/*
+ * FatWriteBackFind -- returns the write-back state of a
+ * file if there is one
+ * @param fsys -- Pointer to file system node
+ * @param first_cluster -- first cluster of the file
+ */
+FatWriteBack* FatWriteBackFind(AuVFSNode* fsys, uint32_t first_cluster) {
+	FatFS* fs = (FatFS*)fsys->device;
+	for (FatWriteBack* wb = fs->wb_files; wb; wb = wb->next) {
+		if (wb->first_cluster == first_cluster)
+			return wb;
+	}
+	return NULL;
+}
+
+/*
+ * FatWriteBackGet -- returns the write-back state of a
+ * file, creating it when needed
+ * @param fsys -- Pointer to file system node
+ * @param file -- Pointer to file
+ */
+FatWriteBack* FatWriteBackGet(AuVFSNode* fsys, AuVFSNode* file) {
+	FatFS* fs = (FatFS*)fsys->device;
+	if (!file->first_block || !file->parent_block)
+		return NULL;
+	FatWriteBack* wb = FatWriteBackFind(fsys, file->first_block);
+	if (wb) {
+		wb->idle = false;
+		return wb;
+	}
+
+	/* the chain is walked once, afterwards the state
+	 * keeps track of its end */
+	uint32_t cluster = file->first_block;
+	uint64_t count = 1;
+	while (1) {
+		uint32_t next = FatReadFAT(fsys, cluster);
+		if (next >= (FAT_BAD_CLUSTER & 0x0FFFFFFF) || next < 2)
+			break;
+		cluster = next;
+		count++;
+	}
+
+	wb = (FatWriteBack*)kmalloc(sizeof(FatWriteBack));
+	memset(wb, 0, sizeof(FatWriteBack));
+	wb->first_cluster = file->first_block;
+	wb->parent_cluster = file->parent_block;
+	wb->last_cluster = cluster;
+	wb->alloc_bytes = count * fs->cluster_sz_in_bytes;
+	wb->tail_cluster = cluster;
+	wb->tail_offset = wb->alloc_bytes - fs->cluster_sz_in_bytes;
+	/* other handles might carry a stale size, the
+	 * directory entry is what counts */
+	FatIndexEntry* ent = FatIndexFindFile(fsys, file);
+	wb->size = file->size;
+	if (ent && ent->size > wb->size)
+		wb->size = ent->size;
+	wb->next = fs->wb_files;
+	fs->wb_files = wb;
+	FatWriteBackStartFlusher();
+	return wb;
+}
+
+/*
+ * FatWriteBackClusterFor -- returns the cluster holding given
+ * byte offset when it lies in the contiguous tail of the chain,
+ * saves walking the whole chain after a flush
+ * @param fsys -- Pointer to file system node
+ * @param wb -- write-back state of the file
+ * @param offset -- byte offset
+ */
+uint32_t FatWriteBackClusterFor(AuVFSNode* fsys, FatWriteBack* wb, uint64_t offset) {
+	FatFS* fs = (FatFS*)fsys->device;
+	if (offset < wb->tail_offset || offset >= wb->alloc_bytes)
+		return 0;
+	return wb->tail_cluster + (uint32_t)((offset - wb->tail_offset) / fs->cluster_sz_in_bytes);
+}
+
+/*
+ * FatWriteBackWindow -- returns the end of the range a
+ * file can buffer before it has to be flushed
+ * @param fsys -- Pointer to file system node
+ * @param wb -- write-back state of the file
+ */
+uint64_t FatWriteBackWindow(AuVFSNode* fsys, FatWriteBack* wb) {
+	FatFS* fs = (FatFS*)fsys->device;
+	return wb->alloc_bytes + FatWriteBackChunkBytes(fs) * FAT_WB_MAX_CHUNKS;
+}
+
+/*
+ * FatWriteBackBuffer -- copies data into the buffered
+ * area of a file, returns bytes buffered, which is less
+ * than length once the buffer is full or the volume has
+ * no free clusters left to reserve for it
+ * @param fsys -- Pointer to file system node
+ * @param wb -- write-back state of the file
+ * @param offset -- byte offset, not below alloc_bytes
+ * @param buffer -- data to copy
+ * @param length -- length in bytes
+ */
+size_t FatWriteBackBuffer(AuVFSNode* fsys, FatWriteBack* wb, uint64_t offset, uint8_t* buffer, size_t length) {
+	FatFS* fs = (FatFS*)fsys->device;
+	uint64_t window = FatWriteBackWindow(fsys, wb);
+	if (offset < wb->alloc_bytes || offset >= window)
+		return 0;
+	if (length > (window - offset))
+		length = window - offset;
+	/* data accepted here is reported as written, it must
+	 * have clusters waiting for it */
+	uint64_t end = FatWriteBackReserve(fsys, wb, offset + length);
+	if (end <= offset)
+		return 0;
+	length = end - offset;
+
+	size_t chunk_bytes = FatWriteBackChunkBytes(fs);
+	uint64_t rel = offset - wb->alloc_bytes;
+	size_t done = 0;
+	while (done < length) {
+		int index = rel / chunk_bytes;
+		size_t offset_in_chunk = rel % chunk_bytes;
+		uint8_t* chunk = FatWriteBackChunk(fs, wb, index);
+		if (!chunk)
+			break;
+		size_t n = chunk_bytes - offset_in_chunk;
+		if (n > (length - done))
+			n = length - done;
+		memcpy(chunk + offset_in_chunk, buffer + done, n);
+		done += n;
+		rel += n;
+	}
+	if (done)
+		wb->idle = false;
+	return done;
+}
+
+/*
+ * FatWriteBackRead -- copies buffered data of a file,
+ * ranges never written read back as zero
+ * @param fsys -- Pointer to file system node
+ * @param wb -- write-back state of the file
+ * @param offset -- byte offset, not below alloc_bytes
+ * @param buffer -- destination buffer
+ * @param length -- length in bytes
+ */
+size_t FatWriteBackRead(AuVFSNode* fsys, FatWriteBack* wb, uint64_t offset, uint8_t* buffer, size_t length) {
+	FatFS* fs = (FatFS*)fsys->device;
+	if (offset < wb->alloc_bytes || offset >= wb->size)
+		return 0;
+	if (length > (wb->size - offset))
+		length = wb->size - offset;
+	size_t chunk_bytes = FatWriteBackChunkBytes(fs);
+	uint64_t rel = offset - wb->alloc_bytes;
+	size_t done = 0;
+	while (done < length && rel < (chunk_bytes * FAT_WB_MAX_CHUNKS)) {
+		int index = rel / chunk_bytes;
+		size_t offset_in_chunk = rel % chunk_bytes;
+		size_t n = chunk_bytes - offset_in_chunk;
+		if (n > (length - done))
+			n = length - done;
+		if (wb->chunks[index])
+			memcpy(buffer + done, wb->chunks[index] + offset_in_chunk, n);
+		else
+			memset(buffer + done, 0, n);
+		done += n;
+		rel += n;
+	}
+	return done;
+}
+
+/*
+ * FatWriteBackSetSize -- records a new file size, the
+ * directory entry is updated on next flush
+ * @param fsys -- Pointer to file system node
+ * @param wb -- write-back state of the file
+ * @param size -- size in bytes
+ */
+void FatWriteBackSetSize(AuVFSNode* fsys, FatWriteBack* wb, uint64_t size) {
+	if (size <= wb->size)
+		return;
+	/* grown range reads back as zeroes, which still
+	 * need clusters */
+	size = FatWriteBackReserve(fsys, wb, size);
+	if (size <= wb->size)
+		return;
+	wb->size = size;
+	wb->size_dirty = true;
+	wb->idle = false;
+	/* no flusher yet, nothing else would write it out */
+	if (!_fat_wb_thread)
+		FatWriteBackFlush(fsys, wb);
+}
+
+/*
+ * FatWriteBackWriteRun -- writes buffered clusters out to a
+ * freshly found run, one disk request per chunk, returns the
+ * number of clusters written which is less than count when a
+ * chunk for a hole could not be allocated
+ * @param fsys -- Pointer to file system node
+ * @param wb -- write-back state of the file
+ * @param first -- first buffered cluster, relative to alloc_bytes
+ * @param start -- first cluster of the run
+ * @param count -- number of clusters in the run
+ */
+static uint32_t FatWriteBackWriteRun(AuVFSNode* fsys, FatWriteBack* wb, uint32_t first, uint32_t start, uint32_t count) {
+	FatFS* fs = (FatFS*)fsys->device;
+	size_t clust_sz = fs->cluster_sz_in_bytes;
+	uint32_t clust_per_chunk = FatWriteBackChunkBytes(fs) / clust_sz;
+	uint32_t c = 0;
+	while (c < count) {
+		uint32_t rel = first + c;
+		int index = rel / clust_per_chunk;
+		uint32_t in_chunk = rel % clust_per_chunk;
+		uint32_t n = clust_per_chunk - in_chunk;
+		if (n > (count - c))
+			n = count - c;
+		/* holes never written still need zeroes on disk */
+		uint8_t* chunk = FatWriteBackChunk(fs, wb, index);
+		if (!chunk)
+			break;
+		AuVDiskWrite(fs->vdisk, FatClusterToSector32(fs, start + c), n * fs->__SectorPerCluster,
+			(uint64_t*)V2P((size_t)(chunk + in_chunk * clust_sz)));
+		c += n;
+	}
+	return c;
+}
+
+/*
+ * FatWriteBackDropChunks -- frees the chunks a partial
+ * flush wrote out and moves the remaining ones down
+ * @param fs -- Pointer to FAT file system
+ * @param wb -- write-back state of the file
+ * @param count -- number of leading chunks written out
+ */
+static void FatWriteBackDropChunks(FatFS* fs, FatWriteBack* wb, int count) {
+	int chunk_pages = (FatWriteBackChunkBytes(fs) + PAGE_SIZE - 1) / PAGE_SIZE;
+	for (int i = 0; i < FAT_WB_MAX_CHUNKS; i++) {
+		if (i < count && wb->chunks[i])
+			AuPmmngrFreeBlocks((void*)V2P((size_t)wb->chunks[i]), chunk_pages);
+		wb->chunks[i] = ((i + count) < FAT_WB_MAX_CHUNKS) ? wb->chunks[i + count] : NULL;
+	}
+}
+
+/*
+ * FatWriteBackFlush -- allocates clusters for buffered
+ * data as contiguous runs, writes it out and updates the
+ * directory entry, returns 0 on success
+ * @param fsys -- Pointer to file system node
+ * @param wb -- write-back state of the file
+ */
+int FatWriteBackFlush(AuVFSNode* fsys, FatWriteBack* wb) {
+	FatFS* fs = (FatFS*)fsys->device;
+	size_t clust_sz = fs->cluster_sz_in_bytes;
+	int ret = 0;
+
+	if (wb->size > wb->alloc_bytes) {
+		uint32_t need = (wb->size - wb->alloc_bytes + clust_sz - 1) / clust_sz;
+		uint32_t done = 0;
+		bool full = false;
+		while (done < need) {
+			uint32_t run = 0;
+			uint32_t start = FatFindFreeRun(fsys, wb->last_cluster + 1, need - done, &run);
+			if (!start) {
+				full = true;
+				break;
+			}
+			/* data first, then the chain and the link from
+			 * old end of file, so that the chain never points
+			 * to garbage, clusters left without data stay free */
+			run = FatWriteBackWriteRun(fsys, wb, done, start, run);
+			if (!run)
+				break;
+			FatAllocChain(fsys, start, run);
+			FatAllocCluster(fsys, wb->last_cluster, start);
+			FatWriteBackUnreserve(fs, wb, run);
+			if (start != (wb->last_cluster + 1)) {
+				wb->tail_cluster = start;
+				wb->tail_offset = wb->alloc_bytes + static_cast<uint64_t>(done) * clust_sz;
+			}
+			wb->last_cluster = start + run - 1;
+			done += run;
+		}
+		if (done < need) {
+			ret = -1;
+			if (full) {
+				/* written data always has clusters reserved, only
+				 * a size grown past them can end up here */
+				SeTextOut("FatWriteBack: volume full, %d clusters dropped \r\n", need - done);
+				wb->size = wb->alloc_bytes + static_cast<uint64_t>(done) * clust_sz;
+				wb->size_dirty = true;
+			}
+		}
+		wb->alloc_bytes += static_cast<uint64_t>(done) * clust_sz;
+		if (done < need && !full) {
+			/* out of memory for a hole, keep what is not on
+			 * disk yet, a run only stops at a chunk boundary */
+			FatWriteBackDropChunks(fs, wb, done / (FatWriteBackChunkBytes(fs) / clust_sz));
+		}
+		else {
+			FatWriteBackFreeChunks(fs, wb);
+			FatWriteBackUnreserve(fs, wb, wb->reserved);
+		}
+	}
+
+	if (wb->size_dirty) {
+		AuVFSNode node;
+		memset(&node, 0, sizeof(AuVFSNode));
+		node.first_block = wb->first_cluster;
+		node.parent_block = wb->parent_cluster;
+		FatFileUpdateSize(fsys, &node, wb->size);
+		wb->size_dirty = false;
+	}
+	return ret;
+}
+
+/*
+ * FatWriteBackSync -- flushes a file, or every file
+ * of the volume when file is null
+ * @param fsys -- Pointer to file system node
+ * @param file -- Pointer to file, can be null
+ */
+int FatWriteBackSync(AuVFSNode* fsys, AuVFSNode* file) {
+	FatFS* fs = (FatFS*)fsys->device;
+	int ret = 0;
+	if (file) {
+		FatWriteBack* wb = FatWriteBackFind(fsys, file->first_block);
+		if (wb)
+			ret = FatWriteBackFlush(fsys, wb);
+		return ret;
+	}
+	for (FatWriteBack* wb = fs->wb_files; wb; wb = wb->next) {
+		if (FatWriteBackFlush(fsys, wb) != 0)
+			ret = -1;
+	}
+	return ret;
+}
+
+/*
+ * FatWriteBackRelease -- flushes a file and forgets
+ * its write-back state
+ * @param fsys -- Pointer to file system node
+ * @param first_cluster -- first cluster of the file
+ */
+void FatWriteBackRelease(AuVFSNode* fsys, uint32_t first_cluster) {
+	FatWriteBack* wb = FatWriteBackFind(fsys, first_cluster);
+	if (!wb)
+		return;
+	FatWriteBackFlush(fsys, wb);
+	FatWriteBackUnlink((FatFS*)fsys->device, wb);
+}
+
+/*
+ * FatWriteBackDiscard -- throws away buffered data of
+ * a file being removed
+ * @param fsys -- Pointer to file system node
+ * @param first_cluster -- first cluster of the file
+ */
+void FatWriteBackDiscard(AuVFSNode* fsys, uint32_t first_cluster) {
+	FatWriteBack* wb = FatWriteBackFind(fsys, first_cluster);
+	if (!wb)
+		return;
+	FatWriteBackUnlink((FatFS*)fsys->device, wb);
+}
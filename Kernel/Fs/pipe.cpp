@@ -86,7 +86,7 @@ void AuPipeIncrementWriteAmount(AuPipe* pipe, size_t amount) {
  * @param buffer -- Pointer to buffer where to put the data
  * @param length -- length to read
  */
-size_t AuPipeRead(AuVFSNode *fs, AuVFSNode *file, uint64_t* buffer, uint32_t length) {
+size_t AuPipeRead(AuVFSNode *fs, AuVFSNode *file, uint64_t* buffer, size_t length) {
 	uint8_t* aligned_buff = (uint8_t*)buffer;
 	AuPipe *pipe = (AuPipe*)fs->device;
 	size_t collected = 0;
@@ -113,7 +113,7 @@ size_t AuPipeRead(AuVFSNode *fs, AuVFSNode *file, uint64_t* buffer, uint32_t len
 * @param buffer -- Pointer to buffer where to put the data
 * @param length -- length to read
 */
-size_t AuPipeWrite(AuVFSNode *fs, AuVFSNode *file, uint64_t* buffer, uint32_t length) {
+size_t AuPipeWrite(AuVFSNode *fs, AuVFSNode *file, uint64_t* buffer, size_t length) {
 	uint8_t* aligned_buff = (uint8_t*)buffer;
 	AuPipe* pipe = (AuPipe*)fs->device;
 	size_t written = 0;
@@ -306,11 +306,11 @@ int AuCreatePipe(char* name, size_t sz) {
 	node->close = AuPipeClose;
 	node->iocontrol = NULL;
 
-	proc->fds[fd] = node;
+	AuProcessSetFileDesc(proc, fd, node);
 
 	SeTextOut("Pipe proc -> %s \r\n", proc->name);
 	AuPipeFSAddFile(pipeFS, "/", node);
-	SeTextOut("Pipe Created -> %d %s\r\n", fd, proc->fds[fd]->filename);
+	SeTextOut("Pipe Created -> %d %s\r\n", fd, AuProcessGetFileNode(proc, fd)->filename);
 	//AuForceScheduler();
 	return fd;
 }
@@ -78,12 +78,178 @@ void AuTTYDelete(TTY* tty) {
 	kfree(tty);
 }
 
-void AuTTYWriteSlave(TTY* tty, uint8_t c) {
-	AuCircBufPut(tty->slavebuf, c);
+/*
+ * AuTTYUnlinkWaiter -- remove a waiter from a wait
+ * queue, if still queued
+ * @param queue -- wait queue
+ * @param waiter -- waiter to remove
+ */
+static void AuTTYUnlinkWaiter(TTYWaiter** queue, TTYWaiter* waiter) {
+	for (TTYWaiter** link = queue; *link != NULL; link = &(*link)->next) {
+		if (*link == waiter) {
+			*link = waiter->next;
+			return;
+		}
+	}
+}
+
+/*
+ * AuTTYWait -- sleep on a tty wait queue until
+ * woken by the other end or by a signal
+ * @param queue -- wait queue
+ * @param thr -- current thread
+ */
+static void AuTTYWait(TTYWaiter** queue, AuThread* thr) {
+	TTYWaiter waiter;
+	waiter.thread = thr;
+	waiter.next = *queue;
+	*queue = &waiter;
+	AuBlockThread(thr);
+	AuForceScheduler();
+	/* signal wake ups leave us queued */
+	AuTTYUnlinkWaiter(queue, &waiter);
+}
+
+/*
+ * AuTTYWakeAll -- wake every thread sleeping on
+ * a tty wait queue
+ * @param queue -- wait queue
+ */
+static void AuTTYWakeAll(TTYWaiter** queue) {
+	while (*queue != NULL) {
+		TTYWaiter* waiter = *queue;
+		*queue = waiter->next;
+		if (waiter->thread->state == THREAD_STATE_BLOCKED)
+			AuUnblockThread(waiter->thread);
+	}
+}
+
+/*
+ * AuTTYOutput -- output processing, puts data from
+ * slave side to master buffer
+ * @param tty -- Pointer to tty
+ * @param data -- data to put
+ * @param len -- length of data
+ * @return number of bytes of data consumed
+ */
+size_t AuTTYOutput(TTY* tty, uint8_t* data, size_t len) {
+	AuRingBuffer* out = tty->masterbuf;
+	if (!(tty->term.c_oflag & OPOST) || !(tty->term.c_oflag & ONLCR))
+		return AuRingBufWrite(out, data, len);
+
+	/* runs between newlines are copied in bulk straight
+	 * into free ring spans, each newline gets a CR in
+	 * front of it */
+	size_t done = 0;
+	while (done < len) {
+		uint8_t* span;
+		uint32_t room = AuRingBufWritePeek(out, &span);
+		if (room == 0)
+			break;
+
+		uint32_t filled = 0;
+		while (filled < room && done < len) {
+			if (data[done] == '\n') {
+				/* CR may land at the end of one span
+				 * and NL at the start of next */
+				if (!tty->outCR) {
+					span[filled++] = '\r';
+					tty->outCR = true;
+					continue;
+				}
+				tty->outCR = false;
+				span[filled++] = '\n';
+				done++;
+				continue;
+			}
+			size_t max = room - filled;
+			if (max > len - done)
+				max = len - done;
+			size_t run = 0;
+			while (run < max && data[done + run] != '\n')
+				run++;
+			memcpy(span + filled, data + done, run);
+			filled += run;
+			done += run;
+		}
+		AuRingBufWriteCommit(out, filled);
+	}
+	return done;
 }
 
-void AuTTYWriteMaster(TTY* tty, uint8_t c) {
-	AuCircBufPut(tty->masterbuf, c);
+/*
+ * AuTTYEcho -- echo input back to master
+ * @param tty -- Pointer to tty
+ * @param data -- data to echo
+ * @param len -- length of data
+ */
+void AuTTYEcho(TTY* tty, uint8_t* data, size_t len) {
+	/* echo is best effort, a full master buffer
+	 * drops it */
+	AuTTYOutput(tty, data, len);
+}
+
+/*
+ * AuTTYCommitLine -- hands the edited line over
+ * to slave readers
+ * @param tty -- Pointer to tty
+ */
+void AuTTYCommitLine(TTY* tty) {
+	uint32_t put = AuRingBufWrite(tty->slavebuf, tty->lineBuf, tty->lineLen);
+	tty->lineLen = 0;
+	if (put == 0)
+		return;
+	if (tty->lineEndCount == TTY_PENDING_LINES) {
+		/* too many unread lines, the newest absorbs this one */
+		uint16_t last = (tty->lineEndHead + tty->lineEndCount - 1) % TTY_PENDING_LINES;
+		tty->lineEnds[last] += put;
+		return;
+	}
+	tty->lineEnds[(tty->lineEndHead + tty->lineEndCount) % TTY_PENDING_LINES] = put;
+	tty->lineEndCount++;
+}
+
+/*
+ * AuTTYConsumeLines -- account bytes read from slavebuf
+ * against committed lines
+ * @param tty -- Pointer to tty
+ * @param len -- number of bytes read
+ */
+static void AuTTYConsumeLines(TTY* tty, size_t len) {
+	while (len > 0 && tty->lineEndCount > 0) {
+		uint16_t* cur = &tty->lineEnds[tty->lineEndHead];
+		if (len < *cur) {
+			*cur -= len;
+			return;
+		}
+		len -= *cur;
+		tty->lineEndHead = (tty->lineEndHead + 1) % TTY_PENDING_LINES;
+		tty->lineEndCount--;
+	}
+}
+
+/*
+ * AuTTYResetLines -- forget committed line boundaries
+ * @param tty -- Pointer to tty
+ */
+static void AuTTYResetLines(TTY* tty) {
+	tty->lineEndHead = 0;
+	tty->lineEndCount = 0;
+}
+
+/*
+ * AuTTYSignal -- send a signal to the foreground
+ * process of the tty
+ * @param tty -- Pointer to tty
+ * @param sig -- signal number
+ */
+void AuTTYSignal(TTY* tty, int sig) {
+	if (!tty->slave_pid)
+		return;
+	AuProcess* proc = AuProcessFindPID(tty->slave_pid);
+	if (!proc || !proc->main_thread)
+		return;
+	AuSendSignal(proc->main_thread->id, sig);
 }
 
 /* AuTTYProcessLine -- Line Discipline layer*/
@@ -99,13 +265,11 @@ void AuTTYProcessLine(TTY* tty, uint8_t c) {
 
 		if (sig != -1) {
 			if (tty->term.c_lflag & ECHO) {
-				AuTTYWriteMaster(tty, '^');
-				AuTTYWriteMaster(tty, ('@' + c) % 128);
-				AuTTYWriteMaster(tty, '\n');
+				uint8_t echo[3] = { '^', (uint8_t)(('@' + c) % 128), '\n' };
+				AuTTYEcho(tty, echo, 3);
 			}
-			//clear_input_buf
-			//if foreground process group or process exist
-				//send signal to foreground process, the sig number
+			tty->lineLen = 0;
+			AuTTYSignal(tty, sig);
 			return;
 		}
 	}
@@ -122,104 +286,197 @@ void AuTTYProcessLine(TTY* tty, uint8_t c) {
 	else if ((tty->term.c_iflag & ICRNL) && c == '\r')
 		c = '\n';
 
+	bool echo = (tty->term.c_lflag & ECHO);
+
 	/* handle canonical mode */
 	if (tty->term.c_lflag & ICANON) {
 		if (c == tty->term.c_cc[VERASE]) {
 			/* erase the last character */
+			if (tty->lineLen > 0) {
+				tty->lineLen--;
+				if (echo && (tty->term.c_lflag & ECHOE))
+					AuTTYEcho(tty, (uint8_t*)"\b \b", 3);
+			}
+			return;
+		}
+
+		if (c == tty->term.c_cc[VKILL]) {
+			while (tty->lineLen > 0) {
+				tty->lineLen--;
+				if (echo && (tty->term.c_lflag & ECHOK))
+					AuTTYEcho(tty, (uint8_t*)"\b \b", 3);
+			}
+			return;
 		}
+
+		if (c == tty->term.c_cc[VEOF]) {
+			/* EOF on an empty line makes read return 0 */
+			if (tty->lineLen == 0)
+				tty->eof = true;
+			AuTTYCommitLine(tty);
+			return;
+		}
+
+		bool eol = (c == '\n') || (tty->term.c_cc[VEOL] && c == tty->term.c_cc[VEOL]);
+		/* last slot is kept for the line terminator */
+		if (!eol && tty->lineLen >= TTY_LINE_MAX - 1)
+			return;
+		tty->lineBuf[tty->lineLen++] = c;
+		if (echo || (c == '\n' && (tty->term.c_lflag & ECHONL)))
+			AuTTYEcho(tty, &c, 1);
+		if (eol)
+			AuTTYCommitLine(tty);
+		return;
 	}
+
+	AuRingBufPut(tty->slavebuf, c);
+	if (echo)
+		AuTTYEcho(tty, &c, 1);
 }
 
+/*
+ * AuTTYInputIsRaw -- check if master input can go
+ * straight to slave buffer without per byte
+ * processing
+ * @param tty -- Pointer to tty
+ */
+static bool AuTTYInputIsRaw(TTY* tty) {
+	if (tty->term.c_lflag & (ICANON | ISIG | ECHO))
+		return false;
+	if (tty->term.c_iflag & (ISTRIP | IGNCR | INLCR | ICRNL))
+		return false;
+	return true;
+}
 
-size_t AuTTYMasterRead(AuVFSNode* fs, AuVFSNode* file, uint64_t* buffer, uint32_t len) {
+/*
+ * AuTTYMasterRead -- reading from master drains the
+ * slave's output, never blocks as terminal emulator
+ * polls it
+ */
+size_t AuTTYMasterRead(AuVFSNode* fs, AuVFSNode* file, uint64_t* buffer, size_t len) {
 	x64_cli();
 	TTY* type = (TTY*)file->device;
 	if (!type)
 		return 0;
 
-	size_t bytes_to_ret = 0;
-	uint8_t* aligned_buf = (uint8_t*)buffer;
-
-	if (CircBufEmpty(type->masterbuf)) {
-		return bytes_to_ret;
-	}
-
-	for (int i = 0; i < type->master_written; i++) {
-		AuCircBufGet(type->masterbuf, &aligned_buf[i]);
-		bytes_to_ret++;
-	}
-
-	type->master_written = 0;
+	size_t bytes_to_ret = AuRingBufRead(type->masterbuf, (uint8_t*)buffer, len);
+	/* room was made for blocked slave writers */
+	if (bytes_to_ret)
+		AuTTYWakeAll(&type->writers);
 	return bytes_to_ret;
 }
 
 /*
  * AuTTYMasterWrite -- writing to master goes to slave buffer
  */
-size_t AuTTYMasterWrite(AuVFSNode* fs, AuVFSNode* file, uint64_t* buffer, uint32_t len) {
+size_t AuTTYMasterWrite(AuVFSNode* fs, AuVFSNode* file, uint64_t* buffer, size_t len) {
 	x64_cli();
 	uint8_t* aligned_buf = (uint8_t*)buffer;
 	TTY* type = (TTY*)file->device;
 	if (!type)
 		return 0;
 
-	for (int i = 0; i < len; i++) {
-		AuCircBufPut(type->slavebuf, aligned_buf[i]);
+	size_t written = len;
+	if (AuTTYInputIsRaw(type)) {
+		written = AuRingBufWrite(type->slavebuf, aligned_buf, len);
 	}
+	else {
+		for (size_t i = 0; i < len; i++)
+			AuTTYProcessLine(type, aligned_buf[i]);
+	}
+
+	if (!AuRingBufEmpty(type->slavebuf) || type->eof)
+		AuTTYWakeAll(&type->readers);
+	return written;
 }
 
-size_t AuTTYSlaveRead(AuVFSNode* fsys, AuVFSNode* file, uint64_t* buffer, uint32_t len) {
+/*
+ * AuTTYSlaveRead -- reading from slave blocks until
+ * input is there, in canonical mode at most one line
+ * is returned
+ */
+size_t AuTTYSlaveRead(AuVFSNode* fsys, AuVFSNode* file, uint64_t* buffer, size_t len) {
 	x64_cli();
 	uint8_t* aligned_buf = (uint8_t*)buffer;
 	TTY* tty = (TTY*)file->device;
 	if (!tty)
 		return 0;
 
-	for (int i = 0; i < len; i++)
-		AuCircBufGet(tty->slavebuf, &aligned_buf[i]);
+	AuThread* thr = AuGetCurrentThread();
+	for (;;) {
+		if (!AuRingBufEmpty(tty->slavebuf)) {
+			size_t want = len;
+			if (tty->term.c_lflag & ICANON) {
+				/* bytes put while not canonical have no
+				 * recorded boundary, newline splits them */
+				size_t line = tty->lineEndCount ? tty->lineEnds[tty->lineEndHead] :
+					AuRingBufFind(tty->slavebuf, '\n');
+				if (line && line < want)
+					want = line;
+			}
+			size_t got = AuRingBufRead(tty->slavebuf, aligned_buf, want);
+			AuTTYConsumeLines(tty, got);
+			return got;
+		}
 
-	return 1;
+		if (tty->eof) {
+			tty->eof = false;
+			return 0;
+		}
+
+		if (tty->hangup || thr->pendingSigCount > 0)
+			return 0;
+
+		AuTTYWait(&tty->readers, thr);
+	}
 }
 
 /*
- * AuTTYSlaveWrite --- writing to slave goes to master buffer
+ * AuTTYSlaveWrite --- writing to slave goes to master buffer,
+ * blocks while master buffer is full
  */
-size_t AuTTYSlaveWrite(AuVFSNode* fsys, AuVFSNode* file, uint64_t* buffer, uint32_t len) {
+size_t AuTTYSlaveWrite(AuVFSNode* fsys, AuVFSNode* file, uint64_t* buffer, size_t len) {
 	x64_cli();
-	char* data = (char*)buffer;
 	AuThread* curr_th = AuGetCurrentThread();
 	uint8_t* aligned_buf = (uint8_t*)buffer;
 	TTY* tty = (TTY*)file->device;
 	if (!tty)
 		return 0;
-	if (len > 512)
-		len = 512;
 
-	if (CircBufFull(tty->masterbuf)) {
-		AuForceScheduler();
-		return 0;
-	}
+	size_t done = 0;
+	while (done < len) {
+		done += AuTTYOutput(tty, aligned_buf + done, len - done);
+		if (done == len)
+			break;
 
-	for (int i = 0; i < len; i++) {
-		AuCircBufPut(tty->masterbuf, aligned_buf[i]);
-		tty->master_written++;
-	}
+		/* nobody is going to drain it */
+		if (tty->hangup)
+			return len;
 
-	/* little bit slow down the slave process,
-	 * it's too fast 
-	 */
-	//AuSleepThread(curr_th, 1000000000000);
-	AuForceScheduler();
+		if (curr_th->pendingSigCount > 0)
+			break;
+
+		AuTTYWait(&tty->writers, curr_th);
+	}
+	return done;
 }
 
 int AuTTYSlaveClose(AuVFSNode* fs, AuVFSNode* file) {
 	AuVFSNode* _fs = AuVFSFind("/dev");
 	if (!_fs)
 		return 0;
+	return 0;
 }
 
 int AuTTYMasterClose(AuVFSNode* fs, AuVFSNode* file) {
+	TTY* tty = (TTY*)file->device;
+	if (!tty)
+		return 0;
 
+	/* release everybody sleeping on the slave end */
+	tty->hangup = true;
+	AuTTYWakeAll(&tty->readers);
+	AuTTYWakeAll(&tty->writers);
 	return 0;
 }
 
@@ -256,6 +513,32 @@ int AuTTYIoControl(AuVFSNode* file, int code, void* arg) {
 					   tty->slave_pid = proc->proc_id;
 					   break;
 	}
+
+	case TIOCGATTR: {
+						memcpy(arg, &tty->term, sizeof(Termios));
+						break;
+	}
+
+	case TIOCSATTR: {
+						bool canon = (tty->term.c_lflag & ICANON);
+						memcpy(&tty->term, arg, sizeof(Termios));
+						/* leaving canonical mode hands over
+						 * the half edited line */
+						if (canon && !(tty->term.c_lflag & ICANON)) {
+							AuTTYCommitLine(tty);
+							AuTTYWakeAll(&tty->readers);
+						}
+						break;
+	}
+
+	case TIOCFLUSH: {
+						AuRingBufReset(tty->masterbuf);
+						AuRingBufReset(tty->slavebuf);
+						tty->lineLen = 0;
+						AuTTYResetLines(tty);
+						AuTTYWakeAll(&tty->writers);
+						break;
+	}
 	}
 
 	return 1;
@@ -276,7 +559,7 @@ AuVFSNode* AuTTYCreateMaster(TTY* tty) {
 	sztoa(master_count, name + 4, 10);
 	strcpy(node->filename, name);
 
-	node->size = 512;
+	node->size = TTY_BUFFER_SIZE;
 	node->flags |= FS_FLAG_TTY;
 	node->device = tty;
 	node->read = AuTTYMasterRead;
@@ -305,7 +588,7 @@ AuVFSNode* AuTTYCreateSlave(TTY* tty) {
 	sztoa(slave_count, name + 4, 10);
 	strcpy(node->filename, name);
 
-	node->size = 512;
+	node->size = TTY_BUFFER_SIZE;
 	node->flags |= FS_FLAG_TTY;
 	node->device = tty;
 	node->read = AuTTYSlaveRead;
@@ -338,28 +621,39 @@ int AuTTYCreate(int* master_fd, int* slave_fd) {
 	TTY* tty = (TTY*)kmalloc(sizeof(TTY));
 	memset(tty, 0, sizeof(TTY));
 
-	void* inbuffer = kmalloc(512);
-	memset(inbuffer, 0, 512);
-	void* outbuffer = kmalloc(512);
-	memset(outbuffer, 0, 512);
+	void* inbuffer = kmalloc(TTY_BUFFER_SIZE);
+	memset(inbuffer, 0, TTY_BUFFER_SIZE);
+	void* outbuffer = kmalloc(TTY_BUFFER_SIZE);
+	memset(outbuffer, 0, TTY_BUFFER_SIZE);
 
-	tty->masterbuf = AuCircBufInitialise((uint8_t*)inbuffer, 512);
-	tty->slavebuf = AuCircBufInitialise((uint8_t*)outbuffer, 512);
+	tty->masterbuf = (AuRingBuffer*)kmalloc(sizeof(AuRingBuffer));
+	tty->slavebuf = (AuRingBuffer*)kmalloc(sizeof(AuRingBuffer));
+	AuRingBufInit(tty->masterbuf, (uint8_t*)inbuffer, TTY_BUFFER_SIZE);
+	AuRingBufInit(tty->slavebuf, (uint8_t*)outbuffer, TTY_BUFFER_SIZE);
 
 	tty->id = slave_count;
-	tty->master_written = 0;
-	tty->slave_written = 0;
+	tty->lineLen = 0;
+	tty->readers = NULL;
+	tty->writers = NULL;
 
 	tty->masterbuf_ptr = inbuffer;
 	tty->slavebuf_ptr = outbuffer;
 
 	tty->term.c_iflag = ICRNL | BRKINT;
 	tty->term.c_oflag = ONLCR | OPOST;
-	tty->term.c_iflag = ECHO | ECHOE | ECHOK | ICANON | ISIG | IEXTEN;
+	/* shell does its own echo and line editing, so
+	 * slave starts non-canonical, TIOCSATTR turns
+	 * ICANON and ECHO on */
+	tty->term.c_lflag = ISIG | IEXTEN;
 	tty->term.c_cflag = CREAD | CS8;
+	tty->term.c_cc[VINTR] = 3;
+	tty->term.c_cc[VQUIT] = 0x1c;
+	tty->term.c_cc[VERASE] = 0x7f;
+	tty->term.c_cc[VKILL] = 0x15;
 	tty->term.c_cc[VEOF] = 4;
+	tty->term.c_cc[VSUSP] = 0x1a;
 	tty->term.c_cc[VEOL] = 0;
-	tty->term.c_cc[VERASE] = 0x7f;
+	AuTTYInsert(tty);
 
 	AuVFSNode* master = AuTTYCreateMaster(tty);
 	AuVFSNode* slave = AuTTYCreateSlave(tty);
@@ -367,13 +661,13 @@ int AuTTYCreate(int* master_fd, int* slave_fd) {
 	int fd = AuProcessGetFileDesc(proc);
 	if (fd == -1)
 		return 0;
-	proc->fds[fd] = master;
+	AuProcessSetFileDesc(proc, fd, master);
 	*master_fd = fd;
 
 	fd = AuProcessGetFileDesc(proc);
 	if (fd == -1)
 		return 0;
-	proc->fds[fd] = slave;
+	AuProcessSetFileDesc(proc, fd, slave);
 	*slave_fd = fd;
 
 	return 1;
@@ -392,3 +686,24 @@ void AuTTYInitialise() {
 	AuDevFSCreateFile(fs, "/dev/tty", FS_FLAG_DIRECTORY);
 }
 
+/*
+ * AuTTYRemoveThread -- drop a thread from tty
+ * wait queues
+ * @param thr -- Pointer to thread
+ */
+void AuTTYRemoveThread(AuThread* thr) {
+	for (TTY* tty = root; tty != NULL; tty = tty->next) {
+		for (TTYWaiter** link = &tty->readers; *link != NULL;) {
+			if ((*link)->thread == thr)
+				*link = (*link)->next;
+			else
+				link = &(*link)->next;
+		}
+		for (TTYWaiter** link = &tty->writers; *link != NULL;) {
+			if ((*link)->thread == thr)
+				*link = (*link)->next;
+			else
+				link = &(*link)->next;
+		}
+	}
+}
@@ -39,6 +39,7 @@
 #include <stdio.h>
 #include <Fs/Fat/fat.h>
 #include <Fs/Dev/devfs.h>
+#include <autrace.h>
 
 AuVDisk *VdiskArray[MAX_VDISK_DEVICES];
 int _vdisk_num_;
@@ -112,8 +113,12 @@ AuVDisk *AuCreateVDisk(){
  * @param buffer -- Buffer, where to store the data
  */
 size_t AuVDiskRead(AuVDisk *disk, uint64_t lba, uint32_t count, uint64_t* buffer) {
-	if (disk->Read) 
-		return disk->Read(disk, disk->startingLBA + lba, count, buffer);
+	if (disk->Read) {
+		AU_TRACE(TRACE_EVENT_BLOCK_ISSUE, disk->startingLBA + lba, count);
+		size_t ret = disk->Read(disk, disk->startingLBA + lba, count, buffer);
+		AU_TRACE(TRACE_EVENT_BLOCK_COMPLETE, disk->startingLBA + lba, count);
+		return ret;
+	}
 	return 0;
 }
 
@@ -126,8 +131,12 @@ size_t AuVDiskRead(AuVDisk *disk, uint64_t lba, uint32_t count, uint64_t* buffer
 * @param buffer -- Buffer, where to store the data
 */
 size_t AuVDiskWrite(AuVDisk* disk, uint64_t lba, uint32_t count, uint64_t* buffer) {
-	if (disk->Write)
-		return disk->Write(disk, disk->startingLBA + lba, count, buffer);
+	if (disk->Write) {
+		AU_TRACE(TRACE_EVENT_BLOCK_ISSUE, disk->startingLBA + lba, count | (1ULL << 32));
+		size_t ret = disk->Write(disk, disk->startingLBA + lba, count, buffer);
+		AU_TRACE(TRACE_EVENT_BLOCK_COMPLETE, disk->startingLBA + lba, count | (1ULL << 32));
+		return ret;
+	}
 	return 0;
 }
 
@@ -194,7 +194,7 @@ AU_EXTERN AU_EXPORT int AuVFSNodeIOControl(AuVFSNode* node, int code, void* arg)
  * @param buffer -- buffer to write to
  * @param length -- length of the file
  */
-AU_EXTERN AU_EXPORT size_t AuVFSNodeRead(AuVFSNode* node, AuVFSNode* file, uint64_t* buffer, uint32_t length) {
+AU_EXTERN AU_EXPORT size_t AuVFSNodeRead(AuVFSNode* node, AuVFSNode* file, uint64_t* buffer, size_t length) {
 	if (node) {
 		if (node->read)
 			return node->read(node, file, buffer, length);
@@ -209,11 +209,12 @@ AU_EXTERN AU_EXPORT size_t AuVFSNodeRead(AuVFSNode* node, AuVFSNode* file, uint6
  * @param buffer -- buffer to write
  * @param length -- length of the data
  */
-AU_EXTERN AU_EXPORT void AuVFSNodeWrite(AuVFSNode* node, AuVFSNode * file, uint64_t *buffer, uint32_t length) {
+AU_EXTERN AU_EXPORT size_t AuVFSNodeWrite(AuVFSNode* node, AuVFSNode * file, uint64_t *buffer, size_t length) {
 	if (!node)
-		return;
+		return 0;
 	if (node->write)
-		node->write(node, file, buffer, length);
+		return node->write(node, file, buffer, length);
+	return 0;
 }
 
 /*
@@ -306,6 +307,21 @@ AU_EXTERN AU_EXPORT void AuVFSNodeClose(AuVFSNode* node, AuVFSNode* file) {
 		node->close(node, file);
 }
 
+/*
+ * AuVFSNodeSync -- writes out data of a file held back
+ * by the file system, the whole file system when file
+ * is null
+ * @param node -- file system node to use
+ * @param file -- file to sync, can be null
+ */
+AU_EXTERN AU_EXPORT int AuVFSNodeSync(AuVFSNode* node, AuVFSNode* file) {
+	if (!node)
+		return -1;
+	if (node->sync)
+		return node->sync(node, file);
+	return 0;
+}
+
 /*
  * AuVFSRemoveFileSystem -- removes a file system 
  * @param node -- file system node to remove
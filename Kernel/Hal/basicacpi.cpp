@@ -151,6 +151,53 @@ void AuACPIParseMADT() {
 	}
 }
 
+/*
+ * AuACPIParseSRAT -- Parses the SRAT table and hands
+ * numa memory and cpu affinity to the physical memory
+ * manager
+ * @param srat -- pointer to srat table
+ */
+void AuACPIParseSRAT(acpi_table_srat_xe* srat) {
+	acpi_sub_table* sub = raw_offset<acpi_sub_table*>(srat, sizeof(acpi_table_srat_xe));
+
+	while (raw_diff(sub, srat) < srat->Header.length) {
+		if (sub->length == 0)
+			break;
+		switch (sub->type) {
+		case acpi_srat_type_cpu_affinity: {
+											  AcpiSRATCpuAffinity* cpu = (AcpiSRATCpuAffinity*)sub;
+											  if (!(cpu->flags & ACPI_SRAT_ENABLED))
+												  break;
+											  uint32_t domain = cpu->proximity_domain_lo |
+												  (cpu->proximity_domain_hi[0] << 8) |
+												  (cpu->proximity_domain_hi[1] << 16) |
+												  (cpu->proximity_domain_hi[2] << 24);
+											  AuPmmngrSetCPUNode(cpu->apic_id, domain);
+											  break;
+		}
+		case acpi_srat_type_memory_affinity: {
+												 AcpiSRATMemAffinity* mem = (AcpiSRATMemAffinity*)sub;
+												 if (!(mem->flags & ACPI_SRAT_ENABLED))
+													 break;
+												 AuPmmngrAddNodeRange(mem->proximity_domain, mem->base_address, mem->length);
+												 break;
+		}
+		case acpi_srat_type_x2apic_cpu_affinity: {
+													 AcpiSRATX2ApicAffinity* cpu = (AcpiSRATX2ApicAffinity*)sub;
+													 if (!(cpu->flags & ACPI_SRAT_ENABLED))
+														 break;
+													 AuPmmngrSetCPUNode(cpu->x2apic_id, cpu->proximity_domain);
+													 break;
+		}
+		default:
+			break;
+		}
+
+		sub = raw_offset<acpi_sub_table*>(sub, sub->length);
+	}
+	AuPmmngrBuildZones();
+}
+
 /*
  * AuACPIInitialise -- initialise the aurora's basic acpi
  * subsystem
@@ -184,8 +231,7 @@ void AuACPIInitialise(void* acpi_base) {
 		}
 		else if (!strncmp(sig, ACPI_SIG_SRAT, strlen(ACPI_SIG_SRAT))) {
 			AuTextOut("acpi srat supported \n");
-			/* here needs to parse the srat table for
-			 * numa memory */
+			AuACPIParseSRAT((acpi_table_srat_xe*)header);
 		}
 		else if (!strncmp(sig, ACPI_SIG_SLIT, strlen(ACPI_SIG_SLIT))) {
 			AuTextOut("acpi slit supported \n");
@@ -43,6 +43,9 @@
 
 TSS* _tss;
 bool _fxsave = false;
+bool _pcid = false;
+bool _invpcid = false;
+bool _pdpe1gb = false;
 uint64_t cpuMhz;
 uint64_t tscBasisTiming;
 uint64_t tscBasisTimingKhz;
@@ -139,6 +142,16 @@ void x86_64_hal_cpu_feature_enable() {
 		x64_write_cr4(cr4);
 	}
 
+	/* process context identifiers, lets the tlb keep
+	 * translations of several address spaces across
+	 * cr3 switches, cr3 still carries pcid 0 here */
+	if ((c & (1 << 17)) != 0) {
+		uint64_t cr4 = x64_read_cr4();
+		cr4 |= (1 << 17);
+		x64_write_cr4(cr4);
+		_pcid = true;
+	}
+
 	if ((d & (1 << 25)) != 0) {
 		size_t cr4 = x64_read_cr4();
 
@@ -159,6 +172,22 @@ void x86_64_hal_cpu_feature_enable() {
 	else if ((c & (1 << 0)) != 0) {
 		//supported SSE3
 	}
+
+	/* invpcid drops entries of a single pcid */
+	x64_cpuid(0, &a, &b, &c, &d, 0);
+	if (a >= 7) {
+		x64_cpuid(7, &a, &b, &c, &d, 0);
+		if ((b & (1 << 10)) != 0)
+			_invpcid = true;
+	}
+
+	/* 1 GiB pages */
+	x64_cpuid(0x80000000, &a, &b, &c, &d, 0);
+	if (a >= 0x80000001) {
+		x64_cpuid(0x80000001, &a, &b, &c, &d, 0);
+		if ((d & (1 << 26)) != 0)
+			_pdpe1gb = true;
+	}
 }
 
 
@@ -166,6 +195,30 @@ bool x86_64_is_cpu_fxsave_supported() {
 	return _fxsave;
 }
 
+/*
+ * x86_64_is_cpu_pcid_supported -- checks if process
+ * context identifiers are enabled
+ */
+bool x86_64_is_cpu_pcid_supported() {
+	return _pcid;
+}
+
+/*
+ * x86_64_is_cpu_invpcid_supported -- checks if single
+ * pcid entries can be invalidated
+ */
+bool x86_64_is_cpu_invpcid_supported() {
+	return _invpcid;
+}
+
+/*
+ * x86_64_is_cpu_pdpe1gb_supported -- checks if 1 GiB
+ * pages can be used
+ */
+bool x86_64_is_cpu_pdpe1gb_supported() {
+	return _pdpe1gb;
+}
+
 /*
  * x86_64_cpu_msi_address -- calculates the cpu msi address
  * @param data -- msi data to return
@@ -37,6 +37,7 @@
 #include <aucon.h>
 #include <Mm/vmmngr.h>
 #include <Mm/vmarea.h>
+#include <Mm/mmap.h>
 #include <Mm/pmmngr.h>
 #include <_null.h>
 #include <Hal/x86_64_idt.h>
@@ -45,6 +46,7 @@
 #include <Hal/x86_64_signal.h>
 #include <Serv/sysserv.h>
 #include <Hal/serial.h>
+#include <autrace.h>
 
 void panic(const char* msg, ...) {
 	SeTextOut("\r\n ***ARCH x86_64 : Kernel Panic!!! *** \r\n");
@@ -208,6 +210,7 @@ void page_fault(size_t vector, void* param){
 
 
 	void* vaddr = (void*)x64_read_cr2();
+	AU_TRACE(TRACE_EVENT_PAGE_FAULT, vaddr, frame->error);
 
 	int present = !(frame->error & 0x1);
 	int rw = frame->error & 0x2;
@@ -217,11 +220,23 @@ void page_fault(size_t vector, void* param){
 
 
 	AuThread* thr = AuGetCurrentThread();
+	AuProcess *proc = NULL;
 	
 	/* check for signal */
 	if (!thr) {
 		goto skip;
 	}
+
+	proc = AuProcessFindThread(thr);
+	if (!proc)
+		proc = AuProcessFindSubThread(thr);
+
+	/* file mappings are paged in on demand, this goes
+	 * first so that a signal handler touching a mapping
+	 * is not taken for a signal return */
+	if (proc && AuMemMapHandleFault(proc, (uint64_t)vaddr, frame->error))
+		return;
+
 	if (thr->returnableSignal) {
 		Signal* sig = (Signal*)thr->returnableSignal;
 		x86_64_cpu_regs_t* ctx = (x86_64_cpu_regs_t*)(thr->frame.kern_esp - sizeof(x86_64_cpu_regs_t));
@@ -236,17 +251,10 @@ void page_fault(size_t vector, void* param){
 		return;
 	}
 
-	AuProcess *proc = NULL;
-	if (thr) {
-		proc = AuProcessFindThread(thr);
-		if (!proc)
-			proc = AuProcessFindSubThread(thr);
-		
-		SeTextOut("Thread name -> %s \r\n", thr->name);
-		if (proc) {
-			SeTextOut("Process pid -> %d \r\n", proc->proc_id);
-			SeTextOut("Process name -> %s \r\n", proc->name);
-		}
+	SeTextOut("Thread name -> %s \r\n", thr->name);
+	if (proc) {
+		SeTextOut("Process pid -> %d \r\n", proc->proc_id);
+		SeTextOut("Process name -> %s \r\n", proc->name);
 	}
 	
 skip:
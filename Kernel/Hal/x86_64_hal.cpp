@@ -37,6 +37,7 @@
 #include <Mm/kmalloc.h>
 #include <Hal/basicacpi.h>
 #include <Hal/x86_64_pic.h>
+#include <Mm/tlb.h>
 
 /*
  * x86_64_hal_initialise -- initialise the x86_64 hardware
@@ -68,6 +69,8 @@ void x86_64_hal_initialise(KERNEL_BOOT_INFO *info) {
 	AuCreatePerCPU(cpu);
 	AuPerCPUSetCpuID(0);
 	AuPerCPUSetKernelTSS(x86_64_get_tss());
+	AuTLBInitialise();
+	AuPmmngrCacheInitialise();
 	/* acpica needs problem fixing */
 	//AuInitialiseACPISubsys(info);
 
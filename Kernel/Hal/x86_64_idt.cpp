@@ -34,6 +34,7 @@
 #include <Hal/x86_64_lowlevel.h>
 #include <Mm/kmalloc.h>
 #include <aucon.h>
+#include <autrace.h>
 
 //=====================================================================
 // I N T E R R U P T   D E S C R I P T O R   T A B L E
@@ -57,7 +58,16 @@ void setvect(size_t vector, void(*function)(size_t vector, void* param))
 
 extern "C" void interrupt_dispatcher(uint64_t num, interrupt_stack_frame *frame)
 {
+	/* exceptions have tracepoints of their own, scheduler
+	 * tick switches stacks and may never return here, the
+	 * decoder closes an irq open across a switch */
+	if (num < 32) {
+		interrupts_handlers[num](num, frame);
+		return;
+	}
+	AU_TRACE(TRACE_EVENT_IRQ_ENTER, num, 0);
 	interrupts_handlers[num](num, frame);
+	AU_TRACE(TRACE_EVENT_IRQ_EXIT, num, 0);
 	return;
 }
 
@@ -413,6 +413,12 @@ flush_tlb:
        invlpg [rcx]
 	   ret
 
+;; invpcid, rcx = type, rdx = pointer to descriptor
+global x64_invpcid
+x64_invpcid:
+       invpcid rcx, [rdx]
+	   ret
+
 global cache_flush
 cache_flush:
        wbinvd
@@ -530,6 +536,20 @@ x64_lock_test:
      mov rax, 1
 	 ret
 
+;; x64_atomic_fetch_add -- (rcx : dword ptr, rdx : value)
+;; returns old value
+global x64_atomic_fetch_add
+x64_atomic_fetch_add:
+     mov eax, edx
+	 lock xadd [rcx], eax
+	 ret
+
+global x64_read_rflags
+x64_read_rflags:
+     pushfq
+	 pop rax
+	 ret
+
 global x64_set_rbp
 x64_set_rbp:
      mov rbp, rcx
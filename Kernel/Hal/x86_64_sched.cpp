@@ -35,14 +35,19 @@
 #include <Hal/x86_64_signal.h>
 #include <Hal/x86_64_pic.h>
 #include <Sync/spinlock.h>
+#include <Sync/mutex.h>
 #include <Hal/serial.h>
 #include <Mm/kmalloc.h>
 #include <Mm/vmmngr.h>
 #include <Hal/pcpu.h>
 #include <Mm/pmmngr.h>
+#include <Mm/tlb.h>
 #include <string.h>
 #include <_null.h>
 #include <aucon.h>
+#include <idtable.h>
+#include <autimer.h>
+#include <autrace.h>
 
 AuThread* thread_list_head;
 AuThread* thread_list_last;
@@ -54,11 +59,13 @@ AuThread* sleep_thr_head;
 AuThread* sleep_thr_last;
 
 bool _x86_64_sched_enable;
-static uint16_t thread_id;
+static AuIDTable* thread_table;
 AuThread* _idle_thr;
 Spinlock *_idle_lock;
 bool _x86_64_sched_init;
 static uint64_t scheduler_tick;
+/* number of ready threads on each priority level */
+static uint32_t ready_count[THREAD_PRIORITY_LEVELS];
 
 extern "C" int save_context(AuThread *t, void *tss);
 extern "C" void execute_idle(AuThread* t, void* tss);
@@ -66,7 +73,9 @@ uint64_t AuMapKStack(uint64_t *cr3);
 
 void AuThreadInsert(AuThread* new_task) {
 	new_task->next = NULL;
+	new_task->queue = THREAD_QUEUE_READY;
 	new_task->prev = NULL;
+	ready_count[new_task->priority]++;
 
 	if (thread_list_head == NULL) {
 		thread_list_last = new_task;
@@ -87,6 +96,10 @@ void AuThreadDelete(AuThread* thread) {
 
 	if (thread_list_head == NULL)
 		return;
+	/* a recount may have left it at zero already */
+	if (thread->queue == THREAD_QUEUE_READY && ready_count[thread->priority])
+		ready_count[thread->priority]--;
+	thread->queue = THREAD_QUEUE_NONE;
 
 	if (thread == thread_list_head) {
 		thread_list_head = thread_list_head->next;
@@ -116,6 +129,7 @@ void AuThreadDelete(AuThread* thread) {
 */
 void AuThreadInsertBlock(AuThread* new_task) {
 	new_task->next = NULL;
+	new_task->queue = THREAD_QUEUE_BLOCKED;
 	new_task->prev = NULL;
 
 	if (blocked_thr_head == NULL) {
@@ -137,6 +151,7 @@ void AuThreadDeleteBlock(AuThread* thread) {
 
 	if (blocked_thr_head == NULL)
 		return;
+	thread->queue = THREAD_QUEUE_NONE;
 
 	if (thread == blocked_thr_head) {
 		blocked_thr_head = blocked_thr_head->next;
@@ -160,6 +175,7 @@ void AuThreadDeleteBlock(AuThread* thread) {
 */
 void AuThreadInsertTrash(AuThread* new_task) {
 	new_task->next = NULL;
+	new_task->queue = THREAD_QUEUE_TRASH;
 	new_task->prev = NULL;
 
 	if (trash_thr_head == NULL) {
@@ -181,6 +197,7 @@ void AuThreadDeleteTrash(AuThread* thread) {
 
 	if (trash_thr_head == NULL)
 		return;
+	thread->queue = THREAD_QUEUE_NONE;
 
 	if (thread == trash_thr_head) {
 		trash_thr_head = trash_thr_head->next;
@@ -204,6 +221,7 @@ void AuThreadDeleteTrash(AuThread* thread) {
 */
 void AuThreadInsertSleep(AuThread* new_task) {
 	new_task->next = NULL;
+	new_task->queue = THREAD_QUEUE_SLEEP;
 	new_task->prev = NULL;
 
 	if (sleep_thr_head == NULL) {
@@ -225,6 +243,7 @@ void AuThreadDeleteSleep(AuThread* thread) {
 
 	if (sleep_thr_head == NULL)
 		return;
+	thread->queue = THREAD_QUEUE_NONE;
 
 	if (thread == sleep_thr_head) {
 		sleep_thr_head = sleep_thr_head->next;
@@ -291,7 +310,7 @@ AuThread* AuCreateKthread(void(*entry) (uint64_t), uint64_t stack, uint64_t cr3,
 	t->uentry = NULL; 
 	memset(t->name, 0,16);
 	strcpy(t->name, name);
-	t->id = thread_id++;
+	t->id = AuIDTableAlloc(thread_table, t);
 
 	t->fx_state = (uint8_t*)kmalloc(512);
 
@@ -353,7 +372,7 @@ void AuIdleThread(uint64_t t) {
  * AuSchedulerInitialise -- initialise the core scheduler
  */
 void AuSchedulerInitialise() {
-	thread_id = 0;
+	thread_table = AuIDTableCreate();
 	thread_list_head = NULL;
 	thread_list_last = NULL;
 	blocked_thr_head = NULL;
@@ -364,7 +383,8 @@ void AuSchedulerInitialise() {
 	_x86_64_sched_init = false;
 	scheduler_tick = 0;
 	_idle_lock = AuCreateSpinlock(false);
-	AuThread *idle_ = AuCreateKthread(AuIdleThread, (uint64_t)P2V((uint64_t)AuPmmngrAlloc() + 4096), x64_read_cr3(), "Idle");
+	AuSpinlockSetName(_idle_lock, "idle_lock");
+	AuThread *idle_ = AuCreateKthread(AuIdleThread, (uint64_t)P2V((uint64_t)AuPmmngrAlloc() + 4096), x64_read_cr3() & X86_64_CR3_ADDR_MASK, "Idle");
 	_idle_thr = idle_;
 	AuPerCPUSetCurrentThread(idle_);
 }
@@ -383,7 +403,10 @@ void AuHandleSleepThreads() {
 	uint64_t timer_ticks = 0;
 	uint64_t timer_subtick = 0;
 	updateTicks(tsc_ticks / x86_64_cpu_get_mhz(), &timer_ticks, &timer_subtick);
-	for (AuThread* sleep_thr = sleep_thr_head; sleep_thr != NULL; sleep_thr = sleep_thr->next) {
+	AuThread* next_thr = NULL;
+	for (AuThread* sleep_thr = sleep_thr_head; sleep_thr != NULL; sleep_thr = next_thr) {
+		/* insertion to ready list rewrites the links */
+		next_thr = sleep_thr->next;
 		if ((sleep_thr->quanta <= timer_ticks) || (sleep_thr->quanta == timer_ticks && sleep_thr->endTick
 			<= timer_subtick)){
 			sleep_thr->state = THREAD_STATE_READY;
@@ -398,13 +421,26 @@ void AuHandleSleepThreads() {
  */
 void AuNextThread() {
 	AuThread* thread = AuPerCPUGetCurrentThread();
+	AuThread* prev = thread;
 	bool _run_idle = false;
+	/* highest priority level that has ready threads,
+	 * lower levels wait until it drains */
+	uint8_t top = THREAD_PRIORITY_LEVELS - 1;
+	while (top > THREAD_PRIORITY_NORMAL && ready_count[top] == 0)
+		top--;
+	int wraps;
 run:	
+	/* a second wrap to the head means one full lap
+	 * found nothing runnable at this level */
+	wraps = 0;
 	do {
 		thread = thread->next;
 
-		if (!thread)
+		if (!thread) {
+			if (++wraps > 1)
+				break;
 			thread = thread_list_head;
+		}
 
 		if (thread == _idle_thr)
 			thread = thread->next;
@@ -414,11 +450,34 @@ run:
 			break;
 		}
 
-	} while (thread->state != THREAD_STATE_READY);
+	} while (thread->state != THREAD_STATE_READY || thread->priority < top);
+
+	if (wraps > 1) {
+		/* counter and thread states disagree, recount the
+		 * ready threads of the level and fall back to the
+		 * next lower one */
+		uint32_t count = 0;
+		for (AuThread* t = thread_list_head; t != NULL; t = t->next) {
+			if (t != _idle_thr && t->priority == top && t->state == THREAD_STATE_READY)
+				count++;
+		}
+		ready_count[top] = count;
+		if (top > THREAD_PRIORITY_NORMAL) {
+			top--;
+			thread = prev;
+			goto run;
+		}
+		_run_idle = true;
+	}
 end:
 	if (_run_idle)
 		thread = _idle_thr;
 
+	prev->onCpu = 0;
+	thread->onCpu = 1;
+	if (prev != thread)
+		AU_TRACE(TRACE_EVENT_SWITCH, prev->id, thread->id);
+
 	//current_thread = thread;
 	AuPerCPUSetCurrentThread(thread);
 }
@@ -439,7 +498,7 @@ void x8664SchedulerISR(size_t v, void* param) {
 	AuThread* current_thread = AuPerCPUGetCurrentThread();
 	
 	if (save_context(current_thread, ktss) == 0) {
-		current_thread->frame.cr3 = x64_read_cr3();
+		current_thread->frame.cr3 = x64_read_cr3() & X86_64_CR3_ADDR_MASK;
 		current_thread->frame.kern_esp = x64_get_kstack(ktss);
 		/* check for any signal */
 		if (AuCheckSignal(current_thread, frame)) {
@@ -461,6 +520,7 @@ void x8664SchedulerISR(size_t v, void* param) {
 			for (;;);
 		}
 		AuHandleSleepThreads();
+		AuHRTimerExpire();
 		AuNextThread();
 		current_thread = AuPerCPUGetCurrentThread();
 		
@@ -472,6 +532,10 @@ void x8664SchedulerISR(size_t v, void* param) {
 		x64_set_kstack(ktss, current_thread->frame.kern_esp);
 
 		x64_ldmxcsr(&current_thread->mxcsr);
+
+		/* tag the address space with its pcid, execute_idle
+		 * loads the tagged value */
+		current_thread->frame.cr3 = AuTLBSwitchCR3(current_thread->frame.cr3);
 	
 		execute_idle(current_thread, ktss);
 	}
@@ -489,6 +553,8 @@ void AuSchedulerStart() {
 	AuThread* current_thread = AuPerCPUGetCurrentThread();
 	TSS* _ks = AuPerCPUGetKernelTSS(); //x86_64_get_tss();
 	SeTextOut("CurrentThread ->%x %x \r\n", current_thread, _ks);
+	current_thread->frame.cr3 = AuTLBSwitchCR3(current_thread->frame.cr3);
+	current_thread->onCpu = 1;
 	execute_idle(current_thread, x86_64_get_tss());
 }
 
@@ -541,16 +607,27 @@ AU_EXTERN AU_EXPORT void AuSleepThread(AuThread *thread, uint64_t ms) {
  */
 AU_EXTERN AU_EXPORT void AuUnblockThread(AuThread *t) {
 	t->state = THREAD_STATE_READY;
-	bool found_ = false;
-	for (AuThread *thr = blocked_thr_head; thr != NULL; thr = thr->next) {
-		if (thr == t) {
-			AuThreadDeleteBlock(thr);
-			found_ = true;
-			break;
-		}
+	if (t->queue == THREAD_QUEUE_BLOCKED) {
+		AuThreadDeleteBlock(t);
+		AuThreadInsert(t);
 	}
-	if (found_)
+}
+
+/*
+ * AuWakeThread -- make a blocked or sleeping thread
+ * ready before its sleep time expires
+ * @param t -- pointer to thread
+ */
+AU_EXTERN AU_EXPORT void AuWakeThread(AuThread* t) {
+	if (t->queue == THREAD_QUEUE_BLOCKED) {
+		AuUnblockThread(t);
+	}
+	else if (t->queue == THREAD_QUEUE_SLEEP) {
+		AuThreadDeleteSleep(t);
+		t->state = THREAD_STATE_READY;
+		t->quanta = 0;
 		AuThreadInsert(t);
+	}
 }
 
 /* 
@@ -562,19 +639,21 @@ void AuThreadMoveToTrash(AuThread* t) {
 	if (!t)
 		return;
 
+	/* a mutex waiter sits on the dying thread's stack */
+	AuMutexRemoveThread(t);
+
 	t->state = THREAD_STATE_KILLABLE;
 
-	/* search the thread in ready queue*/
-	for (AuThread* ready_queue_ = thread_list_head; ready_queue_ != NULL; ready_queue_ = ready_queue_->next) {
-		if (ready_queue_ == t) 
-			AuThreadDelete(t);
-	}
+	/* unlink from whichever queue it is on */
+	if (t->queue == THREAD_QUEUE_READY)
+		AuThreadDelete(t);
+	else if (t->queue == THREAD_QUEUE_BLOCKED)
+		AuThreadDeleteBlock(t);
+	else if (t->queue == THREAD_QUEUE_SLEEP)
+		AuThreadDeleteSleep(t);
 
-	/* search the thread in block queue*/
-	for (AuThread* block_queue_ = blocked_thr_head; block_queue_ != NULL; block_queue_ = block_queue_->next) {
-		if (block_queue_ == t)
-			AuThreadDeleteBlock(t);
-	}
+	/* id is no longer reachable */
+	AuIDTableRemove(thread_table, t->id);
 
 	/* insert it in the trash list */
 	AuThreadInsertTrash(t);
@@ -590,16 +669,11 @@ void AuThreadCleanTrash(AuThread* t) {
 }
 
 /*
- * AuThreadFindByID -- finds a thread by its id from
- * ready queue
+ * AuThreadFindByID -- finds a live thread by its id
  * @param id -- id of the thread
  */
-AuThread* AuThreadFindByID(uint16_t id) {
-	for (AuThread* ready_queue_ = thread_list_head; ready_queue_ != NULL; ready_queue_ = ready_queue_->next) {
-		if (ready_queue_->id == id)
-			return ready_queue_;
-	}
-	return NULL;
+AuThread* AuThreadFindByID(uint32_t id) {
+	return (AuThread*)AuIDTableGet(thread_table, id);
 }
 
 /*
@@ -607,14 +681,48 @@ AuThread* AuThreadFindByID(uint16_t id) {
  * the block queue
  * @param id -- id of the thread
  */
-AuThread* AuThreadFindByIDBlockList(uint16_t id){
-	for (AuThread* block_queue = blocked_thr_head; block_queue != NULL; block_queue = block_queue->next){
-		if (block_queue->id == id)
-			return block_queue;
-	}
+AuThread* AuThreadFindByIDBlockList(uint32_t id){
+	AuThread* thr = (AuThread*)AuIDTableGet(thread_table, id);
+	if (thr && thr->queue == THREAD_QUEUE_BLOCKED)
+		return thr;
 	return NULL;
 }
 
+/*
+ * AuThreadSetPriority -- change effective priority of
+ * a thread
+ * @param t -- pointer to thread
+ * @param priority -- new priority
+ */
+AU_EXTERN AU_EXPORT void AuThreadSetPriority(AuThread* t, uint8_t priority) {
+	if (!t)
+		return;
+	if (priority >= THREAD_PRIORITY_LEVELS)
+		priority = THREAD_PRIORITY_LEVELS - 1;
+	if (t->queue == THREAD_QUEUE_READY) {
+		if (ready_count[t->priority])
+			ready_count[t->priority]--;
+		ready_count[priority]++;
+	}
+	t->priority = priority;
+}
+
+/*
+ * AuThreadSetBasePriority -- change base priority of
+ * a thread
+ * @param t -- pointer to thread
+ * @param priority -- new base priority
+ */
+AU_EXTERN AU_EXPORT void AuThreadSetBasePriority(AuThread* t, uint8_t priority) {
+	if (!t)
+		return;
+	if (priority >= THREAD_PRIORITY_LEVELS)
+		priority = THREAD_PRIORITY_LEVELS - 1;
+	uint8_t inherited = (t->priority > t->basePriority) ? t->priority : THREAD_PRIORITY_NORMAL;
+	t->basePriority = priority;
+	AuThreadSetPriority(t, (inherited > priority) ? inherited : priority);
+}
+
 /*
  * AuForceScheduler -- force the scheduler
  * to switch next thread
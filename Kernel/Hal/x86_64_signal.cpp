@@ -138,29 +138,15 @@ void AuPrepareSignal(AuThread* thr, interrupt_stack_frame* frame, Signal* signal
  * @param tid -- thread id
  * @param signo -- signal number
  */
-void AuSendSignal(uint16_t tid, int signo) {
+void AuSendSignal(uint32_t tid, int signo) {
 	AuThread* thr = AuThreadFindByID(tid);
-	bool blocked = false;
-	if (!thr){
-		thr = AuThreadFindByIDBlockList(tid);
-		if (thr)
-			blocked = true;
-	}
-		
 	if (!thr)
 		return;
 
 	AuAllocateSignal(thr, signo);
 
-	/* unblock the thread for signal handling */
-	if (blocked) {
-		AuUnblockThread(thr);
-	}
-
-	if (thr->state == THREAD_STATE_SLEEP) {
-		thr->quanta = 0;
-		thr->state = THREAD_STATE_READY;
-	}
+	/* unblock or wake the thread for signal handling */
+	AuWakeThread(thr);
 }
 
 
@@ -45,6 +45,10 @@
 #include <Mm\mmap.h>
 #include <net\socket.h>
 #include <Fs\vdisk.h>
+#include <Ipc\channel.h>
+#include <Sync\futex.h>
+#include <Serv\ioring.h>
+#include <autrace.h>
 
 /* Syscall function format */
 typedef int64_t(*syscall_func) (int64_t param1, int64_t param2, int64_t param3, int64_t
@@ -130,6 +134,23 @@ static void* syscalls[AURORA_MAX_SYSCALL] = {
 	AuGetVDiskInfo, //55
 	AuGetVDiskPartitionInfo, //56
 	GetEnvironmenBlock, //57
+	ReadFileAt, //58
+	WriteFileAt, //59
+	ReadFileV, //60
+	WriteFileV, //61
+	FileSync, //62
+	AuChannelWait, //63
+	AuChannelWake, //64
+	Futex, //65
+	IORingSetup, //66
+	IORingEnter, //67
+	FileDup, //68
+	HRTimerCreate, //69
+	HRTimerArm, //70
+	HRTimerDisarm, //71
+	HRTimerWait, //72
+	HRTimerClose, //73
+	GetMonotonicClock, //74
 };
 
 //! System Call Handler Functions
@@ -149,8 +170,10 @@ extern "C" int64_t x64_syscall_handler(int a) {
 	if (!func)
 		return 0;
 
+	AU_TRACE(TRACE_EVENT_SYSCALL_ENTER, a, current_thr->syscall_param.param1);
 	ret_code = func(current_thr->syscall_param.param1, current_thr->syscall_param.param2, current_thr->syscall_param.param3,
 			current_thr->syscall_param.param4, current_thr->syscall_param.param5, current_thr->syscall_param.param6);
+	AU_TRACE(TRACE_EVENT_SYSCALL_EXIT, a, ret_code);
 
 	return ret_code;
 }
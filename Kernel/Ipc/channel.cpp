@@ -0,0 +1,181 @@
+/**
+* BSD 2-Clause License
+*
+* Copyright (c) 2022-2023, Manas Kamal Choudhury
+* All rights reserved.
+*
+* Redistribution and use in source and binary forms, with or without
+* modification, are permitted provided that the following conditions are met:
+*
+* 1. Redistributions of source code must retain the above copyright notice, this
+*    list of conditions and the following disclaimer.
+*
+* 2. Redistributions in binary form must reproduce the above copyright notice,
+*    this list of conditions and the following disclaimer in the documentation
+*    and/or other materials provided with the distribution.
+*
+* THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+* AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+* IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+* DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE
+* FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+* DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR
+* SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER
+* CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY,
+* OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+* OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+*
+**/
+
+#include <Ipc\channel.h>
+#include <Mm\vmmngr.h>
+#include <Sync\spinlock.h>
+#include <Hal\x86_64_hal.h>
+#include <Hal\x86_64_lowlevel.h>
+#include <_null.h>
+
+/*
+ * Channels are single producer, single consumer rings living
+ * in shared memory, peers update head/tail indices without
+ * kernel help. The kernel is only entered when one side has
+ * to sleep on an empty/full ring, so wait queues are keyed
+ * by the physical address of the index word, which stays the
+ * same no matter where each process mapped the segment.
+ */
+
+static AuChannelWaiter* channelBuckets[CHANNEL_WAIT_BUCKETS];
+static Spinlock* channelLock;
+
+/*
+ * AuChannelInitialise -- initialise channel
+ * wait queues
+ */
+void AuChannelInitialise() {
+	for (int i = 0; i < CHANNEL_WAIT_BUCKETS; i++)
+		channelBuckets[i] = NULL;
+	channelLock = AuCreateSpinlock(false);
+	AuSpinlockSetName(channelLock, "channel");
+}
+
+/*
+ * AuChannelGetKey -- translate a user address to
+ * its physical address
+ * @param addr -- user address of the word
+ */
+static uint64_t AuChannelGetKey(uint32_t* addr) {
+	uint64_t virt = (uint64_t)addr;
+	if (virt == 0 || virt >= PHYSICAL_MEM_BASE || (virt & 3))
+		return 0;
+	AuVPage* page = AuVmmngrGetPage(virt, VIRT_GETPAGE_ONLY_RET, VIRT_GETPAGE_ONLY_RET);
+	if (!page || !page->bits.present)
+		return 0;
+	return ((uint64_t)page->bits.page << PAGE_SHIFT) | (virt & (PAGE_SIZE - 1));
+}
+
+static int AuChannelBucket(uint64_t key) {
+	return (key >> 2) % CHANNEL_WAIT_BUCKETS;
+}
+
+/*
+ * AuChannelWait -- sleep until the word at given
+ * user address is woken, returns immediately if
+ * the word no longer holds the expected value
+ * @param addr -- user address of the word
+ * @param expected -- value the caller last observed
+ */
+int AuChannelWait(uint32_t* addr, uint32_t expected) {
+	x64_cli();
+	AuThread* thr = AuGetCurrentThread();
+	uint64_t key = AuChannelGetKey(addr);
+	if (!key)
+		return -1;
+
+	AuAcquireSpinlock(channelLock);
+	/* value is re-checked under the lock, a waker
+	 * always changes the word before taking it */
+	if (*(volatile uint32_t*)addr != expected) {
+		AuReleaseSpinlock(channelLock);
+		return 1;
+	}
+
+	/* waiter lives on this thread's kernel stack,
+	 * it is unlinked before we return */
+	AuChannelWaiter waiter;
+	waiter.key = key;
+	waiter.thread = thr;
+	waiter.woken = false;
+	int bucket = AuChannelBucket(key);
+	waiter.next = channelBuckets[bucket];
+	channelBuckets[bucket] = &waiter;
+
+	AuBlockThread(thr);
+	AuReleaseSpinlock(channelLock);
+	AuForceScheduler();
+
+	/* a signal may have woken us without going through
+	 * AuChannelWake, the waiter is then still queued */
+	x64_cli();
+	AuAcquireSpinlock(channelLock);
+	if (!waiter.woken) {
+		for (AuChannelWaiter** link = &channelBuckets[bucket]; *link != NULL; link = &(*link)->next) {
+			if (*link == &waiter) {
+				*link = waiter.next;
+				break;
+			}
+		}
+	}
+	AuReleaseSpinlock(channelLock);
+	return 0;
+}
+
+/*
+ * AuChannelWake -- wake threads sleeping on the word
+ * at given user address
+ * @param addr -- user address of the word
+ * @param count -- maximum number of threads to wake
+ */
+int AuChannelWake(uint32_t* addr, int count) {
+	x64_cli();
+	uint64_t key = AuChannelGetKey(addr);
+	if (!key)
+		return -1;
+
+	int woken = 0;
+	AuAcquireSpinlock(channelLock);
+	AuChannelWaiter** link = &channelBuckets[AuChannelBucket(key)];
+	while (*link != NULL && woken < count) {
+		AuChannelWaiter* waiter = *link;
+		if (waiter->key != key) {
+			link = &waiter->next;
+			continue;
+		}
+		*link = waiter->next;
+		waiter->woken = true;
+		if (waiter->thread->state == THREAD_STATE_BLOCKED)
+			AuUnblockThread(waiter->thread);
+		woken++;
+	}
+	AuReleaseSpinlock(channelLock);
+	return woken;
+}
+
+/*
+ * AuChannelRemoveThread -- drop a thread from channel
+ * wait queues
+ * @param thr -- Pointer to thread
+ */
+void AuChannelRemoveThread(AuThread* thr) {
+	AuAcquireSpinlock(channelLock);
+	for (int i = 0; i < CHANNEL_WAIT_BUCKETS; i++) {
+		AuChannelWaiter** link = &channelBuckets[i];
+		while (*link != NULL) {
+			if ((*link)->thread == thr) {
+				(*link)->woken = true;
+				*link = (*link)->next;
+			}
+			else
+				link = &(*link)->next;
+		}
+	}
+	AuReleaseSpinlock(channelLock);
+}
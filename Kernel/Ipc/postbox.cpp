@@ -38,6 +38,7 @@
 #include <Fs\dev\devfs.h>
 #include <Hal\x86_64_hal.h>
 #include <Hal\serial.h>
+#include <autrace.h>
 
 /*
  * NOTE: PostBoxIPCManager is aurora's main communication manager between
@@ -45,86 +46,149 @@
  * communicate with user processes and kernel through PostBoxIPCManager
  */
 
-PostBox * firstBox;
-PostBox * lastBox;
+PostBox* postBoxTable[POSTBOX_HASH_SIZE];
 bool _PostBoxRootCreated;
 
-void PostBoxAdvanceIndex(PostBox* box) {
-	if (box->full)
-		box->tailIdx = (box->tailIdx + 1) % box->size;
-
-	box->headIdx = (box->headIdx + 1) % box->size;
-	box->full = (box->headIdx == box->tailIdx);
+/*
+ * PostBoxFind -- find a postbox by its owner id
+ * @param id -- owner id
+ */
+PostBox* PostBoxFind(uint32_t id) {
+	for (PostBox* box = postBoxTable[id % POSTBOX_HASH_SIZE]; box != NULL; box = box->hashNext) {
+		if (box->ownerID == id)
+			return box;
+	}
+	return NULL;
 }
 
-void PostBoxRetreat(PostBox* box) {
-	box->full = false;
-	box->tailIdx = (box->tailIdx + 1) % box->size;
+/*
+ * PostBoxLanePut -- put an event to a lane, if coalescing
+ * is requested and the newest pending event was also put
+ * as coalescable by the same sender with same type and
+ * target handle (dword4), it is overwritten instead
+ * @param box -- Pointer to postbox
+ * @param laneIdx -- lane number
+ * @param event -- event to put
+ * @param coalesce -- event supersedes older one
+ */
+bool PostBoxLanePut(PostBox* box, int laneIdx, PostEvent* event, bool coalesce) {
+	PostBoxLane* lane = &box->lanes[laneIdx];
+	box->stats.posted++;
+	if (coalesce && lane->count > 0) {
+		uint16_t newest = (lane->headIdx + lane->size - 1) % lane->size;
+		PostEvent* last = &lane->events[newest];
+		if (lane->lastCoalesce == newest && last->type == event->type && last->from_id == event->from_id &&
+			last->dword4 == event->dword4) {
+			memcpy(last, event, sizeof(PostEvent));
+			box->stats.coalesced++;
+			return true;
+		}
+	}
+
+	if (lane->count == lane->size) {
+		box->stats.dropped[laneIdx]++;
+		return false;
+	}
+
+	memcpy(&lane->events[lane->headIdx], event, sizeof(PostEvent));
+	lane->lastCoalesce = coalesce ? lane->headIdx : -1;
+	lane->headIdx = (lane->headIdx + 1) % lane->size;
+	lane->count++;
+	if (lane->count > box->stats.highWater[laneIdx])
+		box->stats.highWater[laneIdx] = lane->count;
+	return true;
 }
 
-bool IsPostBoxEmpty(PostBox* box) {
-	return (!box->full && (box->headIdx == box->tailIdx));
+/*
+ * PostBoxGetOne -- take oldest event from highest
+ * priority non-empty lane
+ * @param box -- Pointer to postbox
+ * @param event -- memory area to copy the event
+ */
+bool PostBoxGetOne(PostBox* box, PostEvent* event) {
+	for (int i = 0; i < POSTBOX_LANES; i++) {
+		PostBoxLane* lane = &box->lanes[i];
+		if (lane->count == 0)
+			continue;
+		memcpy(event, &lane->events[lane->tailIdx], sizeof(PostEvent));
+		if (lane->lastCoalesce == lane->tailIdx)
+			lane->lastCoalesce = -1;
+		lane->tailIdx = (lane->tailIdx + 1) % lane->size;
+		lane->count--;
+		box->stats.delivered++;
+		return true;
+	}
+	return false;
 }
 
-bool IsPostBoxFull(PostBox* box) {
-	return box->full;
+/*
+ * PostBoxWakeOwner -- unblock the thread waiting on
+ * a postbox
+ * @param box -- Pointer to postbox
+ */
+void PostBoxWakeOwner(PostBox* box) {
+	if (box->owner != NULL && box->owner->state == THREAD_STATE_BLOCKED)
+		AuUnblockThread(box->owner);
 }
 
 /*
  * PostBoxCreate -- creates a postbox
  * @param root -- is this post box root ?
- * @param tid -- thread id
+ * @param owner -- thread owning the postbox
  */
-void PostBoxCreate(bool root, uint16_t tid) {
+void PostBoxCreate(bool root, AuThread* owner) {
+	uint32_t id = owner->id;
+	if (root && !_PostBoxRootCreated)
+		id = POSTBOX_ROOT_ID;
+
+	/* one postbox per owner */
+	if (PostBoxFind(id))
+		return;
+
 	PostBox* box = (PostBox*)kmalloc(sizeof(PostBox));
 	memset(box, 0, sizeof(PostBox));
-	box->address = (uint64_t*)P2V((size_t)AuPmmngrAlloc());
-	memset(box->address, 0, PAGE_SIZE);
+	box->ownerID = id;
+	box->owner = owner;
 
-	if (root &&  !_PostBoxRootCreated){
-		box->ownerID = POSTBOX_ROOT_ID;
-		_PostBoxRootCreated = true;
-	}
-	else {
-		box->ownerID = tid;
+	for (int i = 0; i < POSTBOX_LANES; i++) {
+		PostBoxLane* lane = &box->lanes[i];
+		void* frames = AuPmmngrAllocBlocks(POSTBOX_LANE_PAGES);
+		if (!frames) {
+			for (int j = 0; j < i; j++)
+				AuPmmngrFreeBlocks((void*)V2P((size_t)box->lanes[j].events), POSTBOX_LANE_PAGES);
+			kfree(box);
+			return;
+		}
+		lane->events = (PostEvent*)P2V((size_t)frames);
+		memset(lane->events, 0, POSTBOX_LANE_PAGES * PAGE_SIZE);
+		lane->size = (POSTBOX_LANE_PAGES * PAGE_SIZE) / sizeof(PostEvent);
+		lane->headIdx = 0;
+		lane->tailIdx = 0;
+		lane->count = 0;
+		lane->lastCoalesce = -1;
 	}
 
-	box->next = NULL;
-	box->prev = NULL;
-	box->headIdx = 0;
-	box->tailIdx = 0;
-	box->full = false;
-
-	box->size = PAGE_SIZE / sizeof(PostEvent);
+	if (id == POSTBOX_ROOT_ID)
+		_PostBoxRootCreated = true;
 
-	if (firstBox == NULL) {
-		firstBox = box;
-		lastBox = box;
-	}
-	else{
-		lastBox->next = box;
-		box->prev = lastBox;
-		lastBox = box;
-	}
+	int bucket = id % POSTBOX_HASH_SIZE;
+	box->hashNext = postBoxTable[bucket];
+	postBoxTable[bucket] = box;
 }
 
 void PostBoxDestroy(PostBox* box) {
-	if (firstBox == NULL)
+	PostBox** link = &postBoxTable[box->ownerID % POSTBOX_HASH_SIZE];
+	while (*link != NULL && *link != box)
+		link = &(*link)->hashNext;
+	if (*link == NULL)
 		return;
+	*link = box->hashNext;
 
-	if (box == firstBox)
-		firstBox = firstBox->next;
-	else
-		box->prev->next = box->next;
-
-	if (box == lastBox) {
-		lastBox = box->prev;
-	}
-	else {
-		box->next->prev = box->prev;
-	}
+	if (box->ownerID == POSTBOX_ROOT_ID)
+		_PostBoxRootCreated = false;
 
-	AuPmmngrFree((void*)V2P((size_t)box->address));
+	for (int i = 0; i < POSTBOX_LANES; i++)
+		AuPmmngrFreeBlocks((void*)V2P((size_t)box->lanes[i].events), POSTBOX_LANE_PAGES);
 	kfree(box);
 }
 
@@ -133,17 +197,16 @@ void PostBoxDestroy(PostBox* box) {
  * an id
  * @param id -- id of the postbox
  */
-void PostBoxDestroyByID(uint16_t id) {
-	PostBox* destroyable = NULL;
-	for (PostBox* box = firstBox; box != NULL; box = box->next) {
-		if (box->ownerID == id){
-			destroyable = box;
-			break;
-		}
-	}
-
+void PostBoxDestroyByID(uint32_t id) {
+	PostBox* destroyable = PostBoxFind(id);
 	if (destroyable)
 		PostBoxDestroy(destroyable);
+
+	/* the root box is not keyed by its owner's thread id,
+	 * forget the owner when it goes away */
+	PostBox* root = PostBoxFind(POSTBOX_ROOT_ID);
+	if (root && root->owner && root->owner->id == id)
+		root->owner = NULL;
 	return;
 }
 
@@ -152,24 +215,51 @@ void PostBoxDestroyByID(uint16_t id) {
  * @param event -- Event to put
  */
 void PostBoxPutEvent(PostEvent* event) {
-	uint16_t owner_id = event->to_id;
-	for (PostBox* box = firstBox; box != NULL; box = box->next) {
-		if (box->ownerID == owner_id){
-			if (!IsPostBoxFull(box)) {
-				memcpy(&box->address[box->headIdx], event, sizeof(PostEvent));
-				PostBoxAdvanceIndex(box);
-			}
-			break;
+	PostBoxPutEvents(event, 1, POSTBOX_LANE_NORMAL, 0);
+}
+
+/*
+ * PostBoxPutEvents -- put a batch of events to post boxes,
+ * owners are woken once after the batch
+ * @param events -- array of events
+ * @param count -- number of events
+ * @param lane -- priority lane
+ * @param flags -- put flags
+ * @return number of events queued
+ */
+int PostBoxPutEvents(PostEvent* events, uint32_t count, uint8_t lane, uint8_t flags) {
+	if (lane >= POSTBOX_LANES)
+		lane = POSTBOX_LANE_NORMAL;
+	int queued = 0;
+	PostBox* box = NULL;
+	for (uint32_t i = 0; i < count; i++) {
+		PostEvent* event = &events[i];
+		if (!box || box->ownerID != event->to_id) {
+			if (box)
+				PostBoxWakeOwner(box);
+			box = PostBoxFind(event->to_id);
 		}
-	}
 
-	AuThread* thread = AuThreadFindByID(owner_id);
-	if (!thread)
-		thread = AuThreadFindByIDBlockList(owner_id);
-	if (thread != NULL && thread->state == THREAD_STATE_BLOCKED)
-		AuUnblockThread(thread);
+		if (!box) {
+			/* no postbox yet, the owner may still be waiting
+			 * for it to get created */
+			AuThread* thread = AuThreadFindByID(event->to_id);
+			if (!thread)
+				thread = AuThreadFindByIDBlockList(event->to_id);
+			if (thread != NULL && thread->state == THREAD_STATE_BLOCKED)
+				AuUnblockThread(thread);
+			continue;
+		}
 
-	return;
+		if (PostBoxLanePut(box, lane, event, (flags & POSTBOX_FLAG_COALESCE))) {
+			AU_TRACE(TRACE_EVENT_POSTBOX_SEND, event->to_id, event->type);
+			queued++;
+		}
+	}
+
+	if (box)
+		PostBoxWakeOwner(box);
+	return queued;
 }
 
 /*
@@ -180,26 +270,37 @@ void PostBoxPutEvent(PostEvent* event) {
  * @param curr_thread -- Pointer to current thread
  */
 int PostBoxGetEvent(PostEvent* event, bool root, AuThread* curr_thread) {
-	int ret_code = POSTBOX_NO_EVENT;
-	uint16_t owner_id = 0;
+	if (PostBoxGetEvents(event, 1, root, curr_thread) == 0)
+		return POSTBOX_NO_EVENT;
+	return 1;
+}
+
+/*
+ * PostBoxGetEvents -- get a batch of events, input lane
+ * first
+ * @param events -- array to fill
+ * @param count -- capacity of the array
+ * @param root -- is this post box is root
+ * @param curr_thread -- Pointer to current thread
+ * @return number of events copied
+ */
+int PostBoxGetEvents(PostEvent* events, uint32_t count, bool root, AuThread* curr_thread) {
+	uint32_t owner_id = 0;
 	if (root)
 		owner_id = POSTBOX_ROOT_ID;
 	else
 		owner_id = curr_thread->id;
 
-	for (PostBox* box = firstBox; box != NULL; box = box->next) {
-		if (box->ownerID == owner_id) {
-			if (!IsPostBoxEmpty(box)) {
-				memcpy(event, &box->address[box->tailIdx], sizeof(PostEvent));
-				memset(&box->address[box->tailIdx], 0, sizeof(PostEvent));
-				PostBoxRetreat(box);
-				ret_code = 1;
-			}
-			break;
-		}
-	}
+	PostBox* box = PostBoxFind(owner_id);
+	if (!box)
+		return 0;
+	if (root && box->owner == NULL)
+		box->owner = curr_thread;
 
-	return ret_code;
+	uint32_t got = 0;
+	while (got < count && PostBoxGetOne(box, &events[got]))
+		got++;
+	return got;
 }
 
 /*
@@ -218,11 +319,11 @@ int PostBoxIOControl(AuVFSNode* file, int code, void* arg) {
 	switch (code) {
 	case POSTBOX_CREATE: {
 							
-							 PostBoxCreate(false, curr_thr->id);
+							 PostBoxCreate(false, curr_thr);
 							 break;
 	}
 	case POSTBOX_CREATE_ROOT: {
-								  PostBoxCreate(true, curr_thr->id);
+								  PostBoxCreate(true, curr_thr);
 								  break;
 	}
 	case POSTBOX_DESTROY: {
@@ -245,6 +346,35 @@ int PostBoxIOControl(AuVFSNode* file, int code, void* arg) {
 									 ret_code = PostBoxGetEvent(e, true, curr_thr);
 									 break;
 	}
+	case POSTBOX_PUT_EVENTS: {
+								 PostBoxPutRequest* req = (PostBoxPutRequest*)arg;
+								 if (!req || !req->events)
+									 return -1;
+								 ret_code = PostBoxPutEvents(req->events, req->count, req->lane, req->flags);
+								 break;
+	}
+	case POSTBOX_GET_EVENTS: {
+								 PostBoxGetRequest* req = (PostBoxGetRequest*)arg;
+								 if (!req || !req->events)
+									 return -1;
+								 ret_code = PostBoxGetEvents(req->events, req->count, req->root, curr_thr);
+								 if (ret_code == 0)
+									 ret_code = POSTBOX_NO_EVENT;
+								 break;
+	}
+	case POSTBOX_GET_STATS: {
+								PostBoxStats* stats = (PostBoxStats*)arg;
+								PostBox* box = PostBoxFind(curr_thr->id);
+								if (!box) {
+									box = PostBoxFind(POSTBOX_ROOT_ID);
+									if (box && box->owner != curr_thr)
+										box = NULL;
+								}
+								if (!box || !stats)
+									return -1;
+								memcpy(stats, &box->stats, sizeof(PostBoxStats));
+								break;
+	}
 	}
 
 	return ret_code;
@@ -255,8 +385,8 @@ int PostBoxIOControl(AuVFSNode* file, int code, void* arg) {
  * the post box ipc manager
  */
 void AuIPCPostBoxInitialise() {
-	firstBox = NULL;
-	lastBox = NULL;
+	for (int i = 0; i < POSTBOX_HASH_SIZE; i++)
+		postBoxTable[i] = NULL;
 	
 	/* create the postbox file */
 	AuVFSNode* dev = AuVFSFind("/dev");
@@ -239,7 +239,6 @@ void* kmalloc(unsigned int size) {
 			if (meta->size == size) {
 				meta->magic = MAGIC_USED;
 				uint8_t* addr = (uint8_t*)meta;
-				SeTextOut("Accurate memory found returning -> %x \r\n", addr);
 				ret = ((uint8_t*)addr + sizeof(meta_data_t));
 				break;
 			}
@@ -297,7 +296,6 @@ void merge_next(meta_data_t *meta) {
 	
 
 	meta->size += meta->next->size + sizeof(meta_data_t);
-	SeTextOut("Meta merge_next sz -> %d \r\n", meta->size);
 
 	if (meta->next->next != NULL)
 		meta->next->next->prev = meta;
@@ -326,9 +324,7 @@ void merge_prev(meta_data_t* meta) {
 			return;
 		}
 		if (meta->prev->magic == MAGIC_FREE){
-			SeTextOut("Meta->prev->sz = %d , meta sz -> %d \r\n", meta->prev->size, meta->size);
 			meta->prev->size += meta->size + sizeof(meta_data_t);
-			SeTextOut("Meta->prev->sz after = %d \r\n", meta->prev->size);
 			if (last_block == meta){
 				last_block = meta->prev;
 				SeTextOut("Last block sz -> %d \r\n", last_block->size);
@@ -336,7 +332,6 @@ void merge_prev(meta_data_t* meta) {
 				for (;;);
 			}
 
-			SeTextOut("Meta prev sz -> %d \r\n", meta->prev->size);
 			meta->prev->next = meta->next;
 			if (meta->prev->next)
 				meta->prev->next->prev = meta->prev;
@@ -443,7 +438,7 @@ void* au_request_page(int pages) {
 * @param pages --pages -- number of pages
 */
 void au_free_page(void* ptr, int pages) {
-	AuFreePages((uint64_t)ptr, true, pages);
+	AuFreePages((uint64_t)ptr, true, (size_t)pages * PAGE_SIZE);
 }
 
 
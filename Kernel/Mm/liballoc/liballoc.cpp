@@ -586,7 +586,7 @@ void* liballoc_alloc(int pages) {
 }
 
 int liballoc_free(void* ptr, int pages) {
-	AuFreePages((uint64_t)ptr, true, pages);
+	AuFreePages((uint64_t)ptr, true, (size_t)pages * PAGE_SIZE);
 	return 0;
 }
 
@@ -33,6 +33,8 @@
 #include <Hal\serial.h>
 #include <Hal\x86_64_lowlevel.h>
 #include <_null.h>
+#include <Mm\tlb.h>
+#include <Mm\reclaim.h>
 
 
 #define PROTECTION_FLAG_READONLY  1<<0
@@ -45,28 +47,102 @@
 #define MEMMAP_FLAG_PRIVATE  1<<2
 #define MEMMAP_FLAG_DISCARD_FILE_READ 1<<3
 
+/* buckets of the mapping object table */
+#define MMAP_OBJECT_BUCKETS 64
+
+/* frame entries with this bit set hold a compressed
+ * copy of the page instead of a frame */
+#define MMAP_FRAME_COMPRESSED  1
+
 
 #pragma pack(push,1)
-/* shared memory map object */
+/* memory map object, one per mapped file, caches
+ * the pages of the file shared by every mapping
+ * of it */
 typedef struct _sh_memap_object_ {
 	char* objectName;
 	uint8_t flags;
 	uint8_t prot_flags;
-	uint64_t beginPhysicalAddr;
 	uint64_t len;  //length in bytes
 	uint16_t linkCount;
 	uint16_t ownerProc;
+	uint64_t firstBlock;
+	bool io;
+	AuVFSNode* fsys;
+	AuVFSNode* file;
+	uint64_t* frames;
+	uint16_t* refs;  //page table entries pointing at each frame
+	size_t numFrames;
+	struct _sh_memap_object_* next;
+	struct _sh_memap_object_* lruPrev;
+	struct _sh_memap_object_* lruNext;
 }AuSharedMmapObject;
 #pragma pack(pop)
 
-list_t* shmmaplist;
+static AuSharedMmapObject* shmmap_table[MMAP_OBJECT_BUCKETS];
+/* objects ordered by last fault, most recent first,
+ * reclaim starts from the tail */
+static AuSharedMmapObject* shmmap_lru_head;
+static AuSharedMmapObject* shmmap_lru_tail;
+
+/*
+ * AuSharedMmapObjectHash -- hashes an object name
+ * together with the file's first block
+ * @param name -- object name
+ * @param first_block -- first block of the file
+ */
+static uint32_t AuSharedMmapObjectHash(char* name, uint64_t first_block) {
+	uint32_t hash = 2166136261u;
+	while (*name) {
+		hash ^= (uint8_t)*name++;
+		hash *= 16777619u;
+	}
+	hash ^= (uint32_t)first_block;
+	hash *= 16777619u;
+	return hash % MMAP_OBJECT_BUCKETS;
+}
 
 /*
  * SharedMemMapListInitialise -- initialise
  * the shared memory map list
  */
 void SharedMemMapListInitialise() {
-	shmmaplist = initialize_list();
+	memset(shmmap_table, 0, sizeof(shmmap_table));
+	AuMemMapRegisterShrinkers();
+}
+
+/*
+ * AuSharedMmapObjectLRUUnlink -- takes an object off
+ * the reclaim list
+ * @param obj -- Pointer to the object
+ */
+static void AuSharedMmapObjectLRUUnlink(AuSharedMmapObject* obj) {
+	if (obj->lruPrev)
+		obj->lruPrev->lruNext = obj->lruNext;
+	else if (shmmap_lru_head == obj)
+		shmmap_lru_head = obj->lruNext;
+	if (obj->lruNext)
+		obj->lruNext->lruPrev = obj->lruPrev;
+	else if (shmmap_lru_tail == obj)
+		shmmap_lru_tail = obj->lruPrev;
+	obj->lruPrev = obj->lruNext = NULL;
+}
+
+/*
+ * AuSharedMmapObjectTouch -- moves an object to the
+ * front of the reclaim list
+ * @param obj -- Pointer to the object
+ */
+static void AuSharedMmapObjectTouch(AuSharedMmapObject* obj) {
+	if (shmmap_lru_head == obj)
+		return;
+	AuSharedMmapObjectLRUUnlink(obj);
+	obj->lruNext = shmmap_lru_head;
+	if (shmmap_lru_head)
+		shmmap_lru_head->lruPrev = obj;
+	shmmap_lru_head = obj;
+	if (!shmmap_lru_tail)
+		shmmap_lru_tail = obj;
 }
 
 /*
@@ -75,35 +151,173 @@ void SharedMemMapListInitialise() {
 AuSharedMmapObject* AuCreateSharedMmapObject(char* name) {
 	AuSharedMmapObject* obj = (AuSharedMmapObject*)kmalloc(sizeof(AuSharedMmapObject));
 	memset(obj, 0, sizeof(AuSharedMmapObject));
-	obj->objectName = (char*)kmalloc(strlen(name));
+	obj->objectName = (char*)kmalloc(strlen(name) + 1);
 	strcpy(obj->objectName, name);
-	obj->linkCount += 1;
 	return obj;
 }
 
 void AuAddSharedMmapObject(AuSharedMmapObject* obj) {
-	list_add(shmmaplist, obj);
+	uint32_t bucket = AuSharedMmapObjectHash(obj->objectName, obj->firstBlock);
+	obj->next = shmmap_table[bucket];
+	shmmap_table[bucket] = obj;
+	AuSharedMmapObjectTouch(obj);
 }
 
 void AuRemoveSharedMmapObject(AuSharedMmapObject* obj) {
-	for (int i = 0; i < shmmaplist->pointer; i++){
-		AuSharedMmapObject* obj_ = (AuSharedMmapObject*)list_get_at(shmmaplist, i);
-		if (obj_ == obj)
-			list_remove(shmmaplist, i);
+	uint32_t bucket = AuSharedMmapObjectHash(obj->objectName, obj->firstBlock);
+	AuSharedMmapObject** link = &shmmap_table[bucket];
+	while (*link) {
+		if (*link == obj) {
+			*link = obj->next;
+			break;
+		}
+		link = &(*link)->next;
+	}
+	AuSharedMmapObjectLRUUnlink(obj);
+
+	for (size_t i = 0; i < obj->numFrames; i++) {
+		if (!obj->frames[i])
+			continue;
+#ifdef MM_COMPRESSED_SWAP
+		if (obj->frames[i] & MMAP_FRAME_COMPRESSED) {
+			AuReclaimFreeCompressed((void*)(obj->frames[i] & ~MMAP_FRAME_COMPRESSED));
+			continue;
+		}
+#endif
+		AuPmmngrFree((void*)obj->frames[i]);
 	}
+	if (obj->frames)
+		kfree(obj->frames);
+	if (obj->refs)
+		kfree(obj->refs);
+	if (obj->file)
+		kfree(obj->file);
 	kfree(obj->objectName);
 	kfree(obj);
 }
 
-AuSharedMmapObject* AuSharedMmapObjectFindByName(char* name) {
-	for (int i = 0; i < shmmaplist->pointer; i++){
-		AuSharedMmapObject* obj_ = (AuSharedMmapObject*)list_get_at(shmmaplist, i);
-		if (strcmp(obj_->objectName, name) == 0)
+AuSharedMmapObject* AuSharedMmapObjectFindByName(char* name, uint64_t first_block) {
+	AuSharedMmapObject* obj_ = shmmap_table[AuSharedMmapObjectHash(name, first_block)];
+	for (; obj_; obj_ = obj_->next){
+		if (obj_->firstBlock == first_block && strcmp(obj_->objectName, name) == 0)
 			return obj_;
 	}
 	return NULL;
 }
 
+/*
+ * AuSharedMmapObjectGrow -- makes room for pages
+ * up to given length
+ * @param obj -- Pointer to the object
+ * @param len -- length in bytes
+ */
+static void AuSharedMmapObjectGrow(AuSharedMmapObject* obj, uint64_t len) {
+	size_t num = PAGE_ALIGN(len) / PAGE_SIZE;
+	if (num <= obj->numFrames)
+		return;
+	uint64_t* frames = (uint64_t*)kmalloc(num * sizeof(uint64_t));
+	memset(frames, 0, num * sizeof(uint64_t));
+	uint16_t* refs = (uint16_t*)kmalloc(num * sizeof(uint16_t));
+	memset(refs, 0, num * sizeof(uint16_t));
+	if (obj->frames) {
+		memcpy(frames, obj->frames, obj->numFrames * sizeof(uint64_t));
+		memcpy(refs, obj->refs, obj->numFrames * sizeof(uint16_t));
+		kfree(obj->frames);
+		kfree(obj->refs);
+	}
+	obj->frames = frames;
+	obj->refs = refs;
+	obj->numFrames = num;
+	if (obj->len < len)
+		obj->len = len;
+}
+
+/*
+ * AuSharedMmapObjectGetPage -- returns the frame caching
+ * a page of the object, reading it from the file on
+ * first use
+ * @param obj -- Pointer to the object
+ * @param index -- page index inside the file
+ */
+static uint64_t AuSharedMmapObjectGetPage(AuSharedMmapObject* obj, size_t index) {
+	if (index >= obj->numFrames)
+		return 0;
+#ifdef MM_COMPRESSED_SWAP
+	if (obj->frames[index] & MMAP_FRAME_COMPRESSED) {
+		/* runs under memory pressure, the compressed copy
+		 * stays until a frame is available */
+		uint64_t phys = (uint64_t)AuPmmngrAlloc();
+		if (!phys)
+			return 0;
+		AuReclaimDecompressPage((void*)(obj->frames[index] & ~MMAP_FRAME_COMPRESSED), (void*)P2V(phys));
+		obj->frames[index] = phys;
+		return phys;
+	}
+#endif
+	if (obj->frames[index])
+		return obj->frames[index];
+
+	uint64_t phys = (uint64_t)AuPmmngrAlloc();
+	if (!phys)
+		return 0;
+	memset((void*)P2V(phys), 0, PAGE_SIZE);
+
+	uint64_t pos = static_cast<uint64_t>(index) * PAGE_SIZE;
+	if (obj->io && pos < obj->file->size) {
+		size_t len = obj->file->size - pos;
+		if (len > PAGE_SIZE)
+			len = PAGE_SIZE;
+		obj->file->pos = pos;
+		obj->file->current = AuVFSGetBlockFor(obj->fsys, obj->file, pos);
+		obj->file->eof = 0;
+		AuVFSNodeRead(obj->fsys, obj->file, (uint64_t*)P2V(phys), len);
+	}
+	obj->frames[index] = phys;
+	return phys;
+}
+
+/*
+ * AuSharedMmapObjectWritePage -- writes a page of the
+ * object back to its file, the file is never extended
+ * @param obj -- Pointer to the object
+ * @param index -- page index inside the file
+ * @param phys -- frame holding the data
+ */
+static void AuSharedMmapObjectWritePage(AuSharedMmapObject* obj, size_t index, uint64_t phys) {
+	uint64_t pos = static_cast<uint64_t>(index) * PAGE_SIZE;
+	if (!obj->io || pos >= obj->file->size)
+		return;
+	size_t len = obj->file->size - pos;
+	if (len > PAGE_SIZE)
+		len = PAGE_SIZE;
+	obj->file->pos = pos;
+	obj->file->current = AuVFSGetBlockFor(obj->fsys, obj->file, pos);
+	obj->file->eof = 0;
+	AuVFSNodeWrite(obj->fsys, obj->file, (uint64_t*)P2V(phys), len);
+}
+
+/*
+ * AuMemMapSetProtection -- applies protection and map
+ * flags on a virtual page
+ * @param page -- Pointer to virtual page
+ * @param prot -- protection flags
+ * @param flags -- memory map flags
+ */
+static void AuMemMapSetProtection(AuVPage* page, int prot, int flags) {
+	/* check for  protection flag */
+	if (prot & PROTECTION_FLAG_READONLY)
+		page->bits.writable = 0;
+	if (prot & PROTECTION_FLAG_NO_EXEC)
+		page->bits.nx = 1;
+	if (prot & PROTECTION_FLAG_NO_CACHE)
+		page->bits.cache_disable = 1;
+	if (prot & PROTECTION_FLAG_READONLY && prot & PROTECTION_FLAG_WRITE)
+		page->bits.writable = 0;
+
+	if (flags & MEMMAP_FLAG_COW)
+		page->bits.cow = 1;
+}
+
 /*
  * CreateMemMapping -- Create a memory mapping of just memory, file or device
  * @param address -- address from where mapping start, if null, kernel will
@@ -121,8 +335,9 @@ void* CreateMemMapping(void* address, size_t len, int prot, int flags, int fd,
 	if (!len)
 		return 0;
 
-	/* for now, memory mapping doesn't support lazy loading 
-	 * so everything works at pre-paging */
+	/* anonymous memory is pre-paged, file mappings only
+	 * record the area, their pages are faulted in from
+	 * the file on first access */
 
 	AuThread* curr_thr = AuGetCurrentThread();
 	AuProcess* proc = AuProcessFindThread(curr_thr);
@@ -133,110 +348,216 @@ void* CreateMemMapping(void* address, size_t len, int prot, int flags, int fd,
 	}
 	AuVFSNode *file = NULL;
 	AuVFSNode* fsys = NULL;
-	uint64_t startingPhysAddr = NULL;
-	bool shobj_len_increase = false;
-	bool shobj_new_create = false;
 
 	AuSharedMmapObject* shobj = NULL;
 	if (fd != -1) 
-		file = proc->fds[fd];
+		file = AuProcessGetFileNode(proc, fd);
 	
+	len = PAGE_ALIGN(len); //simply align the length
+
 	size_t lookup_addr = NULL;
 	if (!address)
-		lookup_addr = (size_t)AuGetFreePage(true, (void*)PROCESS_MMAP_ADDRESS);
+		lookup_addr = AuVMAreaFindGap(proc, PROCESS_MMAP_ADDRESS, PROCESS_BREAK_ADDRESS, len);
 	else
 		lookup_addr = (size_t)address;
-
-	len = PAGE_ALIGN(len); //simply align the length
+	if (!lookup_addr)
+		return NULL;
 
 
 	if (file) {
-		uint64_t file_block_start = 0;
+		if (offset % PAGE_SIZE)
+			return NULL;
 		fsys = AuVFSFind("/");
 		if (!fsys && fd != -1)
 			return 0;
-		if (!(file->flags & FS_FLAG_DEVICE)) {
-			file_block_start = AuVFSGetBlockFor(fsys, file, offset);
-			file->current = file_block_start;
-		}
 
-		if (flags & MEMMAP_FLAG_SHARED) {
-			shobj = AuSharedMmapObjectFindByName(file->filename);
-			/* no shobject found with specified name, so we create
-			 * new one */
-			if (!shobj) {
-				shobj = AuCreateSharedMmapObject(file->filename);
-				shobj->flags = flags;
-				shobj->len = 0;
-				shobj->prot_flags = prot;
-				shobj->ownerProc = proc->proc_id;
-				AuAddSharedMmapObject(shobj);
-				shobj_new_create = true;
-			}
-			/* okay, already there is an shared object with this
-			 * particular name, so check further
-			 */
-			if (shobj) {
-				/* firstly, check if the owner process is accessing,
-				 * then simply we work on the shared object
-				 */
-				if (shobj->ownerProc == proc->proc_id) {
-					shobj_len_increase = true;
-				}
-				else {
-					/* we need to map that object here*/
-					startingPhysAddr = shobj->beginPhysicalAddr;
-				}
-			}
+		/* device and discard mappings never touch the file,
+		 * every mapping of an object must agree on it */
+		bool io = !(file->flags & FS_FLAG_DEVICE) && !(flags & MEMMAP_FLAG_DISCARD_FILE_READ);
+		shobj = AuSharedMmapObjectFindByName(file->filename, file->first_block);
+		if (shobj && shobj->io != io)
+			return NULL;
+		/* no object found for this file, so we create
+		 * new one */
+		if (!shobj) {
+			shobj = AuCreateSharedMmapObject(file->filename);
+			shobj->flags = flags;
+			shobj->prot_flags = prot;
+			shobj->ownerProc = proc->proc_id;
+			shobj->firstBlock = file->first_block;
+			shobj->fsys = fsys;
+			/* keep a private copy of the node, the descriptor
+			 * may get closed while mappings are alive */
+			shobj->file = (AuVFSNode*)kmalloc(sizeof(AuVFSNode));
+			memcpy(shobj->file, file, sizeof(AuVFSNode));
+			shobj->io = io;
+			AuAddSharedMmapObject(shobj);
+			SeTextOut("SHOBJ newly created -> %s \r\n", shobj->objectName);
 		}
+		AuSharedMmapObjectGrow(shobj, offset + len);
 	}
 
-	
+	for (int i = 0; !shobj && i < len / PAGE_SIZE; i++) {
+		uint64_t phys = (uint64_t)AuPmmngrAlloc();
+		AuMapPage(phys, lookup_addr + static_cast<int64_t>(i) * PAGE_SIZE, X86_64_PAGING_USER);
+		AuVPage *page = AuVmmngrGetPage(lookup_addr + static_cast<int64_t>(i) * PAGE_SIZE, NULL, VIRT_GETPAGE_ONLY_RET);
+		AuMemMapSetProtection(page, prot, flags);
+	}
 
-	for (int i = 0; i < len / PAGE_SIZE; i++) {
-		uint64_t phys = 0;
-		if (startingPhysAddr && (flags & MEMMAP_FLAG_SHARED))
-			phys = startingPhysAddr + static_cast<int64_t>(i) * PAGE_SIZE;
-		else
-			phys = (uint64_t)AuPmmngrAlloc();
+	/* contiguous runs may collapse into large pages */
+	if (!shobj)
+		AuVmmngrPromoteRange(proc->cr3, lookup_addr, len);
+
+	uint8_t vmprot = VM_PRESENT;
+	if (!(prot & PROTECTION_FLAG_READONLY))
+		vmprot |= VM_WRITE;
+	if (!(prot & PROTECTION_FLAG_NO_EXEC))
+		vmprot |= VM_EXEC;
+	if (flags & MEMMAP_FLAG_SHARED)
+		vmprot |= VM_SHARED;
+	AuVMArea* area = AuVMAreaMap(proc, lookup_addr, len, vmprot, VM_TYPE_MMAP, shobj ? shobj->file : NULL);
+	if (!area && shobj) {
+		/* overlaps another area, an object created for
+		 * this mapping has nobody else */
+		if (shobj->linkCount == 0)
+			AuRemoveSharedMmapObject(shobj);
+		return NULL;
+	}
+	if (area && shobj) {
+		area->mapobj = shobj;
+		area->file_offset = offset;
+		shobj->linkCount++;
+	}
 
-		if (startingPhysAddr == 0 && shobj_new_create)
-			startingPhysAddr = phys;
+	proc->proc_mmap_len += len;
+	return (void*)lookup_addr;
+}
 
-		if (file && !(flags & MEMMAP_FLAG_DISCARD_FILE_READ)){
-			SeTextOut("mmap reading file \r\n");
-			AuVFSNodeReadBlock(fsys, file, (uint64_t*)phys);
+/*
+ * AuMemMapHandleFault -- resolves a page fault inside a
+ * file backed mapping, shared mappings map the cached
+ * page itself, private ones map it read only and take a
+ * copy on first write
+ * @param proc -- Pointer to process
+ * @param vaddr -- faulting address
+ * @param error -- page fault error code
+ */
+bool AuMemMapHandleFault(AuProcess* proc, uint64_t vaddr, uint64_t error) {
+	AuVMArea* area = AuVMAreaGet(proc, vaddr);
+	if (!area || !area->mapobj)
+		return false;
+
+	bool present = error & 0x1;
+	bool write = error & 0x2;
+	if (write && !(area->prot_flags & VM_WRITE))
+		return false;
+
+	AuSharedMmapObject* obj = area->mapobj;
+	uint64_t page_addr = VIRT_ADDR_ALIGN(vaddr);
+	size_t index = (area->file_offset + (page_addr - area->start)) / PAGE_SIZE;
+	uint64_t cached = AuSharedMmapObjectGetPage(obj, index);
+	if (!cached)
+		return false;
+	AuSharedMmapObjectTouch(obj);
+	/* pinned so that reclaim from the allocations below
+	 * leaves it alone, the pin becomes the mapping's
+	 * reference when the cached page itself is mapped */
+	obj->refs[index]++;
+
+	bool shared = area->prot_flags & VM_SHARED;
+	AuVPage* page = NULL;
+	if (present) {
+		/* only copy-on-write of a private page is legal here */
+		page = AuVmmngrGetEntry(proc->cr3, page_addr);
+		if (!page || shared || !page->bits.cow) {
+			obj->refs[index]--;
+			return false;
 		}
-		AuMapPage(phys, lookup_addr + static_cast<int64_t>(i) * PAGE_SIZE, X86_64_PAGING_USER);
-		AuVPage *page = AuVmmngrGetPage(lookup_addr + static_cast<int64_t>(i) * PAGE_SIZE, NULL, VIRT_GETPAGE_ONLY_RET);
+		uint64_t copy = (uint64_t)AuPmmngrAlloc();
+		if (!copy) {
+			obj->refs[index]--;
+			return false;
+		}
+		memcpy((void*)P2V(copy), (void*)P2V(cached), PAGE_SIZE);
+		/* drop both the pin and the reference held by
+		 * the read only mapping */
+		obj->refs[index]--;
+		if ((static_cast<uint64_t>(page->bits.page) << PAGE_SHIFT) == cached && obj->refs[index])
+			obj->refs[index]--;
+		page->bits.page = copy >> PAGE_SHIFT;
+		page->bits.cow = 0;
+		page->bits.writable = 1;
+		flush_tlb((void*)page_addr);
+		return true;
+	}
 
-		/* check for  protection flag */
-		if (prot & PROTECTION_FLAG_READONLY)
-			page->bits.writable = 0;
-		if (prot & PROTECTION_FLAG_NO_EXEC)
-			page->bits.nx = 1;
-		if (prot & PROTECTION_FLAG_NO_CACHE)
-			page->bits.cache_disable = 1;
-		if (prot & PROTECTION_FLAG_READONLY && prot & PROTECTION_FLAG_WRITE)
-			page->bits.writable = 0;
-
-		if (flags & MEMMAP_FLAG_COW)
-			page->bits.cow = 1;
+	uint64_t phys = cached;
+	if (!shared && write) {
+		phys = (uint64_t)AuPmmngrAlloc();
+		obj->refs[index]--;
+		if (!phys)
+			return false;
+		memcpy((void*)P2V(phys), (void*)P2V(cached), PAGE_SIZE);
+	}
+	AuMapPage(phys, page_addr, X86_64_PAGING_USER);
+	page = AuVmmngrGetPage(page_addr, NULL, VIRT_GETPAGE_ONLY_RET);
+	if (!page) {
+		if (phys == cached)
+			obj->refs[index]--;
+		return false;
+	}
+	if (!(area->prot_flags & VM_WRITE))
+		page->bits.writable = 0;
+	if (!(area->prot_flags & VM_EXEC))
+		page->bits.nx = 1;
+	/* private pages stay read only until written */
+	if (!shared && !write && (area->prot_flags & VM_WRITE)) {
+		page->bits.writable = 0;
+		page->bits.cow = 1;
 	}
+	flush_tlb((void*)page_addr);
+	return true;
+}
 
-	/* shared bit should be handled differently */
-	if (flags & MEMMAP_FLAG_SHARED && shobj) {
-		if (shobj_new_create){
-			shobj->beginPhysicalAddr = startingPhysAddr;
-			shobj->len = len;
-			SeTextOut("SHOBJ newly created -> %s \r\n", shobj->objectName);
+/*
+ * AuMemMapSyncArea -- writes the pages of a shared file
+ * mapping that the cpu marked dirty back to the file
+ * @param proc -- Pointer to process
+ * @param area -- file backed area
+ * @param start -- start of the range inside the area
+ * @param end -- end of the range inside the area
+ * @param release -- unmap the pages as well
+ */
+static void AuMemMapSyncArea(AuProcess* proc, AuVMArea* area, size_t start, size_t end, bool release) {
+	AuSharedMmapObject* obj = area->mapobj;
+	bool shared = area->prot_flags & VM_SHARED;
+	AuTLBBatch batch;
+	AuTLBBatchInit(&batch, V2P((size_t)proc->cr3));
+
+	for (size_t addr = start; addr < end; addr += PAGE_SIZE) {
+		AuVPage* page = AuVmmngrGetEntry(proc->cr3, addr);
+		if (!page || !page->bits.present)
+			continue;
+		size_t index = (area->file_offset + (addr - area->start)) / PAGE_SIZE;
+		uint64_t phys = static_cast<uint64_t>(page->bits.page) << PAGE_SHIFT;
+		uint64_t cached = index < obj->numFrames ? obj->frames[index] : 0;
+
+		if (shared && page->bits.dirty) {
+			AuSharedMmapObjectWritePage(obj, index, phys);
+			page->bits.dirty = 0;
+			if (!release)
+				AuTLBBatchAdd(&batch, addr, 0);
+		}
+		if (release) {
+			if (phys == cached && obj->refs[index])
+				obj->refs[index]--;
+			page->raw = 0;
+			/* private copies go away, cached pages stay
+			 * with the object */
+			AuTLBBatchAdd(&batch, addr, phys != cached ? phys : 0);
 		}
-		if (shobj_len_increase)
-			shobj->len += len;
 	}
-
-	proc->proc_mmap_len += len;
-	return (void*)lookup_addr;
+	AuTLBBatchFlush(&batch);
 }
 
 /*
@@ -261,26 +582,29 @@ void MemMapDirty(void* startingVaddr, size_t len, int flags, int prot) {
 	uint64_t startAddr = (uint64_t)startingVaddr;
 	if (prot != 0) {
 		for (int i = 0; i < len / PAGE_SIZE; i++) {
-			AuVPage* page = AuVmmngrGetPage(startAddr + static_cast<int64_t>(i) * PAGE_SIZE, NULL, VIRT_GETPAGE_ONLY_RET);
-
-			/* check for  protection flag */
-			if (prot & PROTECTION_FLAG_READONLY)
-				page->bits.writable = 0;
-			if (prot & PROTECTION_FLAG_NO_EXEC)
-				page->bits.nx = 1;
-			if (prot & PROTECTION_FLAG_NO_CACHE)
-				page->bits.cache_disable = 1;
-			if (prot & PROTECTION_FLAG_READONLY && prot & PROTECTION_FLAG_WRITE)
-				page->bits.writable = 0;
-
-			if (flags & MEMMAP_FLAG_COW)
-				page->bits.cow = 1;
+			AuVPage* page = AuVmmngrGetEntry(proc->cr3, startAddr + static_cast<int64_t>(i) * PAGE_SIZE);
+			if (!page || !page->bits.present)
+				continue;
+			AuMemMapSetProtection(page, prot, flags);
+		}
+	}
+
+	/* shared file mappings write back the pages
+	 * the cpu has marked dirty */
+	AuVMArea* area = AuVMAreaFindFirst(proc, startAddr, startAddr + len);
+	while (area) {
+		if (area->mapobj) {
+			size_t s = area->start > startAddr ? area->start : startAddr;
+			size_t e = area->end < startAddr + len ? area->end : startAddr + len;
+			AuMemMapSyncArea(proc, area, s, e, false);
 		}
+		area = AuVMAreaFindFirst(proc, area->end, startAddr + len);
 	}
+
 	if (!AuVMAreaGet(proc, (size_t)startingVaddr)) {
-		AuVMArea* area = AuVMAreaCreate((size_t)startingVaddr, ((uint64_t)startingVaddr + len), 0, len, VM_EXEC);
-		list_add(proc->vmareas, area);
-		SeTextOut("VMArea added for %s : %x-%x \r\n", proc->name, area->start, area->end);
+		AuVMArea* area = AuVMAreaMap(proc, (size_t)startingVaddr, len, VM_PRESENT | VM_EXEC, VM_TYPE_TEXT, NULL);
+		if (area)
+			SeTextOut("VMArea added for %s : %x-%x \r\n", proc->name, area->start, area->end);
 	}
 }
 
@@ -295,20 +619,178 @@ void UnmapMemMapping(void* address, size_t len) {
 	if (!len)
 		return;
 
+	AuThread* curr_thr = AuGetCurrentThread();
+	AuProcess* proc = AuProcessFindThread(curr_thr);
+	if (!proc) {
+		proc = AuProcessFindSubThread(curr_thr);
+		if (!proc)
+			return;
+	}
+	/* kernel is still moving data through this range */
+	if (AuVMAreaPinned(proc, (size_t)address, len))
+		return;
+	AuMemMapUnmap(proc, address, len);
+}
+
+/*
+ * AuMemMapUnmap -- unmaps a memory mapping of given
+ * process
+ * @param proc -- Pointer to process
+ * @param address -- address from where mapping starts
+ * @param len -- length of the mapping
+ */
+void AuMemMapUnmap(AuProcess* proc, void* address, size_t len) {
+	if (!len)
+		return;
+
 	//SeTextOut("MemUnmap len -> %d \r\n", len);
 	len = PAGE_ALIGN(len); //simply align the length
 	//SeTextOut("Mem Unmap len aligned -> %d \r\n", len);
-	uint64_t addr = (uint64_t)address;
-	for (int i = 0; i < len / PAGE_SIZE; i++) {
-		AuVPage* page = AuVmmngrGetPage(addr + static_cast<int64_t>(i) * PAGE_SIZE, VIRT_GETPAGE_ONLY_RET, VIRT_GETPAGE_ONLY_RET);
-		if (page) {
-			uint64_t phys = page->bits.page << PAGE_SHIFT;
-			if (phys){
-				AuPmmngrFree((void*)phys);
+	size_t start = (size_t)address;
+	size_t end = start + len;
+
+	/* file backed areas write back their dirty pages and
+	 * hand the cached ones back to the object */
+	AuVMArea* area = AuVMAreaFindFirst(proc, start, end);
+	while (area) {
+		AuSharedMmapObject* obj = area->mapobj;
+		if (obj) {
+			size_t s = area->start > start ? area->start : start;
+			size_t e = area->end < end ? area->end : end;
+			AuMemMapSyncArea(proc, area, s, e, true);
+			if (area->start >= start && area->end <= end) {
+				/* the last mapping of a file drops its object */
+				if (--obj->linkCount == 0)
+					AuRemoveSharedMmapObject(obj);
 			}
-			page->bits.page = 0;
-			page->bits.present = 0;
+			else if (area->start < start && area->end > end)
+				obj->linkCount++;
+		}
+		area = AuVMAreaFindFirst(proc, area->end, end);
+	}
+
+	AuVmmngrUnmapRange(proc->cr3, start, len, VMMNGR_UNMAP_FREE_PHYSICAL);
+
+	AuVMAreaUnmap(proc, start, len);
+	if (proc->proc_mmap_len >= len)
+		proc->proc_mmap_len -= len;
+}
+
+/*
+ * AuMemMapReclaimable -- true if a cached page can be
+ * dropped and read again from its file, pages past the
+ * end of file only live in memory
+ * @param obj -- Pointer to the object
+ * @param index -- page index inside the file
+ */
+static bool AuMemMapReclaimable(AuSharedMmapObject* obj, size_t index) {
+	if (!obj->io || obj->refs[index] || !obj->frames[index])
+		return false;
+	if (obj->frames[index] & MMAP_FRAME_COMPRESSED)
+		return false;
+	return static_cast<uint64_t>(index) * PAGE_SIZE < obj->file->size;
+}
+
+/*
+ * AuMemMapCacheCount -- number of unmapped file pages
+ * that can be dropped
+ * @param shrinker -- unused
+ */
+static size_t AuMemMapCacheCount(AuShrinker* shrinker) {
+	size_t count = 0;
+	for (AuSharedMmapObject* obj = shmmap_lru_tail; obj; obj = obj->lruPrev) {
+		for (size_t i = 0; i < obj->numFrames; i++)
+			if (AuMemMapReclaimable(obj, i))
+				count++;
+	}
+	return count;
+}
+
+/*
+ * AuMemMapCacheScan -- drops unmapped file pages from
+ * the least recently faulted objects, they are read
+ * again from the file on next fault
+ * @param shrinker -- unused
+ * @param nr -- number of pages wanted
+ */
+static size_t AuMemMapCacheScan(AuShrinker* shrinker, size_t nr) {
+	size_t freed = 0;
+	for (AuSharedMmapObject* obj = shmmap_lru_tail; obj && freed < nr; obj = obj->lruPrev) {
+		for (size_t i = 0; i < obj->numFrames && freed < nr; i++) {
+			if (!AuMemMapReclaimable(obj, i))
+				continue;
+			AuPmmngrFreeCold((void*)obj->frames[i]);
+			obj->frames[i] = 0;
+			freed++;
 		}
 	}
+	return freed;
+}
+
+static AuShrinker mmap_cache_shrinker = { "pagecache", AuMemMapCacheCount, AuMemMapCacheScan, SHRINKER_FLAG_DIRECT };
 
-}
\ No newline at end of file
+#ifdef MM_COMPRESSED_SWAP
+/*
+ * AuMemMapCompressible -- true if a page has no file
+ * behind it and nothing maps it
+ * @param obj -- Pointer to the object
+ * @param index -- page index inside the file
+ */
+static bool AuMemMapCompressible(AuSharedMmapObject* obj, size_t index) {
+	if (obj->io || obj->refs[index] || !obj->frames[index])
+		return false;
+	return !(obj->frames[index] & MMAP_FRAME_COMPRESSED);
+}
+
+/*
+ * AuMemMapCompressCount -- number of unmapped memory
+ * only pages that could be compressed
+ * @param shrinker -- unused
+ */
+static size_t AuMemMapCompressCount(AuShrinker* shrinker) {
+	size_t count = 0;
+	for (AuSharedMmapObject* obj = shmmap_lru_tail; obj; obj = obj->lruPrev) {
+		for (size_t i = 0; i < obj->numFrames; i++)
+			if (AuMemMapCompressible(obj, i))
+				count++;
+	}
+	return count;
+}
+
+/*
+ * AuMemMapCompressScan -- replaces unmapped memory only
+ * pages by compressed copies, pages that do not
+ * compress well stay resident
+ * @param shrinker -- unused
+ * @param nr -- number of pages wanted
+ */
+static size_t AuMemMapCompressScan(AuShrinker* shrinker, size_t nr) {
+	size_t freed = 0;
+	for (AuSharedMmapObject* obj = shmmap_lru_tail; obj && freed < nr; obj = obj->lruPrev) {
+		for (size_t i = 0; i < obj->numFrames && freed < nr; i++) {
+			if (!AuMemMapCompressible(obj, i))
+				continue;
+			void* handle = AuReclaimCompressPage((void*)P2V(obj->frames[i]));
+			if (!handle)
+				continue;
+			AuPmmngrFreeCold((void*)obj->frames[i]);
+			obj->frames[i] = (uint64_t)handle | MMAP_FRAME_COMPRESSED;
+			freed++;
+		}
+	}
+	return freed;
+}
+
+static AuShrinker mmap_compress_shrinker = { "zpage", AuMemMapCompressCount, AuMemMapCompressScan, 0 };
+#endif
+
+/*
+ * AuMemMapRegisterShrinkers -- hands the mapping page
+ * cache over to reclaim
+ */
+void AuMemMapRegisterShrinkers() {
+	AuRegisterShrinker(&mmap_cache_shrinker);
+#ifdef MM_COMPRESSED_SWAP
+	AuRegisterShrinker(&mmap_compress_shrinker);
+#endif
+}
@@ -36,16 +36,56 @@
 #include <string.h>
 #include <Hal/serial.h>
 #include <stdint.h>
+#include <_null.h>
+#include <Hal/pcpu.h>
+#include <Sync/spinlock.h>
+#include <Mm/reclaim.h>
+
+#define PMM_PCP_MAX_CPUS  8
+/* frames each cpu can hold, refill and drain move
+ * PMM_PCP_BATCH frames at a time under the global
+ * lock */
+#define PMM_PCP_SIZE   64
+#define PMM_PCP_BATCH  16
+#define PMM_PCP_HIGH   48
+#define RFLAGS_IF  (1<<9)
+
+#define PMM_DMA32_LIMIT  (0x100000000ULL / 4096)
+
+/*
+ * AuPmmPCP -- per cpu frame cache, kept as a ring of
+ * frame addresses, hot frames are taken and returned
+ * at the front, cold frames go to the back and are
+ * the first to be drained
+ */
+typedef struct _pmm_pcp_ {
+	uint64_t frames[PMM_PCP_SIZE];
+	uint32_t first;
+	uint32_t count;
+}AuPmmPCP;
 
 uint64_t _FreeMemory;
 uint64_t _ReservedMemory;
 uint64_t _UsedMemory;
-uint64_t _RamBitmapIndex;
 uint64_t _TotalRam;
 uint64_t _BitmapSize;
 bool _HigherHalf;
 bool debugon;
 uint8_t* BitmapBuffer;
+static Spinlock pmm_lock;
+static AuPmmPCP pmm_pcp[PMM_PCP_MAX_CPUS];
+static bool _pcp_enabled;
+static uint64_t _MaxFrame;
+static AuPmmZone pmm_zones[PMM_MAX_ZONES];
+static int pmm_zone_count;
+/* proximity domain of each node, and node memory
+ * ranges reported by firmware */
+static uint32_t pmm_node_domain[PMM_MAX_NODES];
+static int pmm_node_count;
+static AuPmmNodeRange pmm_node_ranges[PMM_MAX_ZONES];
+static int pmm_range_count;
+static uint8_t pmm_cpu_node[PMM_PCP_MAX_CPUS];
+static bool _numa_reported;
 
 
 /*
@@ -56,7 +96,7 @@ uint8_t* BitmapBuffer;
 */
 void AuPmmngrInitBitmap(size_t BSize, void* Buffer) {
 	BitmapBuffer = (uint8_t*)Buffer;
-	memset(BitmapBuffer, 0, BSize * 8);
+	memset(BitmapBuffer, 0, BSize);
 	_BitmapSize = BSize;
 }
 
@@ -103,15 +143,124 @@ void AuPmmngrLockPage(uint64_t Address) {
 }
 
 /*
-* AuPmmngrLockPage -- locks a set of pages
+* AuPmmngrBitCount -- number of set bits in a byte
+*/
+static inline int AuPmmngrBitCount(uint8_t b) {
+	int count = 0;
+	for (; b; b &= b - 1)
+		count++;
+	return count;
+}
+
+/*
+* AuPmmngrMarkRange -- mark a run of frames used or
+* free, whole bytes of the bitmap are written at once
+* @param First -- first frame index
+* @param Count -- number of frames
+* @param Used -- true to mark used
+* @return number of frames that changed state
+*/
+static uint64_t AuPmmngrMarkRange(uint64_t First, uint64_t Count, bool Used) {
+	uint64_t total = _BitmapSize * 8;
+	if (First >= total)
+		return 0;
+	if (First + Count > total)
+		Count = total - First;
+	uint64_t changed = 0;
+	uint64_t index = First;
+	uint64_t end = First + Count;
+	while (index < end && (index & 7)) {
+		if (AuPmmngrBitmapCheck(index) != Used) {
+			AuPmmngrBitmapSet(index, Used);
+			changed++;
+		}
+		index++;
+	}
+	while (index + 8 <= end) {
+		uint8_t* byte = &BitmapBuffer[index / 8];
+		int set = AuPmmngrBitCount(*byte);
+		changed += Used ? (8 - set) : set;
+		*byte = Used ? 0xFF : 0;
+		index += 8;
+	}
+	while (index < end) {
+		if (AuPmmngrBitmapCheck(index) != Used) {
+			AuPmmngrBitmapSet(index, Used);
+			changed++;
+		}
+		index++;
+	}
+	return changed;
+}
+
+/*
+* AuPmmngrLockPages -- locks a set of pages
 * @param Address -- Starting address of the first page
-* @param Size -- Size of the set
+* @param Count -- number of pages
+*/
+void AuPmmngrLockPages(void *Address, size_t Count) {
+	uint64_t locked = AuPmmngrMarkRange((uint64_t)Address / 4096, Count, true);
+	_FreeMemory -= locked;
+	_ReservedMemory += locked;
+}
+
+/*
+* AuPmmngrCountFree -- number of free frames in a
+* range of the bitmap
+*/
+static uint64_t AuPmmngrCountFree(uint64_t First, uint64_t End) {
+	uint64_t count = 0;
+	uint64_t index = First;
+	while (index < End && (index & 7)) {
+		if (!AuPmmngrBitmapCheck(index))
+			count++;
+		index++;
+	}
+	for (; index + 8 <= End; index += 8)
+		count += 8 - AuPmmngrBitCount(BitmapBuffer[index / 8]);
+	for (; index < End; index++) {
+		if (!AuPmmngrBitmapCheck(index))
+			count++;
+	}
+	return count;
+}
+
+/*
+* AuPmmngrAddZone -- append a zone, split at the dma32
+* boundary
+*/
+static void AuPmmngrAddZone(uint64_t Start, uint64_t End, uint8_t Node) {
+	if (End > _MaxFrame)
+		End = _MaxFrame;
+	while (Start < End && pmm_zone_count < PMM_MAX_ZONES) {
+		uint64_t zend = End;
+		uint8_t type = PMM_ZONE_NORMAL;
+		if (Start < PMM_DMA32_LIMIT) {
+			type = PMM_ZONE_DMA32;
+			if (zend > PMM_DMA32_LIMIT)
+				zend = PMM_DMA32_LIMIT;
+		}
+		AuPmmZone* zone = &pmm_zones[pmm_zone_count++];
+		zone->start = Start;
+		zone->end = zend;
+		zone->scan = Start;
+		zone->freeFrames = AuPmmngrCountFree(Start, zend);
+		zone->node = Node;
+		zone->type = type;
+		Start = zend;
+	}
+}
+
+/*
+* AuPmmngrZoneOf -- returns the zone a frame belongs to
+* @param Index -- frame index
 */
-void AuPmmngrLockPages(void *Address, size_t Size) {
-	uint64_t addr = (uint64_t)Address;
-	for (size_t i = 0; i < Size; i++) {
-		AuPmmngrLockPage(addr + i * 4096);
+static AuPmmZone* AuPmmngrZoneOf(uint64_t Index) {
+	for (int i = 0; i < pmm_zone_count; i++) {
+		if (Index >= pmm_zones[i].start && Index < pmm_zones[i].end)
+			return &pmm_zones[i];
 	}
+	return NULL;
 }
 
 /*
@@ -124,7 +273,12 @@ void AuPmmngrUnreservePage(void* Address) {
 	if (AuPmmngrBitmapSet(Index, false)) {
 		_FreeMemory++;
 		_ReservedMemory--;
-		if (_RamBitmapIndex > Index) _RamBitmapIndex = Index;
+		AuPmmZone* zone = AuPmmngrZoneOf(Index);
+		if (zone) {
+			zone->freeFrames++;
+			if (zone->scan > Index)
+				zone->scan = Index;
+		}
 	}
 }
 
@@ -138,49 +292,55 @@ void AuPmmngrInitialize(KERNEL_BOOT_INFO *info) {
 	_FreeMemory = 0;
 	_BitmapSize = 0;
 	_TotalRam = 0;
-	_RamBitmapIndex = 0;
+	_MaxFrame = 0;
 	BitmapBuffer = 0;
 
 	uint64_t MemMapEntries = info->mem_map_size / info->descriptor_size;
 	void* BitmapArea = 0;
-	/* Scan a suitable area for the bitmap */
+	/* the bitmap has to cover the highest usable frame,
+	 * not just the amount of ram, holes in between stay
+	 * marked as used */
 	for (size_t i = 0; i < MemMapEntries; i++) {
 		EFI_MEMORY_DESCRIPTOR *EfiMem = (EFI_MEMORY_DESCRIPTOR*)((uint64_t)info->map + i * info->descriptor_size);
 		_TotalRam += EfiMem->num_pages;
+		if (EfiMem->type == 7) {
+			uint64_t end = EfiMem->phys_start / 4096 + EfiMem->num_pages;
+			if (end > _MaxFrame)
+				_MaxFrame = end;
+		}
+	}
+
+	uint64_t BitmapSize = (_MaxFrame / 8) + 1;
+	uint64_t BitmapNeed = BitmapSize > 0x100000 ? BitmapSize : 0x100000;
+
+	/* Scan a suitable area for the bitmap */
+	for (size_t i = 0; i < MemMapEntries; i++) {
+		EFI_MEMORY_DESCRIPTOR *EfiMem = (EFI_MEMORY_DESCRIPTOR*)((uint64_t)info->map + i * info->descriptor_size);
 		if (EfiMem->type == 7 && EfiMem->attrib & 0x00000001)  {
-			if (((EfiMem->num_pages * 4096) > 0x100000) && BitmapArea == 0)  {
+			if ((EfiMem->num_pages * 4096) > BitmapNeed && EfiMem->phys_start >= 0x100000) {
 				if ((EfiMem->phys_start & (PAGE_SIZE - 1)) == 0) {
-					BitmapArea = (void*)EfiMem->phys_start; // ((EfiMem->phys_start + 0xFFF) & ~0xFFF);
+					BitmapArea = (void*)EfiMem->phys_start;
 					break;
 				}
 			}
 		}
 	}
 
-	_FreeMemory = _TotalRam;
- 
-	uint64_t BitmapSize = (_TotalRam / 8) + 1; // (_TotalRam * 4096) / 4096 / 8 + 1;
-
-	/* now initialise the bitmap */
+	/* now initialise the bitmap, everything starts out
+	 * used and conventional memory is freed by range */
 	AuPmmngrInitBitmap(BitmapSize, BitmapArea);
-
-	AuPmmngrLockPages((void*)BitmapArea, BitmapSize);
-
+	memset(BitmapBuffer, 0xFF, BitmapSize);
 	for (size_t i = 0; i < MemMapEntries; i++) {
 		EFI_MEMORY_DESCRIPTOR *EfiMem = (EFI_MEMORY_DESCRIPTOR*)((uint64_t)info->map + i * info->descriptor_size);
-		//_TotalRam += EfiMem->num_pages;
-		if (EfiMem->type != 7) {
-			uint64_t PhysStart = EfiMem->phys_start;
-			for (size_t j = 0; j < EfiMem->num_pages; j++){
-				AuPmmngrLockPage(PhysStart + j * 4096);
-			}
-		}
+		if (EfiMem->type == 7)
+			_FreeMemory += AuPmmngrMarkRange(EfiMem->phys_start / 4096, EfiMem->num_pages, false);
 	}
+	_ReservedMemory = _TotalRam - _FreeMemory;
 
+	AuPmmngrLockPages((void*)BitmapArea, (BitmapSize + PAGE_SIZE - 1) / PAGE_SIZE);
 
 	/* Lock addresses below 1MiB mark */
-	for (size_t i = 0; i < (1 * 1024 * 1024)/ 4096; i++)
-		AuPmmngrLockPage(i * 4096);
+	AuPmmngrLockPages(0, (1 * 1024 * 1024) / 4096);
 
 	uint32_t AllocCount = info->reserved_mem_count;
 	uint64_t* AllocStack = (uint64_t*)info->allocated_stack;
@@ -199,7 +359,342 @@ void AuPmmngrInitialize(KERNEL_BOOT_INFO *info) {
 	memset(SMPAddress, 0, 4096);
 	memcpy(SMPAddress, info->apcode, 4096);
 
+	/* single node until firmware tells otherwise */
+	pmm_zone_count = 0;
+	pmm_node_count = 1;
+	pmm_node_domain[0] = 0;
+	AuPmmngrAddZone(0, _MaxFrame, 0);
+}
+
+/*
+ * AuPmmngrTakeFrame -- mark a free frame used, pmm
+ * lock must be held
+ * @param zone -- zone of the frame
+ * @param Index -- frame index
+ */
+static void AuPmmngrTakeFrame(AuPmmZone* zone, uint64_t Index) {
+	AuPmmngrLockPage(Index * 4096);
+	_UsedMemory++;
+	if (zone)
+		zone->freeFrames--;
+}
+
+/*
+ * AuPmmngrZoneTake -- takes the lowest free frame of
+ * a zone, pmm lock must be held
+ * @param zone -- zone to take from
+ * @param frame -- receives the frame address
+ */
+static bool AuPmmngrZoneTake(AuPmmZone* zone, uint64_t* frame) {
+	if (zone->freeFrames == 0)
+		return false;
+	for (; zone->scan < zone->end; zone->scan++) {
+		if (AuPmmngrBitmapCheck(zone->scan)) continue;
+		AuPmmngrTakeFrame(zone, zone->scan);
+		*frame = zone->scan * 4096;
+		return true;
+	}
+	return false;
+}
+
+/*
+ * AuPmmngrBitmapTake -- takes the next free frame from
+ * the bitmap, pmm lock must be held. Zones of the
+ * given node are tried first, dma32 before normal as
+ * drivers still take dma memory from AuPmmngrAlloc and
+ * program only the low 32 bits of it
+ * @param frame -- receives the frame address
+ * @param node -- preferred node
+ */
+static bool AuPmmngrBitmapTake(uint64_t* frame, uint8_t node) {
+	for (int remote = 0; remote < 2; remote++) {
+		for (int type = PMM_ZONE_DMA32; type <= PMM_ZONE_NORMAL; type++) {
+			for (int i = 0; i < pmm_zone_count; i++) {
+				AuPmmZone* zone = &pmm_zones[i];
+				if (zone->type != type || (zone->node == node) == (remote != 0))
+					continue;
+				if (AuPmmngrZoneTake(zone, frame))
+					return true;
+			}
+		}
+	}
+	return false;
+}
+
+/*
+ * AuPmmngrBitmapRelease -- returns a frame to the
+ * bitmap, pmm lock must be held
+ * @param Index -- frame index
+ */
+static void AuPmmngrBitmapRelease(uint64_t Index) {
+	if (AuPmmngrBitmapSet(Index, false)) {
+		_FreeMemory++;
+		_UsedMemory--;
+		AuPmmZone* zone = AuPmmngrZoneOf(Index);
+		if (zone) {
+			zone->freeFrames++;
+			if (zone->scan > Index)
+				zone->scan = Index;
+		}
+	}
+}
 
+/*
+ * AuPmmngrLocalNode -- node of the running cpu
+ */
+static uint8_t AuPmmngrLocalNode() {
+	if (!_pcp_enabled || pmm_node_count == 1)
+		return 0;
+	uint8_t cpu = AuPerCPUGetCpuID();
+	if (cpu >= PMM_PCP_MAX_CPUS)
+		return 0;
+	return pmm_cpu_node[cpu];
+}
+
+/*
+ * AuPmmngrNodeOfDomain -- returns node number of a
+ * proximity domain, new domains get the next number
+ * @param domain -- proximity domain
+ */
+static int AuPmmngrNodeOfDomain(uint32_t domain) {
+	for (int i = 0; i < pmm_node_count; i++)
+		if (pmm_node_domain[i] == domain)
+			return i;
+	if (pmm_node_count >= PMM_MAX_NODES)
+		return -1;
+	pmm_node_domain[pmm_node_count] = domain;
+	return pmm_node_count++;
+}
+
+/*
+ * AuPmmngrAddNodeRange -- record a memory range of a
+ * numa node, called while parsing SRAT
+ * @param domain -- proximity domain
+ * @param base -- physical base address
+ * @param length -- length in bytes
+ */
+void AuPmmngrAddNodeRange(uint32_t domain, uint64_t base, uint64_t length) {
+	if (pmm_range_count >= PMM_MAX_ZONES)
+		return;
+	if (!_numa_reported) {
+		pmm_node_count = 0;
+		_numa_reported = true;
+	}
+	int node = AuPmmngrNodeOfDomain(domain);
+	if (node < 0)
+		return;
+	AuPmmNodeRange* range = &pmm_node_ranges[pmm_range_count++];
+	range->start = base / 4096;
+	range->end = (base + length) / 4096;
+	range->node = node;
+}
+
+/*
+ * AuPmmngrSetCPUNode -- record proximity domain of a
+ * cpu, called while parsing SRAT
+ * @param apicId -- local apic id of the cpu
+ * @param domain -- proximity domain
+ */
+void AuPmmngrSetCPUNode(uint32_t apicId, uint32_t domain) {
+	if (apicId >= PMM_PCP_MAX_CPUS)
+		return;
+	if (!_numa_reported) {
+		pmm_node_count = 0;
+		_numa_reported = true;
+	}
+	int node = AuPmmngrNodeOfDomain(domain);
+	if (node >= 0)
+		pmm_cpu_node[apicId] = node;
+}
+
+/*
+ * AuPmmngrBuildZones -- rebuild zones from the node
+ * ranges reported by firmware, frames outside every
+ * range stay in node 0
+ */
+void AuPmmngrBuildZones() {
+	if (pmm_range_count == 0) {
+		/* cpus without memory ranges, stay single node */
+		pmm_node_count = 1;
+		pmm_node_domain[0] = 0;
+		memset(pmm_cpu_node, 0, sizeof(pmm_cpu_node));
+		return;
+	}
+	uint64_t flags = AuAcquireSpinlockIrqSave(&pmm_lock);
+	pmm_zone_count = 0;
+	/* ranges come in any order, walk memory upwards
+	 * and fill gaps between them with node 0 */
+	uint64_t pos = 0;
+	while (pos < _MaxFrame && pmm_zone_count < PMM_MAX_ZONES) {
+		AuPmmNodeRange* next = NULL;
+		for (int i = 0; i < pmm_range_count; i++) {
+			AuPmmNodeRange* r = &pmm_node_ranges[i];
+			if (r->end <= pos)
+				continue;
+			if (!next || r->start < next->start)
+				next = r;
+		}
+		if (!next) {
+			AuPmmngrAddZone(pos, _MaxFrame, 0);
+			break;
+		}
+		if (next->start > pos)
+			AuPmmngrAddZone(pos, next->start, 0);
+		uint64_t start = next->start > pos ? next->start : pos;
+		AuPmmngrAddZone(start, next->end, next->node);
+		pos = next->end;
+	}
+	if (pos < _MaxFrame && pmm_zone_count == PMM_MAX_ZONES) {
+		/* last zone takes the rest, recount what it now covers */
+		AuPmmZone* last = &pmm_zones[PMM_MAX_ZONES - 1];
+		last->end = _MaxFrame;
+		last->freeFrames = AuPmmngrCountFree(last->start, last->end);
+	}
+	AuReleaseSpinlockIrqRestore(&pmm_lock, flags);
+	AuTextOut("[aurora]: pmm %d numa nodes, %d zones \n", pmm_node_count, pmm_zone_count);
+}
+
+/*
+ * AuPmmngrGetZone -- returns a zone for inspection
+ * @param num -- zone number
+ */
+AuPmmZone* AuPmmngrGetZone(int num) {
+	if (num < 0 || num >= pmm_zone_count)
+		return NULL;
+	return &pmm_zones[num];
+}
+
+/*
+ * AuPmmngrLocalCache -- returns the cache of current
+ * cpu with interrupts disabled, so nothing else on this
+ * cpu touches it, null if caches are not usable
+ * @param flags -- receives interrupt state
+ */
+static AuPmmPCP* AuPmmngrLocalCache(uint64_t* flags) {
+	if (!_pcp_enabled)
+		return NULL;
+	*flags = x64_read_rflags();
+	x64_cli();
+	uint8_t cpu = AuPerCPUGetCpuID();
+	if (cpu >= PMM_PCP_MAX_CPUS) {
+		if (*flags & RFLAGS_IF)
+			x64_sti();
+		return NULL;
+	}
+	return &pmm_pcp[cpu];
+}
+
+/*
+ * AuPmmngrLocalCacheDone -- restore interrupt state
+ * saved by AuPmmngrLocalCache
+ * @param flags -- saved interrupt state
+ */
+static inline void AuPmmngrLocalCacheDone(uint64_t flags) {
+	if (flags & RFLAGS_IF)
+		x64_sti();
+}
+
+/*
+ * AuPmmngrCacheRefill -- pull a batch of frames from
+ * the bitmap into the back of a cache, leaving floor
+ * frames in the bitmap
+ * @param pcp -- pointer to cache
+ * @param floor -- frames that must stay free
+ */
+static void AuPmmngrCacheRefill(AuPmmPCP* pcp, uint64_t floor) {
+	AuAcquireSpinlock(&pmm_lock);
+	for (int i = 0; i < PMM_PCP_BATCH && _FreeMemory > floor; i++) {
+		uint64_t frame;
+		if (!AuPmmngrBitmapTake(&frame, AuPmmngrLocalNode()))
+			break;
+		pcp->frames[(pcp->first + pcp->count) % PMM_PCP_SIZE] = frame;
+		pcp->count++;
+	}
+	AuReleaseSpinlock(&pmm_lock);
+}
+
+/*
+ * AuPmmngrCacheDrain -- give a batch of the coldest
+ * frames of a cache back to the bitmap
+ * @param pcp -- pointer to cache
+ * @param num -- number of frames to drain
+ */
+static void AuPmmngrCacheDrain(AuPmmPCP* pcp, uint32_t num) {
+	AuAcquireSpinlock(&pmm_lock);
+	while (num-- && pcp->count) {
+		pcp->count--;
+		uint64_t frame = pcp->frames[(pcp->first + pcp->count) % PMM_PCP_SIZE];
+		AuPmmngrBitmapRelease(frame / 4096);
+	}
+	AuReleaseSpinlock(&pmm_lock);
+}
+
+/*
+ * AuPmmngrCacheInitialise -- enable per cpu frame
+ * caches, called once per cpu data is available
+ */
+void AuPmmngrCacheInitialise() {
+	memset(pmm_pcp, 0, sizeof(pmm_pcp));
+	AuSpinlockSetName(&pmm_lock, "pmm");
+	_pcp_enabled = true;
+}
+
+/*
+ * AuPmmngrReserve -- number of frames an allocation
+ * must leave free, the pages below min watermark are
+ * kept for reclaim itself
+ * @param reserve -- allocation may use the reserve
+ */
+static uint64_t AuPmmngrReserve(bool reserve) {
+	AuReclaimWatermarks* wm = AuReclaimGetWatermarks();
+	if (!wm || reserve || AuReclaimActive())
+		return 0;
+	return wm->min;
+}
+
+/*
+ * AuPmmngrCheckPressure -- wakes background reclaim
+ * below low watermark, and reclaims directly once the
+ * reserve is reached. Called before any pmm lock is
+ * taken
+ */
+static void AuPmmngrCheckPressure() {
+	AuReclaimWatermarks* wm = AuReclaimGetWatermarks();
+	if (!wm || AuReclaimActive())
+		return;
+	if (_FreeMemory < wm->low)
+		AuReclaimWake();
+	if (_FreeMemory <= wm->min)
+		AuReclaimPages(wm->low - _FreeMemory, true);
+}
+
+/*
+ * AuPmmngrTakeOne -- takes a single frame, from the
+ * local cache when possible
+ * @param frame -- receives the frame address
+ * @param reserve -- allocation may use the reserve
+ */
+static bool AuPmmngrTakeOne(uint64_t* frame, bool reserve) {
+	uint64_t flags;
+	uint64_t floor = AuPmmngrReserve(reserve);
+	AuPmmPCP* pcp = AuPmmngrLocalCache(&flags);
+	if (pcp) {
+		bool found = false;
+		if (pcp->count == 0)
+			AuPmmngrCacheRefill(pcp, floor);
+		if (pcp->count) {
+			*frame = pcp->frames[pcp->first];
+			pcp->first = (pcp->first + 1) % PMM_PCP_SIZE;
+			pcp->count--;
+			found = true;
+		}
+		AuPmmngrLocalCacheDone(flags);
+		return found;
+	}
+	uint64_t lflags = AuAcquireSpinlockIrqSave(&pmm_lock);
+	bool found = _FreeMemory > floor && AuPmmngrBitmapTake(frame, AuPmmngrLocalNode());
+	AuReleaseSpinlockIrqRestore(&pmm_lock, lflags);
+	return found;
 }
 
 /*
@@ -207,14 +702,14 @@ void AuPmmngrInitialize(KERNEL_BOOT_INFO *info) {
  * frame and return it to the caller
  */
 void* AuPmmngrAlloc() {
-	//debugon = true;
-	for (; _RamBitmapIndex < _BitmapSize * 8; _RamBitmapIndex++) {
-		//AuTextOut("  RamBitmap[%d] -> %d   ",_RamBitmapIndex, RamBitmap[_RamBitmapIndex]);
-		if (AuPmmngrBitmapCheck(_RamBitmapIndex)) continue;
-		AuPmmngrLockPage(_RamBitmapIndex * 4096);
-		_UsedMemory++;
-		return (void*)(_RamBitmapIndex * 4096);
-	}
+	uint64_t frame = 0;
+	AuPmmngrCheckPressure();
+	if (AuPmmngrTakeOne(&frame, false))
+		return (void*)frame;
+	/* reclaim could not keep up, the reserve is
+	 * better spent than panicking */
+	if (AuPmmngrTakeOne(&frame, true))
+		return (void*)frame;
 
 	x64_cli();
 	AuTextOut("Kernel Panic!!! No more physical memory \n");
@@ -223,31 +718,143 @@ void* AuPmmngrAlloc() {
 
 /*
  * AuPmmngrAllocBlocks -- Allocate multiple physical page frames
- * and return the first page pointer to the caller
+ * and return the first page pointer to the caller, returns
+ * null when no contiguous run of that size is free
  * @param size -- Number of blocks to allocate
  */
 void* AuPmmngrAllocBlocks(int num) {
-	void* First = AuPmmngrAlloc();
-	for (int i = 1; i < num; i++)
-		AuPmmngrAlloc();
+	/* callers treat the run as contiguous, so it never
+	 * comes from the per cpu caches and scattered frames
+	 * are never handed out in its place */
+	AuPmmngrCheckPressure();
+	return AuPmmngrAllocContiguous(num, 1);
+}
 
-	return First;
+/*
+ * AuPmmngrFindRun -- find and take a run of free
+ * frames inside [first, last), pmm lock must be held
+ * @param first -- first frame to consider
+ * @param last -- frame limit
+ * @param num -- number of frames
+ * @param align -- alignment in frames, power of two
+ */
+static void* AuPmmngrFindRun(uint64_t first, uint64_t last, size_t num, size_t align) {
+	uint64_t start = (first + align - 1) & ~(uint64_t)(align - 1);
+	while (start + num <= last) {
+		uint64_t used = 0;
+		bool found = true;
+		for (uint64_t i = 0; i < num; i++) {
+			if (AuPmmngrBitmapCheck(start + i)) {
+				used = start + i;
+				found = false;
+				break;
+			}
+		}
+		if (found) {
+			for (uint64_t i = 0; i < num; i++)
+				AuPmmngrTakeFrame(AuPmmngrZoneOf(start + i), start + i);
+			return (void*)(start * 4096);
+		}
+		start = (used + align) & ~(uint64_t)(align - 1);
+	}
+	return NULL;
 }
 
 /*
- * AuPmmngrFree -- Free a physical page frame
+ * AuPmmngrLowestFree -- lowest frame that may be free
+ */
+static uint64_t AuPmmngrLowestFree() {
+	uint64_t lowest = _MaxFrame;
+	for (int i = 0; i < pmm_zone_count; i++) {
+		if (pmm_zones[i].freeFrames && pmm_zones[i].scan < lowest)
+			lowest = pmm_zones[i].scan;
+	}
+	return lowest;
+}
+
+/*
+ * AuPmmngrAllocContiguous -- allocates a run of physically
+ * contiguous frames whose first frame sits on the given
+ * frame alignment, returns null if no such run is free
+ * @param num -- number of frames
+ * @param align -- alignment in frames, power of two
+ */
+void* AuPmmngrAllocContiguous(size_t num, size_t align) {
+	uint64_t flags = AuAcquireSpinlockIrqSave(&pmm_lock);
+	void* run = AuPmmngrFindRun(AuPmmngrLowestFree(), _BitmapSize * 8, num, align);
+	AuReleaseSpinlockIrqRestore(&pmm_lock, flags);
+	return run;
+}
+
+/*
+ * AuPmmngrAllocDMA32 -- allocates a run of physically
+ * contiguous frames below 4GiB, for devices that can
+ * only address 32 bits
+ * @param num -- number of frames
+ * @param align -- alignment in frames, power of two
+ */
+void* AuPmmngrAllocDMA32(size_t num, size_t align) {
+	uint64_t flags = AuAcquireSpinlockIrqSave(&pmm_lock);
+	uint64_t limit = _BitmapSize * 8;
+	if (limit > PMM_DMA32_LIMIT)
+		limit = PMM_DMA32_LIMIT;
+	uint64_t first = limit;
+	for (int i = 0; i < pmm_zone_count; i++) {
+		if (pmm_zones[i].type == PMM_ZONE_DMA32 && pmm_zones[i].scan < first)
+			first = pmm_zones[i].scan;
+	}
+	void* run = AuPmmngrFindRun(first, limit, num, align);
+	AuReleaseSpinlockIrqRestore(&pmm_lock, flags);
+	return run;
+}
+
+/*
+ * AuPmmngrFreeFrame -- common free path
  * @param Address -- Pointer to physical page
+ * @param cold -- true if the frame's contents are not
+ * expected to be in cpu cache
  */
-void AuPmmngrFree(void* Address) {
-	//uint64_t ShiftAddr = (uint64_t)Address >> PAGE_SHIFT;
+static void AuPmmngrFreeFrame(void* Address, bool cold) {
 	uint64_t Index = (uint64_t)Address / 4096;
 	if (AuPmmngrBitmapCheck(Index) == false) return;
-	if (AuPmmngrBitmapSet(Index, false)) {
-		_FreeMemory++;
-		_UsedMemory--;
-		if (_RamBitmapIndex > Index)
-			_RamBitmapIndex = Index;
+	uint64_t flags;
+	AuPmmPCP* pcp = AuPmmngrLocalCache(&flags);
+	if (!pcp) {
+		uint64_t lflags = AuAcquireSpinlockIrqSave(&pmm_lock);
+		AuPmmngrBitmapRelease(Index);
+		AuReleaseSpinlockIrqRestore(&pmm_lock, lflags);
+		return;
+	}
+	if (pcp->count == PMM_PCP_SIZE)
+		AuPmmngrCacheDrain(pcp, PMM_PCP_BATCH);
+	if (cold) {
+		pcp->frames[(pcp->first + pcp->count) % PMM_PCP_SIZE] = Index * 4096;
 	}
+	else {
+		pcp->first = (pcp->first + PMM_PCP_SIZE - 1) % PMM_PCP_SIZE;
+		pcp->frames[pcp->first] = Index * 4096;
+	}
+	pcp->count++;
+	if (pcp->count > PMM_PCP_HIGH)
+		AuPmmngrCacheDrain(pcp, PMM_PCP_BATCH);
+	AuPmmngrLocalCacheDone(flags);
+}
+
+/*
+ * AuPmmngrFree -- Free a physical page frame
+ * @param Address -- Pointer to physical page
+ */
+void AuPmmngrFree(void* Address) {
+	AuPmmngrFreeFrame(Address, false);
+}
+
+/*
+ * AuPmmngrFreeCold -- Free a physical page frame whose
+ * contents are not going to be reused soon
+ * @param Address -- Pointer to physical page
+ */
+void AuPmmngrFreeCold(void* Address) {
+	AuPmmngrFreeFrame(Address, true);
 }
 
 /*
@@ -258,7 +865,7 @@ void AuPmmngrFree(void* Address) {
 void AuPmmngrFreeBlocks(void* Addr, int Count) {
 	uint64_t Address = (uint64_t)Addr;
 	for (uint32_t i = 0; i < Count; i++) {
-		AuPmmngrFree((void*)Address);
+		AuPmmngrFreeCold((void*)Address);
 		Address += 0x1000;
 	}
 }
@@ -299,7 +906,10 @@ void AuPmmngrMoveHigher() {
  * of RAM
  */
 uint64_t AuPmmngrGetFreeMem() {
-	return _FreeMemory;
+	uint64_t cached = 0;
+	for (int i = 0; i < PMM_PCP_MAX_CPUS; i++)
+		cached += pmm_pcp[i].count;
+	return _FreeMemory + cached;
 }
 
 /*
@@ -0,0 +1,342 @@
+/**
+* BSD 2-Clause License
+*
+* Copyright (c) 2022-2023, Manas Kamal Choudhury
+* All rights reserved.
+*
+* Redistribution and use in source and binary forms, with or without
+* modification, are permitted provided that the following conditions are met:
+*
+* 1. Redistributions of source code must retain the above copyright notice, this
+*    list of conditions and the following disclaimer.
+*
+* 2. Redistributions in binary form must reproduce the above copyright notice,
+*    this list of conditions and the following disclaimer in the documentation
+*    and/or other materials provided with the distribution.
+*
+* THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+* AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+* IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+* DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE
+* FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+* DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR
+* SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER
+* CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY,
+* OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+* OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+*
+**/
+
+#include <Mm\reclaim.h>
+#include <Mm\pmmngr.h>
+#include <Mm\vmmngr.h>
+#include <Mm\kmalloc.h>
+#include <Hal\x86_64_lowlevel.h>
+#include <Hal\x86_64_sched.h>
+#include <Sync\spinlock.h>
+#include <string.h>
+#include <_null.h>
+
+/* smallest min watermark in pages, and fraction of
+ * total memory it scales with */
+#define RECLAIM_MIN_PAGES  128
+#define RECLAIM_MIN_SHIFT  8
+
+/* compressed pages larger than this are not worth
+ * keeping, the frame stays resident */
+#define ZPAGE_MAX_SIZE  (PAGE_SIZE - PAGE_SIZE / 4)
+#define ZPAGE_WORDS  (PAGE_SIZE / sizeof(uint64_t))
+#define ZPAGE_RUN  0x8000
+
+static AuReclaimWatermarks _wm;
+static bool _wm_ready;
+static AuShrinker* _shrinkers;
+static Spinlock reclaim_lock;
+static AuThread* _reclaim_thread;
+static AuThread* _reclaim_owner;
+static bool _reclaim_busy;
+static bool _reclaim_pending;
+
+/*
+ * AuRegisterShrinker -- registers a cache with reclaim,
+ * shrinkers safe for direct reclaim only drop clean
+ * memory and are asked first, the rest follow in
+ * registration order
+ * @param shrinker -- pointer to shrinker
+ */
+void AuRegisterShrinker(AuShrinker* shrinker) {
+	uint64_t flags = AuAcquireSpinlockIrqSave(&reclaim_lock);
+	AuShrinker** link = &_shrinkers;
+	while (*link) {
+		if ((shrinker->flags & SHRINKER_FLAG_DIRECT) && !((*link)->flags & SHRINKER_FLAG_DIRECT))
+			break;
+		link = &(*link)->next;
+	}
+	shrinker->next = *link;
+	*link = shrinker;
+	AuReleaseSpinlockIrqRestore(&reclaim_lock, flags);
+}
+
+/*
+ * AuUnregisterShrinker -- removes a cache from reclaim
+ * @param shrinker -- pointer to shrinker
+ */
+void AuUnregisterShrinker(AuShrinker* shrinker) {
+	uint64_t flags = AuAcquireSpinlockIrqSave(&reclaim_lock);
+	AuShrinker** link = &_shrinkers;
+	while (*link) {
+		if (*link == shrinker) {
+			*link = shrinker->next;
+			break;
+		}
+		link = &(*link)->next;
+	}
+	AuReleaseSpinlockIrqRestore(&reclaim_lock, flags);
+}
+
+/*
+ * AuReclaimGetWatermarks -- returns current watermarks,
+ * null until reclaim is initialised
+ */
+AuReclaimWatermarks* AuReclaimGetWatermarks() {
+	return _wm_ready ? &_wm : NULL;
+}
+
+/*
+ * AuReclaimActive -- true while the running thread is
+ * the one reclaiming
+ */
+bool AuReclaimActive() {
+	return _reclaim_busy && _reclaim_owner == AuGetCurrentThread();
+}
+
+/*
+ * AuReclaimEnter -- claims reclaim for the running
+ * thread, only one context reclaims at a time
+ */
+static bool AuReclaimEnter() {
+	uint64_t flags = AuAcquireSpinlockIrqSave(&reclaim_lock);
+	bool claimed = !_reclaim_busy;
+	if (claimed) {
+		_reclaim_busy = true;
+		_reclaim_owner = AuGetCurrentThread();
+	}
+	AuReleaseSpinlockIrqRestore(&reclaim_lock, flags);
+	return claimed;
+}
+
+/*
+ * AuReclaimLeave -- releases reclaim
+ */
+static void AuReclaimLeave() {
+	uint64_t flags = AuAcquireSpinlockIrqSave(&reclaim_lock);
+	_reclaim_busy = false;
+	_reclaim_owner = NULL;
+	AuReleaseSpinlockIrqRestore(&reclaim_lock, flags);
+}
+
+/*
+ * AuReclaimPages -- runs shrinkers until nr pages were
+ * freed or nothing more can be freed, a direct reclaim
+ * only runs shrinkers that are safe inside a failing
+ * allocation
+ * @param nr -- number of pages wanted
+ * @param direct -- called from a failing allocation
+ */
+size_t AuReclaimPages(size_t nr, bool direct) {
+	if (!AuReclaimEnter())
+		return 0;
+	size_t freed = 0;
+	for (AuShrinker* shrinker = _shrinkers; shrinker && freed < nr; shrinker = shrinker->next) {
+		if (direct && !(shrinker->flags & SHRINKER_FLAG_DIRECT))
+			continue;
+		size_t avail = shrinker->count(shrinker);
+		if (!avail)
+			continue;
+		size_t want = nr - freed;
+		if (want > avail)
+			want = avail;
+		freed += shrinker->scan(shrinker, want);
+	}
+	AuReclaimLeave();
+	return freed;
+}
+
+/*
+ * AuReclaimWake -- wakes the reclaim thread
+ */
+void AuReclaimWake() {
+	if (!_reclaim_thread)
+		return;
+	uint64_t flags = AuAcquireSpinlockIrqSave(&reclaim_lock);
+	_reclaim_pending = true;
+	if (_reclaim_thread->state == THREAD_STATE_BLOCKED)
+		AuUnblockThread(_reclaim_thread);
+	AuReleaseSpinlockIrqRestore(&reclaim_lock, flags);
+}
+
+/*
+ * AuReclaimThread -- background reclaim, frees memory
+ * in batches until the high watermark is reached and
+ * then waits for the next wake up
+ * @param arg -- unused
+ */
+static void AuReclaimThread(uint64_t arg) {
+	while (1) {
+		/* shrinkers have no locks of their own, like the
+		 * rest of the kernel they rely on interrupts being
+		 * off, so every batch runs under cli and the thread
+		 * can only be preempted in between. Nothing in a
+		 * batch writes to disk, shrinkers with dirty data
+		 * hand it to their own threads */
+		uint64_t free = AuPmmngrGetFreeMem();
+		while (free < _wm.high) {
+			size_t want = _wm.high - free;
+			if (want > RECLAIM_BATCH)
+				want = RECLAIM_BATCH;
+			x64_cli();
+			size_t got = AuReclaimPages(want, false);
+			x64_sti();
+			if (got == 0)
+				break;
+			free = AuPmmngrGetFreeMem();
+		}
+
+		x64_cli();
+		AuAcquireSpinlock(&reclaim_lock);
+		if (!_reclaim_pending)
+			AuBlockThread(_reclaim_thread);
+		_reclaim_pending = false;
+		AuReleaseSpinlock(&reclaim_lock);
+		AuForceScheduler();
+	}
+}
+
+/*
+ * AuReclaimInitialise -- computes watermarks from the
+ * amount of usable memory and starts the reclaim thread
+ */
+void AuReclaimInitialise() {
+	AuSpinlockSetName(&reclaim_lock, "reclaim");
+	uint64_t min = AuPmmngrGetTotalMem() >> RECLAIM_MIN_SHIFT;
+	if (min < RECLAIM_MIN_PAGES)
+		min = RECLAIM_MIN_PAGES;
+	_wm.min = min;
+	_wm.low = min * 2;
+	_wm.high = min * 3;
+	_reclaim_thread = AuCreateKthread(AuReclaimThread, (uint64_t)P2V((uint64_t)AuPmmngrAlloc() + 4096),
+		(uint64_t)AuGetRootPageTable(), "kreclaimd");
+	_wm_ready = true;
+}
+
+#ifdef MM_COMPRESSED_SWAP
+/*
+ * AuZPage -- compressed copy of a page, data holds
+ * records of a 16 bit header followed by either one
+ * word repeated header & ~ZPAGE_RUN times, or that
+ * many literal words
+ */
+#pragma pack(push,1)
+typedef struct _zpage_ {
+	uint16_t size;
+	uint8_t data[1];
+}AuZPage;
+#pragma pack(pop)
+
+/* compression only happens inside reclaim, which is
+ * never entered twice, so a single scratch buffer is
+ * enough */
+static uint8_t zpage_scratch[PAGE_SIZE + 16];
+
+/*
+ * AuReclaimCompressPage -- run length encodes the
+ * 64 bit words of a page, a page filled with one value
+ * ends up as a single record
+ * @param page -- virtual address of the page
+ */
+void* AuReclaimCompressPage(void* page) {
+	uint64_t* words = (uint64_t*)page;
+	size_t out = 0;
+	size_t literal = (size_t)-1;
+	size_t i = 0;
+	while (i < ZPAGE_WORDS) {
+		size_t run = 1;
+		while (i + run < ZPAGE_WORDS && words[i + run] == words[i])
+			run++;
+		if (run >= 2) {
+			uint16_t hdr = ZPAGE_RUN | (uint16_t)run;
+			memcpy(&zpage_scratch[out], &hdr, 2);
+			memcpy(&zpage_scratch[out + 2], &words[i], 8);
+			out += 10;
+			literal = (size_t)-1;
+			i += run;
+		}
+		else {
+			if (literal == (size_t)-1) {
+				literal = out;
+				uint16_t hdr = 0;
+				memcpy(&zpage_scratch[out], &hdr, 2);
+				out += 2;
+			}
+			uint16_t hdr;
+			memcpy(&hdr, &zpage_scratch[literal], 2);
+			hdr++;
+			memcpy(&zpage_scratch[literal], &hdr, 2);
+			memcpy(&zpage_scratch[out], &words[i], 8);
+			out += 8;
+			i++;
+		}
+		if (out > ZPAGE_MAX_SIZE)
+			return NULL;
+	}
+
+	AuZPage* z = (AuZPage*)kmalloc(sizeof(uint16_t) + out);
+	if (!z)
+		return NULL;
+	z->size = (uint16_t)out;
+	memcpy(z->data, zpage_scratch, out);
+	return z;
+}
+
+/*
+ * AuReclaimDecompressPage -- restores a page and frees
+ * the compressed copy
+ * @param handle -- value returned by compress
+ * @param page -- virtual address of destination page
+ */
+void AuReclaimDecompressPage(void* handle, void* page) {
+	AuZPage* z = (AuZPage*)handle;
+	uint64_t* words = (uint64_t*)page;
+	size_t in = 0;
+	size_t w = 0;
+	while (in < z->size && w < ZPAGE_WORDS) {
+		uint16_t hdr;
+		memcpy(&hdr, &z->data[in], 2);
+		in += 2;
+		size_t count = hdr & ~ZPAGE_RUN;
+		if (w + count > ZPAGE_WORDS)
+			count = ZPAGE_WORDS - w;
+		if (hdr & ZPAGE_RUN) {
+			uint64_t value;
+			memcpy(&value, &z->data[in], 8);
+			in += 8;
+			for (size_t j = 0; j < count; j++)
+				words[w++] = value;
+		}
+		else {
+			memcpy(&words[w], &z->data[in], count * 8);
+			in += count * 8;
+			w += count;
+		}
+	}
+	kfree(z);
+}
+
+/*
+ * AuReclaimFreeCompressed -- frees a compressed copy
+ * @param handle -- value returned by compress
+ */
+void AuReclaimFreeCompressed(void* handle) {
+	kfree(handle);
+}
+#endif
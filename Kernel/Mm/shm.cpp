@@ -31,6 +31,7 @@
 #include <Mm/kmalloc.h>
 #include <Mm/pmmngr.h>
 #include <Mm/vmmngr.h>
+#include <Mm/vmarea.h>
 #include <Hal/x86_64_hal.h>
 #include <Hal/serial.h>
 #include <Sync/spinlock.h>
@@ -39,329 +40,321 @@
 #include <_null.h>
 #include <string.h>
 
-list_t *shm_list;
-uint16_t shm_id;
+static AuSHM* shm_keys[SHM_HASH_BUCKETS];
+static AuSHM* shm_handles[SHM_HASH_BUCKETS];
+static uint64_t shm_next_handle;
 Spinlock *shmlock;
 
 /*
  * AuInitialiseSHMMan -- initialise shm manager
  */
 void AuInitialiseSHMMan() {
-	shm_list = initialize_list();
-	shm_id = 1;
+	memset(shm_keys, 0, sizeof(shm_keys));
+	memset(shm_handles, 0, sizeof(shm_handles));
+	shm_next_handle = 1;
 	shmlock = AuCreateSpinlock(false);
+	AuSpinlockSetName(shmlock, "shmlock");
 }
 
 /*
- * AuSHMGetID -- allocate a new shared
- * memory id
+ * AuSHMHash -- bucket of a key or handle
+ * @param value -- key or handle
  */
-uint16_t AuSHMGetID() {
-	uint16_t _id = shm_id;
-	shm_id = shm_id + 1;
-	return  _id;
+static uint32_t AuSHMHash(uint64_t value) {
+	value ^= value >> 33;
+	value *= 0xff51afd7ed558ccdULL;
+	value ^= value >> 33;
+	return value % SHM_HASH_BUCKETS;
 }
 
 /*
- * AuGetSHMSeg -- searches and return a
- * shm segment by its key
+ * AuSHMFindKey -- searches a named segment, shm lock
+ * must be held
  * @param key -- key to search
  */
-AuSHM * AuGetSHMSeg(uint16_t key) {
-	for (int i = 0; i < shm_list->pointer; i++) {
-		AuSHM* shm = (AuSHM*)list_get_at(shm_list, i);
+static AuSHM* AuSHMFindKey(uint64_t key) {
+	for (AuSHM* shm = shm_keys[AuSHMHash(key)]; shm; shm = shm->key_next)
 		if (shm->key == key)
 			return shm;
-	}
-
 	return NULL;
 }
 
 /*
-* AuGetSHMSeg -- searches and return a
-* shm segment by its key
-* @param key -- key to search
-*/
-AuSHM * AuGetSHMByID(uint16_t id) {
-	for (int i = 0; i < shm_list->pointer; i++) {
-		AuSHM* shm = (AuSHM*)list_get_at(shm_list, i);
-		if (shm->id == id)
+ * AuSHMFindHandle -- searches a segment by its handle,
+ * shm lock must be held
+ * @param handle -- handle to search
+ */
+static AuSHM* AuSHMFindHandle(uint64_t handle) {
+	for (AuSHM* shm = shm_handles[AuSHMHash(handle)]; shm; shm = shm->handle_next)
+		if (shm->handle == handle)
 			return shm;
-	}
-
 	return NULL;
 }
+
 /*
- * AuCreateSHM -- create a new shared memory segment or
- * returns previously allocated one
- * @param proc -- Creator process
- * @param key  --  unique key to use
- * @param sz   --  size in multiple of PAGE_SIZE
- * @param flags -- security flags
+ * AuSHMResolve -- searches a segment by key or handle,
+ * shm lock must be held
+ * @param id -- key or handle
  */
-int AuCreateSHM(AuProcess* proc, uint16_t key, size_t sz, uint8_t flags) {
-	AuSHM* shm = NULL;
-	AuAcquireSpinlock(shmlock);
-	if (key > UINT16_MAX){
-		AuReleaseSpinlock(shmlock);
-		SeTextOut("[SHM] Creation failed, key exceeds limitation \r\n");
-		return -1;
-	}
-	/*  search if it's already created */
-	shm = AuGetSHMSeg(key);
-	/* create a new*/
-	if (!shm) {
-		shm = (AuSHM*)kmalloc(sizeof(AuSHM));
-		memset(shm, 0, sizeof(AuSHM));
-		shm->id = AuSHMGetID();
-		shm->key = key;
-		shm->num_frames = (sz / 0x1000) + ((sz % 0x1000) ? 1 : 0);
-		shm->link_count = 0;
-		shm->frames = (uint64_t*)kmalloc(sizeof(uint64_t)* shm->num_frames);
-		for (int i = 0; i < shm->num_frames; i++)  {
-			shm->frames[i] = (uint64_t)AuPmmngrAlloc();
-		}
+static AuSHM* AuSHMResolve(uint64_t id) {
+	if (id & SHM_HANDLE_TAG)
+		return AuSHMFindHandle(id);
+	if (id == SHM_KEY_ANONYMOUS)
+		return NULL;
+	return AuSHMFindKey(id);
+}
 
-		list_add(shm_list, shm);
+/*
+ * AuSHMDestroy -- takes a segment out of the namespace
+ * and frees its memory, shm lock must be held
+ * @param shm -- segment to destroy
+ */
+static void AuSHMDestroy(AuSHM* shm) {
+	AuSHM** link;
+	if (shm->key != SHM_KEY_ANONYMOUS) {
+		for (link = &shm_keys[AuSHMHash(shm->key)]; *link; link = &(*link)->key_next) {
+			if (*link == shm) {
+				*link = shm->key_next;
+				break;
+			}
+		}
 	}
-
-	if (!shm) {
-		AuReleaseSpinlock(shmlock);
-		return -1;
+	for (link = &shm_handles[AuSHMHash(shm->handle)]; *link; link = &(*link)->handle_next) {
+		if (*link == shm) {
+			*link = shm->handle_next;
+			break;
+		}
 	}
 
-	AuReleaseSpinlock(shmlock);
-	return shm->id;
+	for (uint64_t i = 0; i < shm->num_frames; i++)
+		AuPmmngrFree((void*)shm->frames[i]);
+	kfree(shm->frames);
+	kfree(shm);
 }
 
 /*
- * AuSHMDelete -- removes a SHM Segment from system shm list
- * @param shm -- segment to delete
+ * AuSHMRelease -- drops a reference, the last one
+ * destroys the segment, shm lock must be held
+ * @param shm -- segment
  */
-void AuSHMDelete(AuSHM* shm) {
-	if (!shm)
-		return;
-	if (shm->link_count > 0){
-		shm->link_count--;
-	}
-
-	if (shm->link_count == 0){
-		for (int i = 0; i < shm->num_frames; i++) {
-			size_t phys = shm->frames[i];
-			AuPmmngrFree((void*)phys);
-		}
-		
-		for (int j = 0; j <= shm_list->pointer; j++) {
-			AuSHM *shm_ = (AuSHM*)list_get_at(shm_list, j);
-			if (shm_ == shm)
-				list_remove(shm_list, j);
-		}
-		kfree(shm->frames);
-		kfree(shm);
-	}
+static void AuSHMRelease(AuSHM* shm) {
+	if (shm->refs > 0)
+		shm->refs--;
+	if (shm->refs == 0)
+		AuSHMDestroy(shm);
 }
+
 /*
- * AuSHMProcBreak -- gets some available shm memory
- * and increase the break count
- * @param proc -- Process to look
- * @param num_frames -- number of frames to increase
+ * AuSHMGet -- looks up a segment by its key or handle
+ * and takes a reference to it
+ * @param id -- key or handle
  */
-size_t AuSHMProcBreak(AuProcess* proc, size_t num_frames) {
-	size_t start_addr = proc->shm_break;
-	proc->shm_break = (proc->shm_break + num_frames * PAGE_SIZE);
-	return start_addr;
+AuSHM* AuSHMGet(uint64_t id) {
+	AuAcquireSpinlock(shmlock);
+	AuSHM* shm = AuSHMResolve(id);
+	if (shm)
+		shm->refs++;
+	AuReleaseSpinlock(shmlock);
+	return shm;
 }
 
 /*
- * AuSHMProcSwap -- Swaps data between list entry
+ * AuSHMPut -- drops a reference taken by AuSHMGet
+ * @param shm -- segment
  */
-void AuSHMProcSwap(dataentry* current, dataentry* index) {
-	void* tmp = current->data;
-	current->data = index->data;
-	index->data = tmp;
+void AuSHMPut(AuSHM* shm) {
+	if (!shm)
+		return;
+	AuAcquireSpinlock(shmlock);
+	AuSHMRelease(shm);
+	AuReleaseSpinlock(shmlock);
 }
 
 /*
- * AuSHMProcOrderList -- orders current shared memory mappings
- * @param proc -- Pointer to process slot
+ * AuCreateSHM -- create a new shared memory segment or
+ * returns previously allocated one with the same key,
+ * the creating process holds a reference to a fresh
+ * segment until it detaches from it or exits, kernel
+ * creators pass no process and take their own
+ * @param proc -- Creator process
+ * @param key  --  unique key to use, SHM_KEY_ANONYMOUS
+ * for a segment without name
+ * @param sz   --  size in multiple of PAGE_SIZE
+ * @param flags -- shm flags
  */
-void AuSHMProcOrderList(AuProcess* proc) {
-	dataentry* current = proc->shmmaps->entry_current;
-	dataentry* index = NULL;
-	for (int i = 0; i < proc->shmmaps->pointer; i++) {
-		if (current == NULL)
-			break;
-		AuSHMMappings* mappsone = (AuSHMMappings*)current->data;
-		index = current->next;
-		for (int k = 0; k < proc->shmmaps->pointer - 1; k++) {
-			if (index == NULL)
-				break;
-			AuSHMMappings* maptwo = (AuSHMMappings*)index->data;
-			if (mappsone->start_addr > maptwo->start_addr) 
-				AuSHMProcSwap(current, index);
-			index = index->next;
-		}
-		current = current->next;
+int64_t AuCreateSHM(AuProcess* proc, uint64_t key, size_t sz, uint8_t flags) {
+	if (key & SHM_HANDLE_TAG) {
+		SeTextOut("[SHM] Creation failed, key exceeds limitation \r\n");
+		return -1;
+	}
+	AuAcquireSpinlock(shmlock);
+	/*  search if it's already created */
+	AuSHM* shm = NULL;
+	if (key != SHM_KEY_ANONYMOUS)
+		shm = AuSHMFindKey(key);
+	if (shm) {
+		AuReleaseSpinlock(shmlock);
+		return shm->handle;
 	}
+	/* opening a segment that does not exist */
+	if (!sz) {
+		AuReleaseSpinlock(shmlock);
+		return -1;
+	}
+
+	shm = (AuSHM*)kmalloc(sizeof(AuSHM));
+	memset(shm, 0, sizeof(AuSHM));
+	shm->key = key;
+	shm->handle = SHM_HANDLE_TAG | shm_next_handle++;
+	shm->flags = flags;
+	shm->num_frames = (sz / PAGE_SIZE) + ((sz % PAGE_SIZE) ? 1 : 0);
+	if (flags & SHM_FLAG_LARGE_PAGES)
+		shm->num_frames = (shm->num_frames + SHM_LARGE_PAGE_FRAMES - 1) & ~(uint64_t)(SHM_LARGE_PAGE_FRAMES - 1);
+	shm->frames = (uint64_t*)kmalloc(sizeof(uint64_t)* shm->num_frames);
+	/* segments of 2 MiB or more are backed by an aligned
+	 * contiguous run when possible, so that every mapping
+	 * of them can use large pages */
+	uint64_t run = 0;
+	if (shm->num_frames >= SHM_LARGE_PAGE_FRAMES)
+		run = (uint64_t)AuPmmngrAllocContiguous(shm->num_frames, SHM_LARGE_PAGE_FRAMES);
+	for (uint64_t i = 0; i < shm->num_frames; i++) {
+		if (run)
+			shm->frames[i] = run + i * PAGE_SIZE;
+		else
+			shm->frames[i] = (uint64_t)AuPmmngrAlloc();
+		/* frames may carry data of their previous owner */
+		memset((void*)P2V(shm->frames[i]), 0, PAGE_SIZE);
+	}
+
+	if (key != SHM_KEY_ANONYMOUS) {
+		uint32_t bucket = AuSHMHash(key);
+		shm->key_next = shm_keys[bucket];
+		shm_keys[bucket] = shm;
+	}
+	uint32_t bucket = AuSHMHash(shm->handle);
+	shm->handle_next = shm_handles[bucket];
+	shm_handles[bucket] = shm;
+
+	/* creator's reference sits in its mapping list as an
+	 * empty mapping, the first attach fills it in */
+	if (proc) {
+		AuSHMMappings* creator = (AuSHMMappings*)kmalloc(sizeof(AuSHMMappings));
+		memset(creator, 0, sizeof(AuSHMMappings));
+		creator->shm = shm;
+		shm->refs = 1;
+		list_add(proc->shmmaps, creator);
+	}
+
+	int64_t handle = shm->handle;
+	AuReleaseSpinlock(shmlock);
+	return handle;
 }
 
 /*
  * AuSHMObtainMem -- obtains a virtual memory from given
  * shm segment
  * @param proc -- Calling process
- * @param id -- shm segment id
+ * @param id -- key or handle of the segment
  * @param shmaddr -- starting shared memory address to map
  * @parma shmflg -- flags
  */
-void* AuSHMObtainMem(AuProcess* proc, uint16_t id, void* shmaddr, int shmflg) {
+void* AuSHMObtainMem(AuProcess* proc, uint64_t id, void* shmaddr, int shmflg) {
 	AuAcquireSpinlock(shmlock);
-	AuSHM* mem = NULL;
-
-	/* search for shm memory segment */
-	mem = AuGetSHMByID(id);
-
-	if (!mem)
+	AuSHM* mem = AuSHMResolve(id);
+	if (!mem) {
+		AuReleaseSpinlock(shmlock);
 		return NULL;
+	}
 
+	/* place the segment in the lowest gap of the
+	 * shared memory window */
+	size_t length = static_cast<size_t>(mem->num_frames) * PAGE_SIZE;
+	size_t start_addr = 0;
+	if (length >= X86_64_LARGE_PAGE_SIZE) {
+		/* large segments want a 2 MiB aligned placement */
+		start_addr = AuVMAreaFindGap(proc, USER_SHARED_MEM_START, PROCESS_MMAP_ADDRESS, length + X86_64_LARGE_PAGE_SIZE);
+		if (start_addr)
+			start_addr = (start_addr + X86_64_LARGE_PAGE_SIZE - 1) & ~(X86_64_LARGE_PAGE_SIZE - 1);
+	}
+	if (!start_addr)
+		start_addr = AuVMAreaFindGap(proc, USER_SHARED_MEM_START, PROCESS_MMAP_ADDRESS, length);
+	if (!start_addr) {
+		AuReleaseSpinlock(shmlock);
+		return NULL;
+	}
 
-	AuSHMMappings *mappings = (AuSHMMappings*)kmalloc(sizeof(AuSHMMappings));
-	memset(mappings, 0, sizeof(AuSHMMappings));
-
-	mem->link_count++;
-
-	/* look for already available address space gap
-	 * before increasing the process shm_break
-	 */
-	uint64_t last_addr = USER_SHARED_MEM_START;
-	bool have_mappings = false;
+	/* creator attaching for the first time reuses the
+	 * reference it got at creation */
+	AuSHMMappings* mappings = NULL;
 	for (int i = 0; i < proc->shmmaps->pointer; i++) {
-		AuSHMMappings *maps = (AuSHMMappings*)list_get_at(proc->shmmaps, i);
-		if (!have_mappings)
-			have_mappings = true;
-		if (maps->start_addr > last_addr) {
-			size_t gap = maps->start_addr - last_addr;
-			if (gap >= static_cast<uint64_t>(mem->num_frames) * PAGE_SIZE){
-				for (int j = 0; j < mem->num_frames; j++) {
-					size_t phys = mem->frames[j];
-					AuMapPage(phys, last_addr + static_cast<int64_t>(j) * PAGE_SIZE, X86_64_PAGING_USER);
-				}
-				mappings->start_addr = last_addr;
-				mappings->length = mem->num_frames * PAGE_SIZE;
-				mappings->shm = mem;
-
-				/* Here we need some sorting algorithm to sort
-				 * out mappings in ascending order, like Bubble-sort
-				 * algorithm between nodes of mappings
-				 */
-				list_add(proc->shmmaps, mappings);
-				AuReleaseSpinlock(shmlock);
-
-#if 0
-				/* just for debugging purpose */
-				for (int i = 0; i < proc->shmmaps->pointer; i++) {
-					AuSHMMappings* map = (AuSHMMappings*)list_get_at(proc->shmmaps, i);
-					SeTextOut("M -> %x \r\n", map->start_addr);
-				}
-#endif
-
-				/* Now order the list, in ascending order */
-				AuSHMProcOrderList(proc);
-
-#if 0
-				/* just for debugging purpose after sorting 
-				 * has been done 
-				 */
-				SeTextOut("After ordering \r\n");
-
-				for (int i = 0; i < proc->shmmaps->pointer; i++) {
-					AuSHMMappings* map = (AuSHMMappings*)list_get_at(proc->shmmaps, i);
-					SeTextOut("M -> %x \r\n", map->start_addr);
-				}
-#endif
-
-				return (void*)mappings->start_addr;
-			}
+		AuSHMMappings* maps = (AuSHMMappings*)list_get_at(proc->shmmaps, i);
+		if (maps->shm == mem && maps->length == 0) {
+			mappings = maps;
+			break;
 		}
-		last_addr = maps->start_addr + maps->length;
 	}
-
-	if (!have_mappings) {
-		size_t start_addr = USER_SHARED_MEM_START;
-		if (proc->shm_break > start_addr) {
-			size_t gap = proc->shm_break - start_addr;
-			if (gap >= mem->num_frames * PAGE_SIZE) {
-				for (int j = 0; j < mem->num_frames; j++) {
-					size_t phys = mem->frames[j];
-					AuMapPage(phys, last_addr + static_cast<int64_t>(j) * PAGE_SIZE, X86_64_PAGING_USER);
-				}
-				mappings->start_addr = last_addr;
-				mappings->length = mem->num_frames * PAGE_SIZE;
-				mappings->shm = mem;
-				list_add(proc->shmmaps, mappings);
-				/* Now order the list, in ascending order */
-				AuSHMProcOrderList(proc);
-				AuReleaseSpinlock(shmlock);
-				return (void*)mappings->start_addr;
-			}
-		}
+	if (!mappings) {
+		mappings = (AuSHMMappings*)kmalloc(sizeof(AuSHMMappings));
+		memset(mappings, 0, sizeof(AuSHMMappings));
+		mappings->shm = mem;
+		mem->refs++;
+		list_add(proc->shmmaps, mappings);
 	}
 
-	/* finally, we need to increase the shm break */
-	for (int i = 0; i < mem->num_frames; i++) {
-		uint64_t phys_addr = mem->frames[i];
-		uint64_t current_virt = AuSHMProcBreak(proc, 1);
-		AuMapPage((uint64_t)phys_addr, current_virt, X86_64_PAGING_USER);
-		if (mappings->start_addr == 0)
-			mappings->start_addr = current_virt;
+	for (uint64_t j = 0; j < mem->num_frames; j++) {
+		size_t phys = mem->frames[j];
+		AuMapPage(phys, start_addr + j * PAGE_SIZE, X86_64_PAGING_USER);
 	}
+	AuVmmngrPromoteRange(proc->cr3, start_addr, length);
+	AuVMAreaMap(proc, start_addr, length, VM_PRESENT | VM_WRITE | VM_SHARED, VM_TYPE_SHM, NULL);
 
-	mappings->length = mem->num_frames * PAGE_SIZE;
-	mappings->shm = mem;
-	list_add(proc->shmmaps, mappings);
-	/* Now order the list, in ascending order */
-	AuSHMProcOrderList(proc);
+	mappings->start_addr = start_addr;
+	mappings->length = length;
 	AuReleaseSpinlock(shmlock);
 	return (void*)mappings->start_addr;
 }
 
+/*
+ * AuSHMUnmapping -- removes a mapping from process
+ * address space and drops its reference, shm lock
+ * must be held
+ * @param proc -- Pointer to process
+ * @param mapping -- mapping to remove
+ */
+static void AuSHMUnmapping(AuProcess* proc, AuSHMMappings* mapping) {
+	/* frames belong to the segment, only drop the mappings,
+	 * an empty one is the creator's unattached reference */
+	if (mapping->length) {
+		AuVmmngrUnmapRange(proc->cr3, mapping->start_addr, mapping->length, 0);
+		AuVMAreaUnmap(proc, mapping->start_addr, mapping->length);
+	}
+	AuSHMRelease(mapping->shm);
+	kfree(mapping);
+}
+
 /*
  * AuSHMUnmap -- unmaps a shared memory segment
- * @param key -- key to search
+ * @param id -- key or handle of the segment
  * @param proc -- process to look 
  */
-void AuSHMUnmap(uint16_t key, AuProcess* proc) {
+void AuSHMUnmap(uint64_t id, AuProcess* proc) {
 	AuAcquireSpinlock(shmlock);
-	AuSHM* shm = AuGetSHMSeg(key);
-
+	AuSHM* shm = AuSHMResolve(id);
 	if (!shm) {
 		AuReleaseSpinlock(shmlock);
 		return;
 	}
-	
-	AuSHMMappings* mapping = NULL;
-	int index = 0;
+
 	for (int i = 0; i < proc->shmmaps->pointer; i++) {
 		AuSHMMappings* maps = (AuSHMMappings*)list_get_at(proc->shmmaps, i);
 		if (maps->shm == shm){
-			mapping = maps;
-			for (int i = 0; i < mapping->length / PAGE_SIZE; i++) {
-				AuVPage* vpage = AuVmmngrGetPage(mapping->start_addr + static_cast<int64_t>(i) * PAGE_SIZE, VIRT_GETPAGE_ONLY_RET, VIRT_GETPAGE_ONLY_RET);
-				if (vpage) {
-					vpage->bits.page = 0;
-					vpage->bits.present = 0;
-					flush_tlb((void*)(mapping->start_addr + static_cast<int64_t>(i) * PAGE_SIZE));
-				}
-			}
-			SeTextOut("Closing index -> %d \r\n", i);
+			if (maps->length && AuVMAreaPinned(proc, maps->start_addr, maps->length))
+				break;
 			list_remove(proc->shmmaps, i);
-			kfree(mapping);
+			AuSHMUnmapping(proc, maps);
 			break;
 		}
 	}
-
-
-	AuSHMDelete(shm);
-	SeTextOut("%s Unmapping shm ->%d count \r\n",proc->name, shm->link_count);
 	AuReleaseSpinlock(shmlock);
 }
 
@@ -373,19 +366,9 @@ void AuSHMUnmap(uint16_t key, AuProcess* proc) {
  */
 void AuSHMUnmapAll(AuProcess* proc) {
 	AuAcquireSpinlock(shmlock);
-	for (int i = 0; i < proc->shmmaps->pointer; i++) {
-		AuSHMMappings* mapping = (AuSHMMappings*)list_remove(proc->shmmaps, i);
-		for (int j = 0; j < mapping->length / PAGE_SIZE; j++) {
-			AuVPage* vpage = AuVmmngrGetPage(mapping->start_addr + 
-				static_cast<int64_t>(j) * PAGE_SIZE, VIRT_GETPAGE_ONLY_RET, VIRT_GETPAGE_ONLY_RET);
-			vpage->bits.page = 0;
-			vpage->bits.present = 0;
-			flush_tlb((void*)(mapping->start_addr + 
-				static_cast<int64_t>(j) * PAGE_SIZE));
-		}
-		AuSHMDelete(mapping->shm);
-		SeTextOut("Unmapping shm -> %x \r\n", mapping->start_addr);
-		kfree(mapping);
+	while (proc->shmmaps->pointer) {
+		AuSHMMappings* mapping = (AuSHMMappings*)list_remove(proc->shmmaps, 0);
+		AuSHMUnmapping(proc, mapping);
 	}
 	kfree(proc->shmmaps);
 	AuReleaseSpinlock(shmlock);
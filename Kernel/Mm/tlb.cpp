@@ -0,0 +1,410 @@
+/**
+* BSD 2-Clause License
+*
+* Copyright (c) 2022-2023, Manas Kamal Choudhury
+* All rights reserved.
+*
+* Redistribution and use in source and binary forms, with or without
+* modification, are permitted provided that the following conditions are met:
+*
+* 1. Redistributions of source code must retain the above copyright notice, this
+*    list of conditions and the following disclaimer.
+*
+* 2. Redistributions in binary form must reproduce the above copyright notice,
+*    this list of conditions and the following disclaimer in the documentation
+*    and/or other materials provided with the distribution.
+*
+* THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+* AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+* IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+* DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE
+* FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+* DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR
+* SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER
+* CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY,
+* OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+* OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+*
+**/
+
+#include <Mm/tlb.h>
+#include <Mm/pmmngr.h>
+#include <Mm/vmmngr.h>
+#include <Hal/x86_64_lowlevel.h>
+#include <Hal/x86_64_cpu.h>
+#include <Hal/x86_64_idt.h>
+#include <Hal/pcpu.h>
+#include <Hal/apic.h>
+#include <Hal/hal.h>
+#include <Sync/spinlock.h>
+#include <string.h>
+#include <_null.h>
+
+#define TLB_ALL_CPUS 0xFF
+
+/*
+ * AuPCIDSlot -- an address space owning a pcid, stale
+ * has one bit per cpu which must flush the pcid before
+ * using it again
+ */
+typedef struct _pcid_slot_ {
+	uint64_t cr3;
+	uint8_t stale;
+}AuPCIDSlot;
+
+/*
+ * AuTLBRequest -- shootdown mailbox of a cpu
+ */
+typedef struct _tlb_request_ {
+	volatile size_t pending;
+	uint64_t cr3;
+	uint64_t addrs[TLB_BATCH_MAX];
+	int count;
+	bool full;
+	bool kernel;
+}AuTLBRequest;
+
+static AuPCIDSlot pcid_slots[TLB_PCID_SLOTS];
+static int pcid_clock = 1;
+static uint64_t cpu_cr3[TLB_MAX_CPUS];
+static uint8_t tlb_active_cpus;
+static AuTLBRequest tlb_requests[TLB_MAX_CPUS];
+static size_t tlb_shootdown_busy;
+static Spinlock* pcid_lock;
+
+extern uint64_t _ICRDest(uint32_t processor);
+extern bool _ICRBusy();
+
+#define INVPCID_ADDRESS      0
+#define INVPCID_ALL_CONTEXTS 2
+
+/*
+ * AuTLBKernelByPCID -- kernel half is cached under every
+ * pcid, with invpcid it is dropped from all of them right
+ * away instead of making every address space flush fully
+ * on its next switch
+ */
+static bool AuTLBKernelByPCID() {
+	return x86_64_is_cpu_pcid_supported() && x86_64_is_cpu_invpcid_supported() && pcid_lock;
+}
+
+/*
+ * AuTLBInvalidateKernel -- drops kernel half translations
+ * from every pcid of this cpu
+ * @param addrs -- page addresses
+ * @param count -- number of addresses
+ * @param full -- drop everything
+ */
+static void AuTLBInvalidateKernel(uint64_t* addrs, int count, bool full) {
+	uint64_t desc[2];
+	if (full) {
+		desc[0] = desc[1] = 0;
+		x64_invpcid(INVPCID_ALL_CONTEXTS, desc);
+		return;
+	}
+	uint64_t flags = AuAcquireSpinlockIrqSave(pcid_lock);
+	for (int i = 0; i < count; i++) {
+		desc[1] = addrs[i];
+		/* pcid 0 is used by untagged loads */
+		for (int p = 0; p < TLB_PCID_SLOTS; p++) {
+			if (p && !pcid_slots[p].cr3)
+				continue;
+			desc[0] = p;
+			x64_invpcid(INVPCID_ADDRESS, desc);
+		}
+	}
+	AuReleaseSpinlockIrqRestore(pcid_lock, flags);
+}
+
+/*
+ * AuTLBInvalidateCurrent -- drops translations of the
+ * address space loaded on this cpu
+ */
+static void AuTLBInvalidateCurrent(uint64_t cr3, uint64_t* addrs, int count, bool full, bool kernel) {
+	uint64_t current = x64_read_cr3() & X86_64_CR3_ADDR_MASK;
+	if (cr3 != current && !kernel)
+		return;
+	if (kernel && AuTLBKernelByPCID()) {
+		AuTLBInvalidateKernel(addrs, count, full);
+		return;
+	}
+	if (full) {
+		/* reloading without no-flush bit drops every
+		 * entry of current pcid */
+		x64_write_cr3(x64_read_cr3());
+		return;
+	}
+	for (int i = 0; i < count; i++)
+		flush_tlb((void*)addrs[i]);
+}
+
+/*
+ * AuTLBServiceRequest -- handles a pending shootdown
+ * of this cpu
+ */
+static void AuTLBServiceRequest() {
+	uint8_t cpu = AuPerCPUGetCpuID();
+	if (cpu >= TLB_MAX_CPUS)
+		return;
+	AuTLBRequest* req = &tlb_requests[cpu];
+	if (!req->pending)
+		return;
+	AuTLBInvalidateCurrent(req->cr3, req->addrs, req->count, req->full, req->kernel);
+	req->pending = 0;
+}
+
+/*
+ * AuTLBShootdownISR -- shootdown interrupt handler
+ */
+static void AuTLBShootdownISR(size_t v, void* param) {
+	AuTLBServiceRequest();
+	AuInterruptEnd(0);
+}
+
+/*
+ * AuTLBInitialise -- initialise tlb management of
+ * the boot processor
+ */
+void AuTLBInitialise() {
+	memset(pcid_slots, 0, sizeof(pcid_slots));
+	memset(tlb_requests, 0, sizeof(tlb_requests));
+	pcid_lock = AuCreateSpinlock(false);
+	AuSpinlockSetName(pcid_lock, "pcid_lock");
+	tlb_shootdown_busy = 0;
+	setvect(TLB_SHOOTDOWN_VECTOR, AuTLBShootdownISR);
+	AuTLBRegisterCPU();
+}
+
+/*
+ * AuTLBRegisterCPU -- marks current processor as a target
+ * of shootdowns, a processor calls it once it runs threads
+ * with interrupts enabled
+ */
+void AuTLBRegisterCPU() {
+	uint8_t cpu = AuPerCPUGetCpuID();
+	if (cpu >= TLB_MAX_CPUS)
+		return;
+	cpu_cr3[cpu] = x64_read_cr3() & X86_64_CR3_ADDR_MASK;
+	tlb_active_cpus |= (1 << cpu);
+}
+
+/*
+ * AuTLBGetPCID -- returns the pcid of an address space,
+ * allocating one if needed, pcid lock must be held
+ * @param cr3 -- physical address of the root table
+ */
+static int AuTLBGetPCID(uint64_t cr3) {
+	int free_slot = 0;
+	for (int i = 1; i < TLB_PCID_SLOTS; i++) {
+		if (pcid_slots[i].cr3 == cr3)
+			return i;
+		if (!free_slot && !pcid_slots[i].cr3)
+			free_slot = i;
+	}
+
+	/* all pcids in use, take one which no cpu
+	 * has currently loaded */
+	while (!free_slot) {
+		int victim = pcid_clock;
+		pcid_clock = (pcid_clock % (TLB_PCID_SLOTS - 1)) + 1;
+		bool loaded = false;
+		for (int c = 0; c < TLB_MAX_CPUS; c++)
+			if (cpu_cr3[c] == pcid_slots[victim].cr3)
+				loaded = true;
+		if (!loaded)
+			free_slot = victim;
+	}
+
+	pcid_slots[free_slot].cr3 = cr3;
+	pcid_slots[free_slot].stale = TLB_ALL_CPUS;
+	return free_slot;
+}
+
+/*
+ * AuTLBSwitchCR3 -- returns the cr3 value to load for
+ * an address space, tagged with its pcid
+ * @param cr3 -- physical address of the root table
+ */
+uint64_t AuTLBSwitchCR3(uint64_t cr3) {
+	uint64_t phys = cr3 & X86_64_CR3_ADDR_MASK;
+	uint8_t cpu = AuPerCPUGetCpuID();
+	if (cpu < TLB_MAX_CPUS)
+		cpu_cr3[cpu] = phys;
+	if (!x86_64_is_cpu_pcid_supported() || !pcid_lock || cpu >= TLB_MAX_CPUS)
+		return phys;
+
+	uint64_t flags = AuAcquireSpinlockIrqSave(pcid_lock);
+	int pcid = AuTLBGetPCID(phys);
+	uint64_t tagged = phys | pcid;
+	if (pcid_slots[pcid].stale & (1 << cpu))
+		pcid_slots[pcid].stale &= ~(1 << cpu);
+	else
+		tagged |= X86_64_CR3_NOFLUSH;
+	AuReleaseSpinlockIrqRestore(pcid_lock, flags);
+	return tagged;
+}
+
+/*
+ * AuTLBReleaseCR3 -- releases the pcid of an address
+ * space which is being destroyed
+ * @param cr3 -- physical address of the root table
+ */
+void AuTLBReleaseCR3(uint64_t cr3) {
+	uint64_t phys = cr3 & X86_64_CR3_ADDR_MASK;
+	if (!pcid_lock)
+		return;
+	uint64_t flags = AuAcquireSpinlockIrqSave(pcid_lock);
+	for (int i = 1; i < TLB_PCID_SLOTS; i++) {
+		if (pcid_slots[i].cr3 == phys) {
+			pcid_slots[i].cr3 = 0;
+			pcid_slots[i].stale = TLB_ALL_CPUS;
+		}
+	}
+	AuReleaseSpinlockIrqRestore(pcid_lock, flags);
+}
+
+/*
+ * AuTLBMarkStale -- makes every cpu flush the pcids
+ * holding translations of the address space on their
+ * next switch to it, kernel half is cached under every
+ * pcid unless invpcid already dropped it everywhere
+ */
+static void AuTLBMarkStale(uint64_t cr3, bool kernel) {
+	if (!x86_64_is_cpu_pcid_supported() || !pcid_lock)
+		return;
+	if (kernel && AuTLBKernelByPCID())
+		return;
+	/* cpu and cr3 are read with interrupts off, so we
+	 * can't be moved in between */
+	uint64_t flags = AuAcquireSpinlockIrqSave(pcid_lock);
+	uint8_t cpu = AuPerCPUGetCpuID();
+	uint64_t current = x64_read_cr3() & X86_64_CR3_ADDR_MASK;
+	for (int i = 1; i < TLB_PCID_SLOTS; i++) {
+		if (!pcid_slots[i].cr3)
+			continue;
+		if (!kernel && pcid_slots[i].cr3 != cr3)
+			continue;
+		uint8_t mask = TLB_ALL_CPUS;
+		/* the loaded one was just invalidated here */
+		if (pcid_slots[i].cr3 == current)
+			mask &= ~(1 << cpu);
+		pcid_slots[i].stale |= mask;
+	}
+	AuReleaseSpinlockIrqRestore(pcid_lock, flags);
+}
+
+/*
+ * AuTLBShootdown -- drops translations of given pages
+ * on every processor using the address space
+ * @param cr3 -- physical address of the root table
+ * @param addrs -- page addresses
+ * @param count -- number of addresses
+ * @param full -- flush the whole address space
+ * @param kernel -- addresses belong to kernel half
+ */
+void AuTLBShootdown(uint64_t cr3, uint64_t* addrs, int count, bool full, bool kernel) {
+	if (count > TLB_BATCH_MAX) {
+		full = true;
+		count = 0;
+	}
+	AuTLBInvalidateCurrent(cr3, addrs, count, full, kernel);
+	AuTLBMarkStale(cr3, kernel);
+
+	uint8_t self = AuPerCPUGetCpuID();
+	uint8_t targets = 0;
+	for (int c = 0; c < TLB_MAX_CPUS; c++) {
+		if (c == self || !(tlb_active_cpus & (1 << c)))
+			continue;
+		if (kernel || cpu_cr3[c] == cr3)
+			targets |= (1 << c);
+	}
+	if (!targets)
+		return;
+
+	/* one shootdown in flight at a time, keep answering
+	 * our own mailbox while waiting so that two cpus
+	 * shooting at each other cannot deadlock */
+	while (!x64_lock_test(&tlb_shootdown_busy, 0, 1)) {
+		AuTLBServiceRequest();
+		x64_pause();
+	}
+
+	for (int c = 0; c < TLB_MAX_CPUS; c++) {
+		if (!(targets & (1 << c)))
+			continue;
+		AuTLBRequest* req = &tlb_requests[c];
+		req->cr3 = cr3;
+		req->count = count;
+		req->full = full;
+		req->kernel = kernel;
+		memcpy(req->addrs, addrs, count * sizeof(uint64_t));
+		req->pending = 1;
+		WriteAPICRegister(LAPIC_REGISTER_ICR, _ICRDest(c) | 0x4000 | TLB_SHOOTDOWN_VECTOR);
+		while (_ICRBusy());
+	}
+
+	for (int c = 0; c < TLB_MAX_CPUS; c++) {
+		if (!(targets & (1 << c)))
+			continue;
+		while (tlb_requests[c].pending) {
+			AuTLBServiceRequest();
+			x64_pause();
+		}
+	}
+	x64_lock_test(&tlb_shootdown_busy, 1, 0);
+}
+
+/*
+ * AuTLBBatchInit -- prepares an empty batch
+ * @param batch -- pointer to the batch
+ * @param cr3 -- physical address of the root table
+ */
+void AuTLBBatchInit(AuTLBBatch* batch, uint64_t cr3) {
+	batch->cr3 = cr3 & X86_64_CR3_ADDR_MASK;
+	batch->num_addrs = 0;
+	batch->num_frames = 0;
+	batch->full = false;
+	batch->kernel = false;
+}
+
+/*
+ * AuTLBBatchAdd -- adds an unmapped page to a batch
+ * @param batch -- pointer to the batch
+ * @param vaddr -- unmapped virtual address, 0 if only
+ * a frame is released
+ * @param frame -- physical frame to release, 0 for none
+ */
+void AuTLBBatchAdd(AuTLBBatch* batch, uint64_t vaddr, uint64_t frame) {
+	if (vaddr) {
+		if (vaddr >= PHYSICAL_MEM_BASE)
+			batch->kernel = true;
+		if (batch->num_addrs < TLB_BATCH_MAX)
+			batch->addrs[batch->num_addrs++] = vaddr;
+		else
+			batch->full = true;
+	}
+	if (frame) {
+		batch->frames[batch->num_frames++] = frame;
+		if (batch->num_frames == TLB_BATCH_MAX)
+			AuTLBBatchFlush(batch);
+	}
+}
+
+/*
+ * AuTLBBatchFlush -- shoots down the batched pages and
+ * releases the batched frames
+ * @param batch -- pointer to the batch
+ */
+void AuTLBBatchFlush(AuTLBBatch* batch) {
+	/* freed paging tables need their cached walks
+	 * dropped too */
+	if (!batch->num_addrs && batch->num_frames)
+		batch->full = true;
+	if (batch->num_addrs || batch->full)
+		AuTLBShootdown(batch->cr3, batch->addrs, batch->num_addrs, batch->full, batch->kernel);
+	for (int i = 0; i < batch->num_frames; i++)
+		AuPmmngrFree((void*)batch->frames[i]);
+	batch->num_addrs = 0;
+	batch->num_frames = 0;
+	batch->full = false;
+}
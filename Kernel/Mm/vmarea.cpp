@@ -31,13 +31,163 @@
 #include <Mm\kmalloc.h>
 #include <list.h>
 
+/*
+ * AuVMAreaHeight -- height of a subtree
+ * @param area -- root of the subtree
+ */
+static int AuVMAreaHeight(AuVMArea* area) {
+	return area ? area->height : 0;
+}
+
+/*
+ * AuVMAreaUpdate -- recomputes height, span and the
+ * largest free gap of a node from its children
+ * @param area -- node to update
+ */
+static void AuVMAreaUpdate(AuVMArea* area) {
+	int lh = AuVMAreaHeight(area->left);
+	int rh = AuVMAreaHeight(area->right);
+	area->height = (lh > rh ? lh : rh) + 1;
+	area->sub_start = area->left ? area->left->sub_start : area->start;
+	area->sub_end = area->right ? area->right->sub_end : area->end;
+
+	size_t gap = 0;
+	if (area->left) {
+		gap = area->left->max_gap;
+		if (area->start - area->left->sub_end > gap)
+			gap = area->start - area->left->sub_end;
+	}
+	if (area->right) {
+		if (area->right->max_gap > gap)
+			gap = area->right->max_gap;
+		if (area->right->sub_start - area->end > gap)
+			gap = area->right->sub_start - area->end;
+	}
+	area->max_gap = gap;
+}
+
+/*
+ * AuVMAreaRotateRight, AuVMAreaRotateLeft -- tree rotations,
+ * the lowered node is updated before the raised one
+ */
+static AuVMArea* AuVMAreaRotateRight(AuVMArea* area) {
+	AuVMArea* l = area->left;
+	area->left = l->right;
+	l->right = area;
+	AuVMAreaUpdate(area);
+	AuVMAreaUpdate(l);
+	return l;
+}
+
+static AuVMArea* AuVMAreaRotateLeft(AuVMArea* area) {
+	AuVMArea* r = area->right;
+	area->right = r->left;
+	r->left = area;
+	AuVMAreaUpdate(area);
+	AuVMAreaUpdate(r);
+	return r;
+}
+
+/*
+ * AuVMAreaBalance -- restores the AVL property of
+ * a node whose children changed
+ * @param area -- node to balance
+ */
+static AuVMArea* AuVMAreaBalance(AuVMArea* area) {
+	AuVMAreaUpdate(area);
+	int bf = AuVMAreaHeight(area->left) - AuVMAreaHeight(area->right);
+	if (bf > 1) {
+		if (AuVMAreaHeight(area->left->left) < AuVMAreaHeight(area->left->right))
+			area->left = AuVMAreaRotateLeft(area->left);
+		return AuVMAreaRotateRight(area);
+	}
+	if (bf < -1) {
+		if (AuVMAreaHeight(area->right->right) < AuVMAreaHeight(area->right->left))
+			area->right = AuVMAreaRotateRight(area->right);
+		return AuVMAreaRotateLeft(area);
+	}
+	return area;
+}
+
+/*
+ * AuVMAreaTreeInsert -- inserts a node into a subtree
+ * @param root -- root of the subtree
+ * @param area -- node to insert
+ */
+static AuVMArea* AuVMAreaTreeInsert(AuVMArea* root, AuVMArea* area) {
+	if (!root)
+		return area;
+	if (area->start < root->start)
+		root->left = AuVMAreaTreeInsert(root->left, area);
+	else
+		root->right = AuVMAreaTreeInsert(root->right, area);
+	return AuVMAreaBalance(root);
+}
+
+/*
+ * AuVMAreaTreeRemoveMin -- unlinks the lowest node
+ * of a subtree
+ * @param root -- root of the subtree
+ * @param min -- receives the unlinked node
+ */
+static AuVMArea* AuVMAreaTreeRemoveMin(AuVMArea* root, AuVMArea** min) {
+	if (!root->left) {
+		*min = root;
+		return root->right;
+	}
+	root->left = AuVMAreaTreeRemoveMin(root->left, min);
+	return AuVMAreaBalance(root);
+}
+
+/*
+ * AuVMAreaTreeRemove -- unlinks a node from a subtree
+ * @param root -- root of the subtree
+ * @param area -- node to unlink
+ */
+static AuVMArea* AuVMAreaTreeRemove(AuVMArea* root, AuVMArea* area) {
+	if (!root)
+		return NULL;
+	if (root != area) {
+		if (area->start < root->start)
+			root->left = AuVMAreaTreeRemove(root->left, area);
+		else
+			root->right = AuVMAreaTreeRemove(root->right, area);
+		return AuVMAreaBalance(root);
+	}
+
+	if (!root->right)
+		return root->left;
+	AuVMArea* min = NULL;
+	AuVMArea* right = AuVMAreaTreeRemoveMin(root->right, &min);
+	min->left = root->left;
+	min->right = right;
+	return AuVMAreaBalance(min);
+}
+
 /*
  * AuInsertVMArea -- insert a memory segment to the given process
  * @param proc -- pointer to the process
  * @param area -- pointer to the vm area
  */
 void AuInsertVMArea(AuProcess* proc, AuVMArea* area) {
-	list_add(proc->vmareas, area);
+	area->left = NULL;
+	area->right = NULL;
+	AuVMAreaUpdate(area);
+	proc->vmroot = AuVMAreaTreeInsert(proc->vmroot, area);
+	proc->vm_count++;
+	proc->vm_mapped += area->end - area->start;
+}
+
+/*
+ * AuVMAreaUnlink -- takes an area out of the tree
+ * without freeing it
+ * @param proc -- pointer to the process
+ * @param area -- pointer to the vm area
+ */
+static void AuVMAreaUnlink(AuProcess* proc, AuVMArea* area) {
+	proc->vmroot = AuVMAreaTreeRemove(proc->vmroot, area);
+	proc->vm_count--;
+	proc->vm_mapped -= area->end - area->start;
 }
 
 /*
@@ -47,11 +197,9 @@ void AuInsertVMArea(AuProcess* proc, AuVMArea* area) {
  * @param area -- pointer to the vm area
  */
 void AuRemoveVMArea(AuProcess* proc, AuVMArea* area) {
-	for (int i = 0; i < proc->vmareas->pointer; i++) {
-		AuVMArea* area_ = (AuVMArea*)list_get_at(proc->vmareas, i);
-		if (area_ == area)
-			list_remove(proc->vmareas, i);
-	}
+	if (!area)
+		return;
+	AuVMAreaUnlink(proc, area);
 	kfree(area);
 }
 
@@ -83,10 +231,274 @@ AuVMArea* AuVMAreaCreate(size_t start, size_t end, uint8_t prot, size_t len, uin
  * @param address -- address to search
  */
 AuVMArea* AuVMAreaGet(AuProcess* proc, size_t address) {
-	for (int i = 0; i < proc->vmareas->pointer; i++) {
-		AuVMArea* area_ = (AuVMArea*)list_get_at(proc->vmareas, i);
-		if (address > area_->start && address < area_->end)
-			return area_;
+	AuVMArea* area = proc->vmroot;
+	while (area) {
+		if (address < area->start)
+			area = area->left;
+		else if (address >= area->end)
+			area = area->right;
+		else
+			return area;
 	}
 	return NULL;
 }
+
+/*
+ * AuVMAreaFindFirst -- finds the lowest area overlapping
+ * the given range
+ * @param proc -- pointer to the process
+ * @param start -- start of the range
+ * @param end -- end of the range
+ */
+AuVMArea* AuVMAreaFindFirst(AuProcess* proc, size_t start, size_t end) {
+	AuVMArea* found = NULL;
+	AuVMArea* area = proc->vmroot;
+	while (area) {
+		if (area->end > start) {
+			found = area;
+			area = area->left;
+		}
+		else
+			area = area->right;
+	}
+	if (found && found->start < end)
+		return found;
+	return NULL;
+}
+
+/*
+ * AuVMAreaFit -- walks the tree in address order looking
+ * for the first hole of len bytes at or above cursor,
+ * subtrees which cannot hold such a hole are skipped
+ * using their span and largest gap
+ * @param area -- root of the subtree
+ * @param len -- length needed
+ * @param cursor -- lowest candidate address, moved past
+ * every area visited
+ */
+static bool AuVMAreaFit(AuVMArea* area, size_t len, size_t* cursor) {
+	if (!area || area->sub_end <= *cursor)
+		return false;
+
+	size_t lead = area->sub_start > *cursor ? area->sub_start - *cursor : 0;
+	if (lead < len && area->max_gap < len) {
+		*cursor = area->sub_end;
+		return false;
+	}
+
+	if (AuVMAreaFit(area->left, len, cursor))
+		return true;
+	if (area->start >= *cursor && area->start - *cursor >= len)
+		return true;
+	if (area->end > *cursor)
+		*cursor = area->end;
+	return AuVMAreaFit(area->right, len, cursor);
+}
+
+/*
+ * AuVMAreaFindGap -- finds the lowest free range of given
+ * length inside [start, end)
+ * @param proc -- pointer to the process
+ * @param start -- start of the range
+ * @param end -- end of the range
+ * @param len -- length needed
+ */
+size_t AuVMAreaFindGap(AuProcess* proc, size_t start, size_t end, size_t len) {
+	if (!len)
+		return 0;
+	size_t cursor = start;
+	AuVMAreaFit(proc->vmroot, len, &cursor);
+	if (cursor + len < cursor || cursor + len > end)
+		return 0;
+	return cursor;
+}
+
+/*
+ * AuVMAreaCanMerge -- checks if two areas describe same
+ * kind of memory
+ */
+static bool AuVMAreaCanMerge(AuVMArea* area, uint8_t prot, uint8_t type, AuVFSNode* file) {
+	return area && !area->file && !file && area->prot_flags == prot && area->type == type;
+}
+
+/*
+ * AuVMAreaMap -- records a new mapping, merging it with
+ * neighbouring areas of same kind
+ * @param proc -- pointer to the process
+ * @param start -- starting address
+ * @param len -- length of the mapping
+ * @param prot -- protection flags
+ * @param type -- type of the area
+ * @param file -- backing file, if any
+ */
+AuVMArea* AuVMAreaMap(AuProcess* proc, size_t start, size_t len, uint8_t prot, uint8_t type,
+	AuVFSNode* file) {
+	size_t end = start + len;
+	if (!len || AuVMAreaFindFirst(proc, start, end))
+		return NULL;
+
+	AuVMArea* prev = start ? AuVMAreaGet(proc, start - 1) : NULL;
+	AuVMArea* next = AuVMAreaGet(proc, end);
+	if (!AuVMAreaCanMerge(prev, prot, type, file))
+		prev = NULL;
+	if (!AuVMAreaCanMerge(next, prot, type, file))
+		next = NULL;
+
+	if (prev) {
+		AuVMAreaUnlink(proc, prev);
+		prev->end = end;
+		if (next) {
+			prev->end = next->end;
+			AuRemoveVMArea(proc, next);
+		}
+		prev->len = prev->end - prev->start;
+		AuInsertVMArea(proc, prev);
+		return prev;
+	}
+	if (next) {
+		AuVMAreaUnlink(proc, next);
+		next->start = start;
+		next->len = next->end - next->start;
+		AuInsertVMArea(proc, next);
+		return next;
+	}
+
+	AuVMArea* area = AuVMAreaCreate(start, end, prot, len, type);
+	area->file = file;
+	AuInsertVMArea(proc, area);
+	return area;
+}
+
+/*
+ * AuVMAreaUnmap -- removes a range from the address space,
+ * areas partially covered are trimmed or split
+ * @param proc -- pointer to the process
+ * @param start -- starting address
+ * @param len -- length of the range
+ */
+void AuVMAreaUnmap(AuProcess* proc, size_t start, size_t len) {
+	size_t end = start + len;
+	AuVMArea* area = NULL;
+	while ((area = AuVMAreaFindFirst(proc, start, end)) != NULL) {
+		AuVMAreaUnlink(proc, area);
+		if (area->start >= start && area->end <= end) {
+			kfree(area);
+			continue;
+		}
+
+		if (area->start < start && area->end > end) {
+			AuVMArea* tail = AuVMAreaCreate(end, area->end, area->prot_flags, area->end - end, area->type);
+			tail->file = area->file;
+			tail->mapobj = area->mapobj;
+			tail->file_offset = area->file_offset + (end - area->start);
+			AuInsertVMArea(proc, tail);
+			area->end = start;
+		}
+		else if (area->start < start)
+			area->end = start;
+		else {
+			area->file_offset += end - area->start;
+			area->start = end;
+		}
+		area->len = area->end - area->start;
+		AuInsertVMArea(proc, area);
+	}
+}
+
+/*
+ * AuVMAreaPin -- pins a range of user memory for the
+ * duration of a kernel operation on it, such as a
+ * disk transfer straight into its pages
+ * @param proc -- pointer to the process
+ * @param start -- starting address
+ * @param len -- length of the range
+ */
+AuVMPin* AuVMAreaPin(AuProcess* proc, size_t start, size_t len) {
+	if (!proc || !len)
+		return NULL;
+	size_t end = start + len;
+	AuVMPin* pin = (AuVMPin*)kmalloc(sizeof(AuVMPin));
+	pin->start = start & ~(PAGE_SIZE - 1);
+	pin->end = PAGE_ALIGN(end);
+	pin->next = proc->vmpins;
+	proc->vmpins = pin;
+	return pin;
+}
+
+/*
+ * AuVMAreaUnpin -- drops a pin taken by AuVMAreaPin
+ * @param proc -- pointer to the process
+ * @param pin -- pin to drop, can be null
+ */
+void AuVMAreaUnpin(AuProcess* proc, AuVMPin* pin) {
+	if (!proc || !pin)
+		return;
+	for (AuVMPin** link = &proc->vmpins; *link; link = &(*link)->next) {
+		if (*link == pin) {
+			*link = pin->next;
+			kfree(pin);
+			return;
+		}
+	}
+}
+
+/*
+ * AuVMAreaPinned -- checks if any part of a range is
+ * pinned
+ * @param proc -- pointer to the process
+ * @param start -- starting address
+ * @param len -- length of the range
+ */
+bool AuVMAreaPinned(AuProcess* proc, size_t start, size_t len) {
+	size_t end = start + len;
+	for (AuVMPin* pin = proc->vmpins; pin; pin = pin->next)
+		if (pin->start < end && start < pin->end)
+			return true;
+	return false;
+}
+
+static void AuVMAreaCollectStats(AuVMArea* area, AuVMStats* stats) {
+	if (!area)
+		return;
+	AuVMAreaCollectStats(area->left, stats);
+	if (area->type < VM_TYPE_MAX)
+		stats->type_len[area->type] += area->end - area->start;
+	AuVMAreaCollectStats(area->right, stats);
+}
+
+/*
+ * AuVMAreaGetStats -- collects address space statistics
+ * @param proc -- pointer to the process
+ * @param stats -- pointer to statistics to fill
+ */
+void AuVMAreaGetStats(AuProcess* proc, AuVMStats* stats) {
+	memset(stats, 0, sizeof(AuVMStats));
+	stats->num_areas = proc->vm_count;
+	stats->mapped_len = proc->vm_mapped;
+	stats->largest_gap = proc->vmroot ? proc->vmroot->max_gap : 0;
+	AuVMAreaCollectStats(proc->vmroot, stats);
+}
+
+static void AuVMAreaFreeTree(AuVMArea* area) {
+	if (!area)
+		return;
+	AuVMAreaFreeTree(area->left);
+	AuVMAreaFreeTree(area->right);
+	kfree(area);
+}
+
+/*
+ * AuVMAreaDestroyAll -- frees every area of a process
+ * @param proc -- pointer to the process
+ */
+void AuVMAreaDestroyAll(AuProcess* proc) {
+	AuVMAreaFreeTree(proc->vmroot);
+	proc->vmroot = NULL;
+	while (proc->vmpins) {
+		AuVMPin* pin = proc->vmpins;
+		proc->vmpins = pin->next;
+		kfree(pin);
+	}
+	proc->vm_count = 0;
+	proc->vm_mapped = 0;
+}
@@ -32,6 +32,7 @@
 #include <aucon.h>
 #include <Hal\x86_64_lowlevel.h>
 #include <Hal\x86_64_cpu.h>
+#include <Mm\tlb.h>
 #include <string.h>
 #include <_null.h>
 #include <Hal\serial.h>
@@ -72,6 +73,126 @@ size_t x86_64_p_index(uint64_t addr){
 	return (addr & 0x7ff);
 }
 
+/*
+ * AuVmmngrTableEmpty -- checks if a paging table has
+ * no present entry left
+ * @param table -- virtual address of the table
+ */
+static bool AuVmmngrTableEmpty(uint64_t* table) {
+	for (int i = 0; i < 512; i++)
+		if (table[i] & X86_64_PAGING_PRESENT)
+			return false;
+	return true;
+}
+
+/*
+ * AuVmmngrSplitEntry -- splits a huge page entry into a
+ * table of the next smaller page size, mapping the same
+ * frames with the same attributes
+ * @param cr3 -- physical address of the root table the
+ * entry belongs to
+ * @param entry -- pointer to the huge entry
+ * @param virt_addr -- any address inside the huge page
+ * @param span -- size covered by the huge entry
+ * @return false if no frame was left for the table, the
+ * huge entry is then left as it was
+ */
+static bool AuVmmngrSplitEntry(uint64_t cr3, uint64_t* entry, uint64_t virt_addr, uint64_t span) {
+	uint64_t old = *entry;
+	uint64_t sub = span >> 9;
+	uint64_t base = old & X86_64_PAGING_ADDR_MASK & ~(span - 1);
+	uint64_t attr = old & ~X86_64_PAGING_ADDR_MASK;
+	/* bit 7 of a pte selects PAT, not the page size */
+	if (sub == PAGE_SIZE)
+		attr &= ~X86_64_PAGING_HUGE;
+
+	uint64_t table_phys = (uint64_t)AuPmmngrAlloc();
+	if (!table_phys)
+		return false;
+	uint64_t* table = (uint64_t*)P2V(table_phys);
+	for (int i = 0; i < 512; i++)
+		table[i] = (base + i * sub) | attr;
+
+	*entry = table_phys | (old & (X86_64_PAGING_PRESENT | X86_64_PAGING_WRITABLE | X86_64_PAGING_USER));
+
+	/* translations are unchanged, only the cached huge
+	 * entry has to go */
+	AuTLBBatch batch;
+	AuTLBBatchInit(&batch, cr3);
+	AuTLBBatchAdd(&batch, virt_addr & ~(span - 1), 0);
+	AuTLBBatchFlush(&batch);
+	return true;
+}
+
+/*
+ * AuVmmngrPromoteEntry -- replaces a page table whose 512
+ * entries map one aligned, physically contiguous 2 MiB run
+ * with identical attributes by a single large page
+ * @param cr3 -- physical address of the root table
+ * @param pde -- page directory entry pointing to the table
+ * @param virt_addr -- start of the 2 MiB window
+ */
+static bool AuVmmngrPromoteEntry(uint64_t cr3, uint64_t* pde, uint64_t virt_addr) {
+	/* accessed and dirty bits are allowed to differ */
+	const uint64_t ad = 0x60;
+	uint64_t pt_phys = *pde & X86_64_PAGING_ADDR_MASK;
+	uint64_t* pt = (uint64_t*)P2V(pt_phys);
+	uint64_t first = pt[0];
+	if (!(first & X86_64_PAGING_PRESENT) || (first & X86_64_PAGING_HUGE))
+		return false;
+
+	uint64_t base = first & X86_64_PAGING_ADDR_MASK;
+	if (base & (X86_64_LARGE_PAGE_SIZE - 1))
+		return false;
+
+	uint64_t attr = first & ~X86_64_PAGING_ADDR_MASK & ~ad;
+	uint64_t seen = 0;
+	for (int i = 0; i < 512; i++) {
+		uint64_t e = pt[i];
+		if ((e & X86_64_PAGING_ADDR_MASK) != base + i * PAGE_SIZE)
+			return false;
+		if ((e & ~X86_64_PAGING_ADDR_MASK & ~ad) != attr)
+			return false;
+		seen |= e & ad;
+	}
+
+	/* the table entry may have been stricter than the pages */
+	attr &= *pde | ~(uint64_t)(X86_64_PAGING_WRITABLE | X86_64_PAGING_USER);
+	*pde = base | attr | seen | X86_64_PAGING_HUGE;
+
+	AuTLBBatch batch;
+	AuTLBBatchInit(&batch, cr3);
+	AuTLBBatchAdd(&batch, virt_addr, pt_phys);
+	AuTLBBatchFlush(&batch);
+	return true;
+}
+
+/*
+ * AuVmmngrWalk -- returns the entry at the given level that
+ * translates an address, creating missing tables on the way
+ * @param pml4 -- virtual address of the root table
+ * @param virt_addr -- virtual address
+ * @param level -- 1 for a pte, 2 for a pde, 3 for a pdpte
+ * @param flags -- flags of newly created tables
+ */
+static uint64_t* AuVmmngrWalk(uint64_t* pml4, uint64_t virt_addr, int level, uint64_t flags) {
+	uint64_t* table = pml4;
+	for (int l = 4; l > level; l--) {
+		uint64_t* e = &table[(virt_addr >> (12 + 9 * (l - 1))) & 0x1FF];
+		if (!(*e & X86_64_PAGING_PRESENT)) {
+			const uint64_t page = (uint64_t)AuPmmngrAlloc();
+			memset((void*)P2V(page), 0, 4096);
+			*e = page | flags;
+		}
+		else if (*e & X86_64_PAGING_HUGE) {
+			/* already covered by a larger page */
+			return NULL;
+		}
+		table = (uint64_t*)P2V(*e & X86_64_PAGING_ADDR_MASK);
+	}
+	return &table[(virt_addr >> (12 + 9 * (level - 1))) & 0x1FF];
+}
+
 
 /*
  * Au_x86_64_Paging_Init -- Initialise x86_64 paging and setup
@@ -131,7 +252,7 @@ AuVPage * AuVmmngrGetPage(uint64_t virt_addr, uint8_t _flags, uint8_t mode) {
 	const long i2 = (virt_addr >> 21) & 0x1FF;
 	const long i1 = (virt_addr >> 12) & 0x1FF;
 
-	uint64_t *pml4i = (uint64_t*)P2V(x64_read_cr3());
+	uint64_t *pml4i = (uint64_t*)P2V(x64_read_cr3() & ~(4096 - 1));
 
 	if (!(pml4i[i4] & X86_64_PAGING_PRESENT))
 	{
@@ -153,6 +274,11 @@ AuVPage * AuVmmngrGetPage(uint64_t virt_addr, uint8_t _flags, uint8_t mode) {
 
 	}
 
+	/* callers want a 4K entry, break huge pages down first */
+	if (pml3[i3] & X86_64_PAGING_HUGE) {
+		if (!AuVmmngrSplitEntry(V2P((size_t)pml4i), &pml3[i3], virt_addr, X86_64_HUGE_PAGE_SIZE))
+			return NULL;
+	}
 
 	uint64_t* pml2 = (uint64_t*)(P2V(pml3[i3]) & ~(4096 - 1));
 
@@ -166,6 +292,11 @@ AuVPage * AuVmmngrGetPage(uint64_t virt_addr, uint8_t _flags, uint8_t mode) {
 
 	}
 
+	if (pml2[i2] & X86_64_PAGING_HUGE) {
+		if (!AuVmmngrSplitEntry(V2P((size_t)pml4i), &pml2[i2], virt_addr, X86_64_LARGE_PAGE_SIZE))
+			return NULL;
+	}
+
 	uint64_t* pml1 = (uint64_t*)(P2V(pml2[i2]) & ~(4096 - 1));
 	if (pml1[i1] & X86_64_PAGING_PRESENT)
 	{
@@ -203,7 +334,7 @@ bool AuMapPage(uint64_t phys_addr, uint64_t virt_addr, uint8_t attrib) {
 	const long i2 = (virt_addr >> 21) & 0x1FF;
 	const long i1 = (virt_addr >> 12) & 0x1FF;
 
-	uint64_t *pml4i = (uint64_t*)P2V(x64_read_cr3());
+	uint64_t *pml4i = (uint64_t*)P2V(x64_read_cr3() & ~(4096 - 1));
 
 	if (!(pml4i[i4] & X86_64_PAGING_PRESENT))
 	{
@@ -226,6 +357,12 @@ bool AuMapPage(uint64_t phys_addr, uint64_t virt_addr, uint8_t attrib) {
 	}
 
 
+	/* the range is already covered by a huge page */
+	if (pml3[i3] & X86_64_PAGING_HUGE)
+	{
+		return false;
+	}
+
 	uint64_t* pml2 = (uint64_t*)(P2V(pml3[i3]) & ~(4096 - 1));
 
 	if (!(pml2[i2] & X86_64_PAGING_PRESENT))
@@ -238,6 +375,11 @@ bool AuMapPage(uint64_t phys_addr, uint64_t virt_addr, uint8_t attrib) {
 
 	}
 
+	if (pml2[i2] & X86_64_PAGING_HUGE)
+	{
+		return false;
+	}
+
 	uint64_t* pml1 = (uint64_t*)(P2V(pml2[i2]) & ~(4096 - 1));
 	if (pml1[i1] & X86_64_PAGING_PRESENT)
 	{
@@ -290,6 +432,13 @@ bool AuMapPageEx(uint64_t *pml4i, uint64_t phys_addr, uint64_t virt_addr, uint8_
 	}
 
 
+	/* the range is already covered by a huge page */
+	if (pml3[i3] & X86_64_PAGING_HUGE)
+	{
+		AuPmmngrFree((void*)phys_addr);
+		return false;
+	}
+
 	uint64_t* pml2 = (uint64_t*)(P2V(pml3[i3]) & ~(4096 - 1));
 
 	if (!(pml2[i2] & X86_64_PAGING_PRESENT))
@@ -302,6 +451,12 @@ bool AuMapPageEx(uint64_t *pml4i, uint64_t phys_addr, uint64_t virt_addr, uint8_
 
 	}
 
+	if (pml2[i2] & X86_64_PAGING_HUGE)
+	{
+		AuPmmngrFree((void*)phys_addr);
+		return false;
+	}
+
 	uint64_t* pml1 = (uint64_t*)(P2V(pml2[i2]) & ~(4096 - 1));
 	if (pml1[i1] & X86_64_PAGING_PRESENT)
 	{
@@ -322,6 +477,14 @@ bool AuMapPageEx(uint64_t *pml4i, uint64_t phys_addr, uint64_t virt_addr, uint8_
  */
 void* AuMapMMIO(uint64_t phys_addr, size_t page_count) {
 	uint64_t out = (uint64_t)_MmioBase;
+	/* large apertures such as framebuffers get large pages */
+	if (page_count * 4096 >= X86_64_LARGE_PAGE_SIZE && !(phys_addr & (X86_64_LARGE_PAGE_SIZE - 1))) {
+		out = (out + X86_64_LARGE_PAGE_SIZE - 1) & ~(X86_64_LARGE_PAGE_SIZE - 1);
+		AuVmmngrMapRange((uint64_t*)P2V(x64_read_cr3() & ~(4096 - 1)), phys_addr, out, page_count * 4096,
+			0x04 | 0x80000 | 0x200000);
+		_MmioBase = (uint64_t*)(out + (page_count * 4096));
+		return (void*)out;
+	}
 	for (size_t i = 0; i < page_count; i++)
 		AuMapPage(phys_addr + i * 4096, out + i * 4096, 0x04 | 0x80000 | 0x200000);
 
@@ -355,7 +518,7 @@ uint64_t* AuGetFreePage(bool user, void* ptr) {
 	}
 
 	uint64_t* end = 0;
-	uint64_t *pml4 = (uint64_t*)P2V(x64_read_cr3());
+	uint64_t *pml4 = (uint64_t*)P2V(x64_read_cr3() & ~(4096 - 1));
 
 	/* Walk through every page tables */
 	for (;;) {
@@ -387,43 +550,310 @@ uint64_t* AuGetFreePage(bool user, void* ptr) {
  * @param size_t s -- size of area to be freed
  */
 void AuFreePages(uint64_t virt_addr, bool free_physical, size_t s){
-	const long i1 = x86_64_pml4_index(virt_addr);
+	uint64_t start = VIRT_ADDR_ALIGN(virt_addr);
+	size_t len = PAGE_ALIGN((virt_addr - start) + s);
+	if (!len)
+		len = PAGE_SIZE;
+	uint64_t* pml4 = (uint64_t*)P2V(x64_read_cr3() & ~(4096 - 1));
+	AuVmmngrUnmapRange(pml4, start, len, free_physical ? VMMNGR_UNMAP_FREE_PHYSICAL : 0);
+}
+
+/*
+ * AuVmmngrUnmapRange -- unmaps a range of pages, every
+ * paging table on the way is visited once, user half
+ * tables which become empty are freed. Huge pages fully
+ * inside the range are dropped whole, partially covered
+ * ones are demoted first. TLB entries are dropped in
+ * batches on every cpu using the address space before
+ * any frame is given back
+ * @param pml4 -- virtual address of the root table
+ * @param start -- page aligned starting address
+ * @param len -- length in bytes
+ * @param flags -- VMMNGR_UNMAP_* flags
+ */
+size_t AuVmmngrUnmapRange(uint64_t* pml4, uint64_t start, size_t len, uint8_t flags) {
+	const uint64_t l4_span = 1ULL << 39;
+	const uint64_t l3_span = 1ULL << 30;
+	const uint64_t l2_span = 1ULL << 21;
+	uint64_t end = start + len;
+	/* the root space still carries the boot loader's lower
+	 * half tables, those are never released */
+	bool user = (end <= 0x0000800000000000) && (pml4 != (uint64_t*)P2V((size_t)_RootPaging));
+	size_t unmapped = 0;
+
+	AuTLBBatch batch;
+	AuTLBBatchInit(&batch, V2P((size_t)pml4));
+
+	uint64_t addr = start;
+	while (addr < end) {
+		uint64_t next4 = (addr + l4_span) & ~(l4_span - 1);
+		uint64_t lim4 = (next4 < end && next4 != 0) ? next4 : end;
+		uint64_t* pml4e = &pml4[x86_64_pml4_index(addr)];
+		if (!(*pml4e & X86_64_PAGING_PRESENT)) {
+			addr = lim4;
+			continue;
+		}
+		uint64_t* pdpt = (uint64_t*)P2V(*pml4e & X86_64_PAGING_ADDR_MASK);
+
+		while (addr < lim4) {
+			uint64_t next3 = (addr + l3_span) & ~(l3_span - 1);
+			uint64_t lim3 = next3 < lim4 ? next3 : lim4;
+			uint64_t* pdpte = &pdpt[x86_64_pdp_index(addr)];
+			if (!(*pdpte & X86_64_PAGING_PRESENT)) {
+				addr = lim3;
+				continue;
+			}
+			if (*pdpte & X86_64_PAGING_HUGE) {
+				if (!(addr & (l3_span - 1)) && lim3 - addr == l3_span) {
+					uint64_t frame = *pdpte & X86_64_PAGING_ADDR_MASK & ~(l3_span - 1);
+					*pdpte = 0;
+					unmapped += l3_span / PAGE_SIZE;
+					AuTLBBatchAdd(&batch, addr, 0);
+					if (flags & VMMNGR_UNMAP_FREE_PHYSICAL) {
+						AuTLBBatchFlush(&batch);
+						AuPmmngrFreeBlocks((void*)frame, l3_span / PAGE_SIZE);
+					}
+					addr = lim3;
+					continue;
+				}
+				/* partial unmap, demote and go on below, if that
+				 * fails the huge page stays mapped */
+				if (!AuVmmngrSplitEntry(batch.cr3, pdpte, addr, l3_span)) {
+					addr = lim3;
+					continue;
+				}
+			}
+			uint64_t* pd = (uint64_t*)P2V(*pdpte & X86_64_PAGING_ADDR_MASK);
+
+			while (addr < lim3) {
+				uint64_t next2 = (addr + l2_span) & ~(l2_span - 1);
+				uint64_t lim2 = next2 < lim3 ? next2 : lim3;
+				uint64_t* pde = &pd[x86_64_pd_index(addr)];
+				if (!(*pde & X86_64_PAGING_PRESENT)) {
+					addr = lim2;
+					continue;
+				}
+				if (*pde & X86_64_PAGING_HUGE) {
+					if (!(addr & (l2_span - 1)) && lim2 - addr == l2_span) {
+						uint64_t frame = *pde & X86_64_PAGING_ADDR_MASK & ~(l2_span - 1);
+						*pde = 0;
+						unmapped += l2_span / PAGE_SIZE;
+						AuTLBBatchAdd(&batch, addr, 0);
+						if (flags & VMMNGR_UNMAP_FREE_PHYSICAL) {
+							AuTLBBatchFlush(&batch);
+							AuPmmngrFreeBlocks((void*)frame, l2_span / PAGE_SIZE);
+						}
+						addr = lim2;
+						continue;
+					}
+					if (!AuVmmngrSplitEntry(batch.cr3, pde, addr, l2_span)) {
+						addr = lim2;
+						continue;
+					}
+				}
+				uint64_t* pt = (uint64_t*)P2V(*pde & X86_64_PAGING_ADDR_MASK);
+
+				for (; addr < lim2; addr += PAGE_SIZE) {
+					uint64_t* pte = &pt[x86_64_pt_index(addr)];
+					if (!(*pte & X86_64_PAGING_PRESENT))
+						continue;
+					uint64_t frame = *pte & X86_64_PAGING_ADDR_MASK;
+					*pte = 0;
+					unmapped++;
+					AuTLBBatchAdd(&batch, addr, (flags & VMMNGR_UNMAP_FREE_PHYSICAL) ? frame : 0);
+				}
 
-	for (int i = 0; i < (s / 4096) + 1; i++) {
-		uint64_t *pml4_ = (uint64_t*)P2V(x64_read_cr3());
-		uint64_t *pdpt = (uint64_t*)(P2V(pml4_[x86_64_pml4_index(virt_addr)]) & ~(4096 - 1));
-		uint64_t *pd = (uint64_t*)(P2V(pdpt[x86_64_pdp_index(virt_addr)]) & ~(4096 - 1));
-		uint64_t *pt = (uint64_t*)(P2V(pd[x86_64_pd_index(virt_addr)]) & ~(4096 - 1));
-		uint64_t *page = (uint64_t*)(P2V(pt[x86_64_pt_index(virt_addr)]) & ~(4096 - 1));
+				if (user && AuVmmngrTableEmpty(pt)) {
+					AuTLBBatchAdd(&batch, 0, *pde & X86_64_PAGING_ADDR_MASK);
+					*pde = 0;
+				}
+			}
 
-		if ((pt[x86_64_pt_index(virt_addr)] & X86_64_PAGING_PRESENT) != 0) {
-			pt[x86_64_pt_index(virt_addr)] = 0;
+			if (user && AuVmmngrTableEmpty(pd)) {
+				AuTLBBatchAdd(&batch, 0, *pdpte & X86_64_PAGING_ADDR_MASK);
+				*pdpte = 0;
+			}
 		}
 
-		if (free_physical && page != 0) {
-			AuPmmngrFree((void*)V2P((size_t)page));
+		if (user && AuVmmngrTableEmpty(pdpt)) {
+			AuTLBBatchAdd(&batch, 0, *pml4e & X86_64_PAGING_ADDR_MASK);
+			*pml4e = 0;
 		}
-		
-		virt_addr = virt_addr + static_cast<uint64_t>(i) * 4096;
 	}
 
+	AuTLBBatchFlush(&batch);
+	return unmapped;
+}
+
+/*
+ * AuVmmngrMapRange -- maps a physically contiguous range,
+ * using 1 GiB and 2 MiB pages wherever both addresses are
+ * aligned and the slot is still free, 4K pages elsewhere
+ * @param pml4 -- virtual address of the root table
+ * @param phys_addr -- physical start address
+ * @param virt_addr -- virtual start address
+ * @param len -- length in bytes
+ * @param attrib -- page attributes
+ */
+bool AuVmmngrMapRange(uint64_t* pml4, uint64_t phys_addr, uint64_t virt_addr, size_t len, uint8_t attrib) {
+	uint64_t flags = X86_64_PAGING_PRESENT | X86_64_PAGING_WRITABLE | attrib;
+	uint64_t cr3 = V2P((size_t)pml4);
+	bool mapped_all = true;
+
+	len = PAGE_ALIGN(len);
+	while (len) {
+		uint64_t align = phys_addr | virt_addr;
+		uint64_t span = PAGE_SIZE;
+		uint64_t* entry = NULL;
+
+		if (x86_64_is_cpu_pdpe1gb_supported() && !(align & (X86_64_HUGE_PAGE_SIZE - 1)) &&
+			len >= X86_64_HUGE_PAGE_SIZE) {
+			entry = AuVmmngrWalk(pml4, virt_addr, 3, flags);
+			if (entry && !(*entry & X86_64_PAGING_PRESENT))
+				span = X86_64_HUGE_PAGE_SIZE;
+		}
+
+		if (span == PAGE_SIZE && !(align & (X86_64_LARGE_PAGE_SIZE - 1)) && len >= X86_64_LARGE_PAGE_SIZE) {
+			entry = AuVmmngrWalk(pml4, virt_addr, 2, flags);
+			if (entry && (*entry & X86_64_PAGING_PRESENT) && !(*entry & X86_64_PAGING_HUGE)) {
+				/* an empty table left behind by earlier unmaps
+				 * can make room for the large page */
+				uint64_t table = *entry & X86_64_PAGING_ADDR_MASK;
+				if (AuVmmngrTableEmpty((uint64_t*)P2V(table))) {
+					AuTLBBatch batch;
+					AuTLBBatchInit(&batch, cr3);
+					*entry = 0;
+					AuTLBBatchAdd(&batch, virt_addr, table);
+					AuTLBBatchFlush(&batch);
+				}
+			}
+			if (entry && !(*entry & X86_64_PAGING_PRESENT))
+				span = X86_64_LARGE_PAGE_SIZE;
+		}
+
+		if (span == PAGE_SIZE) {
+			entry = AuVmmngrWalk(pml4, virt_addr, 1, flags);
+			if (entry && !(*entry & X86_64_PAGING_PRESENT))
+				*entry = phys_addr | flags;
+			else
+				mapped_all = false;
+		}
+		else
+			*entry = phys_addr | flags | X86_64_PAGING_HUGE;
+
+		phys_addr += span;
+		virt_addr += span;
+		len -= span;
+	}
+	x64_mfence();
+	return mapped_all;
+}
+
+/*
+ * AuVmmngrPromoteRange -- looks for 2 MiB windows inside a
+ * range that ended up mapping aligned, physically contiguous
+ * frames with equal attributes and turns each of them into a
+ * single large page
+ * @param pml4 -- virtual address of the root table
+ * @param start -- starting address
+ * @param len -- length in bytes
+ */
+size_t AuVmmngrPromoteRange(uint64_t* pml4, uint64_t start, size_t len) {
+	uint64_t cr3 = V2P((size_t)pml4);
+	uint64_t addr = (start + X86_64_LARGE_PAGE_SIZE - 1) & ~(X86_64_LARGE_PAGE_SIZE - 1);
+	uint64_t end = start + len;
+	size_t promoted = 0;
+
+	for (; addr + X86_64_LARGE_PAGE_SIZE <= end; addr += X86_64_LARGE_PAGE_SIZE) {
+		uint64_t e = pml4[x86_64_pml4_index(addr)];
+		if (!(e & X86_64_PAGING_PRESENT))
+			continue;
+		uint64_t* pdpt = (uint64_t*)P2V(e & X86_64_PAGING_ADDR_MASK);
+		e = pdpt[x86_64_pdp_index(addr)];
+		if (!(e & X86_64_PAGING_PRESENT) || (e & X86_64_PAGING_HUGE))
+			continue;
+		uint64_t* pd = (uint64_t*)P2V(e & X86_64_PAGING_ADDR_MASK);
+		uint64_t* pde = &pd[x86_64_pd_index(addr)];
+		if (!(*pde & X86_64_PAGING_PRESENT) || (*pde & X86_64_PAGING_HUGE))
+			continue;
+		if (AuVmmngrPromoteEntry(cr3, pde, addr))
+			promoted++;
+	}
+	return promoted;
+}
+
+/*
+ * AuVmmngrGetEntry -- returns the page table entry of an
+ * address without creating missing tables, huge pages on
+ * the way are split, null if no table covers the address
+ * @param pml4 -- virtual address of the root table
+ * @param virt_addr -- virtual address
+ */
+AuVPage* AuVmmngrGetEntry(uint64_t* pml4, uint64_t virt_addr) {
+	uint64_t cr3 = V2P((size_t)pml4);
+	uint64_t e = pml4[x86_64_pml4_index(virt_addr)];
+	if (!(e & X86_64_PAGING_PRESENT))
+		return NULL;
+	uint64_t* pdpt = (uint64_t*)P2V(e & X86_64_PAGING_ADDR_MASK);
+	uint64_t* pdpte = &pdpt[x86_64_pdp_index(virt_addr)];
+	if (!(*pdpte & X86_64_PAGING_PRESENT))
+		return NULL;
+	if (*pdpte & X86_64_PAGING_HUGE) {
+		if (!AuVmmngrSplitEntry(cr3, pdpte, virt_addr, X86_64_HUGE_PAGE_SIZE))
+			return NULL;
+	}
+	uint64_t* pd = (uint64_t*)P2V(*pdpte & X86_64_PAGING_ADDR_MASK);
+	uint64_t* pde = &pd[x86_64_pd_index(virt_addr)];
+	if (!(*pde & X86_64_PAGING_PRESENT))
+		return NULL;
+	if (*pde & X86_64_PAGING_HUGE) {
+		if (!AuVmmngrSplitEntry(cr3, pde, virt_addr, X86_64_LARGE_PAGE_SIZE))
+			return NULL;
+	}
+	uint64_t* pt = (uint64_t*)P2V(*pde & X86_64_PAGING_ADDR_MASK);
+	return (AuVPage*)&pt[x86_64_pt_index(virt_addr)];
 }
 
 
+/*
+ * AuVmmngrTranslateEx -- walks the given page tables and
+ * returns the physical address backing a virtual address,
+ * including the offset within the page, or 0 if it is not
+ * mapped
+ * @param pml4_ -- virtual address of the root table
+ * @param virt_addr -- virtual address
+ */
+static uint64_t AuVmmngrTranslateEx(uint64_t* pml4_, uint64_t virt_addr) {
+	uint64_t e = pml4_[x86_64_pml4_index(virt_addr)];
+	if (!(e & X86_64_PAGING_PRESENT))
+		return 0;
+	uint64_t* pdpt = (uint64_t*)P2V(e & X86_64_PAGING_ADDR_MASK);
+	e = pdpt[x86_64_pdp_index(virt_addr)];
+	if (!(e & X86_64_PAGING_PRESENT))
+		return 0;
+	if (e & X86_64_PAGING_HUGE)
+		return (e & 0x000FFFFFC0000000) | (virt_addr & (X86_64_HUGE_PAGE_SIZE - 1));
+	uint64_t* pd = (uint64_t*)P2V(e & X86_64_PAGING_ADDR_MASK);
+	e = pd[x86_64_pd_index(virt_addr)];
+	if (!(e & X86_64_PAGING_PRESENT))
+		return 0;
+	if (e & X86_64_PAGING_HUGE)
+		return (e & 0x000FFFFFFFE00000) | (virt_addr & (X86_64_LARGE_PAGE_SIZE - 1));
+	uint64_t* pt = (uint64_t*)P2V(e & X86_64_PAGING_ADDR_MASK);
+	e = pt[x86_64_pt_index(virt_addr)];
+	if (!(e & X86_64_PAGING_PRESENT))
+		return 0;
+	return (e & X86_64_PAGING_ADDR_MASK) | (virt_addr & (PAGE_SIZE - 1));
+}
+
 /*
 * AuGetPhysicalAddress -- translates logical address
 * to its physical address
 * @param virt_addr -- virtual address
 */
 void* AuGetPhysicalAddress(uint64_t virt_addr){
-
-	const long i1 = x86_64_pml4_index(virt_addr);
-
-	uint64_t *pml4_ = (uint64_t*)P2V(x64_read_cr3());
-	uint64_t *pdpt = (uint64_t*)(P2V(pml4_[x86_64_pml4_index(virt_addr)]) & ~(4096 - 1));
-	uint64_t *pd = (uint64_t*)(P2V(pdpt[x86_64_pdp_index(virt_addr)]) & ~(4096 - 1));
-	uint64_t *pt = (uint64_t*)(P2V(pd[x86_64_pd_index(virt_addr)]) & ~(4096 - 1));
-	uint64_t *page = (uint64_t*)(P2V(pt[x86_64_pt_index(virt_addr)]) & ~(4096 - 1));
+	uint64_t *pml4_ = (uint64_t*)P2V(x64_read_cr3() & ~(4096 - 1));
+	uint64_t *page = (uint64_t*)(P2V(AuVmmngrTranslateEx(pml4_, virt_addr)) & ~(4096 - 1));
 
 	if (page)
 		return page;
@@ -439,14 +869,7 @@ void* AuGetPhysicalAddress(uint64_t virt_addr){
 * @param virt_addr -- virtual address 
 */
 void* AuGetPhysicalAddressEx(uint64_t* cr3, uint64_t virt_addr){
-
-	const long i1 = x86_64_pml4_index(virt_addr);
-
-	uint64_t *pml4_ = cr3;
-	uint64_t *pdpt = (uint64_t*)(P2V(pml4_[x86_64_pml4_index(virt_addr)]) & ~(4096 - 1));
-	uint64_t *pd = (uint64_t*)(P2V(pdpt[x86_64_pdp_index(virt_addr)]) & ~(4096 - 1));
-	uint64_t *pt = (uint64_t*)(P2V(pd[x86_64_pd_index(virt_addr)]) & ~(4096 - 1));
-	uint64_t *page = (uint64_t*)(P2V(pt[x86_64_pt_index(virt_addr)]) & ~(4096 - 1));
+	uint64_t *page = (uint64_t*)(P2V(AuVmmngrTranslateEx(cr3, virt_addr)) & ~(4096 - 1));
 
 	if (page)
 		return page;
@@ -455,6 +878,44 @@ void* AuGetPhysicalAddressEx(uint64_t* cr3, uint64_t virt_addr){
 
 }
 
+/*
+ * AuVmmngrTranslate -- walks the current page tables and
+ * returns the physical address backing a virtual address,
+ * including the offset within the page, or 0 if it is not
+ * mapped
+ * @param virt_addr -- virtual address
+ */
+static uint64_t AuVmmngrTranslate(uint64_t virt_addr) {
+	return AuVmmngrTranslateEx((uint64_t*)P2V(x64_read_cr3() & ~(4096 - 1)), virt_addr);
+}
+
+/*
+ * AuVmmngrGetPhysicalRun -- returns the physical address
+ * backing a virtual address together with the number of
+ * bytes from there on that are physically contiguous, used
+ * by drivers to DMA straight into caller buffers
+ * @param virt_addr -- virtual address
+ * @param max_len -- maximum length of interest
+ * @param run_len -- pointer receiving the contiguous length
+ */
+uint64_t AuVmmngrGetPhysicalRun(uint64_t virt_addr, size_t max_len, size_t* run_len) {
+	*run_len = 0;
+	uint64_t phys = AuVmmngrTranslate(virt_addr);
+	if (!phys)
+		return 0;
+	size_t len = PAGE_SIZE - (virt_addr & (PAGE_SIZE - 1));
+	while (len < max_len) {
+		uint64_t next = AuVmmngrTranslate(virt_addr + len);
+		if (next != phys + len)
+			break;
+		len += PAGE_SIZE;
+	}
+	if (len > max_len)
+		len = max_len;
+	*run_len = len;
+	return phys;
+}
+
 /*
  * AuCreateVirtualAddressSpace -- creates a new virtual address
  * space and return the new address space in a linear virtual
@@ -503,10 +964,10 @@ void AuVmmngrInitialize() {
  */
 void AuVmmngrBootFree() {
 #ifdef ARCH_X64
-	uint64_t* cr3 = (uint64_t*)x64_read_cr3();
+	uint64_t* cr3 = (uint64_t*)(x64_read_cr3() & ~(4096 - 1));
 	for (int i = 0; i < 256; i++)
 		cr3[i] = 0;
-	x64_write_cr3((uint64_t)cr3);
+	x64_write_cr3(x64_read_cr3());
 #endif
 }
 
@@ -526,6 +987,12 @@ void AuVmmngrCloneAddressSpace(uint64_t *destcr3, uint64_t* srccr3){
 			/* inside page directory pointer */
 			for (int j = 0; j < 512; ++j) {
 				if ((pdp_in[j] & X86_64_PAGING_PRESENT)) {
+					/* clones are built from 4K pages, a huge page
+					 * that can't be split is not cloned */
+					if ((pdp_in[j] & X86_64_PAGING_HUGE) &&
+						!AuVmmngrSplitEntry(V2P((size_t)srccr3), &pdp_in[j], ((uint64_t)i << 39) | ((uint64_t)j << 30),
+						X86_64_HUGE_PAGE_SIZE))
+						continue;
 					uint64_t* pd_new = (uint64_t*)P2V((size_t)AuPmmngrAlloc());
 					memset(pd_new, 0, PAGE_SIZE);
 					pdp_new[j] = V2P((size_t)pd_new) | X86_64_PAGING_PRESENT | X86_64_PAGING_USER;
@@ -534,6 +1001,10 @@ void AuVmmngrCloneAddressSpace(uint64_t *destcr3, uint64_t* srccr3){
 					/* inside page directory*/
 					for (int k = 0; k < 512; ++k) {
 						if ((pd_in[k] & X86_64_PAGING_PRESENT)) {
+							if ((pd_in[k] & X86_64_PAGING_HUGE) &&
+								!AuVmmngrSplitEntry(V2P((size_t)srccr3), &pd_in[k], ((uint64_t)i << 39) | ((uint64_t)j << 30) |
+								((uint64_t)k << 21), X86_64_LARGE_PAGE_SIZE))
+								continue;
 							uint64_t* pt_new = (uint64_t*)P2V((size_t)AuPmmngrAlloc());
 							memset(pt_new, 0, PAGE_SIZE);
 							pd_new[k] = V2P((size_t)pt_new) | X86_64_PAGING_PRESENT | X86_64_PAGING_USER;
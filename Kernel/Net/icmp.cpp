@@ -264,7 +264,7 @@ int CreateICMPSocket() {
 	node->device = sock;
 	node->close = AuICMPFileClose;
 	node->iocontrol = SocketIOControl;
-	proc->fds[fd] = node;
+	AuProcessSetFileDesc(proc, fd, node);
 	current_icmp_sock = sock;
 	SeTextOut("ICMP Socket created \r\n");
 	return fd;
@@ -130,7 +130,7 @@ int AuSocketSetOpt(int sockfd, int level, int optname, const void* optval, sockl
 		if (!proc)
 			return -1;
 	}
-	AuVFSNode* node = proc->fds[sockfd];
+	AuVFSNode* node = AuProcessGetFileNode(proc, sockfd);
 	AuSocket* sock = (AuSocket*)node->device;
 	switch (level)
 	{
@@ -319,7 +319,7 @@ int AuCreateRawSocket(int type, int protocol){
 	node->device = sock;
 	node->close = AuRawSocketClose;
 	node->iocontrol = SocketIOControl;
-	proc->fds[fd] = node;
+	AuProcessSetFileDesc(proc, fd, node);
 	return fd;
 }
 
@@ -367,7 +367,7 @@ int CreateTCPSocket() {
 	node->device = sock;
 	node->close = AuTCPFileClose;
 	node->iocontrol = SocketIOControl;
-	proc->fds[fd] = node;
+	AuProcessSetFileDesc(proc, fd, node);
 	SeTextOut("TCP Socket created \r\n");
 	return fd;
 }
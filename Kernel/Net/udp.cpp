@@ -255,7 +255,7 @@ int CreateUDPSocket() {
 	node->device = sock;
 	node->close = AuUDPFileClose;
 	node->iocontrol = SocketIOControl;
-	proc->fds[fd] = node;
+	AuProcessSetFileDesc(proc, fd, node);
 	SeTextOut("UDP Socket created \r\n");
 	return fd;
 }
@@ -32,6 +32,7 @@
 #include <Mm\pmmngr.h>
 #include <Mm\vmmngr.h>
 #include <Mm\kmalloc.h>
+#include <Mm\vmarea.h>
 #include <process.h>
 #include <Hal\x86_64_sched.h>
 #include <Hal\serial.h>
@@ -84,7 +85,7 @@ int OpenFile(char* filename, int mode) {
 		if (file->open)
 			file->open(file, NULL);
 
-	current_proc->fds[fd] = file;
+	AuProcessSetFileDesc(current_proc, fd, file);
 	return fd;
 }
 
@@ -94,7 +95,7 @@ int OpenFile(char* filename, int mode) {
  * @param fd -- File descriptor
  * @param offset -- offset in bytes
  */
-int FileSetOffset(int fd, size_t offset) {
+int FileSetOffset(int fd, uint64_t offset) {
 	x64_cli();
 	AuThread* current_thr = AuGetCurrentThread();
 	if (!current_thr)
@@ -106,22 +107,91 @@ int FileSetOffset(int fd, size_t offset) {
 			return -1;
 	}
 
-	AuVFSNode* file = current_proc->fds[fd];
+	AuVFSNode* file = AuProcessGetFileNode(current_proc, fd);
 	if (!file)
 		return -1;
 	if (!((file->flags & FS_FLAG_FILE_SYSTEM) || (file->flags & FS_FLAG_DEVICE) || (file->flags & FS_FLAG_PIPE)
 		|| (file->flags & FS_FLAG_DIRECTORY) || (file->flags & FS_FLAG_TTY))){
-		AuVFSNode* fsys = AuVFSFind("/");
+		AuVFSNode* fsys = (AuVFSNode*)file->device;
 		if (!fsys)
 			return -1;
 		size_t block = AuVFSGetBlockFor(fsys, file, offset);
 		file->current = block;
+		file->eof = 0;
+	}
+	file->pos = offset;
+
+	return 0;
+}
+
+/*
+ * FileReadNode -- dispatches a read to the subsystem
+ * owning the opened file
+ * @param file -- Pointer to the opened file
+ * @param buffer -- buffer where to put the data
+ * @param length -- length in bytes
+ */
+static size_t FileReadNode(AuVFSNode* file, void* buffer, size_t length) {
+	size_t ret_bytes = 0;
+	/* every general file will contain its
+	 * file system node as device */
+	AuVFSNode* fsys = (AuVFSNode*)file->device;
+	if (file->flags & FS_FLAG_GENERAL && !(file->flags & FS_FLAG_TTY)) {
+		/* file system moves the data straight into
+		 * caller's buffer */
+		ret_bytes = AuVFSNodeRead(fsys, file, (uint64_t*)buffer, length);
+	}
+	if (file->flags & FS_FLAG_DEVICE){
+		/* devfs will handle*/
+		if (file->read)
+			ret_bytes = file->read(file, file, (uint64_t*)buffer, length);
+	}
+
+	if (file->flags & FS_FLAG_TTY) {
+		if (file->read)
+			ret_bytes = file->read(file, file, (uint64_t*)buffer, length);
+	}
+	if (file->flags == FS_FLAG_PIPE) {
+		/* ofcourse, pipe subsystem will handle */
+		if (file->read)
+			ret_bytes = file->read(file, file, (uint64_t*)buffer, length);
+	}
+	return ret_bytes;
+}
+
+/*
+ * FileWriteNode -- dispatches a write to the subsystem
+ * owning the opened file
+ * @param file -- Pointer to the opened file
+ * @param buffer -- buffer to write
+ * @param length -- length in bytes
+ */
+static size_t FileWriteNode(AuVFSNode* file, void* buffer, size_t length) {
+	/* every general file will contain its
+	* file system node as device */
+	AuVFSNode* fsys = (AuVFSNode*)file->device;
+
+	if (file->flags & FS_FLAG_GENERAL && !(file->flags & FS_FLAG_TTY))
+		return AuVFSNodeWrite(fsys, file, (uint64_t*)buffer, length);
+
+	if (file->flags & FS_FLAG_TTY) {
+		if (file->write)
+			return file->write(file, file, (uint64_t*)buffer, length);
 	}
-	else
-		file->pos = offset;
 
+	if (file->flags & FS_FLAG_DEVICE) {
+		if (file->write) {
+			return file->write(fsys, file, (uint64_t*)buffer, length);
+		}
+	}
+
+	if (file->flags & FS_FLAG_PIPE) {
+		if (file->write)
+			return file->write(file, file, (uint64_t*)buffer, length);
+	}
 	return 0;
 }
+
 /*
  * ReadFile -- reads a file into given buffer
  * @param fd -- file descriptor
@@ -146,47 +216,217 @@ size_t ReadFile(int fd, void* buffer, size_t length) {
 			return 0;
 	}
 	
-	AuVFSNode* file = current_proc->fds[fd];
-	uint64_t* aligned_buffer = (uint64_t*)buffer;
+	AuVFSNode* file = AuProcessGetFileNode(current_proc, fd);
+	if (!file)
+		return 0;
+	/* disk may transfer straight into these pages, keep
+	 * them mapped until it is done */
+	AuVMPin* pin = AuVMAreaPin(current_proc, (size_t)buffer, length);
+	size_t ret_bytes = FileReadNode(file, buffer, length);
+	AuVMAreaUnpin(current_proc, pin);
+	return ret_bytes;
+}
+
 
-	//SeTextOut("Reading from file -> %d -> %x \r\n", fd, file);
+/*
+ * WriteFile -- write system call
+ * @param fd -- file descriptor
+ * @param buffer -- buffer to write
+ * @param length -- length in bytes
+ */
+size_t WriteFile(int fd, void* buffer, size_t length) {
+	x64_cli();
+	if (fd == -1)
+		return 0;
+	if (!buffer)
+		return 0;
+	if (!length)
+		return 0;
+	AuThread* current_thr = AuGetCurrentThread();
+	if (!current_thr)
+		return 0;
+	AuProcess* current_proc = AuProcessFindThread(current_thr);
+	if (!current_proc) {
+		current_proc = AuProcessFindSubThread(current_thr);
+		if (!current_proc) 
+			return 0;
+	}
+	AuVFSNode* file = AuProcessGetFileNode(current_proc, fd);
 	if (!file)
 		return 0;
+	AuVMPin* pin = AuVMAreaPin(current_proc, (size_t)buffer, length);
+	size_t write_bytes = FileWriteNode(file, buffer, length);
+	AuVMAreaUnpin(current_proc, pin);
+	return write_bytes;
+}
+
+/*
+ * ReadFileV -- reads a file into multiple buffers
+ * in one call, buffers are filled in order and the
+ * read stops at first short transfer
+ * @param fd -- file descriptor
+ * @param iov -- array of buffer segments
+ * @param iovcnt -- number of segments
+ */
+size_t ReadFileV(int fd, AuIOVec* iov, int iovcnt) {
+	x64_cli();
+	if (fd == -1)
+		return 0;
+	if (!iov)
+		return 0;
+	if (iovcnt <= 0 || iovcnt > AU_IOV_MAX)
+		return 0;
+	AuThread* current_thr = AuGetCurrentThread();
+	if (!current_thr)
+		return 0;
+	AuProcess* current_proc = AuProcessFindThread(current_thr);
+	if (!current_proc) {
+		current_proc = AuProcessFindSubThread(current_thr);
+		if (!current_proc)
+			return 0;
+	}
+	AuVFSNode* file = AuProcessGetFileNode(current_proc, fd);
+	if (!file)
+		return 0;
+
 	size_t ret_bytes = 0;
-	
-	/* every general file will contain its
-	 * file system node as device */
-	AuVFSNode* fsys = (AuVFSNode*)file->device;
-	if (file->flags & FS_FLAG_GENERAL && !(file->flags & FS_FLAG_TTY)) {
-		ret_bytes = AuVFSNodeRead(fsys, file,aligned_buffer, length);
+	for (int i = 0; i < iovcnt; i++) {
+		if (!iov[i].base || !iov[i].len)
+			continue;
+		AuVMPin* pin = AuVMAreaPin(current_proc, (size_t)iov[i].base, iov[i].len);
+		size_t bytes = FileReadNode(file, iov[i].base, iov[i].len);
+		AuVMAreaUnpin(current_proc, pin);
+		ret_bytes += bytes;
+		if (bytes < iov[i].len)
+			break;
 	}
-	if (file->flags & FS_FLAG_DEVICE){
-		/* devfs will handle*/
-		if (file->read)
-			ret_bytes = file->read(file, file, (uint64_t*)buffer, length);
+	return ret_bytes;
+}
+
+/*
+ * WriteFileV -- writes multiple buffers to a file
+ * in one call, stops at first short transfer
+ * @param fd -- file descriptor
+ * @param iov -- array of buffer segments
+ * @param iovcnt -- number of segments
+ */
+size_t WriteFileV(int fd, AuIOVec* iov, int iovcnt) {
+	x64_cli();
+	if (fd == -1)
+		return 0;
+	if (!iov)
+		return 0;
+	if (iovcnt <= 0 || iovcnt > AU_IOV_MAX)
+		return 0;
+	AuThread* current_thr = AuGetCurrentThread();
+	if (!current_thr)
+		return 0;
+	AuProcess* current_proc = AuProcessFindThread(current_thr);
+	if (!current_proc) {
+		current_proc = AuProcessFindSubThread(current_thr);
+		if (!current_proc)
+			return 0;
 	}
+	AuVFSNode* file = AuProcessGetFileNode(current_proc, fd);
+	if (!file)
+		return 0;
 
-	if (file->flags & FS_FLAG_TTY) {
-		if (file->read)
-			ret_bytes = file->read(file, file, (uint64_t*)aligned_buffer, length);
+	size_t ret_bytes = 0;
+	for (int i = 0; i < iovcnt; i++) {
+		if (!iov[i].base || !iov[i].len)
+			continue;
+		AuVMPin* pin = AuVMAreaPin(current_proc, (size_t)iov[i].base, iov[i].len);
+		size_t bytes = FileWriteNode(file, iov[i].base, iov[i].len);
+		AuVMAreaUnpin(current_proc, pin);
+		ret_bytes += bytes;
+		if (bytes < iov[i].len)
+			break;
 	}
-	if (file->flags == FS_FLAG_PIPE) {
-		/* ofcourse, pipe subsystem will handle */
-		if (file->read)
-			ret_bytes = file->read(file, file, (uint64_t*)buffer, length);
+	return ret_bytes;
+}
+
+/*
+ * FileSync -- writes out data of a file held
+ * back by its file system, syncing a file system
+ * node syncs the whole volume
+ * @param fd -- file descriptor
+ */
+int FileSync(int fd) {
+	x64_cli();
+	if (fd == -1)
+		return -1;
+	AuThread* current_thr = AuGetCurrentThread();
+	if (!current_thr)
+		return -1;
+	AuProcess* current_proc = AuProcessFindThread(current_thr);
+	if (!current_proc) {
+		current_proc = AuProcessFindSubThread(current_thr);
+		if (!current_proc)
+			return -1;
 	}
+	AuVFSNode* file = AuProcessGetFileNode(current_proc, fd);
+	if (!file)
+		return -1;
+	if (file->flags & FS_FLAG_FILE_SYSTEM)
+		return AuVFSNodeSync(file, NULL);
+	if (!(file->flags & FS_FLAG_GENERAL) || (file->flags & FS_FLAG_DEVICE) || (file->flags & FS_FLAG_TTY))
+		return 0;
+	return AuVFSNodeSync((AuVFSNode*)file->device, file);
+}
 
-	return ret_bytes;
+/*
+ * FileDup -- duplicates a file descriptor, both
+ * descriptors share the file and its offset
+ * @param fd -- file descriptor to duplicate
+ * @param newfd -- target descriptor, -1 for the
+ * lowest free one
+ */
+int FileDup(int fd, int newfd) {
+	x64_cli();
+	if (fd == -1)
+		return -1;
+	AuThread* current_thr = AuGetCurrentThread();
+	if (!current_thr)
+		return -1;
+	AuProcess* current_proc = AuProcessFindThread(current_thr);
+	if (!current_proc) {
+		current_proc = AuProcessFindSubThread(current_thr);
+		if (!current_proc)
+			return -1;
+	}
+	return AuProcessDupFileDesc(current_proc, fd, newfd);
 }
 
+/*
+ * FileGetPositionalCursor -- prepares a private copy of a
+ * general file positioned at given offset, so that
+ * positional i/o never touches the shared file position
+ * @param file -- Pointer to the opened file
+ * @param cursor -- Pointer to the private copy
+ * @param offset -- offset in bytes
+ */
+static bool FileGetPositionalCursor(AuVFSNode* file, AuVFSNode* cursor, uint64_t offset) {
+	if (!(file->flags & FS_FLAG_GENERAL) || (file->flags & FS_FLAG_TTY))
+		return false;
+	AuVFSNode* fsys = (AuVFSNode*)file->device;
+	if (!fsys)
+		return false;
+	memcpy(cursor, file, sizeof(AuVFSNode));
+	cursor->current = AuVFSGetBlockFor(fsys, file, offset);
+	cursor->pos = offset;
+	cursor->eof = 0;
+	return true;
+}
 
 /*
- * WriteFile -- write system call
+ * ReadFileAt -- reads a file from given byte offset
+ * without using or updating the file position
  * @param fd -- file descriptor
- * @param buffer -- buffer to write
+ * @param buffer -- buffer where to put the data
  * @param length -- length in bytes
+ * @param offset -- offset in bytes to read from
  */
-size_t WriteFile(int fd, void* buffer, size_t length) {
+size_t ReadFileAt(int fd, void* buffer, size_t length, uint64_t offset) {
 	x64_cli();
 	if (fd == -1)
 		return 0;
@@ -200,42 +440,70 @@ size_t WriteFile(int fd, void* buffer, size_t length) {
 	AuProcess* current_proc = AuProcessFindThread(current_thr);
 	if (!current_proc) {
 		current_proc = AuProcessFindSubThread(current_thr);
-		if (!current_proc) 
+		if (!current_proc)
 			return 0;
 	}
-	AuVFSNode* file = current_proc->fds[fd];
-	uint8_t* aligned_buffer = (uint8_t*)buffer;
+
+	AuVFSNode* file = AuProcessGetFileNode(current_proc, fd);
 	if (!file)
 		return 0;
-	size_t write_bytes = 0;
-	size_t ret_bytes;
-	/* every general file will contain its
-	* file system node as device */
+
+	AuVFSNode cursor;
+	if (!FileGetPositionalCursor(file, &cursor, offset))
+		return 0;
+
 	AuVFSNode* fsys = (AuVFSNode*)file->device;
+	AuVMPin* pin = AuVMAreaPin(current_proc, (size_t)buffer, length);
+	size_t ret_bytes = AuVFSNodeRead(fsys, &cursor, (uint64_t*)buffer, length);
+	AuVMAreaUnpin(current_proc, pin);
+	return ret_bytes;
+}
 
-	if (file->flags & FS_FLAG_GENERAL && !(file->flags & FS_FLAG_TTY)) {
-		uint64_t* buff = (uint64_t*)P2V((size_t)AuPmmngrAlloc());
-		memset(buff, 0, PAGE_SIZE);
-		memcpy(buff,aligned_buffer, PAGE_SIZE);
-		AuVFSNodeWrite(fsys, file, buff, length);
-		AuPmmngrFree((void*)V2P((size_t)buff));
+/*
+ * WriteFileAt -- writes to a file at given byte offset
+ * without using or updating the file position
+ * @param fd -- file descriptor
+ * @param buffer -- buffer to write
+ * @param length -- length in bytes
+ * @param offset -- offset in bytes to write at
+ */
+size_t WriteFileAt(int fd, void* buffer, size_t length, uint64_t offset) {
+	x64_cli();
+	if (fd == -1)
+		return 0;
+	if (!buffer)
+		return 0;
+	if (!length)
+		return 0;
+	AuThread* current_thr = AuGetCurrentThread();
+	if (!current_thr)
+		return 0;
+	AuProcess* current_proc = AuProcessFindThread(current_thr);
+	if (!current_proc) {
+		current_proc = AuProcessFindSubThread(current_thr);
+		if (!current_proc)
+			return 0;
 	}
 
-	if (file->flags & FS_FLAG_TTY) {
-		if (file->write)
-			return file->write(file, file, (uint64_t*)buffer, length);
-	}
+	AuVFSNode* file = AuProcessGetFileNode(current_proc, fd);
+	if (!file)
+		return 0;
 
-	if (file->flags & FS_FLAG_DEVICE) {
-		if (file->write) {
-			return file->write(fsys, file, (uint64_t*)buffer, length);
-		}
-	}
+	AuVFSNode cursor;
+	if (!FileGetPositionalCursor(file, &cursor, offset))
+		return 0;
 
-	if (file->flags & FS_FLAG_PIPE) {
-		if (file->write)
-			return file->write(file, file, (uint64_t*)buffer, length);
-	}
+	AuVFSNode* fsys = (AuVFSNode*)file->device;
+	size_t write_bytes = 0;
+	AuVMPin* pin = AuVMAreaPin(current_proc, (size_t)buffer, length);
+	if (fsys->write)
+		write_bytes = fsys->write(fsys, &cursor, (uint64_t*)buffer, length);
+	AuVMAreaUnpin(current_proc, pin);
+
+	/* only the size is shared back, position stays untouched */
+	if (cursor.size > file->size)
+		file->size = cursor.size;
+	return write_bytes;
 }
 
 /*
@@ -306,13 +574,27 @@ int CloseFile(int fd) {
 			return 0;
 	}
 
-	AuVFSNode* file = current_proc->fds[fd];
+	AuVFSNode* file = AuProcessGetFileNode(current_proc, fd);
+	if (!file)
+		return -1;
 	if (file->flags & FS_FLAG_FILE_SYSTEM){
 		SeTextOut("Closing fs -> %s \r\n", file->filename);
-		current_proc->fds[fd] = 0;
+		AuProcessRemoveFileDesc(current_proc, fd);
 		return -1;
 	}
+
+	/* other descriptors still share this file,
+	 * only drop this descriptor */
+	if (file->fileCopyCount > 0) {
+		file->fileCopyCount -= 1;
+		AuProcessRemoveFileDesc(current_proc, fd);
+		return 0;
+	}
 	if (file->flags & FS_FLAG_GENERAL){
+		/* let the file system write out what
+		 * it still holds for the file */
+		if (!(file->flags & FS_FLAG_DEVICE) && !(file->flags & FS_FLAG_TTY))
+			AuVFSNodeClose((AuVFSNode*)file->device, file);
 		kfree(file);
 	}
 	
@@ -326,7 +608,7 @@ int CloseFile(int fd) {
 			file->close(file, file);
 	}
 
-	current_proc->fds[fd] = 0;
+	AuProcessRemoveFileDesc(current_proc, fd);
 	return 0;
 }
 
@@ -349,7 +631,7 @@ int FileIoControl(int fd, int code, void* arg) {
 		if (!current_proc)
 			return 0;
 	}
-	AuVFSNode* file = current_proc->fds[fd];
+	AuVFSNode* file = AuProcessGetFileNode(current_proc, fd);
 
 	if (!file)
 		return -1;
@@ -379,13 +661,14 @@ int FileStat(int fd, void* buf) {
 		if (!current_proc)
 			return 0;
 	}
-	AuVFSNode* file = current_proc->fds[fd];
+	AuVFSNode* file = AuProcessGetFileNode(current_proc, fd);
 	if (!file)
 		return -1;
 
 	AuFileStatus *status = (AuFileStatus*)buf;
 	status->current_block = file->current;
 	status->size = file->size;
+	status->pos = file->pos;
 	status->filemode = file->flags;
 	status->eof = file->eof;
 	status->start_block = file->first_block;
@@ -425,7 +708,7 @@ int OpenDir(char* filename) {
 	if (fd == -1)
 		return -1;
 
-	current_proc->fds[fd] = dirfile;
+	AuProcessSetFileDesc(current_proc, fd, dirfile);
 	SeTextOut("dir opening -> %s , %x \r\n", dirfile->filename, dirfile);
 	return fd;
 }
@@ -455,7 +738,7 @@ int ReadDir(int dirfd, void* dirent) {
 
 	AuDirectoryEntry* dire_ = (AuDirectoryEntry*)dirent;
 
-	AuVFSNode* dirfile = current_proc->fds[dirfd];
+	AuVFSNode* dirfile = AuProcessGetFileNode(current_proc, dirfd);
 	if (!dirfile)
 		return -1;
 	AuVFSNode* fsys = (AuVFSNode*)dirfile->device;
@@ -481,8 +764,8 @@ int ProcessGetFileDesc(const char* filename) {
 		if (!currproc)
 			return -1;
 	}
-	for (int i = 0; i < FILE_DESC_PER_PROCESS; i++) {
-		AuVFSNode* file = currproc->fds[i];
+	for (int i = 0; i < currproc->max_fds; i++) {
+		AuVFSNode* file = AuProcessGetFileNode(currproc, i);
 		if (file) {
 			if (strcmp(filename, file->filename) == 0) {
 				return i;
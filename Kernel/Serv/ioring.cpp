@@ -0,0 +1,303 @@
+/**
+* BSD 2-Clause License
+*
+* Copyright (c) 2022-2023, Manas Kamal Choudhury
+* All rights reserved.
+*
+* Redistribution and use in source and binary forms, with or without
+* modification, are permitted provided that the following conditions are met:
+*
+* 1. Redistributions of source code must retain the above copyright notice, this
+*    list of conditions and the following disclaimer.
+*
+* 2. Redistributions in binary form must reproduce the above copyright notice,
+*    this list of conditions and the following disclaimer in the documentation
+*    and/or other materials provided with the distribution.
+*
+* THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+* AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+* IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+* DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE
+* FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+* DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR
+* SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER
+* CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY,
+* OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+* OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+*
+**/
+
+#include <Serv\ioring.h>
+#include <Serv\sysserv.h>
+#include <Mm\kmalloc.h>
+#include <Mm\vmmngr.h>
+#include <Mm\pmmngr.h>
+#include <Mm\vmarea.h>
+#include <Hal\x86_64_hal.h>
+#include <Hal\x86_64_lowlevel.h>
+#include <Hal\serial.h>
+#include <aurora.h>
+#include <string.h>
+#include <_null.h>
+
+/*
+ * Every process may register one submission/completion
+ * ring living in its own memory. IORingEnter consumes a
+ * batch of submissions per kernel entry, entries flagged
+ * IORING_SQE_ASYNC are handed to a per process kernel
+ * worker which runs in the process address space, so it
+ * may block on pipes or sockets while the application
+ * keeps running. Completions are reaped by the process
+ * straight from the ring.
+ */
+
+static AuProcess* AuIORingGetProcess(AuThread* thr) {
+	AuProcess* proc = AuProcessFindThread(thr);
+	if (!proc)
+		proc = AuProcessFindSubThread(thr);
+	return proc;
+}
+
+/*
+ * AuIORingExecute -- run one submission through the
+ * regular system call handlers
+ * @param sqe -- submission entry
+ */
+static int64_t AuIORingExecute(AuIORingSQE* sqe) {
+	switch (sqe->opcode) {
+	case IORING_OP_NOP:
+		return 0;
+	case IORING_OP_READ:
+		if (sqe->offset == IORING_OFFSET_CURRENT)
+			return ReadFile(sqe->fd, (void*)sqe->addr, sqe->len);
+		return ReadFileAt(sqe->fd, (void*)sqe->addr, sqe->len, sqe->offset);
+	case IORING_OP_WRITE:
+		if (sqe->offset == IORING_OFFSET_CURRENT)
+			return WriteFile(sqe->fd, (void*)sqe->addr, sqe->len);
+		return WriteFileAt(sqe->fd, (void*)sqe->addr, sqe->len, sqe->offset);
+	case IORING_OP_READV:
+		return ReadFileV(sqe->fd, (AuIOVec*)sqe->addr, (int)sqe->len);
+	case IORING_OP_WRITEV:
+		return WriteFileV(sqe->fd, (AuIOVec*)sqe->addr, (int)sqe->len);
+	case IORING_OP_FSYNC:
+		return FileSync(sqe->fd);
+	case IORING_OP_CLOSE:
+		return CloseFile(sqe->fd);
+	case IORING_OP_IOCTL:
+		return FileIoControl(sqe->fd, (int)sqe->len, (void*)sqe->addr);
+	case IORING_OP_SEND:
+		return NetSend(sqe->fd, (msghdr*)sqe->addr, (int)sqe->len);
+	case IORING_OP_RECV:
+		return NetReceive(sqe->fd, (msghdr*)sqe->addr, (int)sqe->len);
+	case IORING_OP_SHM_OBTAIN:
+		return (int64_t)ObtainSharedMem((uint16_t)sqe->fd, (void*)sqe->addr, (int)sqe->len);
+	case IORING_OP_SHM_UNMAP:
+		UnmapSharedMem((uint16_t)sqe->fd);
+		return 0;
+	default:
+		return -1;
+	}
+}
+
+/*
+ * AuIORingPost -- post a completion, ring lock
+ * must be held
+ * @param ring -- Pointer to ring
+ * @param userData -- user data of the submission
+ * @param result -- result of the operation
+ */
+static void AuIORingPost(AuIORing* ring, uint64_t userData, int64_t result) {
+	uint32_t tail = ring->hdr->cqTail;
+	AuIORingCQE* cqe = &ring->cqes[tail & ring->cqMask];
+	cqe->userData = userData;
+	cqe->result = result;
+	ring->hdr->cqTail = tail + 1;
+	ring->inflight--;
+
+	if (ring->waiter) {
+		uint32_t ready = ring->hdr->cqTail - ring->hdr->cqHead;
+		if (ready >= ring->waitFor || ring->inflight == 0) {
+			if (ring->waiter->state == THREAD_STATE_BLOCKED)
+				AuUnblockThread(ring->waiter);
+			ring->waiter = NULL;
+		}
+	}
+}
+
+/*
+ * AuIORingWorker -- executes asynchronous submissions
+ * of a process
+ */
+void AuIORingWorker(uint64_t) {
+	AuThread* thr = AuGetCurrentThread();
+	AuProcess* proc = (AuProcess*)thr->procSlot;
+	AuIORing* ring = (AuIORing*)proc->ioring;
+	while (1) {
+		x64_cli();
+		AuAcquireSpinlock(ring->lock);
+		if (ring->pendingCount == 0) {
+			ring->workerIdle = true;
+			AuBlockThread(thr);
+			AuReleaseSpinlock(ring->lock);
+			AuForceScheduler();
+			continue;
+		}
+		AuIORingSQE sqe;
+		memcpy(&sqe, &ring->pending[ring->pendingHead], sizeof(AuIORingSQE));
+		ring->pendingHead = (ring->pendingHead + 1) & ring->cqMask;
+		ring->pendingCount--;
+		AuReleaseSpinlock(ring->lock);
+
+		int64_t result = AuIORingExecute(&sqe);
+
+		x64_cli();
+		AuAcquireSpinlock(ring->lock);
+		AuIORingPost(ring, sqe.userData, result);
+		AuReleaseSpinlock(ring->lock);
+	}
+}
+
+/*
+ * AuIORingStartWorker -- creates the worker thread of
+ * a process
+ * @param proc -- Pointer to process
+ * @param ring -- Pointer to ring
+ */
+static void AuIORingStartWorker(AuProcess* proc, AuIORing* ring) {
+	AuThread* thr = AuCreateKthread(AuIORingWorker, CreateKernelStack(proc, proc->cr3),
+		V2P((size_t)proc->cr3), "ioring");
+	thr->priviledge |= THREAD_LEVEL_SUBTHREAD;
+	thr->procSlot = proc;
+	/* cleaned up with the other sub threads */
+	AuProcessAddThread(proc, thr);
+	ring->worker = thr;
+}
+
+/*
+ * IORingSetup -- register ring memory of current
+ * process
+ * @param mem -- page aligned ring memory
+ * @param entries -- number of sq entries, power of two
+ */
+int IORingSetup(void* mem, uint32_t entries) {
+	x64_cli();
+	AuThread* thr = AuGetCurrentThread();
+	AuProcess* proc = AuIORingGetProcess(thr);
+	if (!proc || proc->ioring)
+		return -1;
+	if (entries == 0 || entries > IORING_MAX_ENTRIES || (entries & (entries - 1)))
+		return -1;
+
+	uint64_t start = (uint64_t)mem;
+	size_t sz = sizeof(AuIORingHdr) + entries * sizeof(AuIORingSQE) + entries * 2 * sizeof(AuIORingCQE);
+	if (start == 0 || (start & (PAGE_SIZE - 1)) || start + sz >= KERNEL_BASE_ADDRESS)
+		return -1;
+	for (uint64_t addr = start; addr < start + sz; addr += PAGE_SIZE) {
+		AuVPage* page = AuVmmngrGetPage(addr, VIRT_GETPAGE_ONLY_RET, VIRT_GETPAGE_ONLY_RET);
+		if (!page || !page->bits.present || !page->bits.user)
+			return -1;
+	}
+
+	AuIORing* ring = (AuIORing*)kmalloc(sizeof(AuIORing));
+	memset(ring, 0, sizeof(AuIORing));
+	ring->hdr = (AuIORingHdr*)mem;
+	ring->sqes = (AuIORingSQE*)(start + sizeof(AuIORingHdr));
+	ring->cqes = (AuIORingCQE*)(start + sizeof(AuIORingHdr) + entries * sizeof(AuIORingSQE));
+	ring->sqMask = entries - 1;
+	ring->cqMask = (entries * 2) - 1;
+	ring->lock = AuCreateSpinlock(false);
+	ring->pending = (AuIORingSQE*)kmalloc(entries * 2 * sizeof(AuIORingSQE));
+	/* the ring is only validated here, the kernel and the
+	 * worker touch it without checks from now on */
+	ring->pin = AuVMAreaPin(proc, start, sz);
+
+	ring->hdr->entries = entries;
+	ring->hdr->sqHead = ring->hdr->sqTail = 0;
+	ring->hdr->cqHead = ring->hdr->cqTail = 0;
+	proc->ioring = ring;
+	return 0;
+}
+
+/*
+ * IORingEnter -- consume submissions and optionally
+ * wait for completions
+ * @param toSubmit -- maximum submissions to consume
+ * @param minComplete -- completions to wait for
+ */
+int IORingEnter(uint32_t toSubmit, uint32_t minComplete) {
+	x64_cli();
+	AuThread* thr = AuGetCurrentThread();
+	AuProcess* proc = AuIORingGetProcess(thr);
+	if (!proc || !proc->ioring)
+		return -1;
+	AuIORing* ring = (AuIORing*)proc->ioring;
+	uint32_t submitted = 0;
+
+	AuAcquireSpinlock(ring->lock);
+	while (submitted < toSubmit && ring->hdr->sqHead != ring->hdr->sqTail) {
+		/* unread completions plus everything in flight must
+		 * fit the cq, else posting would overwrite entries
+		 * the process has not reaped yet */
+		uint32_t unread = ring->hdr->cqTail - ring->hdr->cqHead;
+		if (unread + ring->inflight > ring->cqMask)
+			break;
+		uint32_t head = ring->hdr->sqHead;
+		AuIORingSQE sqe;
+		memcpy(&sqe, &ring->sqes[head & ring->sqMask], sizeof(AuIORingSQE));
+		ring->hdr->sqHead = head + 1;
+		ring->inflight++;
+		submitted++;
+
+		if (sqe.flags & IORING_SQE_ASYNC) {
+			if (!ring->worker)
+				AuIORingStartWorker(proc, ring);
+			if (ring->worker) {
+				uint32_t idx = (ring->pendingHead + ring->pendingCount) & ring->cqMask;
+				memcpy(&ring->pending[idx], &sqe, sizeof(AuIORingSQE));
+				ring->pendingCount++;
+				if (ring->workerIdle && ring->worker->state == THREAD_STATE_BLOCKED) {
+					ring->workerIdle = false;
+					AuUnblockThread(ring->worker);
+				}
+				continue;
+			}
+		}
+
+		/* inline, handlers may sleep so drop the lock */
+		AuReleaseSpinlock(ring->lock);
+		int64_t result = AuIORingExecute(&sqe);
+		x64_cli();
+		AuAcquireSpinlock(ring->lock);
+		AuIORingPost(ring, sqe.userData, result);
+	}
+
+	while (minComplete > 0 && ring->inflight > 0 &&
+		(ring->hdr->cqTail - ring->hdr->cqHead) < minComplete) {
+		ring->waiter = thr;
+		ring->waitFor = minComplete;
+		AuBlockThread(thr);
+		AuReleaseSpinlock(ring->lock);
+		AuForceScheduler();
+		x64_cli();
+		AuAcquireSpinlock(ring->lock);
+	}
+	AuReleaseSpinlock(ring->lock);
+	return submitted;
+}
+
+/*
+ * AuIORingDestroy -- release ring state of a
+ * process, worker thread is already moved to
+ * trash with other sub threads
+ * @param proc -- Pointer to process
+ */
+void AuIORingDestroy(AuProcess* proc) {
+	AuIORing* ring = (AuIORing*)proc->ioring;
+	if (!ring)
+		return;
+	proc->ioring = NULL;
+	AuVMAreaUnpin(proc, ring->pin);
+	AuDeleteSpinlock(ring->lock);
+	kfree(ring->pending);
+	kfree(ring);
+}
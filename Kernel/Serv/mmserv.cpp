@@ -28,6 +28,7 @@
 **/
 
 #include <Mm\shm.h>
+#include <Mm\vmarea.h>
 #include <Mm\vmmngr.h>
 #include <Mm\pmmngr.h>
 #include <_null.h>
@@ -41,12 +42,13 @@
  * ============================================================
  */
 /*
- * CreateSharedMem -- create a shared memory chunk
- * @param key -- key to use
+ * CreateSharedMem -- create a shared memory chunk,
+ * returns its handle
+ * @param key -- key to use, 0 for an anonymous segment
  * @param sz -- memory size
  * @param flags -- shared memory flags
  */
-int CreateSharedMem(uint16_t key, size_t sz, uint8_t flags){
+int64_t CreateSharedMem(uint64_t key, size_t sz, uint8_t flags){
 	x64_cli();
 	AuThread* thr = AuGetCurrentThread();
 	if (!thr)
@@ -58,17 +60,16 @@ int CreateSharedMem(uint16_t key, size_t sz, uint8_t flags){
 			return -1;
 		}
 	}
-	int id = AuCreateSHM(proc, key, sz, flags);
-	return id;
+	return AuCreateSHM(proc, key, sz, flags);
 }
 
 /*
  * ObtainSharedMem -- obtain a shared memory
- * @param id -- segment id
+ * @param id -- segment handle or key
  * @param shmaddr -- user specified address
  * @param shmflg -- flags to use for protection
  */
-void* ObtainSharedMem(uint16_t id, void* shmaddr, int shmflg) {
+void* ObtainSharedMem(uint64_t id, void* shmaddr, int shmflg) {
 	x64_cli();
 	AuThread* thr = AuGetCurrentThread();
 	if (!thr)
@@ -84,9 +85,9 @@ void* ObtainSharedMem(uint16_t id, void* shmaddr, int shmflg) {
 
 /*
  * UnmapSharedMem -- unmap shared memory segment
- * @param key -- key to search
+ * @param key -- key or handle to search
  */
-void UnmapSharedMem(uint16_t key) {
+void UnmapSharedMem(uint64_t key) {
 	x64_cli();
 	AuThread* thr = AuGetCurrentThread();
 	if (!thr)  //some serious memory problem
@@ -126,7 +127,9 @@ uint64_t GetProcessHeapMem(size_t sz) {
 		}
 	}
 	
-	uint64_t start_addr = (uint64_t)AuGetFreePage(false, (void*)proc->proc_mem_heap);
+	uint64_t start_addr = AuVMAreaFindGap(proc, PROCESS_BREAK_ADDRESS, PROCESS_USER_STACK_ADDRESS, sz);
+	if (!start_addr)
+		return -1;
 
 	for (int i = 0; i < sz / PAGE_SIZE; i++) {
 		uint64_t phys = (uint64_t)AuPmmngrAlloc();
@@ -136,6 +139,7 @@ uint64_t GetProcessHeapMem(size_t sz) {
 		}
 	}
 	
+	AuVMAreaMap(proc, start_addr, sz, VM_PRESENT | VM_WRITE, VM_TYPE_HEAP, NULL);
 	proc->proc_mem_heap = start_addr;
 	proc->proc_heapmem_len += sz;
 	return start_addr;
@@ -170,21 +174,11 @@ int ProcessHeapUnmap(void* ptr, size_t sz) {
 	}
 	
 	uint64_t start_addr = (uint64_t)ptr;
-	for (int i = 0; i < sz / PAGE_SIZE; i++) {
-		AuVPage* page_ = AuVmmngrGetPage(start_addr + static_cast<uint64_t>(i) * PAGE_SIZE, VIRT_GETPAGE_ONLY_RET, VIRT_GETPAGE_ONLY_RET);
-		if (page_) {
-			uint64_t phys_page = page_->bits.page << PAGE_SHIFT;
-			if (phys_page){
-				AuPmmngrFree((void*)phys_page);
-				//page_->raw = 0;
-				page_->bits.present = 0;
-				page_->bits.page = 0;
-				page_->bits.writable = 0;
-			}
-		}
-	}
+	if (AuVMAreaPinned(proc, start_addr, sz))
+		return -1;
+	AuVmmngrUnmapRange(proc->cr3, start_addr, sz, VMMNGR_UNMAP_FREE_PHYSICAL);
 
-	flush_tlb((void*)start_addr);
+	AuVMAreaUnmap(proc, start_addr, sz);
 	/*if (start_addr < proc->proc_mem_heap)*/
 	proc->proc_mem_heap = start_addr;
 	return 0;
@@ -47,7 +47,7 @@ int NetSend(int sockfd, msghdr* msg, int flags) {
 		if (!proc)
 			return 1;
 	}
-	AuVFSNode* node = proc->fds[sockfd];
+	AuVFSNode* node = AuProcessGetFileNode(proc, sockfd);
 	AuSocket* sock = (AuSocket*)node->device;
 	if (!sock)
 		return -1;
@@ -69,7 +69,7 @@ int NetReceive(int sockfd, msghdr *msg, int flags){
 		if (!proc)
 			return 1;
 	}
-	AuVFSNode* node = proc->fds[sockfd];
+	AuVFSNode* node = AuProcessGetFileNode(proc, sockfd);
 	AuSocket* sock = (AuSocket*)node->device;
 	if (!sock)
 		return -1;
@@ -90,7 +90,7 @@ int NetConnect(int sockfd, sockaddr* addr, socklen_t addrlen) {
 			return 1;
 	}
 
-	AuVFSNode* node = proc->fds[sockfd];
+	AuVFSNode* node = AuProcessGetFileNode(proc, sockfd);
 	if (!node)
 		return 0;
 	AuSocket* sock = (AuSocket*)node->device;
@@ -111,7 +111,7 @@ int NetBind(int sockfd, sockaddr *addr, socklen_t addrlen){
 			return 1;
 	}
 
-	AuVFSNode* node = proc->fds[sockfd];
+	AuVFSNode* node = AuProcessGetFileNode(proc, sockfd);
 	if (!node)
 		return 0;
 	AuSocket* sock = (AuSocket*)node->device;
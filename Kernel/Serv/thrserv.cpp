@@ -56,7 +56,7 @@ int PauseThread() {
 /*
  * GetThreadID -- returns currently running thread id
  */
-uint16_t GetThreadID() {
+uint32_t GetThreadID() {
 	AuThread* current_thr = AuGetCurrentThread();
 	if (!current_thr)
 		return -1;
@@ -301,11 +301,11 @@ int SetFileToProcess(int fileno, int dest_fdidx, int proc_id) {
 	/* now try getting the file from current process
 	 * file entry
 	 */
-	AuVFSNode* file = proc->fds[fileno];
+	AuVFSNode* file = AuProcessGetFileNode(proc, fileno);
 	if (!file)
 		return -1;
 
-	AuVFSNode *destfile = destproc->fds[dest_fdidx];
+	AuVFSNode *destfile = AuProcessGetFileNode(destproc, dest_fdidx);
 	if (destfile)
 		return -1;
 	else {
@@ -315,7 +315,8 @@ int SetFileToProcess(int fileno, int dest_fdidx, int proc_id) {
 		 * fileno to destination processes file
 		 * entry 
 		 */
-		destproc->fds[dest_fdidx] = file;
+		if (AuProcessSetFileDesc(destproc, dest_fdidx, file) == -1)
+			return -1;
 		file->fileCopyCount += 1;
 	}
 }
@@ -75,6 +75,73 @@ int DestroyTimer(int threadID) {
 	return 1;
 }
 
+/*
+ * HRTimerCreate -- create a high resolution timer
+ * owned by current thread
+ * @param flags -- HRTIMER_FLAG_* bits
+ * @return timer id, -1 on failure
+ */
+int HRTimerCreate(uint8_t flags) {
+	x64_cli();
+	AuThread* thr = AuGetCurrentThread();
+	return AuHRTimerCreate(thr->id, flags);
+}
+
+/*
+ * HRTimerArm -- arm a high resolution timer
+ * @param id -- timer id
+ * @param initial -- first expiry in nanoseconds
+ * @param period -- interval in nanoseconds, 0 for
+ * one-shot
+ * @param flags -- HRTIMER_ARM_* bits
+ */
+int HRTimerArm(int id, uint64_t initial, uint64_t period, uint8_t flags) {
+	x64_cli();
+	AuThread* thr = AuGetCurrentThread();
+	return AuHRTimerArm(thr->id, id, initial, period, flags);
+}
+
+/*
+ * HRTimerDisarm -- stop a high resolution timer
+ * @param id -- timer id
+ */
+int HRTimerDisarm(int id) {
+	x64_cli();
+	AuThread* thr = AuGetCurrentThread();
+	return AuHRTimerDisarm(thr->id, id);
+}
+
+/*
+ * HRTimerWait -- wait for a high resolution timer
+ * to expire
+ * @param id -- timer id
+ * @return number of expirations since last wait
+ */
+int64_t HRTimerWait(int id) {
+	x64_cli();
+	AuThread* thr = AuGetCurrentThread();
+	return AuHRTimerWait(thr, id);
+}
+
+/*
+ * HRTimerClose -- destroy a high resolution timer
+ * @param id -- timer id
+ */
+int HRTimerClose(int id) {
+	x64_cli();
+	AuThread* thr = AuGetCurrentThread();
+	return AuHRTimerClose(thr->id, id);
+}
+
+/*
+ * GetMonotonicClock -- returns nanoseconds of the
+ * monotonic clock
+ */
+uint64_t GetMonotonicClock() {
+	x64_cli();
+	return AuTimerGetNanoseconds();
+}
+
 /*
 * GetTimeOfDay -- returns the time format
 * in unix format
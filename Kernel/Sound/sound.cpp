@@ -106,7 +106,7 @@ void AuRemoveDSP(AuDSP *dsp) {
 	}
 }
 
-AuDSP* AuSoundGetDSP(uint16_t id) {
+AuDSP* AuSoundGetDSP(uint32_t id) {
 	for (AuDSP* dsp = dsp_first; dsp != NULL; dsp = dsp->next) {
 		if (dsp->_dsp_id == id)
 			return dsp;
@@ -135,11 +135,10 @@ void AuSoundGetBlock(uint64_t *buffer) {
 	
 	for (AuDSP* dsp = dsp_first; dsp != NULL; dsp = dsp->next) {
 		uint8_t* mixing_zone = mixbuf;
-		memset(mixing_zone, 0, SND_BUFF_SZ);
-		for (int i = 0; i < SND_BUFF_SZ; i++){
-			AuCircBufGet(dsp->buffer, mixing_zone);
-			mixing_zone++;
-		}
+		uint32_t got = AuRingBufRead(dsp->buffer, mixing_zone, SND_BUFF_SZ);
+		/* underrun plays silence */
+		if (got < SND_BUFF_SZ)
+			memset(mixing_zone + got, 0, SND_BUFF_SZ - got);
 
 		int16_t *data_16 = (int16_t*)mixbuf;
 
@@ -164,13 +163,13 @@ void AuSoundGetBlock(uint64_t *buffer) {
 }
 
 
-size_t AuSoundRead(AuVFSNode* fsys, AuVFSNode* file, uint64_t* buffer, uint32_t length) {
+size_t AuSoundRead(AuVFSNode* fsys, AuVFSNode* file, uint64_t* buffer, size_t length) {
 	if (_Registered_dev == NULL)
 		return -1;
 	return 0;
 }
 
-size_t AuSoundWrite(AuVFSNode* fsys, AuVFSNode* file, uint64_t* buffer, uint32_t length) {
+size_t AuSoundWrite(AuVFSNode* fsys, AuVFSNode* file, uint64_t* buffer, size_t length) {
 	x64_cli();
 	if (!_Registered_dev)
 		return 0;
@@ -178,15 +177,13 @@ size_t AuSoundWrite(AuVFSNode* fsys, AuVFSNode* file, uint64_t* buffer, uint32_t
 	AuDSP* dsp = AuSoundGetDSP(t->id);
 	uint8_t *aligned_buf = (uint8_t*)buffer;
 	
-	if (CircBufFull(dsp->buffer)){
+	if (AuRingBufAvailable(dsp->buffer) < SND_BUFF_SZ){
 		if (dsp->SndThread->pendingSigCount > 0)
 			return 0;
 		AuBlockThread(dsp->SndThread);
 		AuForceScheduler();	
 	}
-	for (int i = 0; i < SND_BUFF_SZ; i++) { //
-		AuCircBufPut(dsp->buffer, aligned_buf[i]);
-	}
+	AuRingBufWrite(dsp->buffer, aligned_buf, SND_BUFF_SZ);
 
 	return SND_BUFF_SZ;
 }
@@ -234,12 +231,18 @@ int AuSoundIOControl(AuVFSNode* node, int code, void* arg) {
 									memset(dsp, 0, sizeof(AuDSP));
 									uint8_t* buffer = (uint8_t*)P2V((size_t)AuPmmngrAlloc());
 									memset(buffer, 0, PAGE_SIZE);
-									dsp->buffer = AuCircBufInitialise(buffer, SND_BUFF_SZ);
+									dsp->buffer = (AuRingBuffer*)kmalloc(sizeof(AuRingBuffer));
+									AuRingBufInit(dsp->buffer, buffer, SND_BUFF_SZ);
 									dsp->_dsp_id = thr->id;
 									dsp->SndThread = thr;
 									dsp->sleep_time = _ioctl->uint_1;
 									dsp->available = true;
 									AuSoundAddDSP(dsp);
+									/* the player feeds the card from its
+									 * interrupt, run it ahead of normal
+									 * threads and let it lend its priority
+									 * to mutex owners it waits on */
+									AuThreadSetBasePriority(thr, THREAD_PRIORITY_REALTIME);
 									break;
 	}
 	case SOUND_READ_AVAIL: {
@@ -290,7 +293,8 @@ void AuSoundInitialise() {
 	AuDSP* dsp_ = (AuDSP*)kmalloc(sizeof(AuDSP));
 	memset(dsp_, 0, sizeof(AuDSP));
 	uint8_t* buffer = (uint8_t*)P2V((size_t)AuPmmngrAlloc());
-	dsp_->buffer = AuCircBufInitialise(buffer, SND_BUFF_SZ);
+	dsp_->buffer = (AuRingBuffer*)kmalloc(sizeof(AuRingBuffer));
+	AuRingBufInit(dsp_->buffer, buffer, SND_BUFF_SZ);
 	dsp_->_dsp_id = 0;
 	dsp_->SndThread = 0;
 	dsp_->sleep_time = 0;
@@ -302,11 +306,13 @@ void AuSoundInitialise() {
  * AuSoundRemoveDSP -- remove the dsp from
  * dsp list
  */
-void AuSoundRemoveDSP(uint16_t id) {
+void AuSoundRemoveDSP(uint32_t id) {
 	AuDSP* dsp_ = AuSoundGetDSP(id);
 	if (dsp_) {
+		if (dsp_->SndThread)
+			AuThreadSetBasePriority(dsp_->SndThread, THREAD_PRIORITY_NORMAL);
 		AuPmmngrFree((void*)V2P((size_t)dsp_->buffer->buffer));
-		AuCircBufFree(dsp_->buffer);
+		kfree(dsp_->buffer);
 		AuRemoveDSP(dsp_);
 		kfree(dsp_);
 	}
@@ -0,0 +1,293 @@
+/**
+* BSD 2-Clause License
+*
+* Copyright (c) 2022-2023, Manas Kamal Choudhury
+* All rights reserved.
+*
+* Redistribution and use in source and binary forms, with or without
+* modification, are permitted provided that the following conditions are met:
+*
+* 1. Redistributions of source code must retain the above copyright notice, this
+*    list of conditions and the following disclaimer.
+*
+* 2. Redistributions in binary form must reproduce the above copyright notice,
+*    this list of conditions and the following disclaimer in the documentation
+*    and/or other materials provided with the distribution.
+*
+* THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+* AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+* IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+* DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE
+* FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+* DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR
+* SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER
+* CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY,
+* OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+* OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+*
+**/
+
+#include <Sync\futex.h>
+#include <Sync\spinlock.h>
+#include <Mm\vmmngr.h>
+#include <Mm\tlb.h>
+#include <Hal\x86_64_hal.h>
+#include <Hal\x86_64_lowlevel.h>
+#include <_null.h>
+
+/*
+ * Futex wait queues are hashed by address space and user
+ * virtual address, every bucket has its own lock. Waiters
+ * are placed on the waiting thread's kernel stack and stay
+ * valid until the thread leaves AuFutexWait.
+ */
+
+typedef struct _futex_bucket_ {
+	Spinlock* lock;
+	AuFutexWaiter* head;
+}AuFutexBucket;
+
+static AuFutexBucket futexTable[FUTEX_HASH_SIZE];
+
+/*
+ * AuFutexInitialise -- initialise futex
+ * wait queues
+ */
+void AuFutexInitialise() {
+	for (int i = 0; i < FUTEX_HASH_SIZE; i++) {
+		futexTable[i].lock = AuCreateSpinlock(false);
+		futexTable[i].head = NULL;
+	}
+}
+
+static AuFutexBucket* AuFutexHash(uint64_t space, uint64_t addr) {
+	uint64_t h = (addr >> 2) ^ (space >> 12);
+	h ^= (h >> 17);
+	return &futexTable[h % FUTEX_HASH_SIZE];
+}
+
+static bool AuFutexValidAddr(uint32_t* addr) {
+	uint64_t virt = (uint64_t)addr;
+	if (virt == 0 || virt >= PHYSICAL_MEM_BASE || (virt & 3))
+		return false;
+	AuVPage* page = AuVmmngrGetPage(virt, VIRT_GETPAGE_ONLY_RET, VIRT_GETPAGE_ONLY_RET);
+	if (!page || !page->bits.present)
+		return false;
+	return true;
+}
+
+/*
+ * AuFutexUnlink -- remove a waiter from its bucket, bucket
+ * lock must be held
+ */
+static bool AuFutexUnlink(AuFutexBucket* bucket, AuFutexWaiter* waiter) {
+	for (AuFutexWaiter** link = &bucket->head; *link != NULL; link = &(*link)->next) {
+		if (*link == waiter) {
+			*link = waiter->next;
+			return true;
+		}
+	}
+	return false;
+}
+
+/*
+ * AuFutexWait -- sleep while the futex word holds
+ * the expected value
+ * @param space -- address space of caller
+ * @param addr -- user address of futex
+ * @param expected -- expected value
+ * @param timeout -- timeout in ms, 0 for infinite
+ */
+static int AuFutexWait(uint64_t space, uint32_t* addr, uint32_t expected, uint64_t timeout) {
+	AuThread* thr = AuGetCurrentThread();
+	AuFutexBucket* bucket = AuFutexHash(space, (uint64_t)addr);
+
+	AuAcquireSpinlock(bucket->lock);
+	/* wakers change the word before they take the bucket
+	 * lock, so checking under it can't miss a wakeup */
+	if (*(volatile uint32_t*)addr != expected) {
+		AuReleaseSpinlock(bucket->lock);
+		return FUTEX_AGAIN;
+	}
+
+	AuFutexWaiter waiter;
+	waiter.space = space;
+	waiter.addr = (uint64_t)addr;
+	waiter.thread = thr;
+	waiter.woken = false;
+	waiter.next = bucket->head;
+	bucket->head = &waiter;
+
+	if (timeout)
+		AuSleepThread(thr, timeout);
+	else
+		AuBlockThread(thr);
+	AuReleaseSpinlock(bucket->lock);
+	AuForceScheduler();
+
+	/* either woken, or the sleep expired, requeue may have
+	 * moved us to another bucket meanwhile */
+	x64_cli();
+	while (1) {
+		bucket = AuFutexHash(waiter.space, waiter.addr);
+		AuAcquireSpinlock(bucket->lock);
+		if (bucket == AuFutexHash(waiter.space, waiter.addr))
+			break;
+		AuReleaseSpinlock(bucket->lock);
+	}
+	int ret = 0;
+	if (!waiter.woken) {
+		AuFutexUnlink(bucket, &waiter);
+		ret = FUTEX_TIMEDOUT;
+	}
+	AuReleaseSpinlock(bucket->lock);
+	return ret;
+}
+
+/*
+ * AuFutexWakeBucket -- wake up to count waiters of a
+ * futex, bucket lock must be held
+ */
+static int AuFutexWakeBucket(AuFutexBucket* bucket, uint64_t space, uint64_t addr, int count) {
+	int woken = 0;
+	AuFutexWaiter** link = &bucket->head;
+	while (*link != NULL && woken < count) {
+		AuFutexWaiter* waiter = *link;
+		if (waiter->space != space || waiter->addr != addr) {
+			link = &waiter->next;
+			continue;
+		}
+		*link = waiter->next;
+		waiter->woken = true;
+		AuWakeThread(waiter->thread);
+		woken++;
+	}
+	return woken;
+}
+
+/*
+ * AuFutexWake -- wake threads waiting on a futex
+ * @param space -- address space of caller
+ * @param addr -- user address of futex
+ * @param count -- maximum threads to wake
+ */
+static int AuFutexWake(uint64_t space, uint32_t* addr, int count) {
+	AuFutexBucket* bucket = AuFutexHash(space, (uint64_t)addr);
+	AuAcquireSpinlock(bucket->lock);
+	int woken = AuFutexWakeBucket(bucket, space, (uint64_t)addr, count);
+	AuReleaseSpinlock(bucket->lock);
+	return woken;
+}
+
+/*
+ * AuFutexCmpRequeue -- wake some waiters of a futex and
+ * move the rest to another futex, so that a broadcast
+ * does not wake everybody just to contend on a mutex
+ * @param space -- address space of caller
+ * @param addr -- source futex
+ * @param wakeCount -- waiters to wake
+ * @param requeueCount -- waiters to move
+ * @param addr2 -- target futex
+ * @param expected -- expected value of source futex
+ */
+static int AuFutexCmpRequeue(uint64_t space, uint32_t* addr, int wakeCount, int requeueCount,
+	uint32_t* addr2, uint32_t expected) {
+	AuFutexBucket* b1 = AuFutexHash(space, (uint64_t)addr);
+	AuFutexBucket* b2 = AuFutexHash(space, (uint64_t)addr2);
+
+	/* lock ordering by bucket address */
+	if (b1 < b2) {
+		AuAcquireSpinlock(b1->lock);
+		AuAcquireSpinlock(b2->lock);
+	}
+	else if (b1 > b2) {
+		AuAcquireSpinlock(b2->lock);
+		AuAcquireSpinlock(b1->lock);
+	}
+	else
+		AuAcquireSpinlock(b1->lock);
+
+	int ret = 0;
+	if (*(volatile uint32_t*)addr != expected) {
+		ret = FUTEX_AGAIN;
+		goto unlock;
+	}
+
+	ret = AuFutexWakeBucket(b1, space, (uint64_t)addr, wakeCount);
+
+	{
+		int moved = 0;
+		AuFutexWaiter** link = &b1->head;
+		while (*link != NULL && moved < requeueCount) {
+			AuFutexWaiter* waiter = *link;
+			if (waiter->space != space || waiter->addr != (uint64_t)addr) {
+				link = &waiter->next;
+				continue;
+			}
+			*link = waiter->next;
+			waiter->addr = (uint64_t)addr2;
+			waiter->next = b2->head;
+			b2->head = waiter;
+			moved++;
+		}
+		ret += moved;
+	}
+
+unlock:
+	if (b1 != b2)
+		AuReleaseSpinlock(b2->lock);
+	AuReleaseSpinlock(b1->lock);
+	return ret;
+}
+
+/*
+ * Futex -- futex system call
+ * @param addr -- user address of the futex word
+ * @param op -- FUTEX_WAIT, FUTEX_WAKE or FUTEX_CMP_REQUEUE
+ * @param val -- expected value for wait, wake count for
+ * wake and requeue
+ * @param val2 -- timeout in ms for wait (0 waits forever),
+ * requeue count for requeue
+ * @param addr2 -- target futex for requeue
+ * @param val3 -- expected value of futex for requeue
+ */
+int64_t Futex(uint32_t* addr, int op, uint32_t val, uint64_t val2, uint32_t* addr2, uint32_t val3) {
+	x64_cli();
+	AuThread* thr = AuGetCurrentThread();
+	if (!thr || !AuFutexValidAddr(addr))
+		return FUTEX_ERROR;
+	uint64_t space = thr->frame.cr3 & X86_64_CR3_ADDR_MASK;
+
+	switch (op) {
+	case FUTEX_WAIT:
+		return AuFutexWait(space, addr, val, val2);
+	case FUTEX_WAKE:
+		return AuFutexWake(space, addr, val);
+	case FUTEX_CMP_REQUEUE:
+		if (!AuFutexValidAddr(addr2))
+			return FUTEX_ERROR;
+		return AuFutexCmpRequeue(space, addr, val, val2, addr2, val3);
+	default:
+		return FUTEX_ERROR;
+	}
+}
+
+/*
+ * AuFutexRemoveThread -- drop a thread from futex
+ * wait queues
+ * @param thr -- Pointer to thread
+ */
+void AuFutexRemoveThread(AuThread* thr) {
+	for (int i = 0; i < FUTEX_HASH_SIZE; i++) {
+		AuFutexBucket* bucket = &futexTable[i];
+		AuAcquireSpinlock(bucket->lock);
+		AuFutexWaiter** link = &bucket->head;
+		while (*link != NULL) {
+			if ((*link)->thread == thr)
+				*link = (*link)->next;
+			else
+				link = &(*link)->next;
+		}
+		AuReleaseSpinlock(bucket->lock);
+	}
+}
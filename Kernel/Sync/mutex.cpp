@@ -35,6 +35,10 @@
 #include <_null.h>
 #include <Mm/kmalloc.h>
 
+/* bound on how far priority is pushed along a chain of
+ * blocked owners */
+#define MUTEX_INHERIT_DEPTH  8
+
 /*
  * AuCreateMutex -- create a new mutex and return
  */
@@ -42,10 +46,62 @@ AU_EXTERN AU_EXPORT AuMutex* AuCreateMutex() {
 	AuMutex* mut = (AuMutex*)kmalloc(sizeof(AuMutex));
 	mut->lock = AuCreateSpinlock(false);
 	mut->owner = NULL;
-	mut->waiters = initialize_list();
+	mut->head = NULL;
+	mut->tail = NULL;
+	mut->ceiling = THREAD_PRIORITY_NORMAL;
+	mut->heldNext = NULL;
 	return mut;
 }
 
+/*
+ * AuMutexTake -- try to become owner of a free
+ * mutex
+ * @param mut -- Pointer to mutex
+ * @param thr -- thread taking the mutex
+ */
+static bool AuMutexTake(AuMutex* mut, AuThread* thr) {
+	if (mut->owner)
+		return false;
+	if (!x64_lock_test((volatile size_t*)&mut->owner, 0, (size_t)thr))
+		return false;
+	mut->heldNext = (AuMutex*)thr->heldMutex;
+	thr->heldMutex = mut;
+	return true;
+}
+
+/*
+ * AuMutexInherit -- raise the owner, and whoever
+ * the owner is waiting for, to given priority
+ * @param owner -- owner of the mutex
+ * @param priority -- priority of the waiter
+ */
+static void AuMutexInherit(AuThread* owner, uint8_t priority) {
+	for (int depth = 0; owner && depth < MUTEX_INHERIT_DEPTH; depth++) {
+		if (owner->priority >= priority)
+			break;
+		AuThreadSetPriority(owner, priority);
+		AuMutex* next = (AuMutex*)owner->waitMutex;
+		if (!next)
+			break;
+		owner = next->owner;
+	}
+}
+
+/*
+ * AuMutexRestorePriority -- drop inherited priority
+ * down to what the mutexes still held require
+ * @param thr -- thread that released a mutex
+ */
+static void AuMutexRestorePriority(AuThread* thr) {
+	uint8_t prio = thr->basePriority;
+	for (AuMutex* m = (AuMutex*)thr->heldMutex; m; m = m->heldNext) {
+		if (m->ceiling > prio)
+			prio = m->ceiling;
+	}
+	if (prio != thr->priority)
+		AuThreadSetPriority(thr, prio);
+}
+
 /*
  * AuAcquireMutex -- acuire a mutex lock
  * @param mut -- Pointer to mutex
@@ -55,25 +111,119 @@ AU_EXTERN AU_EXPORT int AuAcquireMutex(AuMutex* mut) {
 		return 0;
 	if (!mut)
 		return 0;
-	x64_cli();
-	AuAcquireSpinlock(mut->lock);
 	AuThread* current_thr = AuGetCurrentThread();
-	AuProcess* current_proc = AuProcessFindThread(current_thr);
-	while (mut->status) {
-		list_add(mut->waiters, current_thr);
-		current_proc->state = 0;
-		current_proc->state |= PROCESS_STATE_BUSY_WAIT;
-		AuBlockThread(current_thr);
-		x64_force_sched();
+
+	/* adaptive part, the owner is likely to release
+	 * soon while it is running on another cpu, blocking
+	 * would cost more than spinning */
+	for (int spin = 0; spin < MUTEX_SPIN_LIMIT; spin++) {
+		AuThread* owner = mut->owner;
+		if (!owner) {
+			if (AuMutexTake(mut, current_thr))
+				return 0;
+			continue;
+		}
+		if (!owner->onCpu || mut->head)
+			break;
+		x64_pause();
 	}
 
-	mut->status = 1;
-	mut->owner = current_thr;
-	SeTextOut("Mutex acquired \r\n");
-	AuReleaseSpinlock(mut->lock);
+	uint64_t flags = AuAcquireSpinlockIrqSave(mut->lock);
+	if (!mut->head && AuMutexTake(mut, current_thr)) {
+		AuReleaseSpinlockIrqRestore(mut->lock, flags);
+		return 0;
+	}
+
+	AuMutexWaiter waiter;
+	waiter.thread = current_thr;
+	waiter.type = MUTEX_WAITER_WRITER;
+	waiter.granted = 0;
+	waiter.next = NULL;
+	if (mut->tail)
+		mut->tail->next = &waiter;
+	else
+		mut->head = &waiter;
+	mut->tail = &waiter;
+
+	if (current_thr->priority > mut->ceiling)
+		mut->ceiling = current_thr->priority;
+	current_thr->waitMutex = mut;
+	AuMutexInherit(mut->owner, current_thr->priority);
+
+	/* ownership is handed over by release, signals
+	 * don't interrupt the wait */
+	while (!waiter.granted) {
+		AuBlockThread(current_thr);
+		AuReleaseSpinlock(mut->lock);
+		AuForceScheduler();
+		AuAcquireSpinlock(mut->lock);
+	}
+	current_thr->waitMutex = NULL;
+	AuReleaseSpinlockIrqRestore(mut->lock, flags);
 	return 0;
 }
 
+/*
+ * AuTryAcquireMutex -- acquire a mutex only if it is
+ * free
+ * @param mut -- Pointer to mutex
+ */
+AU_EXTERN AU_EXPORT bool AuTryAcquireMutex(AuMutex* mut) {
+	if (!mut)
+		return false;
+	if (mut->head)
+		return false;
+	return AuMutexTake(mut, AuGetCurrentThread());
+}
+
+/*
+ * AuMutexHandOver -- passes a mutex from its owner to
+ * the oldest waiter, or leaves it free, mutex lock must
+ * be held
+ * @param mutex -- Pointer to mutex
+ * @param owner -- thread giving the mutex up
+ */
+static void AuMutexHandOver(AuMutex* mutex, AuThread* owner) {
+	/* unlink from held list, mutexes are mostly released
+	 * in reverse order so this is usually the head */
+	AuMutex** link = (AuMutex**)&owner->heldMutex;
+	while (*link && *link != mutex)
+		link = &(*link)->heldNext;
+	if (*link)
+		*link = mutex->heldNext;
+	mutex->heldNext = NULL;
+
+	AuMutexWaiter* waiter = mutex->head;
+	if (!waiter) {
+		mutex->owner = NULL;
+		mutex->ceiling = THREAD_PRIORITY_NORMAL;
+		AuMutexRestorePriority(owner);
+		return;
+	}
+
+	/* hand ownership directly to the oldest waiter, only
+	 * one thread is woken up and nobody can barge in */
+	mutex->head = waiter->next;
+	if (!mutex->head)
+		mutex->tail = NULL;
+	uint8_t ceiling = THREAD_PRIORITY_NORMAL;
+	for (AuMutexWaiter* w = mutex->head; w; w = w->next) {
+		if (w->thread->priority > ceiling)
+			ceiling = w->thread->priority;
+	}
+	mutex->ceiling = ceiling;
+
+	AuThread* next = waiter->thread;
+	mutex->owner = next;
+	mutex->heldNext = (AuMutex*)next->heldMutex;
+	next->heldMutex = mutex;
+	waiter->granted = 1;
+	AuMutexInherit(next, ceiling);
+	AuMutexRestorePriority(owner);
+	if (next->state == THREAD_STATE_BLOCKED)
+		AuUnblockThread(next);
+}
+
 /*
  * AuReleaseMutex -- release a mutex
  * @param pointer to mutex
@@ -83,24 +233,56 @@ AU_EXTERN AU_EXPORT int AuReleaseMutex(AuMutex *mutex) {
 		return 0;
 	if (!mutex)
 		return -1;
-	if (mutex->owner != AuGetCurrentThread()) {
+	AuThread* current_thr = AuGetCurrentThread();
+	if (mutex->owner != current_thr) {
 		return -1;
 	}
-	AuAcquireSpinlock(mutex->lock);
-	mutex->status = 0;
-	mutex->owner = NULL;
-	for (int i = 0; i < mutex->waiters->pointer; i++) {
-		AuThread* thr_ = (AuThread*)list_remove(mutex->waiters, i);
-		AuProcess* current_proc = AuProcessFindThread(thr_);
-		if (thr_) {
-			current_proc->state = 0;
-			current_proc->state |= PROCESS_STATE_READY;
-			AuUnblockThread(thr_);
+	uint64_t flags = AuAcquireSpinlockIrqSave(mutex->lock);
+	AuMutexHandOver(mutex, current_thr);
+	AuReleaseSpinlockIrqRestore(mutex->lock, flags);
+	return 0;
+}
+
+/*
+ * AuMutexRemoveThread -- drops a dying thread from the
+ * mutex it waits on and passes on the mutexes it owns,
+ * its waiter lives on the stack that is about to go
+ * @param thr -- Pointer to thread
+ */
+void AuMutexRemoveThread(AuThread* thr) {
+	AuMutex* mut = (AuMutex*)thr->waitMutex;
+	if (mut) {
+		uint64_t flags = AuAcquireSpinlockIrqSave(mut->lock);
+		AuMutexWaiter* prev = NULL;
+		for (AuMutexWaiter* w = mut->head; w; w = w->next) {
+			if (w->thread == thr) {
+				if (prev)
+					prev->next = w->next;
+				else
+					mut->head = w->next;
+				if (mut->tail == w)
+					mut->tail = prev;
+				break;
+			}
+			prev = w;
+		}
+		uint8_t ceiling = THREAD_PRIORITY_NORMAL;
+		for (AuMutexWaiter* w = mut->head; w; w = w->next) {
+			if (w->thread->priority > ceiling)
+				ceiling = w->thread->priority;
 		}
+		mut->ceiling = ceiling;
+		thr->waitMutex = NULL;
+		AuReleaseSpinlockIrqRestore(mut->lock, flags);
+	}
+
+	/* includes a mutex granted while it was dying */
+	while (thr->heldMutex) {
+		AuMutex* held = (AuMutex*)thr->heldMutex;
+		uint64_t flags = AuAcquireSpinlockIrqSave(held->lock);
+		AuMutexHandOver(held, thr);
+		AuReleaseSpinlockIrqRestore(held->lock, flags);
 	}
-	SeTextOut("Mutex released \r\n");
-	AuReleaseSpinlock(mutex->lock);
-	return 0;
 }
 
 /*
@@ -108,6 +290,6 @@ AU_EXTERN AU_EXPORT int AuReleaseMutex(AuMutex *mutex) {
  * @param mutex -- Pointer to mutex
  */
 AU_EXTERN AU_EXPORT void AuDeleteMutex(AuMutex *mutex) {
-	kfree(mutex->waiters);
+	AuDeleteSpinlock(mutex->lock);
 	kfree(mutex);
-}
\ No newline at end of file
+}
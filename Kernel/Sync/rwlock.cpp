@@ -0,0 +1,183 @@
+/**
+* BSD 2-Clause License
+*
+* Copyright (c) 2022-2023, Manas Kamal Choudhury
+* All rights reserved.
+*
+* Redistribution and use in source and binary forms, with or without
+* modification, are permitted provided that the following conditions are met:
+*
+* 1. Redistributions of source code must retain the above copyright notice, this
+*    list of conditions and the following disclaimer.
+*
+* 2. Redistributions in binary form must reproduce the above copyright notice,
+*    this list of conditions and the following disclaimer in the documentation
+*    and/or other materials provided with the distribution.
+*
+* THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+* AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+* IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+* DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE
+* FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+* DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR
+* SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER
+* CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY,
+* OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+* OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+*
+**/
+
+#include <Sync/rwlock.h>
+#include <Hal/x86_64_sched.h>
+#include <Hal/x86_64_lowlevel.h>
+#include <_null.h>
+#include <Mm/kmalloc.h>
+
+/*
+ * AuCreateRWLock -- create a new reader/writer lock
+ */
+AU_EXTERN AU_EXPORT AuRWLock* AuCreateRWLock() {
+	AuRWLock* rw = (AuRWLock*)kmalloc(sizeof(AuRWLock));
+	rw->lock = AuCreateSpinlock(false);
+	rw->writer = NULL;
+	rw->readers = 0;
+	rw->head = NULL;
+	rw->tail = NULL;
+	return rw;
+}
+
+/*
+ * AuRWLockWait -- queue the current thread and sleep
+ * until a release grants it the lock, called with
+ * rw->lock held
+ * @param rw -- Pointer to rwlock
+ * @param type -- reader or writer
+ */
+static void AuRWLockWait(AuRWLock* rw, uint8_t type) {
+	AuThread* current_thr = AuGetCurrentThread();
+	AuMutexWaiter waiter;
+	waiter.thread = current_thr;
+	waiter.type = type;
+	waiter.granted = 0;
+	waiter.next = NULL;
+	if (rw->tail)
+		rw->tail->next = &waiter;
+	else
+		rw->head = &waiter;
+	rw->tail = &waiter;
+
+	while (!waiter.granted) {
+		AuBlockThread(current_thr);
+		AuReleaseSpinlock(rw->lock);
+		AuForceScheduler();
+		AuAcquireSpinlock(rw->lock);
+	}
+}
+
+/*
+ * AuRWLockGrant -- wake the next writer, or every
+ * reader at the head of queue, called with rw->lock
+ * held once the lock became free
+ * @param rw -- Pointer to rwlock
+ */
+static void AuRWLockGrant(AuRWLock* rw) {
+	AuMutexWaiter* waiter = rw->head;
+	if (!waiter)
+		return;
+	AuMutexWaiter* stop = waiter;
+	if (waiter->type == MUTEX_WAITER_WRITER) {
+		rw->writer = waiter->thread;
+		stop = waiter->next;
+	}
+	else {
+		/* readers behind a writer stay queued, they
+		 * get their turn after it */
+		while (stop && stop->type == MUTEX_WAITER_READER) {
+			rw->readers++;
+			stop = stop->next;
+		}
+	}
+	rw->head = stop;
+	if (!stop)
+		rw->tail = NULL;
+
+	while (waiter != stop) {
+		AuMutexWaiter* next = waiter->next;
+		AuThread* thr = waiter->thread;
+		waiter->granted = 1;
+		if (thr->state == THREAD_STATE_BLOCKED)
+			AuUnblockThread(thr);
+		waiter = next;
+	}
+}
+
+/*
+ * AuAcquireReadLock -- acquire a lock for shared access
+ * @param rw -- Pointer to rwlock
+ */
+AU_EXTERN AU_EXPORT void AuAcquireReadLock(AuRWLock* rw) {
+	if (!rw || !AuIsSchedulerInitialised())
+		return;
+	uint64_t flags = AuAcquireSpinlockIrqSave(rw->lock);
+	if (!rw->writer && !rw->head)
+		rw->readers++;
+	else
+		AuRWLockWait(rw, MUTEX_WAITER_READER);
+	AuReleaseSpinlockIrqRestore(rw->lock, flags);
+}
+
+/*
+ * AuReleaseReadLock -- release a shared access
+ * @param rw -- Pointer to rwlock
+ */
+AU_EXTERN AU_EXPORT void AuReleaseReadLock(AuRWLock* rw) {
+	if (!rw || !AuIsSchedulerInitialised())
+		return;
+	uint64_t flags = AuAcquireSpinlockIrqSave(rw->lock);
+	if (rw->readers > 0) {
+		rw->readers--;
+		if (rw->readers == 0)
+			AuRWLockGrant(rw);
+	}
+	AuReleaseSpinlockIrqRestore(rw->lock, flags);
+}
+
+/*
+ * AuAcquireWriteLock -- acquire a lock for exclusive
+ * access
+ * @param rw -- Pointer to rwlock
+ */
+AU_EXTERN AU_EXPORT void AuAcquireWriteLock(AuRWLock* rw) {
+	if (!rw || !AuIsSchedulerInitialised())
+		return;
+	uint64_t flags = AuAcquireSpinlockIrqSave(rw->lock);
+	if (!rw->writer && rw->readers == 0 && !rw->head)
+		rw->writer = AuGetCurrentThread();
+	else
+		AuRWLockWait(rw, MUTEX_WAITER_WRITER);
+	AuReleaseSpinlockIrqRestore(rw->lock, flags);
+}
+
+/*
+ * AuReleaseWriteLock -- release exclusive access
+ * @param rw -- Pointer to rwlock
+ */
+AU_EXTERN AU_EXPORT void AuReleaseWriteLock(AuRWLock* rw) {
+	if (!rw || !AuIsSchedulerInitialised())
+		return;
+	uint64_t flags = AuAcquireSpinlockIrqSave(rw->lock);
+	if (rw->writer == AuGetCurrentThread()) {
+		rw->writer = NULL;
+		AuRWLockGrant(rw);
+	}
+	AuReleaseSpinlockIrqRestore(rw->lock, flags);
+}
+
+/*
+ * AuDeleteRWLock -- free up a reader/writer lock
+ * @param rw -- Pointer to rwlock
+ */
+AU_EXTERN AU_EXPORT void AuDeleteRWLock(AuRWLock* rw) {
+	AuDeleteSpinlock(rw->lock);
+	kfree(rw);
+}
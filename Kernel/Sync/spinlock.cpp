@@ -30,12 +30,39 @@
 #include <Sync/spinlock.h>
 #include <Mm/kmalloc.h>
 #include <stdint.h>
+#include <stdio.h>
+#include <string.h>
 #include <Hal/serial.h>
 #include <_null.h>
 #include <Hal/x86_64_lowlevel.h>
+#include <Hal/x86_64_cpu.h>
+#include <Hal/pcpu.h>
+#include <Fs/vfs.h>
+#include <Fs/Dev/devfs.h>
 
-Spinlock  early_spin[8];
+extern "C" void* _ReturnAddress(void);
+#pragma intrinsic(_ReturnAddress)
+
+/* pause iterations per waiter ahead of us */
+#define SPINLOCK_BACKOFF  16
+#define SPINLOCK_STAT_LINE  192
+#define RFLAGS_IF  (1<<9)
+
+Spinlock  early_spin[SPINLOCK_EARLY_POOL];
 static uint8_t early_spinlock_cnt = 0;
+static Spinlock statListLock;
+static Spinlock* statList;
+static bool _lock_tracking;
+
+/*
+ * AuInitialiseSpinlock -- initialise a statically
+ * allocated or embedded spinlock
+ * @param lock -- pointer to spinlock
+ */
+AU_EXTERN AU_EXPORT void AuInitialiseSpinlock(Spinlock* lock) {
+	memset(lock, 0, sizeof(Spinlock));
+	lock->holderCpu = 0xFF;
+}
 
 /*
  * AuCreateSpinlock -- creates a new spinlock and return
@@ -44,42 +71,128 @@ static uint8_t early_spinlock_cnt = 0;
 AU_EXTERN AU_EXPORT Spinlock* AuCreateSpinlock(bool early) {
 	Spinlock* spinlock = NULL;
 	if (early) {
+		if (early_spinlock_cnt >= SPINLOCK_EARLY_POOL) {
+			SeTextOut("[aurora kernel]: early spinlock pool exhausted \r\n");
+			return NULL;
+		}
 		spinlock = &early_spin[early_spinlock_cnt];
-		spinlock->value = 0;
 		early_spinlock_cnt++;
 	}
 	else {
 		spinlock = (Spinlock*)kmalloc(sizeof(Spinlock));
-		spinlock->value = 0;
+		if (!spinlock)
+			return NULL;
 	}
-
+	AuInitialiseSpinlock(spinlock);
 	return spinlock;
 }
 
+/*
+ * AuSpinlockUnlink -- remove a lock from statistics
+ * list
+ * @param lock -- pointer to spinlock
+ */
+static void AuSpinlockUnlink(Spinlock* lock) {
+	if (!lock->name)
+		return;
+	AuAcquireSpinlock(&statListLock);
+	Spinlock** link = &statList;
+	while (*link) {
+		if (*link == lock) {
+			*link = lock->statNext;
+			break;
+		}
+		link = &(*link)->statNext;
+	}
+	AuReleaseSpinlock(&statListLock);
+	lock->name = NULL;
+	lock->statNext = NULL;
+}
+
 /*
  * AuDeleteSpinlock -- deletes only non-early spinlocks
  */
 AU_EXTERN AU_EXPORT void AuDeleteSpinlock(Spinlock* lock) {
+	if (!lock)
+		return;
+	AuSpinlockUnlink(lock);
+	if (lock >= early_spin && lock < &early_spin[SPINLOCK_EARLY_POOL])
+		return;
 	kfree(lock);
 }
 
+/*
+ * AuSpinlockAcquired -- book keeping done once the
+ * lock is held
+ * @param lock -- pointer to spinlock
+ * @param start -- tsc value when acquire began
+ * @param contended -- if we had to wait
+ * @param ip -- caller address
+ */
+static inline void AuSpinlockAcquired(Spinlock* lock, uint64_t start, bool contended, void* ip) {
+	uint64_t now = cpu_read_tsc();
+	lock->stats.acquisitions++;
+	if (contended) {
+		uint64_t spin = now - start;
+		lock->stats.contended++;
+		lock->stats.spinCycles += spin;
+		if (spin > lock->stats.maxSpinCycles)
+			lock->stats.maxSpinCycles = spin;
+	}
+	lock->acquiredAt = now;
+	lock->holderIp = ip;
+	if (_lock_tracking)
+		lock->holderCpu = AuPerCPUGetCpuID();
+}
+
+/*
+ * AuSpinlockWait -- takes a ticket and waits for
+ * its turn
+ * @param lock -- pointer to spinlock
+ * @param ip -- caller address
+ */
+static inline void AuSpinlockWait(Spinlock* lock, void* ip) {
+	uint64_t start = cpu_read_tsc();
+	uint32_t ticket = x64_atomic_fetch_add(&lock->next, 1);
+	bool contended = false;
+	uint32_t owner;
+	while ((owner = lock->owner) != ticket) {
+		contended = true;
+		/* back off in proportion to our place in queue, so
+		 * that waiters far behind don't hammer the line */
+		uint32_t delay = (ticket - owner) * SPINLOCK_BACKOFF;
+		for (uint32_t i = 0; i < delay; i++)
+			x64_pause();
+	}
+	AuSpinlockAcquired(lock, start, contended, ip);
+}
+
 /*
  * AuAcquireSpinlock -- acuires a lock
  * @param lock -- pointer to spinlock
  */
 AU_EXTERN AU_EXPORT void AuAcquireSpinlock(Spinlock* lock) {
-	if (lock->value > 1)  {
-		SeTextOut("[aurora kernel]: lock -> %x is corrupted \r\n", lock);
-		lock->value = 0;
-	}
-	do {	
-		if (x64_lock_test(&lock->value, 0, 1)) {
-			break;
-		}
-		x64_pause();
-		volatile size_t* lockd = &lock->value;
-		while (*lockd == 1);
-	} while (1);
+	AuSpinlockWait(lock, _ReturnAddress());
+}
+
+/*
+ * AuTryAcquireSpinlock -- acquire a lock only if it
+ * is free
+ * @param lock -- pointer to spinlock
+ */
+AU_EXTERN AU_EXPORT bool AuTryAcquireSpinlock(Spinlock* lock) {
+	uint64_t start = cpu_read_tsc();
+	uint32_t owner = lock->owner;
+	if (lock->next != owner)
+		return false;
+	/* next and owner share one qword, take the ticket only
+	 * if nobody else took one in between */
+	size_t old = ((size_t)owner << 32) | owner;
+	size_t taken = ((size_t)owner << 32) | (uint32_t)(owner + 1);
+	if (!x64_lock_test((volatile size_t*)&lock->next, old, taken))
+		return false;
+	AuSpinlockAcquired(lock, start, false, _ReturnAddress());
+	return true;
 }
 
 /*
@@ -87,6 +200,167 @@ AU_EXTERN AU_EXPORT void AuAcquireSpinlock(Spinlock* lock) {
  * @param lock -- pointer to spinlock
  */
 AU_EXTERN AU_EXPORT void AuReleaseSpinlock(Spinlock* lock) {
-	if (!x64_lock_test(&lock->value, 1, 0))
-		lock->value = 0;
-}
\ No newline at end of file
+	uint64_t hold = cpu_read_tsc() - lock->acquiredAt;
+	lock->stats.holdCycles += hold;
+	if (hold > lock->stats.maxHoldCycles)
+		lock->stats.maxHoldCycles = hold;
+	lock->holderIp = NULL;
+	lock->holderCpu = 0xFF;
+	/* only the holder writes owner, x86 stores are not
+	 * reordered with earlier stores */
+	lock->owner = lock->owner + 1;
+}
+
+/*
+ * AuAcquireSpinlockIrqSave -- disable interrupts and
+ * acquire a lock
+ * @param lock -- pointer to spinlock
+ */
+AU_EXTERN AU_EXPORT uint64_t AuAcquireSpinlockIrqSave(Spinlock* lock) {
+	uint64_t flags = x64_read_rflags();
+	x64_cli();
+	AuSpinlockWait(lock, _ReturnAddress());
+	return flags;
+}
+
+/*
+ * AuReleaseSpinlockIrqRestore -- release a lock and
+ * restore saved interrupt state
+ * @param lock -- pointer to spinlock
+ * @param flags -- value returned by acquire
+ */
+AU_EXTERN AU_EXPORT void AuReleaseSpinlockIrqRestore(Spinlock* lock, uint64_t flags) {
+	AuReleaseSpinlock(lock);
+	if (flags & RFLAGS_IF)
+		x64_sti();
+}
+
+/*
+ * AuSpinlockIsHeld -- checks if a lock is currently
+ * held by anyone
+ * @param lock -- pointer to spinlock
+ */
+AU_EXTERN AU_EXPORT bool AuSpinlockIsHeld(Spinlock* lock) {
+	return lock->next != lock->owner;
+}
+
+/*
+ * AuSpinlockSetName -- names a lock and makes its
+ * statistics visible through /dev/lockstat
+ * @param lock -- pointer to spinlock
+ * @param name -- name of the lock
+ */
+AU_EXTERN AU_EXPORT void AuSpinlockSetName(Spinlock* lock, const char* name) {
+	if (!lock || !name)
+		return;
+	if (lock->name) {
+		lock->name = name;
+		return;
+	}
+	AuAcquireSpinlock(&statListLock);
+	lock->name = name;
+	lock->statNext = statList;
+	statList = lock;
+	AuReleaseSpinlock(&statListLock);
+}
+
+/*
+ * AuLockStatAppend -- append a string to stat buffer
+ */
+static char* AuLockStatAppend(char* out, const char* str) {
+	size_t len = strlen(str);
+	memcpy(out, str, len);
+	return out + len;
+}
+
+/*
+ * AuLockStatNumber -- append a number followed by a
+ * separator to stat buffer
+ */
+static char* AuLockStatNumber(char* out, uint64_t value, int base) {
+	char num[24];
+	sztoa(value, num, base);
+	out = AuLockStatAppend(out, num);
+	*out++ = ' ';
+	return out;
+}
+
+/*
+ * AuLockStatRead -- read callback of /dev/lockstat, a
+ * fresh snapshot is formatted on every read and
+ * copied from file position
+ * @param fs -- pointer to device node
+ * @param file -- pointer to opened file
+ * @param buffer -- user buffer
+ * @param length -- length to read
+ */
+size_t AuLockStatRead(AuVFSNode* fs, AuVFSNode* file, uint64_t* buffer, size_t length) {
+	if (!file || !buffer)
+		return 0;
+	AuAcquireSpinlock(&statListLock);
+	size_t count = 1;
+	for (Spinlock* lock = statList; lock; lock = lock->statNext)
+		count++;
+	char* text = (char*)kmalloc(count * SPINLOCK_STAT_LINE);
+	if (!text) {
+		AuReleaseSpinlock(&statListLock);
+		return 0;
+	}
+	char* out = AuLockStatAppend(text, "name acquired contended spin maxspin hold maxhold cpu ip\n");
+	for (Spinlock* lock = statList; lock; lock = lock->statNext) {
+		/* names are truncated to keep every line in bounds */
+		size_t nlen = strlen(lock->name);
+		if (nlen > 32)
+			nlen = 32;
+		memcpy(out, lock->name, nlen);
+		out += nlen;
+		*out++ = ' ';
+		out = AuLockStatNumber(out, lock->stats.acquisitions, 10);
+		out = AuLockStatNumber(out, lock->stats.contended, 10);
+		out = AuLockStatNumber(out, lock->stats.spinCycles, 10);
+		out = AuLockStatNumber(out, lock->stats.maxSpinCycles, 10);
+		out = AuLockStatNumber(out, lock->stats.holdCycles, 10);
+		out = AuLockStatNumber(out, lock->stats.maxHoldCycles, 10);
+		if (AuSpinlockIsHeld(lock)) {
+			out = AuLockStatNumber(out, lock->holderCpu, 10);
+			out = AuLockStatAppend(out, "0x");
+			out = AuLockStatNumber(out, (uint64_t)lock->holderIp, 16);
+		}
+		else
+			out = AuLockStatAppend(out, "- - ");
+		out[-1] = '\n';
+	}
+	AuReleaseSpinlock(&statListLock);
+
+	size_t total = out - text;
+	size_t ret = 0;
+	if (file->pos < total) {
+		ret = total - file->pos;
+		if (ret > length)
+			ret = length;
+		memcpy(buffer, text + file->pos, ret);
+		file->pos += ret;
+	}
+	else
+		file->pos = 0;
+	kfree(text);
+	return ret;
+}
+
+/*
+ * AuSpinlockStatInitialise -- creates /dev/lockstat
+ * and enables lock holder tracking
+ */
+void AuSpinlockStatInitialise() {
+	_lock_tracking = true;
+	AuSpinlockSetName(&statListLock, "lockstat");
+	AuVFSNode* dev = AuVFSFind("/dev");
+	if (!dev)
+		return;
+	AuVFSNode* node = (AuVFSNode*)kmalloc(sizeof(AuVFSNode));
+	memset(node, 0, sizeof(AuVFSNode));
+	strcpy(node->filename, "lockstat");
+	node->flags = FS_FLAG_GENERAL | FS_FLAG_DEVICE;
+	node->read = AuLockStatRead;
+	AuDevFSAddFile(dev, "/dev", node);
+}
@@ -31,6 +31,7 @@
 #include <_null.h>
 #include <Mm\vmmngr.h>
 #include <Mm\pmmngr.h>
+#include <Hal\x86_64_lowlevel.h>
 #include <Mm\kmalloc.h>
 #include <string.h>
 #include <va_list.h>
@@ -145,9 +146,8 @@ void AuConsolePostInitialise(PKERNEL_BOOT_INFO info) {
 	aucon = (AuConsole*)kmalloc(sizeof(AuConsole));
 	memset(aucon, 0, sizeof(AuConsole));
 
-	for (int i = 0; i < info->fb_size / PAGE_SIZE; i++)
-		AuMapPage((uint64_t)info->graphics_framebuffer + static_cast<uint64_t>(i) * PAGE_SIZE, 
-			0xFFFFD00000200000 + static_cast<uint64_t>(i) * 4096, X86_64_PAGING_USER);
+	AuVmmngrMapRange((uint64_t*)P2V(x64_read_cr3() & ~(4096 - 1)), (uint64_t)info->graphics_framebuffer,
+		0xFFFFD00000200000, info->fb_size, X86_64_PAGING_USER);
 	early_ = false;
 	aucon->buffer = (uint32_t*)0xFFFFD00000200000;
 	aucon->width = info->X_Resolution;
@@ -33,10 +33,26 @@
 #include <string.h>
 #include <aucon.h>
 #include <Ipc\postbox.h>
+#include <Sync\spinlock.h>
+#include <Hal\x86_64_cpu.h>
+#include <Hal\x86_64_lowlevel.h>
 
 AuTimer *timerFirst;
 AuTimer *timerLast;
 
+/*
+ * High resolution timers are kept in a binary min-heap
+ * ordered by deadline, so the scheduler tick only looks
+ * at the root to find out that nothing is due. Timers
+ * are found by id through a small hash table.
+ */
+static AuHRTimer** hrHeap;
+static int hrHeapCount;
+static int hrHeapSize;
+static AuHRTimer* hrHash[HRTIMER_HASH_SIZE];
+static int hrNextId;
+static Spinlock* hrLock;
+
 /*
 * AuTimerDataInitialise -- initialise timer
 * data's to default value
@@ -44,6 +60,14 @@ AuTimer *timerLast;
 void AuTimerDataInitialise() {
 	timerFirst = NULL;
 	timerLast = NULL;
+	hrHeap = (AuHRTimer**)kmalloc(HRTIMER_HEAP_INITIAL * sizeof(AuHRTimer*));
+	hrHeapCount = 0;
+	hrHeapSize = HRTIMER_HEAP_INITIAL;
+	for (int i = 0; i < HRTIMER_HASH_SIZE; i++)
+		hrHash[i] = NULL;
+	hrNextId = 1;
+	hrLock = AuCreateSpinlock(false);
+	AuSpinlockSetName(hrLock, "hrtimer");
 }
 
 void AuTimerInsert(AuTimer* timer) {
@@ -85,7 +109,7 @@ void AuTimerDelete(AuTimer* timer) {
 /*
 * AuTimerCreate -- create a new timer and immediately it will start
 */
-void AuTimerCreate(uint16_t thread_id, int maxTickLimit, uint8_t updateOrder){
+void AuTimerCreate(uint32_t thread_id, int maxTickLimit, uint8_t updateOrder){
 	AuTimer* timer = (AuTimer*)kmalloc(sizeof(AuTimer));
 	memset(timer, 0, sizeof(AuTimer));
 	timer->threadId = thread_id;
@@ -99,7 +123,7 @@ void AuTimerCreate(uint16_t thread_id, int maxTickLimit, uint8_t updateOrder){
 *AuTimerStart -- starts the timer
 * @param threadId -- timer's thread id
 */
-void AuTimerStart(uint16_t threadId) {
+void AuTimerStart(uint32_t threadId) {
 	for (AuTimer* t = timerFirst; t != NULL; t = t->next) {
 		if (t->threadId == threadId) {
 			t->run = true;
@@ -113,7 +137,7 @@ void AuTimerStart(uint16_t threadId) {
 * AuTimerStop -- stop the timer
 * @param threadId -- timer's thread id
 */
-void AuTimerStop(uint16_t threadId) {
+void AuTimerStop(uint32_t threadId) {
 	for (AuTimer* t = timerFirst; t != NULL; t = t->next) {
 		if (t->threadId == threadId){
 			t->run = false;
@@ -127,7 +151,7 @@ void AuTimerStop(uint16_t threadId) {
 * with given thread id
 * @param threadId -- thread's id
 */
-void AuTimerDestroy(uint16_t threadID) {
+void AuTimerDestroy(uint32_t threadID) {
 	for (AuTimer* t = timerFirst; t != NULL; t = t->next) {
 		if (t->threadId == threadID){
 			AuTimerDelete(t);
@@ -207,4 +231,318 @@ void AuTimerFire(int sec, int min, int hour) {
 			}
 		}
 	}
-}
\ No newline at end of file
+}
+
+/*
+ * AuTimerGetNanoseconds -- returns nanoseconds of the
+ * monotonic clock, counted from tsc
+ */
+uint64_t AuTimerGetNanoseconds() {
+	/* cpu speed is measured in ticks per microsecond */
+	uint64_t mhz = x86_64_cpu_get_mhz();
+	uint64_t tsc = cpu_read_tsc();
+	return (tsc / mhz) * 1000 + ((tsc % mhz) * 1000) / mhz;
+}
+
+static void AuHRTimerHeapSet(int idx, AuHRTimer* t) {
+	hrHeap[idx] = t;
+	t->heapIdx = idx;
+}
+
+static void AuHRTimerSiftUp(int idx) {
+	AuHRTimer* t = hrHeap[idx];
+	while (idx > 0) {
+		int parent = (idx - 1) / 2;
+		if (hrHeap[parent]->deadline <= t->deadline)
+			break;
+		AuHRTimerHeapSet(idx, hrHeap[parent]);
+		idx = parent;
+	}
+	AuHRTimerHeapSet(idx, t);
+}
+
+static void AuHRTimerSiftDown(int idx) {
+	AuHRTimer* t = hrHeap[idx];
+	for (;;) {
+		int child = idx * 2 + 1;
+		if (child >= hrHeapCount)
+			break;
+		if (child + 1 < hrHeapCount && hrHeap[child + 1]->deadline < hrHeap[child]->deadline)
+			child++;
+		if (t->deadline <= hrHeap[child]->deadline)
+			break;
+		AuHRTimerHeapSet(idx, hrHeap[child]);
+		idx = child;
+	}
+	AuHRTimerHeapSet(idx, t);
+}
+
+/*
+ * AuHRTimerHeapInsert -- queue a timer by its deadline
+ * @param t -- Pointer to timer
+ */
+static bool AuHRTimerHeapInsert(AuHRTimer* t) {
+	if (hrHeapCount == hrHeapSize) {
+		AuHRTimer** heap = (AuHRTimer**)krealloc(hrHeap, hrHeapSize * 2 * sizeof(AuHRTimer*));
+		if (!heap)
+			return false;
+		hrHeap = heap;
+		hrHeapSize *= 2;
+	}
+	AuHRTimerHeapSet(hrHeapCount, t);
+	hrHeapCount++;
+	AuHRTimerSiftUp(t->heapIdx);
+	return true;
+}
+
+/*
+ * AuHRTimerHeapRemove -- dequeue a timer, if armed
+ * @param t -- Pointer to timer
+ */
+static void AuHRTimerHeapRemove(AuHRTimer* t) {
+	int idx = t->heapIdx;
+	if (idx < 0)
+		return;
+	t->heapIdx = -1;
+	hrHeapCount--;
+	if (idx == hrHeapCount)
+		return;
+	AuHRTimerHeapSet(idx, hrHeap[hrHeapCount]);
+	AuHRTimerSiftDown(idx);
+	AuHRTimerSiftUp(hrHeap[idx]->heapIdx);
+}
+
+/*
+ * AuHRTimerFind -- look up a timer owned by given
+ * thread
+ * @param threadId -- owner thread id
+ * @param id -- timer id
+ */
+static AuHRTimer* AuHRTimerFind(uint32_t threadId, int id) {
+	for (AuHRTimer* t = hrHash[id % HRTIMER_HASH_SIZE]; t != NULL; t = t->hashNext) {
+		if (t->id == id)
+			return (t->threadId == threadId) ? t : NULL;
+	}
+	return NULL;
+}
+
+/*
+ * AuHRTimerCreate -- creates a disarmed high resolution
+ * timer owned by a thread
+ * @param threadId -- owner thread id
+ * @param flags -- HRTIMER_FLAG_* bits
+ * @return timer id, -1 on failure
+ */
+int AuHRTimerCreate(uint32_t threadId, uint8_t flags) {
+	AuHRTimer* t = (AuHRTimer*)kmalloc(sizeof(AuHRTimer));
+	if (!t)
+		return -1;
+	memset(t, 0, sizeof(AuHRTimer));
+	t->threadId = threadId;
+	t->flags = flags;
+	t->heapIdx = -1;
+
+	uint64_t irq = AuAcquireSpinlockIrqSave(hrLock);
+	t->id = hrNextId++;
+	int bucket = t->id % HRTIMER_HASH_SIZE;
+	t->hashNext = hrHash[bucket];
+	hrHash[bucket] = t;
+	AuReleaseSpinlockIrqRestore(hrLock, irq);
+	return t->id;
+}
+
+/*
+ * AuHRTimerArm -- arm or re-arm a timer
+ * @param threadId -- caller thread id
+ * @param id -- timer id
+ * @param initial -- first expiry in nanoseconds, relative
+ * to now unless HRTIMER_ARM_ABSOLUTE is given
+ * @param period -- interval for periodic timers, 0 for
+ * one-shot
+ * @param flags -- HRTIMER_ARM_* bits
+ */
+int AuHRTimerArm(uint32_t threadId, int id, uint64_t initial, uint64_t period, uint8_t flags) {
+	uint64_t now = AuTimerGetNanoseconds();
+	uint64_t irq = AuAcquireSpinlockIrqSave(hrLock);
+	AuHRTimer* t = AuHRTimerFind(threadId, id);
+	if (!t) {
+		AuReleaseSpinlockIrqRestore(hrLock, irq);
+		return -1;
+	}
+	AuHRTimerHeapRemove(t);
+	t->deadline = (flags & HRTIMER_ARM_ABSOLUTE) ? initial : now + initial;
+	t->period = period;
+	t->expirations = 0;
+	int ret = AuHRTimerHeapInsert(t) ? 0 : -1;
+	AuReleaseSpinlockIrqRestore(hrLock, irq);
+	return ret;
+}
+
+/*
+ * AuHRTimerDisarm -- stops a timer, pending expirations
+ * are kept
+ * @param threadId -- caller thread id
+ * @param id -- timer id
+ */
+int AuHRTimerDisarm(uint32_t threadId, int id) {
+	uint64_t irq = AuAcquireSpinlockIrqSave(hrLock);
+	AuHRTimer* t = AuHRTimerFind(threadId, id);
+	if (t)
+		AuHRTimerHeapRemove(t);
+	AuReleaseSpinlockIrqRestore(hrLock, irq);
+	return t ? 0 : -1;
+}
+
+/*
+ * AuHRTimerWait -- blocks until the timer expired at least
+ * once, returns and clears number of expirations
+ * @param thr -- caller thread
+ * @param id -- timer id
+ */
+int64_t AuHRTimerWait(AuThread* thr, int id) {
+	uint64_t irq = AuAcquireSpinlockIrqSave(hrLock);
+	AuHRTimer* t = AuHRTimerFind(thr->id, id);
+	if (!t) {
+		AuReleaseSpinlockIrqRestore(hrLock, irq);
+		return -1;
+	}
+
+	if (t->expirations == 0) {
+		/* a disarmed timer would never wake us */
+		if (t->heapIdx < 0) {
+			AuReleaseSpinlockIrqRestore(hrLock, irq);
+			return -1;
+		}
+		t->waiter = thr;
+		AuBlockThread(thr);
+		AuReleaseSpinlock(hrLock);
+		AuForceScheduler();
+
+		/* timer might have been closed meanwhile */
+		x64_cli();
+		AuAcquireSpinlock(hrLock);
+		t = AuHRTimerFind(thr->id, id);
+		if (!t) {
+			AuReleaseSpinlockIrqRestore(hrLock, irq);
+			return -1;
+		}
+	}
+	int64_t count = t->expirations;
+	t->expirations = 0;
+	AuReleaseSpinlockIrqRestore(hrLock, irq);
+	return count;
+}
+
+/*
+ * AuHRTimerFree -- unqueue and free a timer, caller
+ * unlinks it from hash
+ * @param t -- Pointer to timer
+ */
+static void AuHRTimerFree(AuHRTimer* t) {
+	AuHRTimerHeapRemove(t);
+	if (t->waiter && t->waiter->state == THREAD_STATE_BLOCKED)
+		AuUnblockThread(t->waiter);
+	kfree(t);
+}
+
+/*
+ * AuHRTimerClose -- destroys a timer, a thread waiting
+ * on it is released
+ * @param threadId -- caller thread id
+ * @param id -- timer id
+ */
+int AuHRTimerClose(uint32_t threadId, int id) {
+	uint64_t irq = AuAcquireSpinlockIrqSave(hrLock);
+	AuHRTimer** link = &hrHash[id % HRTIMER_HASH_SIZE];
+	while (*link != NULL) {
+		AuHRTimer* t = *link;
+		if (t->id == id && t->threadId == threadId) {
+			*link = t->hashNext;
+			AuHRTimerFree(t);
+			AuReleaseSpinlockIrqRestore(hrLock, irq);
+			return 0;
+		}
+		link = &t->hashNext;
+	}
+	AuReleaseSpinlockIrqRestore(hrLock, irq);
+	return -1;
+}
+
+/*
+ * AuHRTimerRemoveThread -- destroys every timer owned
+ * by a thread
+ * @param threadId -- thread id
+ */
+void AuHRTimerRemoveThread(uint32_t threadId) {
+	uint64_t irq = AuAcquireSpinlockIrqSave(hrLock);
+	for (int i = 0; i < HRTIMER_HASH_SIZE; i++) {
+		AuHRTimer** link = &hrHash[i];
+		while (*link != NULL) {
+			AuHRTimer* t = *link;
+			if (t->threadId != threadId) {
+				link = &t->hashNext;
+				continue;
+			}
+			*link = t->hashNext;
+			/* the only possible waiter is the dying owner */
+			t->waiter = NULL;
+			AuHRTimerFree(t);
+		}
+	}
+	AuReleaseSpinlockIrqRestore(hrLock, irq);
+}
+
+/*
+ * AuHRTimerNotify -- deliver an expiry to the owner
+ * @param t -- Pointer to timer
+ * @param fired -- number of periods passed
+ * @param deadline -- deadline that expired
+ */
+static void AuHRTimerNotify(AuHRTimer* t, uint64_t fired, uint64_t deadline) {
+	if (t->waiter) {
+		if (t->waiter->state == THREAD_STATE_BLOCKED)
+			AuUnblockThread(t->waiter);
+		t->waiter = NULL;
+	}
+
+	if (t->flags & HRTIMER_FLAG_POSTBOX) {
+		PostEvent e;
+		memset(&e, 0, sizeof(PostEvent));
+		e.type = HRTIMER_MESSAGE_CODE;
+		e.to_id = t->threadId;
+		e.dword = t->id;
+		e.dword2 = (fired > UINT32_MAX) ? UINT32_MAX : (uint32_t)fired;
+		e.dword3 = (uint32_t)deadline;
+		e.dword4 = (uint32_t)(deadline >> 32);
+		PostBoxPutEvent(&e);
+	}
+}
+
+/*
+ * AuHRTimerExpire -- fire every timer whose deadline has
+ * passed, called from scheduler tick
+ */
+void AuHRTimerExpire() {
+	if (hrHeapCount == 0)
+		return;
+
+	uint64_t now = AuTimerGetNanoseconds();
+	uint64_t irq = AuAcquireSpinlockIrqSave(hrLock);
+	while (hrHeapCount > 0 && hrHeap[0]->deadline <= now) {
+		AuHRTimer* t = hrHeap[0];
+		uint64_t deadline = t->deadline;
+		uint64_t fired = 1;
+		if (t->period) {
+			/* periods missed while late are folded into
+			 * one expiry, the schedule does not drift */
+			fired += (now - deadline) / t->period;
+			t->deadline = deadline + fired * t->period;
+			AuHRTimerSiftDown(0);
+		}
+		else
+			AuHRTimerHeapRemove(t);
+		t->expirations += fired;
+		AuHRTimerNotify(t, fired, deadline);
+	}
+	AuReleaseSpinlockIrqRestore(hrLock, irq);
+}
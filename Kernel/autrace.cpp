@@ -0,0 +1,218 @@
+/**
+* BSD 2-Clause License
+*
+* Copyright (c) 2022-2023, Manas Kamal Choudhury
+* All rights reserved.
+*
+* Redistribution and use in source and binary forms, with or without
+* modification, are permitted provided that the following conditions are met:
+*
+* 1. Redistributions of source code must retain the above copyright notice, this
+*    list of conditions and the following disclaimer.
+*
+* 2. Redistributions in binary form must reproduce the above copyright notice,
+*    this list of conditions and the following disclaimer in the documentation
+*    and/or other materials provided with the distribution.
+*
+* THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+* AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+* IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+* DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE
+* FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+* DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR
+* SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER
+* CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY,
+* OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+* OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+*
+**/
+
+#include <autrace.h>
+#include <ringbuf.h>
+#include <string.h>
+#include <_null.h>
+#include <Sync\spinlock.h>
+#include <Mm\pmmngr.h>
+#include <Mm\vmmngr.h>
+#include <Hal\x86_64_cpu.h>
+#include <Hal\x86_64_lowlevel.h>
+#include <Hal\x86_64_sched.h>
+#include <Hal\pcpu.h>
+#include <Hal\basicacpi.h>
+
+#define RFLAGS_IF  (1<<9)
+
+/*
+ * Every cpu is the only producer of its own ring, it
+ * writes with interrupts off so an irq tracepoint can't
+ * interleave with a half written record. Readers are
+ * serialised by trace_lock and are the only consumer.
+ * Timestamps are raw tsc, cpus are assumed to share an
+ * invariant tsc so records from different rings can be
+ * merged by value
+ */
+volatile uint32_t _au_trace_mask;
+static AuRingBuffer trace_ring[TRACE_MAX_CPUS];
+static volatile uint64_t trace_lost[TRACE_MAX_CPUS];
+static uint64_t trace_reported[TRACE_MAX_CPUS];
+static volatile bool _trace_ready;
+static Spinlock trace_lock;
+
+/*
+ * AuTraceEmit -- put a record into current cpu's ring,
+ * record is dropped and counted if the ring is full
+ * @param event -- event id
+ * @param arg0 -- first argument
+ * @param arg1 -- second argument
+ */
+void AuTraceEmit(uint16_t event, uint64_t arg0, uint64_t arg1) {
+	if (!_trace_ready)
+		return;
+	uint64_t flags = x64_read_rflags();
+	x64_cli();
+	uint8_t cpu = AuPerCPUGetCpuID();
+	if (cpu < TRACE_MAX_CPUS) {
+		AuRingBuffer* ring = &trace_ring[cpu];
+		if (AuRingBufAvailable(ring) >= sizeof(AuTraceRecord)) {
+			AuTraceRecord rec;
+			AuThread* thr = AuPerCPUGetCurrentThread();
+			rec.tsc = cpu_read_tsc();
+			rec.event = event;
+			rec.cpu = cpu;
+			rec.rsvd = 0;
+			rec.thread = thr ? thr->id : 0;
+			rec.arg0 = arg0;
+			rec.arg1 = arg1;
+			AuRingBufWrite(ring, (const uint8_t*)&rec, sizeof(AuTraceRecord));
+		}
+		else
+			trace_lost[cpu] = trace_lost[cpu] + 1;
+	}
+	if (flags & RFLAGS_IF)
+		x64_sti();
+}
+
+/*
+ * AuTraceAllocate -- allocate rings for every present
+ * cpu, done once under trace_lock
+ */
+static int AuTraceAllocate() {
+	uint8_t count = AuGetCPUCount();
+	if (count == 0)
+		count = 1;
+	if (count > TRACE_MAX_CPUS)
+		count = TRACE_MAX_CPUS;
+	for (int i = 0; i < count; i++) {
+		if (trace_ring[i].buffer)
+			continue;
+		void* frames = AuPmmngrAllocBlocks(TRACE_RING_SIZE / PAGE_SIZE);
+		if (!frames)
+			return -1;
+		AuRingBufInit(&trace_ring[i], (uint8_t*)P2V((uint64_t)frames), TRACE_RING_SIZE);
+	}
+	return 0;
+}
+
+/*
+ * AuTraceEnable -- enable a set of events, rings are
+ * allocated on first enable
+ * @param mask -- events to enable
+ * @return 0 on success, -1 if rings could not be allocated
+ */
+int AuTraceEnable(uint32_t mask) {
+	AuAcquireSpinlock(&trace_lock);
+	if (!_trace_ready) {
+		if (AuTraceAllocate() == -1) {
+			AuReleaseSpinlock(&trace_lock);
+			return -1;
+		}
+		_trace_ready = true;
+	}
+	_au_trace_mask = mask;
+	AuReleaseSpinlock(&trace_lock);
+	return 0;
+}
+
+/*
+ * AuTraceDisable -- stop emitting any event, recorded
+ * data stays until read or reset
+ */
+void AuTraceDisable() {
+	_au_trace_mask = 0;
+}
+
+/*
+ * AuTraceReset -- drop everything recorded so far,
+ * consumer side only so producers may keep running
+ */
+void AuTraceReset() {
+	AuAcquireSpinlock(&trace_lock);
+	if (_trace_ready) {
+		for (int i = 0; i < TRACE_MAX_CPUS; i++) {
+			AuRingBuffer* ring = &trace_ring[i];
+			if (!ring->buffer)
+				continue;
+			AuRingBufReadCommit(ring, AuRingBufUsed(ring));
+			trace_reported[i] = trace_lost[i];
+		}
+	}
+	AuReleaseSpinlock(&trace_lock);
+}
+
+/*
+ * AuTraceDrain -- move whole records out of the rings,
+ * a lost record is put in front of a cpu's records
+ * whenever it dropped some since the last drain
+ * @param records -- where to put the records
+ * @param max -- maximum number of records
+ * @return number of records copied
+ */
+uint32_t AuTraceDrain(AuTraceRecord* records, uint32_t max) {
+	uint32_t got = 0;
+	AuAcquireSpinlock(&trace_lock);
+	if (!_trace_ready) {
+		AuReleaseSpinlock(&trace_lock);
+		return 0;
+	}
+	for (int i = 0; i < TRACE_MAX_CPUS && got < max; i++) {
+		AuRingBuffer* ring = &trace_ring[i];
+		if (!ring->buffer)
+			continue;
+		uint64_t lost = trace_lost[i];
+		if (lost != trace_reported[i]) {
+			AuTraceRecord* rec = &records[got++];
+			memset(rec, 0, sizeof(AuTraceRecord));
+			rec->tsc = cpu_read_tsc();
+			rec->event = TRACE_EVENT_LOST;
+			rec->cpu = i;
+			rec->arg0 = lost - trace_reported[i];
+			trace_reported[i] = lost;
+			if (got == max)
+				break;
+		}
+		uint32_t n = AuRingBufUsed(ring) / sizeof(AuTraceRecord);
+		if (n > max - got)
+			n = max - got;
+		if (n == 0)
+			continue;
+		AuRingBufRead(ring, (uint8_t*)&records[got], n * sizeof(AuTraceRecord));
+		got += n;
+	}
+	AuReleaseSpinlock(&trace_lock);
+	return got;
+}
+
+/*
+ * AuTraceFillHeader -- fill in a dump header
+ * @param hdr -- Pointer to header
+ */
+void AuTraceFillHeader(AuTraceHeader* hdr) {
+	uint64_t lost = 0;
+	for (int i = 0; i < TRACE_MAX_CPUS; i++)
+		lost += trace_lost[i];
+	hdr->magic = TRACE_MAGIC;
+	hdr->version = TRACE_VERSION;
+	hdr->recordSize = sizeof(AuTraceRecord);
+	hdr->tscMhz = x86_64_cpu_get_mhz();
+	hdr->lost = lost;
+}
@@ -40,6 +40,7 @@
 #include <Sync\mutex.h>
 #include <Sound\sound.h>
 #include <Mm\shm.h>
+#include <Mm\tlb.h>
 
 /*
 * FreeUserStack -- free up allocated user stack
@@ -129,16 +130,11 @@ void AuProcessClean(AuProcess* parent, AuProcess* killable) {
 	FreeImage(killable);
 
 	/* free up vmareas */
-	for (int i = 0; i < killable->vmareas->pointer; i++) {
-		AuVMArea* area = (AuVMArea*)list_remove(killable->vmareas, i);
-		if (area)
-			kfree(area);
-	}
-	kfree(killable->vmareas);
+	AuVMAreaDestroyAll(killable);
 
 
 	/* finally free up all threads */
-	for (int i = 1; i < MAX_THREADS_PER_PROCESS -1 ; i++) {
+	for (int i = 1; i < killable->num_thread; i++) {
 		AuThread *t_ = killable->threads[i];
 		if (t_) {
 			SeTextOut("cleaning thread -> %x %s\n", t_, t_->name);
@@ -178,7 +174,10 @@ void AuProcessClean(AuProcess* parent, AuProcess* killable) {
 	AuThreadFree(killable, killable->main_thread);
 
 	/* release the process slot */
+	AuProcessFreeTables(killable);
 
+	/* the root table is going away, drop its pcid */
+	AuTLBReleaseCR3(V2P((size_t)killable->cr3));
 	AuPmmngrFree((void*)V2P((size_t)killable->cr3));
 	AuRemoveProcess(0, killable);
 	SeTextOut("Used RAM -> %d GB \ Avail -> %d GB \r\n", ((AuPmmngrGetFreeMem() * PAGE_SIZE) / 1024 / 1024 / 1024),
@@ -109,8 +109,10 @@ FontSeg* FontManagerAllocateSegment(AuVFSNode* fontfile, char* fontname) {
 	memset(seg, 0, sizeof(FontSeg));
 	strcpy(seg->fontname, fontname);
 	uint32_t alignedSz = ALIGN_UP(fontfile->size, 4096);
-	int id = AuCreateSHM(NULL, FontManagerGetKey(), alignedSz, 0);
-	seg->sharedSeg = AuGetSHMByID(id);
+	/* the font manager keeps its own reference, fonts
+	 * stay loaded while applications come and go */
+	int64_t handle = AuCreateSHM(NULL, FontManagerGetKey(), alignedSz, 0);
+	seg->sharedSeg = AuSHMGet(handle);
 	seg->fontFileSz = fontfile->size;
 	FontManagerAddSegment(seg);
 	return seg;
@@ -248,7 +250,7 @@ int AuFTMngrGetFontID(char* fontname) {
 	int font_id = 0;
 	for (FontSeg* seg = firstSeg; seg != NULL; seg = seg->next) {
 		if (strcmp(fontname, seg->fontname) == 0) {
-			font_id =  (seg->sharedSeg->id << 16) | seg->sharedSeg->key & UINT16_MAX;
+			font_id = (int)seg->sharedSeg->key;
 			return font_id;
 		}
 	}
@@ -0,0 +1,154 @@
+/**
+* BSD 2-Clause License
+*
+* Copyright (c) 2022-2023, Manas Kamal Choudhury
+* All rights reserved.
+*
+* Redistribution and use in source and binary forms, with or without
+* modification, are permitted provided that the following conditions are met:
+*
+* 1. Redistributions of source code must retain the above copyright notice, this
+*    list of conditions and the following disclaimer.
+*
+* 2. Redistributions in binary form must reproduce the above copyright notice,
+*    this list of conditions and the following disclaimer in the documentation
+*    and/or other materials provided with the distribution.
+*
+* THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+* AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+* IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+* DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE
+* FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+* DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR
+* SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER
+* CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY,
+* OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+* OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+*
+**/
+
+#include <idtable.h>
+#include <Mm\kmalloc.h>
+#include <string.h>
+#include <_null.h>
+
+static AuIDTableNode* AuIDTableNewNode() {
+	AuIDTableNode* node = (AuIDTableNode*)kmalloc(sizeof(AuIDTableNode));
+	memset(node, 0, sizeof(AuIDTableNode));
+	return node;
+}
+
+/*
+ * AuIDTableSlot -- returns the leaf slot of an id
+ * @param table -- Pointer to id table
+ * @param id -- id to look
+ * @param create -- create missing interior nodes
+ */
+static void** AuIDTableSlot(AuIDTable* table, uint32_t id, bool create) {
+	AuIDTableNode* node = table->root;
+	for (int level = IDTABLE_LEVELS - 1; level > 0; level--) {
+		int idx = (id >> (level * IDTABLE_LEVEL_BITS)) & (IDTABLE_LEVEL_SIZE - 1);
+		if (!node->slots[idx]) {
+			if (!create)
+				return NULL;
+			node->slots[idx] = AuIDTableNewNode();
+			node->used++;
+		}
+		node = (AuIDTableNode*)node->slots[idx];
+	}
+	return &node->slots[id & (IDTABLE_LEVEL_SIZE - 1)];
+}
+
+/*
+ * AuIDTableLeaf -- returns the leaf node holding an
+ * id, interior nodes must exist
+ * @param table -- Pointer to id table
+ * @param id -- id to look
+ */
+static AuIDTableNode* AuIDTableLeaf(AuIDTable* table, uint32_t id) {
+	AuIDTableNode* node = table->root;
+	for (int level = IDTABLE_LEVELS - 1; level > 0; level--)
+		node = (AuIDTableNode*)node->slots[(id >> (level * IDTABLE_LEVEL_BITS)) & (IDTABLE_LEVEL_SIZE - 1)];
+	return node;
+}
+
+/*
+ * AuIDTableCreate -- creates a new id table
+ */
+AuIDTable* AuIDTableCreate() {
+	AuIDTable* table = (AuIDTable*)kmalloc(sizeof(AuIDTable));
+	table->root = AuIDTableNewNode();
+	table->nextID = 1;
+	table->count = 0;
+	return table;
+}
+
+/*
+ * AuIDTableAlloc -- allocates a free id and binds
+ * object to it
+ * @param table -- Pointer to id table
+ * @param obj -- object to bind
+ * @return new id, IDTABLE_INVALID_ID if table is full
+ */
+uint32_t AuIDTableAlloc(AuIDTable* table, void* obj) {
+	if (table->count == UINT32_MAX - 1)
+		return IDTABLE_INVALID_ID;
+	while (1) {
+		uint32_t id = table->nextID++;
+		if (id == IDTABLE_INVALID_ID)
+			continue;
+		void** slot = AuIDTableSlot(table, id, true);
+		/* after a wrap skip ids still in use */
+		if (*slot)
+			continue;
+		*slot = obj;
+		AuIDTableLeaf(table, id)->used++;
+		table->count++;
+		return id;
+	}
+}
+
+/*
+ * AuIDTableGet -- returns object bound to an id
+ * @param table -- Pointer to id table
+ * @param id -- id to look
+ */
+void* AuIDTableGet(AuIDTable* table, uint32_t id) {
+	void** slot = AuIDTableSlot(table, id, false);
+	if (!slot)
+		return NULL;
+	return *slot;
+}
+
+/*
+ * AuIDTableRemove -- releases an id, leaf and interior
+ * nodes left empty are freed so that memory follows
+ * the number of live ids
+ * @param table -- Pointer to id table
+ * @param id -- id to release
+ */
+void AuIDTableRemove(AuIDTable* table, uint32_t id) {
+	AuIDTableNode* path[IDTABLE_LEVELS];
+	AuIDTableNode* node = table->root;
+	for (int level = IDTABLE_LEVELS - 1; level > 0; level--) {
+		path[level] = node;
+		node = (AuIDTableNode*)node->slots[(id >> (level * IDTABLE_LEVEL_BITS)) & (IDTABLE_LEVEL_SIZE - 1)];
+		if (!node)
+			return;
+	}
+	void** slot = &node->slots[id & (IDTABLE_LEVEL_SIZE - 1)];
+	if (!*slot)
+		return;
+	*slot = NULL;
+	table->count--;
+
+	/* walk back up while nodes are empty, root stays */
+	for (int level = 1; level < IDTABLE_LEVELS; level++) {
+		if (--node->used != 0)
+			return;
+		kfree(node);
+		node = path[level];
+		node->slots[(id >> (level * IDTABLE_LEVEL_BITS)) & (IDTABLE_LEVEL_SIZE - 1)] = NULL;
+	}
+	node->used--;
+}
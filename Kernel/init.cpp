@@ -44,6 +44,7 @@
 #include <Hal\pcpu.h>
 #include <Mm\kmalloc.h>
 #include <Mm\mmap.h>
+#include <Mm\reclaim.h>
 #include <string.h>
 #include <Mm\buddy.h>
 #include <ahci.h>
@@ -65,6 +66,8 @@
 #include <Net\aunet.h>
 #include <Net\arp.h>
 #include <Ipc\postbox.h>
+#include <Ipc\channel.h>
+#include <Sync\futex.h>
 #include <autimer.h>
 #include <ftmngr.h>
 #include <hashmap.h>
@@ -106,8 +109,13 @@ void _AuMain(KERNEL_BOOT_INFO *info) {
 	/* initialise sound service */
 	AuSoundInitialise();
 
+	/* export lock statistics */
+	AuSpinlockStatInitialise();
+
 	/* initialise PostBoxIPCManager */
 	AuIPCPostBoxInitialise();
+	AuChannelInitialise();
+	AuFutexInitialise();
 
 	/* initialise aurora timer manager*/
 	AuTimerDataInitialise();
@@ -118,6 +126,9 @@ void _AuMain(KERNEL_BOOT_INFO *info) {
 	x64_cli();
 	AuSchedulerInitialise();
 
+	/* start page reclaim */
+	AuReclaimInitialise();
+
 	/* initialize the usb core subsystem */
 	AuUSBSubsystemInit();
 	
@@ -299,6 +299,7 @@ int AuLoadExecToProcess(AuProcess* proc, char* filename, int argc,char** argv) {
 void AuInitialiseLoader() {
 	loader_mutex = NULL;
 	loader_lock = AuCreateSpinlock(false);
+	AuSpinlockSetName(loader_lock, "loader_lock");
 	loader_mutex = AuCreateMutex();
 	is_loader_busy = false;
 }
@@ -31,6 +31,7 @@
 #include <aucon.h>
 #include <Mm\vmmngr.h>
 #include <Mm\mmap.h>
+#include <Mm\vmarea.h>
 #include <Mm\kmalloc.h>
 #include <pe.h>
 #include <Mm\pmmngr.h>
@@ -47,10 +48,15 @@
 #include <Sound\sound.h>
 #include <Hal\x86_64_signal.h>
 #include <Ipc\postbox.h>
+#include <Ipc\channel.h>
+#include <Fs\tty.h>
+#include <Sync\futex.h>
+#include <Serv\ioring.h>
 #include <autimer.h>
+#include <idtable.h>
 #include <Net/socket.h>
 
-static int pid = 1;
+static AuIDTable* process_table;
 AuProcess *proc_first;
 AuProcess *proc_last;
 AuProcess *root_proc;
@@ -100,6 +106,10 @@ void AuRemoveProcess(AuProcess* parent, AuProcess* proc) {
 	else {
 		proc->next->prev = proc->prev;
 	}
+	AuIDTableRemove(process_table, proc->proc_id);
+	/* exit path does not always go through AuProcessClean,
+	 * tables already freed there are null */
+	AuProcessFreeTables(proc);
 	kfree(proc);
 }
 
@@ -109,11 +119,7 @@ void AuRemoveProcess(AuProcess* parent, AuProcess* proc) {
  * @param pid -- process id to find
  */
 AuProcess* AuProcessFindByPID(AuProcess* proc, int pid) {
-	for (AuProcess *proc_ = proc_first; proc_ != NULL; proc_ = proc_->next) {
-		if (proc_->proc_id == pid)
-			return proc_;
-	}
-	return NULL;
+	return (AuProcess*)AuIDTableGet(process_table, pid);
 }
 
 /*
@@ -122,13 +128,7 @@ AuProcess* AuProcessFindByPID(AuProcess* proc, int pid) {
 * @param thread -- thread to find
 */
 AuProcess* AuProcessFindByThread(AuProcess* proc, AuThread* thread) {
-	for (AuProcess *proc_ = proc_first; proc_ != NULL; proc_ = proc_->next) {
-		if (proc_->main_thread == thread) {
-			return proc_;
-		}
-	}
-
-	return NULL;
+	return AuProcessFindThread(thread);
 }
 
 /*
@@ -137,11 +137,7 @@ AuProcess* AuProcessFindByThread(AuProcess* proc, AuThread* thread) {
  * @param pid -- process id of the process
  */
 AuProcess *AuProcessFindPID(int pid) {
-	for (AuProcess *proc_ = proc_first; proc_ != NULL; proc_ = proc_->next) {
-		if (proc_->proc_id == pid)
-			return proc_;
-	}
-	return NULL;
+	return (AuProcess*)AuIDTableGet(process_table, pid);
 }
 
 /*
@@ -150,12 +146,10 @@ AuProcess *AuProcessFindPID(int pid) {
  * @param thread -- pointer to  main thread
  */
 AuProcess *AuProcessFindThread(AuThread* thread) {
-	for (AuProcess *proc_ = proc_first; proc_ != NULL; proc_ = proc_->next) {
-		if (proc_->main_thread == thread) {
-			return proc_;
-		}
-	}
-
+	/* every process thread points back to its slot */
+	AuProcess* proc_ = (AuProcess*)thread->procSlot;
+	if (proc_ && proc_->main_thread == thread)
+		return proc_;
 	return NULL;
 }
 
@@ -177,8 +171,7 @@ AuProcess* AuProcessFindSubThread(AuThread* thread) {
  * map
  */
 uint64_t* CreateUserStack(AuProcess *proc, uint64_t* cr3) {
-#define USER_STACK 0x0000700000000000 
-	uint64_t location = USER_STACK;
+	uint64_t location = PROCESS_USER_STACK_ADDRESS;
 	location += proc->_user_stack_index_;
 
 	for (int i = 0; i < (PROCESS_USER_STACK_SZ / PAGE_SIZE); ++i) {
@@ -236,11 +229,65 @@ void KernelStackFree(AuProcess* proc,void* ptr, uint64_t *cr3) {
 /*
  * AuAllocateProcessID -- allocates a new
  * pid and return
+ * @param proc -- process to bind with the pid
  */
-int AuAllocateProcessID() {
-	size_t _pid = pid;
-	pid = pid + 1;
-	return _pid;
+int AuAllocateProcessID(AuProcess* proc) {
+	return AuIDTableAlloc(process_table, proc);
+}
+
+/*
+ * AuProcessGrowFileTable -- grows the file descriptor
+ * table so that it can hold fd
+ * @param proc -- pointer to process slot
+ * @param fd -- descriptor that needs to fit
+ */
+static bool AuProcessGrowFileTable(AuProcess* proc, int fd) {
+	if (fd < proc->max_fds)
+		return true;
+	if (fd >= FILE_DESC_INDEX_LIMIT)
+		return false;
+
+	int newsz = proc->max_fds ? proc->max_fds : FILE_DESC_TABLE_INITIAL_SZ;
+	while (newsz <= fd)
+		newsz *= 2;
+
+	AuVFSNode** fds = (AuVFSNode**)kmalloc(newsz * sizeof(AuVFSNode*));
+	uint64_t* bitmap = (uint64_t*)kmalloc((newsz / 64) * sizeof(uint64_t));
+	if (!fds || !bitmap) {
+		if (fds)
+			kfree(fds);
+		if (bitmap)
+			kfree(bitmap);
+		return false;
+	}
+	memset(fds, 0, newsz * sizeof(AuVFSNode*));
+	memset(bitmap, 0, (newsz / 64) * sizeof(uint64_t));
+
+	if (proc->fds) {
+		memcpy(fds, proc->fds, proc->max_fds * sizeof(AuVFSNode*));
+		memcpy(bitmap, proc->fd_bitmap, (proc->max_fds / 64) * sizeof(uint64_t));
+		kfree(proc->fds);
+		kfree(proc->fd_bitmap);
+	}
+	proc->fds = fds;
+	proc->fd_bitmap = bitmap;
+	proc->max_fds = newsz;
+	return true;
+}
+
+/*
+ * AuProcessInitTables -- allocates initial thread and
+ * file descriptor tables for a process
+ * @param proc -- pointer to process slot
+ */
+static void AuProcessInitTables(AuProcess* proc) {
+	proc->threads = (AuThread**)kmalloc(THREAD_TABLE_INITIAL_SZ * sizeof(AuThread*));
+	memset(proc->threads, 0, THREAD_TABLE_INITIAL_SZ * sizeof(AuThread*));
+	proc->max_thread = THREAD_TABLE_INITIAL_SZ;
+	proc->fds = NULL;
+	proc->fd_bitmap = NULL;
+	proc->max_fds = 0;
+	AuProcessGrowFileTable(proc, FILE_DESC_TABLE_INITIAL_SZ - 1);
 }
 
 /*
@@ -250,7 +297,7 @@ AuProcess* AuCreateRootProc() {
 	AuProcess *proc = (AuProcess*)kmalloc(sizeof(AuProcess));
 	memset(proc, 0, sizeof(AuProcess));
 
-	proc->proc_id = AuAllocateProcessID();
+	proc->proc_id = AuAllocateProcessID(proc);
 	memset(proc->name, 0, 16);
 	strcpy(proc->name, "_root");
 
@@ -268,14 +315,12 @@ AuProcess* AuCreateRootProc() {
 	else
 		proc->_envp_block_ = 0x5000;
 	
-	proc->vmareas = initialize_list();
+	proc->vmroot = NULL;
 	proc->shmmaps = initialize_list();
-	proc->shm_break = USER_SHARED_MEM_START;
 	proc->proc_mem_heap = PROCESS_BREAK_ADDRESS;
 	proc->proc_mmap_len = 0;
 	proc->waitlist = initialize_list();
-	for (int i = 0; i < FILE_DESC_PER_PROCESS; i++)
-		proc->fds[i] = 0;
+	AuProcessInitTables(proc);
 
 	/* create the main thread after loading the
 	 * image file to process, because just after
@@ -296,7 +341,7 @@ AuProcess* AuCreateProcessSlot(AuProcess* parent, char* name) {
 	memset(proc, 0, sizeof(AuProcess));
 	strcpy(proc->name, name);
 
-	proc->proc_id = AuAllocateProcessID();
+	proc->proc_id = AuAllocateProcessID(proc);
 
 	/* create empty virtual address space */
 	uint64_t* cr3 = AuCreateVirtualAddressSpace();
@@ -315,14 +360,12 @@ AuProcess* AuCreateProcessSlot(AuProcess* parent, char* name) {
 	if (proc->_envp_block_) 
 		memcpy((void*)envpBlock,(void*)parent->_envp_block_, PAGE_SIZE);
 	
-	proc->vmareas = initialize_list();
+	proc->vmroot = NULL;
 	proc->shmmaps = initialize_list();
-	proc->shm_break = USER_SHARED_MEM_START;
 	proc->proc_mem_heap = PROCESS_BREAK_ADDRESS;
 	proc->proc_mmap_len = 0;
 	proc->waitlist = initialize_list();
-	for (int i = 0; i < FILE_DESC_PER_PROCESS; i++)
-		proc->fds[i] = 0;
+	AuProcessInitTables(proc);
 
 	proc->main_thread = NULL;
 
@@ -342,7 +385,7 @@ AuProcess* AuCreateProcessSlot(AuProcess* parent, char* name) {
 void AuStartRootProc() {
 	proc_first = NULL;
 	proc_last = NULL;
-	pid = 1;
+	process_table = AuIDTableCreate();
 	process_mutex = AuCreateMutex();
 	root_proc = AuCreateRootProc();
 	int num_args = 1;
@@ -415,18 +458,151 @@ void AuProcessWaitForTermination(AuProcess *proc, int pid) {
 	}
 }
 
+/*
+ * AuProcessFreeTables -- frees thread and file
+ * descriptor tables of a process
+ * @param proc -- pointer to process slot
+ */
+void AuProcessFreeTables(AuProcess* proc) {
+	if (proc->threads)
+		kfree(proc->threads);
+	if (proc->fds)
+		kfree(proc->fds);
+	if (proc->fd_bitmap)
+		kfree(proc->fd_bitmap);
+	proc->threads = NULL;
+	proc->fds = NULL;
+	proc->fd_bitmap = NULL;
+	proc->max_thread = 0;
+	proc->max_fds = 0;
+}
+
 /*
  * AuProcessGetFileDesc -- returns a empty file descriptor
  * from process slot, 0, 1 & 2 are reserved for terminal
- * output
+ * output. The lowest free descriptor is found through
+ * the bitmap, 64 slots at a time
  * @param proc -- pointer to process slot
  */
 int AuProcessGetFileDesc(AuProcess* proc) {
-	for (int i = 3; i < (FILE_DESC_PER_PROCESS-3); i++) {
-		if (!proc->fds[i])
-			return i;
+	int words = proc->max_fds / 64;
+	for (int w = FILE_DESC_FIRST_FREE / 64; w < words; w++) {
+		uint64_t used = proc->fd_bitmap[w];
+		if (w == FILE_DESC_FIRST_FREE / 64)
+			used |= ((uint64_t)1 << (FILE_DESC_FIRST_FREE % 64)) - 1;
+		if (used == UINT64_MAX)
+			continue;
+		int bit = 0;
+		while (used & ((uint64_t)1 << bit))
+			bit++;
+		return w * 64 + bit;
 	}
-	return -1;
+
+	/* table is full, next one goes to the grown part */
+	int fd = proc->max_fds;
+	if (!AuProcessGrowFileTable(proc, fd))
+		return -1;
+	return fd;
+}
+
+/*
+ * AuProcessGetFileNode -- returns the file bound
+ * to a file descriptor
+ * @param proc -- pointer to process slot
+ * @param fd -- file descriptor
+ */
+AuVFSNode* AuProcessGetFileNode(AuProcess* proc, int fd) {
+	if (fd < 0 || fd >= proc->max_fds)
+		return NULL;
+	return proc->fds[fd];
+}
+
+/*
+ * AuProcessSetFileDesc -- binds a file to a file
+ * descriptor, grows the table if needed
+ * @param proc -- pointer to process slot
+ * @param fd -- file descriptor
+ * @param file -- file to bind
+ */
+int AuProcessSetFileDesc(AuProcess* proc, int fd, AuVFSNode* file) {
+	if (fd < 0)
+		return -1;
+	if (!AuProcessGrowFileTable(proc, fd))
+		return -1;
+	proc->fds[fd] = file;
+	if (file)
+		proc->fd_bitmap[fd / 64] |= ((uint64_t)1 << (fd % 64));
+	else
+		proc->fd_bitmap[fd / 64] &= ~((uint64_t)1 << (fd % 64));
+	return fd;
+}
+
+/*
+ * AuProcessRemoveFileDesc -- releases a file descriptor
+ * @param proc -- pointer to process slot
+ * @param fd -- file descriptor
+ */
+void AuProcessRemoveFileDesc(AuProcess* proc, int fd) {
+	if (fd < 0 || fd >= proc->max_fds)
+		return;
+	proc->fds[fd] = NULL;
+	proc->fd_bitmap[fd / 64] &= ~((uint64_t)1 << (fd % 64));
+}
+
+/*
+ * AuProcessDupFileDesc -- makes newfd refer to the
+ * file of fd, the file keeps a count of descriptors
+ * sharing it and is only closed with the last one
+ * @param proc -- pointer to process slot
+ * @param fd -- file descriptor to duplicate
+ * @param newfd -- target descriptor, -1 for lowest
+ * free one
+ */
+int AuProcessDupFileDesc(AuProcess* proc, int fd, int newfd) {
+	AuVFSNode* file = AuProcessGetFileNode(proc, fd);
+	if (!file)
+		return -1;
+	if (newfd == fd)
+		return fd;
+	if (newfd == -1) {
+		newfd = AuProcessGetFileDesc(proc);
+		if (newfd == -1)
+			return -1;
+	}
+	else if (AuProcessGetFileNode(proc, newfd))
+		return -1;
+
+	if (AuProcessSetFileDesc(proc, newfd, file) == -1)
+		return -1;
+	file->fileCopyCount += 1;
+	return newfd;
+}
+
+/*
+ * AuProcessAddThread -- adds a sub thread to
+ * process thread table, slot 0 belongs to
+ * main thread
+ * @param proc -- pointer to process slot
+ * @param thr -- thread to add
+ */
+int AuProcessAddThread(AuProcess* proc, AuThread* thr) {
+	if (proc->num_thread == 0)
+		proc->num_thread = 1;
+	if (proc->num_thread >= proc->max_thread) {
+		int newsz = proc->max_thread * 2;
+		AuThread** threads = (AuThread**)kmalloc(newsz * sizeof(AuThread*));
+		if (!threads)
+			return -1;
+		memset(threads, 0, newsz * sizeof(AuThread*));
+		memcpy(threads, proc->threads, proc->max_thread * sizeof(AuThread*));
+		kfree(proc->threads);
+		proc->threads = threads;
+		proc->max_thread = newsz;
+	}
+	int thread_indx = proc->num_thread;
+	proc->threads[thread_indx] = thr;
+	proc->num_thread += 1;
+	return thread_indx;
 }
 
 /*
@@ -434,23 +610,10 @@ int AuProcessGetFileDesc(AuProcess* proc) {
  * @param proc -- Pointer to process
  */
 void AuProcessHeapMemDestroy(AuProcess* proc) {
-	uint64_t startaddr = PROCESS_BREAK_ADDRESS;
-	if ((proc->proc_heapmem_len % PAGE_SIZE) != 0)
-		proc->proc_heapmem_len++;
-
-	for (int i = 0; i < proc->proc_heapmem_len / 4096; i++) {
-		AuVPage* page = AuVmmngrGetPage(startaddr + static_cast<uint64_t>(i) * PAGE_SIZE, VIRT_GETPAGE_ONLY_RET, VIRT_GETPAGE_ONLY_RET);
-		if (page) {
-			uint64_t phys = page->bits.page << PAGE_SHIFT;
-			if (phys){
-#if 0
-				SeTextOut("Heap mem destroy -> %x \r\n", phys);
-#endif
-				AuPmmngrFree((void*)phys);
-			}
-			page->bits.page = 0;
-			page->bits.present = 0;
-		}
+	AuVMArea* area = NULL;
+	while ((area = AuVMAreaFindFirst(proc, PROCESS_BREAK_ADDRESS, PROCESS_USER_STACK_ADDRESS)) != NULL) {
+		AuVmmngrUnmapRange(proc->cr3, area->start, area->len, VMMNGR_UNMAP_FREE_PHYSICAL);
+		AuVMAreaUnmap(proc, area->start, area->len);
 	}
 }
 
@@ -473,8 +636,18 @@ void AuProcessFreeKeResource(AuThread* thr) {
 	/* remove allocated postbox*/
 	PostBoxDestroyByID(thr->id);
 
-	/* destroy allocated timer */
+	/* remove from channel wait queues */
+	AuChannelRemoveThread(thr);
+
+	/* remove from tty wait queues */
+	AuTTYRemoveThread(thr);
+
+	/* remove from futex wait queues */
+	AuFutexRemoveThread(thr);
+
+	/* destroy allocated timers */
 	AuTimerDestroy(thr->id);
+	AuHRTimerRemoveThread(thr->id);
 }
 
 /* AuProcessExit -- marks a process
@@ -506,11 +679,15 @@ void AuProcessExit(AuProcess* proc, bool schedulable) {
 		}
 	}
 
+	/* release async syscall ring, its worker is gone
+	 * with the sub threads above */
+	AuIORingDestroy(proc);
+
 
 	/* here we free almost every possible
 	 * data, that we can free
 	 */
-	for (int i = 0; i < FILE_DESC_PER_PROCESS; i++) {
+	for (int i = 0; i < proc->max_fds; i++) {
 		AuVFSNode *file = proc->fds[i];
 		if (file) {
 			SeTextOut("Closing file -> %s , address -> %x \r\n", file->filename, file);
@@ -539,7 +716,9 @@ void AuProcessExit(AuProcess* proc, bool schedulable) {
 	kfree(proc->waitlist);
 
 	SeTextOut("unmapping mem \r\n");
-	UnmapMemMapping((void*)PROCESS_MMAP_ADDRESS, proc->proc_mmap_len);
+	AuVMArea* area = NULL;
+	while ((area = AuVMAreaFindFirst(proc, PROCESS_MMAP_ADDRESS, PROCESS_BREAK_ADDRESS)) != NULL)
+		AuMemMapUnmap(proc, (void*)area->start, area->len);
 	
 	/*unmap all shared memory mappings */
 	AuSHMUnmapAll(proc);
@@ -600,10 +779,7 @@ int AuCreateUserthread(AuProcess* proc, void(*entry) (), char *name)
 	uentry->rsp -= 32;
 	uentry->stackBase = uentry->rsp;
 	thr->uentry = uentry;
-	int thread_indx = proc->num_thread;
-	proc->threads[proc->num_thread] = thr;
-	proc->num_thread += 1;
-	return thread_indx;
+	return AuProcessAddThread(proc, thr);
 }
 
 
@@ -0,0 +1,232 @@
+/**
+* BSD 2-Clause License
+*
+* Copyright (c) 2022-2023, Manas Kamal Choudhury
+* All rights reserved.
+*
+* Redistribution and use in source and binary forms, with or without
+* modification, are permitted provided that the following conditions are met:
+*
+* 1. Redistributions of source code must retain the above copyright notice, this
+*    list of conditions and the following disclaimer.
+*
+* 2. Redistributions in binary form must reproduce the above copyright notice,
+*    this list of conditions and the following disclaimer in the documentation
+*    and/or other materials provided with the distribution.
+*
+* THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+* AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+* IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+* DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE
+* FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+* DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR
+* SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER
+* CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY,
+* OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+* OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+*
+**/
+
+#include <ringbuf.h>
+#include <string.h>
+
+/*
+ * AuRingBufInit -- initialise a ring over caller
+ * provided storage
+ * @param ring -- Pointer to the ring
+ * @param buffer -- storage of the ring
+ * @param size -- size of storage, power of two
+ * @return 0 on success, -1 if size is not a power of two
+ */
+int AuRingBufInit(AuRingBuffer* ring, uint8_t* buffer, uint32_t size) {
+	if (size == 0 || (size & (size - 1)))
+		return -1;
+	ring->buffer = buffer;
+	ring->size = size;
+	ring->mask = size - 1;
+	ring->head = 0;
+	ring->tail = 0;
+	return 0;
+}
+
+/*
+ * AuRingBufReset -- discard everything in the ring,
+ * neither side may be active
+ * @param ring -- Pointer to the ring
+ */
+void AuRingBufReset(AuRingBuffer* ring) {
+	ring->head = 0;
+	ring->tail = 0;
+}
+
+/*
+ * AuRingBufUsed -- number of bytes ready to read
+ * @param ring -- Pointer to the ring
+ */
+uint32_t AuRingBufUsed(AuRingBuffer* ring) {
+	uint32_t head = AU_RING_LOAD_ACQUIRE(&ring->head);
+	return head - AU_RING_LOAD_ACQUIRE(&ring->tail);
+}
+
+/*
+ * AuRingBufAvailable -- number of bytes that can
+ * be written
+ * @param ring -- Pointer to the ring
+ */
+uint32_t AuRingBufAvailable(AuRingBuffer* ring) {
+	return ring->size - AuRingBufUsed(ring);
+}
+
+/*
+ * AuRingBufEmpty -- checks if nothing is ready to read
+ * @param ring -- Pointer to the ring
+ */
+bool AuRingBufEmpty(AuRingBuffer* ring) {
+	return AuRingBufUsed(ring) == 0;
+}
+
+/*
+ * AuRingBufWritePeek -- producer side, get the free
+ * contiguous span at head without copying
+ * @param ring -- Pointer to the ring
+ * @param span -- receives start of the span
+ * @return length of the span
+ */
+uint32_t AuRingBufWritePeek(AuRingBuffer* ring, uint8_t** span) {
+	uint32_t head = ring->head;
+	/* acquire, consumer is done with the bytes before tail */
+	uint32_t tail = AU_RING_LOAD_ACQUIRE(&ring->tail);
+	uint32_t room = ring->size - (head - tail);
+	uint32_t off = head & ring->mask;
+	uint32_t contig = ring->size - off;
+	*span = ring->buffer + off;
+	return (room < contig) ? room : contig;
+}
+
+/*
+ * AuRingBufWriteCommit -- producer side, publish bytes
+ * filled in through AuRingBufWritePeek
+ * @param ring -- Pointer to the ring
+ * @param len -- number of bytes filled
+ */
+void AuRingBufWriteCommit(AuRingBuffer* ring, uint32_t len) {
+	AU_RING_STORE_RELEASE(&ring->head, ring->head + len);
+}
+
+/*
+ * AuRingBufReadPeek -- consumer side, get the ready
+ * contiguous span at tail without copying
+ * @param ring -- Pointer to the ring
+ * @param span -- receives start of the span
+ * @return length of the span
+ */
+uint32_t AuRingBufReadPeek(AuRingBuffer* ring, uint8_t** span) {
+	uint32_t tail = ring->tail;
+	/* acquire, producer's data is visible up to head */
+	uint32_t head = AU_RING_LOAD_ACQUIRE(&ring->head);
+	uint32_t ready = head - tail;
+	uint32_t off = tail & ring->mask;
+	uint32_t contig = ring->size - off;
+	*span = ring->buffer + off;
+	return (ready < contig) ? ready : contig;
+}
+
+/*
+ * AuRingBufReadCommit -- consumer side, release bytes
+ * consumed through AuRingBufReadPeek
+ * @param ring -- Pointer to the ring
+ * @param len -- number of bytes consumed
+ */
+void AuRingBufReadCommit(AuRingBuffer* ring, uint32_t len) {
+	AU_RING_STORE_RELEASE(&ring->tail, ring->tail + len);
+}
+
+/*
+ * AuRingBufWrite -- producer side, copy as many bytes
+ * as fit in at most two spans
+ * @param ring -- Pointer to the ring
+ * @param data -- data to put
+ * @param len -- length of data
+ * @return number of bytes put
+ */
+uint32_t AuRingBufWrite(AuRingBuffer* ring, const uint8_t* data, uint32_t len) {
+	uint32_t head = ring->head;
+	uint32_t room = ring->size - (head - AU_RING_LOAD_ACQUIRE(&ring->tail));
+	if (len > room)
+		len = room;
+	if (len == 0)
+		return 0;
+
+	uint32_t off = head & ring->mask;
+	uint32_t first = ring->size - off;
+	if (first > len)
+		first = len;
+	memcpy(ring->buffer + off, (void*)data, first);
+	if (len > first)
+		memcpy(ring->buffer, (void*)(data + first), len - first);
+
+	/* single publish for the whole copy */
+	AU_RING_STORE_RELEASE(&ring->head, head + len);
+	return len;
+}
+
+/*
+ * AuRingBufRead -- consumer side, copy up to len
+ * bytes in at most two spans
+ * @param ring -- Pointer to the ring
+ * @param data -- where to put the data
+ * @param len -- maximum number of bytes
+ * @return number of bytes got
+ */
+uint32_t AuRingBufRead(AuRingBuffer* ring, uint8_t* data, uint32_t len) {
+	uint32_t tail = ring->tail;
+	uint32_t ready = AU_RING_LOAD_ACQUIRE(&ring->head) - tail;
+	if (len > ready)
+		len = ready;
+	if (len == 0)
+		return 0;
+
+	uint32_t off = tail & ring->mask;
+	uint32_t first = ring->size - off;
+	if (first > len)
+		first = len;
+	memcpy(data, ring->buffer + off, first);
+	if (len > first)
+		memcpy(data + first, ring->buffer, len - first);
+
+	AU_RING_STORE_RELEASE(&ring->tail, tail + len);
+	return len;
+}
+
+/*
+ * AuRingBufPut -- producer side, put a single byte
+ * @param ring -- Pointer to the ring
+ * @param c -- byte to put
+ * @return 0 on success, -1 if ring is full
+ */
+int AuRingBufPut(AuRingBuffer* ring, uint8_t c) {
+	uint32_t head = ring->head;
+	if (head - AU_RING_LOAD_ACQUIRE(&ring->tail) == ring->size)
+		return -1;
+	ring->buffer[head & ring->mask] = c;
+	AU_RING_STORE_RELEASE(&ring->head, head + 1);
+	return 0;
+}
+
+/*
+ * AuRingBufFind -- consumer side, look for a byte
+ * among ready data
+ * @param ring -- Pointer to the ring
+ * @param c -- byte to look for
+ * @return number of bytes up to and including the
+ * byte, 0 if not present
+ */
+uint32_t AuRingBufFind(AuRingBuffer* ring, uint8_t c) {
+	uint32_t tail = ring->tail;
+	uint32_t ready = AU_RING_LOAD_ACQUIRE(&ring->head) - tail;
+	for (uint32_t i = 0; i < ready; i++) {
+		if (ring->buffer[(tail + i) & ring->mask] == c)
+			return i + 1;
+	}
+	return 0;
+}
@@ -90,7 +90,7 @@ void AuDevWriteKybrd(AuInputMessage* outmsg) {
 * @param buffer -- Pointer to buffer where to put the data
 * @param length -- length to read
 */
-size_t AuDevInputMiceWrite(AuVFSNode* fs, AuVFSNode* file, uint64_t* buffer, uint32_t length) {
+size_t AuDevInputMiceWrite(AuVFSNode* fs, AuVFSNode* file, uint64_t* buffer, size_t length) {
 	if (!file)
 		return 0;
 	if (!buffer)
@@ -107,7 +107,7 @@ size_t AuDevInputMiceWrite(AuVFSNode* fs, AuVFSNode* file, uint64_t* buffer, uin
 * @param buffer -- Pointer to buffer where to put the data
 * @param length -- length to read
 */
-size_t AuDevInputMiceRead(AuVFSNode* fs, AuVFSNode* file, uint64_t* buffer, uint32_t length) {
+size_t AuDevInputMiceRead(AuVFSNode* fs, AuVFSNode* file, uint64_t* buffer, size_t length) {
 	if (!file)
 		return 0;
 	if (!buffer)
@@ -125,7 +125,7 @@ size_t AuDevInputMiceRead(AuVFSNode* fs, AuVFSNode* file, uint64_t* buffer, uint
 * @param buffer -- Pointer to buffer where to put the data
 * @param length -- length to read
 */
-size_t AuDevInputKybrdWrite(AuVFSNode* fs, AuVFSNode* file, uint64_t* buffer, uint32_t length) {
+size_t AuDevInputKybrdWrite(AuVFSNode* fs, AuVFSNode* file, uint64_t* buffer, size_t length) {
 	if (!file)
 		return 0;
 	if (!buffer)
@@ -142,7 +142,7 @@ size_t AuDevInputKybrdWrite(AuVFSNode* fs, AuVFSNode* file, uint64_t* buffer, ui
 * @param buffer -- Pointer to buffer where to put the data
 * @param length -- length to read
 */
-size_t AuDevInputKybrdRead(AuVFSNode* fs, AuVFSNode* file, uint64_t* buffer, uint32_t length) {
+size_t AuDevInputKybrdRead(AuVFSNode* fs, AuVFSNode* file, uint64_t* buffer, size_t length) {
 	if (!file)
 		return 0;
 	if (!buffer)
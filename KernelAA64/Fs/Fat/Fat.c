@@ -320,7 +320,7 @@ size_t FatRead(AuVFSNode* fsys, AuVFSNode* file, uint64_t* buf) {
  * @param buffer -- Pointer to reserved memory
  * @param length -- length to read in bytes
  */
-size_t FatReadFile(AuVFSNode* fsys, AuVFSNode* file, uint64_t* buffer, uint32_t length) {
+size_t FatReadFile(AuVFSNode* fsys, AuVFSNode* file, uint64_t* buffer, size_t length) {
 	if (!fsys)
 		return 0;
 
@@ -384,7 +384,7 @@ void FatFileWriteDone(AuVFSNode* file) {
  * @param buffer -- buffer to write
  * @param length -- bytes needed to write
  */
-size_t FatWrite(AuVFSNode* fsys, AuVFSNode* file, uint64_t* buffer, uint32_t length) {
+size_t FatWrite(AuVFSNode* fsys, AuVFSNode* file, uint64_t* buffer, size_t length) {
 	if (!fsys)
 		return 0;
 	FatFS* _fs = (FatFS*)fsys->device;
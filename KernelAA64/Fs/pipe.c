@@ -85,7 +85,7 @@ void AuPipeIncrementWriteAmount(AuPipe* pipe, size_t amount) {
  * @param buffer -- Pointer to buffer where to put the data
  * @param length -- length to read
  */
-size_t AuPipeRead(AuVFSNode* fs, AuVFSNode* file, uint64_t* buffer, uint32_t length) {
+size_t AuPipeRead(AuVFSNode* fs, AuVFSNode* file, uint64_t* buffer, size_t length) {
 	uint8_t* aligned_buff = (uint8_t*)buffer;
 	AuPipe* pipe = (AuPipe*)fs->device;
 	size_t collected = 0;
@@ -112,7 +112,7 @@ size_t AuPipeRead(AuVFSNode* fs, AuVFSNode* file, uint64_t* buffer, uint32_t len
 * @param buffer -- Pointer to buffer where to put the data
 * @param length -- length to read
 */
-size_t AuPipeWrite(AuVFSNode* fs, AuVFSNode* file, uint64_t* buffer, uint32_t length) {
+size_t AuPipeWrite(AuVFSNode* fs, AuVFSNode* file, uint64_t* buffer, size_t length) {
 	uint8_t* aligned_buff = (uint8_t*)buffer;
 	AuPipe* pipe = (AuPipe*)fs->device;
 	size_t written = 0;
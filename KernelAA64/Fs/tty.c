@@ -132,7 +132,7 @@ void AuTTYProcessLine(TTY* tty, uint8_t c) {
 }
 
 
-size_t AuTTYMasterRead(AuVFSNode* fs, AuVFSNode* file, uint64_t* buffer, uint32_t len) {
+size_t AuTTYMasterRead(AuVFSNode* fs, AuVFSNode* file, uint64_t* buffer, size_t len) {
 	TTY* type = (TTY*)file->device;
 	if (!type)
 		return 0;
@@ -140,23 +140,19 @@ size_t AuTTYMasterRead(AuVFSNode* fs, AuVFSNode* file, uint64_t* buffer, uint32_
 	size_t bytes_to_ret = 0;
 	uint8_t* aligned_buf = (uint8_t*)buffer;
 
-	if (CircBufEmpty(type->masterbuf)) {
-		return bytes_to_ret;
-	}
-
-	for (int i = 0; i < type->master_written; i++) {
-		AuCircBufGet(type->masterbuf, &aligned_buf[i]);
+	/* whatever the slave wrote so far, the buffer
+	 * keeps its own fill level */
+	while (bytes_to_ret < len && !CircBufEmpty(type->masterbuf)) {
+		AuCircBufGet(type->masterbuf, &aligned_buf[bytes_to_ret]);
 		bytes_to_ret++;
 	}
-
-	type->master_written = 0;
 	return bytes_to_ret;
 }
 
 /*
  * AuTTYMasterWrite -- writing to master goes to slave buffer
  */
-size_t AuTTYMasterWrite(AuVFSNode* fs, AuVFSNode* file, uint64_t* buffer, uint32_t len) {
+size_t AuTTYMasterWrite(AuVFSNode* fs, AuVFSNode* file, uint64_t* buffer, size_t len) {
 	uint8_t* aligned_buf = (uint8_t*)buffer;
 	TTY* type = (TTY*)file->device;
 	if (!type)
@@ -167,7 +163,7 @@ size_t AuTTYMasterWrite(AuVFSNode* fs, AuVFSNode* file, uint64_t* buffer, uint32
 	}
 }
 
-size_t AuTTYSlaveRead(AuVFSNode* fsys, AuVFSNode* file, uint64_t* buffer, uint32_t len) {
+size_t AuTTYSlaveRead(AuVFSNode* fsys, AuVFSNode* file, uint64_t* buffer, size_t len) {
 	uint8_t* aligned_buf = (uint8_t*)buffer;
 	TTY* tty = (TTY*)file->device;
 	if (!tty)
@@ -182,7 +178,7 @@ size_t AuTTYSlaveRead(AuVFSNode* fsys, AuVFSNode* file, uint64_t* buffer, uint32
 /*
  * AuTTYSlaveWrite --- writing to slave goes to master buffer
  */
-size_t AuTTYSlaveWrite(AuVFSNode* fsys, AuVFSNode* file, uint64_t* buffer, uint32_t len) {
+size_t AuTTYSlaveWrite(AuVFSNode* fsys, AuVFSNode* file, uint64_t* buffer, size_t len) {
 	char* data = (char*)buffer;
 	AA64Thread* curr_th = AuGetCurrentThread();
 	uint8_t* aligned_buf = (uint8_t*)buffer;
@@ -197,10 +193,8 @@ size_t AuTTYSlaveWrite(AuVFSNode* fsys, AuVFSNode* file, uint64_t* buffer, uint3
 		return 0;
 	}
 
-	for (int i = 0; i < len; i++) {
+	for (int i = 0; i < len; i++)
 		AuCircBufPut(tty->masterbuf, aligned_buf[i]);
-		tty->master_written++;
-	}
 
 	/* little bit slow down the slave process,
 	 * it's too fast
@@ -343,8 +337,6 @@ int AuTTYCreate(int* master_fd, int* slave_fd) {
 	tty->slavebuf = AuCircBufInitialise((uint8_t*)outbuffer, 512);
 
 	tty->id = slave_count;
-	tty->master_written = 0;
-	tty->slave_written = 0;
 
 	tty->masterbuf_ptr = inbuffer;
 	tty->slavebuf_ptr = outbuffer;
@@ -47,7 +47,7 @@ DeodhaiAudioBox* DeodhaiAudioOpenConnection(int postbox, uint8_t numChannel, uin
 	memset(audioBox, 0, sizeof(DeodhaiAudioBox));
 	audioBox->pipe = pipe;
 
-	uint16_t threadID = _KeGetThreadID();
+	uint32_t threadID = _KeGetThreadID();
 
 	/* Open up the connection */
 	DeodhaiAudioMessage* msg = (DeodhaiAudioMessage*)malloc(sizeof(DeodhaiAudioMessage));
@@ -69,8 +69,8 @@ DeodhaiAudioBox* DeodhaiAudioOpenConnection(int postbox, uint8_t numChannel, uin
 				_KePrint("DeodhaiAudio Handshake received \n");
 				uint16_t controlPanelKey = e.dword;
 				uint16_t sampleBufferKey = e.dword2;
-				int id = _KeCreateSharedMem(controlPanelKey, 0, 0);
-				int id2 = _KeCreateSharedMem(sampleBufferKey, 0, 0);
+				int64_t id = _KeCreateSharedMem(controlPanelKey, 0, 0);
+				int64_t id2 = _KeCreateSharedMem(sampleBufferKey, 0, 0);
 				void* controlPanelBuff = _KeObtainSharedMem(id, 0, 0);
 				void* sampleBuff = _KeObtainSharedMem(id2, 0, 0);
 				DeodhaiAudioControlPanel* panel= (DeodhaiAudioControlPanel*)controlPanelBuff;
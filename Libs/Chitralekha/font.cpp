@@ -45,11 +45,11 @@
  */
 ChFont *ChInitialiseFont(char* fontname) {
 	int id = _KeGetFontID(fontname);
-	if (id == 0)
+	if (id <= 0)
 		return NULL;
-	int _font_id = (id >> 16) & UINT16_MAX;
-	int _font_key = id & UINT16_MAX;
-	void* buff = _KeObtainSharedMem(_font_id, NULL, 0);
+	/* fonts are named segments, the id is their key */
+	int _font_key = id;
+	void* buff = _KeObtainSharedMem(_font_key, NULL, 0);
 	if (!buff)
 		return NULL;
 
@@ -49,7 +49,7 @@ ChitralekhaApp* ChitralekhaStartApp(int argc, char* argv[]) {
 	memset(app, 0, sizeof(ChitralekhaApp));
 	app->baseFont = font;
 	app->postboxfd = postboxfd;
-	uint16_t thr_id = _KeGetThreadID();
+	uint32_t thr_id = _KeGetThreadID();
 	app->currentID = thr_id;
 
 	ChitralekhaKeyInitialise();
@@ -65,7 +65,7 @@ ChitralekhaApp* ChitralekhaStartSubApp(ChitralekhaApp* parent) {
 	memset(app, 0, sizeof(ChitralekhaApp));
 	app->baseFont = parent->baseFont;
 	app->postboxfd = parent->postboxfd;
-	uint16_t thr_id = parent->currentID;
+	uint32_t thr_id = parent->currentID;
 	app->currentID = thr_id;
 	app->parent = parent;
 	return app;
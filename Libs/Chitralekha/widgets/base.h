@@ -77,7 +77,7 @@
 		int buffer_height;
 		uint32_t windowHandle;
 		ChFont* baseFont;
-		uint16_t currentID;
+		uint32_t currentID;
 		struct _ChApp_ *parent;
 	}ChitralekhaApp;
 
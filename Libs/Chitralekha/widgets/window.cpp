@@ -77,8 +77,8 @@ void ChRequestWindow(ChitralekhaApp* app, int x, int y, int w, int h, char* titl
 				if (buffKey < 100)
 					_KePrint("Chitralekha: buffer key problem \n");
 				uint32_t handle = e.dword3;
-				uint16_t shid = _KeCreateSharedMem(shkey, 0, 0);
-				uint16_t backid = _KeCreateSharedMem(buffKey, NULL, 0);
+				int64_t shid = _KeCreateSharedMem(shkey, 0, 0);
+				int64_t backid = _KeCreateSharedMem(buffKey, NULL, 0);
 				void* sharedwinaddr = _KeObtainSharedMem(shid, NULL, 0);
 				void* backbuff = _KeObtainSharedMem(backid, NULL, 0);
 				app->sharedWinkey = shkey;
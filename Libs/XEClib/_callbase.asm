@@ -935,4 +935,321 @@ _KeGetEnvironmentBlock:
 
       
 
-     
\ No newline at end of file
+     
+
+;;------------------------------------
+;; _KeReadFileAt -- reads a file from
+;; given offset without touching the
+;; file position
+;; @param rcx -- file descriptor
+;; @param rdx -- buffer address
+;; @param r8 -- length to read in
+;; @param r9 -- offset in bytes
+;;------------------------------------
+global _KeReadFileAt
+%ifdef YES_DYNAMIC
+export _KeReadFileAt
+%endif
+_KeReadFileAt:
+    xor rax, rax
+	mov r12, 58
+	mov r13, rcx
+	mov r14, rdx
+	mov r15, r8
+	mov rdi, r9
+	syscall
+	ret
+
+;;------------------------------------
+;; _KeWriteFileAt -- writes a file at
+;; given offset without touching the
+;; file position
+;; @param rcx -- file descriptor
+;; @param rdx -- buffer address
+;; @param r8 -- length to write out
+;; @param r9 -- offset in bytes
+;;------------------------------------
+global _KeWriteFileAt
+%ifdef YES_DYNAMIC
+export _KeWriteFileAt
+%endif
+_KeWriteFileAt:
+    xor rax, rax
+	mov r12, 59
+	mov r13, rcx
+	mov r14, rdx
+	mov r15, r8
+	mov rdi, r9
+	syscall
+	ret
+
+;;------------------------------------
+;; _KeReadFileV -- reads a file into
+;; multiple buffers in one call
+;; @param rcx -- file descriptor
+;; @param rdx -- array of XEIOVec
+;; @param r8 -- number of segments
+;;------------------------------------
+global _KeReadFileV
+%ifdef YES_DYNAMIC
+export _KeReadFileV
+%endif
+_KeReadFileV:
+    xor rax, rax
+	mov r12, 60
+	mov r13, rcx
+	mov r14, rdx
+	mov r15, r8
+	syscall
+	ret
+
+;;------------------------------------
+;; _KeWriteFileV -- writes multiple
+;; buffers to a file in one call
+;; @param rcx -- file descriptor
+;; @param rdx -- array of XEIOVec
+;; @param r8 -- number of segments
+;;------------------------------------
+global _KeWriteFileV
+%ifdef YES_DYNAMIC
+export _KeWriteFileV
+%endif
+_KeWriteFileV:
+    xor rax, rax
+	mov r12, 61
+	mov r13, rcx
+	mov r14, rdx
+	mov r15, r8
+	syscall
+	ret
+
+;;------------------------------------
+;; _KeFileSync -- writes out data of
+;; a file held back by file system
+;; @param rcx -- file descriptor
+;;------------------------------------
+global _KeFileSync
+%ifdef YES_DYNAMIC
+export _KeFileSync
+%endif
+_KeFileSync:
+    xor rax, rax
+	mov r12, 62
+	mov r13, rcx
+	syscall
+	ret
+
+;;------------------------------------
+;; _KeChannelWait -- sleep on a channel
+;; word until woken
+;; @param rcx -- address of the word
+;; @param rdx -- value last observed
+;;------------------------------------
+global _KeChannelWait
+%ifdef YES_DYNAMIC
+export _KeChannelWait
+%endif
+_KeChannelWait:
+    xor rax, rax
+	mov r12, 63
+	mov r13, rcx
+	mov r14, rdx
+	syscall
+	ret
+
+;;------------------------------------
+;; _KeChannelWake -- wake threads
+;; sleeping on a channel word
+;; @param rcx -- address of the word
+;; @param rdx -- maximum threads to wake
+;;------------------------------------
+global _KeChannelWake
+%ifdef YES_DYNAMIC
+export _KeChannelWake
+%endif
+_KeChannelWake:
+    xor rax, rax
+	mov r12, 64
+	mov r13, rcx
+	mov r14, rdx
+	syscall
+	ret
+
+;;------------------------------------
+;; _KeFutex -- wait, wake or requeue
+;; on a futex word
+;; @param rcx -- address of the word
+;; @param rdx -- operation
+;; @param r8 -- value
+;; @param r9 -- timeout or count
+;; 5th, 6th on stack -- second futex
+;; and its expected value
+;;------------------------------------
+global _KeFutex
+%ifdef YES_DYNAMIC
+export _KeFutex
+%endif
+_KeFutex:
+    xor rax, rax
+	mov r12, 65
+	mov r13, rcx
+	mov r14, rdx
+	mov r15, r8
+	mov rdi, r9
+	syscall
+	ret
+
+;;------------------------------------
+;; _KeIORingSetup -- register async
+;; syscall ring memory
+;; @param rcx -- ring memory
+;; @param rdx -- number of entries
+;;------------------------------------
+global _KeIORingSetup
+%ifdef YES_DYNAMIC
+export _KeIORingSetup
+%endif
+_KeIORingSetup:
+    xor rax, rax
+	mov r12, 66
+	mov r13, rcx
+	mov r14, rdx
+	syscall
+	ret
+
+;;------------------------------------
+;; _KeIORingEnter -- submit queued
+;; entries and wait for completions
+;; @param rcx -- entries to submit
+;; @param rdx -- completions to wait
+;;------------------------------------
+global _KeIORingEnter
+%ifdef YES_DYNAMIC
+export _KeIORingEnter
+%endif
+_KeIORingEnter:
+    xor rax, rax
+	mov r12, 67
+	mov r13, rcx
+	mov r14, rdx
+	syscall
+	ret
+
+;;------------------------------------
+;; _KeFileDup -- duplicates a file
+;; descriptor
+;; @param rcx -- file descriptor
+;; @param rdx -- target descriptor, -1
+;; for the lowest free one
+;;------------------------------------
+global _KeFileDup
+%ifdef YES_DYNAMIC
+export _KeFileDup
+%endif
+_KeFileDup:
+    xor rax, rax
+	mov r12, 68
+	mov r13, rcx
+	mov r14, rdx
+	syscall
+	ret
+
+;;------------------------------------
+;; _KeHRTimerCreate -- create a high
+;; resolution timer
+;; @param rcx -- timer flags
+;;------------------------------------
+global _KeHRTimerCreate
+%ifdef YES_DYNAMIC
+export _KeHRTimerCreate
+%endif
+_KeHRTimerCreate:
+    xor rax, rax
+	mov r12, 69
+	mov r13, rcx
+	syscall
+	ret
+
+;;------------------------------------
+;; _KeHRTimerArm -- arm a high
+;; resolution timer
+;; @param rcx -- timer id
+;; @param rdx -- initial expiry in ns
+;; @param r8 -- period in ns
+;; @param r9 -- arm flags
+;;------------------------------------
+global _KeHRTimerArm
+%ifdef YES_DYNAMIC
+export _KeHRTimerArm
+%endif
+_KeHRTimerArm:
+    xor rax, rax
+	mov r12, 70
+	mov r13, rcx
+	mov r14, rdx
+	mov r15, r8
+	mov rdi, r9
+	syscall
+	ret
+
+;;------------------------------------
+;; _KeHRTimerDisarm -- stop a high
+;; resolution timer
+;; @param rcx -- timer id
+;;------------------------------------
+global _KeHRTimerDisarm
+%ifdef YES_DYNAMIC
+export _KeHRTimerDisarm
+%endif
+_KeHRTimerDisarm:
+    xor rax, rax
+	mov r12, 71
+	mov r13, rcx
+	syscall
+	ret
+
+;;------------------------------------
+;; _KeHRTimerWait -- wait for a high
+;; resolution timer to expire
+;; @param rcx -- timer id
+;;------------------------------------
+global _KeHRTimerWait
+%ifdef YES_DYNAMIC
+export _KeHRTimerWait
+%endif
+_KeHRTimerWait:
+    xor rax, rax
+	mov r12, 72
+	mov r13, rcx
+	syscall
+	ret
+
+;;------------------------------------
+;; _KeHRTimerClose -- destroy a high
+;; resolution timer
+;; @param rcx -- timer id
+;;------------------------------------
+global _KeHRTimerClose
+%ifdef YES_DYNAMIC
+export _KeHRTimerClose
+%endif
+_KeHRTimerClose:
+    xor rax, rax
+	mov r12, 73
+	mov r13, rcx
+	syscall
+	ret
+
+;;------------------------------------
+;; _KeGetMonotonicClock -- returns
+;; monotonic clock in nanoseconds
+;;------------------------------------
+global _KeGetMonotonicClock
+%ifdef YES_DYNAMIC
+export _KeGetMonotonicClock
+%endif
+_KeGetMonotonicClock:
+    xor rax, rax
+	mov r12, 74
+	syscall
+	ret
@@ -44,8 +44,8 @@ XE_EXTERN{
 		unsigned char* ptr;
 		int _file_num;
 		int eof;
-		int size;
-		int curr_pos;
+		int64_t size;
+		int64_t curr_pos;
 	}FILE;
 
 #define SEEK_SET 0
@@ -113,6 +113,22 @@ XE_EXTERN{
 	*/
 	XE_LIB int fseek(FILE* fp, long int offset, int pos);
 
+	/*
+	* _ftelli64 -- returns the current 64 bit file position
+	* of the specified stream
+	* @param fp -- pointer to FILE structure
+	*/
+	XE_LIB int64_t _ftelli64(FILE* fp);
+
+	/*
+	* _fseeki64 -- 64 bit variant of fseek, used for
+	* files larger than 2 GiB
+	* @param fp -- pointer to FILE structure
+	* @param offset -- offset in bytes
+	* @param pos -- position mode
+	*/
+	XE_LIB int _fseeki64(FILE* fp, int64_t offset, int pos);
+
 	/*
 	* fgetc -- reads a single character from the
 	* input stream at the current position
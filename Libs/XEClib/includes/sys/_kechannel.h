@@ -0,0 +1,136 @@
+/**
+* BSD 2-Clause License
+*
+* Copyright (c) 2022-2023, Manas Kamal Choudhury
+* All rights reserved.
+*
+* Redistribution and use in source and binary forms, with or without
+* modification, are permitted provided that the following conditions are met:
+*
+* 1. Redistributions of source code must retain the above copyright notice, this
+*    list of conditions and the following disclaimer.
+*
+* 2. Redistributions in binary form must reproduce the above copyright notice,
+*    this list of conditions and the following disclaimer in the documentation
+*    and/or other materials provided with the distribution.
+*
+* THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+* AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+* IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+* DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE
+* FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+* DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR
+* SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER
+* CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY,
+* OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+* OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+*
+**/
+
+#ifndef __KE_CHANNEL_H__
+#define __KE_CHANNEL_H__
+
+#include <_xeneva.h>
+#include <stdint.h>
+
+#ifdef __cplusplus
+XE_EXTERN{
+#endif
+
+#define XE_CHANNEL_MAGIC  0x4C4E4843
+
+/* send/receive flags */
+#define XE_CHANNEL_NOWAIT  (1<<0)
+
+#pragma pack(push,1)
+/*
+ * XEChannelHdr -- header of a channel placed at the
+ * start of its shared memory segment, producer and
+ * consumer owned indices live in separate cache lines
+ */
+typedef struct _xe_channel_hdr_ {
+	uint32_t magic;
+	uint32_t msgSize;
+	uint32_t slots;
+	uint32_t rsvd[13];
+	/* written by producer */
+	volatile uint32_t head;
+	volatile uint32_t consWaiting;
+	uint32_t rsvd1[14];
+	/* written by consumer */
+	volatile uint32_t tail;
+	volatile uint32_t prodWaiting;
+	uint32_t rsvd2[14];
+}XEChannelHdr;
+#pragma pack(pop)
+
+/*
+ * XEChannel -- process local handle of a channel
+ */
+typedef struct _xe_channel_ {
+	XEChannelHdr* hdr;
+	uint8_t* data;
+	uint16_t key;
+	uint32_t msgSize;
+	uint32_t slots;
+}XEChannel;
+
+	/*
+	 * _KeChannelWait -- sleep on a channel word until
+	 * woken, returns at once if the word changed
+	 * @param addr -- address of the word
+	 * @param expected -- value last observed
+	 */
+	XE_LIB int _KeChannelWait(uint32_t* addr, uint32_t expected);
+
+	/*
+	 * _KeChannelWake -- wake threads sleeping on a
+	 * channel word
+	 * @param addr -- address of the word
+	 * @param count -- maximum threads to wake
+	 */
+	XE_LIB int _KeChannelWake(uint32_t* addr, int count);
+
+	/*
+	 * _XEChannelCreate -- create a new channel
+	 * @param key -- shared memory key
+	 * @param msgSize -- size of each message
+	 * @param slots -- number of messages, power of two
+	 */
+	XE_LIB XEChannel* _XEChannelCreate(uint16_t key, uint32_t msgSize, uint32_t slots);
+
+	/*
+	 * _XEChannelOpen -- open a channel created by peer
+	 * @param key -- shared memory key
+	 */
+	XE_LIB XEChannel* _XEChannelOpen(uint16_t key);
+
+	/*
+	 * _XEChannelSend -- put a message to channel, only
+	 * producer side may call it
+	 * @param ch -- Pointer to channel
+	 * @param msg -- message of msgSize bytes
+	 * @param flags -- XE_CHANNEL_NOWAIT fails on full ring
+	 */
+	XE_LIB int _XEChannelSend(XEChannel* ch, void* msg, int flags);
+
+	/*
+	 * _XEChannelReceive -- take a message from channel,
+	 * only consumer side may call it
+	 * @param ch -- Pointer to channel
+	 * @param msg -- buffer of msgSize bytes
+	 * @param flags -- XE_CHANNEL_NOWAIT fails on empty ring
+	 */
+	XE_LIB int _XEChannelReceive(XEChannel* ch, void* msg, int flags);
+
+	/*
+	 * _XEChannelClose -- close a channel
+	 * @param ch -- Pointer to channel
+	 */
+	XE_LIB void _XEChannelClose(XEChannel* ch);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif
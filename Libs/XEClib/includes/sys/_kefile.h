@@ -93,16 +93,26 @@ typedef struct _disk_partition_info_ {
 #pragma pack(push,1)
 	typedef struct _XEFileStatus_ {
 		uint8_t filemode; //mode of the file
-		size_t size;  //size in bytes
-		uint32_t current_block;
-		uint32_t start_block;
+		uint64_t size;  //size in bytes
+		uint64_t current_block;
+		uint64_t start_block;
 		uint32_t user_id; //for future use
 		uint32_t group_id; //for future use
 		uint32_t num_links;
 		uint8_t eof;
+		uint64_t pos; //current byte offset
 	}XEFileStatus;
 #pragma pack(pop)
 
+	/* one segment of a vectored read/write,
+	 * mirrors kernel's AuIOVec */
+	typedef struct _XEIOVec_ {
+		void* base;
+		size_t len;
+	}XEIOVec;
+
+#define XE_IOV_MAX 64
+
 #pragma pack(push,1)
 	typedef struct _XEFileControl_ {
 		int syscall_magic;
@@ -138,7 +148,13 @@ typedef struct _disk_partition_info_ {
 	XE_LIB int _KeFileStat(int fd, void* buf);
 	XE_LIB int _KeOpenDir(char* filename);
 	XE_LIB int _KeReadDir(int dirfd, void* dirent);
-	XE_LIB int _KeFileSetOffset(int fd, size_t offset);
+	XE_LIB int _KeFileSetOffset(int fd, uint64_t offset);
+	XE_LIB size_t _KeReadFileAt(int fd, void* buffer, size_t length, uint64_t offset);
+	XE_LIB size_t _KeWriteFileAt(int fd, void* buffer, size_t length, uint64_t offset);
+	XE_LIB size_t _KeReadFileV(int fd, XEIOVec* iov, int iovcnt);
+	XE_LIB size_t _KeWriteFileV(int fd, XEIOVec* iov, int iovcnt);
+	XE_LIB int _KeFileSync(int fd);
+	XE_LIB int _KeFileDup(int fd, int newfd);
 	XE_LIB int _KeCreatePipe(char* name, size_t sz);
 	XE_LIB int _KeGetStorageDiskInfo(uint8_t diskID, void* buffer);
 	XE_LIB int _KeGetStoragePartitionInfo(uint8_t diskID, uint8_t partitionID, void* buffer);
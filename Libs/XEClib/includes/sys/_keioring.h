@@ -0,0 +1,152 @@
+/**
+* BSD 2-Clause License
+*
+* Copyright (c) 2022-2023, Manas Kamal Choudhury
+* All rights reserved.
+*
+* Redistribution and use in source and binary forms, with or without
+* modification, are permitted provided that the following conditions are met:
+*
+* 1. Redistributions of source code must retain the above copyright notice, this
+*    list of conditions and the following disclaimer.
+*
+* 2. Redistributions in binary form must reproduce the above copyright notice,
+*    this list of conditions and the following disclaimer in the documentation
+*    and/or other materials provided with the distribution.
+*
+* THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+* AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+* IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+* DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE
+* FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+* DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR
+* SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER
+* CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY,
+* OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+* OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+*
+**/
+
+#ifndef __KE_IORING_H__
+#define __KE_IORING_H__
+
+#include <_xeneva.h>
+#include <stdint.h>
+
+#ifdef __cplusplus
+XE_EXTERN{
+#endif
+
+/* submission opcodes */
+#define IORING_OP_NOP     0
+#define IORING_OP_READ    1
+#define IORING_OP_WRITE   2
+#define IORING_OP_READV   3
+#define IORING_OP_WRITEV  4
+#define IORING_OP_FSYNC   5
+#define IORING_OP_CLOSE   6
+#define IORING_OP_IOCTL   7
+#define IORING_OP_SEND    8
+#define IORING_OP_RECV    9
+#define IORING_OP_SHM_OBTAIN  10
+#define IORING_OP_SHM_UNMAP   11
+
+/* submission flags, async entries run on a kernel
+ * worker and may block without blocking the caller */
+#define IORING_SQE_ASYNC  (1<<0)
+
+#define IORING_OFFSET_CURRENT  ((uint64_t)-1)
+
+#pragma pack(push,1)
+typedef struct _xe_ioring_sqe_ {
+	uint8_t opcode;
+	uint8_t flags;
+	uint16_t rsvd;
+	int32_t fd;
+	uint64_t addr;
+	uint64_t len;
+	uint64_t offset;
+	uint64_t userData;
+}XEIORingSQE;
+
+typedef struct _xe_ioring_cqe_ {
+	uint64_t userData;
+	int64_t result;
+}XEIORingCQE;
+
+typedef struct _xe_ioring_hdr_ {
+	uint32_t entries;
+	volatile uint32_t sqHead;
+	volatile uint32_t sqTail;
+	volatile uint32_t cqHead;
+	volatile uint32_t cqTail;
+	uint32_t rsvd[11];
+}XEIORingHdr;
+#pragma pack(pop)
+
+/*
+ * XEIORing -- process side handle of the ring
+ */
+typedef struct _xe_ioring_ {
+	XEIORingHdr* hdr;
+	XEIORingSQE* sqes;
+	XEIORingCQE* cqes;
+	uint32_t entries;
+	/* sq entries handed out but not yet submitted */
+	uint32_t sqLocalTail;
+}XEIORing;
+
+	/*
+	 * _KeIORingSetup -- register ring memory
+	 * @param mem -- page aligned memory
+	 * @param entries -- number of sq entries
+	 */
+	XE_LIB int _KeIORingSetup(void* mem, uint32_t entries);
+
+	/*
+	 * _KeIORingEnter -- submit and wait for completions
+	 * @param toSubmit -- entries to submit
+	 * @param minComplete -- completions to wait for
+	 */
+	XE_LIB int _KeIORingEnter(uint32_t toSubmit, uint32_t minComplete);
+
+	/*
+	 * _XEIORingCreate -- create the process ring
+	 * @param entries -- number of sq entries, power of two
+	 */
+	XE_LIB XEIORing* _XEIORingCreate(uint32_t entries);
+
+	/*
+	 * _XEIORingGetSQE -- get next free submission entry,
+	 * NULL if the queue is full
+	 * @param ring -- Pointer to ring
+	 */
+	XE_LIB XEIORingSQE* _XEIORingGetSQE(XEIORing* ring);
+
+	/*
+	 * _XEIORingSubmit -- submit all prepared entries
+	 * with one kernel entry
+	 * @param ring -- Pointer to ring
+	 * @param minComplete -- completions to wait for
+	 */
+	XE_LIB int _XEIORingSubmit(XEIORing* ring, uint32_t minComplete);
+
+	/*
+	 * _XEIORingPeekCQE -- get oldest completion without
+	 * entering kernel, NULL if none
+	 * @param ring -- Pointer to ring
+	 */
+	XE_LIB XEIORingCQE* _XEIORingPeekCQE(XEIORing* ring);
+
+	/*
+	 * _XEIORingCQESeen -- release the completion returned
+	 * by _XEIORingPeekCQE
+	 * @param ring -- Pointer to ring
+	 */
+	XE_LIB void _XEIORingCQESeen(XEIORing* ring);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif
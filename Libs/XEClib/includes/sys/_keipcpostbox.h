@@ -38,10 +38,21 @@
 #define POSTBOX_GET_EVENT  404
 #define POSTBOX_CREATE_ROOT  405
 #define POSTBOX_GET_EVENT_ROOT  406
+#define POSTBOX_PUT_EVENTS  407
+#define POSTBOX_GET_EVENTS  408
+#define POSTBOX_GET_STATS   409
 
 #define POSTBOX_NO_EVENT  -1
 #define POSTBOX_ROOT_ID    1
 
+#define POSTBOX_LANE_INPUT   0
+#define POSTBOX_LANE_NORMAL  1
+#define POSTBOX_LANES        2
+
+/* event may be superseded by a newer one of the same type from
+ * the same sender while still pending */
+#define POSTBOX_FLAG_COALESCE  (1<<0)
+
 
 #pragma pack(push,1)
 /*
@@ -49,8 +60,8 @@
 */
 typedef struct _post_event_ {
 	uint8_t type;
-	uint16_t to_id;
-	uint16_t from_id;
+	uint32_t to_id;
+	uint32_t from_id;
 	uint32_t dword;
 	uint32_t dword2;
 	uint32_t dword3;
@@ -65,6 +76,36 @@ typedef struct _post_event_ {
 	unsigned char* charValue2;
 	char charValue3[100];
 }PostEvent;
+
+/*
+ * PostBoxPutRequest -- batch put request
+ */
+typedef struct _postbox_put_req_ {
+	PostEvent* events;
+	uint32_t count;
+	uint8_t lane;
+	uint8_t flags;
+}PostBoxPutRequest;
+
+/*
+ * PostBoxGetRequest -- batch get request
+ */
+typedef struct _postbox_get_req_ {
+	PostEvent* events;
+	uint32_t count;
+	uint8_t root;
+}PostBoxGetRequest;
+
+/*
+ * PostBoxStats -- per postbox counters
+ */
+typedef struct _postbox_stats_ {
+	uint32_t posted;
+	uint32_t delivered;
+	uint32_t coalesced;
+	uint32_t dropped[POSTBOX_LANES];
+	uint32_t highWater[POSTBOX_LANES];
+}PostBoxStats;
 #pragma pack(pop)
 
 #endif
\ No newline at end of file
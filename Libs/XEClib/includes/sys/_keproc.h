@@ -48,7 +48,7 @@ XE_EXTERN{
 	 * _KeGetThreadID -- get currently running
 	 * thread id
 	 */
-	XE_LIB uint16_t _KeGetThreadID();
+	XE_LIB uint32_t _KeGetThreadID();
 
 	/*
 	 * _KeGetProcessID -- get currently running
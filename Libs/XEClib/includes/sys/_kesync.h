@@ -0,0 +1,176 @@
+/**
+* BSD 2-Clause License
+*
+* Copyright (c) 2022-2023, Manas Kamal Choudhury
+* All rights reserved.
+*
+* Redistribution and use in source and binary forms, with or without
+* modification, are permitted provided that the following conditions are met:
+*
+* 1. Redistributions of source code must retain the above copyright notice, this
+*    list of conditions and the following disclaimer.
+*
+* 2. Redistributions in binary form must reproduce the above copyright notice,
+*    this list of conditions and the following disclaimer in the documentation
+*    and/or other materials provided with the distribution.
+*
+* THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+* AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+* IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+* DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE
+* FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+* DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR
+* SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER
+* CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY,
+* OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+* OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+*
+**/
+
+#ifndef __KE_SYNC_H__
+#define __KE_SYNC_H__
+
+#include <_xeneva.h>
+#include <stdint.h>
+
+#ifdef __cplusplus
+XE_EXTERN{
+#endif
+
+/* futex operations */
+#define FUTEX_WAIT  0
+#define FUTEX_WAKE  1
+#define FUTEX_CMP_REQUEUE  2
+
+/* futex return codes */
+#define FUTEX_ERROR     -1
+#define FUTEX_TIMEDOUT  -2
+#define FUTEX_AGAIN     -3
+
+/*
+ * XEMutex -- 0 unlocked, 1 locked, 2 locked
+ * with possible waiters
+ */
+typedef struct _xe_mutex_ {
+	volatile uint32_t state;
+}XEMutex;
+
+/*
+ * XECondVar -- condition variable, sequence is
+ * bumped on every signal
+ */
+typedef struct _xe_condvar_ {
+	volatile uint32_t seq;
+	XEMutex* mutex;
+}XECondVar;
+
+/*
+ * XESemaphore -- counting semaphore
+ */
+typedef struct _xe_semaphore_ {
+	volatile uint32_t count;
+	volatile uint32_t waiters;
+}XESemaphore;
+
+#define XE_MUTEX_INITIALIZER  {0}
+#define XE_CONDVAR_INITIALIZER  {0, 0}
+
+	/*
+	 * _KeFutex -- futex system call
+	 * @param addr -- futex word
+	 * @param op -- FUTEX_WAIT, FUTEX_WAKE or FUTEX_CMP_REQUEUE
+	 * @param val -- expected value for wait, wake count otherwise
+	 * @param val2 -- timeout in ms for wait, requeue count for requeue
+	 * @param addr2 -- requeue target
+	 * @param val3 -- expected value of addr for requeue
+	 */
+	XE_LIB int64_t _KeFutex(uint32_t* addr, int op, uint32_t val, uint64_t val2, uint32_t* addr2, uint32_t val3);
+
+	/*
+	 * _XEMutexInit -- initialise a mutex
+	 * @param m -- Pointer to mutex
+	 */
+	XE_LIB void _XEMutexInit(XEMutex* m);
+
+	/*
+	 * _XEMutexLock -- lock a mutex, sleeps in kernel
+	 * only when contended
+	 * @param m -- Pointer to mutex
+	 */
+	XE_LIB void _XEMutexLock(XEMutex* m);
+
+	/*
+	 * _XEMutexTryLock -- lock a mutex if it's free,
+	 * returns 0 on success
+	 * @param m -- Pointer to mutex
+	 */
+	XE_LIB int _XEMutexTryLock(XEMutex* m);
+
+	/*
+	 * _XEMutexUnlock -- unlock a mutex
+	 * @param m -- Pointer to mutex
+	 */
+	XE_LIB void _XEMutexUnlock(XEMutex* m);
+
+	/*
+	 * _XECondInit -- initialise a condition variable
+	 * @param cv -- Pointer to condition variable
+	 */
+	XE_LIB void _XECondInit(XECondVar* cv);
+
+	/*
+	 * _XECondWait -- atomically unlock mutex and wait
+	 * for a signal, mutex is locked again on return
+	 * @param cv -- Pointer to condition variable
+	 * @param m -- Pointer to locked mutex
+	 * @param timeout -- timeout in ms, 0 for infinite
+	 * @return 0 on signal, FUTEX_TIMEDOUT on timeout
+	 */
+	XE_LIB int _XECondWait(XECondVar* cv, XEMutex* m, uint64_t timeout);
+
+	/*
+	 * _XECondSignal -- wake one waiter
+	 * @param cv -- Pointer to condition variable
+	 */
+	XE_LIB void _XECondSignal(XECondVar* cv);
+
+	/*
+	 * _XECondBroadcast -- wake all waiters
+	 * @param cv -- Pointer to condition variable
+	 */
+	XE_LIB void _XECondBroadcast(XECondVar* cv);
+
+	/*
+	 * _XESemInit -- initialise a semaphore
+	 * @param s -- Pointer to semaphore
+	 * @param count -- initial count
+	 */
+	XE_LIB void _XESemInit(XESemaphore* s, uint32_t count);
+
+	/*
+	 * _XESemWait -- decrement the semaphore, sleeping
+	 * while it is zero
+	 * @param s -- Pointer to semaphore
+	 * @param timeout -- timeout in ms, 0 for infinite
+	 * @return 0 on success, FUTEX_TIMEDOUT on timeout
+	 */
+	XE_LIB int _XESemWait(XESemaphore* s, uint64_t timeout);
+
+	/*
+	 * _XESemTryWait -- decrement the semaphore if
+	 * it is non zero, returns 0 on success
+	 * @param s -- Pointer to semaphore
+	 */
+	XE_LIB int _XESemTryWait(XESemaphore* s);
+
+	/*
+	 * _XESemPost -- increment the semaphore
+	 * @param s -- Pointer to semaphore
+	 */
+	XE_LIB void _XESemPost(XESemaphore* s);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif
@@ -45,6 +45,11 @@ XE_EXTERN{
 #define _KE_TIMER_UPDATE_ORDER_INTERVAL 4
 
 #define TIMER_MESSAGE_CODE 8
+#define HRTIMER_MESSAGE_CODE 9
+
+/* high resolution timer flags */
+#define _KE_HRTIMER_FLAG_POSTBOX  (1<<0)
+#define _KE_HRTIMER_ARM_ABSOLUTE  (1<<0)
 
 
 	/*
@@ -71,6 +76,51 @@ XE_EXTERN{
 	*/
 	XE_LIB int _KeDestroyTimer(int threadID);
 
+	/*
+	* _KeHRTimerCreate -- create a high resolution timer,
+	* with _KE_HRTIMER_FLAG_POSTBOX every expiry posts
+	* HRTIMER_MESSAGE_CODE with timer id in dword and
+	* number of expirations in dword2
+	* @param flags -- timer flags
+	* @return timer id, -1 on failure
+	*/
+	XE_LIB int _KeHRTimerCreate(uint8_t flags);
+
+	/*
+	* _KeHRTimerArm -- arm a high resolution timer
+	* @param id -- timer id
+	* @param initial -- first expiry in nanoseconds, relative
+	* unless _KE_HRTIMER_ARM_ABSOLUTE is given
+	* @param period -- interval in nanoseconds, 0 for one-shot
+	* @param flags -- arm flags
+	*/
+	XE_LIB int _KeHRTimerArm(int id, uint64_t initial, uint64_t period, uint8_t flags);
+
+	/*
+	* _KeHRTimerDisarm -- stop a high resolution timer
+	* @param id -- timer id
+	*/
+	XE_LIB int _KeHRTimerDisarm(int id);
+
+	/*
+	* _KeHRTimerWait -- block until the timer expires,
+	* returns number of expirations since last wait
+	* @param id -- timer id
+	*/
+	XE_LIB int64_t _KeHRTimerWait(int id);
+
+	/*
+	* _KeHRTimerClose -- destroy a high resolution timer
+	* @param id -- timer id
+	*/
+	XE_LIB int _KeHRTimerClose(int id);
+
+	/*
+	* _KeGetMonotonicClock -- returns nanoseconds of the
+	* monotonic clock
+	*/
+	XE_LIB uint64_t _KeGetMonotonicClock();
+
 
 #ifdef __cplusplus
 }
@@ -44,6 +44,7 @@ XE_EXTERN{
 #define TIOCFLUSH    0x5403
 #define TIOCGATTR    0x5404
 #define TIOSPGRP     0x5405
+#define TIOCSATTR    0x5406
 
 	typedef struct _win_size_ {
 		uint16_t ws_row;
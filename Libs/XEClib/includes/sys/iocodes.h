@@ -61,6 +61,9 @@
 #define POSTBOX_GET_EVENT  404
 #define POSTBOX_CREATE_ROOT  405
 #define POSTBOX_GET_EVENT_ROOT  406
+#define POSTBOX_PUT_EVENTS  407
+#define POSTBOX_GET_EVENTS  408
+#define POSTBOX_GET_STATS   409
 
 /*I/O Codes used for network interfaces */
 #define NET_GET_HARDWARE_ADDRESS 0x100
@@ -71,26 +71,27 @@ XE_EXTERN{
 	XE_LIB void _KeMemUnmap(void* address, size_t len);
 
 	/*
-	* _KeCreateSharedMem -- create a shared memory chunk
-	* @param key -- key to use
+	* _KeCreateSharedMem -- create a shared memory chunk,
+	* returns its handle or -1
+	* @param key -- key to use, 0 for an anonymous segment
 	* @param sz -- memory size
 	* @param flags -- shared memory flags
 	*/
-	XE_LIB int _KeCreateSharedMem(uint16_t key, size_t sz, uint8_t flags);
+	XE_LIB int64_t _KeCreateSharedMem(uint64_t key, size_t sz, uint8_t flags);
 
 	/*
 	* _KeObtainSharedMem -- obtain a shared memory
-	* @param id -- segment id
+	* @param id -- segment handle or key
 	* @param shmaddr -- user specified address
 	* @param shmflg -- flags to use for protection
 	*/
-	XE_LIB void* _KeObtainSharedMem(uint16_t id, void* shmaddr, int shmflg);
+	XE_LIB void* _KeObtainSharedMem(uint64_t id, void* shmaddr, int shmflg);
 
 	/*
 	* _KeUnmapSharedMem -- unmap shared memory segment
-	* @param key -- key to search
+	* @param key -- key or handle to search
 	*/
-	XE_LIB void _KeUnmapSharedMem(uint16_t key);
+	XE_LIB void _KeUnmapSharedMem(uint64_t key);
 
 	/*
 	 * _KeGetProcessHeapMem -- request a new memory from
@@ -103,9 +103,12 @@ size_t fread(void* ptr, size_t sz, size_t nmemb, FILE* stream) {
 		fd = XENEVA_STDIN;
 	else
 		fd = stream->_file_num;
-	_KePrint("Reading fopen fread %d %d\r\n", fd, (nmemb*sz));
 	size_t ret_bytes = _KeReadFile(fd, ptr, _length);
-	_KePrint("Returned bytes %d \r\n", ret_bytes);
+	if (fd == stream->_file_num) {
+		stream->curr_pos += ret_bytes;
+		if (stream->curr_pos >= stream->size)
+			stream->eof = 1;
+	}
 	return ret_bytes;
 }
 
@@ -138,7 +141,10 @@ size_t fwrite(void* ptr, size_t sz, size_t nmemb, FILE* stream) {
 		ret_bytes = _KeWriteFile(XENEVA_STDIN, aligned_, sz*nmemb);
 	}
 	else {
-		size_t ret_bytes = _KeWriteFile(stream->_file_num, aligned_, sz*nmemb);
+		ret_bytes = _KeWriteFile(stream->_file_num, aligned_, sz*nmemb);
+		stream->curr_pos += ret_bytes;
+		if (stream->curr_pos > stream->size)
+			stream->size = stream->curr_pos;
 	}
 	return ret_bytes;
 }
@@ -170,6 +176,15 @@ int fputs(const char* s, FILE* stream) {
  * @param fp -- pointer to FILE structure
  */
 long ftell(FILE* fp) {
+	return (long)fp->curr_pos;
+}
+
+/*
+ * _ftelli64 -- returns the current 64 bit file position
+ * of the specified stream
+ * @param fp -- pointer to FILE structure
+ */
+int64_t _ftelli64(FILE* fp) {
 	return fp->curr_pos;
 }
 
@@ -183,28 +198,39 @@ long ftell(FILE* fp) {
  * @param pos -- position mode
  */
 int fseek(FILE* fp, long int offset, int pos) {
-	int val = 0;
-	int newPos = 0;
+	return _fseeki64(fp, offset, pos);
+}
+
+/*
+ * _fseeki64 -- 64 bit variant of fseek, used for
+ * files larger than 2 GiB
+ * @param fp -- pointer to FILE structure
+ * @param offset -- offset in bytes
+ * @param pos -- position mode
+ */
+int _fseeki64(FILE* fp, int64_t offset, int pos) {
+	int64_t newPos = 0;
 	switch (pos) {
 	case SEEK_SET:
 		fp->pos = fp->base + offset;
 		newPos = offset;
-		fp->curr_pos = newPos;
 		break;
 	case SEEK_CUR:
 		fp->pos = (fp->pos + offset);
 		newPos = (fp->curr_pos + offset);
-		fp->curr_pos = newPos;
 		break;
 	case SEEK_END:
-		fp->pos = (fp->base + fp->size);
-		newPos = fp->size;
-		fp->curr_pos = newPos;
+		fp->pos = (fp->base + fp->size + offset);
+		newPos = fp->size + offset;
 		break;
+	default:
+		return -1;
 	}
-	_KePrint("Seeking -> %d \r\n", offset);
-	_KeFileSetOffset(fp->_file_num, newPos);
-	return val;
+	if (newPos < 0)
+		return -1;
+	fp->curr_pos = newPos;
+	fp->eof = 0;
+	return _KeFileSetOffset(fp->_file_num, newPos);
 }
 
 /*
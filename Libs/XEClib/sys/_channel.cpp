@@ -0,0 +1,188 @@
+/**
+* BSD 2-Clause License
+*
+* Copyright (c) 2022-2023, Manas Kamal Choudhury
+* All rights reserved.
+*
+* Redistribution and use in source and binary forms, with or without
+* modification, are permitted provided that the following conditions are met:
+*
+* 1. Redistributions of source code must retain the above copyright notice, this
+*    list of conditions and the following disclaimer.
+*
+* 2. Redistributions in binary form must reproduce the above copyright notice,
+*    this list of conditions and the following disclaimer in the documentation
+*    and/or other materials provided with the distribution.
+*
+* THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+* AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+* IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+* DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE
+* FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+* DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR
+* SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER
+* CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY,
+* OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+* OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+*
+**/
+
+#include <stdlib.h>
+#include <string.h>
+#include <sys/_kechannel.h>
+#include <sys/mman.h>
+
+extern "C" long _InterlockedExchange(long volatile* target, long value);
+#pragma intrinsic(_InterlockedExchange)
+
+/*
+ * Steady state traffic only touches the shared ring, the
+ * kernel is entered when the ring is empty (consumer) or
+ * full (producer) and the other side has to be woken.
+ * Interlocked exchange is used where a store must be
+ * visible before the following load of the peer's
+ * waiting flag.
+ */
+
+static XEChannel* _XEChannelAttach(uint16_t key, int64_t id) {
+	XEChannelHdr* hdr = (XEChannelHdr*)_KeObtainSharedMem(id, NULL, 0);
+	if (!hdr)
+		return NULL;
+	XEChannel* ch = (XEChannel*)malloc(sizeof(XEChannel));
+	memset(ch, 0, sizeof(XEChannel));
+	ch->hdr = hdr;
+	ch->data = (uint8_t*)hdr + sizeof(XEChannelHdr);
+	ch->key = key;
+	return ch;
+}
+
+/*
+ * _XEChannelCreate -- create a new channel
+ * @param key -- shared memory key
+ * @param msgSize -- size of each message
+ * @param slots -- number of messages, power of two
+ */
+XE_EXTERN XE_LIB XEChannel* _XEChannelCreate(uint16_t key, uint32_t msgSize, uint32_t slots) {
+	if (msgSize == 0 || slots == 0 || (slots & (slots - 1)))
+		return NULL;
+	msgSize = (msgSize + 7) & ~7;
+	size_t sz = sizeof(XEChannelHdr) + (size_t)msgSize * slots;
+	int64_t id = _KeCreateSharedMem(key, sz, 0);
+	if (id == -1)
+		return NULL;
+	XEChannel* ch = _XEChannelAttach(key, id);
+	if (!ch)
+		return NULL;
+
+	XEChannelHdr* hdr = ch->hdr;
+	hdr->msgSize = msgSize;
+	hdr->slots = slots;
+	hdr->head = 0;
+	hdr->tail = 0;
+	hdr->consWaiting = 0;
+	hdr->prodWaiting = 0;
+	/* publish last, peers check the magic */
+	_InterlockedExchange((long volatile*)&hdr->magic, XE_CHANNEL_MAGIC);
+	ch->msgSize = msgSize;
+	ch->slots = slots;
+	return ch;
+}
+
+/*
+ * _XEChannelOpen -- open a channel created by peer
+ * @param key -- shared memory key
+ */
+XE_EXTERN XE_LIB XEChannel* _XEChannelOpen(uint16_t key) {
+	int64_t id = _KeCreateSharedMem(key, sizeof(XEChannelHdr), 0);
+	if (id == -1)
+		return NULL;
+	XEChannel* ch = _XEChannelAttach(key, id);
+	if (!ch)
+		return NULL;
+	if (ch->hdr->magic != XE_CHANNEL_MAGIC) {
+		/* not created yet, drop our reference */
+		_XEChannelClose(ch);
+		return NULL;
+	}
+	/* keep local copies, peer may scribble the header */
+	ch->msgSize = ch->hdr->msgSize;
+	ch->slots = ch->hdr->slots;
+	return ch;
+}
+
+/*
+ * _XEChannelSend -- put a message to channel, only
+ * producer side may call it
+ * @param ch -- Pointer to channel
+ * @param msg -- message of msgSize bytes
+ * @param flags -- XE_CHANNEL_NOWAIT fails on full ring
+ */
+XE_EXTERN XE_LIB int _XEChannelSend(XEChannel* ch, void* msg, int flags) {
+	XEChannelHdr* hdr = ch->hdr;
+	uint32_t head = hdr->head;
+	while (1) {
+		uint32_t tail = hdr->tail;
+		if (head - tail < ch->slots)
+			break;
+		if (flags & XE_CHANNEL_NOWAIT)
+			return -1;
+		_InterlockedExchange((long volatile*)&hdr->prodWaiting, 1);
+		if (hdr->tail != tail) {
+			hdr->prodWaiting = 0;
+			continue;
+		}
+		_KeChannelWait((uint32_t*)&hdr->tail, tail);
+	}
+
+	memcpy(ch->data + (size_t)(head & (ch->slots - 1)) * ch->msgSize, msg, ch->msgSize);
+	_InterlockedExchange((long volatile*)&hdr->head, head + 1);
+	if (hdr->consWaiting) {
+		hdr->consWaiting = 0;
+		_KeChannelWake((uint32_t*)&hdr->head, 1);
+	}
+	return 0;
+}
+
+/*
+ * _XEChannelReceive -- take a message from channel,
+ * only consumer side may call it
+ * @param ch -- Pointer to channel
+ * @param msg -- buffer of msgSize bytes
+ * @param flags -- XE_CHANNEL_NOWAIT fails on empty ring
+ */
+XE_EXTERN XE_LIB int _XEChannelReceive(XEChannel* ch, void* msg, int flags) {
+	XEChannelHdr* hdr = ch->hdr;
+	uint32_t tail = hdr->tail;
+	while (1) {
+		uint32_t head = hdr->head;
+		if (head != tail)
+			break;
+		if (flags & XE_CHANNEL_NOWAIT)
+			return -1;
+		_InterlockedExchange((long volatile*)&hdr->consWaiting, 1);
+		if (hdr->head != head) {
+			hdr->consWaiting = 0;
+			continue;
+		}
+		_KeChannelWait((uint32_t*)&hdr->head, head);
+	}
+
+	memcpy(msg, ch->data + (size_t)(tail & (ch->slots - 1)) * ch->msgSize, ch->msgSize);
+	_InterlockedExchange((long volatile*)&hdr->tail, tail + 1);
+	if (hdr->prodWaiting) {
+		hdr->prodWaiting = 0;
+		_KeChannelWake((uint32_t*)&hdr->tail, 1);
+	}
+	return 0;
+}
+
+/*
+ * _XEChannelClose -- close a channel
+ * @param ch -- Pointer to channel
+ */
+XE_EXTERN XE_LIB void _XEChannelClose(XEChannel* ch) {
+	if (!ch)
+		return;
+	_KeUnmapSharedMem(ch->key);
+	free(ch);
+}
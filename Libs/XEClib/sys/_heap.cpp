@@ -2,6 +2,7 @@
 #include <sys\mman.h>
 #include <_xeneva.h>
 #include <sys/_procheap.h>
+#include <sys/_kesync.h>
 
 /**  Durand's Ridiculously Amazing Super Duper Memory functions.  */
 
@@ -526,12 +527,16 @@ void*   realloc(void *p, unsigned int size)
 }
 
 
+static XEMutex liballoc_mutex = XE_MUTEX_INITIALIZER;
+
 int liballoc_lock() {
+	_XEMutexLock(&liballoc_mutex);
 	return 0;
 }
 
 
 int liballoc_unlock() {
+	_XEMutexUnlock(&liballoc_mutex);
 	return 0;
 }
 
@@ -0,0 +1,111 @@
+/**
+* BSD 2-Clause License
+*
+* Copyright (c) 2022-2023, Manas Kamal Choudhury
+* All rights reserved.
+*
+* Redistribution and use in source and binary forms, with or without
+* modification, are permitted provided that the following conditions are met:
+*
+* 1. Redistributions of source code must retain the above copyright notice, this
+*    list of conditions and the following disclaimer.
+*
+* 2. Redistributions in binary form must reproduce the above copyright notice,
+*    this list of conditions and the following disclaimer in the documentation
+*    and/or other materials provided with the distribution.
+*
+* THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+* AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+* IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+* DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE
+* FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+* DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR
+* SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER
+* CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY,
+* OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+* OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+*
+**/
+
+#include <stdlib.h>
+#include <string.h>
+#include <sys/_keioring.h>
+#include <sys/mman.h>
+
+#define IORING_PAGE_SIZE  4096
+
+/*
+ * _XEIORingCreate -- create the process ring
+ * @param entries -- number of sq entries, power of two
+ */
+XE_EXTERN XE_LIB XEIORing* _XEIORingCreate(uint32_t entries) {
+	size_t sz = sizeof(XEIORingHdr) + entries * sizeof(XEIORingSQE) + entries * 2 * sizeof(XEIORingCQE);
+	sz = (sz + IORING_PAGE_SIZE - 1) & ~(IORING_PAGE_SIZE - 1);
+	void* mem = (void*)_KeGetProcessHeapMem(sz);
+	if (!mem || mem == (void*)-1)
+		return NULL;
+	memset(mem, 0, sz);
+	if (_KeIORingSetup(mem, entries) != 0) {
+		_KeProcessHeapUnmap(mem, sz);
+		return NULL;
+	}
+
+	XEIORing* ring = (XEIORing*)malloc(sizeof(XEIORing));
+	ring->hdr = (XEIORingHdr*)mem;
+	ring->sqes = (XEIORingSQE*)((uint8_t*)mem + sizeof(XEIORingHdr));
+	ring->cqes = (XEIORingCQE*)((uint8_t*)ring->sqes + entries * sizeof(XEIORingSQE));
+	ring->entries = entries;
+	ring->sqLocalTail = 0;
+	return ring;
+}
+
+/*
+ * _XEIORingGetSQE -- get next free submission entry,
+ * NULL if the queue is full
+ * @param ring -- Pointer to ring
+ */
+XE_EXTERN XE_LIB XEIORingSQE* _XEIORingGetSQE(XEIORing* ring) {
+	if (ring->sqLocalTail - ring->hdr->sqHead >= ring->entries)
+		return NULL;
+	XEIORingSQE* sqe = &ring->sqes[ring->sqLocalTail & (ring->entries - 1)];
+	memset(sqe, 0, sizeof(XEIORingSQE));
+	ring->sqLocalTail++;
+	return sqe;
+}
+
+/*
+ * _XEIORingSubmit -- submit all prepared entries
+ * with one kernel entry
+ * @param ring -- Pointer to ring
+ * @param minComplete -- completions to wait for
+ */
+XE_EXTERN XE_LIB int _XEIORingSubmit(XEIORing* ring, uint32_t minComplete) {
+	/* entries are fully written before the tail moves,
+	 * volatile store keeps the order */
+	ring->hdr->sqTail = ring->sqLocalTail;
+	uint32_t toSubmit = ring->sqLocalTail - ring->hdr->sqHead;
+	if (toSubmit == 0 && minComplete == 0)
+		return 0;
+	return _KeIORingEnter(toSubmit, minComplete);
+}
+
+/*
+ * _XEIORingPeekCQE -- get oldest completion without
+ * entering kernel, NULL if none
+ * @param ring -- Pointer to ring
+ */
+XE_EXTERN XE_LIB XEIORingCQE* _XEIORingPeekCQE(XEIORing* ring) {
+	uint32_t head = ring->hdr->cqHead;
+	if (head == ring->hdr->cqTail)
+		return NULL;
+	return &ring->cqes[head & ((ring->entries * 2) - 1)];
+}
+
+/*
+ * _XEIORingCQESeen -- release the completion returned
+ * by _XEIORingPeekCQE
+ * @param ring -- Pointer to ring
+ */
+XE_EXTERN XE_LIB void _XEIORingCQESeen(XEIORing* ring) {
+	ring->hdr->cqHead = ring->hdr->cqHead + 1;
+}
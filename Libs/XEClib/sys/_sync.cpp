@@ -0,0 +1,205 @@
+/**
+* BSD 2-Clause License
+*
+* Copyright (c) 2022-2023, Manas Kamal Choudhury
+* All rights reserved.
+*
+* Redistribution and use in source and binary forms, with or without
+* modification, are permitted provided that the following conditions are met:
+*
+* 1. Redistributions of source code must retain the above copyright notice, this
+*    list of conditions and the following disclaimer.
+*
+* 2. Redistributions in binary form must reproduce the above copyright notice,
+*    this list of conditions and the following disclaimer in the documentation
+*    and/or other materials provided with the distribution.
+*
+* THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+* AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+* IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+* DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE
+* FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+* DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR
+* SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER
+* CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY,
+* OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+* OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+*
+**/
+
+#include <sys/_kesync.h>
+
+extern "C" long _InterlockedExchange(long volatile* target, long value);
+extern "C" long _InterlockedCompareExchange(long volatile* dest, long exchange, long comparand);
+extern "C" long _InterlockedIncrement(long volatile* addend);
+extern "C" long _InterlockedDecrement(long volatile* addend);
+#pragma intrinsic(_InterlockedExchange)
+#pragma intrinsic(_InterlockedCompareExchange)
+#pragma intrinsic(_InterlockedIncrement)
+#pragma intrinsic(_InterlockedDecrement)
+
+#define XE_INT_MAX  0x7FFFFFFF
+
+/*
+ * Uncontended lock, unlock, signal and post stay in user
+ * space, the futex syscall is only used to sleep or to
+ * wake a thread that is known to sleep.
+ */
+
+/*
+ * _XEMutexInit -- initialise a mutex
+ * @param m -- Pointer to mutex
+ */
+XE_EXTERN XE_LIB void _XEMutexInit(XEMutex* m) {
+	m->state = 0;
+}
+
+/*
+ * _XEMutexLock -- lock a mutex, sleeps in kernel
+ * only when contended
+ * @param m -- Pointer to mutex
+ */
+XE_EXTERN XE_LIB void _XEMutexLock(XEMutex* m) {
+	long c = _InterlockedCompareExchange((long volatile*)&m->state, 1, 0);
+	if (c == 0)
+		return;
+
+	/* mark contended, whoever unlocks has to wake us */
+	if (c != 2)
+		c = _InterlockedExchange((long volatile*)&m->state, 2);
+	while (c != 0) {
+		_KeFutex((uint32_t*)&m->state, FUTEX_WAIT, 2, 0, 0, 0);
+		c = _InterlockedExchange((long volatile*)&m->state, 2);
+	}
+}
+
+/*
+ * _XEMutexTryLock -- lock a mutex if it's free,
+ * returns 0 on success
+ * @param m -- Pointer to mutex
+ */
+XE_EXTERN XE_LIB int _XEMutexTryLock(XEMutex* m) {
+	if (_InterlockedCompareExchange((long volatile*)&m->state, 1, 0) == 0)
+		return 0;
+	return -1;
+}
+
+/*
+ * _XEMutexUnlock -- unlock a mutex
+ * @param m -- Pointer to mutex
+ */
+XE_EXTERN XE_LIB void _XEMutexUnlock(XEMutex* m) {
+	if (_InterlockedExchange((long volatile*)&m->state, 0) == 2)
+		_KeFutex((uint32_t*)&m->state, FUTEX_WAKE, 1, 0, 0, 0);
+}
+
+/*
+ * _XECondInit -- initialise a condition variable
+ * @param cv -- Pointer to condition variable
+ */
+XE_EXTERN XE_LIB void _XECondInit(XECondVar* cv) {
+	cv->seq = 0;
+	cv->mutex = 0;
+}
+
+/*
+ * _XECondWait -- atomically unlock mutex and wait
+ * for a signal, mutex is locked again on return
+ * @param cv -- Pointer to condition variable
+ * @param m -- Pointer to locked mutex
+ * @param timeout -- timeout in ms, 0 for infinite
+ * @return 0 on signal, FUTEX_TIMEDOUT on timeout
+ */
+XE_EXTERN XE_LIB int _XECondWait(XECondVar* cv, XEMutex* m, uint64_t timeout) {
+	uint32_t seq = cv->seq;
+	cv->mutex = m;
+	_XEMutexUnlock(m);
+	int64_t ret = _KeFutex((uint32_t*)&cv->seq, FUTEX_WAIT, seq, timeout, 0, 0);
+
+	/* broadcast may have requeued us onto the mutex, take it
+	 * in contended state so the next unlock wakes others */
+	while (_InterlockedExchange((long volatile*)&m->state, 2) != 0)
+		_KeFutex((uint32_t*)&m->state, FUTEX_WAIT, 2, 0, 0, 0);
+	return (ret == FUTEX_TIMEDOUT) ? FUTEX_TIMEDOUT : 0;
+}
+
+/*
+ * _XECondSignal -- wake one waiter
+ * @param cv -- Pointer to condition variable
+ */
+XE_EXTERN XE_LIB void _XECondSignal(XECondVar* cv) {
+	_InterlockedIncrement((long volatile*)&cv->seq);
+	_KeFutex((uint32_t*)&cv->seq, FUTEX_WAKE, 1, 0, 0, 0);
+}
+
+/*
+ * _XECondBroadcast -- wake all waiters
+ * @param cv -- Pointer to condition variable
+ */
+XE_EXTERN XE_LIB void _XECondBroadcast(XECondVar* cv) {
+	XEMutex* m = cv->mutex;
+	uint32_t seq = _InterlockedIncrement((long volatile*)&cv->seq);
+	if (!m) {
+		_KeFutex((uint32_t*)&cv->seq, FUTEX_WAKE, XE_INT_MAX, 0, 0, 0);
+		return;
+	}
+	/* wake one, the rest wait on the mutex instead of
+	 * all racing for it */
+	if (_KeFutex((uint32_t*)&cv->seq, FUTEX_CMP_REQUEUE, 1, XE_INT_MAX,
+		(uint32_t*)&m->state, seq) == FUTEX_AGAIN)
+		_KeFutex((uint32_t*)&cv->seq, FUTEX_WAKE, XE_INT_MAX, 0, 0, 0);
+}
+
+/*
+ * _XESemInit -- initialise a semaphore
+ * @param s -- Pointer to semaphore
+ * @param count -- initial count
+ */
+XE_EXTERN XE_LIB void _XESemInit(XESemaphore* s, uint32_t count) {
+	s->count = count;
+	s->waiters = 0;
+}
+
+/*
+ * _XESemTryWait -- decrement the semaphore if
+ * it is non zero, returns 0 on success
+ * @param s -- Pointer to semaphore
+ */
+XE_EXTERN XE_LIB int _XESemTryWait(XESemaphore* s) {
+	uint32_t c = s->count;
+	while (c > 0) {
+		uint32_t prev = _InterlockedCompareExchange((long volatile*)&s->count, c - 1, c);
+		if (prev == c)
+			return 0;
+		c = prev;
+	}
+	return -1;
+}
+
+/*
+ * _XESemWait -- decrement the semaphore, sleeping
+ * while it is zero
+ * @param s -- Pointer to semaphore
+ * @param timeout -- timeout in ms, 0 for infinite
+ * @return 0 on success, FUTEX_TIMEDOUT on timeout
+ */
+XE_EXTERN XE_LIB int _XESemWait(XESemaphore* s, uint64_t timeout) {
+	while (_XESemTryWait(s) != 0) {
+		_InterlockedIncrement((long volatile*)&s->waiters);
+		int64_t ret = _KeFutex((uint32_t*)&s->count, FUTEX_WAIT, 0, timeout, 0, 0);
+		_InterlockedDecrement((long volatile*)&s->waiters);
+		if (ret == FUTEX_TIMEDOUT)
+			return _XESemTryWait(s) == 0 ? 0 : FUTEX_TIMEDOUT;
+	}
+	return 0;
+}
+
+/*
+ * _XESemPost -- increment the semaphore
+ * @param s -- Pointer to semaphore
+ */
+XE_EXTERN XE_LIB void _XESemPost(XESemaphore* s) {
+	_InterlockedIncrement((long volatile*)&s->count);
+	if (s->waiters)
+		_KeFutex((uint32_t*)&s->count, FUTEX_WAKE, 1, 0, 0, 0);
+}
@@ -229,7 +229,7 @@ void DeodhaiBackSurfaceUpdate(ChCanvas* canv, int x, int y, int w, int h) {
 /*
  * DeodhaiCreateWindow -- create a new deodhai window
  */
-Window* DeodhaiCreateWindow(int x, int y, int w, int h, uint16_t flags, uint16_t ownerId, char* title) {
+Window* DeodhaiCreateWindow(int x, int y, int w, int h, uint16_t flags, uint32_t ownerId, char* title) {
 	Window* win = CreateWindow(x, y, w, h, flags, ownerId, title);
 	if (flags & WINDOW_FLAG_ALWAYS_ON_TOP) {
 		DeodhaiAddWindowAlwaysOnTop(win);
@@ -1235,18 +1235,33 @@ void ComposeFrame(ChCanvas *canvas) {
  * @param y -- Mouse y location
  * @param button -- Mouse button state
  */
-void DeodhaiSendMouseEvent(int handle,int ownerId,uint8_t handleType,uint8_t eventType, int x, int y, int button){
+void DeodhaiSendMouseEvent(Window* win, uint8_t eventType, int x, int y, int button){
+	uint8_t handleType = HANDLE_TYPE_NORMAL_WINDOW;
+	if ((win->flags & WINDOW_FLAG_POPUP))
+		handleType = HANDLE_TYPE_POPUP_WINDOW;
 	PostEvent e;
 	memset(&e, 0, sizeof(PostEvent));
 	e.type = eventType;
 	e.dword = x;
 	e.dword2 = y;
 	e.dword3 = button;
-	e.dword4 = handle;
+	e.dword4 = win->handle;
 	e.dword5 = handleType;
-	e.to_id = ownerId;
+	e.to_id = win->ownerId;
 	e.from_id = POSTBOX_ROOT_ID;
-	_KeFileIoControl(postbox_fd, POSTBOX_PUT_EVENT, &e);
+
+	/* plain motion with unchanged button state may be superseded
+	 * by the next motion to the same window if the client has
+	 * not read it yet */
+	PostBoxPutRequest req;
+	req.events = &e;
+	req.count = 1;
+	req.lane = POSTBOX_LANE_INPUT;
+	req.flags = 0;
+	if (eventType == DEODHAI_REPLY_MOUSE_EVENT && button == win->lastButton)
+		req.flags |= POSTBOX_FLAG_COALESCE;
+	win->lastButton = button;
+	_KeFileIoControl(postbox_fd, POSTBOX_PUT_EVENTS, &req);
 }
 
 /*
@@ -1341,25 +1356,16 @@ broadcast:
 		WinSharedInfo* info = (WinSharedInfo*)mouseWin->sharedInfo;
 		DeodhaiResizeCursorUpdate(mouse_x, mouse_y, info);
 
-		int handle = mouseWin->handle;
-		uint8_t handleType = HANDLE_TYPE_NORMAL_WINDOW;
-		if ((mouseWin->flags & WINDOW_FLAG_POPUP))
-			handleType = HANDLE_TYPE_POPUP_WINDOW;
-
 		/* handle mouse last window hover */
 		if (mouseLastHovered) {
 			if (mouseLastHovered != mouseWin) {
-				int lastWinHandleType = HANDLE_TYPE_NORMAL_WINDOW;
-				if ((mouseLastHovered->flags & WINDOW_FLAG_POPUP))
-					lastWinHandleType = HANDLE_TYPE_POPUP_WINDOW;
-				DeodhaiSendMouseEvent(mouseLastHovered->handle, mouseLastHovered->ownerId, lastWinHandleType,
-					DEODHAI_REPLY_MOUSE_LEAVE, mouse_x, mouse_y, button);
+				DeodhaiSendMouseEvent(mouseLastHovered, DEODHAI_REPLY_MOUSE_LEAVE, mouse_x, mouse_y, button);
 			//	_KeProcessSleep(100);
 			}
 		}
 
 		mouseLastHovered = mouseWin;
-		DeodhaiSendMouseEvent(handle,mouseWin->ownerId, handleType,DEODHAI_REPLY_MOUSE_EVENT,mouse_x, mouse_y, button);
+		DeodhaiSendMouseEvent(mouseWin, DEODHAI_REPLY_MOUSE_EVENT, mouse_x, mouse_y, button);
 	}
 
 	if (!mouseWin) {
@@ -1385,7 +1391,12 @@ void DeodhaiBroadcastKey(int code) {
 	e.dword2 = focusedWin->handle;
 	e.to_id = focusedWin->ownerId;
 	e.from_id = POSTBOX_ROOT_ID;
-	_KeFileIoControl(postbox_fd, POSTBOX_PUT_EVENT, &e);
+	PostBoxPutRequest req;
+	req.events = &e;
+	req.count = 1;
+	req.lane = POSTBOX_LANE_INPUT;
+	req.flags = 0;
+	_KeFileIoControl(postbox_fd, POSTBOX_PUT_EVENTS, &req);
 }
 
 
@@ -1801,7 +1812,7 @@ int main(int argc, char* arv[]) {
 		}
 
 		if (event.type == DEODHAI_MESSAGE_WINDOW_HIDE) {
-			uint16_t ownerId = event.dword;
+			uint32_t ownerId = event.dword;
 			uint32_t handle = event.dword2;
 			Window* hideable_win = NULL;
 			for (Window* win = rootWin; win != NULL; win = win->next) {
@@ -1846,7 +1857,7 @@ int main(int argc, char* arv[]) {
 		}
 
 		if (event.type == DEODHAI_MESSAGE_GETWINDOW) {
-			uint16_t ownerID = 0;
+			uint32_t ownerID = 0;
 			uint32_t handle = 0;
 			bool _not_found = true;
 			for (Window* win = rootWin; win != NULL; win = win->next) {
@@ -44,9 +44,9 @@ uint16_t back_buffer_key_prefix = 400;
  * @param shkey -- location where to store the window key
  * @param ownerId -- owning process id
  */
-uint32_t* CreateSharedWinSpace(uint16_t *shkey, uint16_t ownerId) {
+uint32_t* CreateSharedWinSpace(uint16_t *shkey, uint32_t ownerId) {
 	uint32_t key = shared_win_key_prefix + ownerId;
-	int id = _KeCreateSharedMem(key,sizeof(WinSharedInfo), 0);
+	int64_t id = _KeCreateSharedMem(key,sizeof(WinSharedInfo), 0);
 	void* addr = _KeObtainSharedMem(id, NULL, 0);
 	*shkey = key;
 	shared_win_key_prefix += 10;
@@ -59,9 +59,9 @@ uint32_t* CreateSharedWinSpace(uint16_t *shkey, uint16_t ownerId) {
  * @param sz -- Size of the buffer
  * @param key -- location where to store the buffer key
  */
-void* CreateNewBackBuffer(uint16_t ownerId, uint32_t sz, uint16_t *key){
+void* CreateNewBackBuffer(uint32_t ownerId, uint32_t sz, uint16_t *key){
 	uint32_t key_prefix = back_buffer_key_prefix + ownerId;
-	int id = _KeCreateSharedMem(key_prefix, sz, 0);
+	int64_t id = _KeCreateSharedMem(key_prefix, sz, 0);
 	void* ptr = _KeObtainSharedMem(id, 0, NULL);
 	*key = key_prefix;
 	back_buffer_key_prefix += 10;
@@ -89,7 +89,7 @@ void WindowShadowFillColor(Window* win,int shadow_w,int x, int y, int w, int h,
  * @param ownerId -- process owner id of the window
  * @param title -- title of the window
  */
-Window* CreateWindow(int x, int y, int w, int h, uint16_t flags, uint16_t ownerId, char* title) {
+Window* CreateWindow(int x, int y, int w, int h, uint16_t flags, uint32_t ownerId, char* title) {
 	uint16_t shKey = 0;
 	uint16_t backBufferKey = 0;
 	int64_t w_ = w, h_ = h, x_ = x, y_ = y;
@@ -74,7 +74,7 @@ typedef struct _win_info_ {
 
 typedef struct _win_ {
 	uint16_t flags;
-	uint16_t ownerId;
+	uint32_t ownerId;
 	uint32_t* backBuffer;
 	uint32_t* sharedInfo;
 	uint32_t* shadowBuffers;
@@ -89,6 +89,7 @@ typedef struct _win_ {
 	uint8_t animFrameCount;
 	int animAlphaVal;
 	bool animdirection; 
+	int lastButton;  //button state of last mouse event sent
 	char* title;
 	struct _win_* firstPopupWin;
 	struct _win_* lastPopupWin;
@@ -103,7 +104,7 @@ typedef struct _win_ {
 * @param shkey -- location where to store the window key
 * @param ownerId -- owning process id
 */
-extern uint32_t* CreateSharedWinSpace(uint16_t *shkey, uint16_t ownerId);
+extern uint32_t* CreateSharedWinSpace(uint16_t *shkey, uint32_t ownerId);
 
 /*
 * CreateNewBackBuffer --Create a back buffer window
@@ -111,7 +112,7 @@ extern uint32_t* CreateSharedWinSpace(uint16_t *shkey, uint16_t ownerId);
 * @param sz -- Size of the buffer
 * @param key -- location where to store the buffer key
 */
-extern void* CreateNewBackBuffer(uint16_t ownerId, uint32_t sz, uint16_t *key);
+extern void* CreateNewBackBuffer(uint32_t ownerId, uint32_t sz, uint16_t *key);
 /*
 * CreateWindow -- create a new window
 * @param x -- X position of the window
@@ -122,5 +123,5 @@ extern void* CreateNewBackBuffer(uint16_t ownerId, uint32_t sz, uint16_t *key);
 * @param ownerId -- process owner id of the window
 * @param title -- title of the window
 */
-extern Window* CreateWindow(int x, int y, int w, int h, uint16_t flags, uint16_t ownerId, char* title);
+extern Window* CreateWindow(int x, int y, int w, int h, uint16_t flags, uint32_t ownerId, char* title);
 #endif
\ No newline at end of file
@@ -147,7 +147,7 @@ DeodhaiAudioBox* DeodhaiCreateAudioBox(uint16_t ownerThreadID) {
 
 	/* create the control panel */
 	uint16_t controlPanelKey = DeodhaiGetNewControlPanelKey();
-	int id = _KeCreateSharedMem(controlPanelKey, sizeof(AudioControlPanel), 0);
+	int64_t id = _KeCreateSharedMem(controlPanelKey, sizeof(AudioControlPanel), 0);
 	void* addr = _KeObtainSharedMem(id, NULL, 0);
 	AudioControlPanel* panel = (AudioControlPanel*)addr;
 	memset(panel, 0, sizeof(AudioControlPanel));
@@ -158,7 +158,7 @@ DeodhaiAudioBox* DeodhaiCreateAudioBox(uint16_t ownerThreadID) {
 
 	/* now create the sample buffer */
 	uint16_t sampleKey = DeodhaiGetNewSampleBuffKey();
-	int id2 = _KeCreateSharedMem(sampleKey, 4096, 0);
+	int64_t id2 = _KeCreateSharedMem(sampleKey, 4096, 0);
 	void* sampleBuff = _KeObtainSharedMem(id2, NULL, 0);
 
 	/* fill up the information to audio box */
@@ -0,0 +1,183 @@
+/**
+* BSD 2-Clause License
+*
+* Copyright (c) 2022-2023, Manas Kamal Choudhury
+* All rights reserved.
+*
+* Redistribution and use in source and binary forms, with or without
+* modification, are permitted provided that the following conditions are met:
+*
+* 1. Redistributions of source code must retain the above copyright notice, this
+*    list of conditions and the following disclaimer.
+*
+* 2. Redistributions in binary form must reproduce the above copyright notice,
+*    this list of conditions and the following disclaimer in the documentation
+*    and/or other materials provided with the distribution.
+*
+* THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+* AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+* IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+* DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE
+* FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+* DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR
+* SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER
+* CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY,
+* OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+* OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+*
+**/
+
+/*
+ * ringbench -- host side throughput benchmark of the
+ * kernel's SPSC byte ring (Kernel/ringbuf.cpp). Producer
+ * and consumer run on separate threads and yield when
+ * the ring is full or empty, the consumer checks the
+ * byte sequence so ordering bugs show up as failures
+ * rather than as numbers.
+ *
+ * build from repository root:
+ *   g++ -O2 -std=c++11 -pthread -idirafter BaseHdr \
+ *       Tools/RingBench/ringbench.cpp Kernel/ringbuf.cpp -o ringbench
+ *
+ * -idirafter keeps host <stdint.h>/<string.h> ahead of
+ * the kernel's own headers.
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <stdint.h>
+#include <string.h>
+#include <thread>
+#include <chrono>
+#include <ringbuf.h>
+
+#define BENCH_RING_SIZE  4096
+#define BENCH_TOTAL      (256ULL * 1024 * 1024)
+
+enum BenchMode {
+	BENCH_BYTE,   /* one byte per call, like old circbuf */
+	BENCH_COPY,   /* bulk write/read */
+	BENCH_PEEK,   /* zero copy peek/commit on both sides */
+};
+
+static const char* modeName[] = { "byte", "copy", "peek" };
+
+static bool failed;
+
+static void Producer(AuRingBuffer* ring, BenchMode mode, uint32_t chunk, uint64_t total) {
+	uint8_t* src = (uint8_t*)malloc(chunk);
+	uint64_t sent = 0;
+	uint8_t seq = 0;
+	while (sent < total) {
+		if (mode == BENCH_BYTE) {
+			if (AuRingBufPut(ring, seq) == 0) {
+				seq++;
+				sent++;
+			}
+			else
+				std::this_thread::yield();
+			continue;
+		}
+
+		if (mode == BENCH_PEEK) {
+			uint8_t* span;
+			uint32_t room = AuRingBufWritePeek(ring, &span);
+			if (room > chunk)
+				room = chunk;
+			if (room > total - sent)
+				room = (uint32_t)(total - sent);
+			if (room == 0) {
+				std::this_thread::yield();
+				continue;
+			}
+			for (uint32_t i = 0; i < room; i++)
+				span[i] = seq++;
+			AuRingBufWriteCommit(ring, room);
+			sent += room;
+			continue;
+		}
+
+		uint32_t len = chunk;
+		if (len > total - sent)
+			len = (uint32_t)(total - sent);
+		for (uint32_t i = 0; i < len; i++)
+			src[i] = (uint8_t)(seq + i);
+		uint32_t off = 0;
+		while (off < len) {
+			uint32_t n = AuRingBufWrite(ring, src + off, len - off);
+			if (n == 0)
+				std::this_thread::yield();
+			off += n;
+		}
+		seq += (uint8_t)len;
+		sent += len;
+	}
+	free(src);
+}
+
+static void Consumer(AuRingBuffer* ring, BenchMode mode, uint32_t chunk, uint64_t total) {
+	uint8_t* dst = (uint8_t*)malloc(chunk);
+	uint64_t got = 0;
+	uint8_t seq = 0;
+	while (got < total) {
+		if (mode == BENCH_PEEK) {
+			uint8_t* span;
+			uint32_t ready = AuRingBufReadPeek(ring, &span);
+			if (ready > chunk)
+				ready = chunk;
+			if (ready == 0) {
+				std::this_thread::yield();
+				continue;
+			}
+			for (uint32_t i = 0; i < ready; i++) {
+				if (span[i] != seq++)
+					failed = true;
+			}
+			AuRingBufReadCommit(ring, ready);
+			got += ready;
+			continue;
+		}
+
+		uint32_t n = (mode == BENCH_BYTE) ? AuRingBufRead(ring, dst, 1) : AuRingBufRead(ring, dst, chunk);
+		if (n == 0)
+			std::this_thread::yield();
+		for (uint32_t i = 0; i < n; i++) {
+			if (dst[i] != seq++)
+				failed = true;
+		}
+		got += n;
+	}
+	free(dst);
+}
+
+static void Run(BenchMode mode, uint32_t chunk) {
+	AuRingBuffer ring;
+	uint8_t* storage = (uint8_t*)malloc(BENCH_RING_SIZE);
+	AuRingBufInit(&ring, storage, BENCH_RING_SIZE);
+
+	/* byte mode is too slow for the full amount */
+	uint64_t total = (mode == BENCH_BYTE) ? BENCH_TOTAL / 16 : BENCH_TOTAL;
+	failed = false;
+
+	auto start = std::chrono::steady_clock::now();
+	std::thread prod(Producer, &ring, mode, chunk, total);
+	std::thread cons(Consumer, &ring, mode, chunk, total);
+	prod.join();
+	cons.join();
+	auto end = std::chrono::steady_clock::now();
+
+	double secs = std::chrono::duration<double>(end - start).count();
+	printf("%-5s chunk %5u : %9.1f MiB/s %s\n", modeName[mode], chunk,
+		(total / (1024.0 * 1024.0)) / secs, failed ? "CORRUPT" : "ok");
+	free(storage);
+}
+
+int main() {
+	Run(BENCH_BYTE, 1);
+	uint32_t chunks[] = { 16, 64, 512, 2048 };
+	for (int i = 0; i < 4; i++)
+		Run(BENCH_COPY, chunks[i]);
+	for (int i = 0; i < 4; i++)
+		Run(BENCH_PEEK, chunks[i]);
+	return failed ? 1 : 0;
+}
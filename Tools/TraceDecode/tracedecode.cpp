@@ -0,0 +1,319 @@
+/**
+* BSD 2-Clause License
+*
+* Copyright (c) 2022-2023, Manas Kamal Choudhury
+* All rights reserved.
+*
+* Redistribution and use in source and binary forms, with or without
+* modification, are permitted provided that the following conditions are met:
+*
+* 1. Redistributions of source code must retain the above copyright notice, this
+*    list of conditions and the following disclaimer.
+*
+* 2. Redistributions in binary form must reproduce the above copyright notice,
+*    this list of conditions and the following disclaimer in the documentation
+*    and/or other materials provided with the distribution.
+*
+* THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+* AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+* IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+* DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE
+* FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+* DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR
+* SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER
+* CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY,
+* OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+* OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+*
+**/
+
+/*
+ * tracedecode -- host side decoder of kernel trace dumps
+ * read from /dev/trace, writes Chrome trace json that
+ * chrome://tracing or Perfetto can load. Cpus show up
+ * under "cpus" with the thread running on them and irq
+ * slices, threads show up under "threads" with their
+ * syscalls and block requests. Page faults, postbox
+ * sends and lost records are instant events.
+ *
+ * build from repository root:
+ *   g++ -O2 -std=c++11 -idirafter BaseHdr \
+ *       Tools/TraceDecode/tracedecode.cpp -o tracedecode
+ *
+ * usage:
+ *   tracedecode trace.bin > trace.json
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <stdint.h>
+#include <string.h>
+#include <vector>
+#include <map>
+#include <algorithm>
+#include <autrace.h>
+
+#define PID_CPUS     0
+#define PID_THREADS  1
+
+struct OpenSpan {
+	uint64_t key;
+	uint64_t arg;
+	double ts;
+};
+
+struct CpuState {
+	bool running;
+	uint32_t tid;
+	double since;
+	std::vector<OpenSpan> irqs;
+};
+
+static FILE* out;
+static bool first = true;
+static double tscMhz;
+static uint64_t tscBase;
+
+static double ToUs(uint64_t tsc) {
+	return (double)(tsc - tscBase) / tscMhz;
+}
+
+static void Sep() {
+	fprintf(out, first ? "\n" : ",\n");
+	first = false;
+}
+
+static void Meta(int pid, int tid, const char* what, const char* name) {
+	Sep();
+	fprintf(out, "{\"ph\":\"M\",\"pid\":%d,\"tid\":%d,\"name\":\"%s\",\"args\":{\"name\":\"%s\"}}",
+		pid, tid, what, name);
+}
+
+static void Complete(int pid, uint32_t tid, const char* name, double ts, double end, const char* args) {
+	Sep();
+	fprintf(out, "{\"ph\":\"X\",\"pid\":%d,\"tid\":%u,\"name\":\"%s\",\"ts\":%.3f,\"dur\":%.3f,\"args\":{%s}}",
+		pid, tid, name, ts, end - ts, args);
+}
+
+static void Instant(int pid, uint32_t tid, const char* name, double ts, const char* args) {
+	Sep();
+	fprintf(out, "{\"ph\":\"i\",\"s\":\"t\",\"pid\":%d,\"tid\":%u,\"name\":\"%s\",\"ts\":%.3f,\"args\":{%s}}",
+		pid, tid, name, ts, args);
+}
+
+/*
+ * PopSpan -- find the innermost open span with key,
+ * spans opened above it are left open
+ */
+static bool PopSpan(std::vector<OpenSpan>& stack, uint64_t key, OpenSpan* span) {
+	for (size_t i = stack.size(); i > 0; i--) {
+		if (stack[i - 1].key == key) {
+			*span = stack[i - 1];
+			stack.erase(stack.begin() + (i - 1));
+			return true;
+		}
+	}
+	return false;
+}
+
+static bool ByTsc(const AuTraceRecord& a, const AuTraceRecord& b) {
+	return a.tsc < b.tsc;
+}
+
+int main(int argc, char* argv[]) {
+	if (argc < 2) {
+		fprintf(stderr, "usage: %s trace.bin [out.json]\n", argv[0]);
+		return 1;
+	}
+	FILE* in = fopen(argv[1], "rb");
+	if (!in) {
+		perror(argv[1]);
+		return 1;
+	}
+
+	AuTraceHeader hdr;
+	if (fread(&hdr, sizeof(hdr), 1, in) != 1 || hdr.magic != TRACE_MAGIC) {
+		fprintf(stderr, "%s: not a trace dump\n", argv[1]);
+		return 1;
+	}
+	if (hdr.version != TRACE_VERSION || hdr.recordSize != sizeof(AuTraceRecord)) {
+		fprintf(stderr, "%s: unsupported version %u record size %u\n", argv[1],
+			hdr.version, hdr.recordSize);
+		return 1;
+	}
+
+	/* a dump may hold several reads back to back, every
+	 * read starts with a header of its own */
+	std::vector<AuTraceRecord> recs;
+	AuTraceRecord rec;
+	while (fread(&rec, sizeof(rec), 1, in) == 1) {
+		AuTraceHeader* next = (AuTraceHeader*)&rec;
+		if (next->magic == TRACE_MAGIC && next->version == TRACE_VERSION &&
+			next->recordSize == sizeof(AuTraceRecord)) {
+			if (fseek(in, (long)sizeof(AuTraceHeader) - (long)sizeof(AuTraceRecord), SEEK_CUR) != 0)
+				break;
+			continue;
+		}
+		recs.push_back(rec);
+	}
+	fclose(in);
+
+	out = stdout;
+	if (argc > 2) {
+		out = fopen(argv[2], "w");
+		if (!out) {
+			perror(argv[2]);
+			return 1;
+		}
+	}
+
+	/* rings are drained cpu by cpu, merge them back */
+	std::stable_sort(recs.begin(), recs.end(), ByTsc);
+	tscMhz = hdr.tscMhz ? (double)hdr.tscMhz : 1.0;
+	tscBase = recs.empty() ? 0 : recs[0].tsc;
+
+	std::map<uint8_t, CpuState> cpus;
+	std::map<uint32_t, std::vector<OpenSpan> > syscalls;
+	std::map<uint32_t, std::vector<OpenSpan> > blocks;
+	char name[64];
+	char args[128];
+
+	fprintf(out, "{\"traceEvents\":[");
+	Meta(PID_CPUS, 0, "process_name", "cpus");
+	Meta(PID_THREADS, 0, "process_name", "threads");
+
+	for (size_t i = 0; i < recs.size(); i++) {
+		AuTraceRecord* r = &recs[i];
+		double ts = ToUs(r->tsc);
+		if (cpus.find(r->cpu) == cpus.end()) {
+			snprintf(name, sizeof(name), "cpu %u", r->cpu);
+			Meta(PID_CPUS, r->cpu, "thread_name", name);
+			CpuState st;
+			st.running = false;
+			st.tid = 0;
+			st.since = ts;
+			cpus[r->cpu] = st;
+		}
+		CpuState& cpu = cpus[r->cpu];
+
+		switch (r->event) {
+		case TRACE_EVENT_SWITCH: {
+			/* tick handler leaves through the switch, irqs
+			 * still open on this cpu end here */
+			for (size_t j = 0; j < cpu.irqs.size(); j++) {
+				snprintf(name, sizeof(name), "irq 0x%llx", (unsigned long long)cpu.irqs[j].key);
+				Complete(PID_CPUS, r->cpu, name, cpu.irqs[j].ts, ts, "\"closed\":\"switch\"");
+			}
+			cpu.irqs.clear();
+			if (cpu.running) {
+				snprintf(name, sizeof(name), "thread %u", cpu.tid);
+				Complete(PID_CPUS, r->cpu, name, cpu.since, ts, "");
+			}
+			cpu.running = true;
+			cpu.tid = (uint32_t)r->arg1;
+			cpu.since = ts;
+			break;
+		}
+		case TRACE_EVENT_IRQ_ENTER: {
+			OpenSpan s = { r->arg0, 0, ts };
+			cpu.irqs.push_back(s);
+			break;
+		}
+		case TRACE_EVENT_IRQ_EXIT: {
+			OpenSpan s;
+			snprintf(name, sizeof(name), "irq 0x%llx", (unsigned long long)r->arg0);
+			if (PopSpan(cpu.irqs, r->arg0, &s))
+				Complete(PID_CPUS, r->cpu, name, s.ts, ts, "");
+			else
+				Instant(PID_CPUS, r->cpu, name, ts, "\"unpaired\":\"exit\"");
+			break;
+		}
+		case TRACE_EVENT_SYSCALL_ENTER: {
+			OpenSpan s = { r->arg0, r->arg1, ts };
+			syscalls[r->thread].push_back(s);
+			break;
+		}
+		case TRACE_EVENT_SYSCALL_EXIT: {
+			OpenSpan s;
+			snprintf(name, sizeof(name), "syscall %llu", (unsigned long long)r->arg0);
+			if (PopSpan(syscalls[r->thread], r->arg0, &s)) {
+				snprintf(args, sizeof(args), "\"param1\":\"0x%llx\",\"ret\":%lld",
+					(unsigned long long)s.arg, (long long)r->arg1);
+				Complete(PID_THREADS, r->thread, name, s.ts, ts, args);
+			}
+			else {
+				snprintf(args, sizeof(args), "\"unpaired\":\"exit\",\"ret\":%lld", (long long)r->arg1);
+				Instant(PID_THREADS, r->thread, name, ts, args);
+			}
+			break;
+		}
+		case TRACE_EVENT_BLOCK_ISSUE: {
+			OpenSpan s = { r->arg0, r->arg1, ts };
+			blocks[r->thread].push_back(s);
+			break;
+		}
+		case TRACE_EVENT_BLOCK_COMPLETE: {
+			OpenSpan s;
+			const char* op = (r->arg1 >> 32) ? "block write" : "block read";
+			snprintf(args, sizeof(args), "\"lba\":%llu,\"count\":%u",
+				(unsigned long long)r->arg0, (uint32_t)r->arg1);
+			if (PopSpan(blocks[r->thread], r->arg0, &s))
+				Complete(PID_THREADS, r->thread, op, s.ts, ts, args);
+			else
+				Instant(PID_THREADS, r->thread, op, ts, args);
+			break;
+		}
+		case TRACE_EVENT_PAGE_FAULT:
+			snprintf(args, sizeof(args), "\"addr\":\"0x%llx\",\"error\":\"0x%llx\"",
+				(unsigned long long)r->arg0, (unsigned long long)r->arg1);
+			Instant(PID_THREADS, r->thread, "page fault", ts, args);
+			break;
+		case TRACE_EVENT_POSTBOX_SEND:
+			snprintf(args, sizeof(args), "\"to\":%llu,\"type\":%llu",
+				(unsigned long long)r->arg0, (unsigned long long)r->arg1);
+			Instant(PID_THREADS, r->thread, "postbox send", ts, args);
+			break;
+		case TRACE_EVENT_LOST:
+			snprintf(args, sizeof(args), "\"records\":%llu", (unsigned long long)r->arg0);
+			Instant(PID_CPUS, r->cpu, "lost", ts, args);
+			break;
+		default:
+			snprintf(name, sizeof(name), "event %u", r->event);
+			Instant(PID_CPUS, r->cpu, name, ts, "");
+			break;
+		}
+	}
+
+	/* close whatever is still open at the end of the dump */
+	double end = recs.empty() ? 0 : ToUs(recs.back().tsc);
+	for (std::map<uint8_t, CpuState>::iterator it = cpus.begin(); it != cpus.end(); ++it) {
+		CpuState& cpu = it->second;
+		if (cpu.running) {
+			snprintf(name, sizeof(name), "thread %u", cpu.tid);
+			Complete(PID_CPUS, it->first, name, cpu.since, end, "");
+		}
+		for (size_t j = 0; j < cpu.irqs.size(); j++) {
+			snprintf(name, sizeof(name), "irq 0x%llx", (unsigned long long)cpu.irqs[j].key);
+			Instant(PID_CPUS, it->first, name, cpu.irqs[j].ts, "\"unpaired\":\"enter\"");
+		}
+	}
+	for (std::map<uint32_t, std::vector<OpenSpan> >::iterator it = syscalls.begin(); it != syscalls.end(); ++it) {
+		for (size_t j = 0; j < it->second.size(); j++) {
+			snprintf(name, sizeof(name), "syscall %llu", (unsigned long long)it->second[j].key);
+			Instant(PID_THREADS, it->first, name, it->second[j].ts, "\"unpaired\":\"enter\"");
+		}
+	}
+	for (std::map<uint32_t, std::vector<OpenSpan> >::iterator it = blocks.begin(); it != blocks.end(); ++it) {
+		for (size_t j = 0; j < it->second.size(); j++) {
+			snprintf(args, sizeof(args), "\"unpaired\":\"issue\",\"lba\":%llu",
+				(unsigned long long)it->second[j].key);
+			Instant(PID_THREADS, it->first, "block issue", it->second[j].ts, args);
+		}
+	}
+
+	fprintf(out, "\n],\"displayTimeUnit\":\"ns\",\"otherData\":{\"tscMhz\":%llu,\"lost\":%llu}}\n",
+		(unsigned long long)hdr.tscMhz, (unsigned long long)hdr.lost);
+	if (out != stdout)
+		fclose(out);
+	return 0;
+}